@@ -0,0 +1,409 @@
+/*******************************************************************************
+ * Common.cl
+ * - Types and helper functions shared by the kernel programs, including
+ *   the neighbor stencils of the solver's neighbor loops. Include with
+ *   #include "kernels/Common.cl"
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_KERNELS_COMMON_CL
+#define PBF_KERNELS_COMMON_CL
+
+/*******************************************************************************
+ * Types; these must match the host-side definitions in Simulation.h and
+ * Parameters.h exactly
+ ******************************************************************************/
+
+typedef struct {
+
+    float4 pos;      // Current particle position (x)
+
+    float4 posStar;  // Predicted particle position (x*)
+
+    float4 vel;      // Current particle velocity (v)
+
+} Particle;
+
+typedef struct {
+
+    int particleIndex; // Index of particle in particle buffer
+
+    int cellI;         // Corresponding grid index in the x-axis
+
+    int cellJ;         // Corresponding grid index in the y-axis
+
+    int cellK;         // Corresponding grid index in the z-axis
+
+    int key;           // Linearized index key computed from the subscript
+                       // (cellI, cellJ, cellK)
+    int __padding[3];
+
+} ParticlePosition;
+
+typedef struct {
+
+    int start;  // Start of the grid cell in sortedParticleToCell
+
+    int length;
+
+    int __padding[2];
+
+} GridCellOffset;
+
+typedef struct {
+
+    float particleRadius;
+
+    float smoothingRadius;
+
+    float relaxation;
+
+    float artificialPressureK;
+
+    float artificialPressureN;
+
+    float vorticityEpsilon;
+
+    float viscosityCoeff;
+
+} Parameters;
+
+/*******************************************************************************
+ * Spatial grid helpers
+ ******************************************************************************/
+
+/**
+ * Linearizes the cell subscript (i, j, k)
+ */
+int sub2ind(int i, int j, int k, int cellsX, int cellsY)
+{
+    return i + (j * cellsX) + (k * cellsX * cellsY);
+}
+
+/**
+ * Finds the (clamped) subscript of the grid cell containing p, using the same
+ * discretization as the discretizeParticlePositions kernel
+ */
+int3 cellOf(float3 p
+           ,int3 cells
+           ,float3 minExt
+           ,float3 maxExt)
+{
+    float3 cellSize = (maxExt - minExt) / convert_float3(cells);
+    int3 cell       = convert_int3(floor((p - minExt) / cellSize));
+
+    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));
+}
+
+/*******************************************************************************
+ * Neighbor stencils
+ *
+ * A neighbor loop visits the cells of the block starting at
+ * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping
+ * the cells rejected by stencilCellVisible():
+ *
+ *   int3 span  = (int3)(0, 0, 0);
+ *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);
+ *
+ *   for (int k = first.z; k < first.z + span.z; k++)
+ *     for (int j = first.y; j < first.y + span.y; j++)
+ *       for (int i = first.x; i < first.x + span.x; i++)
+ *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))
+ *           ... particles of cell (i, j, k) ...
+ *
+ * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the
+ * block only covers the cells the particle's h-ball touches, which is one
+ * or two cells per axis once cells are at least 2h wide; the solver sizes
+ * its grid that way while the stencil is selected. A program whose
+ * neighbor loops go through these helpers says so by putting
+ * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel
+ * it declares, so a stencil nothing runs isn't reported as active
+ ******************************************************************************/
+
+#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }
+
+/**
+ * Returns the lowest subscript of the block of cells that can hold neighbors
+ * of the particle at p, in cell, and the block's width per axis in span.
+ * The cells the particle's h-ball touches run from floor((p - h) / cellSize)
+ * to floor((p + h) / cellSize) on each axis, which is within one cell of
+ * the particle's own if cells are at least h wide; the block is exactly
+ * that range. Otherwise (cells compressed below h, or particles outside
+ * the grid) the full 3x3x3 block around the cell is used
+ */
+int3 neighborStencilOrigin(float3 p
+                          ,int3 cell
+                          ,float3 minExt
+                          ,float3 cellSize
+                          ,float h
+                          ,int3* span)
+{
+#ifdef PBF_HALF_CELL_STENCIL
+
+    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {
+
+        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));
+        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));
+
+        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {
+            *span = hi - lo + (int3)(1, 1, 1);
+            return lo;
+        }
+    }
+
+#endif
+
+    *span = (int3)(3, 3, 3);
+
+    return cell - (int3)(1, 1, 1);
+}
+
+/**
+ * Squared distance from p to the box of cell c
+ */
+float cellDistance2(float3 p
+                   ,int3 c
+                   ,float3 minExt
+                   ,float3 cellSize)
+{
+    float3 lo = minExt + (convert_float3(c) * cellSize);
+    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));
+
+    return dot(d, d);
+}
+
+/**
+ * Tests if cell c is in the grid and its box comes within h of p; cells
+ * that fail can be skipped without reading any of their particles
+ */
+bool stencilCellVisible(float3 p
+                       ,int3 c
+                       ,int3 cells
+                       ,float3 minExt
+                       ,float3 cellSize
+                       ,float h)
+{
+    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {
+        return false;
+    }
+
+    return cellDistance2(p, c, minExt, cellSize) < (h * h);
+}
+
+/*******************************************************************************
+ * SPH smoothing kernels
+ ******************************************************************************/
+
+/**
+ * Poly6 smoothing kernel, taking the squared distance r^2
+ */
+float poly6(float r2, float h)
+{
+    float h2 = h * h;
+
+    if (r2 >= h2) {
+        return 0.0f;
+    }
+
+    float x = h2 - r2;
+
+    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;
+}
+
+/**
+ * Gradient of the spiky smoothing kernel with respect to r
+ */
+float3 spikyGradient(float3 r, float h)
+{
+    float rLen = length(r);
+
+    if (rLen <= 0.0f || rLen >= h) {
+        return (float3)(0.0f, 0.0f, 0.0f);
+    }
+
+    float x = h - rLen;
+
+    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);
+}
+
+/*******************************************************************************
+ * Geometry helpers
+ ******************************************************************************/
+
+/**
+ * Returns the point on triangle (a, b, c) closest to p. See "Real-Time
+ * Collision Detection" (Ericson, 2005), section 5.1.5
+ */
+float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)
+{
+    float3 ab = b - a;
+    float3 ac = c - a;
+    float3 ap = p - a;
+
+    float d1 = dot(ab, ap);
+    float d2 = dot(ac, ap);
+
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return a;
+    }
+
+    float3 bp = p - b;
+    float d3  = dot(ab, bp);
+    float d4  = dot(ac, bp);
+
+    if (d3 >= 0.0f && d4 <= d3) {
+        return b;
+    }
+
+    float vc = (d1 * d4) - (d3 * d2);
+
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ((d1 / (d1 - d3)) * ab);
+    }
+
+    float3 cp = p - c;
+    float d5  = dot(ab, cp);
+    float d6  = dot(ac, cp);
+
+    if (d6 >= 0.0f && d5 <= d6) {
+        return c;
+    }
+
+    float vb = (d5 * d2) - (d1 * d6);
+
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ((d2 / (d2 - d6)) * ac);
+    }
+
+    float va = (d3 * d6) - (d5 * d4);
+
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+
+    return a + (ab * (vb * denom)) + (ac * (vc * denom));
+}
+
+/**
+ * Transforms the point p by the row-major affine matrix m, using the same
+ * row-vector convention as ofMatrix4x4 (p' = p * m)
+ */
+float3 transformPoint(float16 m, float3 p)
+{
+    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;
+}
+
+/**
+ * Transforms the direction d by the linear part of m
+ */
+float3 transformDirection(float16 m, float3 d)
+{
+    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);
+}
+
+/*******************************************************************************
+ * External force fields
+ *
+ * Analytic descriptors of the external forces acting on the fluid, passed to
+ * kernels in a small constant buffer and evaluated per particle where the
+ * positions are predicted (see kernels/Forces.cl). These must match
+ * pbf::ForceField in ForceFields.h
+ ******************************************************************************/
+
+#define FORCE_GRAVITY   0  // strength * direction, everywhere
+#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),
+                           // at rate strength
+#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)
+#define FORCE_VORTEX    3  // Around the axis direction through position
+#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent
+
+typedef struct {
+
+    float4 position;   // Point or box center
+
+    float4 direction;  // Direction, axis or velocity, by type
+
+    float4 extent;     // Box half-extents (FORCE_DRAG)
+
+    int type;          // FORCE_*
+
+    float strength;
+
+    float radius;      // Falloff radius of attractors, vortices and wind;
+                       // <= 0 for no falloff
+
+    int __padding;
+
+} ForceField;
+
+/**
+ * Linear falloff of a field with distance d: 1 at the source, 0 at radius
+ * and beyond; 1 everywhere if radius <= 0
+ */
+float forceFalloff(float d, float radius)
+{
+    return radius > 0.0f ? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;
+}
+
+/**
+ * Sums the acceleration of numFields force fields on a particle at p moving
+ * at velocity v
+ */
+float3 evaluateForceFields(constant ForceField* fields
+                          ,int numFields
+                          ,float3 p
+                          ,float3 v)
+{
+    float3 a = (float3)(0.0f, 0.0f, 0.0f);
+
+    for (int i = 0; i < numFields; i++) {
+
+        ForceField f = fields[i];
+
+        float3 r = f.position.xyz - p;
+        float d  = length(r);
+
+        switch (f.type) {
+
+            case FORCE_GRAVITY:
+                a += f.strength * f.direction.xyz;
+                break;
+
+            case FORCE_WIND:
+                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);
+                break;
+
+            case FORCE_ATTRACTOR:
+                if (d > 0.0f) {
+                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;
+                }
+                break;
+
+            case FORCE_VORTEX:
+                {
+                    float3 axis  = normalize(f.direction.xyz);
+                    float3 perp  = r - (dot(r, axis) * axis);
+                    float dPerp  = length(perp);
+
+                    if (dPerp > 0.0f) {
+                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);
+                    }
+                }
+                break;
+
+            case FORCE_DRAG:
+                if (all(isless(fabs(r), f.extent.xyz))) {
+                    a -= f.strength * v;
+                }
+                break;
+        }
+    }
+
+    return a;
+}
+
+#endif
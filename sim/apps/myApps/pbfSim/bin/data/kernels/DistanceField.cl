@@ -0,0 +1,203 @@
+/*******************************************************************************
+ * DistanceField.cl
+ * - Kernels used to build narrow band signed distance fields from triangle
+ *   soups, and to push particles out of colliders represented by them
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "kernels/Common.cl"
+
+/******************************************************************************/
+
+// Distance fields are stored as one int per voxel, so they can be built with
+// atomic_min: the upper bits hold the distance to the surface, quantized
+// over [0, band], and the lowest bit is set if the voxel lies behind the
+// closest triangle (i.e. inside the collider). Voxels outside of the band
+// keep the value EMPTY_VOXEL
+#define EMPTY_VOXEL   0x7FFFFFFF
+#define DISTANCE_BITS 29
+
+/**
+ * Encodes a distance d in [0, band] and an inside flag into a voxel value
+ */
+int encodeDistance(float d, float band, bool inside)
+{
+    int q = convert_int_rtz(clamp(d / band, 0.0f, 1.0f) * (float)(1 << DISTANCE_BITS));
+
+    return (q << 1) | (inside ? 1 : 0);
+}
+
+/**
+ * Decodes a voxel value into a signed distance (negative inside)
+ */
+float decodeDistance(int v, float band)
+{
+    if (v == EMPTY_VOXEL) {
+        return band;
+    }
+
+    float d = ((float)(v >> 1) / (float)(1 << DISTANCE_BITS)) * band;
+
+    return (v & 1) ? -d : d;
+}
+
+/**
+ * Fetches the signed distance stored in voxel (x,y,z), clamping to the field
+ */
+float fetchDistance(global const int* field, int4 dims, int x, int y, int z, float band)
+{
+    x = clamp(x, 0, dims.x - 1);
+    y = clamp(y, 0, dims.y - 1);
+    z = clamp(z, 0, dims.z - 1);
+
+    return decodeDistance(field[sub2ind(x, y, z, dims.x, dims.y)], band);
+}
+
+/*******************************************************************************
+ * Kernels
+ ******************************************************************************/
+
+/**
+ * Marks every voxel of the field as empty
+ *
+ * Run 1D over the number of voxels in the field
+ */
+kernel void clearDistanceField(global int* field)
+{
+    field[get_global_id(0)] = EMPTY_VOXEL;
+}
+
+/**
+ * Writes the distance to a single triangle into every voxel within band of
+ * it, keeping the smallest distance per voxel. Voxel (x,y,z) is centered at
+ * fieldOrigin + ((x,y,z) + 0.5) * voxelSize
+ *
+ * Run 1D over the number of triangles
+ */
+kernel void splatTriangleDistances(global const float4* vertices
+                                  ,global const int* indices
+                                  ,int numTriangles
+                                  ,float4 fieldOrigin
+                                  ,float voxelSize
+                                  ,int4 dims
+                                  ,float band
+                                  ,global int* field)
+{
+    int id = get_global_id(0);
+
+    if (id >= numTriangles) {
+        return;
+    }
+
+    float3 a = vertices[indices[(3 * id) + 0]].xyz;
+    float3 b = vertices[indices[(3 * id) + 1]].xyz;
+    float3 c = vertices[indices[(3 * id) + 2]].xyz;
+    float3 n = cross(b - a, c - a);
+
+    // Voxel range covered by the triangle's bounding box grown by the band:
+
+    float3 lo = fmin(a, fmin(b, c)) - (float3)(band, band, band);
+    float3 hi = fmax(a, fmax(b, c)) + (float3)(band, band, band);
+
+    int3 vLo = max(convert_int3(floor((lo - fieldOrigin.xyz) / voxelSize - 0.5f)), (int3)(0, 0, 0));
+    int3 vHi = min(convert_int3(ceil((hi - fieldOrigin.xyz) / voxelSize - 0.5f)), dims.xyz - (int3)(1, 1, 1));
+
+    for (int z = vLo.z; z <= vHi.z; z++) {
+        for (int y = vLo.y; y <= vHi.y; y++) {
+            for (int x = vLo.x; x <= vHi.x; x++) {
+
+                float3 p  = fieldOrigin.xyz + ((float3)(x, y, z) + 0.5f) * voxelSize;
+                float3 q  = closestPointOnTriangle(p, a, b, c);
+                float  d  = distance(p, q);
+
+                if (d > band) {
+                    continue;
+                }
+
+                atomic_min(&field[sub2ind(x, y, z, dims.x, dims.y)]
+                          ,encodeDistance(d, band, dot(p - q, n) < 0.0f));
+            }
+        }
+    }
+}
+
+/**
+ * Pushes the predicted position of every particle that penetrates the
+ * collider back to its surface. The particle is taken into field space by
+ * worldToField, where the distance and its gradient are interpolated
+ * trilinearly from the 8 surrounding voxels; fieldScale converts field
+ * space distances to world units
+ *
+ * Run 1D over the number of particles
+ */
+kernel void resolveDistanceField(global const Parameters* parameters
+                                ,global Particle* particles
+                                ,int numParticles
+                                ,global const int* field
+                                ,float4 fieldOrigin
+                                ,float voxelSize
+                                ,int4 dims
+                                ,float band
+                                ,float16 worldToField
+                                ,float16 fieldToWorld
+                                ,float fieldScale)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    float  radius = parameters->particleRadius;
+    float3 p      = transformPoint(worldToField, particles[id].posStar.xyz);
+
+    // Continuous voxel coordinates; voxel centers sit at integer values:
+
+    float3 g  = ((p - fieldOrigin.xyz) / voxelSize) - 0.5f;
+    float3 gf = floor(g);
+    int3   v  = convert_int3(gf);
+    float3 t  = g - gf;
+
+    if (any(v < (int3)(-1, -1, -1)) || any(v >= dims.xyz)) {
+        return;
+    }
+
+    float d000 = fetchDistance(field, dims, v.x,     v.y,     v.z,     band);
+    float d100 = fetchDistance(field, dims, v.x + 1, v.y,     v.z,     band);
+    float d010 = fetchDistance(field, dims, v.x,     v.y + 1, v.z,     band);
+    float d110 = fetchDistance(field, dims, v.x + 1, v.y + 1, v.z,     band);
+    float d001 = fetchDistance(field, dims, v.x,     v.y,     v.z + 1, band);
+    float d101 = fetchDistance(field, dims, v.x + 1, v.y,     v.z + 1, band);
+    float d011 = fetchDistance(field, dims, v.x,     v.y + 1, v.z + 1, band);
+    float d111 = fetchDistance(field, dims, v.x + 1, v.y + 1, v.z + 1, band);
+
+    float d00 = mix(d000, d100, t.x);
+    float d10 = mix(d010, d110, t.x);
+    float d01 = mix(d001, d101, t.x);
+    float d11 = mix(d011, d111, t.x);
+    float d0  = mix(d00, d10, t.y);
+    float d1  = mix(d01, d11, t.y);
+    float d   = mix(d0, d1, t.z) * fieldScale;
+
+    if (d >= radius) {
+        return;
+    }
+
+    // Analytic gradient of the trilinear interpolant:
+
+    float3 grad;
+    grad.x = mix(mix(d100 - d000, d110 - d010, t.y), mix(d101 - d001, d111 - d011, t.y), t.z);
+    grad.y = mix(d10 - d00, d11 - d01, t.z);
+    grad.z = d1 - d0;
+
+    float3 n = transformDirection(fieldToWorld, grad);
+    float  l = length(n);
+
+    if (l <= 0.0f) {
+        return;
+    }
+
+    particles[id].posStar.xyz += (n / l) * (radius - d);
+}
@@ -0,0 +1,48 @@
+/*******************************************************************************
+ * Forces.cl
+ * - Predicts particle positions under the analytic external force fields
+ *   (see "External force fields" in Common.cl), evaluated straight from
+ *   their constant buffer
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "kernels/Common.cl"
+
+/*******************************************************************************
+ * Kernels
+ ******************************************************************************/
+
+/**
+ * Steps (1) - (4) of the solver, in place of predictPosition: for the sum a
+ * of the force fields,
+ *
+ *   v  = v + dt * a(x, v)
+ *   x* = x + dt * v
+ *
+ * No per-particle external force is read, so the step's traffic is the
+ * particle itself
+ *
+ * Run 1D over numParticles
+ */
+kernel void predictPositionInFields(global Particle* particles
+                                   ,int numParticles
+                                   ,float dt
+                                   ,constant ForceField* fields
+                                   ,int numFields)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    float3 x = particles[id].pos.xyz;
+    float3 v = particles[id].vel.xyz;
+
+    v += dt * evaluateForceFields(fields, numFields, x, v);
+
+    particles[id].vel.xyz     = v;
+    particles[id].posStar.xyz = x + (dt * v);
+}
@@ -0,0 +1,606 @@
+/*******************************************************************************
+ * MeshCollision.cl
+ * - Kernels used to build and refit a linear bounding volume hierarchy (LBVH)
+ *   over a triangle mesh, and to collide swept particles against it
+ *
+ *   The hierarchy is built following "Maximizing Parallelism in the
+ *   Construction of BVHs, Octrees, and k-d Trees" (Karras, 2012): triangles
+ *   are sorted by the Morton code of their centroids, after which every
+ *   internal node can be emitted independently
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "kernels/Common.cl"
+
+/******************************************************************************/
+
+// Maximum depth of the traversal stack used per particle. Subtrees that
+// don't fit are tested leaf by leaf instead (see sweepParticles)
+#define BVH_STACK_SIZE 64
+
+// A node of the hierarchy. For n triangles, nodes [0, n-2] are internal
+// nodes (node 0 is the root) and nodes [n-1, 2n-2] are leaves; this must
+// match BVHNode in MeshCollider.h
+typedef struct {
+
+    float4 bmin;
+
+    float4 bmax;
+
+    int left;      // Child node indices; -1 for leaves
+
+    int right;
+
+    int parent;    // -1 for the root
+
+    int triangle;  // Triangle index; -1 for internal nodes
+
+} BVHNode;
+
+/*******************************************************************************
+ * Helpers
+ ******************************************************************************/
+
+/**
+ * Spreads the lower 10 bits of v out so there are two zero bits between each
+ */
+uint expandBits(uint v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+
+    return v;
+}
+
+/**
+ * 30-bit Morton code of a point in the unit cube
+ */
+uint morton3D(float3 p)
+{
+    p = clamp(p * 1024.0f, 0.0f, 1023.0f);
+
+    return (expandBits((uint)p.x) << 2) | (expandBits((uint)p.y) << 1) | expandBits((uint)p.z);
+}
+
+/**
+ * Length of the longest common prefix of the keys of sorted leaves i and j,
+ * or -1 if j is out of range. Duplicate codes are disambiguated by index
+ */
+int commonPrefix(global const uint* codes, int n, int i, int j)
+{
+    if (j < 0 || j >= n) {
+        return -1;
+    }
+
+    uint ci = codes[i];
+    uint cj = codes[j];
+
+    if (ci == cj) {
+        return 32 + clz((uint)(i ^ j));
+    }
+
+    return clz(ci ^ cj);
+}
+
+/**
+ * Tests if the segment a + t * dir, t in [0, 1], overlaps the box
+ */
+bool segmentHitsBox(float3 a, float3 invDir, float3 bmin, float3 bmax)
+{
+    float3 t0   = (bmin - a) * invDir;
+    float3 t1   = (bmax - a) * invDir;
+    float3 tLo  = fmin(t0, t1);
+    float3 tHi  = fmax(t0, t1);
+    float  tMin = fmax(fmax(tLo.x, tLo.y), fmax(tLo.z, 0.0f));
+    float  tMax = fmin(fmin(tHi.x, tHi.y), fmin(tHi.z, 1.0f));
+
+    return tMin <= tMax;
+}
+
+/**
+ * Moller-Trumbore intersection of the segment a + t * dir, t in [0, 1], with
+ * triangle (v0, v1, v2). Returns the hit parameter t, or a value > 1 if the
+ * segment misses the triangle
+ */
+float segmentTriangle(float3 a, float3 dir, float3 v0, float3 v1, float3 v2)
+{
+    float3 e1 = v1 - v0;
+    float3 e2 = v2 - v0;
+    float3 p  = cross(dir, e2);
+    float  det = dot(e1, p);
+
+    if (fabs(det) < 1.0e-12f) {
+        return 2.0f;
+    }
+
+    float  invDet = 1.0f / det;
+    float3 s      = a - v0;
+    float  u      = dot(s, p) * invDet;
+
+    if (u < 0.0f || u > 1.0f) {
+        return 2.0f;
+    }
+
+    float3 q = cross(s, e1);
+    float  v = dot(dir, q) * invDet;
+
+    if (v < 0.0f || (u + v) > 1.0f) {
+        return 2.0f;
+    }
+
+    float t = dot(e2, q) * invDet;
+
+    return (t >= 0.0f) ? t : 2.0f;
+}
+
+/**
+ * Tests the sphere swept from a to b = a + dir against one triangle, keeping
+ * the earliest crossing (tHit, nHit) and the closest overlap at the end of
+ * the sweep (dMin, nMin)
+ */
+void sweepTriangle(float3 a
+                  ,float3 b
+                  ,float3 dir
+                  ,float3 v0
+                  ,float3 v1
+                  ,float3 v2
+                  ,float* tHit
+                  ,float3* nHit
+                  ,float* dMin
+                  ,float3* nMin)
+{
+    float3 n = normalize(cross(v1 - v0, v2 - v0));
+
+    // Crossing:
+
+    float t = segmentTriangle(a, dir, v0, v1, v2);
+
+    if (t <= 1.0f && t < *tHit) {
+        *tHit = t;
+        *nHit = (dot(a - v0, n) < 0.0f) ? -n : n;
+    }
+
+    // Overlap at the end of the sweep:
+
+    float3 q = closestPointOnTriangle(b, v0, v1, v2);
+    float3 e = b - q;
+    float  d = length(e);
+
+    if (d < *dMin) {
+        *dMin = d;
+        *nMin = (d > 1.0e-6f) ? (e / d) : ((dot(a - v0, n) < 0.0f) ? -n : n);
+    }
+}
+
+/*******************************************************************************
+ * Construction
+ ******************************************************************************/
+
+/**
+ * Applies the row-major affine transform m to the rest pose vertices
+ *
+ * Run 1D over the number of vertices
+ */
+kernel void transformVertices(global const float4* restVertices
+                             ,float16 m
+                             ,int numVertices
+                             ,global float4* vertices)
+{
+    int id = get_global_id(0);
+
+    if (id >= numVertices) {
+        return;
+    }
+
+    vertices[id] = (float4)(transformPoint(m, restVertices[id].xyz), 1.0f);
+}
+
+/**
+ * Computes the Morton code of each triangle's centroid, relative to the
+ * bounds of the mesh
+ *
+ * Run 1D over the number of triangles
+ */
+kernel void computeMortonCodes(global const float4* vertices
+                              ,global const int* indices
+                              ,int numTriangles
+                              ,float4 sceneMin
+                              ,float4 sceneInvExtent
+                              ,global uint* codes
+                              ,global int* triangleIds)
+{
+    int id = get_global_id(0);
+
+    if (id >= numTriangles) {
+        return;
+    }
+
+    float3 c = (vertices[indices[(3 * id) + 0]].xyz +
+                vertices[indices[(3 * id) + 1]].xyz +
+                vertices[indices[(3 * id) + 2]].xyz) / 3.0f;
+
+    codes[id]       = morton3D((c - sceneMin.xyz) * sceneInvExtent.xyz);
+    triangleIds[id] = id;
+}
+
+/**
+ * Radix sort, pass 1 of 2 for the given bit: flags keys whose bit is clear
+ *
+ * Run 1D over the number of keys
+ */
+kernel void radixFlags(global const uint* codes
+                      ,int bit
+                      ,int n
+                      ,global int* flags)
+{
+    int id = get_global_id(0);
+
+    if (id >= n) {
+        return;
+    }
+
+    flags[id] = ((codes[id] >> bit) & 1u) ? 0 : 1;
+}
+
+/**
+ * Radix sort, pass 2 of 2 for the given bit: a stable split of the keys (and
+ * their values) using the exclusive prefix sums of the flags. Keys with the
+ * bit clear go first, in order, followed by the keys with the bit set
+ *
+ * Run 1D over the number of keys
+ */
+kernel void radixScatter(global const uint* codesIn
+                        ,global const int* idsIn
+                        ,global const int* flags
+                        ,global const int* offsets
+                        ,int n
+                        ,global uint* codesOut
+                        ,global int* idsOut)
+{
+    int id = get_global_id(0);
+
+    if (id >= n) {
+        return;
+    }
+
+    int numClear = offsets[n - 1] + flags[n - 1];
+    int dst      = flags[id] ? offsets[id] : (numClear + id - offsets[id]);
+
+    codesOut[dst] = codesIn[id];
+    idsOut[dst]   = idsIn[id];
+}
+
+/**
+ * Initializes the leaf nodes from the sorted triangle ids
+ *
+ * Run 1D over the number of triangles
+ */
+kernel void initializeLeaves(global const int* sortedTriangleIds
+                            ,int numTriangles
+                            ,global BVHNode* nodes)
+{
+    int id = get_global_id(0);
+
+    if (id >= numTriangles) {
+        return;
+    }
+
+    int leaf = (numTriangles - 1) + id;
+
+    nodes[leaf].left     = -1;
+    nodes[leaf].right    = -1;
+    nodes[leaf].triangle = sortedTriangleIds[id];
+
+    // A single triangle forms a tree with only one (root) leaf:
+
+    if (numTriangles == 1) {
+        nodes[leaf].parent = -1;
+    }
+}
+
+/**
+ * Emits internal node i by finding the range of sorted leaves it covers and
+ * where that range splits between its two children (Karras, 2012)
+ *
+ * Run 1D over (number of triangles - 1)
+ */
+kernel void buildHierarchy(global const uint* codes
+                          ,int numTriangles
+                          ,global BVHNode* nodes)
+{
+    int i = get_global_id(0);
+    int n = numTriangles;
+
+    if (i >= (n - 1)) {
+        return;
+    }
+
+    // Direction of the range:
+
+    int d    = (commonPrefix(codes, n, i, i + 1) - commonPrefix(codes, n, i, i - 1)) >= 0 ? 1 : -1;
+    int dMin = commonPrefix(codes, n, i, i - d);
+
+    // Upper bound on the length of the range, then the exact other end:
+
+    int lMax = 2;
+    while (commonPrefix(codes, n, i, i + (lMax * d)) > dMin) {
+        lMax *= 2;
+    }
+
+    int l = 0;
+    for (int t = lMax / 2; t >= 1; t /= 2) {
+        if (commonPrefix(codes, n, i, i + ((l + t) * d)) > dMin) {
+            l += t;
+        }
+    }
+
+    int j     = i + (l * d);
+    int dNode = commonPrefix(codes, n, i, j);
+
+    // Binary search for the split position:
+
+    int s = 0;
+    for (int div = 2; ; div *= 2) {
+
+        int t = (l + div - 1) / div;
+
+        if (commonPrefix(codes, n, i, i + ((s + t) * d)) > dNode) {
+            s += t;
+        }
+
+        if (t <= 1) {
+            break;
+        }
+    }
+
+    int gamma = i + (s * d) + min(d, 0);
+    int left  = (min(i, j) == gamma)     ? (n - 1) + gamma       : gamma;
+    int right = (max(i, j) == gamma + 1) ? (n - 1) + gamma + 1   : gamma + 1;
+
+    nodes[i].left      = left;
+    nodes[i].right     = right;
+    nodes[i].triangle  = -1;
+    nodes[left].parent  = i;
+    nodes[right].parent = i;
+
+    if (i == 0) {
+        nodes[i].parent = -1;
+    }
+}
+
+/*******************************************************************************
+ * Refitting
+ ******************************************************************************/
+
+/**
+ * Clears the per-internal-node visit counters used by refitHierarchy
+ *
+ * Run 1D over (number of triangles - 1)
+ */
+kernel void resetRefitFlags(global int* flags)
+{
+    flags[get_global_id(0)] = 0;
+}
+
+/**
+ * Writes a node's bounds with atomic exchanges, and reads them back with
+ * atomic no-op ORs. The two children of a node are usually refit by
+ * different work-groups, and OpenCL 1.1 only makes plain global stores
+ * visible within a work-group; atomics on the same words are always
+ * coherent across the device, whatever caches plain loads go through
+ */
+void storeBounds(global BVHNode* node, float4 bmin, float4 bmax)
+{
+    global float* lo = (global float*)&node->bmin;
+    global float* hi = (global float*)&node->bmax;
+
+    atomic_xchg(lo + 0, bmin.x);
+    atomic_xchg(lo + 1, bmin.y);
+    atomic_xchg(lo + 2, bmin.z);
+    atomic_xchg(hi + 0, bmax.x);
+    atomic_xchg(hi + 1, bmax.y);
+    atomic_xchg(hi + 2, bmax.z);
+}
+
+void loadBounds(global BVHNode* node, float4* bmin, float4* bmax)
+{
+    volatile global int* lo = (volatile global int*)&node->bmin;
+    volatile global int* hi = (volatile global int*)&node->bmax;
+
+    *bmin = (float4)(as_float(atomic_or(lo + 0, 0))
+                    ,as_float(atomic_or(lo + 1, 0))
+                    ,as_float(atomic_or(lo + 2, 0))
+                    ,0.0f);
+    *bmax = (float4)(as_float(atomic_or(hi + 0, 0))
+                    ,as_float(atomic_or(hi + 1, 0))
+                    ,as_float(atomic_or(hi + 2, 0))
+                    ,0.0f);
+}
+
+/**
+ * Recomputes all node bounds bottom-up from the current vertex positions.
+ * Every leaf walks towards the root; at each internal node, the first child
+ * to arrive stops and the second computes the union of both children, so
+ * each node is processed exactly once, after both of its children
+ *
+ * A child's bounds are stored (see storeBounds()) and fenced before its
+ * arrival is counted on the parent's flag, and the second arrival fences
+ * again before loading both children's bounds, so it never combines a box
+ * the other work-item hasn't finished publishing
+ *
+ * Run 1D over the number of triangles
+ */
+kernel void refitHierarchy(global const float4* vertices
+                          ,global const int* indices
+                          ,int numTriangles
+                          ,float thickness
+                          ,global BVHNode* nodes
+                          ,global int* flags)
+{
+    int id = get_global_id(0);
+
+    if (id >= numTriangles) {
+        return;
+    }
+
+    int leaf = (numTriangles - 1) + id;
+    int tri  = nodes[leaf].triangle;
+
+    float3 a = vertices[indices[(3 * tri) + 0]].xyz;
+    float3 b = vertices[indices[(3 * tri) + 1]].xyz;
+    float3 c = vertices[indices[(3 * tri) + 2]].xyz;
+
+    storeBounds(&nodes[leaf]
+               ,(float4)(fmin(a, fmin(b, c)) - thickness, 0.0f)
+               ,(float4)(fmax(a, fmax(b, c)) + thickness, 0.0f));
+
+    int node = nodes[leaf].parent;
+
+    while (node != -1) {
+
+        mem_fence(CLK_GLOBAL_MEM_FENCE);
+
+        if (atomic_inc(&flags[node]) == 0) {
+            return;
+        }
+
+        mem_fence(CLK_GLOBAL_MEM_FENCE);
+
+        float4 lmin, lmax, rmin, rmax;
+
+        loadBounds(&nodes[nodes[node].left], &lmin, &lmax);
+        loadBounds(&nodes[nodes[node].right], &rmin, &rmax);
+
+        storeBounds(&nodes[node], fmin(lmin, rmin), fmax(lmax, rmax));
+
+        node = nodes[node].parent;
+    }
+}
+
+/*******************************************************************************
+ * Queries
+ ******************************************************************************/
+
+/**
+ * Sweeps every particle, as a sphere, from its current position to its
+ * predicted position and resolves collisions against the mesh:
+ *
+ * - If the swept center crosses a triangle, the predicted position is moved
+ *   back to the earliest crossing, offset by the sphere radius on the side the
+ *   particle came from. This keeps particles from tunneling through thin
+ *   geometry regardless of their speed
+ *
+ * - Otherwise, if the sphere at its predicted position overlaps a triangle,
+ *   it is pushed out along the direction to the closest point
+ *
+ * If the traversal stack is full, the children of a node aren't pushed;
+ * every leaf under the node is tested instead. A node's leaves are
+ * contiguous in Morton order, from its leftmost to its rightmost leaf, so
+ * nothing is skipped however deep the hierarchy gets
+ *
+ * Run 1D over the number of particles
+ */
+kernel void sweepParticles(global const Parameters* parameters
+                          ,global Particle* particles
+                          ,int numParticles
+                          ,global const float4* vertices
+                          ,global const int* indices
+                          ,global const BVHNode* nodes
+                          ,float thickness)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    float  r   = parameters->particleRadius + thickness;
+    float3 a   = particles[id].pos.xyz;
+    float3 b   = particles[id].posStar.xyz;
+    float3 dir = b - a;
+
+    float3 safeDir = select(dir, (float3)(1.0e-12f, 1.0e-12f, 1.0e-12f), isless(fabs(dir), (float3)(1.0e-12f, 1.0e-12f, 1.0e-12f)));
+    float3 invDir  = 1.0f / safeDir;
+
+    float  tHit    = 2.0f;
+    float3 nHit    = (float3)(0.0f, 0.0f, 0.0f);
+    float  dMin    = r;
+    float3 nMin    = (float3)(0.0f, 0.0f, 0.0f);
+
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+
+    stack[top++] = 0;
+
+    while (top > 0) {
+
+        int node = stack[--top];
+
+        // Node boxes are grown by the particle radius, so overlap tests
+        // against the swept sphere reduce to tests against its center:
+
+        float3 bmin = nodes[node].bmin.xyz - parameters->particleRadius;
+        float3 bmax = nodes[node].bmax.xyz + parameters->particleRadius;
+
+        if (!segmentHitsBox(a, invDir, bmin, bmax)) {
+            continue;
+        }
+
+        int tri = nodes[node].triangle;
+
+        if (tri != -1) {
+            sweepTriangle(a, b, dir
+                         ,vertices[indices[(3 * tri) + 0]].xyz
+                         ,vertices[indices[(3 * tri) + 1]].xyz
+                         ,vertices[indices[(3 * tri) + 2]].xyz
+                         ,&tHit, &nHit, &dMin, &nMin);
+            continue;
+        }
+
+        if (top <= (BVH_STACK_SIZE - 2)) {
+            stack[top++] = nodes[node].left;
+            stack[top++] = nodes[node].right;
+            continue;
+        }
+
+        // The stack is full: test the node's leaves one by one
+
+        int first = node;
+        int last  = node;
+
+        while (nodes[first].triangle == -1) {
+            first = nodes[first].left;
+        }
+
+        while (nodes[last].triangle == -1) {
+            last = nodes[last].right;
+        }
+
+        for (int leaf = first; leaf <= last; leaf++) {
+
+            if (!segmentHitsBox(a, invDir
+                               ,nodes[leaf].bmin.xyz - parameters->particleRadius
+                               ,nodes[leaf].bmax.xyz + parameters->particleRadius)) {
+                continue;
+            }
+
+            int t = nodes[leaf].triangle;
+
+            sweepTriangle(a, b, dir
+                         ,vertices[indices[(3 * t) + 0]].xyz
+                         ,vertices[indices[(3 * t) + 1]].xyz
+                         ,vertices[indices[(3 * t) + 2]].xyz
+                         ,&tHit, &nHit, &dMin, &nMin);
+        }
+    }
+
+    if (tHit <= 1.0f) {
+        particles[id].posStar.xyz = a + (tHit * dir) + (nHit * r);
+    } else if (dMin < r) {
+        particles[id].posStar.xyz = b + (nMin * (r - dMin));
+    }
+}
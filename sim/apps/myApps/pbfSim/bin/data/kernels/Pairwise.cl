@@ -0,0 +1,535 @@
+/*******************************************************************************
+ * Pairwise.cl
+ * - Symmetric evaluation of the SPH density estimate: every pair of
+ *   neighboring particles is visited once, through a half-shell stencil of
+ *   cells, and its kernel value is added to both particles. Used in place of
+ *   the gather-based estimateDensity kernel by pbf::PairwiseDensity.
+ *   Particles can be reordered by their number of pair candidates first, so
+ *   SIMD lanes run loops of similar length, and neighbors can be read from
+ *   an image mirroring the sorted positions, through the texture cache
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "kernels/Common.cl"
+
+/*******************************************************************************
+ * Half-shell stencil
+ ******************************************************************************/
+
+/**
+ * The 13 neighbors of a cell that come after it in (z, y, x) order. Pairs in
+ * a cell and the cells of its half shell cover every pair of particles in
+ * adjacent cells exactly once
+ */
+constant int HALF_SHELL[13][3] = {
+    {  1,  0,  0 },
+    { -1,  1,  0 }, {  0,  1,  0 }, {  1,  1,  0 },
+    { -1, -1,  1 }, {  0, -1,  1 }, {  1, -1,  1 },
+    { -1,  0,  1 }, {  0,  0,  1 }, {  1,  0,  1 },
+    { -1,  1,  1 }, {  0,  1,  1 }, {  1,  1,  1 }
+};
+
+/**
+ * Cells of the same color are at least 3 cells apart in x and y and 2 in z,
+ * so the cells they and their half shells write to never overlap (the half
+ * shell spans -1..1 in x and y, and 0..1 in z)
+ */
+#define COLORS_X 3
+#define COLORS_Y 3
+#define COLORS_Z 2
+
+/**
+ * Balanced runs bin particles by their number of pair candidates, in bins
+ * PAIR_BIN_WIDTH candidates wide, the last one open ended; these must match
+ * PairwiseDensity::BINS and BIN_WIDTH
+ */
+#define PAIR_BINS      16
+#define PAIR_BIN_WIDTH 8
+
+/**
+ * Reads of the sorted position image (see mirrorSortedPositions): texel s,
+ * counting along rows, holds the predicted position of sorted particle s,
+ * and its particle index in w
+ */
+const sampler_t NEIGHBOR_SAMPLER = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_NONE | CLK_FILTER_NEAREST;
+
+float4 readSorted(read_only image2d_t positions, int s)
+{
+    int width = get_image_width(positions);
+
+    return read_imagef(positions, NEIGHBOR_SAMPLER, (int2)(s % width, s / width));
+}
+
+/**
+ * Adds value to a float in global memory, atomically
+ */
+void atomicAddFloat(volatile global float* address, float value)
+{
+    union { unsigned int u; float f; } expected, next;
+
+    do {
+        expected.f = *address;
+        next.f     = expected.f + value;
+    } while (atomic_cmpxchg((volatile global unsigned int*)address, expected.u, next.u) != expected.u);
+}
+
+/**
+ * The work of the sorted particle s: pairs with the particles after it in
+ * its own cell, plus all pairs with the particles of its cell's half shell
+ */
+int pairCandidates(int s
+                  ,global const ParticlePosition* sortedParticleToCell
+                  ,global const GridCellOffset* gridCellOffsets
+                  ,int3 cells)
+{
+    ParticlePosition pp = sortedParticleToCell[s];
+
+    int3 cell = (int3)(pp.cellI, pp.cellJ, pp.cellK);
+
+    GridCellOffset own = gridCellOffsets[sub2ind(cell.x, cell.y, cell.z, cells.x, cells.y)];
+
+    int candidates = (own.start + own.length) - (s + 1);
+
+    for (int n = 0; n < 13; n++) {
+
+        int3 c = cell + (int3)(HALF_SHELL[n][0], HALF_SHELL[n][1], HALF_SHELL[n][2]);
+
+        if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {
+            continue;
+        }
+
+        GridCellOffset offset = gridCellOffsets[sub2ind(c.x, c.y, c.z, cells.x, cells.y)];
+
+        if (offset.start != -1) {
+            candidates += offset.length;
+        }
+    }
+
+    return candidates;
+}
+
+/**
+ * Adds the pairs of the sorted particle s to the densities of both
+ * particles; see accumulateDensityPairs
+ */
+void accumulateParticlePairs(int s
+                            ,float h
+                            ,global const Particle* particles
+                            ,global const ParticlePosition* sortedParticleToCell
+                            ,global const GridCellOffset* gridCellOffsets
+                            ,int3 cells
+                            ,volatile global float* density)
+{
+    ParticlePosition pp = sortedParticleToCell[s];
+
+    float3 p  = particles[pp.particleIndex].posStar.xyz;
+    float sum = 0.0f;
+    int3 cell = (int3)(pp.cellI, pp.cellJ, pp.cellK);
+
+    GridCellOffset own = gridCellOffsets[sub2ind(cell.x, cell.y, cell.z, cells.x, cells.y)];
+
+    for (int t = s + 1; t < (own.start + own.length); t++) {
+
+        int other = sortedParticleToCell[t].particleIndex;
+        float3 r  = p - particles[other].posStar.xyz;
+        float W   = poly6(dot(r, r), h);
+
+        if (W > 0.0f) {
+            sum += W;
+            atomicAddFloat(&density[other], W);
+        }
+    }
+
+    for (int n = 0; n < 13; n++) {
+
+        int3 c = cell + (int3)(HALF_SHELL[n][0], HALF_SHELL[n][1], HALF_SHELL[n][2]);
+
+        if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {
+            continue;
+        }
+
+        GridCellOffset offset = gridCellOffsets[sub2ind(c.x, c.y, c.z, cells.x, cells.y)];
+
+        if (offset.start == -1) {
+            continue;
+        }
+
+        for (int t = offset.start; t < (offset.start + offset.length); t++) {
+
+            int other = sortedParticleToCell[t].particleIndex;
+            float3 r  = p - particles[other].posStar.xyz;
+            float W   = poly6(dot(r, r), h);
+
+            if (W > 0.0f) {
+                sum += W;
+                atomicAddFloat(&density[other], W);
+            }
+        }
+    }
+
+    atomicAddFloat(&density[pp.particleIndex], sum);
+}
+
+/**
+ * Like accumulateParticlePairs, but positions and particle indices of the
+ * sorted particles are read from the sorted position image
+ */
+void accumulateParticlePairsImage(int s
+                                 ,float h
+                                 ,global const ParticlePosition* sortedParticleToCell
+                                 ,global const GridCellOffset* gridCellOffsets
+                                 ,int3 cells
+                                 ,read_only image2d_t positions
+                                 ,volatile global float* density)
+{
+    ParticlePosition pp = sortedParticleToCell[s];
+
+    float3 p  = readSorted(positions, s).xyz;
+    float sum = 0.0f;
+    int3 cell = (int3)(pp.cellI, pp.cellJ, pp.cellK);
+
+    GridCellOffset own = gridCellOffsets[sub2ind(cell.x, cell.y, cell.z, cells.x, cells.y)];
+
+    for (int t = s + 1; t < (own.start + own.length); t++) {
+
+        float4 q = readSorted(positions, t);
+        float3 r = p - q.xyz;
+        float W  = poly6(dot(r, r), h);
+
+        if (W > 0.0f) {
+            sum += W;
+            atomicAddFloat(&density[(int)q.w], W);
+        }
+    }
+
+    for (int n = 0; n < 13; n++) {
+
+        int3 c = cell + (int3)(HALF_SHELL[n][0], HALF_SHELL[n][1], HALF_SHELL[n][2]);
+
+        if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {
+            continue;
+        }
+
+        GridCellOffset offset = gridCellOffsets[sub2ind(c.x, c.y, c.z, cells.x, cells.y)];
+
+        if (offset.start == -1) {
+            continue;
+        }
+
+        for (int t = offset.start; t < (offset.start + offset.length); t++) {
+
+            float4 q = readSorted(positions, t);
+            float3 r = p - q.xyz;
+            float W  = poly6(dot(r, r), h);
+
+            if (W > 0.0f) {
+                sum += W;
+                atomicAddFloat(&density[(int)q.w], W);
+            }
+        }
+    }
+
+    atomicAddFloat(&density[pp.particleIndex], sum);
+}
+
+/*******************************************************************************
+ * Kernels
+ ******************************************************************************/
+
+/**
+ * Starts every particle's density at its own contribution, W(0, h)
+ *
+ * Run 1D over numParticles
+ */
+kernel void resetPairDensity(global const Parameters* parameters
+                            ,int numParticles
+                            ,global float* density)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    density[id] = poly6(0.0f, parameters->smoothingRadius);
+}
+
+/**
+ * Bins a sorted particle by its number of pair candidates, counting the
+ * particles per bin. binCounts must be zero (see scanPairBins)
+ *
+ * Run 1D over numParticles
+ */
+kernel void countPairCandidates(global const ParticlePosition* sortedParticleToCell
+                               ,global const GridCellOffset* gridCellOffsets
+                               ,int numParticles
+                               ,int cellsX
+                               ,int cellsY
+                               ,int cellsZ
+                               ,global int* particleBin
+                               ,volatile global int* binCounts)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    int candidates = pairCandidates(id, sortedParticleToCell, gridCellOffsets, (int3)(cellsX, cellsY, cellsZ));
+    int bin        = min(candidates / PAIR_BIN_WIDTH, PAIR_BINS - 1);
+
+    particleBin[id] = bin;
+
+    atomic_inc(&binCounts[bin]);
+}
+
+/**
+ * Turns the bin counts into the offsets each bin starts at in the work
+ * list, heaviest bin first, so the longest runs start earliest. Clears the
+ * counts for the next step
+ *
+ * Run with a single work-item
+ */
+kernel void scanPairBins(global int* binCounts
+                        ,global int* binCursors)
+{
+    int offset = 0;
+
+    for (int bin = PAIR_BINS - 1; bin >= 0; bin--) {
+        binCursors[bin] = offset;
+        offset         += binCounts[bin];
+        binCounts[bin]  = 0;
+    }
+}
+
+/**
+ * Writes every sorted particle into the work list range of its bin. Order
+ * within a bin is arbitrary
+ *
+ * Run 1D over numParticles
+ */
+kernel void scatterPairWork(global const int* particleBin
+                           ,int numParticles
+                           ,volatile global int* binCursors
+                           ,global int* workList)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    workList[atomic_inc(&binCursors[particleBin[id]])] = id;
+}
+
+/**
+ * Adds the pairs of one particle to the densities of both particles: the
+ * particles after it in its own cell, and all particles of its cell's half
+ * shell. The particle's own sum is added once at the end; its partners' are
+ * added atomically, as other work-items add to them too
+ *
+ * Run 1D over numParticles, in sorted order
+ */
+kernel void accumulateDensityPairs(global const Parameters* parameters
+                                  ,global const Particle* particles
+                                  ,global const ParticlePosition* sortedParticleToCell
+                                  ,global const GridCellOffset* gridCellOffsets
+                                  ,int numParticles
+                                  ,int cellsX
+                                  ,int cellsY
+                                  ,int cellsZ
+                                  ,volatile global float* density)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    accumulateParticlePairs(id
+                           ,parameters->smoothingRadius
+                           ,particles
+                           ,sortedParticleToCell
+                           ,gridCellOffsets
+                           ,(int3)(cellsX, cellsY, cellsZ)
+                           ,density);
+}
+
+/**
+ * Like accumulateDensityPairs, but work-item i handles the sorted particle
+ * workList[i] (see scatterPairWork), so the particles sharing SIMD lanes
+ * have similar numbers of candidates
+ *
+ * Run 1D over numParticles
+ */
+kernel void accumulateDensityPairsBalanced(global const Parameters* parameters
+                                          ,global const Particle* particles
+                                          ,global const ParticlePosition* sortedParticleToCell
+                                          ,global const GridCellOffset* gridCellOffsets
+                                          ,int numParticles
+                                          ,int cellsX
+                                          ,int cellsY
+                                          ,int cellsZ
+                                          ,global const int* workList
+                                          ,volatile global float* density)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    accumulateParticlePairs(workList[id]
+                           ,parameters->smoothingRadius
+                           ,particles
+                           ,sortedParticleToCell
+                           ,gridCellOffsets
+                           ,(int3)(cellsX, cellsY, cellsZ)
+                           ,density);
+}
+
+/**
+ * Copies the predicted position of every particle, in sorted order, into
+ * the sorted position image, with the particle index in w (exact up to
+ * 2^24 particles)
+ *
+ * Run 1D over numParticles
+ */
+kernel void mirrorSortedPositions(global const Particle* particles
+                                 ,global const ParticlePosition* sortedParticleToCell
+                                 ,int numParticles
+                                 ,write_only image2d_t positions)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    int index = sortedParticleToCell[id].particleIndex;
+    int width = get_image_width(positions);
+
+    write_imagef(positions
+                ,(int2)(id % width, id / width)
+                ,(float4)(particles[index].posStar.xyz, (float)index));
+}
+
+/**
+ * Like accumulateDensityPairs, reading the sorted particles through the
+ * sorted position image. If workList is given (balanced runs), work-item i
+ * handles the sorted particle workList[i]
+ *
+ * Run 1D over numParticles, after mirrorSortedPositions
+ */
+kernel void accumulateDensityPairsImage(global const Parameters* parameters
+                                       ,global const ParticlePosition* sortedParticleToCell
+                                       ,global const GridCellOffset* gridCellOffsets
+                                       ,int numParticles
+                                       ,int cellsX
+                                       ,int cellsY
+                                       ,int cellsZ
+                                       ,read_only image2d_t positions
+                                       ,global const int* workList
+                                       ,volatile global float* density)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    accumulateParticlePairsImage(workList != 0 ? workList[id] : id
+                                ,parameters->smoothingRadius
+                                ,sortedParticleToCell
+                                ,gridCellOffsets
+                                ,(int3)(cellsX, cellsY, cellsZ)
+                                ,positions
+                                ,density);
+}
+
+/**
+ * Like accumulateDensityPairs, but one work-item handles all pairs of one
+ * cell of the given color, with plain stores: no other work-item of the
+ * launch writes to the same particles. Meant for CPU devices, where the
+ * atomics cost more than the extra launches. Run once per color
+ *
+ * Run 1D over the number of cells of the color (see
+ * PairwiseDensity::cellsOfColor)
+ */
+kernel void accumulateDensityPairsColored(global const Parameters* parameters
+                                         ,global const Particle* particles
+                                         ,global const ParticlePosition* sortedParticleToCell
+                                         ,global const GridCellOffset* gridCellOffsets
+                                         ,int cellsX
+                                         ,int cellsY
+                                         ,int cellsZ
+                                         ,int4 color
+                                         ,global float* density)
+{
+    int id = get_global_id(0);
+
+    // Cells of this color per axis:
+
+    int nx = (cellsX - color.x + COLORS_X - 1) / COLORS_X;
+    int ny = (cellsY - color.y + COLORS_Y - 1) / COLORS_Y;
+    int nz = (cellsZ - color.z + COLORS_Z - 1) / COLORS_Z;
+
+    if (id >= nx * ny * nz) {
+        return;
+    }
+
+    int3 cell  = (int3)(color.x + ((id % nx) * COLORS_X)
+                       ,color.y + (((id / nx) % ny) * COLORS_Y)
+                       ,color.z + ((id / (nx * ny)) * COLORS_Z));
+    int3 cells = (int3)(cellsX, cellsY, cellsZ);
+    float h    = parameters->smoothingRadius;
+
+    GridCellOffset own = gridCellOffsets[sub2ind(cell.x, cell.y, cell.z, cellsX, cellsY)];
+
+    if (own.start == -1) {
+        return;
+    }
+
+    for (int a = own.start; a < (own.start + own.length); a++) {
+
+        int self = sortedParticleToCell[a].particleIndex;
+        float3 p = particles[self].posStar.xyz;
+
+        for (int s = a + 1; s < (own.start + own.length); s++) {
+
+            int other = sortedParticleToCell[s].particleIndex;
+            float3 r  = p - particles[other].posStar.xyz;
+            float W   = poly6(dot(r, r), h);
+
+            density[self]  += W;
+            density[other] += W;
+        }
+
+        for (int n = 0; n < 13; n++) {
+
+            int3 c = cell + (int3)(HALF_SHELL[n][0], HALF_SHELL[n][1], HALF_SHELL[n][2]);
+
+            if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {
+                continue;
+            }
+
+            GridCellOffset offset = gridCellOffsets[sub2ind(c.x, c.y, c.z, cellsX, cellsY)];
+
+            if (offset.start == -1) {
+                continue;
+            }
+
+            for (int s = offset.start; s < (offset.start + offset.length); s++) {
+
+                int other = sortedParticleToCell[s].particleIndex;
+                float3 r  = p - particles[other].posStar.xyz;
+                float W   = poly6(dot(r, r), h);
+
+                density[self]  += W;
+                density[other] += W;
+            }
+        }
+    }
+}
@@ -0,0 +1,239 @@
+/*******************************************************************************
+ * Query.cl
+ * - Batched spatial queries on the sorted grid of the last step: the
+ *   particles in spheres or boxes, as compacted lists of particle indices,
+ *   and SPH estimates of density and velocity at probe points. Used by
+ *   pbf::SpatialQueries
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "kernels/Common.cl"
+
+/******************************************************************************/
+
+// Kinds of query; these must match pbf::SpatialQueryType
+#define QUERY_SPHERE 0
+#define QUERY_BOX    1
+#define QUERY_PROBE  2
+
+// A query; this must match pbf::SpatialQuery in SpatialQueries.h
+typedef struct {
+
+    float4 center;
+
+    float4 halfExtent;  // Box half-extents; x is the radius of spheres and
+                        // probes (<= 0 for probes: the smoothing radius)
+
+    int type;           // QUERY_*
+
+    int __padding[3];
+
+} SpatialQuery;
+
+// The estimate at a probe point; this must match pbf::ProbeResult
+typedef struct {
+
+    float4 velocity;    // Kernel-weighted mean velocity
+
+    float density;      // Sum of poly6 over the particles in range, as in
+                        // the solver's density estimate
+
+    int neighbors;      // Particles in range
+
+    int __padding[2];
+
+} ProbeResult;
+
+/*******************************************************************************
+ * Helpers
+ ******************************************************************************/
+
+/**
+ * Half-extents of the axis-aligned box bounding the query
+ */
+float3 queryHalfExtent(SpatialQuery q)
+{
+    return q.type == QUERY_BOX ? q.halfExtent.xyz : q.halfExtent.xxx;
+}
+
+/**
+ * Tests if x is inside the sphere or box of the query
+ */
+bool queryContains(SpatialQuery q, float3 x)
+{
+    float3 d = x - q.center.xyz;
+
+    if (q.type == QUERY_BOX) {
+        return all(isless(fabs(d), q.halfExtent.xyz));
+    }
+
+    return dot(d, d) < (q.halfExtent.x * q.halfExtent.x);
+}
+
+/*******************************************************************************
+ * Kernels
+ ******************************************************************************/
+
+/**
+ * Finds the particles of a sphere or box query, visiting the grid cells its
+ * bounding box overlaps. The matches are counted first, then a range of
+ * indices is claimed with one atomic add on header[0] and filled. header
+ * receives the range of query i at [1 + 2i] (start) and [2 + 2i] (count);
+ * indices past capacity are not written, so the host can grow the list to
+ * header[0] and run again
+ *
+ * Run 1D over numQueries
+ */
+kernel void findQueryParticles(global const Particle* particles
+                              ,global const ParticlePosition* sortedParticleToCell
+                              ,global const GridCellOffset* gridCellOffsets
+                              ,int cellsX
+                              ,int cellsY
+                              ,int cellsZ
+                              ,float4 minExt
+                              ,float4 maxExt
+                              ,global const SpatialQuery* queries
+                              ,int numQueries
+                              ,volatile global int* header
+                              ,global int* indices
+                              ,int capacity)
+{
+    int id = get_global_id(0);
+
+    if (id >= numQueries) {
+        return;
+    }
+
+    SpatialQuery q = queries[id];
+
+    int3 cells  = (int3)(cellsX, cellsY, cellsZ);
+    float3 he   = queryHalfExtent(q);
+    int3 first  = cellOf(q.center.xyz - he, cells, minExt.xyz, maxExt.xyz);
+    int3 last   = cellOf(q.center.xyz + he, cells, minExt.xyz, maxExt.xyz);
+    int count   = 0;
+
+    for (int k = first.z; k <= last.z; k++) {
+        for (int j = first.y; j <= last.y; j++) {
+            for (int i = first.x; i <= last.x; i++) {
+
+                GridCellOffset offset = gridCellOffsets[sub2ind(i, j, k, cellsX, cellsY)];
+
+                if (offset.start == -1) {
+                    continue;
+                }
+
+                for (int s = offset.start; s < (offset.start + offset.length); s++) {
+                    if (queryContains(q, particles[sortedParticleToCell[s].particleIndex].pos.xyz)) {
+                        count++;
+                    }
+                }
+            }
+        }
+    }
+
+    int start = atomic_add(&header[0], count);
+
+    header[1 + (2 * id)] = start;
+    header[2 + (2 * id)] = count;
+
+    int next = start;
+
+    for (int k = first.z; k <= last.z && next < capacity; k++) {
+        for (int j = first.y; j <= last.y && next < capacity; j++) {
+            for (int i = first.x; i <= last.x && next < capacity; i++) {
+
+                GridCellOffset offset = gridCellOffsets[sub2ind(i, j, k, cellsX, cellsY)];
+
+                if (offset.start == -1) {
+                    continue;
+                }
+
+                for (int s = offset.start; s < (offset.start + offset.length) && next < capacity; s++) {
+
+                    int index = sortedParticleToCell[s].particleIndex;
+
+                    if (queryContains(q, particles[index].pos.xyz)) {
+                        indices[next++] = index;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Estimates density and velocity at the center of a probe query from the
+ * particles within its radius
+ *
+ * Run 1D over numQueries
+ */
+kernel void probeQueryPoints(global const Parameters* parameters
+                            ,global const Particle* particles
+                            ,global const ParticlePosition* sortedParticleToCell
+                            ,global const GridCellOffset* gridCellOffsets
+                            ,int cellsX
+                            ,int cellsY
+                            ,int cellsZ
+                            ,float4 minExt
+                            ,float4 maxExt
+                            ,global const SpatialQuery* queries
+                            ,int numQueries
+                            ,global ProbeResult* results)
+{
+    int id = get_global_id(0);
+
+    if (id >= numQueries) {
+        return;
+    }
+
+    SpatialQuery q = queries[id];
+
+    float h     = q.halfExtent.x > 0.0f ? q.halfExtent.x : parameters->smoothingRadius;
+    float3 p    = q.center.xyz;
+    int3 cells  = (int3)(cellsX, cellsY, cellsZ);
+    int3 first  = cellOf(p - (float3)(h, h, h), cells, minExt.xyz, maxExt.xyz);
+    int3 last   = cellOf(p + (float3)(h, h, h), cells, minExt.xyz, maxExt.xyz);
+
+    float density  = 0.0f;
+    float3 weighed = (float3)(0.0f, 0.0f, 0.0f);
+    int neighbors  = 0;
+
+    for (int k = first.z; k <= last.z; k++) {
+        for (int j = first.y; j <= last.y; j++) {
+            for (int i = first.x; i <= last.x; i++) {
+
+                GridCellOffset offset = gridCellOffsets[sub2ind(i, j, k, cellsX, cellsY)];
+
+                if (offset.start == -1) {
+                    continue;
+                }
+
+                for (int s = offset.start; s < (offset.start + offset.length); s++) {
+
+                    Particle particle = particles[sortedParticleToCell[s].particleIndex];
+
+                    float3 r = p - particle.pos.xyz;
+                    float W  = poly6(dot(r, r), h);
+
+                    if (W > 0.0f) {
+                        density += W;
+                        weighed += W * particle.vel.xyz;
+                        neighbors++;
+                    }
+                }
+            }
+        }
+    }
+
+    ProbeResult result;
+
+    result.velocity     = (float4)(density > 0.0f ? weighed / density : weighed, 0.0f);
+    result.density      = density;
+    result.neighbors    = neighbors;
+    result.__padding[0] = 0;
+    result.__padding[1] = 0;
+
+    results[id] = result;
+}
@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * Visualize.cl
+ * - Kernels used to color particles by a per-particle attribute (speed,
+ *   density, lambda, vorticity) entirely on the device. Colors are written
+ *   straight into the (GL-shared) color buffer of the particle VBO
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "kernels/Common.cl"
+
+/******************************************************************************/
+
+// Attributes; must match Simulation::VisualAttribute
+#define ATTRIBUTE_NONE      0
+#define ATTRIBUTE_SPEED     1
+#define ATTRIBUTE_DENSITY   2
+#define ATTRIBUTE_LAMBDA    3
+#define ATTRIBUTE_VORTICITY 4
+
+// Transfer functions; must match Simulation::TransferFunction
+#define TRANSFER_GRAYSCALE  0
+#define TRANSFER_HEAT       1
+#define TRANSFER_JET        2
+#define TRANSFER_COOL_WARM  3
+
+// Work group size of the min/max reduction, a power of two. Defined by
+// Simulation::setupVisualizeKernels() as the largest the device supports,
+// up to Simulation::MAX_REDUCTION_GROUP_SIZE
+#ifndef REDUCTION_GROUP_SIZE
+#define REDUCTION_GROUP_SIZE 256
+#endif
+
+/*******************************************************************************
+ * Helpers
+ ******************************************************************************/
+
+/**
+ * Maps a normalized value t in [0,1] to a color using the given transfer
+ * function
+ */
+float4 transfer(int transferFunction, float t)
+{
+    t = clamp(t, 0.0f, 1.0f);
+
+    if (transferFunction == TRANSFER_HEAT) {
+
+        // Black -> red -> yellow -> white
+        return (float4)(clamp(3.0f * t, 0.0f, 1.0f)
+                       ,clamp(3.0f * t - 1.0f, 0.0f, 1.0f)
+                       ,clamp(3.0f * t - 2.0f, 0.0f, 1.0f)
+                       ,1.0f);
+
+    } else if (transferFunction == TRANSFER_JET) {
+
+        // Blue -> cyan -> yellow -> red
+        return (float4)(clamp(1.5f - fabs(4.0f * t - 3.0f), 0.0f, 1.0f)
+                       ,clamp(1.5f - fabs(4.0f * t - 2.0f), 0.0f, 1.0f)
+                       ,clamp(1.5f - fabs(4.0f * t - 1.0f), 0.0f, 1.0f)
+                       ,1.0f);
+
+    } else if (transferFunction == TRANSFER_COOL_WARM) {
+
+        // Diverging: blue -> white -> red
+        float3 cool  = (float3)(0.230f, 0.299f, 0.754f);
+        float3 white = (float3)(0.865f, 0.865f, 0.865f);
+        float3 warm  = (float3)(0.706f, 0.016f, 0.150f);
+        float3 c     = t < 0.5f ? mix(cool, white, 2.0f * t)
+                                : mix(white, warm, 2.0f * t - 1.0f);
+
+        return (float4)(c, 1.0f);
+    }
+
+    return (float4)(t, t, t, 1.0f);
+}
+
+/*******************************************************************************
+ * Kernels
+ ******************************************************************************/
+
+/**
+ * Gathers the selected attribute of every particle into a flat array of
+ * scalars
+ *
+ * Run 1D over the number of particles
+ */
+kernel void computeAttribute(global const Particle* particles
+                            ,global const float* density
+                            ,global const float* lambda
+                            ,global const float4* curl
+                            ,int numParticles
+                            ,int attribute
+                            ,global float* values)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    float value = 0.0f;
+
+    if (attribute == ATTRIBUTE_SPEED) {
+        value = length(particles[id].vel.xyz);
+    } else if (attribute == ATTRIBUTE_DENSITY) {
+        value = density[id];
+    } else if (attribute == ATTRIBUTE_LAMBDA) {
+        value = lambda[id];
+    } else if (attribute == ATTRIBUTE_VORTICITY) {
+        value = length(curl[id].xyz);
+    }
+
+    values[id] = value;
+}
+
+/**
+ * First pass of the min/max reduction: every work group reduces its slice of
+ * values to a single (min, max) pair in partials
+ *
+ * Run 1D over the number of values rounded up to a multiple of
+ * REDUCTION_GROUP_SIZE, with a local size of REDUCTION_GROUP_SIZE
+ */
+kernel __attribute__((reqd_work_group_size(REDUCTION_GROUP_SIZE, 1, 1)))
+void reduceAttributeRange(global const float* values
+                         ,int numValues
+                         ,global float2* partials)
+{
+    local float2 scratch[REDUCTION_GROUP_SIZE];
+
+    int id  = get_global_id(0);
+    int lid = get_local_id(0);
+
+    scratch[lid] = id < numValues ? (float2)(values[id], values[id])
+                                  : (float2)(INFINITY, -INFINITY);
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int stride = REDUCTION_GROUP_SIZE / 2; stride > 0; stride >>= 1) {
+
+        if (lid < stride) {
+            float2 a = scratch[lid];
+            float2 b = scratch[lid + stride];
+            scratch[lid] = (float2)(fmin(a.x, b.x), fmax(a.y, b.y));
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0) {
+        partials[get_group_id(0)] = scratch[0];
+    }
+}
+
+/**
+ * Second pass of the min/max reduction: a single work group folds all of the
+ * per-group partials into range[0]
+ *
+ * Run 1D with both global and local size of REDUCTION_GROUP_SIZE
+ */
+kernel __attribute__((reqd_work_group_size(REDUCTION_GROUP_SIZE, 1, 1)))
+void finishAttributeRange(global const float2* partials
+                         ,int numPartials
+                         ,global float2* range)
+{
+    local float2 scratch[REDUCTION_GROUP_SIZE];
+
+    int lid = get_local_id(0);
+
+    float2 r = (float2)(INFINITY, -INFINITY);
+
+    for (int i = lid; i < numPartials; i += REDUCTION_GROUP_SIZE) {
+        r = (float2)(fmin(r.x, partials[i].x), fmax(r.y, partials[i].y));
+    }
+
+    scratch[lid] = r;
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int stride = REDUCTION_GROUP_SIZE / 2; stride > 0; stride >>= 1) {
+
+        if (lid < stride) {
+            float2 a = scratch[lid];
+            float2 b = scratch[lid + stride];
+            scratch[lid] = (float2)(fmin(a.x, b.x), fmax(a.y, b.y));
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0) {
+        range[0] = scratch[0];
+    }
+}
+
+/**
+ * Normalizes every value against either the reduced range (autoRange != 0)
+ * or the given fixed range, and writes the resulting color
+ *
+ * Run 1D over the number of particles
+ */
+kernel void colorizeAttribute(global const float* values
+                             ,int numParticles
+                             ,global const float2* range
+                             ,int autoRange
+                             ,float rangeMin
+                             ,float rangeMax
+                             ,int transferFunction
+                             ,global float4* colors)
+{
+    int id = get_global_id(0);
+
+    if (id >= numParticles) {
+        return;
+    }
+
+    float2 r = autoRange ? range[0] : (float2)(rangeMin, rangeMax);
+    float  w = r.y - r.x;
+    float  t = w > 1.0e-6f ? (values[id] - r.x) / w : 0.5f;
+
+    colors[id] = transfer(transferFunction, t);
+}
+
+/******************************************************************************/
@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * Volume.cl
+ * - Kernels used to splat particle density and velocity into a sparse volume
+ *   made up of fixed-size bricks of voxels. Only bricks that overlap
+ *   occupied grid cells are allocated and filled
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "kernels/Common.cl"
+
+/******************************************************************************/
+
+// Voxels per brick edge; must match VolumeExporter::BRICK_SIZE
+#define BRICK_SIZE 8
+
+#define VOXELS_PER_BRICK (BRICK_SIZE * BRICK_SIZE * BRICK_SIZE)
+
+NEIGHBOR_STENCIL_PROGRAM
+
+/*******************************************************************************
+ * Kernels
+ ******************************************************************************/
+
+/**
+ * Clears the brick occupancy flags
+ *
+ * Run 1D over the total number of bricks in the volume
+ */
+kernel void resetBrickFlags(global int* brickFlags)
+{
+    brickFlags[get_global_id(0)] = 0;
+}
+
+/**
+ * For every occupied grid cell, flags all bricks overlapping the cell's
+ * bounding box grown by the smoothing radius h, since a particle in the cell
+ * contributes to all voxels within h of it
+ *
+ * Run 1D over the total number of grid cells
+ */
+kernel void markActiveBricks(global const int* cellHistogram
+                            ,int cellsX
+                            ,int cellsY
+                            ,int cellsZ
+                            ,float4 minExt
+                            ,float4 maxExt
+                            ,float4 volumeOrigin
+                            ,float brickExtent
+                            ,int bricksX
+                            ,int bricksY
+                            ,int bricksZ
+                            ,float h
+                            ,global int* brickFlags)
+{
+    int id = get_global_id(0);
+
+    if (cellHistogram[id] <= 0) {
+        return;
+    }
+
+    // Recover the cell's subscript from its linear index:
+
+    int i = id % cellsX;
+    int j = (id / cellsX) % cellsY;
+    int k = id / (cellsX * cellsY);
+
+    float3 cellSize = (maxExt.xyz - minExt.xyz) / (float3)(cellsX, cellsY, cellsZ);
+    float3 lo       = minExt.xyz + ((float3)(i, j, k) * cellSize) - (float3)(h, h, h);
+    float3 hi       = lo + cellSize + (float3)(2.0f * h, 2.0f * h, 2.0f * h);
+
+    int3 bricks = (int3)(bricksX, bricksY, bricksZ);
+    int3 bLo    = clamp(convert_int3(floor((lo - volumeOrigin.xyz) / brickExtent)), (int3)(0, 0, 0), bricks - (int3)(1, 1, 1));
+    int3 bHi    = clamp(convert_int3(floor((hi - volumeOrigin.xyz) / brickExtent)), (int3)(0, 0, 0), bricks - (int3)(1, 1, 1));
+
+    // Benign race: every writer stores the same value
+
+    for (int bk = bLo.z; bk <= bHi.z; bk++) {
+        for (int bj = bLo.y; bj <= bHi.y; bj++) {
+            for (int bi = bLo.x; bi <= bHi.x; bi++) {
+                brickFlags[sub2ind(bi, bj, bk, bricksX, bricksY)] = 1;
+            }
+        }
+    }
+}
+
+/**
+ * Given the brick occupancy flags and their exclusive prefix sums, writes the
+ * linear index of each active brick to its compacted slot. Since the scan
+ * preserves order, activeBricks ends up sorted by linear brick index
+ *
+ * Run 1D over the total number of bricks in the volume
+ */
+kernel void compactActiveBricks(global const int* brickFlags
+                               ,global const int* brickOffsets
+                               ,global int* activeBricks)
+{
+    int id = get_global_id(0);
+
+    if (brickFlags[id] != 0) {
+        activeBricks[brickOffsets[id]] = id;
+    }
+}
+
+/**
+ * Computes the SPH density and velocity estimate at the center of each voxel
+ * of each active brick. The output is laid out brick after brick, in the order
+ * given by activeBricks, with voxels in x-fastest order within a brick. Each
+ * voxel is written as (vx, vy, vz, density)
+ *
+ * Run 1D over (number of active bricks * VOXELS_PER_BRICK)
+ */
+kernel void splatBricks(global const Parameters* parameters
+                       ,global const Particle* particles
+                       ,global const ParticlePosition* sortedParticleToCell
+                       ,global const GridCellOffset* gridCellOffsets
+                       ,int cellsX
+                       ,int cellsY
+                       ,int cellsZ
+                       ,float4 minExt
+                       ,float4 maxExt
+                       ,global const int* activeBricks
+                       ,int numActiveBricks
+                       ,float4 volumeOrigin
+                       ,float voxelSize
+                       ,int bricksX
+                       ,int bricksY
+                       ,global float4* voxels)
+{
+    int id    = get_global_id(0);
+    int brick = id / VOXELS_PER_BRICK;
+    int voxel = id % VOXELS_PER_BRICK;
+
+    if (brick >= numActiveBricks) {
+        return;
+    }
+
+    // Brick subscript, then voxel subscript within the volume:
+
+    int b  = activeBricks[brick];
+    int bi = b % bricksX;
+    int bj = (b / bricksX) % bricksY;
+    int bk = b / (bricksX * bricksY);
+
+    int3 v = (int3)(bi * BRICK_SIZE + (voxel % BRICK_SIZE)
+                   ,bj * BRICK_SIZE + ((voxel / BRICK_SIZE) % BRICK_SIZE)
+                   ,bk * BRICK_SIZE + (voxel / (BRICK_SIZE * BRICK_SIZE)));
+
+    float3 x     = volumeOrigin.xyz + ((convert_float3(v) + (float3)(0.5f, 0.5f, 0.5f)) * voxelSize);
+    float  h     = parameters->smoothingRadius;
+    int3   cells = (int3)(cellsX, cellsY, cellsZ);
+    int3   c     = cellOf(x, cells, minExt.xyz, maxExt.xyz);
+
+    float  rho = 0.0f;
+    float3 vel = (float3)(0.0f, 0.0f, 0.0f);
+
+    // Gather from the cells of the neighbor stencil around the voxel (see
+    // kernels/Common.cl):
+
+    float3 cellSize = (maxExt.xyz - minExt.xyz) / convert_float3(cells);
+    int3   span     = (int3)(0, 0, 0);
+    int3   first    = neighborStencilOrigin(x, c, minExt.xyz, cellSize, h, &span);
+
+    for (int nk = first.z; nk < first.z + span.z; nk++) {
+        for (int nj = first.y; nj < first.y + span.y; nj++) {
+            for (int ni = first.x; ni < first.x + span.x; ni++) {
+
+                int3 n = (int3)(ni, nj, nk);
+
+                if (!stencilCellVisible(x, n, cells, minExt.xyz, cellSize, h)) {
+                    continue;
+                }
+
+                GridCellOffset offset = gridCellOffsets[sub2ind(n.x, n.y, n.z, cellsX, cellsY)];
+
+                if (offset.start == -1) {
+                    continue;
+                }
+
+                for (int s = offset.start; s < (offset.start + offset.length); s++) {
+
+                    Particle p = particles[sortedParticleToCell[s].particleIndex];
+                    float3 r   = x - p.pos.xyz;
+                    float  W   = poly6(dot(r, r), h);
+
+                    rho += W;
+                    vel += W * p.vel.xyz;
+                }
+            }
+        }
+    }
+
+    if (rho > 0.0f) {
+        vel /= rho;
+    }
+
+    voxels[id] = (float4)(vel, rho);
+}
@@ -0,0 +1,276 @@
+#*******************************************************************************
+# pbf.py
+# - Python bindings for libpbf (src/pbf), through its C interface. Particle
+#   state is exposed as NumPy arrays backed by the simulation's host-mapped
+#   buffers, so nothing is copied between steps
+#
+#   Build the library first with "make shared" in src/pbf; the module looks
+#   for libpbf.so there, or wherever PBF_LIBRARY points
+#
+#   Example:
+#
+#     import numpy as np, pbf
+#     sim = pbf.Simulation(pbf.random_particles(4096, (0,0,0,10,10,10)), (0,0,0,10,10,10))
+#     sim.step(10)
+#     print(sim.particles['pos'][:, 1].mean(), sim.density.max())
+#
+# CIS563: Physically Based Animation final project
+# Created by Michael Woods & Michael O'Meara
+#*******************************************************************************
+
+import ctypes
+import os
+
+import numpy as np
+
+#*******************************************************************************
+
+# Must match pbf::Particle (src/pbf/Solver.h)
+PARTICLE_DTYPE = np.dtype([('pos', np.float32, 4)
+                          ,('posStar', np.float32, 4)
+                          ,('vel', np.float32, 4)])
+
+# Field order of Parameters (src/pbf/Parameters.h)
+PARAMETER_NAMES = ('particleRadius'
+                  ,'smoothingRadius'
+                  ,'relaxation'
+                  ,'artificialPressureK'
+                  ,'artificialPressureN'
+                  ,'vorticityEpsilon'
+                  ,'viscosityCoeff')
+
+# Same as Constants::DEFAULT_PARAMS and Constants::DEFAULT_DT
+DEFAULT_PARAMETERS = dict(zip(PARAMETER_NAMES, (0.5, 1.15, 0.0033, 0.1, 5.0, 0.1, 0.01)))
+DEFAULT_DT         = 0.033
+
+# Bounds animation types; must match pbf::BoundsAnimation::Type
+SINE_WAVE   = 0
+LINEAR_RAMP = 1
+COMPRESS    = 2
+
+_HERE         = os.path.dirname(os.path.abspath(__file__))
+_DEFAULT_LIB  = os.path.join(_HERE, '..', 'src', 'pbf', 'libpbf.so')
+_DEFAULT_DATA = os.path.join(_HERE, '..', 'bin', 'data')
+
+#*******************************************************************************
+
+def _load_library():
+    # ctypes.CDLL (unlike PyDLL) releases the GIL for the duration of every
+    # call, so Simulation.step() runs concurrently with other Python threads
+    lib = ctypes.CDLL(os.environ.get('PBF_LIBRARY', _DEFAULT_LIB))
+
+    session = ctypes.c_void_p
+    floats  = ctypes.POINTER(ctypes.c_float)
+    ints    = ctypes.POINTER(ctypes.c_int)
+
+    signatures = {
+        'pbf_session_create'               : (session, [ctypes.c_char_p, ctypes.c_int, ctypes.c_int]),
+        'pbf_session_destroy'              : (None, [session]),
+        'pbf_session_is_loaded'            : (ctypes.c_int, [session]),
+        'pbf_session_setup'                : (ctypes.c_int, [session, floats, ctypes.c_int, ints, floats, floats, ctypes.c_float]),
+        'pbf_session_step'                 : (None, [session, ctypes.c_int]),
+        'pbf_session_num_particles'        : (ctypes.c_int, [session]),
+        'pbf_session_frame_number'         : (ctypes.c_uint, [session]),
+        'pbf_session_particles'            : (floats, [session]),
+        'pbf_session_density'              : (floats, [session]),
+        'pbf_session_get_bounds'           : (None, [session, floats]),
+        'pbf_session_set_bounds'           : (None, [session, floats]),
+        'pbf_session_reset_bounds'         : (None, [session]),
+        'pbf_session_get_parameters'       : (None, [session, floats]),
+        'pbf_session_set_parameters'       : (None, [session, floats]),
+        'pbf_session_set_time_step'        : (None, [session, ctypes.c_float]),
+        'pbf_session_set_solver_iterations': (None, [session, ctypes.c_int]),
+        'pbf_session_set_animation'        : (None, [session, ctypes.c_int, ctypes.c_int, ctypes.c_float, ctypes.c_float, ctypes.c_int]),
+    }
+
+    for name, (restype, argtypes) in signatures.items():
+        function          = getattr(lib, name)
+        function.restype  = restype
+        function.argtypes = argtypes
+
+    return lib
+
+_lib = None
+
+def _library():
+    global _lib
+    if _lib is None:
+        _lib = _load_library()
+    return _lib
+
+def _float_array(values, count):
+    values = np.ascontiguousarray(values, dtype=np.float32).ravel()
+    if values.size != count:
+        raise ValueError('expected %d values, got %d' % (count, values.size))
+    return values
+
+def _as_pointer(array, ctype):
+    return array.ctypes.data_as(ctypes.POINTER(ctype))
+
+#*******************************************************************************
+
+def random_particles(count, bounds, radius=DEFAULT_PARAMETERS['particleRadius'], fill=0.25):
+    """
+    Particles at rest, placed at random in the bottom fill fraction of the
+    bounds, like the app's default initial state
+    """
+    lo = np.asarray(bounds[:3], dtype=np.float32) + radius
+    hi = np.asarray(bounds[3:], dtype=np.float32) - radius
+    hi[1] = fill * hi[1]
+
+    particles = np.zeros(count, dtype=PARTICLE_DTYPE)
+    particles['pos'][:, :3] = lo + np.random.rand(count, 3).astype(np.float32) * (hi - lo)
+
+    return particles
+
+class Simulation(object):
+    """
+    A headless simulation (pbf::Session). The particles and density
+    properties are views of the simulation's own memory: they can be read and
+    written in place, and are only valid until the next step()
+    """
+
+    def __init__(self
+                ,particles
+                ,bounds
+                ,parameters=None
+                ,dt=DEFAULT_DT
+                ,cells_per_axis=None
+                ,data_path=_DEFAULT_DATA
+                ,platform=0
+                ,device=0):
+
+        self._lib     = _library()
+        self._session = self._lib.pbf_session_create(data_path.encode('utf-8'), platform, device)
+
+        if not self._lib.pbf_session_is_loaded(self._session):
+            self.close()
+            raise RuntimeError('could not create an OpenCL session or load kernels from ' + data_path)
+
+        initial = np.ascontiguousarray(particles, dtype=PARTICLE_DTYPE)
+        params  = self._parameter_array(parameters)
+        box     = _float_array(bounds, 6)
+        cells   = None
+
+        if cells_per_axis is not None:
+            cells = _as_pointer(np.ascontiguousarray(cells_per_axis, dtype=np.int32), ctypes.c_int)
+
+        ok = self._lib.pbf_session_setup(self._session
+                                        ,_as_pointer(initial, ctypes.c_float)
+                                        ,len(initial)
+                                        ,cells
+                                        ,_as_pointer(box, ctypes.c_float)
+                                        ,_as_pointer(params, ctypes.c_float)
+                                        ,dt)
+        if not ok:
+            self.close()
+            raise RuntimeError('simulation setup failed')
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        if getattr(self, '_session', None):
+            self._lib.pbf_session_destroy(self._session)
+            self._session = None
+
+    def _parameter_array(self, parameters):
+        values = dict(DEFAULT_PARAMETERS)
+        values.update(parameters or {})
+        return _float_array([values[name] for name in PARAMETER_NAMES], len(PARAMETER_NAMES))
+
+    #***************************************************************************
+
+    def step(self, steps=1):
+        """
+        Takes the given number of steps. The GIL is released while the
+        simulation runs
+        """
+        self._lib.pbf_session_step(self._session, steps)
+
+    @property
+    def num_particles(self):
+        return self._lib.pbf_session_num_particles(self._session)
+
+    @property
+    def frame_number(self):
+        return self._lib.pbf_session_frame_number(self._session)
+
+    @property
+    def particles(self):
+        """
+        Structured array (pos, posStar, vel) backed by the mapped particle
+        buffer; no copy is made
+        """
+        pointer = self._lib.pbf_session_particles(self._session)
+        floats  = np.ctypeslib.as_array(pointer, shape=(self.num_particles * 12,))
+        return floats.view(PARTICLE_DTYPE)
+
+    @property
+    def density(self):
+        """
+        Per-particle densities of the last step, backed by the mapped density
+        buffer; no copy is made
+        """
+        pointer = self._lib.pbf_session_density(self._session)
+        return np.ctypeslib.as_array(pointer, shape=(self.num_particles,))
+
+    #***************************************************************************
+
+    @property
+    def bounds(self):
+        values = np.zeros(6, dtype=np.float32)
+        self._lib.pbf_session_get_bounds(self._session, _as_pointer(values, ctypes.c_float))
+        return values
+
+    @bounds.setter
+    def bounds(self, bounds):
+        values = _float_array(bounds, 6)
+        self._lib.pbf_session_set_bounds(self._session, _as_pointer(values, ctypes.c_float))
+
+    def reset_bounds(self):
+        self._lib.pbf_session_reset_bounds(self._session)
+
+    @property
+    def parameters(self):
+        values = np.zeros(len(PARAMETER_NAMES), dtype=np.float32)
+        self._lib.pbf_session_get_parameters(self._session, _as_pointer(values, ctypes.c_float))
+        return dict(zip(PARAMETER_NAMES, values.tolist()))
+
+    def set_parameters(self, **parameters):
+        """
+        Updates the given parameters, e.g. set_parameters(vorticityEpsilon=0.2)
+        """
+        unknown = set(parameters) - set(PARAMETER_NAMES)
+        if unknown:
+            raise ValueError('unknown parameters: ' + ', '.join(sorted(unknown)))
+
+        values = self.parameters
+        values.update(parameters)
+
+        array = self._parameter_array(values)
+        self._lib.pbf_session_set_parameters(self._session, _as_pointer(array, ctypes.c_float))
+
+    def set_time_step(self, dt):
+        self._lib.pbf_session_set_time_step(self._session, dt)
+
+    def set_solver_iterations(self, iterations):
+        self._lib.pbf_session_set_solver_iterations(self._session, iterations)
+
+    def animate_bounds(self, enabled=True, type=SINE_WAVE, period=1.0, amplitude=10.0, both_sides=False):
+        """
+        Moves the max x wall (and the min x wall, if both_sides) every step,
+        as the app's bounds animation does
+        """
+        self._lib.pbf_session_set_animation(self._session
+                                           ,int(enabled)
+                                           ,type
+                                           ,period
+                                           ,amplitude
+                                           ,int(both_sides))
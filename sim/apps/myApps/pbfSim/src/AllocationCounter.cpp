@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * AllocationCounter.cpp
+ * - Counts the heap allocations made through operator new, so the frame
+ *   loop can be checked for allocations once it has warmed up (see
+ *   ofApp::countAllocations)
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "AllocationCounter.h"
+#include "Constants.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+#ifndef COUNT_ALLOCATIONS
+
+bool AllocationCounter::isEnabled()
+{
+    return false;
+}
+
+unsigned long long AllocationCounter::getCount()
+{
+    return 0;
+}
+
+#else
+
+static atomic<unsigned long long> allocations(0);
+
+static void* countedAllocation(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+
+    return malloc(size > 0 ? size : 1);
+}
+
+bool AllocationCounter::isEnabled()
+{
+    return true;
+}
+
+unsigned long long AllocationCounter::getCount()
+{
+    return allocations.load(memory_order_relaxed);
+}
+
+/******************************************************************************/
+
+void* operator new(size_t size)
+{
+    void* memory = countedAllocation(size);
+
+    if (memory == NULL) {
+        throw bad_alloc();
+    }
+
+    return memory;
+}
+
+void* operator new[](size_t size)
+{
+    void* memory = countedAllocation(size);
+
+    if (memory == NULL) {
+        throw bad_alloc();
+    }
+
+    return memory;
+}
+
+void* operator new(size_t size, const nothrow_t&) throw()
+{
+    return countedAllocation(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) throw()
+{
+    return countedAllocation(size);
+}
+
+void operator delete(void* memory) throw()
+{
+    free(memory);
+}
+
+void operator delete[](void* memory) throw()
+{
+    free(memory);
+}
+
+void operator delete(void* memory, const nothrow_t&) throw()
+{
+    free(memory);
+}
+
+void operator delete[](void* memory, const nothrow_t&) throw()
+{
+    free(memory);
+}
+
+#endif
+
+/******************************************************************************/
@@ -0,0 +1,35 @@
+/*******************************************************************************
+ * AllocationCounter.h
+ * - Counts the heap allocations made through operator new, so the frame
+ *   loop can be checked for allocations once it has warmed up (see
+ *   ofApp::countAllocations)
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_ALLOCATION_COUNTER_H
+#define PBF_SIM_ALLOCATION_COUNTER_H
+
+/******************************************************************************/
+
+/**
+ * In builds with COUNT_ALLOCATIONS defined (see Constants.h), the global
+ * operator new and delete are replaced by ones that count calls and forward
+ * to malloc and free. Allocations made with malloc directly (e.g. by the
+ * OpenGL or OpenCL drivers) aren't counted. Other builds keep the standard
+ * operators and count nothing
+ */
+class AllocationCounter
+{
+    public:
+        // Whether allocations are counted in this build
+        static bool isEnabled();
+
+        // Allocations made since startup, from any thread
+        static unsigned long long getCount();
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,438 @@
+/*******************************************************************************
+ * AnimatedCollider.cpp
+ * - Animated Assimp model colliders backed by narrow band distance fields
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "aiMesh.h"
+#include "aiAnim.h"
+#include "AnimatedCollider.h"
+#include "KernelPrograms.h"
+#include "Simulation.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+/**
+ * Computes the bounds of the given points, after transformation by m
+ */
+static void findBounds(const aiVector3D* points
+                      ,int numPoints
+                      ,const ofMatrix4x4& m
+                      ,ofVec3f& minExt
+                      ,ofVec3f& maxExt)
+{
+    float inf = numeric_limits<float>::max();
+
+    minExt = ofVec3f(inf, inf, inf);
+    maxExt = ofVec3f(-inf, -inf, -inf);
+
+    for (int i = 0; i < numPoints; i++) {
+
+        ofVec3f p = ofVec3f(points[i].x, points[i].y, points[i].z) * m;
+
+        minExt.x = min(minExt.x, p.x); maxExt.x = max(maxExt.x, p.x);
+        minExt.y = min(minExt.y, p.y); maxExt.y = max(maxExt.y, p.y);
+        minExt.z = min(minExt.z, p.z); maxExt.z = max(maxExt.z, p.z);
+    }
+}
+
+/**
+ * Number of voxels of size voxelSize needed to cover extent
+ */
+static int voxelsToCover(float extent, float voxelSize)
+{
+    return max(1, static_cast<int>(ceil(extent / voxelSize)));
+}
+
+/**
+ * World units per local unit of a (uniformly scaled) transform
+ */
+static float scaleOf(const ofMatrix4x4& m)
+{
+    return ofVec3f(m(0, 0), m(0, 1), m(0, 2)).length();
+}
+
+/**
+ * A rigid part's field is sized again once its scale has changed by more
+ * than this factor either way since the field was built, so its voxels and
+ * band stay close to the requested world space sizes
+ */
+static const float RESCALE_TOLERANCE = 1.25f;
+
+/******************************************************************************/
+
+/**
+ * Creates an empty collider
+ *
+ * @param [in] _openCL OpenCL manager instance
+ * @param [in] _voxelSize Edge length of a distance field voxel, in world units
+ * @param [in] _bandWidth Distance from the surface, in world units, up to
+ *             which the distance fields are populated. This must be at least
+ *             the particle radius plus the distance a particle can travel in
+ *             a single step
+ */
+AnimatedCollider::AnimatedCollider(msa::OpenCL& _openCL
+                                  ,float _voxelSize
+                                  ,float _bandWidth) :
+    openCL(_openCL),
+    animationIndex(0),
+    time(0.0),
+    voxelSize(_voxelSize),
+    bandWidth(_bandWidth)
+{
+    this->loadKernels();
+}
+
+AnimatedCollider::~AnimatedCollider()
+{
+
+}
+
+/**
+ * Loads kernels/DistanceField.cl
+ */
+void AnimatedCollider::loadKernels()
+{
+    auto program = loadKernelProgram(this->openCL, "kernels/DistanceField.cl");
+
+    this->clearDistanceFieldKernel = this->openCL.loadKernel("clearDistanceField", program);
+    this->splatTriangleDistancesKernel = this->openCL.loadKernel("splatTriangleDistances", program);
+    this->resolveDistanceFieldKernel = this->openCL.loadKernel("resolveDistanceField", program);
+}
+
+/**
+ * Loads the model and builds the distance fields for all of its meshes
+ *
+ * @param [in] filename Model file, relative to the data folder
+ * @param [in] position World position of the model
+ * @param [in] scale Uniform scale applied to the model
+ * @param [in] animationIndex The animation that drives the model, if any
+ * @returns true if the model was loaded
+ */
+bool AnimatedCollider::load(const string& filename
+                           ,const ofVec3f& position
+                           ,float scale
+                           ,int _animationIndex)
+{
+    this->parts.clear();
+    this->time           = 0.0;
+    this->animationIndex = _animationIndex;
+
+    // Keep the model in world units, rather than fitting it to the screen:
+
+    this->model.setScaleNomalization(false);
+
+    if (!this->model.loadModel(filename)) {
+        ofLogError() << "AnimatedCollider: failed to load " << filename << endl;
+        return false;
+    }
+
+    this->model.setPosition(position.x, position.y, position.z);
+    this->model.setScale(scale, scale, scale);
+    this->model.update();
+
+    for (int i = 0; i < static_cast<int>(this->model.getMeshCount()); i++) {
+
+        shared_ptr<Part> part(new Part());
+        part->meshIndex = i;
+
+        this->setupPart(*part);
+
+        if (part->numTriangles > 0) {
+            this->parts.push_back(part);
+        }
+    }
+
+    ofLogNotice() << "AnimatedCollider: loaded " << filename << " with "
+                  << this->parts.size() << " part(s)" << endl;
+
+    return true;
+}
+
+/**
+ * Returns the current transform from the local space of the given mesh to
+ * world space
+ */
+ofMatrix4x4 AnimatedCollider::getMeshToWorld(int meshIndex)
+{
+    return this->model.getMeshHelper(meshIndex).matrix * this->model.getModelMatrix();
+}
+
+/**
+ * Classifies a part as rigid or deforming, uploads its triangles and sizes
+ * its distance field. Rigid parts are voxelized here, once
+ */
+void AnimatedCollider::setupPart(Part& part)
+{
+    ofxAssimpMeshHelper& helper = this->model.getMeshHelper(part.meshIndex);
+    const aiMesh* mesh          = helper.mesh;
+    int numVertices             = static_cast<int>(mesh->mNumVertices);
+
+    part.deforming    = mesh->HasBones() && this->model.hasAnimations();
+    part.numTriangles = static_cast<int>(helper.indices.size() / 3);
+
+    if (part.numTriangles == 0) {
+        return;
+    }
+
+    vector<int> indices(helper.indices.begin(), helper.indices.end());
+
+    part.indices.initBuffer(indices.size() * sizeof(int), CL_MEM_READ_ONLY);
+    part.indices.write(&indices[0], 0, indices.size() * sizeof(int));
+    part.vertices.initBuffer(numVertices * sizeof(float4), CL_MEM_READ_ONLY);
+
+    ofVec3f minExt, maxExt;
+
+    if (part.deforming) {
+
+        // World space field that follows the animated mesh. Since the mesh
+        // changes shape, leave room for it to grow by half its bind pose
+        // extent:
+
+        findBounds(mesh->mVertices, numVertices, this->getMeshToWorld(part.meshIndex), minExt, maxExt);
+
+        part.fieldScale = 1.0f;
+        part.builtScale = 1.0f;
+        part.band       = this->bandWidth;
+        part.hostVertices.resize(numVertices);
+        part.dims[3]    = 0;
+        part.fieldToWorld.makeIdentityMatrix();
+        part.worldToField.makeIdentityMatrix();
+
+        ofVec3f extent = (1.5f * (maxExt - minExt)) + ofVec3f(2.0f * part.band);
+
+        part.voxelSize = this->voxelSize;
+
+        while (voxelsToCover(extent.x, part.voxelSize) *
+               voxelsToCover(extent.y, part.voxelSize) *
+               voxelsToCover(extent.z, part.voxelSize) > MAX_FIELD_VOXELS)
+        {
+            part.voxelSize *= 1.25f;
+        }
+
+        part.capacity = voxelsToCover(extent.x, part.voxelSize)
+                      * voxelsToCover(extent.y, part.voxelSize)
+                      * voxelsToCover(extent.z, part.voxelSize);
+
+        part.field.initBuffer(part.capacity * sizeof(int));
+
+        return;
+    }
+
+    // Rigid: local space field, rebuilt only when the mesh's scale moves
+    // far from the one it was built at (see update()):
+
+    ofMatrix4x4 identity;
+    findBounds(mesh->mVertices, numVertices, identity, part.meshMin, part.meshMax);
+
+    part.fieldToWorld = this->getMeshToWorld(part.meshIndex);
+    part.worldToField = part.fieldToWorld.getInverse();
+    part.fieldScale   = scaleOf(part.fieldToWorld);
+    part.capacity     = 0;
+
+    vector<float4> vertices(numVertices);
+
+    for (int i = 0; i < numVertices; i++) {
+        vertices[i] = float4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f);
+    }
+
+    part.vertices.write(&vertices[0], 0, numVertices * sizeof(float4));
+
+    this->sizeRigidField(part);
+    this->voxelizePart(part);
+}
+
+/**
+ * Sizes a rigid part's field for its current scale: the voxel size and band
+ * are converted to field units, so they keep their world space sizes. The
+ * field buffer is only reallocated if it grows
+ */
+void AnimatedCollider::sizeRigidField(Part& part)
+{
+    part.builtScale  = part.fieldScale;
+    part.voxelSize   = this->voxelSize / part.fieldScale;
+    part.band        = this->bandWidth / part.fieldScale;
+    part.fieldOrigin = part.meshMin - ofVec3f(part.band);
+
+    ofVec3f extent = (part.meshMax - part.meshMin) + ofVec3f(2.0f * part.band);
+
+    while (voxelsToCover(extent.x, part.voxelSize) *
+           voxelsToCover(extent.y, part.voxelSize) *
+           voxelsToCover(extent.z, part.voxelSize) > MAX_FIELD_VOXELS)
+    {
+        part.voxelSize *= 1.25f;
+    }
+
+    part.dims[0] = voxelsToCover(extent.x, part.voxelSize);
+    part.dims[1] = voxelsToCover(extent.y, part.voxelSize);
+    part.dims[2] = voxelsToCover(extent.z, part.voxelSize);
+    part.dims[3] = 0;
+
+    int required = part.dims[0] * part.dims[1] * part.dims[2];
+
+    if (required > part.capacity) {
+        part.capacity = required;
+        part.field.initBuffer(part.capacity * sizeof(int));
+    }
+}
+
+/**
+ * Rebuilds the part's distance field from its current vertex buffer
+ */
+void AnimatedCollider::voxelizePart(Part& part)
+{
+    ofVec4f origin(part.fieldOrigin.x, part.fieldOrigin.y, part.fieldOrigin.z, 0.0f);
+
+    this->clearDistanceFieldKernel->setArg(0, part.field);
+    this->clearDistanceFieldKernel->run1D(part.dims[0] * part.dims[1] * part.dims[2]);
+
+    this->splatTriangleDistancesKernel->setArg(0, part.vertices);
+    this->splatTriangleDistancesKernel->setArg(1, part.indices);
+    this->splatTriangleDistancesKernel->setArg(2, part.numTriangles);
+    this->splatTriangleDistancesKernel->setArg(3, origin);
+    this->splatTriangleDistancesKernel->setArg(4, part.voxelSize);
+    this->splatTriangleDistancesKernel->setArg(5, part.dims, sizeof(part.dims));
+    this->splatTriangleDistancesKernel->setArg(6, part.band);
+    this->splatTriangleDistancesKernel->setArg(7, part.field);
+    this->splatTriangleDistancesKernel->run1D(part.numTriangles);
+}
+
+/**
+ * Moves a deforming part's field to its current (skinned) bounds and
+ * re-voxelizes it
+ */
+void AnimatedCollider::updateDeformingPart(Part& part)
+{
+    ofxAssimpMeshHelper& helper = this->model.getMeshHelper(part.meshIndex);
+    ofMatrix4x4 meshToWorld     = this->getMeshToWorld(part.meshIndex);
+    int numVertices             = static_cast<int>(helper.animatedPos.size());
+
+    if (numVertices != static_cast<int>(part.hostVertices.size())) {
+        return;
+    }
+
+    ofVec3f minExt, maxExt;
+    findBounds(&helper.animatedPos[0], numVertices, meshToWorld, minExt, maxExt);
+
+    for (int i = 0; i < numVertices; i++) {
+        const aiVector3D& v = helper.animatedPos[i];
+        ofVec3f p           = ofVec3f(v.x, v.y, v.z) * meshToWorld;
+        part.hostVertices[i] = float4(p.x, p.y, p.z, 1.0f);
+    }
+
+    // Fit the field to the current bounds, trimming it symmetrically if the
+    // mesh has grown past the field's capacity:
+
+    ofVec3f extent = (maxExt - minExt) + ofVec3f(2.0f * part.band);
+
+    part.fieldOrigin = minExt - ofVec3f(part.band);
+    part.dims[0]     = voxelsToCover(extent.x, part.voxelSize);
+    part.dims[1]     = voxelsToCover(extent.y, part.voxelSize);
+    part.dims[2]     = voxelsToCover(extent.z, part.voxelSize);
+
+    while (part.dims[0] * part.dims[1] * part.dims[2] > part.capacity) {
+
+        int axis = (part.dims[0] >= part.dims[1] && part.dims[0] >= part.dims[2]) ? 0
+                 : (part.dims[1] >= part.dims[2] ? 1 : 2);
+
+        part.dims[axis]         = max(1, part.dims[axis] - 2);
+        part.fieldOrigin[axis] += part.voxelSize;
+    }
+
+    part.vertices.write(&part.hostVertices[0], 0, numVertices * sizeof(float4));
+
+    this->voxelizePart(part);
+}
+
+/**
+ * Advances the model's animation by dt and refreshes all of the parts
+ */
+void AnimatedCollider::update(float dt)
+{
+    this->time += dt;
+
+    if (this->model.hasAnimations()) {
+
+        ofxAssimpAnimation& animation = this->model.getAnimation(this->animationIndex);
+        const aiAnimation* anim       = animation.getAnimation();
+        double ticksPerSecond         = (anim->mTicksPerSecond != 0.0) ? anim->mTicksPerSecond : 25.0;
+        double duration               = anim->mDuration / ticksPerSecond;
+
+        if (duration > 0.0) {
+            animation.setPosition(static_cast<float>(fmod(this->time, duration) / duration));
+        }
+    }
+
+    this->model.update();
+
+    for (auto i = this->parts.begin(); i != this->parts.end(); i++) {
+
+        Part& part = **i;
+
+        if (part.deforming) {
+            this->updateDeformingPart(part);
+        } else {
+
+            // The field's distances are in field units, so the scale that
+            // turns them into world units must follow the transform:
+
+            part.fieldToWorld = this->getMeshToWorld(part.meshIndex);
+            part.worldToField = part.fieldToWorld.getInverse();
+            part.fieldScale   = scaleOf(part.fieldToWorld);
+
+            float change = part.fieldScale / part.builtScale;
+
+            if (change > RESCALE_TOLERANCE || change < 1.0f / RESCALE_TOLERANCE) {
+                this->sizeRigidField(part);
+                this->voxelizePart(part);
+            }
+        }
+    }
+}
+
+/**
+ * Pushes particles out of every part of the collider
+ */
+void AnimatedCollider::resolve(Simulation& simulation)
+{
+    int numParticles = static_cast<int>(simulation.getNumberOfParticles());
+
+    for (auto i = this->parts.begin(); i != this->parts.end(); i++) {
+
+        Part& part = **i;
+        ofVec4f origin(part.fieldOrigin.x, part.fieldOrigin.y, part.fieldOrigin.z, 0.0f);
+
+        this->resolveDistanceFieldKernel->setArg(0, simulation.getParameterBuffer());
+        this->resolveDistanceFieldKernel->setArg(1, simulation.getParticleBuffer());
+        this->resolveDistanceFieldKernel->setArg(2, numParticles);
+        this->resolveDistanceFieldKernel->setArg(3, part.field);
+        this->resolveDistanceFieldKernel->setArg(4, origin);
+        this->resolveDistanceFieldKernel->setArg(5, part.voxelSize);
+        this->resolveDistanceFieldKernel->setArg(6, part.dims, sizeof(part.dims));
+        this->resolveDistanceFieldKernel->setArg(7, part.band);
+        this->resolveDistanceFieldKernel->setArg(8, part.worldToField.getPtr(), 16 * sizeof(float));
+        this->resolveDistanceFieldKernel->setArg(9, part.fieldToWorld.getPtr(), 16 * sizeof(float));
+        this->resolveDistanceFieldKernel->setArg(10, part.fieldScale);
+        this->resolveDistanceFieldKernel->run1D(numParticles);
+    }
+}
+
+/**
+ * Draws the model as a wireframe, so the fluid stays visible
+ */
+void AnimatedCollider::draw()
+{
+    ofSetColor(255, 128, 0);
+    this->model.drawWireframe();
+}
+
+/******************************************************************************/
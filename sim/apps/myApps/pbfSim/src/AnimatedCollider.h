@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * AnimatedCollider.h
+ * - A collider built from an (optionally skinned and animated) Assimp model,
+ *   represented by per-part narrow band signed distance fields that are
+ *   refreshed on the GPU every step
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_ANIMATED_COLLIDER_H
+#define PBF_SIM_ANIMATED_COLLIDER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ofMain.h"
+#include "ofxAssimpModelLoader.h"
+#include "MSAOpenCL.h"
+#include "Collider.h"
+
+/******************************************************************************/
+
+/**
+ * Each mesh of the model becomes one part of the collider:
+ *
+ * - Rigid parts (meshes that are not skinned, or models without animations)
+ *   are voxelized once, in the mesh's local space. Every step only the
+ *   mesh's current local-to-world transform is updated, and particles are
+ *   transformed into local space to sample the cached field
+ *
+ * - Deforming (skinned) parts are re-voxelized every step in world space,
+ *   and only within a narrow band around the animated triangles
+ *
+ * Either way, resolving a particle costs a fixed 8 voxel reads
+ */
+class AnimatedCollider : public Collider
+{
+    private:
+        typedef struct {
+
+            // Index of the mesh in the model
+            int meshIndex;
+
+            // True if the part is skinned and must be re-voxelized
+            bool deforming;
+
+            int numTriangles;
+
+            // Triangle vertices and indices
+            // - Buffer of float4 / Buffer of int
+            msa::OpenCLBuffer vertices;
+            msa::OpenCLBuffer indices;
+
+            // Distance field voxels
+            // - Buffer of int
+            msa::OpenCLBuffer field;
+
+            // Staging area for animated vertex positions (deforming only)
+            std::vector<float4> hostVertices;
+
+            // Number of voxels the field buffer has room for
+            int capacity;
+
+            // Field geometry, in field space
+            ofVec3f fieldOrigin;
+            float voxelSize;
+            int dims[4];
+            float band;
+
+            // Field space <-> world space; identity for deforming parts
+            ofMatrix4x4 fieldToWorld;
+            ofMatrix4x4 worldToField;
+
+            // World units per field space unit, in the current transform
+            // and when the field was last sized (see sizeRigidField())
+            float fieldScale;
+            float builtScale;
+
+            // Bind pose bounds of the mesh, in field space (rigid only)
+            ofVec3f meshMin;
+            ofVec3f meshMax;
+
+        } Part;
+
+        msa::OpenCL& openCL;
+
+        ofxAssimpModelLoader model;
+
+        std::vector<std::shared_ptr<Part> > parts;
+
+        // Index of the animation that drives the model
+        int animationIndex;
+
+        // Simulated time, used to drive the animation in lockstep with
+        // the simulation rather than the wall clock
+        double time;
+
+        // Voxel edge length and half-width of the band, in world units
+        float voxelSize;
+        float bandWidth;
+
+        // Kernels, resolved once when they are loaded rather than looked up
+        // by name on every run
+        msa::OpenCLKernelPtr clearDistanceFieldKernel;
+        msa::OpenCLKernelPtr splatTriangleDistancesKernel;
+        msa::OpenCLKernelPtr resolveDistanceFieldKernel;
+
+        void loadKernels();
+
+        void setupPart(Part& part);
+
+        void sizeRigidField(Part& part);
+
+        void voxelizePart(Part& part);
+
+        void updateDeformingPart(Part& part);
+
+        ofMatrix4x4 getMeshToWorld(int meshIndex);
+
+    public:
+        // Upper bound on the number of voxels in a single part's field
+        static const int MAX_FIELD_VOXELS = 128 * 128 * 128;
+
+        AnimatedCollider(msa::OpenCL& openCL
+                        ,float voxelSize
+                        ,float bandWidth);
+
+        virtual ~AnimatedCollider();
+
+        bool load(const std::string& filename
+                 ,const ofVec3f& position
+                 ,float scale = 1.0f
+                 ,int animationIndex = 0);
+
+        ofxAssimpModelLoader& getModel() { return this->model; }
+
+        int getNumberOfParts() const { return static_cast<int>(this->parts.size()); }
+
+        void update(float dt);
+
+        void resolve(Simulation& simulation);
+
+        void draw();
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * BrickVolume.cpp
+ * - Random access reader for sparse brick volume files
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Poco/File.h"
+#include "Poco/SharedMemory.h"
+#include "BrickVolume.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+BrickVolumeReader::BrickVolumeReader() :
+    mapping(NULL),
+    header(NULL),
+    brickIndex(NULL),
+    voxels(NULL)
+{
+
+}
+
+BrickVolumeReader::~BrickVolumeReader()
+{
+    this->close();
+}
+
+/**
+ * Maps the given brick volume file, replacing any previously opened one
+ *
+ * @param [in] filename Path of the file, relative to the data folder
+ * @returns true if the file was mapped and has a valid header
+ */
+bool BrickVolumeReader::open(const string& filename)
+{
+    this->close();
+
+    string fullPath = ofToDataPath(filename);
+
+    try {
+
+        Poco::File file(fullPath);
+
+        if (!file.exists() || file.getSize() < sizeof(BrickVolumeHeader)) {
+            ofLogError() << "BrickVolumeReader: cannot read " << fullPath << endl;
+            return false;
+        }
+
+        size_t size   = static_cast<size_t>(file.getSize());
+        this->mapping = new Poco::SharedMemory(file, Poco::SharedMemory::AM_READ);
+
+        const char* base             = this->mapping->begin();
+        const BrickVolumeHeader* hdr = reinterpret_cast<const BrickVolumeHeader*>(base);
+
+        // Every count is checked before it is used in a size, so a corrupt
+        // header can't overflow the computations below. The brick index has
+        // to end before the voxels start, and the voxels before the file
+        // ends:
+
+        bool valid = memcmp(hdr->magic, "PBFBRICK", 8) == 0 &&
+                     hdr->brickSize > 0 && hdr->brickSize <= 64 &&
+                     hdr->bricksX > 0 && hdr->bricksY > 0 && hdr->bricksZ > 0 &&
+                     hdr->numBricks >= 0 &&
+                     hdr->dataOffset >= 0 && hdr->dataOffset % 16 == 0;
+
+        if (valid) {
+
+            size_t gridBricks = static_cast<size_t>(hdr->bricksX)
+                              * static_cast<size_t>(hdr->bricksY)
+                              * static_cast<size_t>(hdr->bricksZ);
+            size_t indexEnd   = sizeof(BrickVolumeHeader)
+                              + static_cast<size_t>(hdr->numBricks) * sizeof(int);
+            size_t voxelBytes = static_cast<size_t>(hdr->numBricks)
+                              * hdr->brickSize * hdr->brickSize * hdr->brickSize
+                              * sizeof(float4);
+
+            valid = static_cast<size_t>(hdr->numBricks) <= gridBricks &&
+                    static_cast<size_t>(hdr->dataOffset) >= indexEnd &&
+                    static_cast<size_t>(hdr->dataOffset) <= size &&
+                    voxelBytes <= size - static_cast<size_t>(hdr->dataOffset);
+        }
+
+        if (!valid) {
+            ofLogError() << "BrickVolumeReader: malformed brick volume " << fullPath << endl;
+            this->close();
+            return false;
+        }
+
+        this->header     = hdr;
+        this->brickIndex = reinterpret_cast<const int*>(base + sizeof(BrickVolumeHeader));
+        this->voxels     = reinterpret_cast<const float4*>(base + hdr->dataOffset);
+
+    } catch (Poco::Exception& e) {
+
+        ofLogError() << "BrickVolumeReader: " << e.displayText() << endl;
+        this->close();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Unmaps the current file, if any
+ */
+void BrickVolumeReader::close()
+{
+    delete this->mapping;
+
+    this->mapping    = NULL;
+    this->header     = NULL;
+    this->brickIndex = NULL;
+    this->voxels     = NULL;
+}
+
+/**
+ * Finds the position of brick (i,j,k) in the file's brick index
+ *
+ * @returns The position, or -1 if the brick is empty or out of range
+ */
+int BrickVolumeReader::findBrick(int i, int j, int k) const
+{
+    const BrickVolumeHeader& h = *this->header;
+
+    if (i < 0 || j < 0 || k < 0 || i >= h.bricksX || j >= h.bricksY || k >= h.bricksZ) {
+        return -1;
+    }
+
+    int key          = i + (j * h.bricksX) + (k * h.bricksX * h.bricksY);
+    const int* begin = this->brickIndex;
+    const int* end   = this->brickIndex + h.numBricks;
+    const int* found = lower_bound(begin, end, key);
+
+    return (found != end && *found == key) ? static_cast<int>(found - begin) : -1;
+}
+
+/**
+ * Returns a pointer to the brickSize^3 voxels of brick (i,j,k), or NULL if
+ * the brick is empty
+ */
+const float4* BrickVolumeReader::getBrick(int i, int j, int k) const
+{
+    int n = this->findBrick(i, j, k);
+
+    if (n < 0) {
+        return NULL;
+    }
+
+    int B = this->header->brickSize;
+
+    return this->voxels + (static_cast<size_t>(n) * B * B * B);
+}
+
+/**
+ * Returns voxel (x,y,z) of the whole volume; voxels in empty bricks are zero
+ */
+float4 BrickVolumeReader::getVoxel(int x, int y, int z) const
+{
+    if (x < 0 || y < 0 || z < 0) {
+        return float4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    int B               = this->header->brickSize;
+    const float4* brick = this->getBrick(x / B, y / B, z / B);
+
+    if (brick == NULL) {
+        return float4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    return brick[(x % B) + ((y % B) * B) + ((z % B) * B * B)];
+}
+
+/**
+ * Returns the voxel containing the world space position p
+ */
+float4 BrickVolumeReader::sample(const ofVec3f& p) const
+{
+    const BrickVolumeHeader& h = *this->header;
+
+    int x = static_cast<int>(floor((p.x - h.origin[0]) / h.voxelSize));
+    int y = static_cast<int>(floor((p.y - h.origin[1]) / h.voxelSize));
+    int z = static_cast<int>(floor((p.z - h.origin[2]) / h.voxelSize));
+
+    return this->getVoxel(x, y, z);
+}
+
+/******************************************************************************/
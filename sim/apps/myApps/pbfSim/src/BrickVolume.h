@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * BrickVolume.h
+ * - On-disk layout of the sparse brick volumes written by VolumeExporter, and
+ *   a reader providing random access to individual bricks and voxels
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_BRICK_VOLUME_H
+#define PBF_SIM_BRICK_VOLUME_H
+
+#include <string>
+#include "ofMain.h"
+#include "MSAOpenCL.h"
+
+namespace Poco { class SharedMemory; }
+
+/******************************************************************************/
+
+// A brick volume file consists of the following, in order:
+//
+// 1) A BrickVolumeHeader
+// 2) numBricks ints: the linear indices (i + j*bricksX + k*bricksX*bricksY)
+//    of the stored bricks, in ascending order
+// 3) Starting at dataOffset (16 byte aligned), numBricks * BRICK_SIZE^3
+//    float4 voxels, brick after brick in the same order as the index. Within
+//    a brick, voxels are stored x-fastest, and each voxel is the tuple
+//    (vx, vy, vz, density)
+//
+// Bricks that are not listed in the index are empty (all zeros). All values
+// are stored in host byte order
+
+typedef struct {
+
+    char magic[8];        // "PBFBRICK"
+
+    int version;
+
+    int brickSize;        // Voxels per brick edge
+
+    int bricksX;          // Bricks per axis covering the whole volume
+    int bricksY;
+    int bricksZ;
+
+    int numBricks;        // Number of stored (non-empty) bricks
+
+    int frameNumber;      // Simulation frame the volume was taken from
+
+    int dataOffset;       // Byte offset of the first voxel
+
+    float voxelSize;      // Edge length of a voxel in world units
+
+    float origin[3];      // World position of the volume's minimum corner
+
+} BrickVolumeHeader;
+
+/******************************************************************************/
+
+/**
+ * Memory maps a brick volume file for random access. Looking up a brick is a
+ * binary search over the brick index, and bricks are returned as pointers
+ * into the mapping, so nothing is copied
+ */
+class BrickVolumeReader
+{
+    private:
+        Poco::SharedMemory* mapping;
+
+        const BrickVolumeHeader* header;
+
+        const int* brickIndex;
+
+        const float4* voxels;
+
+        // Disallow copying; the reader owns the mapping
+        BrickVolumeReader(const BrickVolumeReader&);
+        BrickVolumeReader& operator=(const BrickVolumeReader&);
+
+    public:
+        BrickVolumeReader();
+        virtual ~BrickVolumeReader();
+
+        bool open(const std::string& filename);
+        void close();
+
+        bool isOpen() const { return this->header != NULL; }
+
+        const BrickVolumeHeader& getHeader() const { return *this->header; }
+
+        int getNumberOfBricks() const { return this->header->numBricks; }
+
+        int findBrick(int i, int j, int k) const;
+
+        const float4* getBrick(int i, int j, int k) const;
+
+        float4 getVoxel(int x, int y, int z) const;
+
+        float4 sample(const ofVec3f& p) const;
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,46 @@
+/*******************************************************************************
+ * Collider.h
+ * - Interface for obstacles the fluid collides against
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_COLLIDER_H
+#define PBF_SIM_COLLIDER_H
+
+/******************************************************************************/
+
+class Simulation;
+
+/**
+ * A collider is registered with a Simulation via Simulation::addCollider().
+ * Once per step, before the solver runs, update() is called so the collider
+ * can advance its animation and refresh any device-side state. Then, in every
+ * solver iteration, resolve() is called to push the particles' predicted
+ * positions out of the collider
+ */
+class Collider
+{
+    public:
+        virtual ~Collider() { }
+
+        /**
+         * Advances the collider by one time step of length dt
+         */
+        virtual void update(float dt) = 0;
+
+        /**
+         * Resolves penetrations of the simulation's particles (on the device)
+         */
+        virtual void resolve(Simulation& simulation) = 0;
+
+        /**
+         * Draws the collider; optional
+         */
+        virtual void draw() { }
+};
+
+/******************************************************************************/
+
+#endif
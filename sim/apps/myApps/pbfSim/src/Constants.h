@@ -7,7 +7,7 @@
 #ifndef PBF_SIM_CONSTANTS_H
 #define PBF_SIM_CONSTANTS_H
 
-#include "Parameters.h"
+#include "pbf/Parameters.h"
 
 /******************************************************************************/
 
@@ -18,6 +18,22 @@
 // If defined, a simple test scene will be used for rendering
 //#define SIMPLE_SCENE 1
 
+// If defined, the initial particle states will be imported from the given
+// point cloud file (PLY or CSV, relative to the data folder) instead of being
+// placed randomly:
+
+//#define INITIAL_STATE_FILE "scenes/initial.ply"
+
+// If defined, the given model (relative to the data folder) is loaded as an
+// animated collider; skinned meshes in it will deform with its animation:
+
+//#define ANIMATED_COLLIDER_FILE "models/collider.dae"
+
+// If defined, the given model is loaded as a triangle mesh collider. Use this
+// for thin or open geometry (sheets, pipes) that distance fields can't resolve:
+
+//#define MESH_COLLIDER_FILE "models/sheet.obj"
+
 // If defined, mesh spheres will be drawn for the particles, otherwise
 // faster OpenGL points will be used:
 
@@ -27,6 +43,12 @@
     #define DRAW_PARTICLES_AS_SPHERES 1
 #endif
 
+// If defined, the global operator new is replaced by one that counts calls,
+// for pbfSim --count-allocations. Every allocation then pays for an atomic
+// increment, so it is left out of normal builds:
+
+//#define COUNT_ALLOCATIONS 1
+
 // If defined, the simulation will produce better results at the expense of
 // speed
 
@@ -86,6 +108,177 @@ const int PARTICLES_PER_CELL_Z = 3;
 const int PARTICLES_PER_CELL_Z = 2;
 #endif
 
+/**
+ * Edge length of a voxel, in world units, of collider distance fields
+ */
+const float COLLIDER_VOXEL_SIZE = 0.25f;
+
+/**
+ * Distance from a collider's surface, in world units, up to which its
+ * distance field is populated. Particles further inside a collider than this
+ * are not resolved
+ */
+const float COLLIDER_BAND_WIDTH = 2.0f;
+
+/**
+ * Extra thickness, in world units, given to the triangles of mesh colliders
+ */
+const float MESH_COLLIDER_THICKNESS = 0.05f;
+
+/**
+ * Edge length of a voxel, in world units, used when exporting the density
+ * and velocity fields as a sparse brick volume
+ */
+const float VOLUME_VOXEL_SIZE = 0.5f;
+
+/**
+ * Directory (relative to the data folder) exported volumes are written to
+ */
+const char* const VOLUME_EXPORT_DIR = "volumes";
+
+/**
+ * Name of the POSIX shared memory object finished frames are published to
+ * for external renderers. See pbf/FrameRing.h
+ */
+const char* const FRAME_RING_NAME = "/pbfSim-frames";
+
+/**
+ * Number of frames kept in the shared memory ring. A reader that falls more
+ * than this many frames behind skips ahead to the latest one
+ */
+const int FRAME_RING_SLOTS = 4;
+
+/**
+ * Ring file (relative to the data folder) recorded frames are written to
+ * for playback, and the number of frames it keeps. Every frame takes about
+ * 52 bytes per particle, so at 1M particles the default keeps ~15GB on disk
+ */
+const char* const PLAYBACK_FILE = "playback.ring";
+
+const int PLAYBACK_FRAMES = 300;
+
+/**
+ * Number of upcoming frames the playback prefetch thread keeps staged in
+ * host memory, and the frames skipped by a coarse scrub ('[' and ']')
+ */
+const int PLAYBACK_PREFETCH_FRAMES = 8;
+
+const int PLAYBACK_SCRUB_FRAMES = 30;
+
+/**
+ * Port the local simulation job server listens on. See JobServer.h
+ */
+const int JOB_SERVER_PORT = 8563;
+
+/**
+ * Number of headless simulations the job server runs at once
+ */
+const int JOB_SERVER_WORKERS = 2;
+
+/**
+ * Largest particle count a submitted job may ask for
+ */
+const int JOB_MAX_PARTICLES = 1 << 20;
+
+/**
+ * Number of finished (done, failed or cancelled) jobs the job server keeps,
+ * results included; older ones are forgotten as new ones finish
+ */
+const int JOB_SERVER_RETAINED_JOBS = 64;
+
+/**
+ * Roofline report written while roofline profiling is on (relative to the
+ * data folder), and the number of steps each report covers
+ */
+const char* const ROOFLINE_FILE = "roofline.json";
+
+const int ROOFLINE_REPORT_STEPS = 30;
+
+/**
+ * The flight recorder keeps the frame, step and stage timings of the last
+ * FLIGHT_RECORDER_FRAMES frames (a few seconds), and dumps them to
+ * FLIGHT_RECORDER_DIR (relative to the data folder) when a frame takes more
+ * than SPIKE_FRAME_MS, or SPIKE_MEDIAN_FACTOR times the median frame time,
+ * whichever is larger. After a dump, the ring is refilled before the next
+ */
+const char* const FLIGHT_RECORDER_DIR = "flightrecorder";
+
+const int FLIGHT_RECORDER_FRAMES = 300;
+
+const float SPIKE_FRAME_MS = 50.0f;
+
+const float SPIKE_MEDIAN_FACTOR = 3.0f;
+
+/**
+ * Interval at which the heads up display text is re-rendered, for the values
+ * that change every frame (frame rate, timings)
+ */
+const float HUD_REFRESH_SECONDS = 0.25f;
+
+/**
+ * Allocation counting mode (pbfSim --count-allocations): frames run before
+ * counting starts, and frames that must then be allocation-free
+ */
+const int ALLOCATION_WARMUP_FRAMES = 300;
+
+const int ALLOCATION_COUNT_FRAMES = 600;
+
+/**
+ * Folder (relative to the data folder) recorded session logs are written
+ * to, and the random seed the simulation is reset with when recording
+ * starts, so replays begin from the same initial state
+ */
+const char* const SESSION_LOG_DIR = "sessions";
+
+const int SESSION_SEED = 563;
+
+/**
+ * Strength (acceleration at the axis) of the vortex field 'f' stirs the
+ * fluid with, about the vertical axis through the center of the bounds. It
+ * falls off to zero at STIR_RADIUS_FRACTION of the bounds' narrower
+ * horizontal extent from the axis
+ */
+const float STIR_STRENGTH = 20.0f;
+
+const float STIR_RADIUS_FRACTION = 0.5f;
+
+/**
+ * Frame time governor ('t'). It aims for frames of GOVERNOR_TARGET_MS, by
+ * trading quality for time within these bounds: solver iterations, substeps
+ * per frame (each taking an equal share of the time step), drawing every
+ * Nth particle, and collecting stage timings (and refreshing the heads up
+ * display) only every Nth frame
+ */
+const float GOVERNOR_TARGET_MS = 1000.0f / 60.0f;
+
+const int GOVERNOR_MIN_SOLVER_ITERATIONS = 1;
+const int GOVERNOR_MAX_SOLVER_ITERATIONS = 6;
+
+const int GOVERNOR_MIN_SUBSTEPS = 1;
+const int GOVERNOR_MAX_SUBSTEPS = 3;
+
+const int GOVERNOR_MIN_RENDER_STRIDE = 1;
+const int GOVERNOR_MAX_RENDER_STRIDE = 4;
+
+const int GOVERNOR_MIN_STATS_INTERVAL = 1;
+const int GOVERNOR_MAX_STATS_INTERVAL = 16;
+
+/**
+ * The governor lowers quality when the smoothed frame time exceeds the
+ * target by GOVERNOR_DOWNGRADE_FACTOR, and raises it when the frame is
+ * predicted to take less than GOVERNOR_UPGRADE_FACTOR of the target
+ * afterwards. Frame times are smoothed exponentially by GOVERNOR_SMOOTHING,
+ * and after every change it waits GOVERNOR_SETTLE_FRAMES stepped frames for
+ * the new timings to show
+ */
+const float GOVERNOR_DOWNGRADE_FACTOR = 1.05f;
+
+const float GOVERNOR_UPGRADE_FACTOR = 0.8f;
+
+const float GOVERNOR_SMOOTHING = 0.1f;
+
+const int GOVERNOR_SETTLE_FRAMES = 20;
+
 /******************************************************************************/
 
 /**
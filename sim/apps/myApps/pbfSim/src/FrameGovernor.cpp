@@ -0,0 +1,208 @@
+/*******************************************************************************
+ * FrameGovernor.cpp
+ * - Holds the frame time to a target by adjusting the quality knobs of the
+ *   simulation and its display within configured bounds
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include "ofMain.h"
+#include "Constants.h"
+#include "FrameGovernor.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+/**
+ * Takes over the quality knobs of the simulation, starting from its current
+ * settings (clamped to the budget's bounds)
+ *
+ * @param [in] _simulation The simulation to govern
+ * @param [in] _budget Target frame time and the bounds of every knob
+ */
+FrameGovernor::FrameGovernor(Simulation& _simulation, const FrameBudget& _budget) :
+    simulation(_simulation),
+    budget(_budget),
+    originalDt(_simulation.getTimeStep()),
+    frameMs(0.0),
+    stepMs(0.0),
+    drawMs(0.0),
+    framesSinceChange(0),
+    downgrades(0),
+    upgrades(0)
+{
+    this->original.solverIterations = this->simulation.getSolver().getSolverIterations();
+    this->original.substeps         = 1;
+    this->original.renderStride     = this->simulation.getRenderStride();
+    this->original.statsInterval    = 1;
+
+    this->settings = this->clamp(this->original);
+    this->apply();
+}
+
+/**
+ * Hands the knobs back as they were
+ */
+FrameGovernor::~FrameGovernor()
+{
+    this->simulation.getSolver().setSolverIterations(this->original.solverIterations);
+    this->simulation.setTimeStep(this->originalDt);
+    this->simulation.setRenderStride(this->original.renderStride);
+}
+
+/**
+ * Limits every knob to the budget's bounds
+ */
+QualitySettings FrameGovernor::clamp(const QualitySettings& quality) const
+{
+    const QualitySettings& lo = this->budget.lowest;
+    const QualitySettings& hi = this->budget.highest;
+
+    QualitySettings result;
+
+    result.solverIterations = min(max(quality.solverIterations, lo.solverIterations), hi.solverIterations);
+    result.substeps         = min(max(quality.substeps, lo.substeps), hi.substeps);
+    result.renderStride     = min(max(quality.renderStride, hi.renderStride), lo.renderStride);
+    result.statsInterval    = min(max(quality.statsInterval, hi.statsInterval), lo.statsInterval);
+
+    return result;
+}
+
+/**
+ * Predicts the host time of a frame (steps and drawing) with the given
+ * settings, by scaling the measured timings of the current ones
+ */
+double FrameGovernor::predictMs(const QualitySettings& quality) const
+{
+    double work    = quality.substeps * (quality.solverIterations + 1.0);
+    double current = this->settings.substeps * (this->settings.solverIterations + 1.0);
+
+    return this->stepMs * work / current
+         + this->drawMs * this->settings.renderStride / quality.renderStride;
+}
+
+/**
+ * Lowers the knob whose loss is least visible. Returns false if every knob
+ * is at its lowest
+ */
+bool FrameGovernor::downgrade()
+{
+    const QualitySettings& lo = this->budget.lowest;
+    QualitySettings& q        = this->settings;
+    string knob;
+    int value = 0;
+
+    if (q.statsInterval < lo.statsInterval) {
+        q.statsInterval = min(q.statsInterval * 2, lo.statsInterval);
+        knob  = "stats interval";
+        value = q.statsInterval;
+    } else if (q.substeps > lo.substeps) {
+        knob  = "substeps";
+        value = --q.substeps;
+    } else if (q.solverIterations > lo.solverIterations) {
+        knob  = "solver iterations";
+        value = --q.solverIterations;
+    } else if (q.renderStride < lo.renderStride) {
+        knob  = "render stride";
+        value = ++q.renderStride;
+    } else {
+        return false;
+    }
+
+    this->lastDecision = ofVAArgsToString("lowered %s to %d (frame %.1f ms)", knob.c_str(), value, this->frameMs);
+    this->downgrades++;
+
+    return true;
+}
+
+/**
+ * Raises the knob whose loss is most visible, if the frame is predicted to
+ * stay well within the target afterwards. Returns false if nothing changed
+ */
+bool FrameGovernor::upgrade()
+{
+    const QualitySettings& hi = this->budget.highest;
+    QualitySettings next      = this->settings;
+    string knob;
+    int value = 0;
+
+    if (next.renderStride > hi.renderStride) {
+        knob  = "render stride";
+        value = --next.renderStride;
+    } else if (next.solverIterations < hi.solverIterations) {
+        knob  = "solver iterations";
+        value = ++next.solverIterations;
+    } else if (next.substeps < hi.substeps) {
+        knob  = "substeps";
+        value = ++next.substeps;
+    } else if (next.statsInterval > hi.statsInterval) {
+        next.statsInterval = max(next.statsInterval / 2, hi.statsInterval);
+        knob  = "stats interval";
+        value = next.statsInterval;
+    } else {
+        return false;
+    }
+
+    double predicted = this->predictMs(next);
+
+    if (predicted >= this->budget.targetMs * Constants::GOVERNOR_UPGRADE_FACTOR) {
+        return false;
+    }
+
+    this->settings     = next;
+    this->lastDecision = ofVAArgsToString("raised %s to %d (predicted %.1f ms)", knob.c_str(), value, predicted);
+    this->upgrades++;
+
+    return true;
+}
+
+/**
+ * Applies the knobs that belong to the simulation. Substeps divide the time
+ * step the simulation had, so a frame covers the same simulated time
+ */
+void FrameGovernor::apply()
+{
+    this->simulation.getSolver().setSolverIterations(this->settings.solverIterations);
+    this->simulation.setTimeStep(this->originalDt / this->settings.substeps);
+    this->simulation.setRenderStride(this->settings.renderStride);
+}
+
+bool FrameGovernor::update(bool stepped, double _frameMs, double _stepMs, double _drawMs)
+{
+    if (!stepped) {
+        return false;
+    }
+
+    // Smooth the timings; the first frame seeds them:
+
+    float a = this->frameMs > 0.0 ? Constants::GOVERNOR_SMOOTHING : 1.0f;
+
+    this->frameMs += a * (_frameMs - this->frameMs);
+    this->stepMs  += a * (_stepMs - this->stepMs);
+    this->drawMs  += a * (_drawMs - this->drawMs);
+
+    if (++this->framesSinceChange < Constants::GOVERNOR_SETTLE_FRAMES) {
+        return false;
+    }
+
+    // The frame time is what has to fit, but with vertical sync it doesn't
+    // drop below the refresh interval, so only the host time shows room to
+    // spare:
+
+    bool over    = max(this->frameMs, this->stepMs + this->drawMs) > this->budget.targetMs * Constants::GOVERNOR_DOWNGRADE_FACTOR;
+    bool changed = over ? this->downgrade() : this->upgrade();
+
+    if (changed) {
+        this->apply();
+        this->framesSinceChange = 0;
+    }
+
+    return changed;
+}
+
+/******************************************************************************/
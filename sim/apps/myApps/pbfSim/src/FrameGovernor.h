@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * FrameGovernor.h
+ * - Holds the frame time to a target by adjusting the quality knobs of the
+ *   simulation and its display within configured bounds: solver iterations,
+ *   substeps per frame, render level of detail and how often statistics are
+ *   collected
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_FRAME_GOVERNOR_H
+#define PBF_SIM_FRAME_GOVERNOR_H
+
+#include <string>
+#include "Simulation.h"
+
+/******************************************************************************/
+
+/**
+ * The quality knobs the governor turns
+ */
+typedef struct {
+
+    int solverIterations;
+
+    int substeps;                     // Solver steps per frame, each taking
+                                      // an equal share of the time step
+
+    int renderStride;                 // Every Nth particle is drawn
+
+    int statsInterval;                // Stage timings are collected, and
+                                      // the HUD refreshed, every Nth frame
+
+} QualitySettings;
+
+/**
+ * The frame time to aim for, and the bounds of every knob
+ */
+typedef struct {
+
+    float targetMs;
+
+    QualitySettings lowest;
+
+    QualitySettings highest;
+
+} FrameBudget;
+
+/******************************************************************************/
+
+/**
+ * Fed the timings of every frame (see ofApp::update and ofApp::draw). When
+ * the smoothed frame time runs over the target, one knob is lowered, in the
+ * order the loss is least visible: statistics first, then substeps, solver
+ * iterations and finally the render level of detail. When there is room,
+ * knobs are raised in the opposite order, but only if a simple cost model
+ * predicts the frame will still fit: step time scales with
+ * substeps * (iterations + 1), draw time with the number of particles drawn.
+ * After every change the governor waits for the timings to settle, so it
+ * doesn't oscillate between two settings
+ *
+ * Iterations, time step and render stride are applied to the simulation
+ * directly; the app reads substeps and statsInterval back for its loop
+ */
+class FrameGovernor
+{
+    private:
+        Simulation& simulation;
+
+        FrameBudget budget;
+
+        // What the simulation ran with before, restored by the destructor
+        QualitySettings original;
+        float originalDt;
+
+        QualitySettings settings;
+
+        // Smoothed timings of the stepped frames; zero until the first
+        double frameMs;
+        double stepMs;
+        double drawMs;
+
+        int framesSinceChange;
+
+        unsigned int downgrades;
+        unsigned int upgrades;
+
+        std::string lastDecision;
+
+        // Non-copyable
+        FrameGovernor(const FrameGovernor&);
+        FrameGovernor& operator=(const FrameGovernor&);
+
+        QualitySettings clamp(const QualitySettings& quality) const;
+        double predictMs(const QualitySettings& quality) const;
+        bool downgrade();
+        bool upgrade();
+        void apply();
+
+    public:
+        FrameGovernor(Simulation& simulation, const FrameBudget& budget);
+
+        virtual ~FrameGovernor();
+
+        /**
+         * Adds the timings of a frame and adjusts the knobs if needed.
+         * Returns true if any knob changed
+         *
+         * @param [in] stepped Whether the simulation stepped; frames that
+         *             didn't are ignored
+         * @param [in] frameMs Time between the last two frames
+         * @param [in] stepMs Host time of the frame's steps
+         * @param [in] drawMs Host time of drawing the particles
+         */
+        bool update(bool stepped, double frameMs, double stepMs, double drawMs);
+
+        const FrameBudget& getBudget() const       { return this->budget; }
+        const QualitySettings& getSettings() const { return this->settings; }
+
+        double getFrameMs() const { return this->frameMs; }
+        double getStepMs() const  { return this->stepMs; }
+        double getDrawMs() const  { return this->drawMs; }
+
+        // Predicted time of a frame with the current settings
+        double getPredictedMs() const { return this->predictMs(this->settings); }
+
+        unsigned int getDowngrades() const { return this->downgrades; }
+        unsigned int getUpgrades() const   { return this->upgrades; }
+
+        // e.g. "lowered substeps to 1 (frame 18.2 ms)"
+        const std::string& getLastDecision() const { return this->lastDecision; }
+};
+
+/******************************************************************************/
+
+#endif
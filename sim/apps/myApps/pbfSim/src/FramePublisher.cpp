@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * FramePublisher.cpp
+ * - Publishes every finished frame of a simulation to a shared memory frame
+ *   ring, where external processes (e.g. an offline renderer) can map it, or
+ *   to a ring file that keeps the last frames of a run for playback
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "FramePublisher.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+/**
+ * Creates the ring, sized for the simulation's particle count
+ *
+ * @param [in] simulation The simulation whose frames are published
+ * @param [in] name Shared memory object name, starting with '/', or the
+ *             path of the ring file if onDisk is set
+ * @param [in] numSlots Number of frames kept in the ring
+ * @param [in] onDisk If true, the ring is a file (see
+ *             pbf::FrameRingWriter::createFile)
+ */
+FramePublisher::FramePublisher(Simulation& _simulation
+                              ,const string& name
+                              ,int numSlots
+                              ,bool onDisk) :
+    simulation(_simulation),
+    published(0)
+{
+    int maxParticles = this->simulation.getNumberOfParticles();
+    bool created     = onDisk ? this->ring.createFile(name, numSlots, maxParticles)
+                              : this->ring.create(name, numSlots, maxParticles);
+
+    if (!created) {
+        ofLogError() << "Couldn't create frame ring " << name << endl;
+    }
+}
+
+FramePublisher::~FramePublisher()
+{
+    this->ring.close();
+}
+
+/**
+ * Publishes the results of the simulation's last step. The device buffers
+ * are read directly into the ring's next slot, so there is no intermediate
+ * copy
+ */
+bool FramePublisher::publishFrame()
+{
+    int n = this->simulation.getNumberOfParticles();
+
+    if (!this->ring.isOpen() || n > this->ring.getMaxParticles()) {
+        return false;
+    }
+
+    pbf::Particle* particles = NULL;
+    float* density           = NULL;
+
+    if (!this->ring.beginFrame(particles, density)) {
+        return false;
+    }
+
+    this->simulation.getParticleBuffer().getCLBuffer().read(particles, 0, n * sizeof(pbf::Particle));
+    this->simulation.getDensityBuffer().read(density, 0, n * sizeof(float));
+
+    this->ring.endFrame(this->simulation.getFrameNumber()
+                       ,n
+                       ,this->simulation.getSolver().getBounds());
+
+    this->published++;
+
+    return true;
+}
+
+/******************************************************************************/
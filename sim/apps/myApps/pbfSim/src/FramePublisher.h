@@ -0,0 +1,51 @@
+/*******************************************************************************
+ * FramePublisher.h
+ * - Publishes every finished frame of a simulation to a shared memory frame
+ *   ring, where external processes (e.g. an offline renderer) can map it, or
+ *   to a ring file that keeps the last frames of a run for playback
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_FRAME_PUBLISHER_H
+#define PBF_SIM_FRAME_PUBLISHER_H
+
+#include <string>
+#include "pbf/FrameRing.h"
+#include "Simulation.h"
+
+/******************************************************************************/
+
+/**
+ * Reads the particles and densities of the last step straight into the next
+ * slot of a pbf::FrameRingWriter. Publishing never waits on readers
+ */
+class FramePublisher
+{
+    private:
+        Simulation& simulation;
+
+        pbf::FrameRingWriter ring;
+
+        // Number of frames published
+        unsigned long long published;
+
+    public:
+        FramePublisher(Simulation& simulation
+                      ,const std::string& name
+                      ,int numSlots
+                      ,bool onDisk = false);
+
+        virtual ~FramePublisher();
+
+        bool isOpen() const { return this->ring.isOpen(); }
+
+        unsigned long long getPublishedCount() const { return this->published; }
+
+        bool publishFrame();
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,710 @@
+/*******************************************************************************
+ * JobServer.cpp
+ * - A local HTTP service that accepts simulation jobs, queues them by
+ *   priority and runs them on a pool of headless pbf::Session workers
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <sstream>
+#include "Poco/Thread.h"
+#include "Poco/URI.h"
+#include "Poco/Net/HTMLForm.h"
+#include "Poco/Net/HTTPRequestHandler.h"
+#include "Poco/Net/HTTPRequestHandlerFactory.h"
+#include "Poco/Net/HTTPServerParams.h"
+#include "Poco/Net/HTTPServerRequest.h"
+#include "Poco/Net/HTTPServerResponse.h"
+#include "Poco/Net/ServerSocket.h"
+#include "JobServer.h"
+#include "Constants.h"
+
+/******************************************************************************/
+
+using namespace std;
+using Poco::Net::HTTPResponse;
+using Poco::Net::HTTPServerRequest;
+using Poco::Net::HTTPServerResponse;
+
+/******************************************************************************/
+
+namespace {
+
+// How often progress streams poll their job
+const long PROGRESS_INTERVAL_MS = 100;
+
+const char* statusName(JobStatus status)
+{
+    switch (status) {
+        case JOB_QUEUED:  return "queued";
+        case JOB_RUNNING: return "running";
+        case JOB_DONE:    return "done";
+        case JOB_FAILED:  return "failed";
+        default:          return "cancelled";
+    }
+}
+
+string toJson(const Job& job)
+{
+    ostringstream json;
+
+    json << "{\"id\":" << job.id
+         << ",\"status\":\"" << statusName(job.status) << "\""
+         << ",\"priority\":" << job.priority
+         << ",\"particles\":" << job.numParticles
+         << ",\"steps\":" << job.steps
+         << ",\"stepsDone\":" << job.stepsDone
+         << ",\"parameters\":{"
+         <<     "\"particleRadius\":" << job.parameters.particleRadius
+         <<     ",\"smoothingRadius\":" << job.parameters.smoothingRadius
+         <<     ",\"relaxation\":" << job.parameters.relaxation
+         <<     ",\"artificialPressureK\":" << job.parameters.artificialPressureK
+         <<     ",\"artificialPressureN\":" << job.parameters.artificialPressureN
+         <<     ",\"vorticityEpsilon\":" << job.parameters.vorticityEpsilon
+         <<     ",\"viscosityCoeff\":" << job.parameters.viscosityCoeff
+         << "}"
+         << ",\"metrics\":{"
+         <<     "\"worker\":" << job.metrics.worker
+         <<     ",\"reusedBuffers\":" << (job.metrics.reusedBuffers ? "true" : "false")
+         <<     ",\"queuedMs\":" << job.metrics.queuedMs
+         <<     ",\"setupMs\":" << job.metrics.setupMs
+         <<     ",\"msPerStep\":" << job.metrics.msPerStep
+         <<     ",\"totalMs\":" << job.metrics.totalMs
+         <<     ",\"meanDensity\":" << job.metrics.stats.meanDensity
+         <<     ",\"maxDensity\":" << job.metrics.stats.maxDensity
+         <<     ",\"meanSpeed\":" << job.metrics.stats.meanSpeed
+         <<     ",\"maxSpeed\":" << job.metrics.stats.maxSpeed
+         << "}}";
+
+    return json.str();
+}
+
+void sendText(HTTPServerResponse& response
+             ,HTTPResponse::HTTPStatus status
+             ,const string& contentType
+             ,const string& body)
+{
+    response.setStatus(status);
+    response.setContentType(contentType);
+    response.setContentLength(body.size());
+    response.send() << body;
+}
+
+void sendError(HTTPServerResponse& response, HTTPResponse::HTTPStatus status, const string& message)
+{
+    sendText(response, status, "application/json", "{\"error\":\"" + message + "\"}");
+}
+
+/**
+ * Builds a job from the fields of a submission form; see JobServer
+ */
+bool parseJob(const Poco::Net::HTMLForm& form, int maxParticles, Job& job, string& error)
+{
+    const Parameters& defaults = Constants::DEFAULT_PARAMS;
+
+    job.priority         = ofToInt(form.get("priority", "0"));
+    job.numParticles     = ofToInt(form.get("particles", ofToString(Constants::DEFAULT_NUM_PARTICLES)));
+    job.steps            = ofToInt(form.get("steps", "100"));
+    job.dt               = ofToFloat(form.get("dt", ofToString(Constants::DEFAULT_DT)));
+    job.solverIterations = ofToInt(form.get("iterations", "3"));
+    job.seed             = static_cast<unsigned int>(ofToInt(form.get("seed", "1")));
+
+    job.parameters = Parameters(ofToFloat(form.get("particleRadius", ofToString(defaults.particleRadius)))
+                               ,ofToFloat(form.get("smoothingRadius", ofToString(defaults.smoothingRadius)))
+                               ,ofToFloat(form.get("relaxation", ofToString(defaults.relaxation)))
+                               ,ofToFloat(form.get("artificialPressureK", ofToString(defaults.artificialPressureK)))
+                               ,ofToFloat(form.get("artificialPressureN", ofToString(defaults.artificialPressureN)))
+                               ,ofToFloat(form.get("vorticityEpsilon", ofToString(defaults.vorticityEpsilon)))
+                               ,ofToFloat(form.get("viscosityCoeff", ofToString(defaults.viscosityCoeff))));
+
+    vector<string> bounds = ofSplitString(form.get("bounds", "-30,-10,-10,30,80,10"), ",", true, true);
+
+    if (bounds.size() != 6) {
+        error = "bounds must be 6 comma-separated values";
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        job.bounds.min[i] = ofToFloat(bounds[i]);
+        job.bounds.max[i] = ofToFloat(bounds[i + 3]);
+
+        if (job.bounds.max[i] <= job.bounds.min[i]) {
+            error = "bounds are empty";
+            return false;
+        }
+    }
+
+    if (job.numParticles <= 0 || job.numParticles > maxParticles) {
+        error = "particles must be between 1 and " + ofToString(maxParticles);
+        return false;
+    }
+
+    if (job.steps <= 0 || job.dt <= 0.0f || job.solverIterations <= 0 || job.parameters.particleRadius <= 0.0f) {
+        error = "steps, dt, iterations and particleRadius must be positive";
+        return false;
+    }
+
+    return true;
+}
+
+/******************************************************************************/
+
+class JobRequestHandler : public Poco::Net::HTTPRequestHandler
+{
+    private:
+        JobServer& server;
+
+        void streamProgress(int id, HTTPServerResponse& response);
+
+        void sendResults(int id, const string& what, HTTPServerResponse& response);
+
+    public:
+        JobRequestHandler(JobServer& _server) : server(_server) { }
+
+        void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response);
+};
+
+void JobRequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerResponse& response)
+{
+    vector<string> path = ofSplitString(Poco::URI(request.getURI()).getPath(), "/", true, true);
+    string method       = request.getMethod();
+
+    if (path.size() == 1 && path[0] == "metrics" && method == "GET") {
+        sendText(response, HTTPResponse::HTTP_OK, "application/json", this->server.metricsToJson());
+        return;
+    }
+
+    if (path.empty() || path[0] != "jobs") {
+        sendError(response, HTTPResponse::HTTP_NOT_FOUND, "not found");
+        return;
+    }
+
+    // /jobs
+
+    if (path.size() == 1) {
+
+        if (method == "GET") {
+            sendText(response, HTTPResponse::HTTP_OK, "application/json", this->server.jobsToJson());
+            return;
+        }
+
+        if (method != "POST") {
+            sendError(response, HTTPResponse::HTTP_METHOD_NOT_ALLOWED, "use GET or POST");
+            return;
+        }
+
+        Poco::Net::HTMLForm form(request, request.stream());
+        shared_ptr<Job> job(new Job());
+        string error;
+
+        if (!parseJob(form, this->server.getMaxParticles(), *job, error)) {
+            sendError(response, HTTPResponse::HTTP_BAD_REQUEST, error);
+            return;
+        }
+
+        int id = this->server.submit(job);
+
+        sendText(response, HTTPResponse::HTTP_ACCEPTED, "application/json", this->server.jobToJson(id));
+        return;
+    }
+
+    // /jobs/<id>[/progress|/particles|/density]
+
+    int id = ofToInt(path[1]);
+    Job job;
+
+    if (method != "GET") {
+        sendError(response, HTTPResponse::HTTP_METHOD_NOT_ALLOWED, "use GET");
+    } else if (!this->server.getJob(id, job)) {
+        sendError(response, HTTPResponse::HTTP_NOT_FOUND, "no such job");
+    } else if (path.size() == 2) {
+        sendText(response, HTTPResponse::HTTP_OK, "application/json", this->server.jobToJson(id));
+    } else if (path.size() == 3 && path[2] == "progress") {
+        this->streamProgress(id, response);
+    } else if (path.size() == 3 && (path[2] == "particles" || path[2] == "density")) {
+        this->sendResults(id, path[2], response);
+    } else {
+        sendError(response, HTTPResponse::HTTP_NOT_FOUND, "not found");
+    }
+}
+
+/**
+ * Writes a line of JSON whenever the job has progressed, until it is done
+ */
+void JobRequestHandler::streamProgress(int id, HTTPServerResponse& response)
+{
+    response.setChunkedTransferEncoding(true);
+    response.setContentType("application/x-ndjson");
+
+    ostream& out  = response.send();
+    int lastSteps = -1;
+    Job job;
+
+    while (this->server.getJob(id, job)) {
+
+        bool finished = job.status != JOB_QUEUED && job.status != JOB_RUNNING;
+
+        if (job.stepsDone != lastSteps || finished) {
+            out << "{\"id\":" << job.id
+                << ",\"status\":\"" << statusName(job.status) << "\""
+                << ",\"stepsDone\":" << job.stepsDone
+                << ",\"steps\":" << job.steps << "}\n";
+            out.flush();
+            lastSteps = job.stepsDone;
+        }
+
+        if (finished || !out.good()) {
+            break;
+        }
+
+        Poco::Thread::sleep(PROGRESS_INTERVAL_MS);
+    }
+}
+
+/**
+ * Sends a finished job's particles or densities as raw floats
+ */
+void JobRequestHandler::sendResults(int id, const string& what, HTTPServerResponse& response)
+{
+    Job job;
+
+    if (!this->server.getJob(id, job) || job.status != JOB_DONE) {
+        sendError(response, HTTPResponse::HTTP_NOT_FOUND, "job is not done");
+        return;
+    }
+
+    const char* data = NULL;
+    size_t size      = 0;
+
+    if (what == "particles") {
+        data = reinterpret_cast<const char*>(&(*job.particles)[0]);
+        size = job.particles->size() * sizeof(pbf::Particle);
+    } else {
+        data = reinterpret_cast<const char*>(&(*job.density)[0]);
+        size = job.density->size() * sizeof(float);
+    }
+
+    response.setStatus(HTTPResponse::HTTP_OK);
+    response.setContentType("application/octet-stream");
+    response.setContentLength(size);
+    response.send().write(data, size);
+}
+
+class JobRequestHandlerFactory : public Poco::Net::HTTPRequestHandlerFactory
+{
+    private:
+        JobServer& server;
+
+    public:
+        JobRequestHandlerFactory(JobServer& _server) : server(_server) { }
+
+        Poco::Net::HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request)
+        {
+            return new JobRequestHandler(this->server);
+        }
+};
+
+}
+
+/*******************************************************************************
+ * JobWorker
+ ******************************************************************************/
+
+JobWorker::JobWorker(JobServer& _server, int _index, shared_ptr<pbf::Session> _session) :
+    server(_server),
+    index(_index),
+    session(_session)
+{
+    this->initialScene.numParticles = 0;
+}
+
+JobWorker::~JobWorker()
+{
+    this->stop();
+}
+
+/**
+ * Stops the worker once its current job is done
+ */
+void JobWorker::stop()
+{
+    if (this->isThreadRunning()) {
+        this->stopThread();
+        this->waitForThread(false);
+    }
+}
+
+void JobWorker::threadedFunction()
+{
+    while (this->isThreadRunning()) {
+
+        shared_ptr<Job> job = this->server.nextJob(this->index, 100);
+
+        if (job) {
+            this->runJob(job);
+        }
+    }
+}
+
+/**
+ * Sets up the worker's session for a job and steps it, reporting progress
+ * about every 1% of the steps
+ */
+void JobWorker::runJob(shared_ptr<Job> job)
+{
+    unsigned long long start = ofGetElapsedTimeMillis();
+
+    JobMetrics metrics   = job->metrics;
+    const Job& last      = this->initialScene;
+    bool sameScene       = last.numParticles == job->numParticles
+                        && last.seed == job->seed
+                        && last.parameters.particleRadius == job->parameters.particleRadius
+                        && memcmp(&last.bounds, &job->bounds, sizeof(pbf::Bounds)) == 0;
+
+    if (!sameScene) {
+        pbf::Session::randomParticles(this->initialState
+                                     ,job->numParticles
+                                     ,job->bounds
+                                     ,job->parameters.particleRadius
+                                     ,job->seed);
+
+        this->initialScene.numParticles = job->numParticles;
+        this->initialScene.seed         = job->seed;
+        this->initialScene.parameters   = job->parameters;
+        this->initialScene.bounds       = job->bounds;
+    }
+
+    int cells[3];
+    pbf::Session::idealCellsPerAxis(job->bounds, job->parameters.particleRadius, Constants::PARTICLES_PER_CELL_X, cells);
+
+    if (!this->session->setup(&this->initialState[0], job->numParticles, cells, job->bounds, job->parameters, job->dt)) {
+        this->server.finishJob(job, false, metrics, NULL, NULL);
+        return;
+    }
+
+    this->session->setSolverIterations(job->solverIterations);
+
+    unsigned long long setupDone = ofGetElapsedTimeMillis();
+
+    metrics.setupMs       = static_cast<double>(setupDone - start);
+    metrics.reusedBuffers = this->session->reusedBuffers();
+
+    int chunk = max(1, job->steps / 100);
+
+    for (int done = 0; done < job->steps; ) {
+
+        int steps = min(chunk, job->steps - done);
+
+        this->session->step(steps);
+
+        done += steps;
+
+        this->server.updateProgress(job, done);
+    }
+
+    unsigned long long end = ofGetElapsedTimeMillis();
+
+    metrics.msPerStep = static_cast<double>(end - setupDone) / job->steps;
+    metrics.totalMs   = static_cast<double>(end - start);
+    metrics.stats     = this->session->getStatistics();
+
+    const pbf::Particle* particles = this->session->getParticles();
+    const float* density           = this->session->getDensity();
+
+    this->server.finishJob(job
+                          ,true
+                          ,metrics
+                          ,make_shared<const vector<pbf::Particle> >(particles, particles + job->numParticles)
+                          ,make_shared<const vector<float> >(density, density + job->numParticles));
+}
+
+/*******************************************************************************
+ * JobServer
+ ******************************************************************************/
+
+/**
+ * @param [in] _dataPath Directory containing kernels/
+ * @param [in] _port Port to listen on
+ * @param [in] _maxParticles Largest particle count a job may ask for
+ */
+JobServer::JobServer(const string& _dataPath, int _port, int _maxParticles) :
+    dataPath(_dataPath),
+    port(_port),
+    maxParticles(_maxParticles),
+    nextId(1),
+    running(0),
+    completed(0),
+    totalSetupMs(0.0)
+{
+
+}
+
+JobServer::~JobServer()
+{
+    this->stop();
+}
+
+/**
+ * Warms up the worker sessions and starts serving
+ *
+ * @param [in] numWorkers Number of jobs that can run at once
+ */
+bool JobServer::start(int numWorkers)
+{
+    if (this->isRunning()) {
+        return true;
+    }
+
+    for (int i = 0; i < numWorkers; i++) {
+
+        shared_ptr<pbf::Session> session(new pbf::Session(this->dataPath));
+
+        if (!session->isLoaded()) {
+            ofLogError() << "JobServer: couldn't create worker session " << i << endl;
+            continue;
+        }
+
+        shared_ptr<JobWorker> worker(new JobWorker(*this, static_cast<int>(this->workers.size()), session));
+        worker->startThread();
+
+        this->workers.push_back(worker);
+    }
+
+    if (this->workers.empty()) {
+        return false;
+    }
+
+    try {
+
+        Poco::Net::HTTPServerParams* params = new Poco::Net::HTTPServerParams();
+        params->setMaxThreads(16);
+        params->setMaxQueued(64);
+
+        this->httpServer = shared_ptr<Poco::Net::HTTPServer>(
+            new Poco::Net::HTTPServer(new JobRequestHandlerFactory(*this)
+                                     ,Poco::Net::ServerSocket(static_cast<Poco::UInt16>(this->port))
+                                     ,params));
+        this->httpServer->start();
+
+    } catch (Poco::Exception& e) {
+        ofLogError() << "JobServer: couldn't listen on port " << this->port << ": " << e.displayText() << endl;
+        this->stop();
+        return false;
+    }
+
+    ofLogNotice() << "JobServer: listening on port " << this->port
+                  << " with " << this->workers.size() << " workers" << endl;
+
+    return true;
+}
+
+/**
+ * Stops accepting requests, then stops the workers once their current jobs
+ * are done. Queued jobs are cancelled, so anyone polling them sees them end
+ */
+void JobServer::stop()
+{
+    if (this->httpServer) {
+        this->httpServer->stop();
+        this->httpServer.reset();
+    }
+
+    this->lock.lock();
+        while (!this->queue.empty()) {
+            int id = -this->queue.top().second;
+            this->queue.pop();
+            this->jobs[id]->status = JOB_CANCELLED;
+            this->retire(id);
+        }
+    this->lock.unlock();
+
+    for (size_t i = 0; i < this->workers.size(); i++) {
+        this->workers[i]->stop();
+    }
+
+    this->workers.clear();
+}
+
+/**
+ * Queues a job
+ *
+ * @param [in] job The job; its id and status are assigned here
+ */
+int JobServer::submit(shared_ptr<Job> job)
+{
+    this->lock.lock();
+
+        job->id          = this->nextId++;
+        job->status      = JOB_QUEUED;
+        job->stepsDone   = 0;
+        job->submittedAt = ofGetElapsedTimeMillis();
+
+        memset(&job->metrics, 0, sizeof(JobMetrics));
+        job->metrics.worker = -1;
+
+        this->jobs[job->id] = job;
+        this->queue.push(make_pair(job->priority, -job->id));
+
+    this->lock.unlock();
+
+    this->jobReady.set();
+
+    return job->id;
+}
+
+/**
+ * Takes the highest priority queued job
+ *
+ * @param [in] worker Index of the worker taking the job
+ * @param [in] timeoutMs How long to wait for a job to be submitted
+ */
+shared_ptr<Job> JobServer::nextJob(int worker, long timeoutMs)
+{
+    for (int attempt = 0; attempt < 2; attempt++) {
+
+        shared_ptr<Job> job;
+
+        this->lock.lock();
+            if (!this->queue.empty()) {
+                job = this->jobs[-this->queue.top().second];
+                this->queue.pop();
+                job->status           = JOB_RUNNING;
+                job->metrics.worker   = worker;
+                job->metrics.queuedMs = static_cast<double>(ofGetElapsedTimeMillis() - job->submittedAt);
+                this->running++;
+            }
+        this->lock.unlock();
+
+        if (job) {
+            return job;
+        }
+
+        if (attempt == 0) {
+            this->jobReady.tryWait(timeoutMs);
+        }
+    }
+
+    return shared_ptr<Job>();
+}
+
+void JobServer::updateProgress(shared_ptr<Job> job, int stepsDone)
+{
+    this->lock.lock();
+        job->stepsDone = stepsDone;
+    this->lock.unlock();
+}
+
+/**
+ * Records the outcome of a job
+ *
+ * @param [in] job The job
+ * @param [in] succeeded Whether the job ran
+ * @param [in] metrics The job's timings and statistics
+ * @param [in] particles The final particles, or NULL if the job failed
+ * @param [in] density The final densities, or NULL if the job failed
+ */
+void JobServer::finishJob(shared_ptr<Job> job
+                         ,bool succeeded
+                         ,const JobMetrics& metrics
+                         ,shared_ptr<const vector<pbf::Particle> > particles
+                         ,shared_ptr<const vector<float> > density)
+{
+    this->lock.lock();
+        job->status    = succeeded ? JOB_DONE : JOB_FAILED;
+        job->metrics   = metrics;
+        job->particles = particles;
+        job->density   = density;
+
+        this->running--;
+        this->completed++;
+        this->totalSetupMs += metrics.setupMs;
+
+        this->retire(job->id);
+    this->lock.unlock();
+}
+
+/**
+ * Adds a job that has finished to the retained ones, forgetting the oldest
+ * (and freeing their results) beyond JOB_SERVER_RETAINED_JOBS. Called with
+ * the lock held
+ *
+ * @param [in] id The job's id
+ */
+void JobServer::retire(int id)
+{
+    this->finished.push_back(id);
+
+    while (this->finished.size() > static_cast<size_t>(Constants::JOB_SERVER_RETAINED_JOBS)) {
+        this->jobs.erase(this->finished.front());
+        this->finished.pop_front();
+    }
+}
+
+/**
+ * Copies a job's state
+ *
+ * @param [in] id The job's id
+ * @param [out] job The copy
+ */
+bool JobServer::getJob(int id, Job& job)
+{
+    ofScopedLock guard(this->lock);
+
+    auto found = this->jobs.find(id);
+
+    if (found == this->jobs.end()) {
+        return false;
+    }
+
+    job = *found->second;
+
+    return true;
+}
+
+string JobServer::jobToJson(int id)
+{
+    Job job;
+
+    return this->getJob(id, job) ? toJson(job) : "null";
+}
+
+string JobServer::jobsToJson()
+{
+    ofScopedLock guard(this->lock);
+
+    string json = "[";
+
+    for (auto i = this->jobs.begin(); i != this->jobs.end(); i++) {
+        json += (i == this->jobs.begin() ? "" : ",") + toJson(*i->second);
+    }
+
+    return json + "]";
+}
+
+string JobServer::metricsToJson()
+{
+    ofScopedLock guard(this->lock);
+
+    ostringstream json;
+
+    json << "{\"workers\":" << this->workers.size()
+         << ",\"queued\":" << this->queue.size()
+         << ",\"running\":" << this->running
+         << ",\"completed\":" << this->completed
+         << ",\"meanSetupMs\":" << (this->completed > 0 ? this->totalSetupMs / this->completed : 0.0)
+         << "}";
+
+    return json.str();
+}
+
+void JobServer::getCounts(int& queued, int& _running, int& _completed)
+{
+    ofScopedLock guard(this->lock);
+
+    queued     = static_cast<int>(this->queue.size());
+    _running   = this->running;
+    _completed = this->completed;
+}
+
+/******************************************************************************/
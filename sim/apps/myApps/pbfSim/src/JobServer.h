@@ -0,0 +1,215 @@
+/*******************************************************************************
+ * JobServer.h
+ * - A local HTTP service that accepts simulation jobs, queues them by
+ *   priority and runs them on a pool of headless pbf::Session workers whose
+ *   programs (and, for same-sized jobs, buffers) stay warm between jobs
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_JOB_SERVER_H
+#define PBF_SIM_JOB_SERVER_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include "ofMain.h"
+#include "Poco/Event.h"
+#include "Poco/Net/HTTPServer.h"
+#include "pbf/Session.h"
+
+/******************************************************************************/
+
+enum JobStatus
+{
+    JOB_QUEUED
+   ,JOB_RUNNING
+   ,JOB_DONE
+   ,JOB_FAILED
+   ,JOB_CANCELLED      // Still queued when the server stopped
+};
+
+// Timings and results of a job, filled in by the worker that ran it
+
+typedef struct {
+
+    int worker;
+    bool reusedBuffers;
+    double queuedMs;
+    double setupMs;
+    double msPerStep;
+    double totalMs;
+    pbf::SessionStatistics stats;
+
+} JobMetrics;
+
+/**
+ * A submitted job: what to simulate, and once it ran, its metrics and final
+ * particle state. The scene and parameters don't change once the job is
+ * submitted; everything else is guarded by JobServer's lock
+ */
+typedef struct {
+
+    int id;
+
+    int priority;            // Higher runs first
+
+    JobStatus status;
+
+    // Scene and parameters
+    int numParticles;
+    pbf::Bounds bounds;
+    Parameters parameters;
+    float dt;
+    int steps;
+    int solverIterations;
+    unsigned int seed;
+
+    // Progress and metrics
+    int stepsDone;
+    unsigned long long submittedAt; // ofGetElapsedTimeMillis()
+    JobMetrics metrics;
+
+    // Final state; shared so that copies of the job are cheap
+    std::shared_ptr<const std::vector<pbf::Particle> > particles;
+    std::shared_ptr<const std::vector<float> > density;
+
+} Job;
+
+/******************************************************************************/
+
+class JobServer;
+
+/**
+ * Runs jobs taken from the server's queue on its own session
+ */
+class JobWorker : public ofThread
+{
+    private:
+        JobServer& server;
+
+        int index;
+
+        std::shared_ptr<pbf::Session> session;
+
+        // Initial state of the last job, kept for jobs with the same scene
+        std::vector<pbf::Particle> initialState;
+        Job initialScene;
+
+        void runJob(std::shared_ptr<Job> job);
+
+    protected:
+        void threadedFunction();
+
+    public:
+        JobWorker(JobServer& server, int index, std::shared_ptr<pbf::Session> session);
+        virtual ~JobWorker();
+
+        void stop();
+};
+
+/******************************************************************************/
+
+/**
+ * Serves the following on http://localhost:<port>:
+ *
+ *   POST /jobs                 Submits a job; form fields (all optional):
+ *                              particles, steps, priority, dt, iterations,
+ *                              seed, bounds ("x0,y0,z0,x1,y1,z1") and any of
+ *                              the Parameters fields by name
+ *   GET  /jobs                 All jobs and their metrics
+ *   GET  /jobs/<id>            One job
+ *   GET  /jobs/<id>/progress   Streams a line of JSON per progress update
+ *                              until the job is done
+ *   GET  /jobs/<id>/particles  Final particles, 12 floats each (binary)
+ *   GET  /jobs/<id>/density    Final densities, 1 float each (binary)
+ *   GET  /metrics              Server-wide counts and timings
+ *
+ * Only the last JOB_SERVER_RETAINED_JOBS finished jobs are kept (see
+ * Constants.h); older ones, and their results, answer 404
+ */
+class JobServer
+{
+    private:
+        std::string dataPath;
+
+        int port;
+
+        int maxParticles;
+
+        std::vector<std::shared_ptr<JobWorker> > workers;
+
+        std::shared_ptr<Poco::Net::HTTPServer> httpServer;
+
+        ofMutex lock;
+
+        Poco::Event jobReady;
+
+        std::map<int, std::shared_ptr<Job> > jobs;
+
+        // Ids of the finished jobs still in jobs, oldest first
+        std::deque<int> finished;
+
+        // (priority, -id) so that equal priorities run first come, first
+        // served
+        std::priority_queue<std::pair<int, int> > queue;
+
+        int nextId;
+
+        int running;
+
+        int completed;
+
+        double totalSetupMs;
+
+        void retire(int id);
+
+    public:
+        JobServer(const std::string& dataPath, int port, int maxParticles);
+        virtual ~JobServer();
+
+        /**
+         * Creates numWorkers sessions (compiling the kernels up front) and
+         * starts listening
+         */
+        bool start(int numWorkers);
+
+        void stop();
+
+        bool isRunning() const { return this->httpServer != NULL; }
+
+        int getPort() const { return this->port; }
+
+        int getMaxParticles() const { return this->maxParticles; }
+
+        // Queues a job and returns its id
+        int submit(std::shared_ptr<Job> job);
+
+        // Waits up to timeoutMs for a queued job; returns NULL if none
+        std::shared_ptr<Job> nextJob(int worker, long timeoutMs);
+
+        // Called by workers as jobs progress and finish
+        void updateProgress(std::shared_ptr<Job> job, int stepsDone);
+        void finishJob(std::shared_ptr<Job> job
+                      ,bool succeeded
+                      ,const JobMetrics& metrics
+                      ,std::shared_ptr<const std::vector<pbf::Particle> > particles
+                      ,std::shared_ptr<const std::vector<float> > density);
+
+        // A copy of a job's current state, or false if there is no such job
+        bool getJob(int id, Job& job);
+
+        std::string jobToJson(int id);
+        std::string jobsToJson();
+        std::string metricsToJson();
+
+        void getCounts(int& queued, int& running, int& completed);
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,45 @@
+/*******************************************************************************
+ * KernelPrograms.h
+ * - Loads the app's own kernel programs through ofxMSAOpenCL from the sources
+ *   embedded in libpbf (see pbf/KernelSources.h), falling back to the files
+ *   in the data folder
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_KERNEL_PROGRAMS_H
+#define PBF_SIM_KERNEL_PROGRAMS_H
+
+#include <string>
+#include "MSAOpenCL.h"
+#include "pbf/KernelSources.h"
+
+/******************************************************************************/
+
+/**
+ * Builds a kernel file given relative to the data folder, e.g.
+ * "kernels/Visualize.cl". ofxMSAOpenCL takes no build options, so any
+ * defines (e.g. "#define REDUCTION_GROUP_SIZE 128\n") are put in front of
+ * the source instead
+ */
+inline msa::OpenCLProgramPtr loadKernelProgram(msa::OpenCL& openCL
+                                              ,const std::string& kernelPath
+                                              ,const std::string& defines = "")
+{
+    std::string source;
+
+    if (pbf::getKernelSource(kernelPath, source)) {
+        return openCL.loadProgramFromSource(defines + source);
+    }
+
+    if (defines.empty()) {
+        return openCL.loadProgramFromFile(kernelPath);
+    }
+
+    return openCL.loadProgramFromSource(defines + ofBufferFromFile(kernelPath).getText());
+}
+
+/******************************************************************************/
+
+#endif
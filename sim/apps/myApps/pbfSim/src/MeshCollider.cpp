@@ -0,0 +1,371 @@
+/*******************************************************************************
+ * MeshCollider.cpp
+ * - Triangle mesh colliders backed by a GPU linear BVH
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <limits>
+#include "ofxAssimpModelLoader.h"
+#include "MeshCollider.h"
+#include "KernelPrograms.h"
+#include "Simulation.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+// Bits per Morton code; must match morton3D in kernels/MeshCollision.cl
+static const int MORTON_BITS = 30;
+
+/******************************************************************************/
+
+/**
+ * Creates a collider from the triangles of the given mesh, and builds its
+ * hierarchy
+ *
+ * @param [in] _openCL OpenCL manager instance
+ * @param [in] _mesh Triangle mesh (OF_PRIMITIVE_TRIANGLES), indexed or not
+ * @param [in] _thickness Extra thickness given to every triangle
+ */
+MeshCollider::MeshCollider(msa::OpenCL& _openCL
+                          ,const ofMesh& _mesh
+                          ,float _thickness) :
+    openCL(_openCL),
+    numVertices(0),
+    numTriangles(0),
+    thickness(_thickness),
+    mesh(_mesh),
+    dirty(false)
+{
+    // Flatten the mesh into float4 vertices and int triangle indices:
+
+    this->numVertices = static_cast<int>(this->mesh.getNumVertices());
+
+    vector<int> triangles;
+
+    if (this->mesh.getNumIndices() > 0) {
+        triangles.assign(this->mesh.getIndices().begin(), this->mesh.getIndices().end());
+    } else {
+        for (int i = 0; i < this->numVertices; i++) {
+            triangles.push_back(i);
+        }
+    }
+
+    this->numTriangles = static_cast<int>(triangles.size() / 3);
+
+    if (this->numTriangles == 0) {
+        ofLogWarning() << "MeshCollider: mesh has no triangles" << endl;
+        return;
+    }
+
+    vector<float4> points(this->numVertices);
+
+    for (int i = 0; i < this->numVertices; i++) {
+        const ofVec3f& v = this->mesh.getVertex(i);
+        points[i] = float4(v.x, v.y, v.z, 1.0f);
+    }
+
+    this->restVertices.initBuffer(this->numVertices * sizeof(float4), CL_MEM_READ_ONLY);
+    this->restVertices.write(&points[0], 0, this->numVertices * sizeof(float4));
+    this->vertices.initBuffer(this->numVertices * sizeof(float4));
+
+    this->indices.initBuffer(this->numTriangles * 3 * sizeof(int), CL_MEM_READ_ONLY);
+    this->indices.write(&triangles[0], 0, this->numTriangles * 3 * sizeof(int));
+
+    this->nodes.initBuffer(((2 * this->numTriangles) - 1) * sizeof(BVHNode));
+    this->refitFlags.initBuffer(max(1, this->numTriangles - 1) * sizeof(int));
+
+    this->loadKernels();
+    this->build();
+    this->refit();
+
+    ofLogNotice() << "MeshCollider: built hierarchy over " << this->numTriangles << " triangles" << endl;
+}
+
+MeshCollider::~MeshCollider()
+{
+
+}
+
+/**
+ * Loads kernels/MeshCollision.cl
+ */
+void MeshCollider::loadKernels()
+{
+    auto program = loadKernelProgram(this->openCL, "kernels/MeshCollision.cl");
+
+    this->transformVerticesKernel = this->openCL.loadKernel("transformVertices", program);
+    this->computeMortonCodesKernel = this->openCL.loadKernel("computeMortonCodes", program);
+    this->radixFlagsKernel = this->openCL.loadKernel("radixFlags", program);
+    this->radixScatterKernel = this->openCL.loadKernel("radixScatter", program);
+    this->initializeLeavesKernel = this->openCL.loadKernel("initializeLeaves", program);
+    this->buildHierarchyKernel = this->openCL.loadKernel("buildHierarchy", program);
+    this->resetRefitFlagsKernel = this->openCL.loadKernel("resetRefitFlags", program);
+    this->refitHierarchyKernel = this->openCL.loadKernel("refitHierarchy", program);
+    this->sweepParticlesKernel = this->openCL.loadKernel("sweepParticles", program);
+
+    this->prefixSum = shared_ptr<pbf::PrefixSum>(new pbf::PrefixSum(this->openCL.getContext()
+                                                                    ,this->openCL.getDevice()
+                                                                    ,this->openCL.getQueue()
+                                                                    ,ofToDataPath("")));
+}
+
+/**
+ * Loads all meshes of a model file into a single triangle mesh, with each
+ * mesh's node transform applied
+ *
+ * @param [in] filename Model file, relative to the data folder
+ * @param [out] mesh The combined mesh
+ * @returns true if the model was loaded
+ */
+bool MeshCollider::loadMesh(const string& filename, ofMesh& mesh)
+{
+    ofxAssimpModelLoader model;
+
+    model.setScaleNomalization(false);
+
+    if (!model.loadModel(filename)) {
+        ofLogError() << "MeshCollider: failed to load " << filename << endl;
+        return false;
+    }
+
+    mesh.clear();
+    mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+
+    for (int i = 0; i < static_cast<int>(model.getMeshCount()); i++) {
+
+        ofMesh part           = model.getMesh(i);
+        ofMatrix4x4 transform = model.getMeshHelper(i).matrix * model.getModelMatrix();
+        ofIndexType offset    = static_cast<ofIndexType>(mesh.getNumVertices());
+
+        for (int j = 0; j < static_cast<int>(part.getNumVertices()); j++) {
+            mesh.addVertex(part.getVertex(j) * transform);
+        }
+
+        for (int j = 0; j < static_cast<int>(part.getNumIndices()); j++) {
+            mesh.addIndex(offset + part.getIndex(j));
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Builds the hierarchy topology from the current vertex positions:
+ *
+ * 1) Compute the Morton code of every triangle centroid
+ * 2) Sort the triangles by code with an LSD radix sort; each bit is a stable
+ *    split computed from the prefix sums of the "bit is clear" flags
+ * 3) Emit the leaves and all internal nodes in parallel
+ */
+void MeshCollider::build()
+{
+    int n = this->numTriangles;
+
+    // Mesh bounds, needed to normalize the centroids:
+
+    float inf = numeric_limits<float>::max();
+    ofVec3f minExt(inf, inf, inf);
+    ofVec3f maxExt(-inf, -inf, -inf);
+
+    for (int i = 0; i < this->numVertices; i++) {
+
+        ofVec3f p = this->mesh.getVertex(i) * this->transform;
+
+        minExt.x = min(minExt.x, p.x); maxExt.x = max(maxExt.x, p.x);
+        minExt.y = min(minExt.y, p.y); maxExt.y = max(maxExt.y, p.y);
+        minExt.z = min(minExt.z, p.z); maxExt.z = max(maxExt.z, p.z);
+    }
+
+    ofVec3f extent = maxExt - minExt;
+    ofVec4f invExtent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f
+                     ,extent.y > 0.0f ? 1.0f / extent.y : 0.0f
+                     ,extent.z > 0.0f ? 1.0f / extent.z : 0.0f
+                     ,0.0f);
+
+    // Scratch buffers for the sort:
+
+    msa::OpenCLBuffer codesA, codesB, idsA, idsB, flags, offsets;
+
+    codesA.initBuffer(n * sizeof(cl_uint));
+    codesB.initBuffer(n * sizeof(cl_uint));
+    idsA.initBuffer(n * sizeof(int));
+    idsB.initBuffer(n * sizeof(int));
+    flags.initBuffer(n * sizeof(int));
+    offsets.initBuffer(n * sizeof(int));
+
+    this->transformVerticesKernel->setArg(0, this->restVertices);
+    this->transformVerticesKernel->setArg(1, this->transform.getPtr(), 16 * sizeof(float));
+    this->transformVerticesKernel->setArg(2, this->numVertices);
+    this->transformVerticesKernel->setArg(3, this->vertices);
+    this->transformVerticesKernel->run1D(this->numVertices);
+
+    this->computeMortonCodesKernel->setArg(0, this->vertices);
+    this->computeMortonCodesKernel->setArg(1, this->indices);
+    this->computeMortonCodesKernel->setArg(2, n);
+    this->computeMortonCodesKernel->setArg(3, ofVec4f(minExt.x, minExt.y, minExt.z, 0.0f));
+    this->computeMortonCodesKernel->setArg(4, invExtent);
+    this->computeMortonCodesKernel->setArg(5, codesA);
+    this->computeMortonCodesKernel->setArg(6, idsA);
+    this->computeMortonCodesKernel->run1D(n);
+
+    msa::OpenCLBuffer* codesIn  = &codesA;
+    msa::OpenCLBuffer* codesOut = &codesB;
+    msa::OpenCLBuffer* idsIn    = &idsA;
+    msa::OpenCLBuffer* idsOut   = &idsB;
+
+    for (int bit = 0; bit < MORTON_BITS; bit++) {
+
+        this->radixFlagsKernel->setArg(0, *codesIn);
+        this->radixFlagsKernel->setArg(1, bit);
+        this->radixFlagsKernel->setArg(2, n);
+        this->radixFlagsKernel->setArg(3, flags);
+        this->radixFlagsKernel->run1D(n);
+
+        this->prefixSum->scan(offsets, flags, n);
+
+        this->radixScatterKernel->setArg(0, *codesIn);
+        this->radixScatterKernel->setArg(1, *idsIn);
+        this->radixScatterKernel->setArg(2, flags);
+        this->radixScatterKernel->setArg(3, offsets);
+        this->radixScatterKernel->setArg(4, n);
+        this->radixScatterKernel->setArg(5, *codesOut);
+        this->radixScatterKernel->setArg(6, *idsOut);
+        this->radixScatterKernel->run1D(n);
+
+        swap(codesIn, codesOut);
+        swap(idsIn, idsOut);
+    }
+
+    // The sorted keys are now in codesIn/idsIn:
+
+    this->initializeLeavesKernel->setArg(0, *idsIn);
+    this->initializeLeavesKernel->setArg(1, n);
+    this->initializeLeavesKernel->setArg(2, this->nodes);
+    this->initializeLeavesKernel->run1D(n);
+
+    if (n > 1) {
+        this->buildHierarchyKernel->setArg(0, *codesIn);
+        this->buildHierarchyKernel->setArg(1, n);
+        this->buildHierarchyKernel->setArg(2, this->nodes);
+        this->buildHierarchyKernel->run1D(n - 1);
+    }
+
+    // The scratch buffers are released on return, so wait for the queue:
+
+    this->openCL.finish();
+}
+
+/**
+ * Re-transforms the vertices and recomputes the bounds of every node,
+ * keeping the topology
+ */
+void MeshCollider::refit()
+{
+    int n = this->numTriangles;
+
+    this->transformVerticesKernel->setArg(0, this->restVertices);
+    this->transformVerticesKernel->setArg(1, this->transform.getPtr(), 16 * sizeof(float));
+    this->transformVerticesKernel->setArg(2, this->numVertices);
+    this->transformVerticesKernel->setArg(3, this->vertices);
+    this->transformVerticesKernel->run1D(this->numVertices);
+
+    if (n > 1) {
+        this->resetRefitFlagsKernel->setArg(0, this->refitFlags);
+        this->resetRefitFlagsKernel->run1D(n - 1);
+    }
+
+    this->refitHierarchyKernel->setArg(0, this->vertices);
+    this->refitHierarchyKernel->setArg(1, this->indices);
+    this->refitHierarchyKernel->setArg(2, n);
+    this->refitHierarchyKernel->setArg(3, this->thickness);
+    this->refitHierarchyKernel->setArg(4, this->nodes);
+    this->refitHierarchyKernel->setArg(5, this->refitFlags);
+    this->refitHierarchyKernel->run1D(n);
+}
+
+/**
+ * Sets the mesh's local-to-world transform; the hierarchy is refit at the
+ * start of the next step
+ */
+void MeshCollider::setTransform(const ofMatrix4x4& _transform)
+{
+    this->transform = _transform;
+    this->dirty     = true;
+}
+
+/**
+ * Replaces the mesh's (local space) vertex positions, e.g. for a deforming
+ * mesh. The vertex count must not change. The hierarchy is refit at the
+ * start of the next step; since its topology is kept, the query cost grows
+ * if the mesh deforms far from the shape it was built with
+ */
+void MeshCollider::setVertices(const vector<ofVec3f>& _vertices)
+{
+    if (static_cast<int>(_vertices.size()) != this->numVertices) {
+        ofLogError() << "MeshCollider: expected " << this->numVertices << " vertices, got "
+                     << _vertices.size() << endl;
+        return;
+    }
+
+    vector<float4> points(this->numVertices);
+
+    for (int i = 0; i < this->numVertices; i++) {
+        points[i] = float4(_vertices[i].x, _vertices[i].y, _vertices[i].z, 1.0f);
+        this->mesh.setVertex(i, _vertices[i]);
+    }
+
+    this->restVertices.write(&points[0], 0, this->numVertices * sizeof(float4));
+    this->dirty = true;
+}
+
+/**
+ * Refits the hierarchy if the mesh moved since the last step
+ */
+void MeshCollider::update(float dt)
+{
+    if (this->dirty && this->numTriangles > 0) {
+        this->refit();
+        this->dirty = false;
+    }
+}
+
+/**
+ * Sweeps the simulation's particles against the mesh
+ */
+void MeshCollider::resolve(Simulation& simulation)
+{
+    if (this->numTriangles == 0) {
+        return;
+    }
+
+    int numParticles = static_cast<int>(simulation.getNumberOfParticles());
+
+    this->sweepParticlesKernel->setArg(0, simulation.getParameterBuffer());
+    this->sweepParticlesKernel->setArg(1, simulation.getParticleBuffer());
+    this->sweepParticlesKernel->setArg(2, numParticles);
+    this->sweepParticlesKernel->setArg(3, this->vertices);
+    this->sweepParticlesKernel->setArg(4, this->indices);
+    this->sweepParticlesKernel->setArg(5, this->nodes);
+    this->sweepParticlesKernel->setArg(6, this->thickness);
+    this->sweepParticlesKernel->run1D(numParticles);
+}
+
+/**
+ * Draws the mesh as a wireframe
+ */
+void MeshCollider::draw()
+{
+    ofSetColor(0, 192, 255);
+    ofPushMatrix();
+        ofMultMatrix(this->transform);
+        this->mesh.drawWireframe();
+    ofPopMatrix();
+}
+
+/******************************************************************************/
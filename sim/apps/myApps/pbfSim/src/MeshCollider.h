@@ -0,0 +1,138 @@
+/*******************************************************************************
+ * MeshCollider.h
+ * - Exact particle-versus-triangle collision against (possibly thin or open)
+ *   triangle meshes, accelerated by a linear BVH built and refit on the GPU
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_MESH_COLLIDER_H
+#define PBF_SIM_MESH_COLLIDER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ofMain.h"
+#include "MSAOpenCL.h"
+#include "pbf/PrefixSum.h"
+#include "Collider.h"
+
+/******************************************************************************/
+
+// A node of the device BVH; must match BVHNode in kernels/MeshCollision.cl
+
+typedef struct {
+
+    float4 bmin;
+
+    float4 bmax;
+
+    int left;
+
+    int right;
+
+    int parent;
+
+    int triangle;
+
+} BVHNode;
+
+/******************************************************************************/
+
+/**
+ * Unlike the distance fields used by AnimatedCollider, which need a voxel or
+ * two of thickness to register a surface, this collider tests particles
+ * against the triangles themselves, so sheets, pipes and other thin geometry
+ * are handled properly. Particles are treated as spheres swept from their
+ * current to their predicted position, so they cannot tunnel through
+ * surfaces either
+ *
+ * The hierarchy topology is built once (Morton codes, radix sort, Karras
+ * 2012 emission, all on the GPU). When the mesh moves, via setTransform() or
+ * setVertices(), only the node bounds are refit at the start of the next
+ * step
+ */
+class MeshCollider : public Collider
+{
+    private:
+        msa::OpenCL& openCL;
+
+        // Used by the radix sort during construction
+        std::shared_ptr<pbf::PrefixSum> prefixSum;
+
+        int numVertices;
+        int numTriangles;
+
+        // Extra thickness given to every triangle, in world units
+        float thickness;
+
+        // Host copy of the mesh, for drawing
+        ofMesh mesh;
+
+        ofMatrix4x4 transform;
+
+        // Set when the vertices need to be re-transformed and refit
+        bool dirty;
+
+        // Rest pose and current (world space) vertices
+        // - Buffers of float4
+        msa::OpenCLBuffer restVertices;
+        msa::OpenCLBuffer vertices;
+
+        // Triangle vertex indices
+        // - Buffer of int
+        msa::OpenCLBuffer indices;
+
+        // Hierarchy nodes
+        // - Buffer of BVHNode
+        msa::OpenCLBuffer nodes;
+
+        // Per internal node visit counters used while refitting
+        // - Buffer of int
+        msa::OpenCLBuffer refitFlags;
+
+        // Kernels, resolved once when they are loaded rather than looked up
+        // by name on every run
+        msa::OpenCLKernelPtr transformVerticesKernel;
+        msa::OpenCLKernelPtr computeMortonCodesKernel;
+        msa::OpenCLKernelPtr radixFlagsKernel;
+        msa::OpenCLKernelPtr radixScatterKernel;
+        msa::OpenCLKernelPtr initializeLeavesKernel;
+        msa::OpenCLKernelPtr buildHierarchyKernel;
+        msa::OpenCLKernelPtr resetRefitFlagsKernel;
+        msa::OpenCLKernelPtr refitHierarchyKernel;
+        msa::OpenCLKernelPtr sweepParticlesKernel;
+
+        void loadKernels();
+
+        void build();
+
+        void refit();
+
+    public:
+        MeshCollider(msa::OpenCL& openCL
+                    ,const ofMesh& mesh
+                    ,float thickness = 0.0f);
+
+        virtual ~MeshCollider();
+
+        static bool loadMesh(const std::string& filename, ofMesh& mesh);
+
+        int getNumberOfTriangles() const { return this->numTriangles; }
+
+        const ofMatrix4x4& getTransform() const { return this->transform; }
+        void setTransform(const ofMatrix4x4& transform);
+
+        void setVertices(const std::vector<ofVec3f>& vertices);
+
+        void update(float dt);
+
+        void resolve(Simulation& simulation);
+
+        void draw();
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,305 @@
+/*******************************************************************************
+ * PlaybackViewer.cpp
+ * - Plays back the frames recorded to a ring file at display rate, without
+ *   running the solver
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include "PlaybackViewer.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+/**
+ * Maps the ring file and starts prefetching from its oldest frame
+ *
+ * @param [in] path The ring file, as written by a FramePublisher on disk
+ * @param [in] _numParticles Particle count of the simulation the frames are
+ *             shown in; the recording must have the same count
+ * @param [in] prefetchFrames Number of frames staged ahead of the cursor
+ */
+PlaybackViewer::PlaybackViewer(const string& path, int _numParticles, int prefetchFrames) :
+    numParticles(_numParticles),
+    firstFrame(0),
+    lastFrame(0),
+    cursor(0),
+    direction(1),
+    shownFrame(0),
+    shownFrameNumber(0),
+    playing(true)
+{
+    if (!this->ring.openFile(path)) {
+        ofLogError() << "Couldn't open playback file " << path << endl;
+        return;
+    }
+
+    if (this->ring.getMaxParticles() != this->numParticles) {
+        ofLogError() << path << " was recorded with " << this->ring.getMaxParticles()
+                     << " particles, not " << this->numParticles << endl;
+        this->ring.close();
+        return;
+    }
+
+    // The recording is finished, so the range of frames doesn't change:
+
+    this->firstFrame = this->ring.getOldestFrame();
+    this->lastFrame  = this->ring.getPublishedCount();
+    this->cursor     = this->firstFrame;
+
+    if (this->firstFrame == 0) {
+        ofLogError() << path << " has no recorded frames" << endl;
+        return;
+    }
+
+    this->buffers.resize(max(prefetchFrames, 1));
+    this->wanted.resize(this->buffers.size());
+
+    for (auto i = this->buffers.begin(); i != this->buffers.end(); i++) {
+        i->frame       = 0;
+        i->frameNumber = 0;
+        i->loading     = false;
+        i->valid       = false;
+        i->positions.resize(4 * this->numParticles, 1.0f);
+    }
+
+    this->startThread();
+}
+
+PlaybackViewer::~PlaybackViewer()
+{
+    this->close();
+}
+
+/**
+ * Stops the prefetch thread and unmaps the ring file
+ */
+void PlaybackViewer::close()
+{
+    if (this->isThreadRunning()) {
+        this->stopThread();
+        this->wake.set();
+        this->waitForThread(false);
+    }
+
+    this->ring.close();
+    this->firstFrame = 0;
+    this->lastFrame  = 0;
+}
+
+/**
+ * Wraps a frame into [firstFrame, lastFrame]
+ */
+unsigned long long PlaybackViewer::wrap(long long frame) const
+{
+    long long length = static_cast<long long>(this->lastFrame - this->firstFrame + 1);
+    long long offset = (frame - static_cast<long long>(this->firstFrame)) % length;
+
+    return this->firstFrame + static_cast<unsigned long long>(offset < 0 ? offset + length : offset);
+}
+
+unsigned long long PlaybackViewer::getPosition() const
+{
+    return this->shownFrame > 0 ? this->shownFrame - this->firstFrame : 0;
+}
+
+unsigned long long PlaybackViewer::getLength() const
+{
+    return this->firstFrame > 0 ? this->lastFrame - this->firstFrame + 1 : 0;
+}
+
+int PlaybackViewer::getPrefetchedCount()
+{
+    int count = 0;
+
+    this->lock();
+        for (auto i = this->buffers.begin(); i != this->buffers.end(); i++) {
+            if (i->frame != 0 && !i->loading && i->valid) {
+                count++;
+            }
+        }
+    this->unlock();
+
+    return count;
+}
+
+/**
+ * Moves the cursor, and has the prefetch thread stage frames in the
+ * direction of the move
+ *
+ * @param [in] frames Number of frames to move by
+ */
+void PlaybackViewer::scrub(int frames)
+{
+    if (!this->isOpen()) {
+        return;
+    }
+
+    this->lock();
+        this->cursor    = this->wrap(static_cast<long long>(this->cursor) + frames);
+        this->direction = frames < 0 ? -1 : 1;
+    this->unlock();
+
+    this->wake.set();
+}
+
+/**
+ * Called once per displayed frame. The timeline only advances once the frame
+ * at the cursor was shown, so playback slows down rather than skipping
+ * frames if the disk can't keep up
+ *
+ * @param [in] simulation The simulation the frame is shown in
+ */
+bool PlaybackViewer::update(Simulation& simulation)
+{
+    if (!this->isOpen()) {
+        return false;
+    }
+
+    PlaybackBuffer* ready = NULL;
+
+    this->lock();
+        if (this->playing && this->shownFrame == this->cursor) {
+            this->cursor    = this->wrap(static_cast<long long>(this->cursor) + 1);
+            this->direction = 1;
+        }
+
+        for (auto i = this->buffers.begin(); i != this->buffers.end(); i++) {
+            if (i->frame == this->cursor && !i->loading) {
+                ready = &(*i);
+            }
+        }
+
+        unsigned long long frame = this->cursor;
+    this->unlock();
+
+    this->wake.set();
+
+    if (ready == NULL || this->shownFrame == frame) {
+        return false;
+    }
+
+    // The buffer at the cursor is never reused by the prefetch thread, and
+    // only this thread moves the cursor, so it can be read unlocked. Frames
+    // that couldn't be read are skipped:
+
+    this->shownFrame = frame;
+
+    if (!ready->valid) {
+        return false;
+    }
+
+    simulation.showPositions(&ready->positions[0]);
+
+    this->shownFrameNumber = ready->frameNumber;
+
+    return true;
+}
+
+/**
+ * Stages the next frame the cursor will need, if any, in a buffer holding a
+ * frame it won't. Returns false if there was nothing to do
+ */
+bool PlaybackViewer::prefetchNext()
+{
+    PlaybackBuffer* target = NULL;
+    unsigned long long frame = 0;
+
+    this->lock();
+        int depth = static_cast<int>(this->buffers.size());
+
+        // The frames wanted, in the order they will be shown:
+
+        for (int k = 0; k < depth; k++) {
+            this->wanted[k] = this->wrap(static_cast<long long>(this->cursor) + k * this->direction);
+        }
+
+        for (int k = 0; k < depth && frame == 0; k++) {
+
+            bool staged = false;
+
+            for (auto i = this->buffers.begin(); i != this->buffers.end(); i++) {
+                staged = staged || i->frame == this->wanted[k];
+            }
+
+            if (!staged) {
+                frame = this->wanted[k];
+            }
+        }
+
+        for (auto i = this->buffers.begin(); i != this->buffers.end() && frame != 0 && target == NULL; i++) {
+            if (!i->loading && find(this->wanted.begin(), this->wanted.end(), i->frame) == this->wanted.end()) {
+                target = &(*i);
+            }
+        }
+
+        if (target != NULL) {
+            target->frame   = frame;
+            target->loading = true;
+            target->valid   = false;
+        }
+    this->unlock();
+
+    if (target == NULL) {
+        return false;
+    }
+
+    bool valid = this->load(frame, *target);
+
+    this->lock();
+        target->loading = false;
+        target->valid   = valid;
+    this->unlock();
+
+    return true;
+}
+
+/**
+ * Copies the positions of a frame out of the mapped file. Pages that aren't
+ * resident yet are read from disk here, off the main thread
+ *
+ * @param [in] frame The frame to copy
+ * @param [out] buffer Where to copy it to
+ */
+bool PlaybackViewer::load(unsigned long long frame, PlaybackBuffer& buffer)
+{
+    pbf::FrameView view;
+
+    if (!this->ring.acquire(frame, view)) {
+        return false;
+    }
+
+    int n        = min(static_cast<int>(view.numParticles), this->numParticles);
+    float* dest  = &buffer.positions[0];
+
+    for (int i = 0; i < n; i++) {
+        const cl_float4& p = view.particles[i].pos;
+        dest[4 * i]     = p.s[0];
+        dest[4 * i + 1] = p.s[1];
+        dest[4 * i + 2] = p.s[2];
+        dest[4 * i + 3] = 1.0f;
+    }
+
+    buffer.frameNumber = view.frameNumber;
+
+    return this->ring.validate(view);
+}
+
+void PlaybackViewer::threadedFunction()
+{
+    while (this->isThreadRunning()) {
+
+        // Sleep until the cursor moves once everything wanted is staged:
+
+        if (!this->prefetchNext()) {
+            this->wake.tryWait(10);
+        }
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * PlaybackViewer.h
+ * - Plays back the frames recorded to a ring file (see FramePublisher and
+ *   pbf::FrameRingWriter::createFile) at display rate, without running the
+ *   solver. A prefetch thread streams the frames ahead of the playback
+ *   position out of the mapped file, so showing one is a single upload to
+ *   the particle vertex buffer
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_PLAYBACK_VIEWER_H
+#define PBF_SIM_PLAYBACK_VIEWER_H
+
+#include <string>
+#include <vector>
+#include "ofMain.h"
+#include "Poco/Event.h"
+#include "pbf/FrameRing.h"
+#include "Simulation.h"
+
+/******************************************************************************/
+
+/**
+ * A recorded frame staged in host memory, laid out like the particle vertex
+ * buffer (x,y,z,w per particle)
+ */
+typedef struct {
+
+    unsigned long long frame;         // 0 if the buffer holds no frame
+
+    unsigned int frameNumber;         // Simulation frame number
+
+    bool loading;                     // Being filled by the prefetch thread
+
+    bool valid;                       // False if the frame couldn't be read
+
+    std::vector<float> positions;
+
+} PlaybackBuffer;
+
+/******************************************************************************/
+
+/**
+ * The timeline covers the frames still in the ring, oldest to newest, and
+ * wraps around at either end. Everything but threadedFunction() is called
+ * from the main (GL) thread
+ */
+class PlaybackViewer : public ofThread
+{
+    private:
+        pbf::FrameRingReader ring;
+
+        int numParticles;
+
+        unsigned long long firstFrame;
+        unsigned long long lastFrame;
+
+        // Guarded by the thread's mutex: the frame to show, the direction
+        // frames are prefetched in, and the staged frames. wanted is scratch
+        // space of the prefetch thread
+        unsigned long long cursor;
+        int direction;
+        std::vector<PlaybackBuffer> buffers;
+        std::vector<unsigned long long> wanted;
+
+        // The frame last uploaded, and whether the timeline advances
+        unsigned long long shownFrame;
+        unsigned int shownFrameNumber;
+        bool playing;
+
+        Poco::Event wake;
+
+        // Non-copyable
+        PlaybackViewer(const PlaybackViewer&);
+        PlaybackViewer& operator=(const PlaybackViewer&);
+
+        unsigned long long wrap(long long frame) const;
+        bool prefetchNext();
+        bool load(unsigned long long frame, PlaybackBuffer& buffer);
+
+    protected:
+        void threadedFunction();
+
+    public:
+        PlaybackViewer(const std::string& path, int numParticles, int prefetchFrames);
+
+        virtual ~PlaybackViewer();
+
+        bool isOpen() const { return this->ring.isOpen() && this->firstFrame > 0; }
+
+        void close();
+
+        bool isPlaying() const             { return this->playing; }
+        void setPlaying(bool playing)      { this->playing = playing; }
+
+        unsigned long long getFirstFrame() const { return this->firstFrame; }
+        unsigned long long getLastFrame() const  { return this->lastFrame; }
+
+        // Timeline position of the frame last shown, counted from 0
+        unsigned long long getPosition() const;
+        unsigned long long getLength() const;
+
+        unsigned int getShownFrameNumber() const { return this->shownFrameNumber; }
+
+        // Number of frames staged ahead of the cursor
+        int getPrefetchedCount();
+
+        // Moves the timeline by the given number of frames; negative values
+        // scrub (and prefetch) backwards
+        void scrub(int frames);
+
+        /**
+         * Advances the timeline if playing and the current frame was shown,
+         * and shows the frame at the cursor if it has been staged. Returns
+         * true if a new frame was shown
+         */
+        bool update(Simulation& simulation);
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,477 @@
+/*******************************************************************************
+ * PointCloudFormat.cpp
+ * - The point cloud file formats read by PointCloudImporter: PLY (ASCII or
+ *   binary) and CSV headers, and the scalars and text records of their
+ *   bodies
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "PointCloudFormat.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace {
+
+bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+/**
+ * Maps a PLY type name (both the "char"/"float" and the "int8"/"float32"
+ * spellings) to a scalar type
+ */
+bool toScalarType(const string& name, PointCloudFormat::ScalarType& type)
+{
+    if (name == "char" || name == "int8") {
+        type = PointCloudFormat::TYPE_INT8;
+    } else if (name == "uchar" || name == "uint8") {
+        type = PointCloudFormat::TYPE_UINT8;
+    } else if (name == "short" || name == "int16") {
+        type = PointCloudFormat::TYPE_INT16;
+    } else if (name == "ushort" || name == "uint16") {
+        type = PointCloudFormat::TYPE_UINT16;
+    } else if (name == "int" || name == "int32") {
+        type = PointCloudFormat::TYPE_INT32;
+    } else if (name == "uint" || name == "uint32") {
+        type = PointCloudFormat::TYPE_UINT32;
+    } else if (name == "float" || name == "float32") {
+        type = PointCloudFormat::TYPE_FLOAT32;
+    } else if (name == "double" || name == "float64") {
+        type = PointCloudFormat::TYPE_FLOAT64;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Maps a property/column name to one of the attribute indices, or -1 if
+ * the name is not one we care about
+ */
+int toAttribute(string name)
+{
+    transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    if (name == "x") {
+        return PointCloudFormat::ATTR_X;
+    } else if (name == "y") {
+        return PointCloudFormat::ATTR_Y;
+    } else if (name == "z") {
+        return PointCloudFormat::ATTR_Z;
+    } else if (name == "vx" || name == "velocity_x") {
+        return PointCloudFormat::ATTR_VX;
+    } else if (name == "vy" || name == "velocity_y") {
+        return PointCloudFormat::ATTR_VY;
+    } else if (name == "vz" || name == "velocity_z") {
+        return PointCloudFormat::ATTR_VZ;
+    }
+    return -1;
+}
+
+/**
+ * A small bounded float parser. strtof() can't be used here, since the
+ * mapped file isn't NUL terminated and it is locale dependent. Returns
+ * false if no number starts at p
+ */
+bool parseFloat(const char*& p, const char* end, float& value)
+{
+    const char* start = p;
+    bool negative     = false;
+    double mantissa   = 0.0;
+    int exponent      = 0;
+    bool digits       = false;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = (mantissa * 10.0) + (*p++ - '0');
+        digits   = true;
+    }
+
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mantissa = (mantissa * 10.0) + (*p++ - '0');
+            exponent--;
+            digits = true;
+        }
+    }
+
+    if (!digits) {
+        p = start;
+        return false;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* expStart = p++;
+        bool expNegative     = false;
+        int expValue         = 0;
+
+        if (p < end && (*p == '-' || *p == '+')) {
+            expNegative = (*p == '-');
+            p++;
+        }
+
+        if (p < end && *p >= '0' && *p <= '9') {
+            while (p < end && *p >= '0' && *p <= '9') {
+                expValue = (expValue * 10) + (*p++ - '0');
+            }
+            exponent += expNegative ? -expValue : expValue;
+        } else {
+            p = expStart;
+        }
+    }
+
+    value = static_cast<float>((negative ? -mantissa : mantissa) * pow(10.0, exponent));
+    return true;
+}
+
+/**
+ * Returns the next line in [p, end), advancing p past it
+ */
+string nextLine(const char*& p, const char* end)
+{
+    const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+
+    if (lineEnd == NULL) {
+        lineEnd = end;
+    }
+
+    string line(p, lineEnd);
+    p = (lineEnd < end) ? lineEnd + 1 : end;
+
+    if (!line.empty() && line[line.size() - 1] == '\r') {
+        line.erase(line.size() - 1);
+    }
+
+    return line;
+}
+
+}
+
+/******************************************************************************/
+
+int PointCloudFormat::scalarSize(ScalarType type)
+{
+    switch (type) {
+        case TYPE_INT8:
+        case TYPE_UINT8:
+            return 1;
+        case TYPE_INT16:
+        case TYPE_UINT16:
+            return 2;
+        case TYPE_INT32:
+        case TYPE_UINT32:
+        case TYPE_FLOAT32:
+            return 4;
+        case TYPE_FLOAT64:
+            return 8;
+    }
+    return 0;
+}
+
+float PointCloudFormat::readScalar(const char* p, ScalarType type, bool swapBytes)
+{
+    char bytes[8];
+    int size = scalarSize(type);
+
+    if (swapBytes) {
+        for (int i = 0; i < size; i++) {
+            bytes[i] = p[size - 1 - i];
+        }
+    } else {
+        memcpy(bytes, p, size);
+    }
+
+    switch (type) {
+        case TYPE_INT8:    return static_cast<float>(*reinterpret_cast<int8_t*>(bytes));
+        case TYPE_UINT8:   return static_cast<float>(*reinterpret_cast<uint8_t*>(bytes));
+        case TYPE_INT16:   return static_cast<float>(*reinterpret_cast<int16_t*>(bytes));
+        case TYPE_UINT16:  return static_cast<float>(*reinterpret_cast<uint16_t*>(bytes));
+        case TYPE_INT32:   return static_cast<float>(*reinterpret_cast<int32_t*>(bytes));
+        case TYPE_UINT32:  return static_cast<float>(*reinterpret_cast<uint32_t*>(bytes));
+        case TYPE_FLOAT32: return *reinterpret_cast<float*>(bytes);
+        case TYPE_FLOAT64: return static_cast<float>(*reinterpret_cast<double*>(bytes));
+    }
+    return 0.0f;
+}
+
+int PointCloudFormat::parseLine(const char*& p, const char* end, float* values, int maxValues)
+{
+    int count = 0;
+
+    while (p < end && *p != '\n') {
+        if (isSeparator(*p)) {
+            p++;
+            continue;
+        }
+
+        float value = 0.0f;
+
+        if (parseFloat(p, end, value)) {
+            if (count < maxValues) {
+                values[count] = value;
+            }
+            count++;
+        } else {
+            // Not a number; skip the token
+            while (p < end && *p != '\n' && !isSeparator(*p)) {
+                p++;
+            }
+        }
+    }
+
+    if (p < end) {
+        p++; // Skip the '\n'
+    }
+
+    return count;
+}
+
+/******************************************************************************/
+
+bool PointCloudFormat::parseHeader(const char* begin
+                                  ,const char* end
+                                  ,Format& format
+                                  ,RecordLayout& layout
+                                  ,int& numRecords
+                                  ,const char*& body)
+{
+    for (int a = 0; a < NUM_ATTRS; a++) {
+        layout.column[a] = -1;
+        layout.type[a]   = TYPE_FLOAT32;
+    }
+
+    layout.stride     = 0;
+    layout.numColumns = 0;
+
+    // Sniff for the PLY magic number, regardless of the extension:
+
+    if ((end - begin) >= 3 && strncmp(begin, "ply", 3) == 0) {
+        return parsePLYHeader(begin, end, format, layout, numRecords, body);
+    }
+
+    format     = CSV;
+    numRecords = -1;
+
+    return parseCSVHeader(begin, end, layout, body);
+}
+
+/**
+ * Parses a PLY header. Only the "vertex" element is read; any elements
+ * that precede it are skipped, and any that follow it are ignored
+ */
+bool PointCloudFormat::parsePLYHeader(const char* begin
+                                     ,const char* end
+                                     ,Format& format
+                                     ,RecordLayout& layout
+                                     ,int& numRecords
+                                     ,const char*& body)
+{
+    const char* p   = begin;
+    string element  = "";
+    int elementSize = 0;     // Size in bytes of a record of the current element
+    int elementCount = 0;
+    bool variable   = false; // Current element contains list properties
+    bool foundVertex = false;
+    size_t skipBytes = 0;    // Binary: bytes of elements preceding "vertex"
+    int skipLines   = 0;     // ASCII: lines of elements preceding "vertex"
+
+    nextLine(p, end); // "ply"
+
+    while (p < end) {
+
+        istringstream line(nextLine(p, end));
+        string keyword;
+        line >> keyword;
+
+        if (keyword == "format") {
+
+            string type;
+            line >> type;
+
+            if (type == "ascii") {
+                format = PLY_ASCII;
+            } else if (type == "binary_little_endian") {
+                format = PLY_BINARY_LITTLE_ENDIAN;
+            } else if (type == "binary_big_endian") {
+                format = PLY_BINARY_BIG_ENDIAN;
+            } else {
+                return false;
+            }
+
+        } else if (keyword == "element") {
+
+            // Account for the element we were just in:
+
+            if (element == "vertex") {
+                foundVertex = true;
+            }
+
+            if (!foundVertex && !element.empty()) {
+                if (format != PLY_ASCII && variable && elementCount > 0) {
+                    return false; // Can't skip variable-sized binary records
+                }
+                skipBytes += static_cast<size_t>(elementSize) * elementCount;
+                skipLines += elementCount;
+            }
+
+            line >> element >> elementCount;
+            elementSize = 0;
+            variable    = false;
+
+            if (element == "vertex") {
+                numRecords = elementCount;
+            }
+
+        } else if (keyword == "property") {
+
+            string typeName, name;
+            line >> typeName;
+
+            if (typeName == "list") {
+                variable = true;
+                if (element == "vertex") {
+                    return false;
+                }
+                continue;
+            }
+
+            line >> name;
+
+            ScalarType type;
+
+            if (!toScalarType(typeName, type)) {
+                return false;
+            }
+
+            if (element == "vertex") {
+                int attr = toAttribute(name);
+                if (attr >= 0) {
+                    layout.type[attr]   = type;
+                    layout.column[attr] = (format == PLY_ASCII) ? layout.numColumns : layout.stride;
+                }
+                layout.stride += scalarSize(type);
+                layout.numColumns++;
+            }
+
+            elementSize += scalarSize(type);
+
+        } else if (keyword == "end_header") {
+            break;
+        }
+    }
+
+    if (numRecords < 0 || layout.column[ATTR_X] < 0 || layout.column[ATTR_Y] < 0 || layout.column[ATTR_Z] < 0) {
+        return false;
+    }
+
+    body = p;
+
+    if (format == PLY_ASCII) {
+        for (int i = 0; i < skipLines && body < end; i++) {
+            nextLine(body, end);
+        }
+    } else {
+        body += skipBytes;
+        if (body + (static_cast<size_t>(numRecords) * layout.stride) > end) {
+            return false; // Truncated file
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Parses the (optional) header row of a CSV file. If the first line
+ * contains column names, x/y/z/vx/vy/vz are looked up by name; otherwise
+ * the first three columns are taken as the position and the next three,
+ * if present, as the velocity
+ */
+bool PointCloudFormat::parseCSVHeader(const char* begin
+                                     ,const char* end
+                                     ,RecordLayout& layout
+                                     ,const char*& body)
+{
+    const char* p = begin;
+    const char* firstLine = begin;
+    float values[MAX_TEXT_COLUMNS];
+
+    // Skip leading blank lines:
+
+    string line = "";
+
+    while (p < end && line.find_first_not_of(" \t,;") == string::npos) {
+        firstLine = p;
+        line = nextLine(p, end);
+    }
+
+    const char* q = firstLine;
+    int numValues = parseLine(q, end, values, MAX_TEXT_COLUMNS);
+
+    // Count the tokens on the line; if every token is numeric, there's no header:
+
+    vector<string> tokens;
+    string token = "";
+
+    for (size_t i = 0; i <= line.size(); i++) {
+        if (i == line.size() || isSeparator(line[i])) {
+            if (!token.empty()) {
+                tokens.push_back(token);
+            }
+            token = "";
+        } else {
+            token += line[i];
+        }
+    }
+
+    layout.numColumns = static_cast<int>(tokens.size());
+
+    if (numValues == layout.numColumns) {
+
+        body = firstLine;
+
+        layout.column[ATTR_X] = 0;
+        layout.column[ATTR_Y] = 1;
+        layout.column[ATTR_Z] = 2;
+
+        if (layout.numColumns >= 6) {
+            layout.column[ATTR_VX] = 3;
+            layout.column[ATTR_VY] = 4;
+            layout.column[ATTR_VZ] = 5;
+        }
+
+    } else {
+
+        body = p;
+
+        for (int i = 0; i < layout.numColumns; i++) {
+            int attr = toAttribute(tokens[i]);
+            if (attr >= 0) {
+                layout.column[attr] = i;
+            }
+        }
+    }
+
+    return layout.column[ATTR_X] >= 0 && layout.column[ATTR_Y] >= 0 && layout.column[ATTR_Z] >= 0;
+}
+
+/******************************************************************************/
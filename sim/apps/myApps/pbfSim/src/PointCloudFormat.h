@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * PointCloudFormat.h
+ * - The point cloud file formats read by PointCloudImporter: PLY (ASCII or
+ *   binary) and CSV headers, and the scalars and text records of their
+ *   bodies. Has no openFrameworks dependency, so it is checked on its own
+ *   by "make check" in src/pbf
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_POINT_CLOUD_FORMAT_H
+#define PBF_SIM_POINT_CLOUD_FORMAT_H
+
+/******************************************************************************/
+
+class PointCloudFormat
+{
+    public:
+        enum Format
+        {
+            UNKNOWN
+           ,PLY_ASCII
+           ,PLY_BINARY_LITTLE_ENDIAN
+           ,PLY_BINARY_BIG_ENDIAN
+           ,CSV
+        };
+
+        // Scalar types that may appear in a PLY "property" declaration
+        enum ScalarType
+        {
+            TYPE_INT8
+           ,TYPE_UINT8
+           ,TYPE_INT16
+           ,TYPE_UINT16
+           ,TYPE_INT32
+           ,TYPE_UINT32
+           ,TYPE_FLOAT32
+           ,TYPE_FLOAT64
+        };
+
+        // Index of each attribute in RecordLayout#column
+        enum Attribute
+        {
+            ATTR_X = 0
+           ,ATTR_Y
+           ,ATTR_Z
+           ,ATTR_VX
+           ,ATTR_VY
+           ,ATTR_VZ
+           ,NUM_ATTRS
+        };
+
+        // Maximum number of columns considered in a single text record
+        static const int MAX_TEXT_COLUMNS = 64;
+
+        // Describes where each of the attributes we care about lives in a
+        // single record (a PLY vertex or a CSV row). Binary layouts use
+        // byte offsets; ASCII layouts use column indices. -1 = not present
+        typedef struct {
+
+            int column[6];          // x, y, z, vx, vy, vz
+
+            ScalarType type[6];     // Binary only: type of each column
+
+            int stride;             // Binary only: size of one record in bytes
+
+            int numColumns;         // ASCII only: number of columns per record
+
+        } RecordLayout;
+
+    private:
+        static bool parsePLYHeader(const char* begin
+                                  ,const char* end
+                                  ,Format& format
+                                  ,RecordLayout& layout
+                                  ,int& numRecords
+                                  ,const char*& body);
+
+        static bool parseCSVHeader(const char* begin
+                                  ,const char* end
+                                  ,RecordLayout& layout
+                                  ,const char*& body);
+
+    public:
+        /**
+         * Parses the header of a file, determining the record layout and
+         * where the records start. PLY files are recognized by their magic
+         * number; anything else is read as CSV
+         *
+         * @param [in] begin Start of the file
+         * @param [in] end One past the end of the file
+         * @param [out] format The format of the file
+         * @param [out] layout The layout of a record
+         * @param [out] numRecords PLY: number of vertices; CSV: -1 (all lines)
+         * @param [out] body The first record
+         * @returns false if the header is malformed or not supported
+         */
+        static bool parseHeader(const char* begin
+                               ,const char* end
+                               ,Format& format
+                               ,RecordLayout& layout
+                               ,int& numRecords
+                               ,const char*& body);
+
+        // Size in bytes of a PLY scalar type
+        static int scalarSize(ScalarType type);
+
+        // Reads a single binary scalar and converts it to float
+        static float readScalar(const char* p, ScalarType type, bool swapBytes);
+
+        /**
+         * Parses the whitespace/comma/semicolon separated numbers on the line
+         * starting at p. On return, p points to the start of the next line.
+         * Returns the number of values on the line, which may be more than
+         * maxValues
+         */
+        static int parseLine(const char*& p, const char* end, float* values, int maxValues);
+};
+
+/******************************************************************************/
+
+#endif
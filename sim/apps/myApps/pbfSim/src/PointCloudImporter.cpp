@@ -0,0 +1,470 @@
+/*******************************************************************************
+ * PointCloudImporter.cpp
+ * - Loads initial particle states (position, optional velocity) from PLY
+ *   (ASCII or binary) and CSV point cloud files
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include "ofMain.h"
+#include "Poco/Environment.h"
+#include "Poco/File.h"
+#include "Poco/Runnable.h"
+#include "Poco/SharedMemory.h"
+#include "Poco/Thread.h"
+#include "PointCloudImporter.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace {
+
+// Files smaller than this are parsed on the calling thread only
+const size_t MIN_BYTES_PER_THREAD = 1 << 20;
+
+bool isHostLittleEndian()
+{
+    const int one = 1;
+    return *reinterpret_cast<const char*>(&one) == 1;
+}
+
+/**
+ * Returns a pointer to the start of the line that follows position p, i.e.
+ * one past the next '\n' at or after p
+ */
+const char* alignToLine(const char* p, const char* begin, const char* end)
+{
+    if (p <= begin) {
+        return begin;
+    }
+
+    const char* newline = static_cast<const char*>(memchr(p - 1, '\n', end - (p - 1)));
+
+    return (newline == NULL) ? end : newline + 1;
+}
+
+/**
+ * Tests whether a point lies inside the given bounds shrunk by radius
+ */
+bool isInside(const ofVec3f& minExt, const ofVec3f& maxExt, float radius, float x, float y, float z)
+{
+    return x >= (minExt.x + radius) && x <= (maxExt.x - radius) &&
+           y >= (minExt.y + radius) && y <= (maxExt.y - radius) &&
+           z >= (minExt.z + radius) && z <= (maxExt.z - radius);
+}
+
+/**
+ * Assembles a particle from the attribute values of one record; returns
+ * false if the particle falls outside the clipping bounds
+ */
+bool makeParticle(const float* attrs
+                 ,const ofVec3f& minExt
+                 ,const ofVec3f& maxExt
+                 ,float radius
+                 ,Particle& p)
+{
+    if (!isInside(minExt, maxExt, radius, attrs[PointCloudFormat::ATTR_X], attrs[PointCloudFormat::ATTR_Y], attrs[PointCloudFormat::ATTR_Z])) {
+        return false;
+    }
+
+    p = Particle();
+
+    p.pos.x = attrs[PointCloudFormat::ATTR_X];
+    p.pos.y = attrs[PointCloudFormat::ATTR_Y];
+    p.pos.z = attrs[PointCloudFormat::ATTR_Z];
+
+    p.vel.x = attrs[PointCloudFormat::ATTR_VX];
+    p.vel.y = attrs[PointCloudFormat::ATTR_VY];
+    p.vel.z = attrs[PointCloudFormat::ATTR_VZ];
+
+    return true;
+}
+
+/**
+ * Runs all of the given tasks concurrently and waits for them to finish.
+ * The first task runs on the calling thread
+ */
+void runConcurrently(vector<Poco::Runnable*>& tasks)
+{
+    vector<Poco::Thread*> threads;
+
+    for (size_t i = 1; i < tasks.size(); i++) {
+        Poco::Thread* thread = new Poco::Thread();
+        thread->start(*tasks[i]);
+        threads.push_back(thread);
+    }
+
+    if (!tasks.empty()) {
+        tasks[0]->run();
+    }
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+}
+
+/******************************************************************************/
+
+// Parses a contiguous range of fixed-size binary records
+
+class BinaryChunkTask : public Poco::Runnable
+{
+    public:
+        const char* body;
+        int first, last;
+        const PointCloudFormat::RecordLayout* layout;
+        bool swapBytes;
+        ofVec3f minExt, maxExt;
+        float radius;
+        vector<Particle> particles;
+
+        virtual void run()
+        {
+            float attrs[PointCloudFormat::NUM_ATTRS];
+            Particle p;
+
+            this->particles.reserve(this->last - this->first);
+
+            for (int i = this->first; i < this->last; i++) {
+
+                const char* record = this->body + (static_cast<size_t>(i) * this->layout->stride);
+
+                for (int a = 0; a < PointCloudFormat::NUM_ATTRS; a++) {
+                    int offset = this->layout->column[a];
+                    attrs[a]   = (offset < 0) ? 0.0f : PointCloudFormat::readScalar(record + offset, this->layout->type[a], this->swapBytes);
+                }
+
+                if (makeParticle(attrs, this->minExt, this->maxExt, this->radius, p)) {
+                    this->particles.push_back(p);
+                }
+            }
+        }
+};
+
+// Counts the lines in a line-aligned range of a text file (first pass)
+
+class LineCountTask : public Poco::Runnable
+{
+    public:
+        const char* begin;
+        const char* end;
+        int numLines;
+
+        virtual void run()
+        {
+            const char* p = this->begin;
+            this->numLines = 0;
+
+            while (p < this->end) {
+                const char* newline = static_cast<const char*>(memchr(p, '\n', this->end - p));
+                this->numLines++;
+                p = (newline == NULL) ? this->end : newline + 1;
+            }
+        }
+};
+
+// Parses the records in a line-aligned range of a text file (second pass)
+
+class TextChunkTask : public Poco::Runnable
+{
+    public:
+        const char* begin;
+        const char* end;
+        int firstLine;    // Index of the first line in this chunk
+        int numRecords;   // Lines at or past this index are ignored (-1 = all)
+        const PointCloudFormat::RecordLayout* layout;
+        ofVec3f minExt, maxExt;
+        float radius;
+        vector<Particle> particles;
+        int numParsed;    // Records parsed, before clipping
+        int numShort;     // Non-blank lines with too few values
+
+        virtual void run()
+        {
+            float values[PointCloudFormat::MAX_TEXT_COLUMNS];
+            float attrs[PointCloudFormat::NUM_ATTRS];
+            int lineIndex = this->firstLine;
+            const char* p = this->begin;
+            Particle particle;
+
+            this->numParsed = 0;
+            this->numShort  = 0;
+
+            while (p < this->end && (this->numRecords < 0 || lineIndex < this->numRecords)) {
+
+                int count = PointCloudFormat::parseLine(p, this->end, values, PointCloudFormat::MAX_TEXT_COLUMNS);
+                lineIndex++;
+
+                if (count == 0) {
+                    continue; // Blank line
+                }
+
+                if (count < this->layout->numColumns) {
+                    this->numShort++;
+                    continue;
+                }
+
+                this->numParsed++;
+
+                for (int a = 0; a < PointCloudFormat::NUM_ATTRS; a++) {
+                    int column = this->layout->column[a];
+                    attrs[a]   = (column < 0 || column >= PointCloudFormat::MAX_TEXT_COLUMNS) ? 0.0f : values[column];
+                }
+
+                if (makeParticle(attrs, this->minExt, this->maxExt, this->radius, particle)) {
+                    this->particles.push_back(particle);
+                }
+            }
+        }
+};
+
+}
+
+/******************************************************************************/
+
+/**
+ * Constructs a new point cloud importer
+ *
+ * @param [in] _bounds Points outside of these bounds are discarded
+ * @param [in] _particleRadius Points closer than this to the bounds are discarded
+ * @param [in] _numThreads Number of parsing threads; 0 = one per processor
+ */
+PointCloudImporter::PointCloudImporter(const AABB& _bounds
+                                      ,float _particleRadius
+                                      ,int _numThreads) :
+    bounds(_bounds),
+    particleRadius(_particleRadius),
+    numThreads(_numThreads),
+    numPointsRead(0),
+    numShortLines(0)
+{
+    if (this->numThreads <= 0) {
+        this->numThreads = static_cast<int>(Poco::Environment::processorCount());
+    }
+
+    this->numThreads = std::max(1, this->numThreads);
+}
+
+/**
+ * Guesses the format of a file from its extension. PLY files are further
+ * distinguished (ASCII vs. binary) when the header is read
+ */
+PointCloudImporter::Format PointCloudImporter::guessFormat(const string& filename)
+{
+    string ext = ofToLower(ofFilePath::getFileExt(filename));
+
+    if (ext == "ply") {
+        return PLY_ASCII;
+    } else if (ext == "csv" || ext == "txt" || ext == "xyz") {
+        return CSV;
+    }
+    return UNKNOWN;
+}
+
+/**
+ * Loads the given point cloud file, replacing the contents of particles
+ * with the points that lie inside the bounds
+ *
+ * @param [in] filename Path to the point cloud (relative to the data folder)
+ * @param [out] particles The particles read from the file
+ * @returns true if the file was read successfully
+ */
+bool PointCloudImporter::load(const string& filename, vector<Particle>& particles)
+{
+    particles.clear();
+    this->numPointsRead = 0;
+    this->numShortLines = 0;
+
+    string fullPath = ofToDataPath(filename, true);
+    Poco::File file(fullPath);
+
+    if (!file.exists() || file.getSize() == 0) {
+        ofLogError() << "PointCloudImporter: cannot read " << fullPath << endl;
+        return false;
+    }
+
+    float t0 = ofGetElapsedTimef();
+
+    try {
+
+        Poco::SharedMemory mapping(file, Poco::SharedMemory::AM_READ);
+
+        const char* begin = mapping.begin();
+        const char* end   = mapping.end();
+        const char* body  = NULL;
+        Format format     = UNKNOWN;
+        int numRecords    = -1;
+        RecordLayout layout;
+
+        if (!this->parseHeader(begin, end, format, layout, numRecords, body)) {
+            ofLogError() << "PointCloudImporter: unsupported or malformed header in " << fullPath << endl;
+            return false;
+        }
+
+        // The header decides the format; the extension only catches PLY
+        // files whose magic number is missing, which would otherwise be
+        // read as CSV:
+
+        if (format == CSV && guessFormat(filename) == PLY_ASCII) {
+            ofLogError() << "PointCloudImporter: " << fullPath << " has no PLY header" << endl;
+            return false;
+        }
+
+        if (format == PLY_BINARY_LITTLE_ENDIAN || format == PLY_BINARY_BIG_ENDIAN) {
+            this->parseBinary(body, end, format, layout, numRecords, particles);
+        } else {
+            this->parseText(body, end, layout, numRecords, particles);
+        }
+
+    } catch (Poco::Exception& e) {
+        ofLogError() << "PointCloudImporter: " << e.displayText() << endl;
+        return false;
+    }
+
+    ofLogNotice() << "PointCloudImporter: read " << this->numPointsRead << " points, kept "
+                  << particles.size() << " in " << (ofGetElapsedTimef() - t0) << "s ("
+                  << this->numThreads << " threads)" << endl;
+
+    if (this->numShortLines > 0) {
+        ofLogWarning() << "PointCloudImporter: skipped " << this->numShortLines << " line(s) with fewer than "
+                       << "the header's columns in " << fullPath << endl;
+    }
+
+    return true;
+}
+
+/******************************************************************************/
+
+/**
+ * Parses fixed-size binary PLY records. Records are split evenly amongst
+ * the worker threads
+ */
+void PointCloudImporter::parseBinary(const char* body
+                                    ,const char* end
+                                    ,Format format
+                                    ,const RecordLayout& layout
+                                    ,int numRecords
+                                    ,vector<Particle>& particles)
+{
+    size_t bytes   = static_cast<size_t>(numRecords) * layout.stride;
+    int numChunks  = static_cast<int>(std::min(static_cast<size_t>(this->numThreads)
+                                              ,std::max(static_cast<size_t>(1), bytes / MIN_BYTES_PER_THREAD)));
+    int perChunk   = (numRecords + numChunks - 1) / numChunks;
+    bool swapBytes = (format == PLY_BINARY_LITTLE_ENDIAN) != isHostLittleEndian();
+
+    vector<BinaryChunkTask> tasks(numChunks);
+    vector<Poco::Runnable*> runnables;
+
+    for (int i = 0; i < numChunks; i++) {
+        BinaryChunkTask& task = tasks[i];
+        task.body      = body;
+        task.first     = std::min(numRecords, i * perChunk);
+        task.last      = std::min(numRecords, (i + 1) * perChunk);
+        task.layout    = &layout;
+        task.swapBytes = swapBytes;
+        task.minExt    = this->bounds.getMinExtent();
+        task.maxExt    = this->bounds.getMaxExtent();
+        task.radius    = this->particleRadius;
+        runnables.push_back(&task);
+    }
+
+    runConcurrently(runnables);
+
+    size_t total = 0;
+
+    for (int i = 0; i < numChunks; i++) {
+        total += tasks[i].particles.size();
+    }
+
+    particles.reserve(total);
+
+    for (int i = 0; i < numChunks; i++) {
+        particles.insert(particles.end(), tasks[i].particles.begin(), tasks[i].particles.end());
+    }
+
+    this->numPointsRead = numRecords;
+}
+
+/**
+ * Parses ASCII PLY and CSV records. The body is split into line-aligned
+ * chunks; a first parallel pass counts the lines in each chunk so that
+ * every chunk knows the index of its first line (PLY files may contain
+ * other elements after the vertices), then a second parallel pass parses
+ * the records themselves
+ */
+void PointCloudImporter::parseText(const char* body
+                                  ,const char* end
+                                  ,const RecordLayout& layout
+                                  ,int numRecords
+                                  ,vector<Particle>& particles)
+{
+    size_t bytes  = end - body;
+    int numChunks = static_cast<int>(std::min(static_cast<size_t>(this->numThreads)
+                                             ,std::max(static_cast<size_t>(1), bytes / MIN_BYTES_PER_THREAD)));
+
+    vector<const char*> boundaries(numChunks + 1);
+
+    for (int i = 0; i <= numChunks; i++) {
+        boundaries[i] = alignToLine(body + ((bytes * i) / numChunks), body, end);
+    }
+
+    // Pass 1: count lines per chunk
+
+    vector<LineCountTask> counts(numChunks);
+    vector<Poco::Runnable*> runnables;
+
+    for (int i = 0; i < numChunks; i++) {
+        counts[i].begin = boundaries[i];
+        counts[i].end   = boundaries[i + 1];
+        runnables.push_back(&counts[i]);
+    }
+
+    runConcurrently(runnables);
+
+    // Pass 2: parse
+
+    vector<TextChunkTask> tasks(numChunks);
+    int firstLine = 0;
+
+    runnables.clear();
+
+    for (int i = 0; i < numChunks; i++) {
+        TextChunkTask& task = tasks[i];
+        task.begin      = boundaries[i];
+        task.end        = boundaries[i + 1];
+        task.firstLine  = firstLine;
+        task.numRecords = numRecords;
+        task.layout     = &layout;
+        task.minExt     = this->bounds.getMinExtent();
+        task.maxExt     = this->bounds.getMaxExtent();
+        task.radius     = this->particleRadius;
+        runnables.push_back(&task);
+
+        firstLine += counts[i].numLines;
+    }
+
+    runConcurrently(runnables);
+
+    size_t total = 0;
+
+    for (int i = 0; i < numChunks; i++) {
+        total               += tasks[i].particles.size();
+        this->numPointsRead += tasks[i].numParsed;
+        this->numShortLines += tasks[i].numShort;
+    }
+
+    particles.reserve(total);
+
+    for (int i = 0; i < numChunks; i++) {
+        particles.insert(particles.end(), tasks[i].particles.begin(), tasks[i].particles.end());
+    }
+}
+
+/******************************************************************************/
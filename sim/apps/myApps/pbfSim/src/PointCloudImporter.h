@@ -0,0 +1,76 @@
+/*******************************************************************************
+ * PointCloudImporter.h
+ * - Loads initial particle states (position, optional velocity) from PLY
+ *   (ASCII or binary) and CSV point cloud files
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_POINT_CLOUD_IMPORTER_H
+#define PBF_SIM_POINT_CLOUD_IMPORTER_H
+
+#include <string>
+#include <vector>
+#include "AABB.h"
+#include "PointCloudFormat.h"
+#include "Simulation.h"
+
+/******************************************************************************/
+
+/**
+ * Imports point clouds into a flat array of particles. The file is memory
+ * mapped and split into chunks that are parsed concurrently on worker
+ * threads; points that fall outside of the simulation bounds (shrunk by
+ * the particle radius) are dropped. The header and record formats are
+ * those of PointCloudFormat
+ */
+class PointCloudImporter : public PointCloudFormat
+{
+    private:
+        // Points outside of these bounds are discarded
+        AABB bounds;
+
+        // Particle radius; points closer than this to the bounds are discarded
+        float particleRadius;
+
+        // Number of worker threads used for parsing
+        int numThreads;
+
+        // Number of points read from the last file, before clipping
+        int numPointsRead;
+
+        // Text files: number of non-blank lines of the last file that had
+        // fewer values than a record, and were skipped
+        int numShortLines;
+
+        void parseBinary(const char* body
+                        ,const char* end
+                        ,Format format
+                        ,const RecordLayout& layout
+                        ,int numRecords
+                        ,std::vector<Particle>& particles);
+
+        void parseText(const char* body
+                      ,const char* end
+                      ,const RecordLayout& layout
+                      ,int numRecords
+                      ,std::vector<Particle>& particles);
+
+    public:
+        PointCloudImporter(const AABB& bounds
+                          ,float particleRadius
+                          ,int numThreads = 0);
+
+        static Format guessFormat(const std::string& filename);
+
+        const int getNumberOfPointsRead() const { return this->numPointsRead; }
+
+        const int getNumberOfShortLines() const { return this->numShortLines; }
+
+        bool load(const std::string& filename, std::vector<Particle>& particles);
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * RooflineProfiler.cpp
+ * - Profiles the simulation's solver stages and places them on a roofline
+ *   (achieved GB/s and GFLOP/s against the device's peaks) every few steps,
+ *   for the heads up display and as a JSON file
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include "RooflineProfiler.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+/**
+ * Finds the device's peaks. The bandwidth test runs once, here, on the
+ * simulation's own queue
+ *
+ * @param [in] simulation The simulation to profile
+ * @param [in] filename JSON file every report is written to, or empty
+ * @param [in] stepsPerReport Number of steps each report covers
+ */
+RooflineProfiler::RooflineProfiler(Simulation& _simulation
+                                  ,const string& _filename
+                                  ,int _stepsPerReport) :
+    simulation(_simulation),
+    filename(_filename),
+    stepsPerReport(max(_stepsPerReport, 1)),
+    steps(0),
+    reported(false)
+{
+    pbf::Solver& solver = this->simulation.getSolver();
+
+    this->device = pbf::Roofline::queryDevice(solver.getDevice());
+
+    // Keep the test buffers well within device memory:
+
+    size_t bytes = static_cast<size_t>(min<unsigned long long>(64ULL << 20, this->device.globalMemBytes / 8));
+
+    this->device.peakGBps = pbf::Roofline::measureBandwidth(solver.getContext(), solver.getQueue(), bytes);
+
+    ofLogNotice() << "Roofline peaks for " << this->device.name << ": "
+                  << this->device.peakGflops << " GFLOP/s (estimated), "
+                  << this->device.peakGBps << " GB/s (measured)";
+}
+
+RooflineProfiler::~RooflineProfiler()
+{
+
+}
+
+/**
+ * Adds the step's stage timings to the running sums, and once enough steps
+ * are in, turns them into a new report. Neighbor counts are measured from
+ * the grid of the last step
+ *
+ * @param [in] stepTimings From Solver::collectStageTimings
+ */
+void RooflineProfiler::stepped(const vector<pbf::StageTiming>& stepTimings)
+{
+    if (stepTimings.empty()) {
+        return;
+    }
+
+    for (auto i = stepTimings.begin(); i != stepTimings.end(); i++) {
+
+        auto j = this->timings.begin();
+
+        while (j != this->timings.end() && j->name != i->name) {
+            j++;
+        }
+
+        if (j == this->timings.end()) {
+            this->timings.push_back(*i);
+        } else {
+            j->ms   += i->ms;
+            j->runs += i->runs;
+        }
+    }
+
+    if (++this->steps < this->stepsPerReport) {
+        return;
+    }
+
+    pbf::Solver& solver = this->simulation.getSolver();
+
+    this->report = pbf::Roofline::build(this->device
+                                       ,this->timings
+                                       ,this->steps
+                                       ,solver.getNumberOfParticles()
+                                       ,solver.getNumberOfCells()
+                                       ,solver.measureNeighborCount());
+    this->reported = true;
+
+    if (!this->filename.empty()) {
+        pbf::Roofline::writeJson(this->filename, this->report);
+    }
+
+    this->timings.clear();
+    this->steps = 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * RooflineProfiler.h
+ * - Profiles the simulation's solver stages and places them on a roofline
+ *   (achieved GB/s and GFLOP/s against the device's peaks) every few steps,
+ *   for the heads up display and as a JSON file
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_ROOFLINE_PROFILER_H
+#define PBF_SIM_ROOFLINE_PROFILER_H
+
+#include <string>
+#include <vector>
+#include "pbf/Roofline.h"
+#include "Simulation.h"
+
+/******************************************************************************/
+
+/**
+ * Accumulates the stage timings of every step, which the app collects from
+ * the solver (see ofApp::update), and reports once enough steps are in
+ */
+class RooflineProfiler
+{
+    private:
+        Simulation& simulation;
+
+        pbf::DeviceInfo device;
+
+        // Where every report is written, or empty
+        std::string filename;
+
+        int stepsPerReport;
+
+        // Steps accumulated since the last report
+        int steps;
+
+        bool reported;
+
+        pbf::RooflineReport report;
+
+        std::vector<pbf::StageTiming> timings;
+
+    public:
+        RooflineProfiler(Simulation& simulation
+                        ,const std::string& filename
+                        ,int stepsPerReport);
+
+        virtual ~RooflineProfiler();
+
+        // Call after every profiled step, with the step's stage timings
+        void stepped(const std::vector<pbf::StageTiming>& stepTimings);
+
+        bool hasReport() const { return this->reported; }
+
+        const pbf::RooflineReport& getReport() const { return this->report; }
+};
+
+/******************************************************************************/
+
+#endif
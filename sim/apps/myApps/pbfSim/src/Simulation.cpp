@@ -9,9 +9,11 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
 #include "ofMain.h"
 #include "Constants.h"
 #include "Simulation.h"
+#include "KernelPrograms.h"
 
 /******************************************************************************/
 
@@ -19,6 +21,37 @@ using namespace std;
 
 /******************************************************************************/
 
+// The host-side types must match the solver's device-side ones:
+
+static_assert(sizeof(Particle) == sizeof(pbf::Particle), "Particle layout mismatch");
+static_assert(sizeof(ParticlePosition) == sizeof(pbf::ParticlePosition), "ParticlePosition layout mismatch");
+static_assert(sizeof(GridCellOffset) == sizeof(pbf::GridCellOffset), "GridCellOffset layout mismatch");
+
+// Particle shader uniform names, built once rather than on every draw:
+
+static const string UNIFORM_PARTICLE_RADIUS    = "particleRadius";
+static const string UNIFORM_CAMERA_POSITION    = "cameraPosition";
+
+/**
+ * The largest power of two work group size, up to
+ * Simulation::MAX_REDUCTION_GROUP_SIZE, the device allows
+ */
+static int reductionGroupSizeFor(cl_device_id device)
+{
+    size_t maxSize = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxSize), &maxSize, NULL);
+
+    int size = Simulation::MAX_REDUCTION_GROUP_SIZE;
+
+    while (size > 1 && static_cast<size_t>(size) > maxSize) {
+        size >>= 1;
+    }
+
+    return size;
+}
+
+/******************************************************************************/
+
 ostream& operator<<(ostream& os, Particle p)
 {
     return os << "Particle {" << endl
@@ -44,18 +77,21 @@ Simulation::Simulation(msa::OpenCL& _openCL
     openCL(_openCL),
     bounds(_bounds),
     originalBounds(_bounds),
+    gridBounds(_bounds),
     numParticles(_numParticles),
     dt(Constants::DEFAULT_DT),
     parameters(_parameters),
     frameNumber(0),
-    animFrameNumber(0),
     animBounds(false),
-    animType(SINE_WAVE),
-    animPeriod(1.0f),
-    animAmp(10.0f),
-    animBothSides(false),
     doDrawGrid(false),
-    doVisualDebugging(false)
+    doVisualDebugging(false),
+    visualAttribute(ATTRIBUTE_NONE),
+    transferFunction(TRANSFER_JET),
+    autoRange(true),
+    rangeMin(0.0f),
+    rangeMax(1.0f),
+    renderStride(1),
+    particleBufferStale(false)
 {
     // Given the number of particles, find the ideal number of cells per axis
     // such that no cell contains more than 4 particles
@@ -84,20 +120,61 @@ Simulation::Simulation(msa::OpenCL& _openCL
     openCL(_openCL),
     bounds(_bounds),
     originalBounds(_bounds),
+    gridBounds(_bounds),
     numParticles(_numParticles),
     dt(_dt),
     cellsPerAxis(_cellsPerAxis),
     parameters(_parameters),
     frameNumber(0),
-    animFrameNumber(0),
     animBounds(false),
-    animType(SINE_WAVE),
-    animPeriod(1.0f),
-    animAmp(10.0f),
-    animBothSides(false),
     doDrawGrid(false),
-    doVisualDebugging(false)
+    doVisualDebugging(false),
+    visualAttribute(ATTRIBUTE_NONE),
+    transferFunction(TRANSFER_JET),
+    autoRange(true),
+    rangeMin(0.0f),
+    rangeMax(1.0f),
+    renderStride(1),
+    particleBufferStale(false)
+{
+    this->initialize();
+}
+
+/**
+ * Constructs a new simulation instance whose particles start out in the
+ * given states, e.g. as loaded by PointCloudImporter
+ *
+ * @param [in] _openCL OpenCL manager instance
+ * @param [in] _bounds Defines the boundaries of the simulation in world space
+ * @param [in] _initialState Initial particle positions and velocities
+ * @param [in] _parameters Simulation parameters
+ */
+Simulation::Simulation(msa::OpenCL& _openCL
+                      ,AABB _bounds
+                      ,const vector<Particle>& _initialState
+                      ,Parameters _parameters) :
+    openCL(_openCL),
+    bounds(_bounds),
+    originalBounds(_bounds),
+    gridBounds(_bounds),
+    numParticles(static_cast<int>(_initialState.size())),
+    initialState(_initialState),
+    dt(Constants::DEFAULT_DT),
+    parameters(_parameters),
+    frameNumber(0),
+    animBounds(false),
+    doDrawGrid(false),
+    doVisualDebugging(false),
+    visualAttribute(ATTRIBUTE_NONE),
+    transferFunction(TRANSFER_JET),
+    autoRange(true),
+    rangeMin(0.0f),
+    rangeMax(1.0f),
+    renderStride(1),
+    particleBufferStale(false)
 {
+    this->cellsPerAxis = this->findIdealParticleCount();
+    
     this->initialize();
 }
 
@@ -140,6 +217,18 @@ void Simulation::readFromGPU()
     this->parameterBuffer.read(&this->parameters, 0, sizeof(Parameters));
     this->particles.readFromDevice();
     this->renderPos.readFromDevice();
+
+#ifdef DRAW_PARTICLES_AS_SPHERES
+
+    // Spheres are colored one by one on the host; points take their colors
+    // straight from the vertex buffer, so only spheres need them read back,
+    // and only while an attribute is shown:
+
+    if (this->visualAttribute != ATTRIBUTE_NONE) {
+        this->renderColor.readFromDevice();
+    }
+
+#endif
 }
 
 /**
@@ -169,7 +258,7 @@ const Parameters& Simulation::getParameters() const
 void Simulation::setParameters(const Parameters& parameters)
 {
     this->parameters = parameters;
-    this->parameterBuffer.write(&this->parameters, 0, sizeof(Parameters));
+    this->solver->setParameters(this->parameters);
 }
 
 /******************************************************************************/
@@ -197,9 +286,22 @@ void Simulation::initializeBuffers()
     
 #ifdef DRAW_PARTICLES_AS_SPHERES
     this->renderPos.initBuffer(this->numParticles);
+    this->renderColor.initBuffer(this->numParticles);
 #else
     this->renderPos.initFromGLObject(this->particleVertices.getVertId(), this->numParticles);
+    this->renderColor.initFromGLObject(this->particleVertices.getColorId(), this->numParticles);
 #endif
+
+    // Attribute visualization: the scalar attribute values, one (min, max)
+    // pair per reduction work group, and the final reduced (min, max) pair:
+
+    this->reductionGroupSize = reductionGroupSizeFor(this->openCL.getDevice());
+
+    int numGroups = (this->numParticles + this->reductionGroupSize - 1) / this->reductionGroupSize;
+
+    this->attributeValues.initBuffer(this->numParticles * sizeof(float));
+    this->attributePartials.initBuffer(numGroups * 2 * sizeof(float));
+    this->attributeRange.initBuffer(2 * sizeof(float));
     
     // Accumulated forces acting on the i-th particles
     
@@ -258,7 +360,14 @@ void Simulation::initializeBuffers()
     
     this->posDelta.initBuffer(this->numParticles * sizeof(float4));
     
-    // Set up initial positions and velocities for the particles:
+    // Set up initial positions and velocities for the particles. If an
+    // initial state was given, it's copied as-is and uploaded in one go by
+    // writeToGPU():
+    
+    if (!this->initialState.empty()) {
+        memcpy(&this->particles[0], &this->initialState[0], this->numParticles * sizeof(Particle));
+        return;
+    }
     
     float radius = this->parameters.particleRadius;
     
@@ -361,6 +470,18 @@ void Simulation::initializeOpenGL()
     this->particleVertices.setNormalData(this->particleMesh.getNormalsPointer()
                                         ,this->numParticles
                                         ,GL_STATIC_DRAW);
+
+    // Per-particle colors written by OpenCL when visualizing an attribute,
+    // seen by the shader as the vertex color. The stride must be given
+    // explicitly, since ofVbo sizes the buffer with it. Colors stay
+    // disabled until an attribute is selected:
+
+    this->particleVertices.setColorData((const float*)0
+                                       ,this->numParticles
+                                       ,GL_DYNAMIC_DRAW
+                                       ,sizeof(float) * 4);
+
+    this->particleVertices.disableColors();
     
 #endif
 }
@@ -372,214 +493,290 @@ void Simulation::initializeOpenGL()
  */
 void Simulation::setupKernels(bool load)
 {
-    auto minExt = this->bounds.getMinExtent();
-    auto maxExt = this->bounds.getMaxExtent();
-
-    int  cellsX = static_cast<int>(this->cellsPerAxis.x);
-    int  cellsY = static_cast<int>(this->cellsPerAxis.y);
-    int  cellsZ = static_cast<int>(this->cellsPerAxis.z);
-    
-    // Read the source files for the kernels:
-
     // === Simulation.cl : the basis for the PBF simulation ====================
-    
-    if (load) {
-        this->openCL.loadProgramFromFile("kernels/Simulation.cl");
-    }
+    //
+    // The solver core (see src/pbf) loads Simulation.cl itself, and works
+    // directly on the buffers allocated in initializeBuffers():
 
-    // KERNEL :: debugHistogram
-    
     if (load) {
-        this->openCL.loadKernel("debugHistogram");
+        this->solver = shared_ptr<pbf::Solver>(new pbf::Solver(this->openCL.getContext()
+                                                              ,this->openCL.getDevice()
+                                                              ,this->openCL.getQueue()
+                                                              ,ofToDataPath("")));
+        this->solver->setListener(this);
+        this->solver->setSolverIterations(Constants::SOLVER_ITERATIONS);
     }
-    this->openCL.kernel("debugHistogram")->setArg(0, this->cellHistogram);
-    this->openCL.kernel("debugHistogram")->setArg(1, this->cellPrefixSums);
-    this->openCL.kernel("debugHistogram")->setArg(2, this->numCells);
-    
-    // KERNEL :: debugSorting
 
-    if (load) {
-        this->openCL.loadKernel("debugSorting");
+    pbf::DeviceBuffers buffers;
+
+    buffers.parameters           = this->parameterBuffer.getCLMem();
+    buffers.particles            = this->particles.getCLBuffer().getCLMem();
+    buffers.particleToCell       = this->particleToCell.getCLMem();
+    buffers.sortedParticleToCell = this->sortedParticleToCell.getCLMem();
+    buffers.cellHistogram        = this->cellHistogram.getCLMem();
+    buffers.cellPrefixSums       = this->cellPrefixSums.getCLMem();
+    buffers.gridCellOffsets      = this->gridCellOffsets.getCLMem();
+    buffers.density              = this->density.getCLMem();
+    buffers.lambda               = this->lambda.getCLMem();
+    buffers.curl                 = this->curl.getCLMem();
+    buffers.extForces            = this->extForces.getCLMem();
+    buffers.posDelta             = this->posDelta.getCLMem();
+    buffers.renderPos            = this->renderPos.getCLBuffer().getCLMem();
+
+    int cells[3] = { static_cast<int>(this->cellsPerAxis.x)
+                   , static_cast<int>(this->cellsPerAxis.y)
+                   , static_cast<int>(this->cellsPerAxis.z) };
+
+    if (!this->solver->setup(this->numParticles
+                            ,cells
+                            ,this->getSolverBounds()
+                            ,this->parameters
+                            ,this->dt
+                            ,buffers)) {
+        ofLogError() << "Failed to set up the solver" << endl;
     }
-    this->openCL.kernel("debugSorting")->setArg(0, this->particleToCell);
-    this->openCL.kernel("debugSorting")->setArg(1, this->sortedParticleToCell);
-    this->openCL.kernel("debugSorting")->setArg(2, this->numParticles);
 
-    // KERNEL :: resetParticleQuantities
+    // === Visualize.cl : device-side attribute coloring =======================
+    //
+    // Only needed once an attribute is visualized, so it isn't built until
+    // then (see visualizeAttribute()); once built, its arguments are rebound
+    // along with the rest:
 
-    if (load) {
-        this->openCL.loadKernel("resetParticleQuantities");
+    if (this->computeAttributeKernel) {
+        this->setupVisualizeKernels(false);
     }
-    this->openCL.kernel("resetParticleQuantities")->setArg(0, this->particles);
-    this->openCL.kernel("resetParticleQuantities")->setArg(1, this->particleToCell);
-    this->openCL.kernel("resetParticleQuantities")->setArg(2, this->sortedParticleToCell);
-    this->openCL.kernel("resetParticleQuantities")->setArg(3, this->density);
-    this->openCL.kernel("resetParticleQuantities")->setArg(4, this->lambda);
-    this->openCL.kernel("resetParticleQuantities")->setArg(5, this->posDelta);
-    
-    // KERNEL :: resetCellQuantities
+}
+
+/**
+ * Loads (if load is true) kernels/Visualize.cl, built for the device's
+ * reduction group size, and binds the arguments of its kernels
+ */
+void Simulation::setupVisualizeKernels(bool load)
+{
+    msa::OpenCLProgramPtr program;
 
     if (load) {
-        this->openCL.loadKernel("resetCellQuantities");
+        program = loadKernelProgram(this->openCL
+                                   ,"kernels/Visualize.cl"
+                                   ,"#define REDUCTION_GROUP_SIZE " + ofToString(this->reductionGroupSize) + "\n");
     }
-    this->openCL.kernel("resetCellQuantities")->setArg(0, this->cellHistogram);
-    this->openCL.kernel("resetCellQuantities")->setArg(1, this->cellPrefixSums);
-    this->openCL.kernel("resetCellQuantities")->setArg(2, this->gridCellOffsets);
 
-    // KERNEL :: predictPosition
+    // KERNEL :: computeAttribute
 
     if (load) {
-        this->openCL.loadKernel("predictPosition");
+        this->computeAttributeKernel = this->openCL.loadKernel("computeAttribute", program);
     }
-    this->openCL.kernel("predictPosition")->setArg(0, this->particles);
-    this->openCL.kernel("predictPosition")->setArg(1, this->extForces);
-    this->openCL.kernel("predictPosition")->setArg(2, this->dt);
-    
-    // KERNEL :: discretizeParticlePositions
+    this->computeAttributeKernel->setArg(0, this->particles);
+    this->computeAttributeKernel->setArg(1, this->density);
+    this->computeAttributeKernel->setArg(2, this->lambda);
+    this->computeAttributeKernel->setArg(3, this->curl);
+    this->computeAttributeKernel->setArg(4, this->numParticles);
+    this->computeAttributeKernel->setArg(5, static_cast<int>(this->visualAttribute));
+    this->computeAttributeKernel->setArg(6, this->attributeValues);
+
+    // KERNEL :: reduceAttributeRange
 
     if (load) {
-        this->openCL.loadKernel("discretizeParticlePositions");
+        this->reduceAttributeRangeKernel = this->openCL.loadKernel("reduceAttributeRange", program);
     }
-    this->openCL.kernel("discretizeParticlePositions")->setArg(0, this->particles);
-    this->openCL.kernel("discretizeParticlePositions")->setArg(1, this->particleToCell);
-    this->openCL.kernel("discretizeParticlePositions")->setArg(2, this->cellHistogram);
-    this->openCL.kernel("discretizeParticlePositions")->setArg(3, cellsX);
-    this->openCL.kernel("discretizeParticlePositions")->setArg(4, cellsY);
-    this->openCL.kernel("discretizeParticlePositions")->setArg(5, cellsZ);
-    this->openCL.kernel("discretizeParticlePositions")->setArg(6, minExt);
-    this->openCL.kernel("discretizeParticlePositions")->setArg(7, maxExt);
-
-    // KERNEL :: countSortParticlesByCell
-    
+    this->reduceAttributeRangeKernel->setArg(0, this->attributeValues);
+    this->reduceAttributeRangeKernel->setArg(1, this->numParticles);
+    this->reduceAttributeRangeKernel->setArg(2, this->attributePartials);
+
+    // KERNEL :: finishAttributeRange
+
     if (load) {
-        this->openCL.loadKernel("countSortParticlesByCell");
+        this->finishAttributeRangeKernel = this->openCL.loadKernel("finishAttributeRange", program);
     }
-    this->openCL.kernel("countSortParticlesByCell")->setArg(0, this->particleToCell);
-    this->openCL.kernel("countSortParticlesByCell")->setArg(1, this->sortedParticleToCell);
-    this->openCL.kernel("countSortParticlesByCell")->setArg(2, this->cellPrefixSums);
-    this->openCL.kernel("countSortParticlesByCell")->setArg(3, this->numParticles);
-    
-    // KERNEL :: findParticleBins
-    
+    this->finishAttributeRangeKernel->setArg(0, this->attributePartials);
+    this->finishAttributeRangeKernel->setArg(1, (this->numParticles + this->reductionGroupSize - 1) / this->reductionGroupSize);
+    this->finishAttributeRangeKernel->setArg(2, this->attributeRange);
+
+    // KERNEL :: colorizeAttribute
+
     if (load) {
-        this->openCL.loadKernel("findParticleBins");
+        this->colorizeAttributeKernel = this->openCL.loadKernel("colorizeAttribute", program);
     }
-    this->openCL.kernel("findParticleBins")->setArg(0, this->sortedParticleToCell);
-    this->openCL.kernel("findParticleBins")->setArg(1, this->gridCellOffsets);
-    this->openCL.kernel("findParticleBins")->setArg(2, this->numParticles);
-    
-    // KERNEL :: estimateDensity
+    this->colorizeAttributeKernel->setArg(0, this->attributeValues);
+    this->colorizeAttributeKernel->setArg(1, this->numParticles);
+    this->colorizeAttributeKernel->setArg(2, this->attributeRange);
+    this->colorizeAttributeKernel->setArg(7, this->renderColor);
+}
 
-    if (load) {
-        this->openCL.loadKernel("estimateDensity");
+/******************************************************************************/
+
+/**
+ * Starts or stops splitting the steps between two devices. The particle
+ * state moves between the solver's buffers and the devices here, so stepping
+ * continues from the same state either way
+ *
+ * @param [in] enabled Whether to co-execute
+ */
+bool Simulation::setCoExecution(bool enabled)
+{
+    if (!enabled) {
+        this->coExecution.reset();
+        this->getParticleBuffer();
+        return true;
     }
-    this->openCL.kernel("estimateDensity")->setArg(0, this->parameterBuffer);
-    this->openCL.kernel("estimateDensity")->setArg(1, this->particles);
-    this->openCL.kernel("estimateDensity")->setArg(2, this->sortedParticleToCell);
-    this->openCL.kernel("estimateDensity")->setArg(3, this->gridCellOffsets);
-    this->openCL.kernel("estimateDensity")->setArg(4, this->numParticles);
-    this->openCL.kernel("estimateDensity")->setArg(5, cellsX);
-    this->openCL.kernel("estimateDensity")->setArg(6, cellsY);
-    this->openCL.kernel("estimateDensity")->setArg(7, cellsZ);
-    this->openCL.kernel("estimateDensity")->setArg(8, minExt);
-    this->openCL.kernel("estimateDensity")->setArg(9, maxExt);
-    this->openCL.kernel("estimateDensity")->setArg(10, this->density);
-    
-    // KERNEL :: computeLambda
 
-    if (load) {
-        this->openCL.loadKernel("computeLambda");
+    if (this->isCoExecuting()) {
+        return true;
     }
-    this->openCL.kernel("computeLambda")->setArg(0, this->parameterBuffer);
-    this->openCL.kernel("computeLambda")->setArg(1, this->particles);
-    this->openCL.kernel("computeLambda")->setArg(2, this->sortedParticleToCell);
-    this->openCL.kernel("computeLambda")->setArg(3, this->gridCellOffsets);
-    this->openCL.kernel("computeLambda")->setArg(4, this->density);
-    this->openCL.kernel("computeLambda")->setArg(5, this->numParticles);
-    this->openCL.kernel("computeLambda")->setArg(6, cellsX);
-    this->openCL.kernel("computeLambda")->setArg(7, cellsY);
-    this->openCL.kernel("computeLambda")->setArg(8, cellsZ);
-    this->openCL.kernel("computeLambda")->setArg(9, minExt);
-    this->openCL.kernel("computeLambda")->setArg(10, maxExt);
-    this->openCL.kernel("computeLambda")->setArg(11, this->lambda);
-    
-    // KERNEL :: computePositionDelta
 
-    if (load) {
-        this->openCL.loadKernel("computePositionDelta");
+    this->coExecution = shared_ptr<pbf::CoExecution>(new pbf::CoExecution(ofToDataPath("")));
+
+    if (!this->coExecution->open()) {
+        this->coExecution.reset();
+        return false;
     }
-    this->openCL.kernel("computePositionDelta")->setArg(0, this->parameterBuffer);
-    this->openCL.kernel("computePositionDelta")->setArg(1, this->particles);
-    this->openCL.kernel("computePositionDelta")->setArg(2, this->sortedParticleToCell);
-    this->openCL.kernel("computePositionDelta")->setArg(3, this->gridCellOffsets);
-    this->openCL.kernel("computePositionDelta")->setArg(4, this->numParticles);
-    this->openCL.kernel("computePositionDelta")->setArg(5, this->lambda);
-    this->openCL.kernel("computePositionDelta")->setArg(6, cellsX);
-    this->openCL.kernel("computePositionDelta")->setArg(7, cellsY);
-    this->openCL.kernel("computePositionDelta")->setArg(8, cellsZ);
-    this->openCL.kernel("computePositionDelta")->setArg(9, minExt);
-    this->openCL.kernel("computePositionDelta")->setArg(10, maxExt);
-    this->openCL.kernel("computePositionDelta")->setArg(11, this->posDelta);
-    
-    // KERNEL :: updatePositionDelta
 
-    if (load) {
-        this->openCL.loadKernel("updatePositionDelta");
+    this->openCL.finish();
+    this->particles.readFromDevice();
+    this->coExecutionPositions.assign(4 * this->numParticles, 1.0f);
+
+    if (!this->setupCoExecution()) {
+        this->coExecution.reset();
+        return false;
     }
-    this->openCL.kernel("updatePositionDelta")->setArg(0, this->posDelta);
-    this->openCL.kernel("updatePositionDelta")->setArg(1, this->particles);
 
-    // KERNEL :: resolveCollisions
+    return true;
+}
 
-    if (load) {
-        this->openCL.loadKernel("resolveCollisions");
+/**
+ * Hands the host copy of the particles to the co-executing devices
+ */
+bool Simulation::setupCoExecution()
+{
+    const ofVec3f& cells = this->cellsPerAxis;
+    int cellsPerAxis[3]  = { static_cast<int>(cells.x), static_cast<int>(cells.y), static_cast<int>(cells.z) };
+
+    return this->coExecution->setup(reinterpret_cast<pbf::Particle*>(&this->particles[0])
+                                   ,this->numParticles
+                                   ,cellsPerAxis
+                                   ,this->getSolverBounds()
+                                   ,this->solver->getParameters()
+                                   ,this->dt
+                                   ,this->solver->getSolverIterations());
+}
+
+/**
+ * While co-executing, the particle buffer is only written when something
+ * asks for it (e.g. the volume exporter), from the state last read back
+ * for drawing, rather than after every step
+ */
+msa::OpenCLBufferManagedT<Particle>& Simulation::getParticleBuffer()
+{
+    if (this->particleBufferStale) {
+        this->particles.writeToDevice();
+        this->particleBufferStale = false;
     }
-    this->openCL.kernel("resolveCollisions")->setArg(0, this->parameterBuffer);
-    this->openCL.kernel("resolveCollisions")->setArg(1, this->particles);
-    this->openCL.kernel("resolveCollisions")->setArg(2, minExt);
-    this->openCL.kernel("resolveCollisions")->setArg(3, maxExt);
 
-    // KERNEL :: computeCurl
+    return this->particles;
+}
 
-    if (load) {
-        this->openCL.loadKernel("computeCurl");
+/**
+ * Registers a collider. The collider is updated at the start of every step
+ * and resolved in every solver iteration; the simulation does not take
+ * ownership of it
+ *
+ * @param [in] collider The collider to add
+ */
+void Simulation::addCollider(Collider* collider)
+{
+    if (find(this->colliders.begin(), this->colliders.end(), collider) == this->colliders.end()) {
+        this->colliders.push_back(collider);
     }
-    this->openCL.kernel("computeCurl")->setArg(0, this->parameterBuffer);
-    this->openCL.kernel("computeCurl")->setArg(1, this->particles);
-    this->openCL.kernel("computeCurl")->setArg(2, this->sortedParticleToCell);
-    this->openCL.kernel("computeCurl")->setArg(3, this->gridCellOffsets);
-    this->openCL.kernel("computeCurl")->setArg(4, this->numParticles);
-    this->openCL.kernel("computeCurl")->setArg(5, cellsX);
-    this->openCL.kernel("computeCurl")->setArg(6, cellsY);
-    this->openCL.kernel("computeCurl")->setArg(7, cellsZ);
-    this->openCL.kernel("computeCurl")->setArg(8, minExt);
-    this->openCL.kernel("computeCurl")->setArg(9, maxExt);
-    this->openCL.kernel("computeCurl")->setArg(10, this->curl);
-    
-    // KERNEL ::  updatePosition
-    
-    if (load) {
-        this->openCL.loadKernel("updatePosition");
+}
+
+/**
+ * Unregisters a collider previously added with addCollider()
+ *
+ * @param [in] collider The collider to remove
+ */
+void Simulation::removeCollider(Collider* collider)
+{
+    this->colliders.erase(remove(this->colliders.begin(), this->colliders.end(), collider)
+                         ,this->colliders.end());
+}
+
+/**
+ * Selects the attribute the particles are colored by. ATTRIBUTE_NONE
+ * restores the default appearance
+ *
+ * @param [in] attribute The attribute to visualize
+ */
+void Simulation::setVisualAttribute(VisualAttribute attribute)
+{
+    this->visualAttribute = attribute;
+
+#ifndef DRAW_PARTICLES_AS_SPHERES
+    if (attribute == ATTRIBUTE_NONE) {
+        this->particleVertices.disableColors();
+    } else {
+        this->particleVertices.enableColors();
     }
-    this->openCL.kernel("updatePosition")->setArg(0, this->parameterBuffer);
-    this->openCL.kernel("updatePosition")->setArg(1, this->dt);
-    this->openCL.kernel("updatePosition")->setArg(2, this->particles);
-    this->openCL.kernel("updatePosition")->setArg(3, this->sortedParticleToCell);
-    this->openCL.kernel("updatePosition")->setArg(4, this->gridCellOffsets);
-    this->openCL.kernel("updatePosition")->setArg(5, this->numParticles);
-    this->openCL.kernel("updatePosition")->setArg(6, this->curl);
-    this->openCL.kernel("updatePosition")->setArg(7, cellsX);
-    this->openCL.kernel("updatePosition")->setArg(8, cellsY);
-    this->openCL.kernel("updatePosition")->setArg(9, cellsZ);
-    this->openCL.kernel("updatePosition")->setArg(10, minExt);
-    this->openCL.kernel("updatePosition")->setArg(11, maxExt);
-    this->openCL.kernel("updatePosition")->setArg(12, this->renderPos);
-    
-    // Set up the kernels for computing a prefix sum ("scan") in parallel:
-    this->prefixSum = shared_ptr<PrefixSum>(new PrefixSum(this->openCL));
+#endif
 }
 
-/******************************************************************************/
+/**
+ * Sets the fixed range attribute values are normalized against when
+ * auto-ranging is disabled
+ *
+ * @param [in] rangeMin Value mapped to the start of the transfer function
+ * @param [in] rangeMax Value mapped to the end of the transfer function
+ */
+void Simulation::setAttributeRange(float rangeMin, float rangeMax)
+{
+    this->rangeMin = rangeMin;
+    this->rangeMax = rangeMax;
+}
+
+/**
+ * Changes the time step, e.g. to take several smaller steps per frame
+ *
+ * @param [in] dt The new time step
+ */
+void Simulation::setTimeStep(float dt)
+{
+    this->dt = dt;
+    this->solver->setTimeStep(dt);
+}
+
+/**
+ * Draws only every stride-th particle from now on. The solver never reorders
+ * the particles, so they stay in the order they were placed in, and every
+ * Nth is an even sample of the fluid
+ *
+ * @param [in] stride 1 to draw every particle
+ */
+void Simulation::setRenderStride(int stride)
+{
+    stride = max(stride, 1);
+
+    if (stride == this->renderStride) {
+        return;
+    }
+
+    this->renderStride = stride;
+
+#ifndef DRAW_PARTICLES_AS_SPHERES
+
+    if (stride > 1) {
+
+        this->strideIndices.clear();
+
+        for (int i = 0; i < this->numParticles; i += stride) {
+            this->strideIndices.push_back(static_cast<ofIndexType>(i));
+        }
+
+        this->particleVertices.setIndexData(&this->strideIndices[0]
+                                           ,static_cast<int>(this->strideIndices.size())
+                                           ,GL_STATIC_DRAW);
+    }
+
+#endif
+}
 
 /**
  * Resets the current simulation stats bounding box back to the initial
@@ -587,7 +784,7 @@ void Simulation::setupKernels(bool load)
  */
 void Simulation::resetBounds()
 {
-    this->animFrameNumber = 0;
+    this->boundsAnimation.reset();
     this->bounds = this->originalBounds;
 }
 
@@ -601,6 +798,13 @@ void Simulation::reset()
     this->setupKernels(false);
     this->resetBounds();
     this->writeToGPU();
+
+    this->particleBufferStale = false;
+
+    if (this->isCoExecuting() && !this->setupCoExecution()) {
+        ofLogError() << "Couldn't reset the co-executed state; stepping on one device again" << endl;
+        this->coExecution.reset();
+    }
 }
 
 /**
@@ -608,51 +812,12 @@ void Simulation::reset()
  */
 void Simulation::stepBoundsAnimation()
 {
-    float value     = 0.0f;
-    float pi        = static_cast<float>(M_PI);
-    float t         = static_cast<float>(this->animFrameNumber);
-    float origMinX  = this->originalBounds.getMinExtent().x;
-    float origMaxX  = this->originalBounds.getMaxExtent().x;
-    float width     = origMaxX - origMinX;
-    float limit     = width * 0.66;
-    float halfLimit = limit * 0.5f;
-    float limitMinX = origMinX + halfLimit;
-    float limitMaxX = origMaxX - halfLimit;
-    
-    if (this->animType == SINE_WAVE) {
-        
-        float theta = ofDegToRad(static_cast<float>(this->animFrameNumber % 720));
-        value   = this->animAmp * sin(this->animPeriod * pi * theta);
+    pbf::Bounds animated = this->getSolverBounds();
 
-        this->bounds.getMaxExtent().x = origMaxX - value;
-        
-        if (this->animBothSides) {
-            this->bounds.getMinExtent().x = origMinX + value;
-        }
-        
-    } else if (this->animType == LINEAR_RAMP) {
-        
-        float tPeriod = (t / this->animPeriod) * this->dt;
-        value = 2.0f * this->animAmp * (tPeriod - floor(0.5f + tPeriod));
-    
-        this->bounds.getMaxExtent().x = origMaxX - value;
-        
-        if (this->animBothSides) {
-            this->bounds.getMinExtent().x = origMinX + value;
-        }
-        
-    } else if (this->animType == COMPRESS) {
-
-        if (this->bounds.getMaxExtent().x >= limitMaxX) {
-            this->bounds.getMaxExtent().x -= 0.25f;
-        }
+    this->boundsAnimation.step(this->getOriginalSolverBounds(), animated, this->dt);
 
-        if (this->animBothSides && this->bounds.getMinExtent().x <= limitMinX) {
-            this->bounds.getMinExtent().x += 0.25f;
-        }
-    }
-    
-    this->animFrameNumber++;
+    this->bounds.getMinExtent().x = animated.min[0];
+    this->bounds.getMaxExtent().x = animated.max[0];
 }
 
 /**
@@ -665,14 +830,6 @@ void Simulation::stepBoundsAnimation()
  */
 void Simulation::step()
 {
-    // Solver iterations (this will be adjustable later)
-
-    int N = Constants::SOLVER_ITERATIONS;
-
-    // Intialize the simulation step:
-    
-    this->resetQuantities();
-    
     // Where the actual work is done: the sequence of substeps follows
     // more-or-less from the listing "Algorithm 1 Simulation Loop" in the
     // paper "Position Based Fluids". The main difference is that we are using
@@ -682,25 +839,30 @@ void Simulation::step()
     // in the slides
     // "￼FAST FIXED-RADIUS NEAREST NEIGHBORS: INTERACTIVE MILLION-PARTICLE FLUID"
     // that uses counting sort as an alternative to radix sort
+    //
+    // See pbf::Solver::step(); colliders are advanced and resolved from the
+    // beginStep() and solverIteration() callbacks
 
-    this->predictPositions(); // See (1) - (4)
-    
-    this->findNeighboringParticles(); // See (5) - (7)
+    this->gridBounds = this->bounds;
+    this->solver->setBounds(this->getSolverBounds());
 
-    // Solver runs for N iterations:
+    if (this->isCoExecuting()) {
+        this->stepCoExecution();
+        return;
+    }
 
-    for (int i = 0; i < N; i++) { // See (8) - (19)
+    // The render positions are shared with OpenGL, so they must be acquired
+    // while the solver writes to them:
 
-        this->calculateDensity(); // See (9) - (12)
+    this->renderPos.getCLBuffer().lockGLObject();
+    this->solver->step();
+    this->renderPos.getCLBuffer().unlockGLObject();
 
-        this->calculatePositionDelta(); // See (13)
+    // Color the particles by the selected attribute, if any:
 
-        //this->handleCollisions(); // See (14)
-        
-        this->updatePositionDelta(); // See (17)
+    if (this->visualAttribute != ATTRIBUTE_NONE) {
+        this->visualizeAttribute();
     }
-
-    this->updatePosition(); // See (20) - (24)
     
     // Make sure the OpenCL work queue is empty before proceeding. This will
     // block until all the stuff in GPU-land is done before moving forward
@@ -734,6 +896,46 @@ void Simulation::step()
     this->frameNumber++;
 }
 
+/**
+ * Takes a step on two devices at once (see setCoExecution()). The state
+ * stays on the devices; the owned particles are read back for drawing, and
+ * the solver's particle buffer is only brought up to date when it's needed
+ * (see getParticleBuffer())
+ */
+void Simulation::stepCoExecution()
+{
+    pbf::Particle* state = reinterpret_cast<pbf::Particle*>(&this->particles[0]);
+
+    if (!this->coExecution->step(this->getSolverBounds()
+                                ,this->solver->getParameters()
+                                ,this->dt
+                                ,this->solver->getSolverIterations()
+                                ,&this->solver->getForceFields())
+        || !this->coExecution->readParticles(state)) {
+        ofLogError() << "Co-execution step failed; stepping on one device again" << endl;
+        this->coExecution.reset();
+        this->getParticleBuffer();
+        return;
+    }
+
+    this->particleBufferStale = true;
+
+    for (int i = 0; i < this->numParticles; i++) {
+        const Particle& p = this->particles[i];
+        this->coExecutionPositions[4 * i]     = p.pos.x;
+        this->coExecutionPositions[4 * i + 1] = p.pos.y;
+        this->coExecutionPositions[4 * i + 2] = p.pos.z;
+    }
+
+    this->showPositions(&this->coExecutionPositions[0]);
+
+    if (this->animBounds) {
+        this->stepBoundsAnimation();
+    }
+
+    this->frameNumber++;
+}
+
 /******************************************************************************/
 
 /**
@@ -743,28 +945,29 @@ void Simulation::step()
  */
 void Simulation::drawGrid(const ofCamera& camera)
 {
-    auto p1 = this->bounds.getMinExtent();
-    auto p2 = this->bounds.getMaxExtent();
+    auto p1    = this->bounds.getMinExtent();
+    auto p2    = this->bounds.getMaxExtent();
+    auto cells = this->getBinnedCellsPerAxis();
     
-    float xCellWidth = (p2.x - p1.x) / static_cast<float>(this->cellsPerAxis.x);
+    float xCellWidth = (p2.x - p1.x) / static_cast<float>(cells.x);
     float halfXWidth = xCellWidth * 0.5f;
-    float yCellWidth = (p2.y - p1.y) / static_cast<float>(this->cellsPerAxis.y);
+    float yCellWidth = (p2.y - p1.y) / static_cast<float>(cells.y);
     float halfYWidth = yCellWidth * 0.5f;
-    float zCellWidth = (p2.z - p1.z) / static_cast<float>(this->cellsPerAxis.z);
+    float zCellWidth = (p2.z - p1.z) / static_cast<float>(cells.z);
     float halfZWidth = zCellWidth * 0.5f;
     
     ofNoFill();
     ofSetColor(0, 255, 0);
 
-    for (int i = 1; i < (2  * this->cellsPerAxis.x); i += 2) {
+    for (int i = 1; i < (2  * cells.x); i += 2) {
 
         float xCorner = p1.x + (static_cast<float>(i) * halfXWidth);
 
-        for (int j = 1; j < (2  * this->cellsPerAxis.y); j += 2) {
+        for (int j = 1; j < (2  * cells.y); j += 2) {
         
             float yCorner = p1.y + (static_cast<float>(j) * halfYWidth);
         
-            for (int k = 1; k < (2  * this->cellsPerAxis.z); k += 2) {
+            for (int k = 1; k < (2  * cells.z); k += 2) {
                 
                 float zCorner = p1.z + (static_cast<float>(k) * halfZWidth);
 
@@ -809,26 +1012,48 @@ void Simulation::drawParticles(const ofCamera& camera)
 {
     auto cp              = camera.getPosition();
     float particleRadius = this->getParameters().particleRadius ;
+
+    // Fewer particles are drawn larger, so they cover about the same volume:
+
+    float strideScale = powf(static_cast<float>(this->renderStride), 1.0f / 3.0f);
     
 #if DRAW_PARTICLES_AS_SPHERES
 
+    // Attribute colors go through the current color (gl_Color), like any
+    // other oF drawing:
+
+    bool colorByAttribute = this->visualAttribute != ATTRIBUTE_NONE;
+
     this->shader.begin();
-        this->shader.setUniform3f("cameraPosition", cp.x, cp.y, cp.z);
-        for (int i = 0; i < this->numParticles; i++) {
+        this->shader.setUniform3f(UNIFORM_CAMERA_POSITION, cp.x, cp.y, cp.z);
+        for (int i = 0; i < this->numParticles; i += this->renderStride) {
             Particle &p = this->particles[i];
+            if (colorByAttribute) {
+                float4 &c = this->renderColor[i];
+                ofSetColor(ofFloatColor(c.x, c.y, c.z, c.w));
+            }
             ofPushMatrix();
                 ofTranslate(p.pos.x, p.pos.y, p.pos.z);
+                ofScale(strideScale, strideScale, strideScale);
                 this->particleMesh.draw();
             ofPopMatrix();
         }
     this->shader.end();
 
+    if (colorByAttribute) {
+        ofSetColor(255, 255, 255);
+    }
+
 #else
     
     this->shader.begin();
-        this->shader.setUniform1f("particleRadius", particleRadius * 50.0f);
-        this->shader.setUniform3f("cameraPosition", cp.x, cp.y, cp.z);
-        this->particleVertices.draw(GL_POINTS, 0, this->numParticles);
+        this->shader.setUniform1f(UNIFORM_PARTICLE_RADIUS, particleRadius * 50.0f * strideScale);
+        this->shader.setUniform3f(UNIFORM_CAMERA_POSITION, cp.x, cp.y, cp.z);
+        if (this->renderStride > 1) {
+            this->particleVertices.drawElements(GL_POINTS, static_cast<int>(this->strideIndices.size()));
+        } else {
+            this->particleVertices.draw(GL_POINTS, 0, this->numParticles);
+        }
     this->shader.end();
 
 #endif
@@ -850,6 +1075,30 @@ void Simulation::drawParticles(const ofCamera& camera)
     }
 }
 
+/**
+ * Uploads the given positions to the particle vertex buffer, where the solver
+ * would otherwise have written them
+ *
+ * @param [in] positions numParticles homogenous points (x,y,z,w)
+ */
+void Simulation::showPositions(const float* positions)
+{
+#if DRAW_PARTICLES_AS_SPHERES
+
+    for (int i = 0; i < this->numParticles; i++) {
+        Particle &p = this->particles[i];
+        p.pos.x = positions[4 * i];
+        p.pos.y = positions[4 * i + 1];
+        p.pos.z = positions[4 * i + 2];
+    }
+
+#else
+
+    this->particleVertices.updateVertexData(positions, this->numParticles);
+
+#endif
+}
+
 /**
  * This method is once per step of the simulation to render all graphical
  * output, including rendering the bounding box of the simulated environment,
@@ -868,160 +1117,116 @@ void Simulation::draw(const ofCamera& camera)
 
     this->drawParticles(camera);
 
+    for (auto i = this->colliders.begin(); i != this->colliders.end(); i++) {
+        (*i)->draw();
+    }
+
     ofDrawAxis(2.0f);
 }
 
 /******************************************************************************/
 
 /**
- * This implementation is based off of the method described in
- * "￼FAST FIXED-RADIUS NEAREST NEIGHBORS: INTERACTIVE MILLION-PARTICLE FLUID" by
- * Hoetzlein, 2014 that uses counting sort as an alternative to radix sort.
- *
- * See http://on-demand.gputechconf.com/gtc/2014/presentations/S4117-fast-fixed-radius-nearest-neighbor-gpu.pdf
+ * Returns the current bounds in the form the solver takes them
  */
-void Simulation::findNeighboringParticles()
+pbf::Bounds Simulation::getSolverBounds()
 {
-    this->discretizeParticlePositions();
-    this->sortParticlesByCell();
+    return Simulation::toSolverBounds(this->bounds);
 }
 
 /**
- * Resets various particle quantities, like density, etc.
- *
- * @see kernels/Simulation.cl (resetParticleQuantities, resetCellQuantities) for details
+ * Returns the bounds the simulation started with, as the solver expects them
  */
-void Simulation::resetQuantities()
+pbf::Bounds Simulation::getOriginalSolverBounds()
 {
-    this->openCL.kernel("resetParticleQuantities")->run1D(this->numParticles);
-    this->openCL.kernel("resetCellQuantities")->run1D(this->numCells);
+    return Simulation::toSolverBounds(this->originalBounds);
 }
 
 /**
- * Updates the predicted positions of the particles via an explicit Euler step
+ * Converts an AABB to the bounds type used by the solver
  *
- * @see kernels/Simulation.cl (predictPosition) for details
+ * @param [in] aabb The box to convert
  */
-void Simulation::predictPositions()
+pbf::Bounds Simulation::toSolverBounds(AABB aabb)
 {
-    this->openCL.kernel("predictPosition")->run1D(this->numParticles);
-}
+    auto minExt = aabb.getMinExtent();
+    auto maxExt = aabb.getMaxExtent();
 
-/**
- * Discretizes all of the particles to a grid cell, where the number of
- * grid cells along each axis in the simulated space is specified by 
- * cellsPerAxis, e.g. (4,5,6) specifies 4 cells in the x-axs, 5 in the y-axis, 
- * and 6 in the z-axis
- *
- * @see kernels/Simulation.cl (discretizeParticlePositions) for details
- */
-void Simulation::discretizeParticlePositions()
-{
-    this->openCL.kernel("discretizeParticlePositions")->setArg(6, this->bounds.getMinExtent());
-    this->openCL.kernel("discretizeParticlePositions")->setArg(7, this->bounds.getMaxExtent());
-    this->openCL.kernel("discretizeParticlePositions")->run1D(this->numParticles);
+    pbf::Bounds solverBounds = {{ minExt.x, minExt.y, minExt.z }
+                               ,{ maxExt.x, maxExt.y, maxExt.z }};
+
+    return solverBounds;
 }
 
 /**
- * Sorts the particles by the assigned grid cell. Following the run of this
- * function, sortedParticleToCell (on the GPU) will contain a
- * listing of ParticlePosition, that are sorted by linearized cell indices, e.g.
- * particles that are in the same cell will be consecutive in 
- * sortedParticleToCell, making neighbor search quick.
- *
- * @see kernels/Simulation.cl (countSortParticles) for details
+ * Called by the solver after per-step quantities are reset, before particle
+ * positions are predicted
  */
-void Simulation::sortParticlesByCell()
+void Simulation::beginStep(float dt)
 {
-    // First, compute the prefix sums of the entries of the cell histogram:
-    
-    this->prefixSum->scan(this->cellPrefixSums, this->cellHistogram, this->numCells);
-    
-    // next, use the prefix sums to determine the sorted position of the
-    // particles:
-    
-    this->openCL.kernel("countSortParticlesByCell")->run1D(this->numParticles);
+    // Advance any animated obstacles to the end of this step:
 
-    //this->openCL.kernel("debugHistogram")->run1D(1);
-    //this->openCL.kernel("debugSorting")->run1D(1);
-    
-    // Finally, compute the bins/cells that each particle is in and store
-    // the (start,length) tuples for each grid cell span in an array, which we
-    // will use for lookup later:
-    
-    this->openCL.kernel("findParticleBins")->run1D(this->numParticles);
+    this->updateColliders();
 }
 
 /**
- * Computes the density for each particle using the SPH density estimator
- * 
- * (*) Specifically, this function is part of the constraint solver loop
- *
- * @see kernels/Simulation.cl (estimateDensity) for details
+ * Called by the solver at the end of every constraint solver iteration
  */
-void Simulation::calculateDensity()
+void Simulation::solverIteration(int iteration)
 {
-    this->openCL.kernel("estimateDensity")->setArg(8, this->bounds.getMinExtent());
-    this->openCL.kernel("estimateDensity")->setArg(9, this->bounds.getMaxExtent());
-    this->openCL.kernel("estimateDensity")->run1D(this->numParticles);
+    this->resolveColliders(); // See (14)
 }
 
 /**
- * Computes the position delta
- *
- * (*) Specifically, this function is part of the constraint solver loop
- *
- * @see kernels/Simulation.cl (computeLambda, computePositionDelta) for details
+ * Advances all registered colliders by one time step, refreshing any state
+ * they keep on the GPU
  */
-void Simulation::calculatePositionDelta()
+void Simulation::updateColliders()
 {
-    this->openCL.kernel("computeLambda")->setArg(9, this->bounds.getMinExtent());
-    this->openCL.kernel("computeLambda")->setArg(10, this->bounds.getMaxExtent());
-    this->openCL.kernel("computeLambda")->run1D(this->numParticles);
-
-    this->openCL.kernel("computePositionDelta")->setArg(9, this->bounds.getMinExtent());
-    this->openCL.kernel("computePositionDelta")->setArg(10, this->bounds.getMaxExtent());
-    this->openCL.kernel("computePositionDelta")->run1D(this->numParticles);
+    for (auto i = this->colliders.begin(); i != this->colliders.end(); i++) {
+        (*i)->update(this->dt);
+    }
 }
 
 /**
- * Apply the position delta
- *
- * @see kernels/Simulation.cl (updatePositionDelta) for details
+ * Pushes the predicted particle positions out of all registered colliders
  */
-void Simulation::updatePositionDelta()
+void Simulation::resolveColliders()
 {
-    this->openCL.kernel("updatePositionDelta")->run1D(this->numParticles);
+    for (auto i = this->colliders.begin(); i != this->colliders.end(); i++) {
+        (*i)->resolve(*this);
+    }
 }
 
 /**
- * TODO: All this does now is clamp the particle positions to the simulation
- * bounding box
+ * Colors the particles by the selected attribute without any host
+ * round-trip: the attribute is gathered, its range optionally found by a
+ * two-pass min/max reduction, and the resulting colors written directly into
+ * the particle VBO's color buffer
  *
- * @see kernels/Simulation.cl (resolveCollisions) for details
+ * @see kernels/Visualize.cl for details
  */
-void Simulation::handleCollisions()
+void Simulation::visualizeAttribute()
 {
-    this->openCL.kernel("resolveCollisions")->setArg(2, this->bounds.getMinExtent());
-    this->openCL.kernel("resolveCollisions")->setArg(3, this->bounds.getMaxExtent());
-    this->openCL.kernel("resolveCollisions")->run1D(this->numParticles);
-}
+    if (!this->computeAttributeKernel) {
+        this->setupVisualizeKernels(true);
+    }
 
-/**
- * Updates the actual, final position of the particles in the current
- * simulation step
- *
- * @see kernels/Simulation.cl (computeCurl, updatePosition) for details
- */
-void Simulation::updatePosition()
-{
-    this->openCL.kernel("computeCurl")->setArg(8, this->bounds.getMinExtent());
-    this->openCL.kernel("computeCurl")->setArg(9, this->bounds.getMaxExtent());
-    this->openCL.kernel("computeCurl")->run1D(this->numParticles);
+    int numGroups = (this->numParticles + this->reductionGroupSize - 1) / this->reductionGroupSize;
+
+    this->computeAttributeKernel->setArg(5, static_cast<int>(this->visualAttribute));
+    this->computeAttributeKernel->run1D(this->numParticles);
+
+    if (this->autoRange) {
+        this->reduceAttributeRangeKernel->run1D(numGroups * this->reductionGroupSize, this->reductionGroupSize);
+        this->finishAttributeRangeKernel->run1D(this->reductionGroupSize, this->reductionGroupSize);
+    }
 
-    this->openCL.kernel("updatePosition")->setArg(10, this->bounds.getMinExtent());
-    this->openCL.kernel("updatePosition")->setArg(11, this->bounds.getMaxExtent());
-    this->openCL.kernel("updatePosition")->run1D(this->numParticles);
+    this->colorizeAttributeKernel->setArg(3, this->autoRange ? 1 : 0);
+    this->colorizeAttributeKernel->setArg(4, this->rangeMin);
+    this->colorizeAttributeKernel->setArg(5, this->rangeMax);
+    this->colorizeAttributeKernel->setArg(6, static_cast<int>(this->transferFunction));
+    this->colorizeAttributeKernel->run1D(this->numParticles);
 }
 
 /******************************************************************************/
@@ -9,10 +9,14 @@
 
 #include <iostream>
 #include <memory>
-#include "Parameters.h"
+#include <vector>
+#include "pbf/Parameters.h"
+#include "pbf/Solver.h"
+#include "pbf/BoundsAnimation.h"
+#include "pbf/CoExecution.h"
 #include "Constants.h"
 #include "AABB.h"
-#include "PrefixSum.h"
+#include "Collider.h"
 #include "MSAOpenCL.h"
 
 /******************************************************************************/
@@ -81,16 +85,47 @@ typedef struct {
  * code defining the implementation of this class was originally derived
  * from the second assignment in the class, which in turn, was based off of
  * Matthias Muller's "Position Based Dynamics" paper
+ *
+ * The stepping itself is done by pbf::Solver (see src/pbf), which has no
+ * openFrameworks dependency. This class owns the device buffers the solver
+ * works on, shares them with OpenGL for rendering, and adds the
+ * openFrameworks-side features: drawing, colliders, bounds animation and
+ * attribute visualization
  */
-class Simulation
+class Simulation : protected pbf::SolverListener
 {
     public:
         enum AnimationType
         {
-            SINE_WAVE
-           ,LINEAR_RAMP
-           ,COMPRESS
+            SINE_WAVE   = pbf::BoundsAnimation::SINE_WAVE
+           ,LINEAR_RAMP = pbf::BoundsAnimation::LINEAR_RAMP
+           ,COMPRESS    = pbf::BoundsAnimation::COMPRESS
         };
+
+        // Per-particle quantities the particles can be colored by; must
+        // match the ATTRIBUTE_* definitions in kernels/Visualize.cl
+        enum VisualAttribute
+        {
+            ATTRIBUTE_NONE
+           ,ATTRIBUTE_SPEED
+           ,ATTRIBUTE_DENSITY
+           ,ATTRIBUTE_LAMBDA
+           ,ATTRIBUTE_VORTICITY
+        };
+
+        // Mappings of normalized attribute values to colors; must match the
+        // TRANSFER_* definitions in kernels/Visualize.cl
+        enum TransferFunction
+        {
+            TRANSFER_GRAYSCALE
+           ,TRANSFER_HEAT
+           ,TRANSFER_JET
+           ,TRANSFER_COOL_WARM
+        };
+
+        // Largest work group size of the attribute min/max reduction; the
+        // one used is clamped to the device's (see reductionGroupSize)
+        static const int MAX_REDUCTION_GROUP_SIZE = 256;
     
     private:
         // Count of the current frame number
@@ -109,20 +144,29 @@ class Simulation
         // animated, e.g. moving in some periodic fashion
         bool animBounds;
 
-        // Counter used for the current bounds-modifying animation operation
-        unsigned int animFrameNumber;
-    
-        // The animation type for animating the bounds of the simulation
-        AnimationType animType;
-    
-        // Bounds animation period
-        float animPeriod;
-    
-        // Bounds animation amplitude
-        float animAmp;
-    
-        // Flag to toggle bounds animation on both sides of the simulation area
-        bool animBothSides;
+        // Type, period, amplitude and step counter of the bounds animation
+        pbf::BoundsAnimation boundsAnimation;
+
+        // Attribute the particles are colored by, if any
+        VisualAttribute visualAttribute;
+
+        // Transfer function used to map the attribute to a color
+        TransferFunction transferFunction;
+
+        // If true, the attribute range is found every step by a min/max
+        // reduction on the device, otherwise [rangeMin, rangeMax] is used
+        bool autoRange;
+        float rangeMin;
+        float rangeMax;
+
+        // Every renderStride-th particle is drawn (see setRenderStride());
+        // when drawing points, through an index buffer of their indices
+        int renderStride;
+
+        // Work group size of the attribute min/max reduction: the largest
+        // power of two up to MAX_REDUCTION_GROUP_SIZE the device allows
+        int reductionGroupSize;
+        std::vector<ofIndexType> strideIndices;
 
         // Given a particle count, particle radius and world bounds,
         // find the "ideal" cell count per axis
@@ -144,10 +188,15 @@ class Simulation
         // OpenCL manager
         msa::OpenCL& openCL;
     
-        // Used to compute the prefix sum of the cell histogram array. This
-        // is needed in order to sort the particles by grid cell so fast,
-        // fixed-radius particle neighbor lookup is possible
-        std::shared_ptr<PrefixSum> prefixSum;
+        // The solver core; steps the simulation on the buffers below
+        std::shared_ptr<pbf::Solver> solver;
+
+        // Kernels, resolved once when they are loaded rather than looked up
+        // by name on every run
+        msa::OpenCLKernelPtr computeAttributeKernel;
+        msa::OpenCLKernelPtr reduceAttributeRangeKernel;
+        msa::OpenCLKernelPtr finishAttributeRangeKernel;
+        msa::OpenCLKernelPtr colorizeAttributeKernel;
     
         // Basic shader
         ofShader shader;
@@ -155,6 +204,7 @@ class Simulation
         // Bounding volume
         AABB originalBounds; // Starting, unmodified bounds
         AABB bounds;         // Modifiable bounds
+        AABB gridBounds;     // Bounds used to bin the particles in the last step
     
         // Timestep size:
         float dt;
@@ -165,6 +215,10 @@ class Simulation
         // Total number of particles in the system
         int numParticles;
 
+        // Optional initial particle states (e.g. imported from a point
+        // cloud). If empty, particles are placed randomly in the bounds
+        std::vector<Particle> initialState;
+
         // Simulation parameters to pass to the kernels
         Parameters parameters;
  
@@ -218,25 +272,52 @@ class Simulation
         // Final render position for OpenCL <-> OpenGL instanced rendering
         msa::OpenCLBufferManagedT<float4> renderPos;
 
+        // Per-particle attribute colors, shared with the particle VBO's
+        // color buffer when drawing points
+        msa::OpenCLBufferManagedT<float4> renderColor;
+
+        // Scalar attribute values the colors are computed from
+        // - Buffer of float
+        msa::OpenCLBuffer attributeValues;
+
+        // Per work group (min, max) pairs, and the final (min, max) pair, of
+        // the attribute range reduction
+        // - Buffers of float2
+        msa::OpenCLBuffer attributePartials;
+        msa::OpenCLBuffer attributeRange;
+
+        // Obstacles the particles collide against (not owned)
+        std::vector<Collider*> colliders;
+
+        // If set, steps run on two devices at once instead of the solver
+        // (see setCoExecution()); the positions are staged here for drawing
+        std::shared_ptr<pbf::CoExecution> coExecution;
+        std::vector<float> coExecutionPositions;
+
+        // Set while the host copy of the particles is ahead of the particle
+        // buffer (see getParticleBuffer())
+        bool particleBufferStale;
+
         // Initialization-related functions:
         void initialize();
         void initializeBuffers();
         void setupKernels(bool load);
+        void setupVisualizeKernels(bool load);
         void initializeOpenGL();
 
-        // Particle sorting functions:
-        void discretizeParticlePositions();
-        void sortParticlesByCell();
-    
         // Simulation state-related functions:
-        void resetQuantities();
-        void predictPositions();
-        void findNeighboringParticles();
-        void calculateDensity();
-        void calculatePositionDelta();
-        void updatePositionDelta();
-        void handleCollisions();
-        void updatePosition();
+        pbf::Bounds getSolverBounds();
+        pbf::Bounds getOriginalSolverBounds();
+        static pbf::Bounds toSolverBounds(AABB aabb);
+        void updateColliders();
+        void resolveColliders();
+        void visualizeAttribute();
+        bool setupCoExecution();
+        void stepCoExecution();
+
+        // pbf::SolverListener:
+        void beginStep(float dt);
+        void solverIteration(int iteration);
     
         // Drawing-related functions:
         void drawBounds(const ofCamera& camera);
@@ -258,6 +339,11 @@ class Simulation
                   ,ofVec3f cellsPerAxis
                   ,Parameters parameters);
 
+        Simulation(msa::OpenCL& openCL
+                  ,AABB bounds
+                  ,const std::vector<Particle>& initialState
+                  ,Parameters parameters);
+
         virtual ~Simulation();
 
         const unsigned int getFrameNumber() const { return this->frameNumber; }
@@ -270,7 +356,51 @@ class Simulation
         const unsigned int getNumberOfParticles() const { return this->numParticles; }
     
         const unsigned int getNumberOfCells() const { return this->numCells; }
-    
+
+        // The grid the solver bins the particles into; coarser than the one
+        // above while the half-cell neighbor stencil is selected
+        ofVec3f getBinnedCellsPerAxis() const
+        {
+            const int* cells = this->solver->getCellsPerAxis();
+            return ofVec3f(cells[0], cells[1], cells[2]);
+        }
+
+        int getNumberOfBinnedCells() const { return this->solver->getNumberOfCells(); }
+
+        const AABB& getGridBounds() const { return this->gridBounds; }
+
+        // Device state, for auxiliary passes (e.g. volume export) that run
+        // against the results of the last step:
+        msa::OpenCL& getOpenCL()                                  { return this->openCL; }
+        pbf::Solver& getSolver()                                  { return *this->solver; }
+        pbf::PrefixSum& getPrefixSum()                            { return this->solver->getPrefixSum(); }
+        msa::OpenCLBuffer& getParameterBuffer()                   { return this->parameterBuffer; }
+        msa::OpenCLBufferManagedT<Particle>& getParticleBuffer();
+        msa::OpenCLBuffer& getCellHistogramBuffer()               { return this->cellHistogram; }
+        msa::OpenCLBuffer& getSortedParticleToCellBuffer()        { return this->sortedParticleToCell; }
+        msa::OpenCLBuffer& getGridCellOffsetsBuffer()             { return this->gridCellOffsets; }
+        msa::OpenCLBuffer& getDensityBuffer()                     { return this->density; }
+    
+        /**
+         * Batched spatial queries against the particles and grid of the last
+         * step, answered on the device (see pbf::SpatialQueries): the
+         * particles in spheres and boxes, as ranges into one compacted list
+         * of particle indices, and density and velocity at probe points.
+         * Both block until their results are read back
+         */
+        bool queryParticles(const std::vector<pbf::SpatialQuery>& queries
+                           ,std::vector<pbf::QueryRange>& ranges
+                           ,std::vector<int>& indices)
+        {
+            return this->solver->findParticles(queries, ranges, indices);
+        }
+
+        bool probe(const std::vector<pbf::SpatialQuery>& probes
+                  ,std::vector<pbf::ProbeResult>& results)
+        {
+            return this->solver->probe(probes, results);
+        }
+
         const Parameters& getParameters() const;
         void setParameters(const Parameters& parameters);
     
@@ -283,17 +413,60 @@ class Simulation
         void enableBoundsAnimation()     { this->animBounds = true; }
         void disableBoundsAnimation()    { this->animBounds = false; }
 
-        void enableBothSidesAnimation()  { this->animBothSides = true; }
-        void disableBothSidesAnimation() { this->animBothSides = false; }
-    
-        void setAnimationType(AnimationType animType) { this->animType = animType; }
-        void setAnimationPeriod(float period)         { this->animPeriod = period; }
-        void setAnimationAmp(float amp)               { this->animAmp = amp; }
+        void enableBothSidesAnimation()  { this->boundsAnimation.bothSides = true; }
+        void disableBothSidesAnimation() { this->boundsAnimation.bothSides = false; }
+    
+        AnimationType getAnimationType() const        { return static_cast<AnimationType>(this->boundsAnimation.type); }
+        void setAnimationType(AnimationType animType) { this->boundsAnimation.type = static_cast<pbf::BoundsAnimation::Type>(animType); }
+        void setAnimationPeriod(float period)         { this->boundsAnimation.period = period; }
+        void setAnimationAmp(float amp)               { this->boundsAnimation.amplitude = amp; }
+
+        VisualAttribute getVisualAttribute() const         { return this->visualAttribute; }
+        void setVisualAttribute(VisualAttribute attribute);
+
+        TransferFunction getTransferFunction() const       { return this->transferFunction; }
+        void setTransferFunction(TransferFunction transfer) { this->transferFunction = transfer; }
+
+        const bool autoRangeEnabled() const { return this->autoRange; }
+        void enableAutoRange()              { this->autoRange = true; }
+        void disableAutoRange()             { this->autoRange = false; }
+        void setAttributeRange(float rangeMin, float rangeMax);
+
+        // Time step of every step(); the solver's is kept in sync
+        float getTimeStep() const { return this->dt; }
+        void setTimeStep(float dt);
+
+        /**
+         * Level of detail of the particle rendering: only every Nth
+         * particle is drawn, enlarged so the fluid covers about the same
+         * volume. 1 draws all of them
+         */
+        int getRenderStride() const { return this->renderStride; }
+        void setRenderStride(int stride);
+
+        /**
+         * Splits the steps between two OpenCL devices (the GPU and the CPU
+         * if there are both; see pbf::CoExecution). The particle state stays
+         * on the two devices, and is read back every step only for drawing;
+         * colliders and attribute coloring are skipped while co-executing.
+         * Returns false if two devices couldn't be found
+         */
+        bool setCoExecution(bool enabled);
+        bool isCoExecuting() const { return this->coExecution && this->coExecution->isOpen(); }
+        const pbf::CoExecution* getCoExecution() const { return this->coExecution.get(); }
+
+        void addCollider(Collider* collider);
+        void removeCollider(Collider* collider);
     
         void reset();
         void step();
         void resetBounds();
         void draw(const ofCamera& camera);
+
+        // Replaces the drawn particle positions (x,y,z,w per particle) with
+        // ones that didn't come from the solver, e.g. a recorded frame being
+        // played back. They are drawn until the next step
+        void showPositions(const float* positions);
 };
 
 #endif
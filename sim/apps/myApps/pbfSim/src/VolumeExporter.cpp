@@ -0,0 +1,372 @@
+/*******************************************************************************
+ * VolumeExporter.cpp
+ * - Sparse brick volume export of the simulation's density and velocity
+ *   fields
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "ofMain.h"
+#include "VolumeExporter.h"
+#include "KernelPrograms.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/*******************************************************************************
+ * BrickVolumeWriter
+ ******************************************************************************/
+
+/**
+ * Creates a new writer that stores files in the given directory (relative to
+ * the data folder). The directory is created if it does not exist
+ */
+BrickVolumeWriter::BrickVolumeWriter(const string& _outputDir) :
+    outputDir(_outputDir)
+{
+    ofDirectory dir(this->outputDir);
+
+    if (!dir.exists()) {
+        dir.create(true);
+    }
+}
+
+BrickVolumeWriter::~BrickVolumeWriter()
+{
+    this->stop();
+}
+
+/**
+ * Queues a frame for writing
+ */
+void BrickVolumeWriter::enqueue(shared_ptr<BrickVolumeFrame> frame)
+{
+    this->lock();
+        this->queue.push_back(frame);
+    this->unlock();
+
+    this->frameReady.set();
+}
+
+/**
+ * Returns the number of frames waiting to be written
+ */
+int BrickVolumeWriter::getQueueLength()
+{
+    this->lock();
+        int length = static_cast<int>(this->queue.size());
+    this->unlock();
+
+    return length;
+}
+
+/**
+ * Stops the writer thread once every queued frame has been written
+ */
+void BrickVolumeWriter::stop()
+{
+    if (this->isThreadRunning()) {
+        this->stopThread();
+        this->frameReady.set();
+        this->waitForThread(false);
+    }
+}
+
+void BrickVolumeWriter::threadedFunction()
+{
+    while (true) {
+
+        shared_ptr<BrickVolumeFrame> frame;
+
+        this->lock();
+            if (!this->queue.empty()) {
+                frame = this->queue.front();
+                this->queue.pop_front();
+            }
+        this->unlock();
+
+        if (frame) {
+            this->writeFrame(*frame);
+            continue;
+        }
+
+        // Nothing left to write; only exit once the queue has been drained:
+
+        if (!this->isThreadRunning()) {
+            break;
+        }
+
+        this->frameReady.tryWait(100);
+    }
+}
+
+/**
+ * Writes a single frame to <outputDir>/volume_<frame number>.pbv
+ */
+bool BrickVolumeWriter::writeFrame(const BrickVolumeFrame& frame)
+{
+    string filename = ofToDataPath(this->outputDir + "/volume_" + ofToString(frame.header.frameNumber, 6, '0') + ".pbv");
+    ofstream out(filename.c_str(), ios::out | ios::binary | ios::trunc);
+
+    if (!out) {
+        ofLogError() << "BrickVolumeWriter: cannot open " << filename << endl;
+        return false;
+    }
+
+    const char padding[16] = { 0 };
+    size_t indexEnd        = sizeof(BrickVolumeHeader) + (frame.brickIndex.size() * sizeof(int));
+
+    out.write(reinterpret_cast<const char*>(&frame.header), sizeof(BrickVolumeHeader));
+
+    if (!frame.brickIndex.empty()) {
+        out.write(reinterpret_cast<const char*>(&frame.brickIndex[0]), frame.brickIndex.size() * sizeof(int));
+    }
+
+    out.write(padding, frame.header.dataOffset - indexEnd);
+
+    if (!frame.voxels.empty()) {
+        out.write(reinterpret_cast<const char*>(&frame.voxels[0]), frame.voxels.size() * sizeof(float4));
+    }
+
+    if (!out) {
+        ofLogError() << "BrickVolumeWriter: failed writing " << filename << endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * VolumeExporter
+ ******************************************************************************/
+
+/**
+ * Creates a new exporter for the given simulation
+ *
+ * @param [in] _simulation The simulation whose fields are exported
+ * @param [in] _outputDir Output directory, relative to the data folder
+ * @param [in] _voxelSize Edge length of a voxel in world units
+ * @param [in] _maxPendingFrames Maximum number of frames waiting to be
+ *             written before new frames are dropped
+ */
+VolumeExporter::VolumeExporter(Simulation& _simulation
+                              ,const string& _outputDir
+                              ,float _voxelSize
+                              ,int _maxPendingFrames) :
+    simulation(_simulation),
+    openCL(_simulation.getOpenCL()),
+    voxelSize(_voxelSize),
+    bricksX(0),
+    bricksY(0),
+    bricksZ(0),
+    numBricks(0),
+    brickCapacity(0),
+    voxelCapacity(0),
+    writer(_outputDir),
+    maxPendingFrames(_maxPendingFrames)
+{
+    this->loadKernels();
+    this->fitToBounds();
+
+    this->writer.startThread();
+}
+
+VolumeExporter::~VolumeExporter()
+{
+    this->writer.stop();
+}
+
+/**
+ * Loads kernels/Volume.cl and binds the arguments that do not change between
+ * frames. The brick buffers and the volume's extent are bound by
+ * fitToBounds()
+ */
+void VolumeExporter::loadKernels()
+{
+    auto program = loadKernelProgram(this->openCL, "kernels/Volume.cl");
+
+    this->resetBrickFlagsKernel = this->openCL.loadKernel("resetBrickFlags", program);
+
+    this->markActiveBricksKernel = this->openCL.loadKernel("markActiveBricks", program);
+    this->markActiveBricksKernel->setArg(7, this->voxelSize * static_cast<float>(BRICK_SIZE));
+
+    this->compactActiveBricksKernel = this->openCL.loadKernel("compactActiveBricks", program);
+
+    this->splatBricksKernel = this->openCL.loadKernel("splatBricks", program);
+    this->splatBricksKernel->setArg(12, this->voxelSize);
+}
+
+/**
+ * Fits the volume to the current simulation bounds, grown by one smoothing
+ * radius so the kernel support of particles at the walls is not clipped.
+ * The bounds may be animated, so this runs before every export; the brick
+ * buffers are only reallocated when the volume outgrows them
+ */
+void VolumeExporter::fitToBounds()
+{
+    float h          = this->simulation.getParameters().smoothingRadius;
+    AABB bounds      = this->simulation.getBounds();
+    ofVec3f minExt   = bounds.getMinExtent() - ofVec3f(h, h, h);
+    ofVec3f maxExt   = bounds.getMaxExtent() + ofVec3f(h, h, h);
+    float brickWidth = this->voxelSize * static_cast<float>(BRICK_SIZE);
+
+    this->origin    = minExt;
+    this->bricksX   = max(1, static_cast<int>(ceil((maxExt.x - minExt.x) / brickWidth)));
+    this->bricksY   = max(1, static_cast<int>(ceil((maxExt.y - minExt.y) / brickWidth)));
+    this->bricksZ   = max(1, static_cast<int>(ceil((maxExt.z - minExt.z) / brickWidth)));
+    this->numBricks = this->bricksX * this->bricksY * this->bricksZ;
+
+    if (this->numBricks > this->brickCapacity) {
+
+        this->brickCapacity = this->numBricks;
+
+        this->brickFlags.initBuffer(this->brickCapacity * sizeof(int));
+        this->brickOffsets.initBuffer(this->brickCapacity * sizeof(int));
+        this->activeBricks.initBuffer(this->brickCapacity * sizeof(int));
+
+        this->resetBrickFlagsKernel->setArg(0, this->brickFlags);
+        this->markActiveBricksKernel->setArg(12, this->brickFlags);
+        this->compactActiveBricksKernel->setArg(0, this->brickFlags);
+        this->compactActiveBricksKernel->setArg(1, this->brickOffsets);
+        this->compactActiveBricksKernel->setArg(2, this->activeBricks);
+        this->splatBricksKernel->setArg(9, this->activeBricks);
+    }
+
+    ofVec4f origin4(this->origin.x, this->origin.y, this->origin.z, 0.0f);
+
+    this->markActiveBricksKernel->setArg(6, origin4);
+    this->markActiveBricksKernel->setArg(8, this->bricksX);
+    this->markActiveBricksKernel->setArg(9, this->bricksY);
+    this->markActiveBricksKernel->setArg(10, this->bricksZ);
+
+    this->splatBricksKernel->setArg(11, origin4);
+    this->splatBricksKernel->setArg(13, this->bricksX);
+    this->splatBricksKernel->setArg(14, this->bricksY);
+}
+
+/**
+ * Flags every brick near an occupied grid cell, then compacts the flagged
+ * bricks into activeBricks
+ *
+ * @returns The number of active bricks
+ */
+int VolumeExporter::findActiveBricks()
+{
+    AABB gridBounds = this->simulation.getGridBounds();
+    ofVec3f minExt  = gridBounds.getMinExtent();
+    ofVec3f maxExt  = gridBounds.getMaxExtent();
+    ofVec3f cells   = this->simulation.getBinnedCellsPerAxis();
+    int numCells    = this->simulation.getNumberOfBinnedCells();
+
+    this->resetBrickFlagsKernel->run1D(this->numBricks);
+
+    this->markActiveBricksKernel->setArg(0, this->simulation.getCellHistogramBuffer());
+    this->markActiveBricksKernel->setArg(1, static_cast<int>(cells.x));
+    this->markActiveBricksKernel->setArg(2, static_cast<int>(cells.y));
+    this->markActiveBricksKernel->setArg(3, static_cast<int>(cells.z));
+    this->markActiveBricksKernel->setArg(4, ofVec4f(minExt.x, minExt.y, minExt.z, 0.0f));
+    this->markActiveBricksKernel->setArg(5, ofVec4f(maxExt.x, maxExt.y, maxExt.z, 0.0f));
+    this->markActiveBricksKernel->setArg(11, this->simulation.getParameters().smoothingRadius);
+    this->markActiveBricksKernel->run1D(numCells);
+
+    this->simulation.getPrefixSum().scan(this->brickOffsets, this->brickFlags, this->numBricks);
+
+    this->compactActiveBricksKernel->run1D(this->numBricks);
+
+    // The active count is the last exclusive prefix sum plus the last flag:
+
+    int lastFlag   = 0;
+    int lastOffset = 0;
+
+    this->brickFlags.read(&lastFlag, (this->numBricks - 1) * sizeof(int), sizeof(int));
+    this->brickOffsets.read(&lastOffset, (this->numBricks - 1) * sizeof(int), sizeof(int));
+
+    return lastOffset + lastFlag;
+}
+
+/**
+ * Splats the current particle state into the active bricks and hands the
+ * result to the writer thread. This should be called between simulation
+ * steps, since it relies on the cell histogram and sorted particle lists
+ * computed in the last step
+ *
+ * @returns false if the frame was dropped because the writer is behind
+ */
+bool VolumeExporter::exportFrame()
+{
+    if (this->writer.getQueueLength() >= this->maxPendingFrames) {
+        ofLogWarning() << "VolumeExporter: writer is behind, dropping frame "
+                       << this->simulation.getFrameNumber() << endl;
+        return false;
+    }
+
+    this->fitToBounds();
+
+    int numActive = this->findActiveBricks();
+
+    // Grow the voxel buffer geometrically so reallocation is rare:
+
+    if (numActive > this->voxelCapacity) {
+        this->voxelCapacity = min(this->numBricks, max(numActive, 2 * this->voxelCapacity));
+        this->voxels.initBuffer(this->voxelCapacity * VOXELS_PER_BRICK * sizeof(float4));
+        this->splatBricksKernel->setArg(15, this->voxels);
+    }
+
+    shared_ptr<BrickVolumeFrame> frame(new BrickVolumeFrame());
+    BrickVolumeHeader& header = frame->header;
+    int indexEnd              = static_cast<int>(sizeof(BrickVolumeHeader) + (numActive * sizeof(int)));
+
+    memcpy(header.magic, "PBFBRICK", 8);
+    header.version     = 1;
+    header.brickSize   = BRICK_SIZE;
+    header.bricksX     = this->bricksX;
+    header.bricksY     = this->bricksY;
+    header.bricksZ     = this->bricksZ;
+    header.numBricks   = numActive;
+    header.frameNumber = static_cast<int>(this->simulation.getFrameNumber());
+    header.dataOffset  = (indexEnd + 15) & ~15;
+    header.voxelSize   = this->voxelSize;
+    header.origin[0]   = this->origin.x;
+    header.origin[1]   = this->origin.y;
+    header.origin[2]   = this->origin.z;
+
+    if (numActive > 0) {
+
+        AABB gridBounds = this->simulation.getGridBounds();
+        ofVec3f minExt  = gridBounds.getMinExtent();
+        ofVec3f maxExt  = gridBounds.getMaxExtent();
+        ofVec3f cells   = this->simulation.getBinnedCellsPerAxis();
+
+        this->splatBricksKernel->setArg(0, this->simulation.getParameterBuffer());
+        this->splatBricksKernel->setArg(1, this->simulation.getParticleBuffer());
+        this->splatBricksKernel->setArg(2, this->simulation.getSortedParticleToCellBuffer());
+        this->splatBricksKernel->setArg(3, this->simulation.getGridCellOffsetsBuffer());
+        this->splatBricksKernel->setArg(4, static_cast<int>(cells.x));
+        this->splatBricksKernel->setArg(5, static_cast<int>(cells.y));
+        this->splatBricksKernel->setArg(6, static_cast<int>(cells.z));
+        this->splatBricksKernel->setArg(7, ofVec4f(minExt.x, minExt.y, minExt.z, 0.0f));
+        this->splatBricksKernel->setArg(8, ofVec4f(maxExt.x, maxExt.y, maxExt.z, 0.0f));
+        this->splatBricksKernel->setArg(10, numActive);
+        this->splatBricksKernel->run1D(numActive * VOXELS_PER_BRICK);
+
+        // Only the active bricks are read back:
+
+        frame->brickIndex.resize(numActive);
+        frame->voxels.resize(numActive * VOXELS_PER_BRICK);
+
+        this->activeBricks.read(&frame->brickIndex[0], 0, numActive * sizeof(int));
+        this->voxels.read(&frame->voxels[0], 0, numActive * VOXELS_PER_BRICK * sizeof(float4));
+    }
+
+    this->writer.enqueue(frame);
+
+    return true;
+}
+
+/******************************************************************************/
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * VolumeExporter.h
+ * - Splats particle density and velocity into a sparse brick volume on the
+ *   GPU and writes the result to disk on a background thread
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_SIM_VOLUME_EXPORTER_H
+#define PBF_SIM_VOLUME_EXPORTER_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ofMain.h"
+#include "Poco/Event.h"
+#include "MSAOpenCL.h"
+#include "BrickVolume.h"
+#include "Simulation.h"
+
+/******************************************************************************/
+
+// A single exported frame, as handed from the exporter to the writer thread
+
+typedef struct {
+
+    BrickVolumeHeader header;
+
+    std::vector<int> brickIndex;
+
+    std::vector<float4> voxels;
+
+} BrickVolumeFrame;
+
+/******************************************************************************/
+
+/**
+ * Drains a queue of exported frames, writing each one to its own file, so
+ * that disk I/O never stalls the simulation loop
+ */
+class BrickVolumeWriter : public ofThread
+{
+    private:
+        std::string outputDir;
+
+        std::deque<std::shared_ptr<BrickVolumeFrame> > queue;
+
+        Poco::Event frameReady;
+
+        bool writeFrame(const BrickVolumeFrame& frame);
+
+    protected:
+        void threadedFunction();
+
+    public:
+        BrickVolumeWriter(const std::string& outputDir);
+        virtual ~BrickVolumeWriter();
+
+        void enqueue(std::shared_ptr<BrickVolumeFrame> frame);
+
+        int getQueueLength();
+
+        void stop();
+};
+
+/******************************************************************************/
+
+/**
+ * Exports the density and velocity fields of a simulation as a sparse volume
+ * made up of BRICK_SIZE^3 voxel bricks. Only bricks near grid cells that
+ * contain particles (according to the simulation's cell histogram) are
+ * splatted, read back and stored. The volume is fitted to the simulation
+ * bounds at every export, so it follows animated bounds; every file's
+ * header carries its own origin and brick counts
+ */
+class VolumeExporter
+{
+    public:
+        // Voxels per brick edge; must match BRICK_SIZE in kernels/Volume.cl
+        static const int BRICK_SIZE = 8;
+
+        static const int VOXELS_PER_BRICK = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+    private:
+        Simulation& simulation;
+
+        msa::OpenCL& openCL;
+
+        // Edge length of a voxel in world units
+        float voxelSize;
+
+        // World position of the minimum corner of brick (0,0,0)
+        ofVec3f origin;
+
+        // Bricks per axis covering the simulation bounds at the last export
+        int bricksX, bricksY, bricksZ;
+
+        int numBricks;
+
+        // Number of bricks the brick buffers have room for; grown on demand
+        int brickCapacity;
+
+        // Number of bricks voxels has room for; grown on demand
+        int voxelCapacity;
+
+        // Per-brick occupancy flags, their exclusive prefix sums, and the
+        // compacted list of active brick indices
+        // - Buffers of int
+        msa::OpenCLBuffer brickFlags;
+        msa::OpenCLBuffer brickOffsets;
+        msa::OpenCLBuffer activeBricks;
+
+        // Splatted voxels of the active bricks
+        // - Buffer of float4
+        msa::OpenCLBuffer voxels;
+
+        BrickVolumeWriter writer;
+
+        // Frames are dropped rather than queued past this many pending writes
+        int maxPendingFrames;
+
+        // Kernels, resolved once when they are loaded rather than looked up
+        // by name on every run
+        msa::OpenCLKernelPtr resetBrickFlagsKernel;
+        msa::OpenCLKernelPtr markActiveBricksKernel;
+        msa::OpenCLKernelPtr compactActiveBricksKernel;
+        msa::OpenCLKernelPtr splatBricksKernel;
+
+        void loadKernels();
+
+        void fitToBounds();
+
+        int findActiveBricks();
+
+    public:
+        VolumeExporter(Simulation& simulation
+                      ,const std::string& outputDir
+                      ,float voxelSize
+                      ,int maxPendingFrames = 8);
+
+        virtual ~VolumeExporter();
+
+        float getVoxelSize() const { return this->voxelSize; }
+
+        bool exportFrame();
+};
+
+/******************************************************************************/
+
+#endif
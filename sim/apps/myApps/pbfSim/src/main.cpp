@@ -9,14 +9,55 @@
 
 #include "ofMain.h"
 #include "ofApp.h"
+#include "AllocationCounter.h"
 
 /******************************************************************************/
 
-int main()
+/**
+ * Usage: pbfSim [--replay <session log> [--headless]] [--count-allocations]
+ *
+ * With --replay, a session recorded with the 'c' key is replayed, and its
+ * per-frame timings are written next to the log. --headless skips all
+ * drawing and exits when the replay is over. --count-allocations runs the
+ * simulation and exits with status 1 if any frame allocates after warming
+ * up; it needs a build with COUNT_ALLOCATIONS defined (see Constants.h)
+ */
+int main(int argc, char** argv)
 {
     ofSetCurrentRenderer(ofGLProgrammableRenderer::TYPE);
     ofSetupOpenGL(1024, 768, OF_WINDOW);
-	ofRunApp(new ofApp());
+
+    ofApp* app = new ofApp();
+
+    string replayFile;
+    bool headless = false;
+    bool countAllocations = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--replay" && i + 1 < argc) {
+            replayFile = argv[++i];
+        } else if (string(argv[i]) == "--headless") {
+            headless = true;
+        } else if (string(argv[i]) == "--count-allocations") {
+            countAllocations = true;
+        }
+    }
+
+    if (!replayFile.empty()) {
+        app->replaySession(replayFile, headless);
+    }
+
+    if (countAllocations) {
+
+        if (!AllocationCounter::isEnabled()) {
+            ofLogError() << "--count-allocations needs a build with COUNT_ALLOCATIONS defined";
+            return 1;
+        }
+
+        app->countAllocations();
+    }
+
+	ofRunApp(app);
 }
 
 /******************************************************************************/
@@ -13,6 +13,8 @@
 #include <sstream>
 #include "ofApp.h"
 #include "Constants.h"
+#include "PointCloudImporter.h"
+#include "AllocationCounter.h"
 
 /******************************************************************************/
 
@@ -22,6 +24,30 @@ using namespace std;
  * Simulation state
  ******************************************************************************/
 
+/**
+ * Replaces the queue created by ofxMSAOpenCL with one that has profiling
+ * enabled, so the solver's stages can be timed for the flight recorder and
+ * the roofline report. Must be called
+ * before the simulation is created, since the solver keeps the queue
+ */
+void ofApp::enableQueueProfiling()
+{
+    cl_int err = CL_SUCCESS;
+
+    cl_command_queue& queue = this->openCL.getQueue();
+    cl_command_queue profilingQueue = clCreateCommandQueue(this->openCL.getContext()
+                                                          ,this->openCL.getDevice()
+                                                          ,CL_QUEUE_PROFILING_ENABLE
+                                                          ,&err);
+    if (err != CL_SUCCESS) {
+        ofLogWarning() << "Couldn't create a profiling queue; solver stages won't be timed";
+        return;
+    }
+
+    clReleaseCommandQueue(queue);
+    queue = profilingQueue;
+}
+
 void ofApp::initializeSimulation()
 {
     this->advanceStep = false;
@@ -47,6 +73,23 @@ void ofApp::initializeSimulation()
     int numParticles      = Constants::DEFAULT_NUM_PARTICLES;
     Parameters parameters = Constants::DEFAULT_PARAMS;
     
+#ifdef INITIAL_STATE_FILE
+    
+    vector<Particle> initialState;
+    PointCloudImporter importer(bounds, parameters.particleRadius);
+    
+    if (importer.load(INITIAL_STATE_FILE, initialState) && !initialState.empty()) {
+        this->simulation = new Simulation(this->openCL
+                                         ,bounds
+                                         ,initialState
+                                         ,parameters);
+        return;
+    }
+    
+    ofLogWarning() << "Falling back to a random initial state" << endl;
+    
+#endif
+    
     this->simulation = new Simulation(this->openCL
                                      ,bounds
                                      ,numParticles
@@ -54,17 +97,72 @@ void ofApp::initializeSimulation()
 #endif
 }
 
+/**
+ * Loads the scene's colliders, if any are configured, and adds them to the
+ * simulation
+ */
+void ofApp::initializeColliders()
+{
+    this->collider     = NULL;
+    this->meshCollider = NULL;
+
+#ifdef MESH_COLLIDER_FILE
+
+    ofMesh mesh;
+
+    if (MeshCollider::loadMesh(MESH_COLLIDER_FILE, mesh)) {
+        this->meshCollider = new MeshCollider(this->openCL, mesh, Constants::MESH_COLLIDER_THICKNESS);
+        this->simulation->addCollider(this->meshCollider);
+    }
+
+#endif
+
+#ifdef ANIMATED_COLLIDER_FILE
+
+    this->collider = new AnimatedCollider(this->openCL
+                                         ,Constants::COLLIDER_VOXEL_SIZE
+                                         ,Constants::COLLIDER_BAND_WIDTH);
+
+    if (!this->collider->load(ANIMATED_COLLIDER_FILE, ofVec3f(0.0f, 0.0f, 0.0f))) {
+        delete this->collider;
+        this->collider = NULL;
+        return;
+    }
+
+    this->simulation->addCollider(this->collider);
+
+#endif
+}
+
 void ofApp::reset()
 {
     this->advanceStep = false;
     this->simulation->reset();
 }
 
+/**
+ * Only sets what must be known before setup(); see replaySession() and
+ * countAllocations()
+ */
+ofApp::ofApp() :
+    countingAllocations(false),
+    headlessReplay(false)
+{
+
+}
+
 void ofApp::setup()
 {
     // Initialize from GL world:
     
     this->openCL.setupFromOpenGL();
+    this->enableQueueProfiling();
+
+    // Start building the solver's programs right away. They build on worker
+    // threads while the GUI and the simulation's buffers are set up, and the
+    // solver takes them over when it's created:
+
+    pbf::Solver::prebuild(this->openCL.getContext(), this->openCL.getDevice(), ofToDataPath(""));
     
 #ifdef ENABLE_LOGGING
     ofSetLogLevel(OF_LOG_VERBOSE);
@@ -97,10 +195,31 @@ void ofApp::setup()
     this->periodAnimSlider.addListener(this, &ofApp::setAnimPeriod);
     this->ampAnimSlider.addListener(this, &ofApp::setAnimAmp);
     this->resetBounds.addListener(this, &ofApp::doResetBounds);
+
+    // Attribute visualization; the attribute and transfer function sliders
+    // select Simulation::VisualAttribute and Simulation::TransferFunction
+    // values, respectively:
+
+    this->visGui.setup("Visualization");
+    this->visGui.setPosition(this->gui.getPosition().x
+                            ,this->gui.getPosition().y + this->gui.getHeight() + 10.0f);
+    this->visGui.add(this->attributeSlider.setup("Attribute", Simulation::ATTRIBUTE_NONE, Simulation::ATTRIBUTE_NONE, Simulation::ATTRIBUTE_VORTICITY));
+    this->visGui.add(this->transferSlider.setup("Transfer", Simulation::TRANSFER_JET, Simulation::TRANSFER_GRAYSCALE, Simulation::TRANSFER_COOL_WARM));
+    this->visGui.add(this->toggleAutoRange.setup("Auto range", true));
+    this->visGui.add(this->rangeMinSlider.setup("Range min", 0.0f, -100.0f, 100.0f));
+    this->visGui.add(this->rangeMaxSlider.setup("Range max", 1.0f, -100.0f, 100.0f));
+
+    this->attributeSlider.addListener(this, &ofApp::setVisualAttribute);
+    this->transferSlider.addListener(this, &ofApp::setTransferFunction);
+    this->toggleAutoRange.addListener(this, &ofApp::setAutoRange);
+    this->rangeMinSlider.addListener(this, &ofApp::setAttributeRange);
+    this->rangeMaxSlider.addListener(this, &ofApp::setAttributeRange);
     
     // and the flag initial values:
     
-    this->paused = true;
+    this->paused       = true;
+    this->exportVolume = false;
+    this->publishFrames = false;
     
     // set the camera's distance from the object:
 
@@ -108,7 +227,121 @@ void ofApp::setup()
     
     // Set up the simulation:
     
+    this->volumeExporter = NULL;
+    this->framePublisher = NULL;
+    this->frameRecorder  = NULL;
+    this->playbackViewer = NULL;
+    this->jobServer      = NULL;
+    this->rooflineProfiler = NULL;
+    this->frameGovernor    = NULL;
+    this->drawMs           = 0.0;
+    this->steppedFrames    = 0;
+    this->laneUtilizationMeasured = false;
+    this->stirField = -1;
     this->initializeSimulation();
+    this->initializeColliders();
+
+    // The flight recorder is always on, so the solver stages of every step
+    // are timed:
+
+    this->flightRecorder = new pbf::FlightRecorder(Constants::FLIGHT_RECORDER_FRAMES);
+    this->simulation->getSolver().setProfiling(true);
+
+    // The heads up display is rendered on the first frame:
+
+    this->hotkeys.clear();
+    this->hotkeys.push_back("'s' = step");
+    this->hotkeys.push_back("'p' or space = toggle pause");
+    this->hotkeys.push_back("'r' = reset");
+    this->hotkeys.push_back("'g' = toggle grid");
+    this->hotkeys.push_back("'d' = toggle visual debugging");
+    this->hotkeys.push_back("'v' = toggle volume export");
+    this->hotkeys.push_back("'m' = toggle shared memory frame publishing");
+    this->hotkeys.push_back("'o' = start/stop recording frames for playback");
+    this->hotkeys.push_back("'l' = enter/leave playback of recorded frames");
+    this->hotkeys.push_back("left/right, '[' ']' = scrub playback");
+    this->hotkeys.push_back("'j' = start/stop the simulation job server");
+    this->hotkeys.push_back("'k' = toggle roofline profiling");
+    this->hotkeys.push_back("'c' = start/stop recording the session");
+    this->hotkeys.push_back("'h' = reset frame time percentiles");
+    this->hotkeys.push_back("'n' = toggle the half-cell neighbor stencil");
+    this->hotkeys.push_back("'x' = toggle the pairwise density estimate");
+    this->hotkeys.push_back("'b' = toggle pairwise density load balancing");
+    this->hotkeys.push_back("'i' = cycle pairwise density neighbor reads (auto/buffer/image)");
+    this->hotkeys.push_back("'f' = toggle stirring (vortex force field)");
+    this->hotkeys.push_back("'e' = toggle co-execution on two devices (GPU + CPU)");
+    this->hotkeys.push_back("'t' = toggle the frame time governor");
+
+    this->hudDirty       = true;
+    this->hudRefreshed   = false;
+    this->hudUpdated     = 0.0f;
+    this->hudAllocations = 0;
+
+    if (this->countingAllocations) {
+        this->paused              = false;
+        this->allocationFrame     = 0;
+        this->lastAllocationCount = AllocationCounter::getCount();
+    }
+
+    // Nothing is recorded or replayed until asked for:
+
+    this->recordingSession = false;
+    this->replayingSession = false;
+    this->sessionFrame     = 0;
+
+    if (!this->replayFile.empty()) {
+        this->startSessionReplay();
+    }
+
+    this->firstFrameDrawn = false;
+    this->setupDoneMs     = ofGetElapsedTimeMillis();
+    this->firstFrameMs    = 0;
+}
+
+/**
+ * Called on shutdown; waits for any pending volume writes to finish,
+ * removes the shared memory frame ring, closes the playback file and stops
+ * the job server
+ */
+void ofApp::exit()
+{
+    delete this->volumeExporter;
+    this->volumeExporter = NULL;
+
+    delete this->framePublisher;
+    this->framePublisher = NULL;
+
+    delete this->frameRecorder;
+    this->frameRecorder = NULL;
+
+    delete this->playbackViewer;
+    this->playbackViewer = NULL;
+
+    delete this->jobServer;
+    this->jobServer = NULL;
+
+    delete this->rooflineProfiler;
+    this->rooflineProfiler = NULL;
+
+    delete this->frameGovernor;
+    this->frameGovernor = NULL;
+
+    delete this->flightRecorder;
+    this->flightRecorder = NULL;
+
+    this->stopSessionRecording();
+
+    if (this->collider != NULL) {
+        this->simulation->removeCollider(this->collider);
+        delete this->collider;
+        this->collider = NULL;
+    }
+
+    if (this->meshCollider != NULL) {
+        this->simulation->removeCollider(this->meshCollider);
+        delete this->meshCollider;
+        this->meshCollider = NULL;
+    }
 }
 
 /**
@@ -116,13 +349,92 @@ void ofApp::setup()
  */
 void ofApp::update()
 {
-    if (this->isPaused()) {
+    bool stepped = false;
+
+    if (this->countingAllocations) {
+        this->checkFrameAllocations();
+    }
+
+    // Apply the inputs of a replayed session that are due before this step:
+
+    if (this->replayingSession) {
+        this->replaySessionEvents();
+    }
+
+    // The frame governor may split a frame into substeps, and collect stage
+    // timings only every few frames. The roofline report needs them all:
+
+    int substeps      = 1;
+    int statsInterval = 1;
+
+    if (this->frameGovernor != NULL) {
+        substeps      = this->frameGovernor->getSettings().substeps;
+        statsInterval = this->rooflineProfiler != NULL ? 1 : this->frameGovernor->getSettings().statsInterval;
+    }
+
+    bool profile = this->steppedFrames % statsInterval == 0;
+
+    if (this->simulation->getSolver().isProfiling() != profile) {
+        this->simulation->getSolver().setProfiling(profile);
+    }
+
+    unsigned long long stepStart = ofGetElapsedTimeMicros();
+
+    if (this->playbackViewer != NULL) {
+        // Recorded frames are shown instead; the solver doesn't run:
+        this->playbackViewer->update(*this->simulation);
+        this->advanceStep = false;
+    } else if (this->isPaused()) {
         if (this->advanceStep) {
-            this->simulation->step();
+            for (int i = 0; i < substeps; i++) {
+                this->simulation->step();
+            }
             this->advanceStep = false;
+            stepped = true;
         }
     } else {
-        this->simulation->step();
+        for (int i = 0; i < substeps; i++) {
+            this->simulation->step();
+        }
+        stepped = true;
+    }
+
+    double stepMs = static_cast<double>(ofGetElapsedTimeMicros() - stepStart) * 1.0e-3;
+
+    if (stepped) {
+        this->steppedFrames++;
+    }
+
+    // Device time of the step's solver stages:
+
+    this->stageTimings.clear();
+
+    if (stepped && this->simulation->getSolver().isProfiling()) {
+        this->simulation->getSolver().collectStageTimings(this->stageTimings);
+    }
+
+    // Export the density/velocity volume of the step we just took?
+
+    if (stepped && this->exportVolume) {
+        this->volumeExporter->exportFrame();
+    }
+
+    // Hand the step to external renderers?
+
+    if (stepped && this->publishFrames) {
+        this->framePublisher->publishFrame();
+    }
+
+    // Record the step for playback?
+
+    if (stepped && this->frameRecorder != NULL) {
+        this->frameRecorder->publishFrame();
+    }
+
+    // Profile the step for the roofline report?
+
+    if (stepped && this->rooflineProfiler != NULL) {
+        this->rooflineProfiler->stepped(this->stageTimings);
     }
 
     // Animate bounds?
@@ -138,159 +450,1004 @@ void ofApp::update()
     } else {
         this->simulation->disableBothSidesAnimation();
     }
+
+    // Frame time percentiles and the flight recorder:
+
+    this->recordFrameTiming(stepped, stepMs);
+
+    // Let the frame governor adjust the quality knobs. It holds still while
+    // a session is recorded or replayed, since the knobs change the results:
+
+    if (this->frameGovernor != NULL && !this->recordingSession && !this->replayingSession) {
+        if (this->frameGovernor->update(stepped, ofGetLastFrameTime() * 1000.0, stepMs, this->drawMs)) {
+            this->hudDirty = true;
+        }
+    }
+
+    // Session bookkeeping. Inputs polled above take effect from the next
+    // update on, so they are recorded against it:
+
+    if (this->replayingSession) {
+        this->recordReplayTiming(stepped, stepMs);
+    }
+
+    if (this->recordingSession || this->replayingSession) {
+        this->sessionFrame++;
+    }
+
+    if (this->recordingSession) {
+        this->recordPolledInputs(false);
+    }
 }
 
 /*******************************************************************************
- * Control callback functions
+ * Frame timing
  ******************************************************************************/
 
-void ofApp::setSineAnim()
+/**
+ * Adds the frame to the percentiles and the flight recorder, and dumps the
+ * recorder if the frame was a spike. The frame time is that of the last
+ * completed frame, i.e. the one before this update
+ *
+ * @param [in] stepped Whether the simulation stepped in this update
+ * @param [in] stepMs Host time of the step
+ */
+void ofApp::recordFrameTiming(bool stepped, double stepMs)
 {
-    this->simulation->setAnimationType(Simulation::SINE_WAVE);
-}
+    double frameMs = ofGetLastFrameTime() * 1000.0;
 
-void ofApp::setRampAnim()
-{
-    this->simulation->setAnimationType(Simulation::LINEAR_RAMP);
-}
+    this->frameTimes.add(frameMs);
 
-void ofApp::setCompressAnim()
-{
-    this->simulation->setAnimationType(Simulation::COMPRESS);
+    if (stepped) {
+        this->stepTimes.add(stepMs);
+    }
+
+    this->flightRecorder->record(this->simulation->getFrameNumber()
+                                ,ofGetElapsedTimef()
+                                ,static_cast<float>(frameMs)
+                                ,static_cast<float>(stepped ? stepMs : 0.0)
+                                ,this->stageTimings
+                                ,!stepped || this->simulation->getSolver().isProfiling());
+
+    // A spike is judged against the median, so a slow but steady frame rate
+    // doesn't dump every few seconds. Waiting for a full ring also skips the
+    // first, slow frames after startup:
+
+    double threshold = max(static_cast<double>(Constants::SPIKE_FRAME_MS)
+                          ,Constants::SPIKE_MEDIAN_FACTOR * this->frameTimes.percentile(50.0));
+
+    if (frameMs > threshold &&
+        this->flightRecorder->getFramesSinceDump() >= static_cast<unsigned long long>(this->flightRecorder->getCapacity())) {
+        this->dumpFlightRecorder(frameMs);
+    }
 }
 
-void ofApp::doResetBounds()
+/**
+ * Writes the flight recorder's frames to a new file in the flight recorder
+ * folder
+ *
+ * @param [in] frameMs Duration of the spike that triggered the dump
+ */
+void ofApp::dumpFlightRecorder(double frameMs)
 {
-    this->toggleAnimateBounds    = false;
-    this->toggleAnimateBothSides = false;
+    ofDirectory::createDirectory(Constants::FLIGHT_RECORDER_DIR, true, true);
 
-    this->simulation->disableBoundsAnimation();
-    this->simulation->resetBounds();
+    string filename = string(Constants::FLIGHT_RECORDER_DIR) + "/spike-" +
+                      ofGetTimestampString("%Y%m%d-%H%M%S") + "-frame" +
+                      ofToString(this->simulation->getFrameNumber()) + ".csv";
+
+    if (this->flightRecorder->dump(ofToDataPath(filename))) {
+        ofLogNotice() << "Frame took " << frameMs << " ms; writing flight recording to " << filename;
+        this->lastSpikeFile = filename;
+    } else {
+        ofLogWarning() << "Frame took " << frameMs << " ms; flight recording dropped, earlier ones are still being written";
+    }
 }
 
-void ofApp::setAnimPeriod(float& period)
+/**
+ * Starts the frame and step time percentiles over, e.g. after a change of
+ * scene
+ */
+void ofApp::resetFrameTimings()
 {
-    this->simulation->setAnimationPeriod(period);
+    this->frameTimes.reset();
+    this->stepTimes.reset();
 }
 
-void ofApp::setAnimAmp(float& amp)
+/**
+ * Enables allocation counting mode for the next run of the app
+ */
+void ofApp::countAllocations()
 {
-    this->simulation->setAnimationAmp(amp);
+    this->countingAllocations = true;
+    this->allocatingFrames    = 0;
+    this->firstAllocatingFrame = 0;
+    this->maxFrameAllocations = 0;
+    this->hudRefreshFrames    = 0;
 }
 
-/*******************************************************************************
- * Drawing
- ******************************************************************************/
-
 /**
- * Draws a "heads up display" that shows the status of the simulation, as well
- * as some other pieces of pertinent information
+ * Called at the start of every update in allocation counting mode, with the
+ * allocations since the last call making up one frame (the previous draw
+ * and this update). After ALLOCATION_WARMUP_FRAMES frames, every frame must
+ * be allocation-free, apart from re-rendering the heads up display text,
+ * which goes through openFrameworks' string drawing: the allocations made
+ * around that alone are subtracted, and the rest of the frame is still
+ * checked. The result is logged after ALLOCATION_COUNT_FRAMES more frames,
+ * and the app exits
  */
-void ofApp::drawHeadsUpDisplay(ofEasyCam& camera)
+void ofApp::checkFrameAllocations()
 {
-    // Show the controls:
-    
-    ofVec3f cameraPos = camera.getPosition();
-    
-    // Show the current frame rate and frame count
+    unsigned long long allocations = AllocationCounter::getCount() - this->lastAllocationCount - this->hudAllocations;
 
-    int w           = static_cast<int>(ofGetScreenWidth());
-    int hOffset     = static_cast<int>(static_cast<float>(w) - (0.425f * static_cast<float>(w)));
-    int vSpacing    = 15;
-    int textYOffset = vSpacing;
-    
-    // Paused flag
+    this->allocationFrame++;
 
-    if (this->isPaused()) {
-        ofSetColor(0, 255, 0);
-        ofFill();
-        ofDrawBitmapString("Paused", hOffset, textYOffset += vSpacing);
+    if (this->allocationFrame > static_cast<unsigned int>(Constants::ALLOCATION_WARMUP_FRAMES)) {
+
+        if (this->hudRefreshed) {
+            this->hudRefreshFrames++;
+        }
+
+        if (allocations > 0) {
+            if (this->allocatingFrames++ == 0) {
+                this->firstAllocatingFrame = this->allocationFrame;
+            }
+            this->maxFrameAllocations = max(this->maxFrameAllocations, allocations);
+        }
     }
-    
-    ofSetColor(255);
-    ofFill();
-    
-    // FPS
 
-    string fpsText = ofToString(ofGetFrameRate()) + " fps";
-    ofDrawBitmapString(fpsText, hOffset, textYOffset += vSpacing);
+    this->hudRefreshed   = false;
+    this->hudAllocations = 0;
 
-    // Current frame
+    if (this->allocationFrame >= static_cast<unsigned int>(Constants::ALLOCATION_WARMUP_FRAMES + Constants::ALLOCATION_COUNT_FRAMES)) {
 
-    ofDrawBitmapString("Frame: " + ofToString(this->simulation->getFrameNumber()), hOffset, textYOffset += vSpacing);
+        this->countingAllocations = false;
 
-    // Hotkeys
+        if (this->allocatingFrames > 0) {
+            ofLogError() << this->allocatingFrames << " of " << Constants::ALLOCATION_COUNT_FRAMES
+                         << " frames allocated after warm-up (first: frame " << this->firstAllocatingFrame
+                         << ", at most " << this->maxFrameAllocations << " allocations per frame)";
+        } else {
+            ofLogNotice() << "No allocations in " << Constants::ALLOCATION_COUNT_FRAMES
+                          << " frames after warm-up (allocations of " << this->hudRefreshFrames
+                          << " heads up display refreshes not counted)";
+        }
 
-    ofDrawBitmapString("Hotkeys:", hOffset, textYOffset += vSpacing);
-    vector<string> hotkeys;
-    hotkeys.push_back("'s' = step");
-    hotkeys.push_back("'p' or space = toggle pause");
-    hotkeys.push_back("'r' = reset");
-    hotkeys.push_back("'g' = toggle grid");
-    hotkeys.push_back("'d' = toggle visual debugging");
-    
-    for (auto i = hotkeys.begin(); i != hotkeys.end(); i++) {
-        ofDrawBitmapString(*i, hOffset, textYOffset += vSpacing);
+        ofExit(this->allocatingFrames > 0 ? 1 : 0);
+        return;
     }
 
-    // Status information
+    this->lastAllocationCount = AllocationCounter::getCount();
+}
 
-    auto bounds = this->simulation->getBounds();
-    auto minExt = bounds.getMinExtent();
-    auto maxExt = bounds.getMaxExtent();
-    
-    // Camera Position
+/*******************************************************************************
+ * Session recording and replay
+ ******************************************************************************/
 
-    ofDrawBitmapString("Camera position: <" + ofToString(cameraPos.x) +
-                                        "," + ofToString(cameraPos.y) +
-                                        "," + ofToString(cameraPos.z) + ">"
-                      ,hOffset
-                      ,textYOffset += vSpacing);
+/**
+ * Starts recording the session's inputs to a new log in the data folder.
+ * The simulation is reset from a fixed random seed, so a replay starts from
+ * the same state
+ */
+void ofApp::startSessionRecording()
+{
+    ofDirectory::createDirectory(Constants::SESSION_LOG_DIR, true, true);
 
-    // Bounds
+    string filename = ofToDataPath(string(Constants::SESSION_LOG_DIR) + "/session-" +
+                                   ofGetTimestampString("%Y%m%d-%H%M%S") + ".log");
 
-    ofDrawBitmapString("Bounds: <" +
-                       ofToString(minExt.x) + "," + ofToString(minExt.y) + "," + ofToString(minExt.z) + "> <" +
-                       ofToString(maxExt.x) + "," + ofToString(maxExt.y) + "," + ofToString(maxExt.z) + ">"
-                      ,hOffset, textYOffset += vSpacing);
+    if (!this->sessionLog.startRecording(filename)) {
+        return;
+    }
 
-    // Cell count
+    // Substeps aren't recorded, so the governor hands its knobs back before
+    // the state is:
 
-    auto cellsPerAxis = this->simulation->getCellsPerAxis();
-    ofDrawBitmapString("Cells per axis: <" +
-                       ofToString(cellsPerAxis[0]) + "," + ofToString(cellsPerAxis[1]) + "," + ofToString(cellsPerAxis[2]) + ">"
-                       ,hOffset, textYOffset += vSpacing);
-    
-    // Particle count
+    delete this->frameGovernor;
+    this->frameGovernor = NULL;
 
-    ofDrawBitmapString("Particles: " + ofToString(this->simulation->getNumberOfParticles())
-                      ,hOffset, textYOffset += vSpacing);
+    ofSeedRandom(Constants::SESSION_SEED);
+    this->reset();
 
-    ofDisableDepthTest();
-    this->gui.draw();
-    ofEnableDepthTest();
+    this->recordingSession = true;
+    this->sessionFrame     = 0;
+    this->sessionStart     = ofGetElapsedTimef();
+
+    this->recordSessionState();
+
+    ofLogNotice() << "Recording session to " << filename;
 }
 
-/**
- * Renders the simulation
- */
-void ofApp::draw()
+void ofApp::stopSessionRecording()
 {
-    ofBackground(0);
-    
-    // Render the current step of the simulation:
-    
-    this->camera.begin();
-        this->simulation->draw(this->camera);
-    this->camera.end();
+    if (!this->recordingSession) {
+        return;
+    }
 
-    this->drawHeadsUpDisplay(this->camera);
+    this->recordSessionEvent("end");
+    this->sessionLog.stopRecording();
+    this->recordingSession = false;
 }
 
-/*******************************************************************************
- * Input handling
- ******************************************************************************/
-
+void ofApp::toggleSessionRecording()
+{
+    if (this->recordingSession) {
+        this->stopSessionRecording();
+    } else {
+        this->startSessionRecording();
+    }
+}
+
+void ofApp::recordSessionEvent(const string& name, const vector<float>& values)
+{
+    if (this->recordingSession) {
+        this->sessionLog.record(this->sessionFrame, ofGetElapsedTimef() - this->sessionStart, name, values);
+    }
+}
+
+void ofApp::recordSessionEvent(const string& name, float value)
+{
+    this->recordSessionEvent(name, vector<float>(1, value));
+}
+
+/**
+ * Records everything a replay needs to start from the same state: the seed
+ * and scene, and the current value of every input
+ */
+void ofApp::recordSessionState()
+{
+    AABB bounds               = this->simulation->getBounds();
+    const ofVec3f& cells      = this->simulation->getCellsPerAxis();
+    const Parameters& params  = this->simulation->getParameters();
+    pbf::Solver& solver       = this->simulation->getSolver();
+
+    float scene[] = { bounds.getMinExtent().x, bounds.getMinExtent().y, bounds.getMinExtent().z
+                    , bounds.getMaxExtent().x, bounds.getMaxExtent().y, bounds.getMaxExtent().z
+                    , static_cast<float>(this->simulation->getNumberOfParticles())
+                    , solver.getTimeStep()
+                    , cells.x, cells.y, cells.z
+                    , params.particleRadius, params.smoothingRadius, params.relaxation
+                    , params.artificialPressureK, params.artificialPressureN
+                    , params.vorticityEpsilon, params.viscosityCoeff
+                    , static_cast<float>(solver.getSolverIterations()) };
+
+    float range[] = { this->rangeMinSlider, this->rangeMaxSlider };
+
+    this->recordSessionEvent("seed", static_cast<float>(Constants::SESSION_SEED));
+    this->recordSessionEvent("scene", vector<float>(scene, scene + sizeof(scene) / sizeof(float)));
+    this->recordSessionEvent("paused", this->paused ? 1.0f : 0.0f);
+    this->recordSessionEvent("animation", static_cast<float>(this->simulation->getAnimationType()));
+    this->recordSessionEvent("period", this->periodAnimSlider);
+    this->recordSessionEvent("amplitude", this->ampAnimSlider);
+    this->recordSessionEvent("attribute", static_cast<float>(this->attributeSlider));
+    this->recordSessionEvent("transfer", static_cast<float>(this->transferSlider));
+    this->recordSessionEvent("autoRange", this->toggleAutoRange ? 1.0f : 0.0f);
+    this->recordSessionEvent("range", vector<float>(range, range + 2));
+
+    this->recordPolledInputs(true);
+}
+
+/**
+ * Records the inputs that are polled rather than delivered as events: the
+ * animation toggles and the camera. Only changes are recorded, unless force
+ * is given
+ */
+void ofApp::recordPolledInputs(bool force)
+{
+    bool animate   = this->toggleAnimateBounds;
+    bool bothSides = this->toggleAnimateBothSides;
+
+    if (force || animate != this->lastAnimateBounds) {
+        this->recordSessionEvent("animate", animate ? 1.0f : 0.0f);
+        this->lastAnimateBounds = animate;
+    }
+
+    if (force || bothSides != this->lastAnimateBothSides) {
+        this->recordSessionEvent("bothSides", bothSides ? 1.0f : 0.0f);
+        this->lastAnimateBothSides = bothSides;
+    }
+
+    ofVec3f position         = this->camera.getGlobalPosition();
+    ofQuaternion orientation = this->camera.getGlobalOrientation();
+
+    if (force || position != this->lastCameraPosition || orientation.asVec4() != this->lastCameraOrientation.asVec4()) {
+
+        float pose[] = { position.x, position.y, position.z
+                       , orientation.x(), orientation.y(), orientation.z(), orientation.w() };
+
+        this->recordSessionEvent("camera", vector<float>(pose, pose + 7));
+
+        this->lastCameraPosition    = position;
+        this->lastCameraOrientation = orientation;
+    }
+}
+
+/**
+ * Sets up a replay of a recorded session, started at the end of setup()
+ *
+ * @param [in] filename Session log, as written by startSessionRecording()
+ * @param [in] headless If true, nothing is drawn and the app exits once the
+ *             replay is over
+ */
+void ofApp::replaySession(const string& filename, bool headless)
+{
+    this->replayFile     = filename;
+    this->headlessReplay = headless;
+}
+
+/**
+ * Loads the session log and starts replaying it. Per-frame timings are
+ * written next to the log, as <log>.timings.csv
+ */
+void ofApp::startSessionReplay()
+{
+    if (!this->sessionLog.load(this->replayFile)) {
+        return;
+    }
+
+    string timings = this->replayFile + ".timings.csv";
+
+    this->replayTimings.open(timings.c_str());
+    this->replayTimings << "frame,simulation_frame,frame_ms,step_ms" << endl;
+
+    this->replayFrameMs[0] = this->replayFrameMs[1] = 0.0;
+    this->replayStepMs[0]  = this->replayStepMs[1]  = 0.0;
+    this->replaySteps      = 0;
+
+    this->replayingSession = true;
+    this->sessionFrame     = 0;
+
+    // The camera follows the log, not the mouse:
+
+    this->camera.disableMouseInput();
+
+    ofLogNotice() << "Replaying " << this->replayFile << " (" << this->sessionLog.getEvents().size()
+                  << " events, " << this->sessionLog.getLastFrame() << " frames)";
+}
+
+/**
+ * Applies every event due at the current frame
+ */
+void ofApp::replaySessionEvents()
+{
+    pbf::SessionEvent event;
+
+    while (this->replayingSession && this->sessionLog.nextEvent(this->sessionFrame, event)) {
+        this->applySessionEvent(event);
+    }
+
+    // A log cut short (e.g. by a crash) has no end event:
+
+    if (this->replayingSession && this->sessionLog.isFinished() && this->sessionFrame > this->sessionLog.getLastFrame()) {
+        this->finishSessionReplay();
+    }
+}
+
+/**
+ * Applies a recorded input the way it was originally delivered: through the
+ * GUI controls, the key handler or the camera
+ */
+void ofApp::applySessionEvent(const pbf::SessionEvent& event)
+{
+    const string& name = event.name;
+    float value        = event.values.empty() ? 0.0f : event.values[0];
+
+    if (name == "seed") {
+        ofSeedRandom(static_cast<int>(value));
+        this->reset();
+    } else if (name == "scene") {
+        if (event.values.size() > 6 && static_cast<unsigned int>(event.values[6]) != this->simulation->getNumberOfParticles()) {
+            ofLogWarning() << "The session was recorded with " << event.values[6] << " particles; replaying with "
+                           << this->simulation->getNumberOfParticles();
+        }
+    } else if (name == "paused") {
+        this->paused = value != 0.0f;
+    } else if (name == "key") {
+        this->handleKey(static_cast<int>(value));
+    } else if (name == "animate") {
+        // Applied directly as well, since update() polls the toggle only
+        // after stepping:
+        this->toggleAnimateBounds = value != 0.0f;
+        if (this->toggleAnimateBounds) {
+            this->simulation->enableBoundsAnimation();
+        } else {
+            this->simulation->disableBoundsAnimation();
+        }
+    } else if (name == "bothSides") {
+        this->toggleAnimateBothSides = value != 0.0f;
+        if (this->toggleAnimateBothSides) {
+            this->simulation->enableBothSidesAnimation();
+        } else {
+            this->simulation->disableBothSidesAnimation();
+        }
+    } else if (name == "animation") {
+        this->simulation->setAnimationType(static_cast<Simulation::AnimationType>(static_cast<int>(value)));
+    } else if (name == "period") {
+        this->periodAnimSlider = value;
+    } else if (name == "amplitude") {
+        this->ampAnimSlider = value;
+    } else if (name == "resetBounds") {
+        this->doResetBounds();
+    } else if (name == "attribute") {
+        this->attributeSlider = static_cast<int>(value);
+    } else if (name == "transfer") {
+        this->transferSlider = static_cast<int>(value);
+    } else if (name == "autoRange") {
+        this->toggleAutoRange = value != 0.0f;
+    } else if (name == "range" && event.values.size() == 2) {
+        this->rangeMinSlider = event.values[0];
+        this->rangeMaxSlider = event.values[1];
+    } else if (name == "camera" && event.values.size() == 7) {
+        const vector<float>& v = event.values;
+        this->camera.setGlobalPosition(ofVec3f(v[0], v[1], v[2]));
+        this->camera.setGlobalOrientation(ofQuaternion(v[3], v[4], v[5], v[6]));
+    } else if (name == "end") {
+        this->finishSessionReplay();
+    } else {
+        ofLogWarning() << "Unknown session event " << name << " at frame " << event.frame;
+    }
+}
+
+void ofApp::recordReplayTiming(bool stepped, double stepMs)
+{
+    double frameMs = ofGetLastFrameTime() * 1000.0;
+
+    this->replayTimings << this->sessionFrame << ","
+                        << this->simulation->getFrameNumber() << ","
+                        << frameMs << ","
+                        << (stepped ? stepMs : 0.0) << "\n";
+
+    this->replayFrameMs[0] += frameMs;
+    this->replayFrameMs[1]  = max(this->replayFrameMs[1], frameMs);
+
+    if (stepped) {
+        this->replayStepMs[0] += stepMs;
+        this->replayStepMs[1]  = max(this->replayStepMs[1], stepMs);
+        this->replaySteps++;
+    }
+}
+
+/**
+ * Ends a replay, reporting its frame and step times. A headless replay
+ * exits the app
+ */
+void ofApp::finishSessionReplay()
+{
+    this->replayingSession = false;
+    this->replayTimings.close();
+    this->camera.enableMouseInput();
+
+    double frames = static_cast<double>(max(this->sessionFrame, 1u));
+    double steps  = static_cast<double>(max(this->replaySteps, 1u));
+
+    ofLogNotice() << "Replay of " << this->replayFile << " done: "
+                  << this->sessionFrame << " frames, mean " << (this->replayFrameMs[0] / frames)
+                  << " ms, max " << this->replayFrameMs[1] << " ms; "
+                  << this->replaySteps << " steps, mean " << (this->replayStepMs[0] / steps)
+                  << " ms, max " << this->replayStepMs[1] << " ms";
+
+    if (this->headlessReplay) {
+        ofExit();
+    }
+}
+
+/*******************************************************************************
+ * Control callback functions
+ ******************************************************************************/
+
+void ofApp::setSineAnim()
+{
+    this->recordSessionEvent("animation", Simulation::SINE_WAVE);
+    this->simulation->setAnimationType(Simulation::SINE_WAVE);
+}
+
+void ofApp::setRampAnim()
+{
+    this->recordSessionEvent("animation", Simulation::LINEAR_RAMP);
+    this->simulation->setAnimationType(Simulation::LINEAR_RAMP);
+}
+
+void ofApp::setCompressAnim()
+{
+    this->recordSessionEvent("animation", Simulation::COMPRESS);
+    this->simulation->setAnimationType(Simulation::COMPRESS);
+}
+
+void ofApp::doResetBounds()
+{
+    this->recordSessionEvent("resetBounds");
+
+    this->toggleAnimateBounds    = false;
+    this->toggleAnimateBothSides = false;
+
+    this->simulation->disableBoundsAnimation();
+    this->simulation->resetBounds();
+}
+
+void ofApp::setAnimPeriod(float& period)
+{
+    this->recordSessionEvent("period", period);
+    this->simulation->setAnimationPeriod(period);
+}
+
+void ofApp::setAnimAmp(float& amp)
+{
+    this->recordSessionEvent("amplitude", amp);
+    this->simulation->setAnimationAmp(amp);
+}
+
+void ofApp::setVisualAttribute(int& attribute)
+{
+    this->recordSessionEvent("attribute", static_cast<float>(attribute));
+    this->simulation->setVisualAttribute(static_cast<Simulation::VisualAttribute>(attribute));
+    this->hudDirty = true;
+}
+
+void ofApp::setTransferFunction(int& transfer)
+{
+    this->recordSessionEvent("transfer", static_cast<float>(transfer));
+    this->simulation->setTransferFunction(static_cast<Simulation::TransferFunction>(transfer));
+    this->hudDirty = true;
+}
+
+void ofApp::setAutoRange(bool& autoRange)
+{
+    this->recordSessionEvent("autoRange", autoRange ? 1.0f : 0.0f);
+
+    if (autoRange) {
+        this->simulation->enableAutoRange();
+    } else {
+        this->simulation->disableAutoRange();
+    }
+}
+
+void ofApp::setAttributeRange(float& value)
+{
+    float range[] = { this->rangeMinSlider, this->rangeMaxSlider };
+    this->recordSessionEvent("range", vector<float>(range, range + 2));
+
+    this->simulation->setAttributeRange(this->rangeMinSlider, this->rangeMaxSlider);
+}
+
+/*******************************************************************************
+ * Drawing
+ ******************************************************************************/
+
+/**
+ * Draws a "heads up display" that shows the status of the simulation, as well
+ * as some other pieces of pertinent information
+ */
+void ofApp::renderHeadsUpDisplay(ofEasyCam& camera)
+{
+    // Show the controls:
+    
+    ofVec3f cameraPos = camera.getPosition();
+    
+    // Show the current frame rate and frame count
+
+    int w           = static_cast<int>(ofGetScreenWidth());
+    int hOffset     = static_cast<int>(static_cast<float>(w) - (0.425f * static_cast<float>(w)));
+    int vSpacing    = 15;
+    int textYOffset = vSpacing;
+    
+    // Paused flag
+
+    if (this->isPaused()) {
+        ofSetColor(0, 255, 0);
+        ofFill();
+        ofDrawBitmapString("Paused", hOffset, textYOffset += vSpacing);
+    }
+    
+    ofSetColor(255);
+    ofFill();
+    
+    // FPS
+
+    string fpsText = ofToString(ofGetFrameRate()) + " fps";
+    ofDrawBitmapString(fpsText, hOffset, textYOffset += vSpacing);
+
+    // Time to first frame
+
+    if (this->firstFrameDrawn) {
+        ofDrawBitmapString("First frame: " + ofToString(this->firstFrameMs) + " ms (setup " +
+                           ofToString(this->setupDoneMs) + " ms)"
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    // Frame governor: its target, what it measures, and the knobs it chose
+
+    if (this->frameGovernor != NULL) {
+
+        const FrameGovernor& governor  = *this->frameGovernor;
+        const QualitySettings& quality = governor.getSettings();
+
+        ofDrawBitmapString(ofVAArgsToString("Governor: target %.1f ms, frame %.1f ms (step %.1f, draw %.1f), %u lowered, %u raised"
+                                           ,governor.getBudget().targetMs
+                                           ,governor.getFrameMs()
+                                           ,governor.getStepMs()
+                                           ,governor.getDrawMs()
+                                           ,governor.getDowngrades()
+                                           ,governor.getUpgrades())
+                          ,hOffset, textYOffset += vSpacing);
+
+        ofDrawBitmapString(ofVAArgsToString("Quality: %d iterations, %d substep(s), 1/%d particles drawn, stats every %d frame(s)"
+                                           ,quality.solverIterations
+                                           ,quality.substeps
+                                           ,quality.renderStride
+                                           ,quality.statsInterval) +
+                           (governor.getLastDecision().empty() ? string() : "; " + governor.getLastDecision()) +
+                           (this->recordingSession || this->replayingSession ? " (held during the session)" : "")
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    // Frame and step time percentiles
+
+    ofDrawBitmapString(ofVAArgsToString("Frame ms: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f"
+                                       ,this->frameTimes.percentile(50.0)
+                                       ,this->frameTimes.percentile(95.0)
+                                       ,this->frameTimes.percentile(99.0)
+                                       ,this->frameTimes.getMax())
+                      ,hOffset, textYOffset += vSpacing);
+
+    ofDrawBitmapString(ofVAArgsToString("Step ms:  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f"
+                                       ,this->stepTimes.percentile(50.0)
+                                       ,this->stepTimes.percentile(95.0)
+                                       ,this->stepTimes.percentile(99.0)
+                                       ,this->stepTimes.getMax())
+                      ,hOffset, textYOffset += vSpacing);
+
+    if (this->flightRecorder->getDumpCount() > 0) {
+        ofDrawBitmapString("Frame spikes recorded: " + ofToString(this->flightRecorder->getDumpCount()) +
+                           ", last in " + this->lastSpikeFile
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    // Current frame
+
+    ofDrawBitmapString("Frame: " + ofToString(this->simulation->getFrameNumber()), hOffset, textYOffset += vSpacing);
+
+    // Hotkeys
+
+    ofDrawBitmapString("Hotkeys:", hOffset, textYOffset += vSpacing);
+    for (auto i = this->hotkeys.begin(); i != this->hotkeys.end(); i++) {
+        ofDrawBitmapString(*i, hOffset, textYOffset += vSpacing);
+    }
+
+    // Status information
+
+    auto bounds = this->simulation->getBounds();
+    auto minExt = bounds.getMinExtent();
+    auto maxExt = bounds.getMaxExtent();
+    
+    // Camera Position
+
+    ofDrawBitmapString("Camera position: <" + ofToString(cameraPos.x) +
+                                        "," + ofToString(cameraPos.y) +
+                                        "," + ofToString(cameraPos.z) + ">"
+                      ,hOffset
+                      ,textYOffset += vSpacing);
+
+    // Bounds
+
+    ofDrawBitmapString("Bounds: <" +
+                       ofToString(minExt.x) + "," + ofToString(minExt.y) + "," + ofToString(minExt.z) + "> <" +
+                       ofToString(maxExt.x) + "," + ofToString(maxExt.y) + "," + ofToString(maxExt.z) + ">"
+                      ,hOffset, textYOffset += vSpacing);
+
+    // Cell count
+
+    auto cellsPerAxis = this->simulation->getBinnedCellsPerAxis();
+    ofDrawBitmapString("Cells per axis: <" +
+                       ofToString(cellsPerAxis[0]) + "," + ofToString(cellsPerAxis[1]) + "," + ofToString(cellsPerAxis[2]) + ">"
+                       ,hOffset, textYOffset += vSpacing);
+
+    // Neighbor stencil
+
+    // Only claimed if the solver's kernels actually go through the stencil
+    // helpers the half-cell define changes:
+
+    const pbf::Solver& stencilSolver = this->simulation->getSolver();
+
+    ofDrawBitmapString(stencilSolver.isHalfCellStencilActive()
+                           ? "Neighbor stencil: half-cell (1-2 cells per axis)"
+                           : stencilSolver.getNeighborStencil() == pbf::STENCIL_HALF_CELL
+                               ? "Neighbor stencil: 3x3x3 (half-cell unused by kernels/Simulation.cl)"
+                               : "Neighbor stencil: 3x3x3"
+                      ,hOffset, textYOffset += vSpacing);
+
+    // Density estimate
+
+    ofDrawBitmapString(this->simulation->getSolver().isPairwiseDensity()
+                           ? "Density: pairwise (half-shell)"
+                           : "Density: gather"
+                      ,hOffset, textYOffset += vSpacing);
+
+    // External force fields
+
+    pbf::ForceFields& forceFields = this->simulation->getSolver().getForceFields();
+
+    ofDrawBitmapString("Force fields: " + ofToString(forceFields.size()) +
+                       (this->stirField >= 0 ? " (stirring)" : "")
+                      ,hOffset, textYOffset += vSpacing);
+
+    pbf::PairwiseDensity* pairwiseDensity = this->simulation->getSolver().getPairwiseDensity();
+
+    if (this->simulation->getSolver().isPairwiseDensity() && pairwiseDensity != NULL) {
+
+        static const char* const READS[] = { "buffer", "image", "auto" };
+
+        double bufferMs = 0.0;
+        double imageMs  = 0.0;
+        string reads    = READS[pairwiseDensity->getNeighborReads()];
+
+        if (pairwiseDensity->getNeighborReads() == pbf::NEIGHBOR_READS_AUTO) {
+            reads += string(" -> ") + (pairwiseDensity->isReadingImage() ? "image" : "buffer");
+        }
+
+        if (pairwiseDensity->getCalibration(bufferMs, imageMs)) {
+            reads += " (buffer " + ofToString(bufferMs, 2) + " ms, image " +
+                     (imageMs > 0.0 ? ofToString(imageMs, 2) + " ms)" : "n/a)");
+        }
+
+        ofDrawBitmapString("Neighbor reads: " + reads, hOffset, textYOffset += vSpacing);
+    }
+
+    if (this->laneUtilizationMeasured) {
+
+        const pbf::LaneUtilization& u = this->laneUtilization;
+
+        ofDrawBitmapString("Lane utilization: " + ofToString(u.sorted * 100.0, 0) + "% cell order, " +
+                           ofToString(u.balanced * 100.0, 0) + "% binned (SIMD " + ofToString(u.simdWidth) + ")" +
+                           (pairwiseDensity != NULL && pairwiseDensity->isBalanced() ? ", balancing" : "")
+                          ,hOffset, textYOffset += vSpacing);
+    }
+    
+    // Particle count
+
+    ofDrawBitmapString("Particles: " + ofToString(this->simulation->getNumberOfParticles())
+                      ,hOffset, textYOffset += vSpacing);
+
+    // Co-execution: the share of the particles, and the step time, of every
+    // device
+
+    if (this->simulation->isCoExecuting()) {
+
+        const pbf::CoExecution& coExecution = *this->simulation->getCoExecution();
+        static const char* const AXES = "xyz";
+
+        for (int k = 0; k < pbf::CoExecution::NUM_PARTITIONS; k++) {
+
+            const pbf::CoExecutionPartition& p = coExecution.getPartition(k);
+
+            ofDrawBitmapString("Co-execution on " + p.name + (p.gpu ? " (GPU)" : "") + ": " +
+                               ofToString(p.share * 100.0f, 0) + "% target, " + ofToString(p.owned) + " owned + " +
+                               ofToString(p.ghosts) + " ghosts, " + ofToString(p.stepMs, 2) + " ms" +
+                               (k == 0 ? string(", split ") + AXES[coExecution.getAxis()] + " = " +
+                                         ofToString(coExecution.getSplit(), 2) : string())
+                              ,hOffset, textYOffset += vSpacing);
+        }
+    }
+
+    // Volume export
+
+    if (this->exportVolume) {
+        ofDrawBitmapString("Exporting volume to: " + string(Constants::VOLUME_EXPORT_DIR)
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    // Frame publishing
+
+    if (this->publishFrames) {
+        ofDrawBitmapString("Publishing frames to: " + string(Constants::FRAME_RING_NAME) +
+                           " (" + ofToString(this->framePublisher->getPublishedCount()) + " published)"
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    // Frame recording and playback
+
+    if (this->frameRecorder != NULL) {
+        ofDrawBitmapString("Recording frames to: " + string(Constants::PLAYBACK_FILE) +
+                           " (" + ofToString(this->frameRecorder->getPublishedCount()) + " recorded, last " +
+                           ofToString(Constants::PLAYBACK_FRAMES) + " kept)"
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    if (this->playbackViewer != NULL) {
+        ofDrawBitmapString("Playback: " + string(this->playbackViewer->isPlaying() ? "playing" : "paused") +
+                           ", frame " + ofToString(this->playbackViewer->getPosition() + 1) +
+                           " of " + ofToString(this->playbackViewer->getLength()) +
+                           " (simulation frame " + ofToString(this->playbackViewer->getShownFrameNumber()) + "), " +
+                           ofToString(this->playbackViewer->getPrefetchedCount()) + " prefetched"
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    // Job server
+
+    if (this->jobServer != NULL && this->jobServer->isRunning()) {
+        int queued = 0, running = 0, completed = 0;
+        this->jobServer->getCounts(queued, running, completed);
+        ofDrawBitmapString("Job server on port " + ofToString(this->jobServer->getPort()) + ": " +
+                           ofToString(queued) + " queued, " + ofToString(running) + " running, " +
+                           ofToString(completed) + " completed"
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    // Session recording / replay
+
+    if (this->recordingSession) {
+        ofDrawBitmapString("Recording session: frame " + ofToString(this->sessionFrame)
+                          ,hOffset, textYOffset += vSpacing);
+    } else if (this->replayingSession) {
+        ofDrawBitmapString("Replaying " + this->replayFile + ": frame " + ofToString(this->sessionFrame) +
+                           " of " + ofToString(this->sessionLog.getLastFrame())
+                          ,hOffset, textYOffset += vSpacing);
+    }
+
+    // Roofline: achieved bandwidth and FLOP rate of every solver stage
+
+    if (this->rooflineProfiler != NULL) {
+        if (this->rooflineProfiler->hasReport()) {
+
+            const pbf::RooflineReport& report = this->rooflineProfiler->getReport();
+
+            ofDrawBitmapString(ofVAArgsToString("Roofline: %.0f GB/s, %.0f GFLOP/s peak, %.1f neighbors/particle"
+                                               ,report.device.peakGBps
+                                               ,report.device.peakGflops
+                                               ,report.meanNeighbors)
+                              ,hOffset, textYOffset += vSpacing);
+
+            for (auto i = report.entries.begin(); i != report.entries.end(); i++) {
+                ofDrawBitmapString(ofVAArgsToString("  %-27s %7.3f ms %7.1f GB/s %7.1f GFLOP/s %4.0f%% %s"
+                                                   ,i->stage.c_str()
+                                                   ,i->ms / static_cast<double>(report.steps)
+                                                   ,i->gbps
+                                                   ,i->gflops
+                                                   ,100.0 * i->ofRoof
+                                                   ,i->limiter)
+                                  ,hOffset, textYOffset += vSpacing);
+            }
+        } else {
+            ofDrawBitmapString("Roofline: profiling...", hOffset, textYOffset += vSpacing);
+        }
+    }
+
+    // Attribute visualization
+
+    if (this->simulation->getVisualAttribute() != Simulation::ATTRIBUTE_NONE) {
+        const char* attributes[] = { "none", "speed", "density", "lambda", "vorticity" };
+        const char* transfers[]  = { "grayscale", "heat", "jet", "cool/warm" };
+        ofDrawBitmapString("Coloring by: " + string(attributes[this->simulation->getVisualAttribute()]) +
+                           " (" + string(transfers[this->simulation->getTransferFunction()]) + ")"
+                          ,hOffset, textYOffset += vSpacing);
+    }
+}
+
+/**
+ * Draws the heads up display and the GUI. Building the text (strings and
+ * glyph meshes) allocates, so it's rendered into an FBO only when something
+ * it shows has been changed by an input, or every HUD_REFRESH_SECONDS for the
+ * values that change on their own (frame rate, timings, camera); all other
+ * frames draw the FBO as is
+ *
+ * @param [in] camera The scene camera
+ */
+void ofApp::drawHeadsUpDisplay(ofEasyCam& camera)
+{
+    int width  = ofGetWidth();
+    int height = ofGetHeight();
+
+    if (!this->hudText.isAllocated() ||
+        static_cast<int>(this->hudText.getWidth()) != width ||
+        static_cast<int>(this->hudText.getHeight()) != height) {
+        this->hudText.allocate(width, height, GL_RGBA);
+        this->hudDirty = true;
+    }
+
+    float now = ofGetElapsedTimef();
+
+    ofDisableDepthTest();
+
+    // The frame governor may refresh the timings less often:
+
+    float refreshSeconds = Constants::HUD_REFRESH_SECONDS;
+
+    if (this->frameGovernor != NULL) {
+        refreshSeconds *= this->frameGovernor->getSettings().statsInterval;
+    }
+
+    if (this->hudDirty || now - this->hudUpdated >= refreshSeconds) {
+
+        // openFrameworks' string drawing allocates; those allocations are
+        // taken out of the frame's count (see checkFrameAllocations):
+
+        unsigned long long allocationsBefore = AllocationCounter::getCount();
+
+        this->hudText.begin();
+            ofClear(0, 0, 0, 0);
+            this->renderHeadsUpDisplay(camera);
+        this->hudText.end();
+
+        this->hudAllocations += AllocationCounter::getCount() - allocationsBefore;
+
+        this->hudDirty     = false;
+        this->hudRefreshed = true;
+        this->hudUpdated   = now;
+    }
+
+    ofEnableAlphaBlending();
+    ofSetColor(255);
+    this->hudText.draw(0.0f, 0.0f);
+    ofDisableAlphaBlending();
+
+    if (this->playbackViewer != NULL) {
+        this->drawPlaybackTimeline();
+    }
+
+    this->gui.draw();
+    this->visGui.draw();
+    ofEnableDepthTest();
+}
+
+/**
+ * Draws the playback timeline along the bottom of the window. It moves every
+ * frame, so unlike the rest of the heads up display it's drawn directly
+ */
+void ofApp::drawPlaybackTimeline()
+{
+    float width  = static_cast<float>(ofGetWidth());
+    float height = static_cast<float>(ofGetHeight());
+    float length = static_cast<float>(max(this->playbackViewer->getLength(), 1ULL));
+    float margin = 20.0f;
+    float barY   = height - 2.0f * margin;
+    float barW   = width - 2.0f * margin;
+
+    ofNoFill();
+    ofSetColor(128);
+    ofRect(margin, barY, barW, 8.0f);
+
+    ofFill();
+    ofSetColor(0, 255, 0);
+    ofRect(margin, barY, barW * static_cast<float>(this->playbackViewer->getPosition() + 1) / length, 8.0f);
+
+    ofSetColor(255);
+}
+
+/**
+ * Renders the simulation
+ */
+void ofApp::draw()
+{
+    ofBackground(0);
+
+    if (this->replayingSession && this->headlessReplay) {
+        return;
+    }
+    
+    // Render the current step of the simulation:
+    
+    unsigned long long drawStart = ofGetElapsedTimeMicros();
+
+    this->camera.begin();
+        this->simulation->draw(this->camera);
+    this->camera.end();
+
+    this->drawMs = static_cast<double>(ofGetElapsedTimeMicros() - drawStart) * 1.0e-3;
+
+    this->drawHeadsUpDisplay(this->camera);
+
+    if (!this->firstFrameDrawn) {
+        this->firstFrameDrawn = true;
+        this->firstFrameMs    = ofGetElapsedTimeMillis();
+        this->hudDirty        = true;
+        ofLogNotice() << "First frame drawn " << this->firstFrameMs << " ms after startup (setup done after "
+                      << this->setupDoneMs << " ms)" << endl;
+    }
+}
+
+/*******************************************************************************
+ * Input handling
+ ******************************************************************************/
+
 /**
  * Tests if the simulation is paused
  */
@@ -308,16 +1465,337 @@ void ofApp::togglePaused()
 }
 
 /**
- * Invokes a keypress callback function
+ * Enables/disables exporting the density and velocity fields after every
+ * step. The exporter is created the first time export is enabled
+ */
+void ofApp::toggleVolumeExport()
+{
+    if (this->volumeExporter == NULL) {
+        this->volumeExporter = new VolumeExporter(*this->simulation
+                                                 ,Constants::VOLUME_EXPORT_DIR
+                                                 ,Constants::VOLUME_VOXEL_SIZE);
+    }
+
+    this->exportVolume = !this->exportVolume;
+}
+
+/**
+ * Enables/disables publishing every step to the shared memory frame ring
+ * read by external renderers. The ring is created the first time publishing
+ * is enabled
+ */
+void ofApp::toggleFramePublishing()
+{
+    if (this->framePublisher == NULL) {
+        this->framePublisher = new FramePublisher(*this->simulation
+                                                 ,Constants::FRAME_RING_NAME
+                                                 ,Constants::FRAME_RING_SLOTS);
+    }
+
+    this->publishFrames = !this->publishFrames && this->framePublisher->isOpen();
+}
+
+/**
+ * Starts or stops recording every step to the playback file, a ring of the
+ * last PLAYBACK_FRAMES frames on disk. Starting a recording replaces the
+ * previous one. Nothing is recorded during playback
+ */
+void ofApp::toggleFrameRecording()
+{
+    if (this->frameRecorder != NULL) {
+        delete this->frameRecorder;
+        this->frameRecorder = NULL;
+        return;
+    }
+
+    if (this->playbackViewer != NULL) {
+        return;
+    }
+
+    this->frameRecorder = new FramePublisher(*this->simulation
+                                            ,ofToDataPath(Constants::PLAYBACK_FILE, true)
+                                            ,Constants::PLAYBACK_FRAMES
+                                            ,true);
+
+    if (!this->frameRecorder->isOpen()) {
+        delete this->frameRecorder;
+        this->frameRecorder = NULL;
+    }
+}
+
+/**
+ * Enters or leaves playback of the recorded frames. A recording in progress
+ * is finished first. While playing back, the solver doesn't run; when
+ * playback ends, the simulation picks up where it was
+ */
+void ofApp::togglePlayback()
+{
+    if (this->playbackViewer != NULL) {
+        delete this->playbackViewer;
+        this->playbackViewer = NULL;
+        return;
+    }
+
+    if (this->frameRecorder != NULL) {
+        delete this->frameRecorder;
+        this->frameRecorder = NULL;
+    }
+
+    this->playbackViewer = new PlaybackViewer(ofToDataPath(Constants::PLAYBACK_FILE, true)
+                                             ,this->simulation->getNumberOfParticles()
+                                             ,Constants::PLAYBACK_PREFETCH_FRAMES);
+
+    if (!this->playbackViewer->isOpen()) {
+        delete this->playbackViewer;
+        this->playbackViewer = NULL;
+    }
+}
+
+/**
+ * Starts or stops the local job server. Starting it compiles the kernels for
+ * all of its workers, so jobs start without delay
+ */
+void ofApp::toggleJobServer()
+{
+    if (this->jobServer != NULL) {
+        delete this->jobServer;
+        this->jobServer = NULL;
+        return;
+    }
+
+    this->jobServer = new JobServer(ofToDataPath("", true)
+                                   ,Constants::JOB_SERVER_PORT
+                                   ,Constants::JOB_MAX_PARTICLES);
+
+    if (!this->jobServer->start(Constants::JOB_SERVER_WORKERS)) {
+        delete this->jobServer;
+        this->jobServer = NULL;
+    }
+}
+
+/**
+ * Switches between the full 3x3x3 and the half-cell neighbor stencil. The
+ * solver's kernels are rebuilt and its grid resized, so this stalls for a
+ * moment
+ */
+void ofApp::toggleNeighborStencil()
+{
+    pbf::Solver& solver = this->simulation->getSolver();
+
+    pbf::NeighborStencil stencil = solver.getNeighborStencil() == pbf::STENCIL_FULL
+                                 ? pbf::STENCIL_HALF_CELL
+                                 : pbf::STENCIL_FULL;
+
+    if (!solver.setNeighborStencil(stencil)) {
+        ofLogError() << "Couldn't rebuild the solver kernels for the new neighbor stencil";
+    }
+}
+
+/**
+ * Switches between the gather-based and the pairwise (half-shell) density
+ * estimate. kernels/Pairwise.cl is built the first time, so this stalls for
+ * a moment
+ */
+void ofApp::togglePairwiseDensity()
+{
+    pbf::Solver& solver = this->simulation->getSolver();
+
+    if (!solver.setPairwiseDensity(!solver.isPairwiseDensity())) {
+        ofLogError() << "Couldn't build the pairwise density kernels";
+    }
+}
+
+/**
+ * Cycles the neighbor reads of the pairwise density estimate (selecting it
+ * if needed) through automatic selection, buffer reads and image reads
+ */
+void ofApp::cycleNeighborReads()
+{
+    pbf::Solver& solver = this->simulation->getSolver();
+
+    if (!solver.isPairwiseDensity() && !solver.setPairwiseDensity(true)) {
+        ofLogError() << "Couldn't build the pairwise density kernels";
+        return;
+    }
+
+    pbf::PairwiseDensity* pairwise = solver.getPairwiseDensity();
+    pbf::NeighborReads reads       = pbf::NEIGHBOR_READS_AUTO;
+
+    switch (pairwise->getNeighborReads()) {
+        case pbf::NEIGHBOR_READS_AUTO:
+            reads = pbf::NEIGHBOR_READS_BUFFER;
+            break;
+        case pbf::NEIGHBOR_READS_BUFFER:
+            reads = pbf::NEIGHBOR_READS_IMAGE;
+            break;
+        case pbf::NEIGHBOR_READS_IMAGE:
+            reads = pbf::NEIGHBOR_READS_AUTO;
+            break;
+    }
+
+    if (!pairwise->setNeighborReads(reads)) {
+        ofLogError() << "This device can't read neighbors from an image";
+    }
+}
+
+/**
+ * Adds or removes a vortex force field about the vertical axis through the
+ * center of the bounds
+ */
+void ofApp::toggleStirring()
+{
+    pbf::ForceFields& fields = this->simulation->getSolver().getForceFields();
+
+    if (this->stirField >= 0) {
+        fields.remove(this->stirField);
+        this->stirField = -1;
+        return;
+    }
+
+    AABB bounds    = this->simulation->getBounds();
+    ofVec3f center = (bounds.getMinExtent() + bounds.getMaxExtent()) * 0.5f;
+    ofVec3f size   = bounds.getMaxExtent() - bounds.getMinExtent();
+
+    float position[] = { center.x, center.y, center.z };
+    float axis[]     = { 0.0f, 1.0f, 0.0f };
+    float radius     = min(size.x, size.z) * Constants::STIR_RADIUS_FRACTION;
+
+    this->stirField = fields.add(pbf::vortexField(position, axis, Constants::STIR_STRENGTH, radius));
+}
+
+/**
+ * Starts or stops the frame governor. Stopping it restores the quality
+ * settings it started from
+ */
+void ofApp::toggleFrameGovernor()
+{
+    if (this->frameGovernor != NULL) {
+        delete this->frameGovernor;
+        this->frameGovernor = NULL;
+        return;
+    }
+
+    FrameBudget budget;
+
+    budget.targetMs = Constants::GOVERNOR_TARGET_MS;
+
+    budget.lowest.solverIterations  = Constants::GOVERNOR_MIN_SOLVER_ITERATIONS;
+    budget.lowest.substeps          = Constants::GOVERNOR_MIN_SUBSTEPS;
+    budget.lowest.renderStride      = Constants::GOVERNOR_MAX_RENDER_STRIDE;
+    budget.lowest.statsInterval     = Constants::GOVERNOR_MAX_STATS_INTERVAL;
+
+    budget.highest.solverIterations = Constants::GOVERNOR_MAX_SOLVER_ITERATIONS;
+    budget.highest.substeps         = Constants::GOVERNOR_MAX_SUBSTEPS;
+    budget.highest.renderStride     = Constants::GOVERNOR_MIN_RENDER_STRIDE;
+    budget.highest.statsInterval    = Constants::GOVERNOR_MIN_STATS_INTERVAL;
+
+    this->frameGovernor = new FrameGovernor(*this->simulation, budget);
+}
+
+/**
+ * Starts or stops splitting the steps between two OpenCL devices (see
+ * Simulation::setCoExecution())
+ */
+void ofApp::toggleCoExecution()
+{
+    bool enabled = !this->simulation->isCoExecuting();
+
+    if (!this->simulation->setCoExecution(enabled)) {
+        ofLogError() << "Co-execution needs two OpenCL devices (or device fission)" << endl;
+    }
+}
+
+/**
+ * Switches binning particles by their number of pair candidates on or off
+ * for the pairwise density estimate (selecting it if needed), and reports
+ * the lane utilization of the last step with particles in cell order and
+ * binned. Blocks for the read back
+ */
+void ofApp::toggleDensityBalancing()
+{
+    pbf::Solver& solver = this->simulation->getSolver();
+
+    if (!solver.isPairwiseDensity() && !solver.setPairwiseDensity(true)) {
+        ofLogError() << "Couldn't build the pairwise density kernels";
+        return;
+    }
+
+    pbf::PairwiseDensity* pairwise = solver.getPairwiseDensity();
+
+    if (!pairwise->setBalanced(!pairwise->isBalanced())) {
+        ofLogError() << "Couldn't allocate the pairwise density work list";
+    }
+
+    if (pairwise->isColored()) {
+        ofLogNotice() << "Pairwise density runs by cell color on this device; balancing has no effect";
+    }
+
+    this->laneUtilization         = pairwise->measureLaneUtilization();
+    this->laneUtilizationMeasured = true;
+
+    ofLogNotice() << "Lane utilization (SIMD " << this->laneUtilization.simdWidth << "): "
+                  << (this->laneUtilization.sorted * 100.0) << "% in cell order, "
+                  << (this->laneUtilization.balanced * 100.0) << "% binned by neighbor count";
+}
+
+/**
+ * Starts or stops the roofline report on the solver stage timings. The
+ * device's peak bandwidth is measured every time it starts
+ */
+void ofApp::toggleRooflineProfiling()
+{
+    if (this->rooflineProfiler != NULL) {
+        delete this->rooflineProfiler;
+        this->rooflineProfiler = NULL;
+        return;
+    }
+
+    if (!this->simulation->getSolver().isProfiling()) {
+        ofLogWarning() << "The solver isn't profiled; roofline profiling is unavailable";
+        return;
+    }
+
+    this->rooflineProfiler = new RooflineProfiler(*this->simulation
+                                                 ,ofToDataPath(Constants::ROOFLINE_FILE)
+                                                 ,Constants::ROOFLINE_REPORT_STEPS);
+}
+
+/**
+ * Records a key press, if the session is being recorded, and handles it.
+ * Keys are ignored while a session is replayed, so it runs as recorded
  */
 void ofApp::keyPressed(int key)
 {
+    if (this->replayingSession) {
+        return;
+    }
+
+    if (key == 'c') {
+        this->toggleSessionRecording();
+        return;
+    }
+
+    this->recordSessionEvent("key", static_cast<float>(key));
+    this->handleKey(key);
+}
+
+/**
+ * Invokes a keypress callback function
+ */
+void ofApp::handleKey(int key)
+{
+    this->hudDirty = true;
+
     switch (key) {
-        // Pause
+        // Pause (or pause playback)
         case 'p':
         case ' ':
             {
-                this->togglePaused();
+                if (this->playbackViewer != NULL) {
+                    this->playbackViewer->setPlaying(!this->playbackViewer->isPlaying());
+                } else {
+                    this->togglePaused();
+                }
             }
             break;
         // Step
@@ -344,6 +1822,109 @@ void ofApp::keyPressed(int key)
                 this->simulation->toggleDrawGrid();
             }
             break;
+        // Toggle volume export:
+        case 'v':
+            {
+                this->toggleVolumeExport();
+            }
+            break;
+        // Toggle shared memory frame publishing:
+        case 'm':
+            {
+                this->toggleFramePublishing();
+            }
+            break;
+        // Start/stop the job server:
+        case 'j':
+            {
+                this->toggleJobServer();
+            }
+            break;
+        // Start/stop roofline profiling:
+        case 'k':
+            {
+                this->toggleRooflineProfiling();
+            }
+            break;
+        // Reset the frame time percentiles:
+        case 'h':
+            {
+                this->resetFrameTimings();
+            }
+            break;
+        // Toggle the half-cell neighbor stencil:
+        case 'n':
+            {
+                this->toggleNeighborStencil();
+            }
+            break;
+        // Toggle the pairwise density estimate:
+        case 'x':
+            {
+                this->togglePairwiseDensity();
+            }
+            break;
+        // Toggle load balancing of the pairwise density estimate:
+        case 'b':
+            {
+                this->toggleDensityBalancing();
+            }
+            break;
+        // Cycle the neighbor reads of the pairwise density estimate:
+        case 'i':
+            {
+                this->cycleNeighborReads();
+            }
+            break;
+        // Toggle stirring the fluid with a vortex force field:
+        case 'f':
+            {
+                this->toggleStirring();
+            }
+            break;
+        // Toggle co-execution on two devices:
+        case 'e':
+            {
+                this->toggleCoExecution();
+            }
+            break;
+        // Toggle the frame time governor:
+        case 't':
+            {
+                this->toggleFrameGovernor();
+            }
+            break;
+        // Start/stop recording frames for playback:
+        case 'o':
+            {
+                this->toggleFrameRecording();
+            }
+            break;
+        // Enter/leave playback:
+        case 'l':
+            {
+                this->togglePlayback();
+            }
+            break;
+        // Scrub playback by a frame, pausing it:
+        case OF_KEY_LEFT:
+        case OF_KEY_RIGHT:
+            {
+                if (this->playbackViewer != NULL) {
+                    this->playbackViewer->setPlaying(false);
+                    this->playbackViewer->scrub(key == OF_KEY_LEFT ? -1 : 1);
+                }
+            }
+            break;
+        // Scrub playback coarsely:
+        case '[':
+        case ']':
+            {
+                if (this->playbackViewer != NULL) {
+                    this->playbackViewer->scrub(key == '[' ? -Constants::PLAYBACK_SCRUB_FRAMES : Constants::PLAYBACK_SCRUB_FRAMES);
+                }
+            }
+            break;
     }
 }
 
@@ -3,7 +3,18 @@
 #include "ofMain.h"
 #include "ofxGui.h"
 #include "MSAOpenCL.h"
+#include "pbf/SessionLog.h"
+#include "pbf/TimingHistogram.h"
+#include "pbf/FlightRecorder.h"
 #include "Simulation.h"
+#include "VolumeExporter.h"
+#include "FramePublisher.h"
+#include "PlaybackViewer.h"
+#include "JobServer.h"
+#include "RooflineProfiler.h"
+#include "FrameGovernor.h"
+#include "AnimatedCollider.h"
+#include "MeshCollider.h"
 
 /*******************************************************************************
  * OpenFrameworks base class
@@ -18,6 +29,10 @@ class ofApp : public ofBaseApp
         void doResetBounds();
         void setAnimPeriod(float& period);
         void setAnimAmp(float& amp);
+        void setVisualAttribute(int& attribute);
+        void setTransferFunction(int& transfer);
+        void setAutoRange(bool& autoRange);
+        void setAttributeRange(float& value);
     
     protected:
         // UI controls:
@@ -31,26 +46,158 @@ class ofApp : public ofBaseApp
         ofxFloatSlider periodAnimSlider;
         ofxFloatSlider ampAnimSlider;
 
+        ofxGuiGroup visGui;
+        ofxIntSlider attributeSlider;
+        ofxIntSlider transferSlider;
+        ofxToggle toggleAutoRange;
+        ofxFloatSlider rangeMinSlider;
+        ofxFloatSlider rangeMaxSlider;
+
         // Flags
         bool paused;
         bool advanceStep;
+        bool exportVolume;
+        bool publishFrames;
     
         // Simulation, etc.
         ofEasyCam camera;
         msa::OpenCL openCL;
         Simulation* simulation;
+        VolumeExporter* volumeExporter;
+        FramePublisher* framePublisher;
+        FramePublisher* frameRecorder;
+        PlaybackViewer* playbackViewer;
+        JobServer* jobServer;
+        RooflineProfiler* rooflineProfiler;
+        FrameGovernor* frameGovernor;
+        AnimatedCollider* collider;
+        MeshCollider* meshCollider;
+
+        // Frame timing. The stage timings of every step are collected for
+        // the flight recorder, and the roofline report if it's on
+        pbf::TimingHistogram frameTimes;
+        pbf::TimingHistogram stepTimes;
+        pbf::FlightRecorder* flightRecorder;
+        std::vector<pbf::StageTiming> stageTimings;
+        std::string lastSpikeFile;
+
+        // Host time of drawing the simulation in the last frame, and the
+        // number of stepped frames, for the frame governor's knobs
+        double drawMs;
+        unsigned int steppedFrames;
+
+        // Index of the vortex field toggled by 'f' in the solver's force
+        // fields, or -1
+        int stirField;
+
+        // Lane utilization of the pairwise density pass, measured when
+        // balancing is toggled
+        pbf::LaneUtilization laneUtilization;
+        bool laneUtilizationMeasured;
+
+        // Time to first frame: milliseconds from startup until setup() was
+        // done, and until the first frame was drawn
+        bool firstFrameDrawn;
+        unsigned long long setupDoneMs;
+        unsigned long long firstFrameMs;
+
+        // Heads up display text, rendered into hudText only when hudDirty is
+        // set or HUD_REFRESH_SECONDS have passed; other frames just draw it
+        ofFbo hudText;
+        bool hudDirty;
+        bool hudRefreshed;
+        float hudUpdated;
+
+        // Allocations made re-rendering hudText since the last frame check,
+        // in allocation counting mode
+        unsigned long long hudAllocations;
+        std::vector<std::string> hotkeys;
+
+        // Allocation counting mode (see countAllocations)
+        bool countingAllocations;
+        unsigned int allocationFrame;
+        unsigned long long lastAllocationCount;
+        unsigned int allocatingFrames;
+        unsigned int firstAllocatingFrame;
+        unsigned long long maxFrameAllocations;
+        unsigned int hudRefreshFrames;
+
+        // Session recording and replay. sessionFrame counts the updates
+        // since recording or replay started
+        pbf::SessionLog sessionLog;
+        bool recordingSession;
+        bool replayingSession;
+        bool headlessReplay;
+        std::string replayFile;
+        unsigned int sessionFrame;
+        float sessionStart;
+        std::ofstream replayTimings;
+        double replayFrameMs[2];   // Sum, max
+        double replayStepMs[2];
+        unsigned int replaySteps;
+        bool lastAnimateBounds;
+        bool lastAnimateBothSides;
+        ofVec3f lastCameraPosition;
+        ofQuaternion lastCameraOrientation;
     
+        void enableQueueProfiling();
         void initializeSimulation();
+        void initializeColliders();
         void drawHeadsUpDisplay(ofEasyCam& camera);
+        void renderHeadsUpDisplay(ofEasyCam& camera);
+        void drawPlaybackTimeline();
+        void checkFrameAllocations();
+
+        void startSessionRecording();
+        void stopSessionRecording();
+        void recordSessionEvent(const std::string& name, const std::vector<float>& values = std::vector<float>());
+        void recordSessionEvent(const std::string& name, float value);
+        void recordSessionState();
+        void recordPolledInputs(bool force);
+        void startSessionReplay();
+        void replaySessionEvents();
+        void applySessionEvent(const pbf::SessionEvent& event);
+        void recordReplayTiming(bool stepped, double stepMs);
+        void recordFrameTiming(bool stepped, double stepMs);
+        void dumpFlightRecorder(double frameMs);
+        void finishSessionReplay();
+        void handleKey(int key);
     
 	public:
+        ofApp();
+
 		void setup();
         void reset();
 		void update();
 		void draw();
+        void exit();
     
         bool isPaused() const;
         void togglePaused();
+        void toggleVolumeExport();
+        void toggleFramePublishing();
+        void toggleFrameRecording();
+        void togglePlayback();
+        void toggleJobServer();
+        void toggleRooflineProfiling();
+        void toggleNeighborStencil();
+        void togglePairwiseDensity();
+        void toggleDensityBalancing();
+        void cycleNeighborReads();
+        void toggleStirring();
+        void toggleCoExecution();
+        void toggleFrameGovernor();
+        void toggleSessionRecording();
+        void resetFrameTimings();
+
+        // Replays a recorded session once the app is set up. Call before
+        // ofRunApp(); headless skips all drawing and exits when done
+        void replaySession(const std::string& filename, bool headless);
+
+        // Runs the simulation unpaused and checks that no frame allocates
+        // after warming up, exiting with status 1 if any does. Call before
+        // ofRunApp()
+        void countAllocations();
 
 		void keyPressed(int key);
 };
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * BoundsAnimation.cpp
+ * - Periodic animation of the simulation bounds, e.g. a wall moving back and
+ *   forth to make waves
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <cmath>
+#include "BoundsAnimation.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+BoundsAnimation::BoundsAnimation() :
+    type(SINE_WAVE),
+    period(1.0f),
+    amplitude(10.0f),
+    bothSides(false),
+    frame(0)
+{
+
+}
+
+/**
+ * Steps the animation by one frame
+ *
+ * @param [in] original The bounds the animation is relative to
+ * @param [in|out] bounds The animated bounds
+ * @param [in] dt The simulation time step
+ */
+void BoundsAnimation::step(const Bounds& original, Bounds& bounds, float dt)
+{
+    float value     = 0.0f;
+    float pi        = static_cast<float>(M_PI);
+    float t         = static_cast<float>(this->frame);
+    float origMinX  = original.min[0];
+    float origMaxX  = original.max[0];
+    float width     = origMaxX - origMinX;
+    float limit     = width * 0.66f;
+    float halfLimit = limit * 0.5f;
+    float limitMinX = origMinX + halfLimit;
+    float limitMaxX = origMaxX - halfLimit;
+
+    if (this->type == SINE_WAVE) {
+
+        float theta = static_cast<float>(this->frame % 720) * (pi / 180.0f);
+        value       = this->amplitude * sin(this->period * pi * theta);
+
+        bounds.max[0] = origMaxX - value;
+
+        if (this->bothSides) {
+            bounds.min[0] = origMinX + value;
+        }
+
+    } else if (this->type == LINEAR_RAMP) {
+
+        float tPeriod = (t / this->period) * dt;
+        value         = 2.0f * this->amplitude * (tPeriod - floor(0.5f + tPeriod));
+
+        bounds.max[0] = origMaxX - value;
+
+        if (this->bothSides) {
+            bounds.min[0] = origMinX + value;
+        }
+
+    } else if (this->type == COMPRESS) {
+
+        if (bounds.max[0] >= limitMaxX) {
+            bounds.max[0] -= 0.25f;
+        }
+
+        if (this->bothSides && bounds.min[0] <= limitMinX) {
+            bounds.min[0] += 0.25f;
+        }
+    }
+
+    this->frame++;
+}
+
+}
+
+/******************************************************************************/
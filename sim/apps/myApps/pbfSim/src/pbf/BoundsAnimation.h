@@ -0,0 +1,56 @@
+/*******************************************************************************
+ * BoundsAnimation.h
+ * - Periodic animation of the simulation bounds, e.g. a wall moving back and
+ *   forth to make waves
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_BOUNDS_ANIMATION_H
+#define PBF_LIB_BOUNDS_ANIMATION_H
+
+#include "Solver.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * Animates the x extent of the bounds relative to the original bounds. Only
+ * the max x wall moves unless bothSides is set
+ */
+class BoundsAnimation
+{
+    public:
+        enum Type
+        {
+            SINE_WAVE
+           ,LINEAR_RAMP
+           ,COMPRESS
+        };
+
+        Type type;
+
+        float period;
+
+        float amplitude;
+
+        bool bothSides;
+
+        // Number of animation steps taken
+        unsigned int frame;
+
+        BoundsAnimation();
+
+        void reset() { this->frame = 0; }
+
+        // Moves bounds by one animation step of length dt
+        void step(const Bounds& original, Bounds& bounds, float dt);
+};
+
+}
+
+/******************************************************************************/
+
+#endif
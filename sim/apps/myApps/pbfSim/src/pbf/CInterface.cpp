@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * CInterface.cpp
+ * - A plain C interface to pbf::Session, for foreign function interfaces
+ *   such as Python's ctypes
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <cstring>
+#include "CInterface.h"
+#include "Session.h"
+
+/******************************************************************************/
+
+using namespace std;
+using namespace pbf;
+
+/******************************************************************************/
+
+static_assert(sizeof(Particle) == 12 * sizeof(float), "Particle must be 12 floats");
+static_assert(sizeof(Parameters) == 7 * sizeof(float), "Parameters must be 7 floats");
+
+struct pbf_session
+{
+    Session session;
+
+    pbf_session(const char* dataPath, int platformIndex, int deviceIndex) :
+        session(dataPath, platformIndex, deviceIndex)
+    {
+
+    }
+};
+
+namespace {
+
+Bounds toBounds(const float* values)
+{
+    Bounds bounds = {{ values[0], values[1], values[2] }
+                    ,{ values[3], values[4], values[5] }};
+
+    return bounds;
+}
+
+Parameters toParameters(const float* values)
+{
+    return Parameters(values[0], values[1], values[2], values[3], values[4], values[5], values[6]);
+}
+
+}
+
+/******************************************************************************/
+
+pbf_session* pbf_session_create(const char* dataPath, int platformIndex, int deviceIndex)
+{
+    return new pbf_session(dataPath != NULL ? dataPath : "", platformIndex, deviceIndex);
+}
+
+void pbf_session_destroy(pbf_session* session)
+{
+    delete session;
+}
+
+int pbf_session_is_loaded(pbf_session* session)
+{
+    return session->session.isLoaded() ? 1 : 0;
+}
+
+int pbf_session_setup(pbf_session* session
+                     ,const float* initialState
+                     ,int numParticles
+                     ,const int* cellsPerAxis
+                     ,const float* bounds
+                     ,const float* parameters
+                     ,float dt)
+{
+    Bounds b     = toBounds(bounds);
+    Parameters p = toParameters(parameters);
+
+    int cells[3];
+
+    if (cellsPerAxis != NULL) {
+        memcpy(cells, cellsPerAxis, sizeof(cells));
+    } else {
+        Session::idealCellsPerAxis(b, p.particleRadius, 2, cells);
+    }
+
+    return session->session.setup(reinterpret_cast<const Particle*>(initialState)
+                                 ,numParticles
+                                 ,cells
+                                 ,b
+                                 ,p
+                                 ,dt) ? 1 : 0;
+}
+
+void pbf_session_step(pbf_session* session, int steps)
+{
+    session->session.step(steps);
+}
+
+int pbf_session_num_particles(pbf_session* session)
+{
+    return session->session.getNumberOfParticles();
+}
+
+unsigned int pbf_session_frame_number(pbf_session* session)
+{
+    return session->session.getFrameNumber();
+}
+
+float* pbf_session_particles(pbf_session* session)
+{
+    return reinterpret_cast<float*>(session->session.getParticles());
+}
+
+float* pbf_session_density(pbf_session* session)
+{
+    return session->session.getDensity();
+}
+
+void pbf_session_get_bounds(pbf_session* session, float* bounds)
+{
+    const Bounds& b = session->session.getBounds();
+
+    memcpy(bounds, b.min, 3 * sizeof(float));
+    memcpy(bounds + 3, b.max, 3 * sizeof(float));
+}
+
+void pbf_session_set_bounds(pbf_session* session, const float* bounds)
+{
+    session->session.setBounds(toBounds(bounds));
+}
+
+void pbf_session_reset_bounds(pbf_session* session)
+{
+    session->session.resetBounds();
+}
+
+void pbf_session_get_parameters(pbf_session* session, float* parameters)
+{
+    const Parameters& p = session->session.getParameters();
+
+    float values[] = { p.particleRadius
+                     , p.smoothingRadius
+                     , p.relaxation
+                     , p.artificialPressureK
+                     , p.artificialPressureN
+                     , p.vorticityEpsilon
+                     , p.viscosityCoeff };
+
+    memcpy(parameters, values, sizeof(values));
+}
+
+void pbf_session_set_parameters(pbf_session* session, const float* parameters)
+{
+    session->session.setParameters(toParameters(parameters));
+}
+
+void pbf_session_set_time_step(pbf_session* session, float dt)
+{
+    session->session.setTimeStep(dt);
+}
+
+void pbf_session_set_solver_iterations(pbf_session* session, int iterations)
+{
+    session->session.setSolverIterations(iterations);
+}
+
+void pbf_session_set_animation(pbf_session* session
+                              ,int enabled
+                              ,int type
+                              ,float period
+                              ,float amplitude
+                              ,int bothSides)
+{
+    BoundsAnimation& animation = session->session.getAnimation();
+
+    animation.type      = static_cast<BoundsAnimation::Type>(type);
+    animation.period    = period;
+    animation.amplitude = amplitude;
+    animation.bothSides = bothSides != 0;
+
+    session->session.setAnimating(enabled != 0);
+}
+
+/******************************************************************************/
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * CInterface.h
+ * - A plain C interface to pbf::Session, for foreign function interfaces
+ *   such as Python's ctypes (see python/pbf.py). Built into libpbf.so by
+ *   "make shared"
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_C_INTERFACE_H
+#define PBF_LIB_C_INTERFACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+
+typedef struct pbf_session pbf_session;
+
+/*
+ * Particles are laid out as 12 floats each: pos, posStar and vel, each as
+ * x, y, z, w. Bounds are 6 floats: min x, y, z, then max x, y, z. Parameters
+ * are 7 floats, in the order of the fields of Parameters (see Parameters.h)
+ */
+
+pbf_session* pbf_session_create(const char* dataPath, int platformIndex, int deviceIndex);
+void pbf_session_destroy(pbf_session* session);
+int pbf_session_is_loaded(pbf_session* session);
+
+/* cellsPerAxis may be NULL, in which case it's derived from the bounds and
+   particle radius. Returns 0 on failure */
+int pbf_session_setup(pbf_session* session
+                     ,const float* initialState
+                     ,int numParticles
+                     ,const int* cellsPerAxis
+                     ,const float* bounds
+                     ,const float* parameters
+                     ,float dt);
+
+/* Blocks until the steps are done; does not touch any interpreter state, so
+   bindings can release their global locks around it */
+void pbf_session_step(pbf_session* session, int steps);
+
+int pbf_session_num_particles(pbf_session* session);
+unsigned int pbf_session_frame_number(pbf_session* session);
+
+/* Host-mapped state, valid until the next step */
+float* pbf_session_particles(pbf_session* session);
+float* pbf_session_density(pbf_session* session);
+
+void pbf_session_get_bounds(pbf_session* session, float* bounds);
+void pbf_session_set_bounds(pbf_session* session, const float* bounds);
+void pbf_session_reset_bounds(pbf_session* session);
+
+void pbf_session_get_parameters(pbf_session* session, float* parameters);
+void pbf_session_set_parameters(pbf_session* session, const float* parameters);
+
+void pbf_session_set_time_step(pbf_session* session, float dt);
+void pbf_session_set_solver_iterations(pbf_session* session, int iterations);
+
+/* type: 0 = sine wave, 1 = linear ramp, 2 = compress */
+void pbf_session_set_animation(pbf_session* session
+                              ,int enabled
+                              ,int type
+                              ,float period
+                              ,float amplitude
+                              ,int bothSides);
+
+/******************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,704 @@
+/*******************************************************************************
+ * CoExecution.cpp
+ * - Steps one particle state on two OpenCL devices at once, with a split of
+ *   the domain that follows their measured step times
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <utility>
+#include "CoExecution.h"
+
+#ifdef __APPLE__
+    #include <OpenCL/cl_ext.h>
+#else
+    #include <CL/cl_ext.h>
+#endif
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+namespace {
+
+// How far the shares move toward the measured throughput ratio per step;
+// lower is steadier, higher follows load changes faster
+const float REBALANCE_SMOOTHING = 0.5f;
+
+// The split only moves for the shares once it's off from them by more than
+// this fraction of the particles, since moving it means a full upload
+const float REBALANCE_THRESHOLD = 0.02f;
+
+// Neither device gets less than this share, so both keep being measured
+const float MIN_SHARE = 0.05f;
+
+// Width of the ghost band around the split, in smoothing radii, before the
+// one radius added per solver iteration (see step())
+const float GHOST_RADII = 2.0f;
+
+// Extra width of the band when it's uploaded, in smoothing radii: the
+// particles can move this far before an owned particle's neighborhood may
+// reach past the ghosts. How far they moved is estimated from the fastest
+// exchanged particle, times TRAVEL_SAFETY, since the particles away from
+// the split aren't read back
+const float SKIN_RADII = 1.0f;
+const float TRAVEL_SAFETY = 2.0f;
+
+// The slabs are partitioned again after this many steps at the latest
+const int MAX_RESIDENT_STEPS = 32;
+
+// Slab sizes (owned + ghosts) are rounded up to a multiple of this, with
+// the extra filled by more ghosts, so the sessions' buffers are only
+// reallocated when a slab grows or shrinks by about this much
+const int PARTITION_GRANULE = 1024;
+
+// Returns the devices of every platform
+vector<cl_device_id> allDevices()
+{
+    vector<cl_device_id> result;
+    cl_uint numPlatforms = 0;
+
+    if (clGetPlatformIDs(0, NULL, &numPlatforms) != CL_SUCCESS || numPlatforms == 0) {
+        return result;
+    }
+
+    vector<cl_platform_id> platforms(numPlatforms);
+    clGetPlatformIDs(numPlatforms, &platforms[0], NULL);
+
+    for (auto p = platforms.begin(); p != platforms.end(); p++) {
+
+        cl_uint numDevices = 0;
+
+        if (clGetDeviceIDs(*p, CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices) != CL_SUCCESS || numDevices == 0) {
+            continue;
+        }
+
+        vector<cl_device_id> devices(numDevices);
+        clGetDeviceIDs(*p, CL_DEVICE_TYPE_ALL, numDevices, &devices[0], NULL);
+
+        result.insert(result.end(), devices.begin(), devices.end());
+    }
+
+    return result;
+}
+
+bool isDeviceType(cl_device_id device, cl_device_type type)
+{
+    cl_device_type actual = 0;
+    clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(actual), &actual, NULL);
+    return (actual & type) != 0;
+}
+
+// The split goes across the longest extent of the bounds, which keeps the
+// shared boundary (and so the number of ghosts) small
+int longestAxis(const Bounds& bounds)
+{
+    int longest = 0;
+
+    for (int i = 1; i < 3; i++) {
+        if (bounds.max[i] - bounds.min[i] > bounds.max[longest] - bounds.min[longest]) {
+            longest = i;
+        }
+    }
+
+    return longest;
+}
+
+}
+
+/**
+ * @param [in] _dataPath Directory containing kernels/
+ */
+CoExecution::CoExecution(const string& _dataPath) :
+    dataPath(_dataPath),
+    axis(0),
+    split(0.0f),
+    numParticles(0),
+    travelled(0.0f),
+    bandWidth(0.0f),
+    residentSteps(0)
+{
+    this->cellsPerAxis[0] = this->cellsPerAxis[1] = this->cellsPerAxis[2] = 0;
+
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+        this->partitions[k].gpu    = false;
+        this->partitions[k].owned  = 0;
+        this->partitions[k].ghosts = 0;
+        this->partitions[k].stepMs = 0.0;
+        this->partitions[k].share  = 1.0f / NUM_PARTITIONS;
+    }
+}
+
+CoExecution::~CoExecution()
+{
+    this->close();
+}
+
+bool CoExecution::open(cl_device_type types)
+{
+    vector<cl_device_id> devices;
+    vector<cl_device_id> found = allDevices();
+
+    for (auto i = found.begin(); i != found.end(); i++) {
+        if (isDeviceType(*i, types)) {
+            devices.push_back(*i);
+        }
+    }
+
+    if (devices.empty()) {
+        cerr << "[pbf] Co-execution: no OpenCL devices found" << endl;
+        return false;
+    }
+
+    cl_device_id gpu = NULL;
+    cl_device_id cpu = NULL;
+
+    for (auto i = devices.begin(); i != devices.end(); i++) {
+        if (gpu == NULL && isDeviceType(*i, CL_DEVICE_TYPE_GPU)) {
+            gpu = *i;
+        } else if (cpu == NULL && isDeviceType(*i, CL_DEVICE_TYPE_CPU)) {
+            cpu = *i;
+        }
+    }
+
+    if (gpu != NULL && cpu != NULL) {
+        return this->open(gpu, cpu);
+    }
+
+    if (devices.size() >= 2) {
+        return this->open(devices[0], devices[1]);
+    }
+
+    return this->openSubDevices(devices[0]);
+}
+
+/**
+ * Splits a device into two sub-devices with half of its compute units each
+ */
+bool CoExecution::openSubDevices(cl_device_id device)
+{
+    clCreateSubDevicesEXT_fn createSubDevices =
+        reinterpret_cast<clCreateSubDevicesEXT_fn>(clGetExtensionFunctionAddress("clCreateSubDevicesEXT"));
+
+    cl_uint computeUnits = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(computeUnits), &computeUnits, NULL);
+
+    if (createSubDevices == NULL || computeUnits < 2) {
+        cerr << "[pbf] Co-execution needs two OpenCL devices, or one that supports device fission" << endl;
+        return false;
+    }
+
+    cl_device_partition_property_ext properties[] = {
+        CL_DEVICE_PARTITION_EQUALLY_EXT, computeUnits / 2, 0
+    };
+
+    cl_device_id halves[2] = { NULL, NULL };
+    cl_uint numHalves      = 0;
+
+    if (!checkError(createSubDevices(device, properties, 2, halves, &numHalves), "clCreateSubDevicesEXT")) {
+        return false;
+    }
+
+    this->subDevices.assign(halves, halves + min(numHalves, 2u));
+
+    if (this->subDevices.size() < 2) {
+        cerr << "[pbf] Co-execution: device fission returned " << numHalves << " sub-device(s)" << endl;
+        this->close();
+        return false;
+    }
+
+    return this->open(halves[0], halves[1]);
+}
+
+bool CoExecution::open(cl_device_id first, cl_device_id second)
+{
+    cl_device_id devices[NUM_PARTITIONS] = { first, second };
+
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+
+        this->sessions[k] = shared_ptr<Session>(new Session(this->dataPath, devices[k]));
+
+        if (!this->sessions[k]->isLoaded()) {
+            cerr << "[pbf] Co-execution: couldn't load the solver on device " << k << endl;
+            this->close();
+            return false;
+        }
+
+        this->sessions[k]->setResident(true);
+
+        this->partitions[k].name   = this->sessions[k]->getDeviceName();
+        this->partitions[k].gpu    = isDeviceType(devices[k], CL_DEVICE_TYPE_GPU);
+        this->partitions[k].share  = 1.0f / NUM_PARTITIONS;
+        this->partitions[k].stepMs = 0.0;
+    }
+
+    // The GPU usually takes most of the work; start from a guess rather
+    // than an even split, and let rebalancing correct it:
+
+    if (this->partitions[0].gpu != this->partitions[1].gpu) {
+        int gpu = this->partitions[0].gpu ? 0 : 1;
+        this->partitions[gpu].share     = 0.75f;
+        this->partitions[1 - gpu].share = 0.25f;
+    }
+
+    this->split = 0.0f;
+
+    return true;
+}
+
+void CoExecution::close()
+{
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+        this->sessions[k].reset();
+        this->local[k].clear();
+        this->indices[k].clear();
+        this->layers[k].clear();
+        this->partitions[k].owned  = 0;
+        this->partitions[k].ghosts = 0;
+    }
+
+    this->numParticles = 0;
+    this->state.clear();
+
+    if (!this->subDevices.empty()) {
+
+        clReleaseDeviceEXT_fn releaseDevice =
+            reinterpret_cast<clReleaseDeviceEXT_fn>(clGetExtensionFunctionAddress("clReleaseDeviceEXT"));
+
+        for (auto i = this->subDevices.begin(); i != this->subDevices.end() && releaseDevice != NULL; i++) {
+            releaseDevice(*i);
+        }
+
+        this->subDevices.clear();
+    }
+}
+
+float CoExecution::ghostWidth(const Parameters& parameters, int solverIterations)
+{
+    return (GHOST_RADII + max(solverIterations, 0)) * parameters.smoothingRadius;
+}
+
+/**
+ * Sorts the state into the two slabs. Particles on the other side of the
+ * split, nearest first, are appended to each slab as ghosts: all of those
+ * within width, and then more until the slab's size reaches its rounded-up
+ * capacity. Each slab's owned particles end with the ones the other slab
+ * takes as ghosts, in the same order, so a single contiguous copy refreshes
+ * the ghosts after a step (see exchange())
+ */
+void CoExecution::partition(float width)
+{
+    const int n = this->numParticles;
+
+    vector<pair<float, int> > others[NUM_PARTITIONS];
+    vector<int> ghosts[NUM_PARTITIONS];
+    vector<int> owners(n);
+    vector<char> exported(n, 0);
+
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+        others[k].reserve(n);
+    }
+
+    for (int i = 0; i < n; i++) {
+
+        float distance = this->state[i].pos.s[this->axis] - this->split;
+        int k          = distance < 0.0f ? 0 : 1;
+
+        owners[i] = k;
+        others[1 - k].push_back(make_pair(distance < 0.0f ? -distance : distance, i));
+    }
+
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+
+        int owned       = static_cast<int>(others[1 - k].size());
+        int available   = static_cast<int>(others[k].size());
+        int withinWidth = 0;
+
+        for (auto i = others[k].begin(); i != others[k].end(); i++) {
+            withinWidth += i->first <= width ? 1 : 0;
+        }
+
+        // Keep the current capacity while the slab fits in it without too
+        // much slack; otherwise round the new size up:
+
+        int required = owned + withinWidth;
+        int previous = this->sessions[k]->getNumberOfParticles();
+        int capacity = required <= previous && previous - required < 2 * PARTITION_GRANULE
+                     ? previous
+                     : ((required + PARTITION_GRANULE - 1) / PARTITION_GRANULE) * PARTITION_GRANULE;
+
+        int count = min(capacity - owned, available);
+
+        if (count < available) {
+            nth_element(others[k].begin(), others[k].begin() + count, others[k].end());
+        }
+
+        for (int i = 0; i < count; i++) {
+            ghosts[k].push_back(others[k][i].second);
+            exported[others[k][i].second] = 1;
+        }
+
+        this->partitions[k].owned  = owned;
+        this->partitions[k].ghosts = count;
+    }
+
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+
+        vector<int>& owned = this->indices[k];
+
+        owned.clear();
+        owned.reserve(this->partitions[k].owned);
+
+        for (int i = 0; i < n; i++) {
+            if (owners[i] == k && !exported[i]) {
+                owned.push_back(i);
+            }
+        }
+
+        owned.insert(owned.end(), ghosts[1 - k].begin(), ghosts[1 - k].end());
+
+        this->local[k].resize(owned.size() + ghosts[k].size());
+
+        for (size_t i = 0; i < owned.size(); i++) {
+            this->local[k][i] = this->state[owned[i]];
+        }
+
+        for (size_t i = 0; i < ghosts[k].size(); i++) {
+            this->local[k][owned.size() + i] = this->state[ghosts[k][i]];
+        }
+    }
+
+    this->bandWidth = width;
+}
+
+/**
+ * Uploads both slabs. The sessions keep their buffers if a slab's capacity
+ * didn't change
+ */
+bool CoExecution::upload(const Bounds& bounds, const Parameters& parameters, float dt)
+{
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+
+        if (this->local[k].empty()) {
+            continue;
+        }
+
+        if (!this->sessions[k]->setup(&this->local[k][0]
+                                     ,static_cast<int>(this->local[k].size())
+                                     ,this->cellsPerAxis
+                                     ,bounds
+                                     ,parameters
+                                     ,dt)) {
+            cerr << "[pbf] Co-execution: couldn't set up partition " << k << endl;
+            return false;
+        }
+
+        this->layers[k].clear();
+    }
+
+    this->travelled     = 0.0f;
+    this->residentSteps = 0;
+
+    return true;
+}
+
+/**
+ * Steps a slab on its device, then reads back the end of its owned range,
+ * which the other slab holds as ghosts. Runs on its own thread, concurrently
+ * with the other slab. Returns the time taken in milliseconds, or a negative
+ * value if the layer couldn't be read back
+ */
+double CoExecution::stepPartition(int k
+                                 ,const Bounds& bounds
+                                 ,const Parameters& parameters
+                                 ,float dt
+                                 ,int solverIterations
+                                 ,const ForceFields* forceFields)
+{
+    auto start = chrono::steady_clock::now();
+
+    Session& session = *this->sessions[k];
+
+    if (this->local[k].empty()) {
+        this->layers[k].clear();
+        return 0.0;
+    }
+
+    session.setParameters(parameters);
+    session.setTimeStep(dt);
+    session.setBounds(bounds);
+    session.setSolverIterations(solverIterations);
+
+    if (forceFields != NULL) {
+
+        ForceFields& fields = session.getSolver().getForceFields();
+
+        fields.clear();
+
+        for (int i = 0; i < forceFields->size(); i++) {
+            fields.add(forceFields->get(i));
+        }
+    }
+
+    session.step(1);
+
+    int owned = this->partitions[k].owned;
+    int count = this->partitions[1 - k].ghosts;
+
+    this->layers[k].resize(count);
+
+    if (count > 0 && !session.readParticles(owned - count, count, &this->layers[k][0])) {
+        return -1.0;
+    }
+
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Writes the layer read back from each slab over the other slab's ghosts,
+ * and adds the distance the fastest of those particles covered in the step
+ * to the estimate of how far any particle has moved since the upload
+ */
+bool CoExecution::exchange(float dt)
+{
+    float fastest = 0.0f;
+
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+
+        const vector<Particle>& layer = this->layers[k];
+
+        if (layer.empty()) {
+            continue;
+        }
+
+        if (!this->sessions[1 - k]->writeParticles(this->partitions[1 - k].owned
+                                                  ,static_cast<int>(layer.size())
+                                                  ,&layer[0])) {
+            return false;
+        }
+
+        for (auto p = layer.begin(); p != layer.end(); p++) {
+            const cl_float* v = p->vel.s;
+            fastest = max(fastest, v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        }
+    }
+
+    this->travelled += TRAVEL_SAFETY * sqrt(fastest) * dt;
+    this->residentSteps++;
+
+    return true;
+}
+
+/**
+ * Moves the shares toward the devices' measured throughputs
+ */
+void CoExecution::rebalance()
+{
+    CoExecutionPartition& first  = this->partitions[0];
+    CoExecutionPartition& second = this->partitions[1];
+
+    if (first.stepMs > 0.0 && second.stepMs > 0.0 && first.owned > 0 && second.owned > 0) {
+
+        double rate0  = first.owned / first.stepMs;
+        double rate1  = second.owned / second.stepMs;
+        float target  = static_cast<float>(rate0 / (rate0 + rate1));
+
+        first.share  += REBALANCE_SMOOTHING * (target - first.share);
+        first.share   = min(max(first.share, MIN_SHARE), 1.0f - MIN_SHARE);
+        second.share  = 1.0f - first.share;
+    }
+}
+
+/**
+ * Moves the split to the coordinate along the given axis below which the
+ * first device's share of the particles lies
+ */
+void CoExecution::placeSplit(int _axis)
+{
+    const int n = this->numParticles;
+
+    this->axis = _axis;
+    this->coordinates.resize(n);
+
+    for (int i = 0; i < n; i++) {
+        this->coordinates[i] = this->state[i].pos.s[this->axis];
+    }
+
+    int m = min(max(static_cast<int>(this->partitions[0].share * n), 0), n - 1);
+
+    nth_element(this->coordinates.begin(), this->coordinates.begin() + m, this->coordinates.end());
+
+    this->split = this->coordinates[m];
+}
+
+/**
+ * True if the slabs must be partitioned (and uploaded) again before the
+ * next step: the split should be across another axis or is outside the
+ * bounds; the particles may have moved far enough that the band no longer
+ * covers ghostWidth(); or the split is off from the shares by more than
+ * REBALANCE_THRESHOLD of the particles
+ */
+bool CoExecution::shouldPartition(int longest
+                                 ,const Bounds& bounds
+                                 ,const Parameters& parameters
+                                 ,int solverIterations) const
+{
+    if (longest != this->axis || this->split <= bounds.min[longest] || this->split >= bounds.max[longest]) {
+        return true;
+    }
+
+    if (ghostWidth(parameters, solverIterations) + this->travelled > this->bandWidth
+        || this->residentSteps >= MAX_RESIDENT_STEPS) {
+        return true;
+    }
+
+    float target = this->partitions[0].share * this->numParticles;
+
+    return fabs(target - this->partitions[0].owned) > REBALANCE_THRESHOLD * this->numParticles;
+}
+
+/**
+ * @param [in] particles The initial state
+ * @param [in] _numParticles Number of particles
+ * @param [in] _cellsPerAxis Spatial grid subdivisions per axis
+ * @param [in] bounds Bounds of the simulation
+ * @param [in] parameters Simulation parameters
+ * @param [in] dt Time step
+ * @param [in] solverIterations Solver iterations per step, which the width
+ *             of the ghost band depends on
+ */
+bool CoExecution::setup(const Particle* particles
+                       ,int _numParticles
+                       ,const int _cellsPerAxis[3]
+                       ,const Bounds& bounds
+                       ,const Parameters& parameters
+                       ,float dt
+                       ,int solverIterations)
+{
+    if (!this->isOpen() || _numParticles <= 0) {
+        return false;
+    }
+
+    this->numParticles = _numParticles;
+
+    for (int i = 0; i < 3; i++) {
+        this->cellsPerAxis[i] = _cellsPerAxis[i];
+    }
+
+    this->state.assign(particles, particles + _numParticles);
+
+    this->placeSplit(longestAxis(bounds));
+    this->partition(ghostWidth(parameters, solverIterations) + SKIN_RADII * parameters.smoothingRadius);
+
+    return this->upload(bounds, parameters, dt);
+}
+
+bool CoExecution::step(const Bounds& bounds
+                      ,const Parameters& parameters
+                      ,float dt
+                      ,int solverIterations
+                      ,const ForceFields* forceFields)
+{
+    if (!this->isOpen() || this->numParticles <= 0) {
+        return false;
+    }
+
+    // Ghosts are stepped with incomplete neighborhoods at the outer edge of
+    // the band, and the error moves toward the split as the step goes on:
+    // the densities and constraints of the particles nearest the split need
+    // their neighbors' positions within 2h, and every solver iteration
+    // pulls positions from about one more radius away. The band covers all
+    // of that, so the owned particles are stepped as on a single device.
+    // Once the particles may have moved through the skin, or the split
+    // should move, the slabs are read back and partitioned again:
+
+    int longest = longestAxis(bounds);
+
+    if (this->shouldPartition(longest, bounds, parameters, solverIterations)) {
+
+        if (!this->readParticles(&this->state[0])) {
+            cerr << "[pbf] Co-execution: couldn't read the partitions back" << endl;
+            return false;
+        }
+
+        this->placeSplit(longest);
+        this->partition(ghostWidth(parameters, solverIterations) + SKIN_RADII * parameters.smoothingRadius);
+
+        if (!this->upload(bounds, parameters, dt)) {
+            return false;
+        }
+    }
+
+    future<double> second = async(launch::async
+                                 ,&CoExecution::stepPartition
+                                 ,this
+                                 ,1
+                                 ,cref(bounds)
+                                 ,cref(parameters)
+                                 ,dt
+                                 ,solverIterations
+                                 ,forceFields);
+
+    double firstMs  = this->stepPartition(0, bounds, parameters, dt, solverIterations, forceFields);
+    double secondMs = second.get();
+
+    if (firstMs < 0.0 || secondMs < 0.0) {
+        cerr << "[pbf] Co-execution: couldn't read back a partition's boundary layer" << endl;
+        return false;
+    }
+
+    this->partitions[0].stepMs = firstMs;
+    this->partitions[1].stepMs = secondMs;
+
+    if (!this->exchange(dt)) {
+        cerr << "[pbf] Co-execution: couldn't exchange the ghosts" << endl;
+        return false;
+    }
+
+    this->rebalance();
+
+    return true;
+}
+
+/**
+ * @param [out] particles Where the owned particles of both slabs are written
+ */
+bool CoExecution::readParticles(Particle* particles)
+{
+    if (!this->isOpen()) {
+        return false;
+    }
+
+    for (int k = 0; k < NUM_PARTITIONS; k++) {
+
+        int owned = this->partitions[k].owned;
+
+        if (owned == 0) {
+            continue;
+        }
+
+        if (!this->sessions[k]->readParticles(0, owned, &this->local[k][0])) {
+            return false;
+        }
+
+        for (int i = 0; i < owned; i++) {
+            particles[this->indices[k][i]] = this->local[k][i];
+        }
+    }
+
+    return true;
+}
+
+}
+
+/******************************************************************************/
@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * CoExecution.h
+ * - Steps one particle state on two OpenCL devices at once (typically the
+ *   GPU and the CPU), each simulating a slab of the domain plus a boundary
+ *   layer copied from the other. The slabs stay on their devices between
+ *   steps, and the slab boundary follows the measured step times of the
+ *   devices, so both finish their part of a step together
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_CO_EXECUTION_H
+#define PBF_LIB_CO_EXECUTION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Session.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * One of the two devices, and how its part of the last step went
+ */
+typedef struct {
+
+    std::string name;
+
+    bool gpu;
+
+    int owned;                        // Particles stepped and kept
+
+    int ghosts;                       // Boundary layer from the other slab
+
+    double stepMs;                    // Step, and read back of the layer
+                                      // the other slab takes as ghosts
+
+    float share;                      // Share of the particles the split
+                                      // currently aims to give the device
+
+} CoExecutionPartition;
+
+/**
+ * The domain is split by a plane across its longest axis. On setup(), and
+ * whenever the plane moves:
+ *
+ *   1. Every particle goes to the slab its position is in, and particles
+ *      within ghostWidth() plus a skin of the plane are also copied to the
+ *      other slab as ghosts, so the particles a slab owns see every
+ *      neighbor that affects them during a step, through all solver
+ *      iterations
+ *   2. Each slab is uploaded to its device, with the particles the other
+ *      slab takes as ghosts at the end of its owned range
+ *
+ * Then each step:
+ *
+ *   1. Both slabs are stepped at the same time, each on its own device,
+ *      through a resident headless Session
+ *   2. The end of each slab's owned range is read back and written over
+ *      the other slab's ghosts; nothing else leaves the devices
+ *   3. The devices' shares move toward the ratio of their measured
+ *      throughputs
+ *
+ * The plane only moves, and the slabs are only read back and uploaded
+ * again, when the particles may have moved further than the skin since the
+ * last upload, or when the shares ask for a split that differs from the
+ * current one by more than a few percent of the particles.
+ *
+ * All exchanges go through the host, since the devices usually don't share
+ * a context (or even a platform)
+ */
+class CoExecution
+{
+    private:
+        std::string dataPath;
+
+        std::shared_ptr<Session> sessions[2];
+
+        // Sub-devices created by device fission, if it was used
+        std::vector<cl_device_id> subDevices;
+
+        CoExecutionPartition partitions[2];
+
+        // The split plane: coordinate along axis
+        int axis;
+        float split;
+
+        int numParticles;
+
+        int cellsPerAxis[3];
+
+        // All particles, in the caller's order, as of the last read back
+        std::vector<Particle> state;
+
+        // Per slab: local particles for uploads and read backs (owned
+        // first, then ghosts), and the index of each owned one in the
+        // caller's array
+        std::vector<Particle> local[2];
+        std::vector<int> indices[2];
+
+        // Per slab: the end of the owned range, as read back after a step
+        std::vector<Particle> layers[2];
+
+        // How far a particle may have moved since the last upload (from the
+        // fastest particle exchanged in each step), the width of the band
+        // the ghosts were taken from, and the steps taken since
+        float travelled;
+        float bandWidth;
+        int residentSteps;
+
+        // Scratch space for finding the split
+        std::vector<float> coordinates;
+
+        // Non-copyable
+        CoExecution(const CoExecution&);
+        CoExecution& operator=(const CoExecution&);
+
+        bool openSubDevices(cl_device_id device);
+
+        void partition(float width);
+
+        bool upload(const Bounds& bounds, const Parameters& parameters, float dt);
+
+        double stepPartition(int k
+                            ,const Bounds& bounds
+                            ,const Parameters& parameters
+                            ,float dt
+                            ,int solverIterations
+                            ,const ForceFields* forceFields);
+
+        bool exchange(float dt);
+
+        void rebalance();
+
+        void placeSplit(int axis);
+
+        bool shouldPartition(int axis
+                            ,const Bounds& bounds
+                            ,const Parameters& parameters
+                            ,int solverIterations) const;
+
+    public:
+        static const int NUM_PARTITIONS = 2;
+
+        CoExecution(const std::string& dataPath);
+
+        virtual ~CoExecution();
+
+        /**
+         * Picks the devices: the first GPU and the first CPU if there are
+         * both; otherwise the first two devices found (e.g. on two CPU
+         * platforms); otherwise the only device, split in two by device
+         * fission (cl_ext_device_fission). Returns false if none of these
+         * is possible
+         *
+         * @param [in] types Only devices of these types are considered,
+         *             e.g. CL_DEVICE_TYPE_CPU to co-execute on two CPUs
+         */
+        bool open(cl_device_type types = CL_DEVICE_TYPE_ALL);
+
+        // Uses the given devices
+        bool open(cl_device_id first, cl_device_id second);
+
+        void close();
+
+        bool isOpen() const { return this->sessions[0] && this->sessions[1]; }
+
+        /**
+         * Splits the particles between the devices and uploads them. Can be
+         * called again to start over from another state
+         */
+        bool setup(const Particle* particles
+                  ,int numParticles
+                  ,const int cellsPerAxis[3]
+                  ,const Bounds& bounds
+                  ,const Parameters& parameters
+                  ,float dt
+                  ,int solverIterations);
+
+        /**
+         * Steps the particles on the devices. Blocks until both devices are
+         * done
+         *
+         * @param [in] forceFields If given, the fields every device applies
+         */
+        bool step(const Bounds& bounds
+                 ,const Parameters& parameters
+                 ,float dt
+                 ,int solverIterations
+                 ,const ForceFields* forceFields = NULL);
+
+        /**
+         * Reads the owned particles back from both devices, in the order
+         * they were passed to setup()
+         *
+         * @param [out] particles getNumberOfParticles() particles
+         */
+        bool readParticles(Particle* particles);
+
+        int getNumberOfParticles() const { return this->numParticles; }
+
+        /**
+         * Width of the band of ghosts on either side of the split: 2h, plus
+         * h per solver iteration, with h the smoothing radius. Uploads add
+         * a skin to it, so the band still covers the neighborhoods after
+         * the particles have moved for a few steps
+         */
+        static float ghostWidth(const Parameters& parameters, int solverIterations);
+
+        const CoExecutionPartition& getPartition(int k) const { return this->partitions[k]; }
+
+        // The device stepping partition k; NULL if not open
+        cl_device_id getDevice(int k) const { return this->sessions[k] ? this->sessions[k]->getDevice() : NULL; }
+
+        int getAxis() const    { return this->axis; }
+        float getSplit() const { return this->split; }
+};
+
+}
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,494 @@
+/*******************************************************************************
+ * Ensemble.cpp
+ * - Runs parameter sweeps over all OpenCL devices with work-stealing worker
+ *   threads
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "Ensemble.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+namespace {
+
+double millisecondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+template <typename T>
+bool readValues(istringstream& line, vector<T>& values)
+{
+    values.clear();
+
+    T value;
+
+    while (line >> value) {
+        values.push_back(value);
+    }
+
+    return !values.empty();
+}
+
+}
+
+/*******************************************************************************
+ * SweepSpec
+ ******************************************************************************/
+
+SweepSpec::SweepSpec() :
+    dt(0.033f),
+    steps(100),
+    solverIterations(3),
+    seed(1)
+{
+    Parameters defaults;
+
+    this->particleCounts.push_back(4096);
+    this->particleRadius.push_back(defaults.particleRadius);
+    this->smoothingRadius.push_back(defaults.smoothingRadius);
+    this->relaxation.push_back(defaults.relaxation);
+    this->artificialPressureK.push_back(defaults.artificialPressureK);
+    this->artificialPressureN.push_back(defaults.artificialPressureN);
+    this->vorticityEpsilon.push_back(defaults.vorticityEpsilon);
+    this->viscosityCoeff.push_back(defaults.viscosityCoeff);
+
+    for (int i = 0; i < 3; i++) {
+        this->bounds.min[i] = 0.0f;
+        this->bounds.max[i] = 20.0f;
+    }
+}
+
+/**
+ * Reads a sweep specification. Each line is "name = value [value ...]", and
+ * '#' starts a comment, e.g.
+ *
+ *   particles           = 4096 16384
+ *   bounds              = 0 0 0 20 20 20
+ *   steps               = 200
+ *   relaxation          = 0.001 0.0033 0.01
+ *   vorticityEpsilon    = 0 0.1 0.2
+ *
+ * Parameters that aren't given keep their single default value
+ *
+ * @param [in] filename Path to the specification
+ */
+bool SweepSpec::load(const string& filename)
+{
+    ifstream file(filename.c_str());
+
+    if (!file.is_open()) {
+        cerr << "[pbf] Couldn't open sweep specification: " << filename << endl;
+        return false;
+    }
+
+    string text;
+    int lineNumber = 0;
+
+    while (getline(file, text)) {
+
+        lineNumber++;
+
+        size_t comment = text.find('#');
+
+        if (comment != string::npos) {
+            text.erase(comment);
+        }
+
+        size_t equals = text.find('=');
+
+        if (equals == string::npos) {
+            if (text.find_first_not_of(" \t\r") != string::npos) {
+                cerr << "[pbf] " << filename << ":" << lineNumber << ": expected name = values" << endl;
+                return false;
+            }
+            continue;
+        }
+
+        string name;
+        istringstream(text.substr(0, equals)) >> name;
+        istringstream values(text.substr(equals + 1));
+
+        vector<float> floats;
+        vector<int> ints;
+        bool ok = true;
+
+        if (name == "particles") {
+            ok = readValues(values, this->particleCounts);
+        } else if (name == "bounds") {
+            ok = readValues(values, floats) && floats.size() == 6;
+            if (ok) {
+                copy(floats.begin(), floats.begin() + 3, this->bounds.min);
+                copy(floats.begin() + 3, floats.end(), this->bounds.max);
+            }
+        } else if (name == "dt") {
+            ok = readValues(values, floats) && floats.size() == 1;
+            this->dt = ok ? floats[0] : this->dt;
+        } else if (name == "steps") {
+            ok = readValues(values, ints) && ints.size() == 1;
+            this->steps = ok ? ints[0] : this->steps;
+        } else if (name == "iterations") {
+            ok = readValues(values, ints) && ints.size() == 1;
+            this->solverIterations = ok ? ints[0] : this->solverIterations;
+        } else if (name == "seed") {
+            ok = readValues(values, ints) && ints.size() == 1;
+            this->seed = ok ? static_cast<unsigned int>(ints[0]) : this->seed;
+        } else if (name == "particleRadius") {
+            ok = readValues(values, this->particleRadius);
+        } else if (name == "smoothingRadius") {
+            ok = readValues(values, this->smoothingRadius);
+        } else if (name == "relaxation") {
+            ok = readValues(values, this->relaxation);
+        } else if (name == "artificialPressureK") {
+            ok = readValues(values, this->artificialPressureK);
+        } else if (name == "artificialPressureN") {
+            ok = readValues(values, this->artificialPressureN);
+        } else if (name == "vorticityEpsilon") {
+            ok = readValues(values, this->vorticityEpsilon);
+        } else if (name == "viscosityCoeff") {
+            ok = readValues(values, this->viscosityCoeff);
+        } else {
+            cerr << "[pbf] " << filename << ":" << lineNumber << ": unknown setting " << name << endl;
+            return false;
+        }
+
+        if (!ok) {
+            cerr << "[pbf] " << filename << ":" << lineNumber << ": bad values for " << name << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * Ensemble
+ ******************************************************************************/
+
+/**
+ * Creates a worker session on every OpenCL device of every platform
+ *
+ * @param [in] dataPath Directory containing kernels/
+ * @param [in] cpuWorkers Number of workers given to each CPU device
+ */
+Ensemble::Ensemble(const string& dataPath, int cpuWorkers)
+{
+    cl_uint numPlatforms = 0;
+
+    clGetPlatformIDs(0, NULL, &numPlatforms);
+
+    vector<cl_platform_id> platforms(numPlatforms);
+
+    if (numPlatforms > 0) {
+        clGetPlatformIDs(numPlatforms, &platforms[0], NULL);
+    }
+
+    for (cl_uint p = 0; p < numPlatforms; p++) {
+
+        cl_uint numDevices = 0;
+
+        clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices);
+
+        vector<cl_device_id> devices(numDevices);
+
+        if (numDevices > 0) {
+            clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, numDevices, &devices[0], NULL);
+        }
+
+        for (cl_uint d = 0; d < numDevices; d++) {
+
+            cl_device_type type = 0;
+
+            clGetDeviceInfo(devices[d], CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+
+            int count = (type & CL_DEVICE_TYPE_CPU) ? max(cpuWorkers, 1) : 1;
+
+            for (int i = 0; i < count; i++) {
+
+                shared_ptr<Worker> worker(new Worker());
+
+                worker->session = shared_ptr<Session>(new Session(dataPath, p, d));
+
+                if (!worker->session->isLoaded()) {
+                    cerr << "[pbf] Skipping device " << worker->session->getDeviceName() << endl;
+                    continue;
+                }
+
+                this->workers.push_back(worker);
+            }
+        }
+    }
+}
+
+Ensemble::~Ensemble()
+{
+
+}
+
+/**
+ * Expands a sweep into the Cartesian product of its values
+ *
+ * @param [in] spec The sweep
+ */
+vector<EnsembleRun> Ensemble::expand(const SweepSpec& spec)
+{
+    const vector<float>* axes[] = { &spec.particleRadius
+                                  , &spec.smoothingRadius
+                                  , &spec.relaxation
+                                  , &spec.artificialPressureK
+                                  , &spec.artificialPressureN
+                                  , &spec.vorticityEpsilon
+                                  , &spec.viscosityCoeff };
+    const int numAxes = 7;
+
+    size_t combinations = spec.particleCounts.size();
+
+    for (int a = 0; a < numAxes; a++) {
+        combinations *= axes[a]->size();
+    }
+
+    vector<EnsembleRun> runs(combinations);
+
+    for (size_t i = 0; i < combinations; i++) {
+
+        // Decode i as a mixed radix number, one digit per axis:
+
+        size_t remainder = i;
+        float values[numAxes];
+
+        for (int a = numAxes - 1; a >= 0; a--) {
+            values[a]  = (*axes[a])[remainder % axes[a]->size()];
+            remainder /= axes[a]->size();
+        }
+
+        runs[i].index        = static_cast<int>(i);
+        runs[i].numParticles = spec.particleCounts[remainder];
+        runs[i].parameters   = Parameters(values[0], values[1], values[2], values[3], values[4], values[5], values[6]);
+    }
+
+    return runs;
+}
+
+/**
+ * Takes the next run for a worker: the front of its own queue, or failing
+ * that, the back of another worker's
+ *
+ * @param [in] worker Index of the worker
+ * @param [out] run Index of the run to do
+ */
+bool Ensemble::nextRun(int worker, int& run)
+{
+    int numWorkers = this->getNumberOfWorkers();
+
+    for (int k = 0; k < numWorkers; k++) {
+
+        Worker& victim = *this->workers[(worker + k) % numWorkers];
+
+        lock_guard<mutex> guard(victim.lock);
+
+        if (victim.queue.empty()) {
+            continue;
+        }
+
+        if (k == 0) {
+            run = victim.queue.front();
+            victim.queue.pop_front();
+        } else {
+            run = victim.queue.back();
+            victim.queue.pop_back();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Worker thread body: simulates runs until there are none left anywhere
+ */
+void Ensemble::work(int worker
+                   ,const SweepSpec& spec
+                   ,const vector<EnsembleRun>& runs
+                   ,vector<EnsembleResult>& results)
+{
+    Session& session = *this->workers[worker]->session;
+
+    vector<Particle> initialState;
+    int initialCount    = -1;
+    float initialRadius = -1.0f;
+    int index           = 0;
+
+    while (this->nextRun(worker, index)) {
+
+        const EnsembleRun& run = runs[index];
+        EnsembleResult& result = results[index];
+
+        result.device = session.getDeviceName();
+        result.worker = worker;
+
+        if (run.numParticles != initialCount || run.parameters.particleRadius != initialRadius) {
+            Session::randomParticles(initialState, run.numParticles, spec.bounds, run.parameters.particleRadius, spec.seed);
+            initialCount  = run.numParticles;
+            initialRadius = run.parameters.particleRadius;
+        }
+
+        int cells[3];
+        Session::idealCellsPerAxis(spec.bounds, run.parameters.particleRadius, 2, cells);
+
+        auto start = chrono::steady_clock::now();
+
+        if (!session.setup(&initialState[0], run.numParticles, cells, spec.bounds, run.parameters, spec.dt)) {
+            continue;
+        }
+
+        session.setSolverIterations(spec.solverIterations);
+
+        result.setupMs       = millisecondsSince(start);
+        result.reusedBuffers = session.reusedBuffers();
+
+        start = chrono::steady_clock::now();
+
+        session.step(spec.steps);
+
+        result.msPerStep = millisecondsSince(start) / max(spec.steps, 1);
+
+        // Metrics of the final state, read straight from the mapped buffers:
+
+        SessionStatistics stats = session.getStatistics();
+
+        result.meanDensity = stats.meanDensity;
+        result.maxDensity  = stats.maxDensity;
+        result.meanSpeed   = stats.meanSpeed;
+        result.maxSpeed    = stats.maxSpeed;
+        result.completed   = true;
+    }
+}
+
+/**
+ * Simulates every run of a sweep
+ *
+ * @param [in] spec The sweep
+ * @param [out] results One result per run, in the order of expand(spec)
+ */
+bool Ensemble::run(const SweepSpec& spec, vector<EnsembleResult>& results)
+{
+    vector<EnsembleRun> runs = Ensemble::expand(spec);
+
+    results.assign(runs.size(), EnsembleResult());
+
+    for (size_t i = 0; i < runs.size(); i++) {
+        results[i].run       = runs[i];
+        results[i].completed = false;
+        results[i].worker    = -1;
+    }
+
+    int numWorkers = this->getNumberOfWorkers();
+
+    if (numWorkers == 0) {
+        cerr << "[pbf] No OpenCL device could run the ensemble" << endl;
+        return false;
+    }
+
+    // Deal the runs out by size, so workers mostly keep their buffers:
+
+    vector<int> order(runs.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<int>(i);
+    }
+
+    stable_sort(order.begin(), order.end(), [&runs](int a, int b) {
+        return runs[a].numParticles < runs[b].numParticles;
+    });
+
+    size_t block = (order.size() + numWorkers - 1) / numWorkers;
+
+    for (size_t i = 0; i < order.size(); i++) {
+        this->workers[i / block]->queue.push_back(order[i]);
+    }
+
+    vector<thread> threads;
+
+    for (int w = 0; w < numWorkers; w++) {
+        threads.push_back(thread(&Ensemble::work, this, w, cref(spec), cref(runs), ref(results)));
+    }
+
+    for (size_t w = 0; w < threads.size(); w++) {
+        threads[w].join();
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+        if (!results[i].completed) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Writes a results table as comma-separated values
+ *
+ * @param [in] filename Path of the file to write
+ * @param [in] results The results of Ensemble::run()
+ */
+bool Ensemble::writeResults(const string& filename, const vector<EnsembleResult>& results)
+{
+    ofstream file(filename.c_str());
+
+    if (!file.is_open()) {
+        cerr << "[pbf] Couldn't write ensemble results to " << filename << endl;
+        return false;
+    }
+
+    file << "run,particles,particleRadius,smoothingRadius,relaxation,artificialPressureK,"
+         << "artificialPressureN,vorticityEpsilon,viscosityCoeff,completed,device,worker,"
+         << "reusedBuffers,setupMs,msPerStep,meanDensity,maxDensity,meanSpeed,maxSpeed" << endl;
+
+    for (size_t i = 0; i < results.size(); i++) {
+
+        const EnsembleResult& r = results[i];
+        const Parameters& p     = r.run.parameters;
+
+        file << r.run.index          << ","
+             << r.run.numParticles   << ","
+             << p.particleRadius     << ","
+             << p.smoothingRadius    << ","
+             << p.relaxation         << ","
+             << p.artificialPressureK << ","
+             << p.artificialPressureN << ","
+             << p.vorticityEpsilon   << ","
+             << p.viscosityCoeff     << ","
+             << (r.completed ? 1 : 0) << ","
+             << "\"" << r.device << "\","
+             << r.worker             << ","
+             << (r.reusedBuffers ? 1 : 0) << ","
+             << r.setupMs            << ","
+             << r.msPerStep          << ","
+             << r.meanDensity        << ","
+             << r.maxDensity         << ","
+             << r.meanSpeed          << ","
+             << r.maxSpeed           << endl;
+    }
+
+    return true;
+}
+
+}
+
+/******************************************************************************/
@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * Ensemble.h
+ * - Runs parameter sweeps: every combination of the swept parameters is
+ *   simulated headlessly, with the runs spread over all OpenCL devices by
+ *   work-stealing worker threads, and the per-run metrics are gathered into
+ *   one results table
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_ENSEMBLE_H
+#define PBF_LIB_ENSEMBLE_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Session.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * What to sweep. Every parameter has a list of values, and one run is made
+ * for each combination (the Cartesian product) of them and of the particle
+ * counts. Loaded from a text file of "name = value [value ...]" lines; see
+ * SweepSpec::load()
+ */
+struct SweepSpec
+{
+    std::vector<int> particleCounts;
+
+    std::vector<float> particleRadius;
+    std::vector<float> smoothingRadius;
+    std::vector<float> relaxation;
+    std::vector<float> artificialPressureK;
+    std::vector<float> artificialPressureN;
+    std::vector<float> vorticityEpsilon;
+    std::vector<float> viscosityCoeff;
+
+    Bounds bounds;
+
+    float dt;
+
+    int steps;
+
+    int solverIterations;
+
+    // Seed of the random initial particle positions; the same for every run
+    // of a given particle count
+    unsigned int seed;
+
+    SweepSpec();
+
+    bool load(const std::string& filename);
+};
+
+// A single combination of a sweep
+
+typedef struct {
+
+    int index;
+
+    int numParticles;
+
+    Parameters parameters;
+
+} EnsembleRun;
+
+// Metrics gathered from a run
+
+typedef struct {
+
+    EnsembleRun run;
+
+    bool completed;
+
+    std::string device;
+
+    int worker;
+
+    // Whether the worker's buffers from a previous run were reused
+    bool reusedBuffers;
+
+    double setupMs;
+
+    double msPerStep;
+
+    float meanDensity;
+    float maxDensity;
+
+    float meanSpeed;
+    float maxSpeed;
+
+} EnsembleResult;
+
+/******************************************************************************/
+
+/**
+ * Keeps one headless session per worker. Every OpenCL device gets a worker;
+ * CPU devices can get more than one (cpuWorkers), for when the CPU runtime
+ * doesn't keep all cores busy with a single queue. Sessions outlive a sweep,
+ * so programs are compiled once per worker and buffers are reused between
+ * runs of the same size
+ *
+ * Runs are sorted by particle count and dealt out to the workers in
+ * contiguous blocks, so each worker mostly sees a single size. A worker that
+ * runs out of work steals from the back of another worker's queue
+ */
+class Ensemble
+{
+    private:
+        typedef struct {
+
+            std::shared_ptr<Session> session;
+
+            std::deque<int> queue;
+
+            std::mutex lock;
+
+        } Worker;
+
+        std::vector<std::shared_ptr<Worker> > workers;
+
+        // Non-copyable
+        Ensemble(const Ensemble&);
+        Ensemble& operator=(const Ensemble&);
+
+        bool nextRun(int worker, int& run);
+
+        void work(int worker
+                 ,const SweepSpec& spec
+                 ,const std::vector<EnsembleRun>& runs
+                 ,std::vector<EnsembleResult>& results);
+
+    public:
+        Ensemble(const std::string& dataPath, int cpuWorkers = 1);
+
+        virtual ~Ensemble();
+
+        int getNumberOfWorkers() const { return static_cast<int>(this->workers.size()); }
+
+        // Expands a sweep into its runs
+        static std::vector<EnsembleRun> expand(const SweepSpec& spec);
+
+        /**
+         * Simulates every run of the sweep; blocks until all are done.
+         * results is indexed like expand(spec)
+         */
+        bool run(const SweepSpec& spec, std::vector<EnsembleResult>& results);
+
+        // Writes results as comma-separated values, one row per run
+        static bool writeResults(const std::string& filename, const std::vector<EnsembleResult>& results);
+};
+
+}
+
+/******************************************************************************/
+
+#endif
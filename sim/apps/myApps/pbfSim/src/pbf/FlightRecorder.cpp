@@ -0,0 +1,222 @@
+/*******************************************************************************
+ * FlightRecorder.cpp
+ * - Keeps the frame, step and per-stage timings of the last few seconds in
+ *   a ring, which can be dumped to disk when something goes wrong (e.g. a
+ *   frame time spike), so the spike can be diagnosed after the fact. Dumps
+ *   are written on a background thread
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "FlightRecorder.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * Allocates the ring up front; recording never allocates, except when a
+ * stage is seen for the first time
+ *
+ * @param [in] capacity Number of frames kept
+ */
+FlightRecorder::FlightRecorder(int capacity) :
+    records(max(capacity, 1)),
+    next(0),
+    size(0),
+    recorded(0),
+    lastDump(0),
+    dumps(0),
+    stopping(false)
+{
+    this->stages.reserve(MAX_STAGES);
+}
+
+/**
+ * Waits for the pending dumps to be written
+ */
+FlightRecorder::~FlightRecorder()
+{
+    {
+        lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+
+    this->ready.notify_all();
+
+    if (this->writer.joinable()) {
+        this->writer.join();
+    }
+}
+
+/**
+ * Returns the column of a stage, adding it if it's new. Returns -1 once
+ * MAX_STAGES stages are known
+ */
+int FlightRecorder::stageIndex(const string& stage)
+{
+    for (size_t i = 0; i < this->stages.size(); i++) {
+        if (this->stages[i] == stage) {
+            return static_cast<int>(i);
+        }
+    }
+
+    if (this->stages.size() >= static_cast<size_t>(MAX_STAGES)) {
+        return -1;
+    }
+
+    this->stages.push_back(stage);
+
+    return static_cast<int>(this->stages.size()) - 1;
+}
+
+void FlightRecorder::record(unsigned int frame
+                           ,double time
+                           ,float frameMs
+                           ,float stepMs
+                           ,const vector<StageTiming>& timings
+                           ,bool measured)
+{
+    FlightRecord& record = this->records[this->next];
+
+    record.frame    = frame;
+    record.time     = time;
+    record.frameMs  = frameMs;
+    record.stepMs   = stepMs;
+    record.measured = measured;
+
+    memset(record.stageMs, 0, sizeof(record.stageMs));
+
+    for (size_t i = 0; i < timings.size(); i++) {
+
+        int index = this->stageIndex(timings[i].name);
+
+        if (index >= 0) {
+            record.stageMs[index] = static_cast<float>(timings[i].ms);
+        }
+    }
+
+    this->next = (this->next + 1) % this->records.size();
+    this->size = min(this->size + 1, this->records.size());
+    this->recorded++;
+}
+
+/**
+ * Copies the ring for the writer thread. The copy is the only work done on
+ * the caller's thread
+ *
+ * @param [in] filename Path of the CSV file to write
+ */
+bool FlightRecorder::dump(const string& filename)
+{
+    shared_ptr<FlightRecording> recording(new FlightRecording());
+
+    recording->filename = filename;
+    recording->stages   = this->stages;
+    recording->records.reserve(this->size);
+
+    size_t capacity = this->records.size();
+    size_t first    = (this->next + capacity - this->size) % capacity;
+
+    for (size_t i = 0; i < this->size; i++) {
+        recording->records.push_back(this->records[(first + i) % capacity]);
+    }
+
+    {
+        lock_guard<std::mutex> lock(this->mutex);
+
+        if (this->pending.size() >= static_cast<size_t>(MAX_PENDING_DUMPS)) {
+            return false;
+        }
+
+        this->pending.push_back(recording);
+
+        if (!this->writer.joinable()) {
+            this->writer = thread(&FlightRecorder::writeRecordings, this);
+        }
+    }
+
+    this->ready.notify_one();
+
+    this->lastDump = this->recorded;
+    this->dumps++;
+
+    return true;
+}
+
+/**
+ * Writer thread: writes the pending dumps in order until the recorder is
+ * destroyed and nothing is left
+ */
+void FlightRecorder::writeRecordings()
+{
+    while (true) {
+
+        shared_ptr<FlightRecording> recording;
+
+        {
+            unique_lock<std::mutex> lock(this->mutex);
+
+            while (this->pending.empty() && !this->stopping) {
+                this->ready.wait(lock);
+            }
+
+            if (this->pending.empty()) {
+                return;
+            }
+
+            recording = this->pending.front();
+            this->pending.pop_front();
+        }
+
+        write(*recording);
+    }
+}
+
+bool FlightRecorder::write(const FlightRecording& recording)
+{
+    ofstream out(recording.filename.c_str());
+
+    if (!out) {
+        cerr << "[pbf] Couldn't write flight recording " << recording.filename << endl;
+        return false;
+    }
+
+    out << "frame,time,frame_ms,step_ms";
+
+    for (size_t s = 0; s < recording.stages.size(); s++) {
+        out << "," << recording.stages[s];
+    }
+
+    out << "\n";
+
+    for (auto record = recording.records.begin(); record != recording.records.end(); record++) {
+
+        out << record->frame << "," << record->time << "," << record->frameMs << "," << record->stepMs;
+
+        for (size_t s = 0; s < recording.stages.size(); s++) {
+            if (record->measured) {
+                out << "," << record->stageMs[s];
+            } else {
+                out << ",not measured";
+            }
+        }
+
+        out << "\n";
+    }
+
+    return true;
+}
+
+}
+
+/******************************************************************************/
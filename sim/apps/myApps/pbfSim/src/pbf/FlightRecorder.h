@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * FlightRecorder.h
+ * - Keeps the frame, step and per-stage timings of the last few seconds in
+ *   a ring, which can be dumped to disk when something goes wrong (e.g. a
+ *   frame time spike), so the spike can be diagnosed after the fact. Dumps
+ *   are written on a background thread
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_FLIGHT_RECORDER_H
+#define PBF_LIB_FLIGHT_RECORDER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Solver.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * Timings of one frame. Stage times are indexed like
+ * FlightRecorder::getStages(); stages that didn't run are 0
+ */
+typedef struct {
+
+    unsigned int frame;
+
+    double time;          // Seconds, on the caller's clock
+
+    float frameMs;
+
+    float stepMs;         // 0 if the frame didn't step
+
+    bool measured;        // False if the frame stepped without stage
+                          // timings (profiling off); stageMs is all 0
+
+    float stageMs[32];
+
+} FlightRecord;
+
+// A copy of the ring, oldest frame first, as handed to the writer thread
+
+typedef struct {
+
+    std::string filename;
+
+    std::vector<std::string> stages;
+
+    std::vector<FlightRecord> records;
+
+} FlightRecording;
+
+class FlightRecorder
+{
+    public:
+        static const int MAX_STAGES = 32;
+
+    private:
+        std::vector<FlightRecord> records;
+
+        // Slot the next record goes to, and the number of records kept
+        size_t next;
+        size_t size;
+
+        // Stage names, in the order first seen
+        std::vector<std::string> stages;
+
+        unsigned long long recorded;
+
+        // Value of recorded at the last dump
+        unsigned long long lastDump;
+
+        int dumps;
+
+        // Dumps waiting to be written; the writer thread is started by the
+        // first dump and drains the queue before the recorder is destroyed
+        std::deque<std::shared_ptr<FlightRecording> > pending;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::thread writer;
+        bool stopping;
+
+        // Non-copyable
+        FlightRecorder(const FlightRecorder&);
+        FlightRecorder& operator=(const FlightRecorder&);
+
+        int stageIndex(const std::string& stage);
+
+        void writeRecordings();
+
+        static bool write(const FlightRecording& recording);
+
+    public:
+        // Dumps are dropped rather than queued past this many pending writes
+        static const int MAX_PENDING_DUMPS = 4;
+
+        FlightRecorder(int capacity);
+
+        virtual ~FlightRecorder();
+
+        int getCapacity() const { return static_cast<int>(this->records.size()); }
+
+        /**
+         * Adds a frame, overwriting the oldest one once the ring is full
+         *
+         * @param [in] frame Frame number
+         * @param [in] time Time of the frame, in seconds
+         * @param [in] frameMs Duration of the frame
+         * @param [in] stepMs Duration of the simulation step, or 0
+         * @param [in] timings Per-stage device times of the step, if any
+         * @param [in] measured False if the frame stepped but its stages
+         *             weren't timed (e.g. profiling was off)
+         */
+        void record(unsigned int frame
+                   ,double time
+                   ,float frameMs
+                   ,float stepMs
+                   ,const std::vector<StageTiming>& timings
+                   ,bool measured = true);
+
+        const std::vector<std::string>& getStages() const { return this->stages; }
+
+        // Frames recorded since the last dump (or since the start)
+        unsigned long long getFramesSinceDump() const { return this->recorded - this->lastDump; }
+
+        int getDumpCount() const { return this->dumps; }
+
+        /**
+         * Copies the frames in the ring, oldest first, and hands them to the
+         * writer thread, which writes them as CSV: frame, time, frame_ms,
+         * step_ms and one column per stage ("not measured" for frames whose
+         * stages weren't timed). Returns false if the copy was dropped
+         * because MAX_PENDING_DUMPS dumps are still waiting
+         */
+        bool dump(const std::string& filename);
+};
+
+}
+
+/******************************************************************************/
+
+#endif
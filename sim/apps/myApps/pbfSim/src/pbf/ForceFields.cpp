@@ -0,0 +1,269 @@
+/*******************************************************************************
+ * ForceFields.cpp
+ * - Analytic external force fields: gravity, wind, attractors, vortices and
+ *   drag volumes, described by a few floats each and evaluated per particle
+ *   on the device as the positions are predicted. See kernels/Forces.cl
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <cstring>
+#include <iostream>
+#include "ForceFields.h"
+#include "Solver.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+const int ForceFields::MAX_FIELDS;
+
+/**
+ * Returns a descriptor of the given type, zeroed otherwise
+ */
+static ForceField makeField(ForceFieldType type, float strength, float radius)
+{
+    ForceField field;
+
+    memset(&field, 0, sizeof(ForceField));
+
+    field.type     = type;
+    field.strength = strength;
+    field.radius   = radius;
+
+    return field;
+}
+
+static void setFloat3(cl_float4& target, const float value[3])
+{
+    target.s[0] = value[0];
+    target.s[1] = value[1];
+    target.s[2] = value[2];
+    target.s[3] = 0.0f;
+}
+
+/**
+ * Uniform acceleration strength * direction
+ */
+ForceField gravityField(const float direction[3], float strength)
+{
+    ForceField field = makeField(FORCE_GRAVITY, strength, 0.0f);
+
+    setFloat3(field.direction, direction);
+
+    return field;
+}
+
+/**
+ * Pulls particle velocities toward velocity at the given rate (1/s), within
+ * radius of center (everywhere if radius <= 0)
+ */
+ForceField windField(const float velocity[3], float rate, const float center[3], float radius)
+{
+    ForceField field = makeField(FORCE_WIND, rate, radius);
+
+    setFloat3(field.direction, velocity);
+    setFloat3(field.position, center);
+
+    return field;
+}
+
+/**
+ * Acceleration of strength toward position, falling off linearly to zero at
+ * radius (constant if radius <= 0)
+ */
+ForceField attractorField(const float position[3], float strength, float radius)
+{
+    ForceField field = makeField(FORCE_ATTRACTOR, strength, radius);
+
+    setFloat3(field.position, position);
+
+    return field;
+}
+
+/**
+ * Acceleration of strength around the axis through position, counter-
+ * clockwise looking down the axis, falling off linearly to zero at radius
+ * from the axis
+ */
+ForceField vortexField(const float position[3], const float axis[3], float strength, float radius)
+{
+    ForceField field = makeField(FORCE_VORTEX, strength, radius);
+
+    setFloat3(field.position, position);
+    setFloat3(field.direction, axis);
+
+    return field;
+}
+
+/**
+ * Linear drag of strength (1/s) inside the box center +/- halfExtent
+ */
+ForceField dragField(const float center[3], const float halfExtent[3], float strength)
+{
+    ForceField field = makeField(FORCE_DRAG, strength, 0.0f);
+
+    setFloat3(field.position, center);
+    setFloat3(field.extent, halfExtent);
+
+    return field;
+}
+
+/******************************************************************************/
+
+/**
+ * Builds kernels/Forces.cl and allocates the constant buffer of fields
+ *
+ * @param [in] context OpenCL context the solver's buffers belong to
+ * @param [in] device Device the kernels are built for
+ * @param [in] _queue Queue all work is enqueued on
+ * @param [in] dataPath Directory containing kernels/Forces.cl
+ */
+ForceFields::ForceFields(cl_context context
+                        ,cl_device_id device
+                        ,cl_command_queue _queue
+                        ,const string& dataPath) :
+    queue(_queue),
+    program(context, device),
+    predictKernel(NULL),
+    buffer(NULL),
+    dirty(false),
+    numParticles(0),
+    events(NULL)
+{
+    this->fields.reserve(MAX_FIELDS);
+
+    if (!this->program.loadKernelFile("kernels/Forces.cl", dataPath)) {
+        return;
+    }
+
+    this->predictKernel = this->program.kernel("predictPositionInFields");
+
+    cl_int err = CL_SUCCESS;
+
+    this->buffer = clCreateBuffer(context, CL_MEM_READ_ONLY, MAX_FIELDS * sizeof(ForceField), NULL, &err);
+
+    if (!checkError(err, "clCreateBuffer (force fields)")) {
+        this->buffer = NULL;
+        return;
+    }
+
+    setArg(this->predictKernel, 3, this->buffer);
+}
+
+ForceFields::~ForceFields()
+{
+    if (this->buffer != NULL) {
+        clReleaseMemObject(this->buffer);
+    }
+}
+
+/**
+ * Binds the particles the fields act on
+ *
+ * @param [in] b The solver's effective buffers
+ * @param [in] _numParticles Number of particles
+ */
+void ForceFields::bind(const DeviceBuffers& b, int _numParticles)
+{
+    if (!this->isLoaded()) {
+        return;
+    }
+
+    this->numParticles = _numParticles;
+
+    // KERNEL :: predictPositionInFields (the time step, argument 2, and the
+    // field count, argument 4, are set per run)
+
+    setArg(this->predictKernel, 0, b.particles);
+    setArg(this->predictKernel, 1, this->numParticles);
+}
+
+int ForceFields::add(const ForceField& field)
+{
+    if (this->size() >= MAX_FIELDS) {
+        cerr << "[pbf] At most " << MAX_FIELDS << " force fields can be set" << endl;
+        return -1;
+    }
+
+    this->fields.push_back(field);
+    this->dirty = true;
+
+    return this->size() - 1;
+}
+
+void ForceFields::set(int index, const ForceField& field)
+{
+    if (index < 0 || index >= this->size()) {
+        return;
+    }
+
+    this->fields[index] = field;
+    this->dirty         = true;
+}
+
+void ForceFields::remove(int index)
+{
+    if (index < 0 || index >= this->size()) {
+        return;
+    }
+
+    this->fields.erase(this->fields.begin() + index);
+    this->dirty = true;
+}
+
+void ForceFields::clear()
+{
+    this->fields.clear();
+    this->dirty = true;
+}
+
+/**
+ * Predicts the positions under the fields' accelerations
+ */
+void ForceFields::predict(float dt)
+{
+    if (!this->isLoaded() || this->numParticles <= 0) {
+        return;
+    }
+
+    // The write blocks, so fields can change again right after:
+
+    if (this->dirty && !this->fields.empty()) {
+        checkError(clEnqueueWriteBuffer(this->queue
+                                       ,this->buffer
+                                       ,CL_TRUE
+                                       ,0
+                                       ,this->fields.size() * sizeof(ForceField)
+                                       ,&this->fields[0]
+                                       ,0
+                                       ,NULL
+                                       ,NULL)
+                  ,"clEnqueueWriteBuffer (force fields)");
+    }
+
+    this->dirty = false;
+
+    setArg(this->predictKernel, 2, dt);
+    setArg(this->predictKernel, 4, this->size());
+
+    if (this->events == NULL) {
+        run1D(this->queue, this->predictKernel, static_cast<size_t>(this->numParticles));
+        return;
+    }
+
+    cl_event event = NULL;
+
+    run1D(this->queue, this->predictKernel, static_cast<size_t>(this->numParticles), 0, &event);
+
+    if (event != NULL) {
+        this->events->push_back(event);
+    }
+}
+
+}
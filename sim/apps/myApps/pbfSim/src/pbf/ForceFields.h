@@ -0,0 +1,155 @@
+/*******************************************************************************
+ * ForceFields.h
+ * - Analytic external force fields: gravity, wind, attractors, vortices and
+ *   drag volumes, described by a few floats each and evaluated per particle
+ *   on the device as the positions are predicted. See kernels/Forces.cl
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_FORCE_FIELDS_H
+#define PBF_LIB_FORCE_FIELDS_H
+
+#include <string>
+#include <vector>
+#include "Program.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+struct DeviceBuffers;
+
+// Kinds of force field; these must match FORCE_* in kernels/Common.cl
+
+enum ForceFieldType {
+    FORCE_GRAVITY = 0,  // strength * direction, everywhere
+    FORCE_WIND,         // Pulls velocities toward direction (a velocity), at
+                        // rate strength
+    FORCE_ATTRACTOR,    // Toward position (away, if strength < 0)
+    FORCE_VORTEX,       // Around the axis direction through position
+    FORCE_DRAG          // -strength * v inside the box position +/- extent
+};
+
+// Device-side descriptor; this must match ForceField in kernels/Common.cl
+
+typedef struct {
+
+    cl_float4 position;   // Point or box center
+
+    cl_float4 direction;  // Direction, axis or velocity, by type
+
+    cl_float4 extent;     // Box half-extents (FORCE_DRAG)
+
+    cl_int type;          // ForceFieldType
+
+    cl_float strength;
+
+    cl_float radius;      // Falloff radius of attractors, vortices and wind;
+                          // <= 0 for no falloff
+
+    cl_int __padding;
+
+} ForceField;
+
+// Descriptors of each kind of field
+
+ForceField gravityField(const float direction[3], float strength);
+
+ForceField windField(const float velocity[3], float rate, const float center[3], float radius);
+
+ForceField attractorField(const float position[3], float strength, float radius);
+
+ForceField vortexField(const float position[3], const float axis[3], float strength, float radius);
+
+ForceField dragField(const float center[3], const float halfExtent[3], float strength);
+
+/**
+ * The force fields acting on the particles of a solver. Descriptors are
+ * kept on the host and written to a small constant buffer whenever they
+ * change. The solver predicts positions with predict() rather than
+ * predictPosition, which evaluates the fields from that buffer as it
+ * integrates, so no per-particle external force is written or read
+ */
+class ForceFields
+{
+    public:
+        // Size of the constant buffer, in fields
+        static const int MAX_FIELDS = 64;
+
+    private:
+        cl_command_queue queue;
+
+        // kernels/Forces.cl
+        Program program;
+
+        cl_kernel predictKernel;
+
+        // ForceField[MAX_FIELDS]
+        cl_mem buffer;
+
+        std::vector<ForceField> fields;
+
+        // Whether fields has changed since it was last written to buffer
+        bool dirty;
+
+        int numParticles;
+
+        // If set, receives an event for every kernel run (see setEventList)
+        std::vector<cl_event>* events;
+
+        // Non-copyable
+        ForceFields(const ForceFields&);
+        ForceFields& operator=(const ForceFields&);
+
+    public:
+        ForceFields(cl_context context
+                   ,cl_device_id device
+                   ,cl_command_queue queue
+                   ,const std::string& dataPath);
+
+        virtual ~ForceFields();
+
+        bool isLoaded() const { return this->program.isLoaded() && this->buffer != NULL; }
+
+        // Binds the particles of a solver; called again whenever they
+        // change
+        void bind(const DeviceBuffers& buffers, int numParticles);
+
+        /**
+         * Adds a field, returning its index, or -1 if MAX_FIELDS are already
+         * set. Indices of the other fields stay valid until one is removed
+         */
+        int add(const ForceField& field);
+
+        void set(int index, const ForceField& field);
+
+        // Removes the field at index; later fields move down by one
+        void remove(int index);
+
+        void clear();
+
+        int size() const { return static_cast<int>(this->fields.size()); }
+
+        const ForceField& get(int index) const { return this->fields[index]; }
+
+        /**
+         * Steps (1) - (4) of a step: integrates the fields' accelerations
+         * into the velocities and predicts the positions, writing the
+         * fields to the device first if they changed
+         *
+         * @param [in] dt The time step
+         */
+        void predict(float dt);
+
+        // Collects the events of subsequent kernel runs into events, e.g.
+        // for profiling; NULL stops collecting
+        void setEventList(std::vector<cl_event>* events) { this->events = events; }
+};
+
+}
+
+/******************************************************************************/
+
+#endif
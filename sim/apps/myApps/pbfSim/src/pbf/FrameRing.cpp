@@ -0,0 +1,599 @@
+/*******************************************************************************
+ * FrameRing.cpp
+ * - A ring of frame slots in POSIX shared memory (or a file), used to hand
+ *   finished frames to other processes without copying or serializing them
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "FrameRing.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+namespace {
+
+const char FRAME_RING_MAGIC[8] = { 'P', 'B', 'F', 'R', 'I', 'N', 'G', '\0' };
+
+// Number of times a reader retries when the writer laps it
+const int MAX_READ_ATTEMPTS = 4;
+
+size_t alignTo(size_t value, size_t alignment)
+{
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+}
+
+/*******************************************************************************
+ * FrameRingWriter
+ ******************************************************************************/
+
+FrameRingWriter::FrameRingWriter() :
+    base(NULL),
+    size(0),
+    header(NULL),
+    writing(-1),
+    onDisk(false)
+{
+
+}
+
+FrameRingWriter::~FrameRingWriter()
+{
+    this->close();
+}
+
+FrameSlotHeader* FrameRingWriter::slotHeader(int slot)
+{
+    return reinterpret_cast<FrameSlotHeader*>(this->base + this->header->dataOffset
+                                                         + static_cast<size_t>(slot) * this->header->slotSize);
+}
+
+/**
+ * Creates the shared memory object, replacing any stale one of the same name
+ *
+ * @param [in] _name Shared memory object name, starting with '/'
+ * @param [in] numSlots Number of frames kept in the ring
+ * @param [in] maxParticles Largest particle count a frame can hold
+ */
+bool FrameRingWriter::create(const string& _name, int numSlots, int maxParticles)
+{
+    this->close();
+
+#ifdef _WIN32
+
+    cerr << "[pbf] Shared memory frame rings require POSIX shared memory" << endl;
+    return false;
+
+#else
+
+    if (numSlots < 2 || maxParticles <= 0) {
+        cerr << "[pbf] A frame ring needs at least 2 slots and 1 particle" << endl;
+        return false;
+    }
+
+    shm_unlink(_name.c_str());
+
+    int fd = shm_open(_name.c_str(), O_CREAT | O_RDWR, 0644);
+
+    if (fd < 0) {
+        cerr << "[pbf] shm_open(" << _name << ") failed" << endl;
+        return false;
+    }
+
+    this->onDisk = false;
+
+    return this->map(fd, _name, numSlots, maxParticles);
+
+#endif
+}
+
+/**
+ * Creates the ring in a file, replacing any previous contents. The file is
+ * sized up front but stays sparse until frames are written to it
+ *
+ * @param [in] path The file to create
+ * @param [in] numSlots Number of frames kept in the ring
+ * @param [in] maxParticles Largest particle count a frame can hold
+ */
+bool FrameRingWriter::createFile(const string& path, int numSlots, int maxParticles)
+{
+    this->close();
+
+#ifdef _WIN32
+
+    cerr << "[pbf] Frame ring files require POSIX mmap" << endl;
+    return false;
+
+#else
+
+    if (numSlots < 2 || maxParticles <= 0) {
+        cerr << "[pbf] A frame ring needs at least 2 slots and 1 particle" << endl;
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        cerr << "[pbf] Couldn't create frame ring file " << path << endl;
+        return false;
+    }
+
+    this->onDisk = true;
+
+    return this->map(fd, path, numSlots, maxParticles);
+
+#endif
+}
+
+/**
+ * Sizes and maps a newly created ring object, and writes its header. The
+ * descriptor is closed in any case
+ *
+ * @param [in] fd Descriptor of the shared memory object or file
+ * @param [in] _name Its name, for messages and unlinking
+ * @param [in] numSlots Number of frames kept in the ring
+ * @param [in] maxParticles Largest particle count a frame can hold
+ */
+bool FrameRingWriter::map(int fd, const string& _name, int numSlots, int maxParticles)
+{
+#ifdef _WIN32
+
+    return false;
+
+#else
+
+    size_t particleOffset = alignTo(sizeof(FrameSlotHeader), 64);
+    size_t densityOffset  = alignTo(particleOffset + maxParticles * sizeof(Particle), 64);
+    size_t slotSize       = alignTo(densityOffset + maxParticles * sizeof(float), 64);
+    size_t dataOffset     = alignTo(sizeof(FrameRingHeader), 64);
+    size_t totalSize      = dataOffset + numSlots * slotSize;
+
+    if (ftruncate(fd, static_cast<off_t>(totalSize)) != 0) {
+        cerr << "[pbf] Couldn't size frame ring " << _name << endl;
+        ::close(fd);
+        this->unlink(_name);
+        return false;
+    }
+
+    void* mapped = mmap(NULL, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    if (mapped == MAP_FAILED) {
+        cerr << "[pbf] Couldn't map frame ring " << _name << endl;
+        this->unlink(_name);
+        return false;
+    }
+
+    this->name   = _name;
+    this->base   = static_cast<unsigned char*>(mapped);
+    this->size   = totalSize;
+    this->header = reinterpret_cast<FrameRingHeader*>(this->base);
+
+    // The mapping starts out zeroed, so the atomics already read as 0; fill
+    // in the layout, and stamp the magic last so readers never see a
+    // partially initialized header:
+
+    this->header->version        = VERSION;
+    this->header->numSlots       = static_cast<unsigned int>(numSlots);
+    this->header->maxParticles   = static_cast<unsigned int>(maxParticles);
+    this->header->slotSize       = static_cast<unsigned int>(slotSize);
+    this->header->dataOffset     = dataOffset;
+    this->header->particleOffset = particleOffset;
+    this->header->densityOffset  = densityOffset;
+
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(this->header->magic, FRAME_RING_MAGIC, sizeof(FRAME_RING_MAGIC));
+
+    return true;
+
+#endif
+}
+
+/**
+ * Removes a ring object that couldn't be set up
+ *
+ * @param [in] _name Shared memory object name or file path
+ */
+void FrameRingWriter::unlink(const string& _name)
+{
+#ifndef _WIN32
+    if (this->onDisk) {
+        ::unlink(_name.c_str());
+    } else {
+        shm_unlink(_name.c_str());
+    }
+#endif
+}
+
+/**
+ * Unmaps the ring. A shared memory object is unlinked, while a file is kept
+ * (its dirty pages are written back by the system). Readers that still have
+ * it mapped keep their mapping
+ */
+void FrameRingWriter::close()
+{
+#ifndef _WIN32
+    if (this->base != NULL) {
+        munmap(this->base, this->size);
+        if (!this->onDisk) {
+            shm_unlink(this->name.c_str());
+        }
+    }
+#endif
+
+    this->base    = NULL;
+    this->size    = 0;
+    this->header  = NULL;
+    this->writing = -1;
+}
+
+/**
+ * Claims the slot of the next frame, marking it as being written
+ *
+ * @param [out] particles Where to write the frame's particles
+ * @param [out] density Where to write the frame's particle densities
+ */
+bool FrameRingWriter::beginFrame(Particle*& particles, float*& density)
+{
+    if (this->header == NULL) {
+        return false;
+    }
+
+    unsigned long long frame = this->header->published.load(memory_order_relaxed) + 1;
+
+    this->writing = static_cast<int>((frame - 1) % this->header->numSlots);
+
+    FrameSlotHeader* slot = this->slotHeader(this->writing);
+
+    // Make the sequence odd; the fence keeps the data writes that follow
+    // from being reordered before it:
+
+    unsigned long long sequence = slot->sequence.load(memory_order_relaxed);
+    unsigned long long odd      = (sequence & 1ULL) ? sequence + 2 : sequence + 1;
+
+    slot->sequence.store(odd, memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_release);
+
+    unsigned char* data = reinterpret_cast<unsigned char*>(slot);
+
+    particles = reinterpret_cast<Particle*>(data + this->header->particleOffset);
+    density   = reinterpret_cast<float*>(data + this->header->densityOffset);
+
+    return true;
+}
+
+/**
+ * Publishes the slot claimed by beginFrame()
+ *
+ * @param [in] frameNumber The simulation's frame number
+ * @param [in] numParticles Number of particles written to the slot
+ * @param [in] bounds Simulation bounds of the frame
+ */
+void FrameRingWriter::endFrame(unsigned int frameNumber, int numParticles, const Bounds& bounds)
+{
+    if (this->header == NULL || this->writing < 0) {
+        return;
+    }
+
+    FrameSlotHeader* slot    = this->slotHeader(this->writing);
+    unsigned long long frame = this->header->published.load(memory_order_relaxed) + 1;
+
+    slot->frame        = frame;
+    slot->frameNumber  = frameNumber;
+    slot->numParticles = static_cast<unsigned int>(numParticles);
+
+    for (int i = 0; i < 3; i++) {
+        slot->bounds[i]     = bounds.min[i];
+        slot->bounds[i + 3] = bounds.max[i];
+    }
+
+    // Even again: the slot is consistent. Then advertise it:
+
+    slot->sequence.store(slot->sequence.load(memory_order_relaxed) + 1, memory_order_release);
+
+    this->header->published.store(frame, memory_order_release);
+
+    this->writing = -1;
+}
+
+/*******************************************************************************
+ * FrameRingReader
+ ******************************************************************************/
+
+FrameRingReader::FrameRingReader() :
+    base(NULL),
+    size(0),
+    header(NULL)
+{
+
+}
+
+FrameRingReader::~FrameRingReader()
+{
+    this->close();
+}
+
+const FrameSlotHeader* FrameRingReader::slotHeader(int slot) const
+{
+    return reinterpret_cast<const FrameSlotHeader*>(this->base + this->header->dataOffset
+                                                               + static_cast<size_t>(slot) * this->header->slotSize);
+}
+
+/**
+ * Maps the named shared memory object read-only
+ *
+ * @param [in] name Shared memory object name, as given to FrameRingWriter
+ */
+bool FrameRingReader::open(const string& name)
+{
+    this->close();
+
+#ifdef _WIN32
+
+    cerr << "[pbf] Shared memory frame rings require POSIX shared memory" << endl;
+    return false;
+
+#else
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    return this->map(fd, name);
+
+#endif
+}
+
+/**
+ * Maps a ring file read-only
+ *
+ * @param [in] path The file, as given to FrameRingWriter::createFile()
+ */
+bool FrameRingReader::openFile(const string& path)
+{
+    this->close();
+
+#ifdef _WIN32
+
+    cerr << "[pbf] Frame ring files require POSIX mmap" << endl;
+    return false;
+
+#else
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    return this->map(fd, path);
+
+#endif
+}
+
+/**
+ * Maps a ring object and checks its header. The descriptor is closed in any
+ * case
+ *
+ * @param [in] fd Descriptor of the shared memory object or file
+ * @param [in] name Its name, for messages
+ */
+bool FrameRingReader::map(int fd, const string& name)
+{
+#ifdef _WIN32
+
+    return false;
+
+#else
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FrameRingHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t mappedSize = static_cast<size_t>(info.st_size);
+    void* mapped      = mmap(NULL, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    const FrameRingHeader* candidate = static_cast<const FrameRingHeader*>(mapped);
+
+    bool valid = memcmp(candidate->magic, FRAME_RING_MAGIC, sizeof(FRAME_RING_MAGIC)) == 0;
+
+    atomic_thread_fence(memory_order_acquire);
+
+    valid = valid
+         && candidate->version == FrameRingWriter::VERSION
+         && candidate->numSlots > 0
+         && candidate->dataOffset + static_cast<size_t>(candidate->numSlots) * candidate->slotSize <= mappedSize;
+
+    if (!valid) {
+        cerr << "[pbf] " << name << " is not a frame ring (or not initialized yet)" << endl;
+        munmap(mapped, mappedSize);
+        return false;
+    }
+
+    this->base   = static_cast<unsigned char*>(mapped);
+    this->size   = mappedSize;
+    this->header = candidate;
+
+    return true;
+
+#endif
+}
+
+void FrameRingReader::close()
+{
+#ifndef _WIN32
+    if (this->base != NULL) {
+        munmap(this->base, this->size);
+    }
+#endif
+
+    this->base   = NULL;
+    this->size   = 0;
+    this->header = NULL;
+}
+
+unsigned long long FrameRingReader::getPublishedCount() const
+{
+    return this->header != NULL ? this->header->published.load(memory_order_acquire) : 0;
+}
+
+unsigned long long FrameRingReader::getOldestFrame() const
+{
+    unsigned long long published = this->getPublishedCount();
+
+    if (published == 0) {
+        return 0;
+    }
+
+    return published > this->header->numSlots ? published - this->header->numSlots + 1 : 1;
+}
+
+/**
+ * Maps the given frame in place, if it's still in the ring and not being
+ * overwritten
+ *
+ * @param [in] frame The 1-based publication count of the frame
+ * @param [out] view The mapped frame
+ */
+bool FrameRingReader::acquire(unsigned long long frame, FrameView& view) const
+{
+    unsigned long long published = this->getPublishedCount();
+
+    if (frame == 0 || frame > published || published - frame >= this->header->numSlots) {
+        return false;
+    }
+
+    int slot                     = static_cast<int>((frame - 1) % this->header->numSlots);
+    const FrameSlotHeader* shdr  = this->slotHeader(slot);
+    unsigned long long sequence  = shdr->sequence.load(memory_order_acquire);
+
+    if (sequence & 1ULL) {
+        return false;
+    }
+
+    view.frame        = shdr->frame;
+    view.frameNumber  = shdr->frameNumber;
+    view.numParticles = shdr->numParticles;
+
+    for (int i = 0; i < 6; i++) {
+        view.bounds[i] = shdr->bounds[i];
+    }
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(shdr);
+
+    view.particles = reinterpret_cast<const Particle*>(data + this->header->particleOffset);
+    view.density   = reinterpret_cast<const float*>(data + this->header->densityOffset);
+    view.sequence  = sequence;
+    view.slot      = slot;
+
+    return view.frame == frame && this->validate(view);
+}
+
+/**
+ * Maps the most recently published frame in place
+ *
+ * @param [out] view The mapped frame
+ */
+bool FrameRingReader::acquireLatest(FrameView& view) const
+{
+    if (this->header == NULL) {
+        return false;
+    }
+
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+        if (this->acquire(this->getPublishedCount(), view)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Tests if the slot a view points at is unchanged since it was acquired
+ *
+ * @param [in] view A view filled in by acquire() or acquireLatest()
+ */
+bool FrameRingReader::validate(const FrameView& view) const
+{
+    if (this->header == NULL) {
+        return false;
+    }
+
+    // Keep the reads of the frame's data from being reordered after the
+    // sequence check:
+
+    atomic_thread_fence(memory_order_acquire);
+
+    return this->slotHeader(view.slot)->sequence.load(memory_order_relaxed) == view.sequence;
+}
+
+/**
+ * Copies the most recently published frame out of the ring
+ *
+ * @param [out] view The copied frame's description; its pointers still
+ *              point into the ring
+ * @param [out] particles Room for getMaxParticles() particles, or NULL
+ * @param [out] density Room for getMaxParticles() floats, or NULL
+ */
+bool FrameRingReader::copyLatest(FrameView& view, Particle* particles, float* density) const
+{
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+
+        if (!this->acquireLatest(view)) {
+            return false;
+        }
+
+        unsigned int n = std::min(view.numParticles, this->header->maxParticles);
+
+        if (particles != NULL) {
+            memcpy(particles, view.particles, n * sizeof(Particle));
+        }
+
+        if (density != NULL) {
+            memcpy(density, view.density, n * sizeof(float));
+        }
+
+        if (this->validate(view)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}
+
+/******************************************************************************/
@@ -0,0 +1,250 @@
+/*******************************************************************************
+ * FrameRing.h
+ * - A ring of frame slots in POSIX shared memory, used to hand finished
+ *   frames to other processes (e.g. an external renderer) without copying
+ *   or serializing them. Every slot is guarded by a sequence lock, so the
+ *   writer never waits on readers, and readers detect frames that were
+ *   overwritten while they were looking at them. The same ring can also be
+ *   backed by a file, which keeps the last frames of a run on disk for
+ *   playback
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_FRAME_RING_H
+#define PBF_LIB_FRAME_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include "Solver.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * Layout of the shared memory object:
+ *
+ *   FrameRingHeader
+ *   slot 0: FrameSlotHeader, Particle[maxParticles], float density[maxParticles]
+ *   slot 1: ...
+ *
+ * Slots start at FrameRingHeader::dataOffset and are slotSize bytes apart;
+ * all offsets are 64 byte aligned
+ */
+typedef struct {
+
+    char magic[8];                    // "PBFRING\0"
+
+    unsigned int version;
+
+    unsigned int numSlots;
+
+    unsigned int maxParticles;
+
+    unsigned int slotSize;            // Bytes per slot, header included
+
+    unsigned long long dataOffset;    // Offset of the first slot
+
+    unsigned long long particleOffset; // Offsets of the arrays within a slot
+    unsigned long long densityOffset;
+
+    // Number of frames published so far. Frame f (1-based) lives in slot
+    // (f - 1) % numSlots
+    std::atomic<unsigned long long> published;
+
+} FrameRingHeader;
+
+typedef struct {
+
+    // Sequence lock: odd while the writer is filling the slot
+    std::atomic<unsigned long long> sequence;
+
+    unsigned long long frame;         // 1-based publication count
+
+    unsigned int frameNumber;         // Simulation frame number
+
+    unsigned int numParticles;
+
+    float bounds[6];                  // min xyz, max xyz
+
+} FrameSlotHeader;
+
+/**
+ * A frame mapped in place. The pointers are only meaningful until the slot
+ * is reused by the writer; FrameRingReader::validate() tells if that
+ * happened
+ */
+typedef struct {
+
+    unsigned long long frame;
+
+    unsigned int frameNumber;
+
+    unsigned int numParticles;
+
+    float bounds[6];
+
+    const Particle* particles;
+
+    const float* density;
+
+    // Sequence the slot had when the frame was acquired
+    unsigned long long sequence;
+
+    int slot;
+
+} FrameView;
+
+/******************************************************************************/
+
+/**
+ * Creates the shared memory object and publishes frames into it
+ */
+class FrameRingWriter
+{
+    private:
+        std::string name;
+
+        unsigned char* base;
+
+        size_t size;
+
+        FrameRingHeader* header;
+
+        // Slot being written between beginFrame() and endFrame(), or -1
+        int writing;
+
+        // True if the ring is backed by a file rather than shared memory
+        bool onDisk;
+
+        // Non-copyable
+        FrameRingWriter(const FrameRingWriter&);
+        FrameRingWriter& operator=(const FrameRingWriter&);
+
+        FrameSlotHeader* slotHeader(int slot);
+
+        bool map(int fd, const std::string& name, int numSlots, int maxParticles);
+
+        void unlink(const std::string& name);
+
+    public:
+        static const unsigned int VERSION = 1;
+
+        FrameRingWriter();
+
+        virtual ~FrameRingWriter();
+
+        /**
+         * Creates (or recreates) the named shared memory object. name must
+         * start with a '/', e.g. "/pbfSim-frames"
+         */
+        bool create(const std::string& name, int numSlots, int maxParticles);
+
+        /**
+         * Creates (or truncates) a file holding the ring, and maps it. The
+         * file is kept when the ring is closed, so it can be played back
+         * with FrameRingReader::openFile()
+         */
+        bool createFile(const std::string& path, int numSlots, int maxParticles);
+
+        // Unmaps the ring, and unlinks it if it's in shared memory
+        void close();
+
+        bool isOpen() const { return this->header != NULL; }
+
+        int getMaxParticles() const { return this->header != NULL ? this->header->maxParticles : 0; }
+
+        /**
+         * Claims the next slot and returns where its particles and densities
+         * should be written. Never blocks
+         */
+        bool beginFrame(Particle*& particles, float*& density);
+
+        // Publishes the slot claimed by beginFrame()
+        void endFrame(unsigned int frameNumber, int numParticles, const Bounds& bounds);
+};
+
+/******************************************************************************/
+
+/**
+ * Maps a shared memory object created by FrameRingWriter (read-only) and
+ * gives access to the frames in it
+ */
+class FrameRingReader
+{
+    private:
+        unsigned char* base;
+
+        size_t size;
+
+        const FrameRingHeader* header;
+
+        // Non-copyable
+        FrameRingReader(const FrameRingReader&);
+        FrameRingReader& operator=(const FrameRingReader&);
+
+        const FrameSlotHeader* slotHeader(int slot) const;
+
+        bool map(int fd, const std::string& name);
+
+    public:
+        FrameRingReader();
+
+        virtual ~FrameRingReader();
+
+        bool open(const std::string& name);
+
+        // Maps a ring file written by FrameRingWriter::createFile()
+        bool openFile(const std::string& path);
+
+        void close();
+
+        bool isOpen() const { return this->header != NULL; }
+
+        int getMaxParticles() const { return this->header != NULL ? this->header->maxParticles : 0; }
+
+        int getNumSlots() const { return this->header != NULL ? this->header->numSlots : 0; }
+
+        // Number of frames published so far
+        unsigned long long getPublishedCount() const;
+
+        // Oldest frame still in the ring, or 0 if nothing was published
+        unsigned long long getOldestFrame() const;
+
+        /**
+         * Maps the most recently published frame in place. Returns false if
+         * nothing has been published yet, or if the writer kept overwriting
+         * the slot while it was being acquired
+         */
+        bool acquireLatest(FrameView& view) const;
+
+        /**
+         * Maps a specific frame (1-based publication count), if it's still
+         * in the ring
+         */
+        bool acquire(unsigned long long frame, FrameView& view) const;
+
+        /**
+         * Returns true if the frame the view points at has not been
+         * overwritten since it was acquired. Call after reading the frame's
+         * data to know if what was read is consistent
+         */
+        bool validate(const FrameView& view) const;
+
+        /**
+         * Copies the most recently published frame out of the ring. The
+         * destination arrays must have room for the ring's maximum particle
+         * count. Either pointer may be NULL. Returns false if no consistent
+         * copy could be made
+         */
+        bool copyLatest(FrameView& view, Particle* particles, float* density) const;
+};
+
+}
+
+/******************************************************************************/
+
+#endif
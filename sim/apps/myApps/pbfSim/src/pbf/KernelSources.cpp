@@ -0,0 +1,5403 @@
+/*******************************************************************************
+ * KernelSources.cpp
+ * - Generated by pbf-embedkernels (tools/embedkernels.cpp) from the kernels
+ *   in bin/data; don't edit. "make kernels" in src/pbf regenerates it
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include "KernelSources.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+namespace {
+
+// kernels/Common.cl
+
+const char* const COMMON_CL[] = {
+    "/*******************************************************************************\n",
+    " * Common.cl\n",
+    " * - Types and helper functions shared by the kernel programs, including\n",
+    " *   the neighbor stencils of the solver's neighbor loops. Include with\n",
+    " *   #include \"kernels/Common.cl\"\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#ifndef PBF_KERNELS_COMMON_CL\n",
+    "#define PBF_KERNELS_COMMON_CL\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Types; these must match the host-side definitions in Simulation.h and\n",
+    " * Parameters.h exactly\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 pos;      // Current particle position (x)\n",
+    "\n",
+    "    float4 posStar;  // Predicted particle position (x*)\n",
+    "\n",
+    "    float4 vel;      // Current particle velocity (v)\n",
+    "\n",
+    "} Particle;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int particleIndex; // Index of particle in particle buffer\n",
+    "\n",
+    "    int cellI;         // Corresponding grid index in the x-axis\n",
+    "\n",
+    "    int cellJ;         // Corresponding grid index in the y-axis\n",
+    "\n",
+    "    int cellK;         // Corresponding grid index in the z-axis\n",
+    "\n",
+    "    int key;           // Linearized index key computed from the subscript\n",
+    "                       // (cellI, cellJ, cellK)\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} ParticlePosition;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int start;  // Start of the grid cell in sortedParticleToCell\n",
+    "\n",
+    "    int length;\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} GridCellOffset;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float particleRadius;\n",
+    "\n",
+    "    float smoothingRadius;\n",
+    "\n",
+    "    float relaxation;\n",
+    "\n",
+    "    float artificialPressureK;\n",
+    "\n",
+    "    float artificialPressureN;\n",
+    "\n",
+    "    float vorticityEpsilon;\n",
+    "\n",
+    "    float viscosityCoeff;\n",
+    "\n",
+    "} Parameters;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Spatial grid helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Linearizes the cell subscript (i, j, k)\n",
+    " */\n",
+    "int sub2ind(int i, int j, int k, int cellsX, int cellsY)\n",
+    "{\n",
+    "    return i + (j * cellsX) + (k * cellsX * cellsY);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Finds the (clamped) subscript of the grid cell containing p, using the same\n",
+    " * discretization as the discretizeParticlePositions kernel\n",
+    " */\n",
+    "int3 cellOf(float3 p\n",
+    "           ,int3 cells\n",
+    "           ,float3 minExt\n",
+    "           ,float3 maxExt)\n",
+    "{\n",
+    "    float3 cellSize = (maxExt - minExt) / convert_float3(cells);\n",
+    "    int3 cell       = convert_int3(floor((p - minExt) / cellSize));\n",
+    "\n",
+    "    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Neighbor stencils\n",
+    " *\n",
+    " * A neighbor loop visits the cells of the block starting at\n",
+    " * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping\n",
+    " * the cells rejected by stencilCellVisible():\n",
+    " *\n",
+    " *   int3 span  = (int3)(0, 0, 0);\n",
+    " *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);\n",
+    " *\n",
+    " *   for (int k = first.z; k < first.z + span.z; k++)\n",
+    " *     for (int j = first.y; j < first.y + span.y; j++)\n",
+    " *       for (int i = first.x; i < first.x + span.x; i++)\n",
+    " *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))\n",
+    " *           ... particles of cell (i, j, k) ...\n",
+    " *\n",
+    " * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the\n",
+    " * block only covers the cells the particle's h-ball touches, which is one\n",
+    " * or two cells per axis once cells are at least 2h wide; the solver sizes\n",
+    " * its grid that way while the stencil is selected. A program whose\n",
+    " * neighbor loops go through these helpers says so by putting\n",
+    " * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel\n",
+    " * it declares, so a stencil nothing runs isn't reported as active\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }\n",
+    "\n",
+    "/**\n",
+    " * Returns the lowest subscript of the block of cells that can hold neighbors\n",
+    " * of the particle at p, in cell, and the block's width per axis in span.\n",
+    " * The cells the particle's h-ball touches run from floor((p - h) / cellSize)\n",
+    " * to floor((p + h) / cellSize) on each axis, which is within one cell of\n",
+    " * the particle's own if cells are at least h wide; the block is exactly\n",
+    " * that range. Otherwise (cells compressed below h, or particles outside\n",
+    " * the grid) the full 3x3x3 block around the cell is used\n",
+    " */\n",
+    "int3 neighborStencilOrigin(float3 p\n",
+    "                          ,int3 cell\n",
+    "                          ,float3 minExt\n",
+    "                          ,float3 cellSize\n",
+    "                          ,float h\n",
+    "                          ,int3* span)\n",
+    "{\n",
+    "#ifdef PBF_HALF_CELL_STENCIL\n",
+    "\n",
+    "    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {\n",
+    "\n",
+    "        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));\n",
+    "        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));\n",
+    "\n",
+    "        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {\n",
+    "            *span = hi - lo + (int3)(1, 1, 1);\n",
+    "            return lo;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "    *span = (int3)(3, 3, 3);\n",
+    "\n",
+    "    return cell - (int3)(1, 1, 1);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Squared distance from p to the box of cell c\n",
+    " */\n",
+    "float cellDistance2(float3 p\n",
+    "                   ,int3 c\n",
+    "                   ,float3 minExt\n",
+    "                   ,float3 cellSize)\n",
+    "{\n",
+    "    float3 lo = minExt + (convert_float3(c) * cellSize);\n",
+    "    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));\n",
+    "\n",
+    "    return dot(d, d);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if cell c is in the grid and its box comes within h of p; cells\n",
+    " * that fail can be skipped without reading any of their particles\n",
+    " */\n",
+    "bool stencilCellVisible(float3 p\n",
+    "                       ,int3 c\n",
+    "                       ,int3 cells\n",
+    "                       ,float3 minExt\n",
+    "                       ,float3 cellSize\n",
+    "                       ,float h)\n",
+    "{\n",
+    "    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "        return false;\n",
+    "    }\n",
+    "\n",
+    "    return cellDistance2(p, c, minExt, cellSize) < (h * h);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * SPH smoothing kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Poly6 smoothing kernel, taking the squared distance r^2\n",
+    " */\n",
+    "float poly6(float r2, float h)\n",
+    "{\n",
+    "    float h2 = h * h;\n",
+    "\n",
+    "    if (r2 >= h2) {\n",
+    "        return 0.0f;\n",
+    "    }\n",
+    "\n",
+    "    float x = h2 - r2;\n",
+    "\n",
+    "    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Gradient of the spiky smoothing kernel with respect to r\n",
+    " */\n",
+    "float3 spikyGradient(float3 r, float h)\n",
+    "{\n",
+    "    float rLen = length(r);\n",
+    "\n",
+    "    if (rLen <= 0.0f || rLen >= h) {\n",
+    "        return (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    }\n",
+    "\n",
+    "    float x = h - rLen;\n",
+    "\n",
+    "    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Geometry helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Returns the point on triangle (a, b, c) closest to p. See \"Real-Time\n",
+    " * Collision Detection\" (Ericson, 2005), section 5.1.5\n",
+    " */\n",
+    "float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)\n",
+    "{\n",
+    "    float3 ab = b - a;\n",
+    "    float3 ac = c - a;\n",
+    "    float3 ap = p - a;\n",
+    "\n",
+    "    float d1 = dot(ab, ap);\n",
+    "    float d2 = dot(ac, ap);\n",
+    "\n",
+    "    if (d1 <= 0.0f && d2 <= 0.0f) {\n",
+    "        return a;\n",
+    "    }\n",
+    "\n",
+    "    float3 bp = p - b;\n",
+    "    float d3  = dot(ab, bp);\n",
+    "    float d4  = dot(ac, bp);\n",
+    "\n",
+    "    if (d3 >= 0.0f && d4 <= d3) {\n",
+    "        return b;\n",
+    "    }\n",
+    "\n",
+    "    float vc = (d1 * d4) - (d3 * d2);\n",
+    "\n",
+    "    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {\n",
+    "        return a + ((d1 / (d1 - d3)) * ab);\n",
+    "    }\n",
+    "\n",
+    "    float3 cp = p - c;\n",
+    "    float d5  = dot(ab, cp);\n",
+    "    float d6  = dot(ac, cp);\n",
+    "\n",
+    "    if (d6 >= 0.0f && d5 <= d6) {\n",
+    "        return c;\n",
+    "    }\n",
+    "\n",
+    "    float vb = (d5 * d2) - (d1 * d6);\n",
+    "\n",
+    "    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {\n",
+    "        return a + ((d2 / (d2 - d6)) * ac);\n",
+    "    }\n",
+    "\n",
+    "    float va = (d3 * d6) - (d5 * d4);\n",
+    "\n",
+    "    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {\n",
+    "        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));\n",
+    "    }\n",
+    "\n",
+    "    float denom = 1.0f / (va + vb + vc);\n",
+    "\n",
+    "    return a + (ab * (vb * denom)) + (ac * (vc * denom));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the point p by the row-major affine matrix m, using the same\n",
+    " * row-vector convention as ofMatrix4x4 (p' = p * m)\n",
+    " */\n",
+    "float3 transformPoint(float16 m, float3 p)\n",
+    "{\n",
+    "    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the direction d by the linear part of m\n",
+    " */\n",
+    "float3 transformDirection(float16 m, float3 d)\n",
+    "{\n",
+    "    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * External force fields\n",
+    " *\n",
+    " * Analytic descriptors of the external forces acting on the fluid, passed to\n",
+    " * kernels in a small constant buffer and evaluated per particle where the\n",
+    " * positions are predicted (see kernels/Forces.cl). These must match\n",
+    " * pbf::ForceField in ForceFields.h\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define FORCE_GRAVITY   0  // strength * direction, everywhere\n",
+    "#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),\n",
+    "                           // at rate strength\n",
+    "#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)\n",
+    "#define FORCE_VORTEX    3  // Around the axis direction through position\n",
+    "#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 position;   // Point or box center\n",
+    "\n",
+    "    float4 direction;  // Direction, axis or velocity, by type\n",
+    "\n",
+    "    float4 extent;     // Box half-extents (FORCE_DRAG)\n",
+    "\n",
+    "    int type;          // FORCE_*\n",
+    "\n",
+    "    float strength;\n",
+    "\n",
+    "    float radius;      // Falloff radius of attractors, vortices and wind;\n",
+    "                       // <= 0 for no falloff\n",
+    "\n",
+    "    int __padding;\n",
+    "\n",
+    "} ForceField;\n",
+    "\n",
+    "/**\n",
+    " * Linear falloff of a field with distance d: 1 at the source, 0 at radius\n",
+    " * and beyond; 1 everywhere if radius <= 0\n",
+    " */\n",
+    "float forceFalloff(float d, float radius)\n",
+    "{\n",
+    "    return radius > 0.0f \? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Sums the acceleration of numFields force fields on a particle at p moving\n",
+    " * at velocity v\n",
+    " */\n",
+    "float3 evaluateForceFields(constant ForceField* fields\n",
+    "                          ,int numFields\n",
+    "                          ,float3 p\n",
+    "                          ,float3 v)\n",
+    "{\n",
+    "    float3 a = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    for (int i = 0; i < numFields; i++) {\n",
+    "\n",
+    "        ForceField f = fields[i];\n",
+    "\n",
+    "        float3 r = f.position.xyz - p;\n",
+    "        float d  = length(r);\n",
+    "\n",
+    "        switch (f.type) {\n",
+    "\n",
+    "            case FORCE_GRAVITY:\n",
+    "                a += f.strength * f.direction.xyz;\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_WIND:\n",
+    "                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_ATTRACTOR:\n",
+    "                if (d > 0.0f) {\n",
+    "                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_VORTEX:\n",
+    "                {\n",
+    "                    float3 axis  = normalize(f.direction.xyz);\n",
+    "                    float3 perp  = r - (dot(r, axis) * axis);\n",
+    "                    float dPerp  = length(perp);\n",
+    "\n",
+    "                    if (dPerp > 0.0f) {\n",
+    "                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);\n",
+    "                    }\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_DRAG:\n",
+    "                if (all(isless(fabs(r), f.extent.xyz))) {\n",
+    "                    a -= f.strength * v;\n",
+    "                }\n",
+    "                break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return a;\n",
+    "}\n",
+    "\n",
+    "#endif\n",
+    ""
+};
+
+// kernels/DistanceField.cl
+
+const char* const DISTANCEFIELD_CL[] = {
+    "/*******************************************************************************\n",
+    " * DistanceField.cl\n",
+    " * - Kernels used to build narrow band signed distance fields from triangle\n",
+    " *   soups, and to push particles out of colliders represented by them\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Common.cl\n",
+    " * - Types and helper functions shared by the kernel programs, including\n",
+    " *   the neighbor stencils of the solver's neighbor loops. Include with\n",
+    " *   #include \"kernels/Common.cl\"\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#ifndef PBF_KERNELS_COMMON_CL\n",
+    "#define PBF_KERNELS_COMMON_CL\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Types; these must match the host-side definitions in Simulation.h and\n",
+    " * Parameters.h exactly\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 pos;      // Current particle position (x)\n",
+    "\n",
+    "    float4 posStar;  // Predicted particle position (x*)\n",
+    "\n",
+    "    float4 vel;      // Current particle velocity (v)\n",
+    "\n",
+    "} Particle;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int particleIndex; // Index of particle in particle buffer\n",
+    "\n",
+    "    int cellI;         // Corresponding grid index in the x-axis\n",
+    "\n",
+    "    int cellJ;         // Corresponding grid index in the y-axis\n",
+    "\n",
+    "    int cellK;         // Corresponding grid index in the z-axis\n",
+    "\n",
+    "    int key;           // Linearized index key computed from the subscript\n",
+    "                       // (cellI, cellJ, cellK)\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} ParticlePosition;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int start;  // Start of the grid cell in sortedParticleToCell\n",
+    "\n",
+    "    int length;\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} GridCellOffset;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float particleRadius;\n",
+    "\n",
+    "    float smoothingRadius;\n",
+    "\n",
+    "    float relaxation;\n",
+    "\n",
+    "    float artificialPressureK;\n",
+    "\n",
+    "    float artificialPressureN;\n",
+    "\n",
+    "    float vorticityEpsilon;\n",
+    "\n",
+    "    float viscosityCoeff;\n",
+    "\n",
+    "} Parameters;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Spatial grid helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Linearizes the cell subscript (i, j, k)\n",
+    " */\n",
+    "int sub2ind(int i, int j, int k, int cellsX, int cellsY)\n",
+    "{\n",
+    "    return i + (j * cellsX) + (k * cellsX * cellsY);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Finds the (clamped) subscript of the grid cell containing p, using the same\n",
+    " * discretization as the discretizeParticlePositions kernel\n",
+    " */\n",
+    "int3 cellOf(float3 p\n",
+    "           ,int3 cells\n",
+    "           ,float3 minExt\n",
+    "           ,float3 maxExt)\n",
+    "{\n",
+    "    float3 cellSize = (maxExt - minExt) / convert_float3(cells);\n",
+    "    int3 cell       = convert_int3(floor((p - minExt) / cellSize));\n",
+    "\n",
+    "    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Neighbor stencils\n",
+    " *\n",
+    " * A neighbor loop visits the cells of the block starting at\n",
+    " * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping\n",
+    " * the cells rejected by stencilCellVisible():\n",
+    " *\n",
+    " *   int3 span  = (int3)(0, 0, 0);\n",
+    " *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);\n",
+    " *\n",
+    " *   for (int k = first.z; k < first.z + span.z; k++)\n",
+    " *     for (int j = first.y; j < first.y + span.y; j++)\n",
+    " *       for (int i = first.x; i < first.x + span.x; i++)\n",
+    " *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))\n",
+    " *           ... particles of cell (i, j, k) ...\n",
+    " *\n",
+    " * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the\n",
+    " * block only covers the cells the particle's h-ball touches, which is one\n",
+    " * or two cells per axis once cells are at least 2h wide; the solver sizes\n",
+    " * its grid that way while the stencil is selected. A program whose\n",
+    " * neighbor loops go through these helpers says so by putting\n",
+    " * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel\n",
+    " * it declares, so a stencil nothing runs isn't reported as active\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }\n",
+    "\n",
+    "/**\n",
+    " * Returns the lowest subscript of the block of cells that can hold neighbors\n",
+    " * of the particle at p, in cell, and the block's width per axis in span.\n",
+    " * The cells the particle's h-ball touches run from floor((p - h) / cellSize)\n",
+    " * to floor((p + h) / cellSize) on each axis, which is within one cell of\n",
+    " * the particle's own if cells are at least h wide; the block is exactly\n",
+    " * that range. Otherwise (cells compressed below h, or particles outside\n",
+    " * the grid) the full 3x3x3 block around the cell is used\n",
+    " */\n",
+    "int3 neighborStencilOrigin(float3 p\n",
+    "                          ,int3 cell\n",
+    "                          ,float3 minExt\n",
+    "                          ,float3 cellSize\n",
+    "                          ,float h\n",
+    "                          ,int3* span)\n",
+    "{\n",
+    "#ifdef PBF_HALF_CELL_STENCIL\n",
+    "\n",
+    "    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {\n",
+    "\n",
+    "        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));\n",
+    "        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));\n",
+    "\n",
+    "        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {\n",
+    "            *span = hi - lo + (int3)(1, 1, 1);\n",
+    "            return lo;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "    *span = (int3)(3, 3, 3);\n",
+    "\n",
+    "    return cell - (int3)(1, 1, 1);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Squared distance from p to the box of cell c\n",
+    " */\n",
+    "float cellDistance2(float3 p\n",
+    "                   ,int3 c\n",
+    "                   ,float3 minExt\n",
+    "                   ,float3 cellSize)\n",
+    "{\n",
+    "    float3 lo = minExt + (convert_float3(c) * cellSize);\n",
+    "    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));\n",
+    "\n",
+    "    return dot(d, d);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if cell c is in the grid and its box comes within h of p; cells\n",
+    " * that fail can be skipped without reading any of their particles\n",
+    " */\n",
+    "bool stencilCellVisible(float3 p\n",
+    "                       ,int3 c\n",
+    "                       ,int3 cells\n",
+    "                       ,float3 minExt\n",
+    "                       ,float3 cellSize\n",
+    "                       ,float h)\n",
+    "{\n",
+    "    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "        return false;\n",
+    "    }\n",
+    "\n",
+    "    return cellDistance2(p, c, minExt, cellSize) < (h * h);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * SPH smoothing kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Poly6 smoothing kernel, taking the squared distance r^2\n",
+    " */\n",
+    "float poly6(float r2, float h)\n",
+    "{\n",
+    "    float h2 = h * h;\n",
+    "\n",
+    "    if (r2 >= h2) {\n",
+    "        return 0.0f;\n",
+    "    }\n",
+    "\n",
+    "    float x = h2 - r2;\n",
+    "\n",
+    "    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Gradient of the spiky smoothing kernel with respect to r\n",
+    " */\n",
+    "float3 spikyGradient(float3 r, float h)\n",
+    "{\n",
+    "    float rLen = length(r);\n",
+    "\n",
+    "    if (rLen <= 0.0f || rLen >= h) {\n",
+    "        return (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    }\n",
+    "\n",
+    "    float x = h - rLen;\n",
+    "\n",
+    "    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Geometry helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Returns the point on triangle (a, b, c) closest to p. See \"Real-Time\n",
+    " * Collision Detection\" (Ericson, 2005), section 5.1.5\n",
+    " */\n",
+    "float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)\n",
+    "{\n",
+    "    float3 ab = b - a;\n",
+    "    float3 ac = c - a;\n",
+    "    float3 ap = p - a;\n",
+    "\n",
+    "    float d1 = dot(ab, ap);\n",
+    "    float d2 = dot(ac, ap);\n",
+    "\n",
+    "    if (d1 <= 0.0f && d2 <= 0.0f) {\n",
+    "        return a;\n",
+    "    }\n",
+    "\n",
+    "    float3 bp = p - b;\n",
+    "    float d3  = dot(ab, bp);\n",
+    "    float d4  = dot(ac, bp);\n",
+    "\n",
+    "    if (d3 >= 0.0f && d4 <= d3) {\n",
+    "        return b;\n",
+    "    }\n",
+    "\n",
+    "    float vc = (d1 * d4) - (d3 * d2);\n",
+    "\n",
+    "    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {\n",
+    "        return a + ((d1 / (d1 - d3)) * ab);\n",
+    "    }\n",
+    "\n",
+    "    float3 cp = p - c;\n",
+    "    float d5  = dot(ab, cp);\n",
+    "    float d6  = dot(ac, cp);\n",
+    "\n",
+    "    if (d6 >= 0.0f && d5 <= d6) {\n",
+    "        return c;\n",
+    "    }\n",
+    "\n",
+    "    float vb = (d5 * d2) - (d1 * d6);\n",
+    "\n",
+    "    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {\n",
+    "        return a + ((d2 / (d2 - d6)) * ac);\n",
+    "    }\n",
+    "\n",
+    "    float va = (d3 * d6) - (d5 * d4);\n",
+    "\n",
+    "    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {\n",
+    "        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));\n",
+    "    }\n",
+    "\n",
+    "    float denom = 1.0f / (va + vb + vc);\n",
+    "\n",
+    "    return a + (ab * (vb * denom)) + (ac * (vc * denom));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the point p by the row-major affine matrix m, using the same\n",
+    " * row-vector convention as ofMatrix4x4 (p' = p * m)\n",
+    " */\n",
+    "float3 transformPoint(float16 m, float3 p)\n",
+    "{\n",
+    "    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the direction d by the linear part of m\n",
+    " */\n",
+    "float3 transformDirection(float16 m, float3 d)\n",
+    "{\n",
+    "    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * External force fields\n",
+    " *\n",
+    " * Analytic descriptors of the external forces acting on the fluid, passed to\n",
+    " * kernels in a small constant buffer and evaluated per particle where the\n",
+    " * positions are predicted (see kernels/Forces.cl). These must match\n",
+    " * pbf::ForceField in ForceFields.h\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define FORCE_GRAVITY   0  // strength * direction, everywhere\n",
+    "#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),\n",
+    "                           // at rate strength\n",
+    "#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)\n",
+    "#define FORCE_VORTEX    3  // Around the axis direction through position\n",
+    "#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 position;   // Point or box center\n",
+    "\n",
+    "    float4 direction;  // Direction, axis or velocity, by type\n",
+    "\n",
+    "    float4 extent;     // Box half-extents (FORCE_DRAG)\n",
+    "\n",
+    "    int type;          // FORCE_*\n",
+    "\n",
+    "    float strength;\n",
+    "\n",
+    "    float radius;      // Falloff radius of attractors, vortices and wind;\n",
+    "                       // <= 0 for no falloff\n",
+    "\n",
+    "    int __padding;\n",
+    "\n",
+    "} ForceField;\n",
+    "\n",
+    "/**\n",
+    " * Linear falloff of a field with distance d: 1 at the source, 0 at radius\n",
+    " * and beyond; 1 everywhere if radius <= 0\n",
+    " */\n",
+    "float forceFalloff(float d, float radius)\n",
+    "{\n",
+    "    return radius > 0.0f \? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Sums the acceleration of numFields force fields on a particle at p moving\n",
+    " * at velocity v\n",
+    " */\n",
+    "float3 evaluateForceFields(constant ForceField* fields\n",
+    "                          ,int numFields\n",
+    "                          ,float3 p\n",
+    "                          ,float3 v)\n",
+    "{\n",
+    "    float3 a = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    for (int i = 0; i < numFields; i++) {\n",
+    "\n",
+    "        ForceField f = fields[i];\n",
+    "\n",
+    "        float3 r = f.position.xyz - p;\n",
+    "        float d  = length(r);\n",
+    "\n",
+    "        switch (f.type) {\n",
+    "\n",
+    "            case FORCE_GRAVITY:\n",
+    "                a += f.strength * f.direction.xyz;\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_WIND:\n",
+    "                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_ATTRACTOR:\n",
+    "                if (d > 0.0f) {\n",
+    "                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_VORTEX:\n",
+    "                {\n",
+    "                    float3 axis  = normalize(f.direction.xyz);\n",
+    "                    float3 perp  = r - (dot(r, axis) * axis);\n",
+    "                    float dPerp  = length(perp);\n",
+    "\n",
+    "                    if (dPerp > 0.0f) {\n",
+    "                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);\n",
+    "                    }\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_DRAG:\n",
+    "                if (all(isless(fabs(r), f.extent.xyz))) {\n",
+    "                    a -= f.strength * v;\n",
+    "                }\n",
+    "                break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return a;\n",
+    "}\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "/******************************************************************************/\n",
+    "\n",
+    "// Distance fields are stored as one int per voxel, so they can be built with\n",
+    "// atomic_min: the upper bits hold the distance to the surface, quantized\n",
+    "// over [0, band], and the lowest bit is set if the voxel lies behind the\n",
+    "// closest triangle (i.e. inside the collider). Voxels outside of the band\n",
+    "// keep the value EMPTY_VOXEL\n",
+    "#define EMPTY_VOXEL   0x7FFFFFFF\n",
+    "#define DISTANCE_BITS 29\n",
+    "\n",
+    "/**\n",
+    " * Encodes a distance d in [0, band] and an inside flag into a voxel value\n",
+    " */\n",
+    "int encodeDistance(float d, float band, bool inside)\n",
+    "{\n",
+    "    int q = convert_int_rtz(clamp(d / band, 0.0f, 1.0f) * (float)(1 << DISTANCE_BITS));\n",
+    "\n",
+    "    return (q << 1) | (inside \? 1 : 0);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Decodes a voxel value into a signed distance (negative inside)\n",
+    " */\n",
+    "float decodeDistance(int v, float band)\n",
+    "{\n",
+    "    if (v == EMPTY_VOXEL) {\n",
+    "        return band;\n",
+    "    }\n",
+    "\n",
+    "    float d = ((float)(v >> 1) / (float)(1 << DISTANCE_BITS)) * band;\n",
+    "\n",
+    "    return (v & 1) \? -d : d;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Fetches the signed distance stored in voxel (x,y,z), clamping to the field\n",
+    " */\n",
+    "float fetchDistance(global const int* field, int4 dims, int x, int y, int z, float band)\n",
+    "{\n",
+    "    x = clamp(x, 0, dims.x - 1);\n",
+    "    y = clamp(y, 0, dims.y - 1);\n",
+    "    z = clamp(z, 0, dims.z - 1);\n",
+    "\n",
+    "    return decodeDistance(field[sub2ind(x, y, z, dims.x, dims.y)], band);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Marks every voxel of the field as empty\n",
+    " *\n",
+    " * Run 1D over the number of voxels in the field\n",
+    " */\n",
+    "kernel void clearDistanceField(global int* field)\n",
+    "{\n",
+    "    field[get_global_id(0)] = EMPTY_VOXEL;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Writes the distance to a single triangle into every voxel within band of\n",
+    " * it, keeping the smallest distance per voxel. Voxel (x,y,z) is centered at\n",
+    " * fieldOrigin + ((x,y,z) + 0.5) * voxelSize\n",
+    " *\n",
+    " * Run 1D over the number of triangles\n",
+    " */\n",
+    "kernel void splatTriangleDistances(global const float4* vertices\n",
+    "                                  ,global const int* indices\n",
+    "                                  ,int numTriangles\n",
+    "                                  ,float4 fieldOrigin\n",
+    "                                  ,float voxelSize\n",
+    "                                  ,int4 dims\n",
+    "                                  ,float band\n",
+    "                                  ,global int* field)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numTriangles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    float3 a = vertices[indices[(3 * id) + 0]].xyz;\n",
+    "    float3 b = vertices[indices[(3 * id) + 1]].xyz;\n",
+    "    float3 c = vertices[indices[(3 * id) + 2]].xyz;\n",
+    "    float3 n = cross(b - a, c - a);\n",
+    "\n",
+    "    // Voxel range covered by the triangle's bounding box grown by the band:\n",
+    "\n",
+    "    float3 lo = fmin(a, fmin(b, c)) - (float3)(band, band, band);\n",
+    "    float3 hi = fmax(a, fmax(b, c)) + (float3)(band, band, band);\n",
+    "\n",
+    "    int3 vLo = max(convert_int3(floor((lo - fieldOrigin.xyz) / voxelSize - 0.5f)), (int3)(0, 0, 0));\n",
+    "    int3 vHi = min(convert_int3(ceil((hi - fieldOrigin.xyz) / voxelSize - 0.5f)), dims.xyz - (int3)(1, 1, 1));\n",
+    "\n",
+    "    for (int z = vLo.z; z <= vHi.z; z++) {\n",
+    "        for (int y = vLo.y; y <= vHi.y; y++) {\n",
+    "            for (int x = vLo.x; x <= vHi.x; x++) {\n",
+    "\n",
+    "                float3 p  = fieldOrigin.xyz + ((float3)(x, y, z) + 0.5f) * voxelSize;\n",
+    "                float3 q  = closestPointOnTriangle(p, a, b, c);\n",
+    "                float  d  = distance(p, q);\n",
+    "\n",
+    "                if (d > band) {\n",
+    "                    continue;\n",
+    "                }\n",
+    "\n",
+    "                atomic_min(&field[sub2ind(x, y, z, dims.x, dims.y)]\n",
+    "                          ,encodeDistance(d, band, dot(p - q, n) < 0.0f));\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Pushes the predicted position of every particle that penetrates the\n",
+    " * collider back to its surface. The particle is taken into field space by\n",
+    " * worldToField, where the distance and its gradient are interpolated\n",
+    " * trilinearly from the 8 surrounding voxels; fieldScale converts field\n",
+    " * space distances to world units\n",
+    " *\n",
+    " * Run 1D over the number of particles\n",
+    " */\n",
+    "kernel void resolveDistanceField(global const Parameters* parameters\n",
+    "                                ,global Particle* particles\n",
+    "                                ,int numParticles\n",
+    "                                ,global const int* field\n",
+    "                                ,float4 fieldOrigin\n",
+    "                                ,float voxelSize\n",
+    "                                ,int4 dims\n",
+    "                                ,float band\n",
+    "                                ,float16 worldToField\n",
+    "                                ,float16 fieldToWorld\n",
+    "                                ,float fieldScale)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    float  radius = parameters->particleRadius;\n",
+    "    float3 p      = transformPoint(worldToField, particles[id].posStar.xyz);\n",
+    "\n",
+    "    // Continuous voxel coordinates; voxel centers sit at integer values:\n",
+    "\n",
+    "    float3 g  = ((p - fieldOrigin.xyz) / voxelSize) - 0.5f;\n",
+    "    float3 gf = floor(g);\n",
+    "    int3   v  = convert_int3(gf);\n",
+    "    float3 t  = g - gf;\n",
+    "\n",
+    "    if (any(v < (int3)(-1, -1, -1)) || any(v >= dims.xyz)) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    float d000 = fetchDistance(field, dims, v.x,     v.y,     v.z,     band);\n",
+    "    float d100 = fetchDistance(field, dims, v.x + 1, v.y,     v.z,     band);\n",
+    "    float d010 = fetchDistance(field, dims, v.x,     v.y + 1, v.z,     band);\n",
+    "    float d110 = fetchDistance(field, dims, v.x + 1, v.y + 1, v.z,     band);\n",
+    "    float d001 = fetchDistance(field, dims, v.x,     v.y,     v.z + 1, band);\n",
+    "    float d101 = fetchDistance(field, dims, v.x + 1, v.y,     v.z + 1, band);\n",
+    "    float d011 = fetchDistance(field, dims, v.x,     v.y + 1, v.z + 1, band);\n",
+    "    float d111 = fetchDistance(field, dims, v.x + 1, v.y + 1, v.z + 1, band);\n",
+    "\n",
+    "    float d00 = mix(d000, d100, t.x);\n",
+    "    float d10 = mix(d010, d110, t.x);\n",
+    "    float d01 = mix(d001, d101, t.x);\n",
+    "    float d11 = mix(d011, d111, t.x);\n",
+    "    float d0  = mix(d00, d10, t.y);\n",
+    "    float d1  = mix(d01, d11, t.y);\n",
+    "    float d   = mix(d0, d1, t.z) * fieldScale;\n",
+    "\n",
+    "    if (d >= radius) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    // Analytic gradient of the trilinear interpolant:\n",
+    "\n",
+    "    float3 grad;\n",
+    "    grad.x = mix(mix(d100 - d000, d110 - d010, t.y), mix(d101 - d001, d111 - d011, t.y), t.z);\n",
+    "    grad.y = mix(d10 - d00, d11 - d01, t.z);\n",
+    "    grad.z = d1 - d0;\n",
+    "\n",
+    "    float3 n = transformDirection(fieldToWorld, grad);\n",
+    "    float  l = length(n);\n",
+    "\n",
+    "    if (l <= 0.0f) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    particles[id].posStar.xyz += (n / l) * (radius - d);\n",
+    "}\n",
+    ""
+};
+
+// kernels/Forces.cl
+
+const char* const FORCES_CL[] = {
+    "/*******************************************************************************\n",
+    " * Forces.cl\n",
+    " * - Predicts particle positions under the analytic external force fields\n",
+    " *   (see \"External force fields\" in Common.cl), evaluated straight from\n",
+    " *   their constant buffer\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Common.cl\n",
+    " * - Types and helper functions shared by the kernel programs, including\n",
+    " *   the neighbor stencils of the solver's neighbor loops. Include with\n",
+    " *   #include \"kernels/Common.cl\"\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#ifndef PBF_KERNELS_COMMON_CL\n",
+    "#define PBF_KERNELS_COMMON_CL\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Types; these must match the host-side definitions in Simulation.h and\n",
+    " * Parameters.h exactly\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 pos;      // Current particle position (x)\n",
+    "\n",
+    "    float4 posStar;  // Predicted particle position (x*)\n",
+    "\n",
+    "    float4 vel;      // Current particle velocity (v)\n",
+    "\n",
+    "} Particle;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int particleIndex; // Index of particle in particle buffer\n",
+    "\n",
+    "    int cellI;         // Corresponding grid index in the x-axis\n",
+    "\n",
+    "    int cellJ;         // Corresponding grid index in the y-axis\n",
+    "\n",
+    "    int cellK;         // Corresponding grid index in the z-axis\n",
+    "\n",
+    "    int key;           // Linearized index key computed from the subscript\n",
+    "                       // (cellI, cellJ, cellK)\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} ParticlePosition;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int start;  // Start of the grid cell in sortedParticleToCell\n",
+    "\n",
+    "    int length;\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} GridCellOffset;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float particleRadius;\n",
+    "\n",
+    "    float smoothingRadius;\n",
+    "\n",
+    "    float relaxation;\n",
+    "\n",
+    "    float artificialPressureK;\n",
+    "\n",
+    "    float artificialPressureN;\n",
+    "\n",
+    "    float vorticityEpsilon;\n",
+    "\n",
+    "    float viscosityCoeff;\n",
+    "\n",
+    "} Parameters;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Spatial grid helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Linearizes the cell subscript (i, j, k)\n",
+    " */\n",
+    "int sub2ind(int i, int j, int k, int cellsX, int cellsY)\n",
+    "{\n",
+    "    return i + (j * cellsX) + (k * cellsX * cellsY);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Finds the (clamped) subscript of the grid cell containing p, using the same\n",
+    " * discretization as the discretizeParticlePositions kernel\n",
+    " */\n",
+    "int3 cellOf(float3 p\n",
+    "           ,int3 cells\n",
+    "           ,float3 minExt\n",
+    "           ,float3 maxExt)\n",
+    "{\n",
+    "    float3 cellSize = (maxExt - minExt) / convert_float3(cells);\n",
+    "    int3 cell       = convert_int3(floor((p - minExt) / cellSize));\n",
+    "\n",
+    "    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Neighbor stencils\n",
+    " *\n",
+    " * A neighbor loop visits the cells of the block starting at\n",
+    " * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping\n",
+    " * the cells rejected by stencilCellVisible():\n",
+    " *\n",
+    " *   int3 span  = (int3)(0, 0, 0);\n",
+    " *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);\n",
+    " *\n",
+    " *   for (int k = first.z; k < first.z + span.z; k++)\n",
+    " *     for (int j = first.y; j < first.y + span.y; j++)\n",
+    " *       for (int i = first.x; i < first.x + span.x; i++)\n",
+    " *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))\n",
+    " *           ... particles of cell (i, j, k) ...\n",
+    " *\n",
+    " * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the\n",
+    " * block only covers the cells the particle's h-ball touches, which is one\n",
+    " * or two cells per axis once cells are at least 2h wide; the solver sizes\n",
+    " * its grid that way while the stencil is selected. A program whose\n",
+    " * neighbor loops go through these helpers says so by putting\n",
+    " * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel\n",
+    " * it declares, so a stencil nothing runs isn't reported as active\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }\n",
+    "\n",
+    "/**\n",
+    " * Returns the lowest subscript of the block of cells that can hold neighbors\n",
+    " * of the particle at p, in cell, and the block's width per axis in span.\n",
+    " * The cells the particle's h-ball touches run from floor((p - h) / cellSize)\n",
+    " * to floor((p + h) / cellSize) on each axis, which is within one cell of\n",
+    " * the particle's own if cells are at least h wide; the block is exactly\n",
+    " * that range. Otherwise (cells compressed below h, or particles outside\n",
+    " * the grid) the full 3x3x3 block around the cell is used\n",
+    " */\n",
+    "int3 neighborStencilOrigin(float3 p\n",
+    "                          ,int3 cell\n",
+    "                          ,float3 minExt\n",
+    "                          ,float3 cellSize\n",
+    "                          ,float h\n",
+    "                          ,int3* span)\n",
+    "{\n",
+    "#ifdef PBF_HALF_CELL_STENCIL\n",
+    "\n",
+    "    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {\n",
+    "\n",
+    "        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));\n",
+    "        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));\n",
+    "\n",
+    "        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {\n",
+    "            *span = hi - lo + (int3)(1, 1, 1);\n",
+    "            return lo;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "    *span = (int3)(3, 3, 3);\n",
+    "\n",
+    "    return cell - (int3)(1, 1, 1);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Squared distance from p to the box of cell c\n",
+    " */\n",
+    "float cellDistance2(float3 p\n",
+    "                   ,int3 c\n",
+    "                   ,float3 minExt\n",
+    "                   ,float3 cellSize)\n",
+    "{\n",
+    "    float3 lo = minExt + (convert_float3(c) * cellSize);\n",
+    "    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));\n",
+    "\n",
+    "    return dot(d, d);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if cell c is in the grid and its box comes within h of p; cells\n",
+    " * that fail can be skipped without reading any of their particles\n",
+    " */\n",
+    "bool stencilCellVisible(float3 p\n",
+    "                       ,int3 c\n",
+    "                       ,int3 cells\n",
+    "                       ,float3 minExt\n",
+    "                       ,float3 cellSize\n",
+    "                       ,float h)\n",
+    "{\n",
+    "    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "        return false;\n",
+    "    }\n",
+    "\n",
+    "    return cellDistance2(p, c, minExt, cellSize) < (h * h);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * SPH smoothing kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Poly6 smoothing kernel, taking the squared distance r^2\n",
+    " */\n",
+    "float poly6(float r2, float h)\n",
+    "{\n",
+    "    float h2 = h * h;\n",
+    "\n",
+    "    if (r2 >= h2) {\n",
+    "        return 0.0f;\n",
+    "    }\n",
+    "\n",
+    "    float x = h2 - r2;\n",
+    "\n",
+    "    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Gradient of the spiky smoothing kernel with respect to r\n",
+    " */\n",
+    "float3 spikyGradient(float3 r, float h)\n",
+    "{\n",
+    "    float rLen = length(r);\n",
+    "\n",
+    "    if (rLen <= 0.0f || rLen >= h) {\n",
+    "        return (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    }\n",
+    "\n",
+    "    float x = h - rLen;\n",
+    "\n",
+    "    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Geometry helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Returns the point on triangle (a, b, c) closest to p. See \"Real-Time\n",
+    " * Collision Detection\" (Ericson, 2005), section 5.1.5\n",
+    " */\n",
+    "float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)\n",
+    "{\n",
+    "    float3 ab = b - a;\n",
+    "    float3 ac = c - a;\n",
+    "    float3 ap = p - a;\n",
+    "\n",
+    "    float d1 = dot(ab, ap);\n",
+    "    float d2 = dot(ac, ap);\n",
+    "\n",
+    "    if (d1 <= 0.0f && d2 <= 0.0f) {\n",
+    "        return a;\n",
+    "    }\n",
+    "\n",
+    "    float3 bp = p - b;\n",
+    "    float d3  = dot(ab, bp);\n",
+    "    float d4  = dot(ac, bp);\n",
+    "\n",
+    "    if (d3 >= 0.0f && d4 <= d3) {\n",
+    "        return b;\n",
+    "    }\n",
+    "\n",
+    "    float vc = (d1 * d4) - (d3 * d2);\n",
+    "\n",
+    "    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {\n",
+    "        return a + ((d1 / (d1 - d3)) * ab);\n",
+    "    }\n",
+    "\n",
+    "    float3 cp = p - c;\n",
+    "    float d5  = dot(ab, cp);\n",
+    "    float d6  = dot(ac, cp);\n",
+    "\n",
+    "    if (d6 >= 0.0f && d5 <= d6) {\n",
+    "        return c;\n",
+    "    }\n",
+    "\n",
+    "    float vb = (d5 * d2) - (d1 * d6);\n",
+    "\n",
+    "    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {\n",
+    "        return a + ((d2 / (d2 - d6)) * ac);\n",
+    "    }\n",
+    "\n",
+    "    float va = (d3 * d6) - (d5 * d4);\n",
+    "\n",
+    "    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {\n",
+    "        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));\n",
+    "    }\n",
+    "\n",
+    "    float denom = 1.0f / (va + vb + vc);\n",
+    "\n",
+    "    return a + (ab * (vb * denom)) + (ac * (vc * denom));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the point p by the row-major affine matrix m, using the same\n",
+    " * row-vector convention as ofMatrix4x4 (p' = p * m)\n",
+    " */\n",
+    "float3 transformPoint(float16 m, float3 p)\n",
+    "{\n",
+    "    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the direction d by the linear part of m\n",
+    " */\n",
+    "float3 transformDirection(float16 m, float3 d)\n",
+    "{\n",
+    "    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * External force fields\n",
+    " *\n",
+    " * Analytic descriptors of the external forces acting on the fluid, passed to\n",
+    " * kernels in a small constant buffer and evaluated per particle where the\n",
+    " * positions are predicted (see kernels/Forces.cl). These must match\n",
+    " * pbf::ForceField in ForceFields.h\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define FORCE_GRAVITY   0  // strength * direction, everywhere\n",
+    "#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),\n",
+    "                           // at rate strength\n",
+    "#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)\n",
+    "#define FORCE_VORTEX    3  // Around the axis direction through position\n",
+    "#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 position;   // Point or box center\n",
+    "\n",
+    "    float4 direction;  // Direction, axis or velocity, by type\n",
+    "\n",
+    "    float4 extent;     // Box half-extents (FORCE_DRAG)\n",
+    "\n",
+    "    int type;          // FORCE_*\n",
+    "\n",
+    "    float strength;\n",
+    "\n",
+    "    float radius;      // Falloff radius of attractors, vortices and wind;\n",
+    "                       // <= 0 for no falloff\n",
+    "\n",
+    "    int __padding;\n",
+    "\n",
+    "} ForceField;\n",
+    "\n",
+    "/**\n",
+    " * Linear falloff of a field with distance d: 1 at the source, 0 at radius\n",
+    " * and beyond; 1 everywhere if radius <= 0\n",
+    " */\n",
+    "float forceFalloff(float d, float radius)\n",
+    "{\n",
+    "    return radius > 0.0f \? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Sums the acceleration of numFields force fields on a particle at p moving\n",
+    " * at velocity v\n",
+    " */\n",
+    "float3 evaluateForceFields(constant ForceField* fields\n",
+    "                          ,int numFields\n",
+    "                          ,float3 p\n",
+    "                          ,float3 v)\n",
+    "{\n",
+    "    float3 a = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    for (int i = 0; i < numFields; i++) {\n",
+    "\n",
+    "        ForceField f = fields[i];\n",
+    "\n",
+    "        float3 r = f.position.xyz - p;\n",
+    "        float d  = length(r);\n",
+    "\n",
+    "        switch (f.type) {\n",
+    "\n",
+    "            case FORCE_GRAVITY:\n",
+    "                a += f.strength * f.direction.xyz;\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_WIND:\n",
+    "                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_ATTRACTOR:\n",
+    "                if (d > 0.0f) {\n",
+    "                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_VORTEX:\n",
+    "                {\n",
+    "                    float3 axis  = normalize(f.direction.xyz);\n",
+    "                    float3 perp  = r - (dot(r, axis) * axis);\n",
+    "                    float dPerp  = length(perp);\n",
+    "\n",
+    "                    if (dPerp > 0.0f) {\n",
+    "                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);\n",
+    "                    }\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_DRAG:\n",
+    "                if (all(isless(fabs(r), f.extent.xyz))) {\n",
+    "                    a -= f.strength * v;\n",
+    "                }\n",
+    "                break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return a;\n",
+    "}\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Steps (1) - (4) of the solver, in place of predictPosition: for the sum a\n",
+    " * of the force fields,\n",
+    " *\n",
+    " *   v  = v + dt * a(x, v)\n",
+    " *   x* = x + dt * v\n",
+    " *\n",
+    " * No per-particle external force is read, so the step's traffic is the\n",
+    " * particle itself\n",
+    " *\n",
+    " * Run 1D over numParticles\n",
+    " */\n",
+    "kernel void predictPositionInFields(global Particle* particles\n",
+    "                                   ,int numParticles\n",
+    "                                   ,float dt\n",
+    "                                   ,constant ForceField* fields\n",
+    "                                   ,int numFields)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    float3 x = particles[id].pos.xyz;\n",
+    "    float3 v = particles[id].vel.xyz;\n",
+    "\n",
+    "    v += dt * evaluateForceFields(fields, numFields, x, v);\n",
+    "\n",
+    "    particles[id].vel.xyz     = v;\n",
+    "    particles[id].posStar.xyz = x + (dt * v);\n",
+    "}\n",
+    ""
+};
+
+// kernels/MeshCollision.cl
+
+const char* const MESHCOLLISION_CL[] = {
+    "/*******************************************************************************\n",
+    " * MeshCollision.cl\n",
+    " * - Kernels used to build and refit a linear bounding volume hierarchy (LBVH)\n",
+    " *   over a triangle mesh, and to collide swept particles against it\n",
+    " *\n",
+    " *   The hierarchy is built following \"Maximizing Parallelism in the\n",
+    " *   Construction of BVHs, Octrees, and k-d Trees\" (Karras, 2012): triangles\n",
+    " *   are sorted by the Morton code of their centroids, after which every\n",
+    " *   internal node can be emitted independently\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Common.cl\n",
+    " * - Types and helper functions shared by the kernel programs, including\n",
+    " *   the neighbor stencils of the solver's neighbor loops. Include with\n",
+    " *   #include \"kernels/Common.cl\"\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#ifndef PBF_KERNELS_COMMON_CL\n",
+    "#define PBF_KERNELS_COMMON_CL\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Types; these must match the host-side definitions in Simulation.h and\n",
+    " * Parameters.h exactly\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 pos;      // Current particle position (x)\n",
+    "\n",
+    "    float4 posStar;  // Predicted particle position (x*)\n",
+    "\n",
+    "    float4 vel;      // Current particle velocity (v)\n",
+    "\n",
+    "} Particle;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int particleIndex; // Index of particle in particle buffer\n",
+    "\n",
+    "    int cellI;         // Corresponding grid index in the x-axis\n",
+    "\n",
+    "    int cellJ;         // Corresponding grid index in the y-axis\n",
+    "\n",
+    "    int cellK;         // Corresponding grid index in the z-axis\n",
+    "\n",
+    "    int key;           // Linearized index key computed from the subscript\n",
+    "                       // (cellI, cellJ, cellK)\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} ParticlePosition;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int start;  // Start of the grid cell in sortedParticleToCell\n",
+    "\n",
+    "    int length;\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} GridCellOffset;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float particleRadius;\n",
+    "\n",
+    "    float smoothingRadius;\n",
+    "\n",
+    "    float relaxation;\n",
+    "\n",
+    "    float artificialPressureK;\n",
+    "\n",
+    "    float artificialPressureN;\n",
+    "\n",
+    "    float vorticityEpsilon;\n",
+    "\n",
+    "    float viscosityCoeff;\n",
+    "\n",
+    "} Parameters;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Spatial grid helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Linearizes the cell subscript (i, j, k)\n",
+    " */\n",
+    "int sub2ind(int i, int j, int k, int cellsX, int cellsY)\n",
+    "{\n",
+    "    return i + (j * cellsX) + (k * cellsX * cellsY);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Finds the (clamped) subscript of the grid cell containing p, using the same\n",
+    " * discretization as the discretizeParticlePositions kernel\n",
+    " */\n",
+    "int3 cellOf(float3 p\n",
+    "           ,int3 cells\n",
+    "           ,float3 minExt\n",
+    "           ,float3 maxExt)\n",
+    "{\n",
+    "    float3 cellSize = (maxExt - minExt) / convert_float3(cells);\n",
+    "    int3 cell       = convert_int3(floor((p - minExt) / cellSize));\n",
+    "\n",
+    "    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Neighbor stencils\n",
+    " *\n",
+    " * A neighbor loop visits the cells of the block starting at\n",
+    " * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping\n",
+    " * the cells rejected by stencilCellVisible():\n",
+    " *\n",
+    " *   int3 span  = (int3)(0, 0, 0);\n",
+    " *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);\n",
+    " *\n",
+    " *   for (int k = first.z; k < first.z + span.z; k++)\n",
+    " *     for (int j = first.y; j < first.y + span.y; j++)\n",
+    " *       for (int i = first.x; i < first.x + span.x; i++)\n",
+    " *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))\n",
+    " *           ... particles of cell (i, j, k) ...\n",
+    " *\n",
+    " * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the\n",
+    " * block only covers the cells the particle's h-ball touches, which is one\n",
+    " * or two cells per axis once cells are at least 2h wide; the solver sizes\n",
+    " * its grid that way while the stencil is selected. A program whose\n",
+    " * neighbor loops go through these helpers says so by putting\n",
+    " * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel\n",
+    " * it declares, so a stencil nothing runs isn't reported as active\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }\n",
+    "\n",
+    "/**\n",
+    " * Returns the lowest subscript of the block of cells that can hold neighbors\n",
+    " * of the particle at p, in cell, and the block's width per axis in span.\n",
+    " * The cells the particle's h-ball touches run from floor((p - h) / cellSize)\n",
+    " * to floor((p + h) / cellSize) on each axis, which is within one cell of\n",
+    " * the particle's own if cells are at least h wide; the block is exactly\n",
+    " * that range. Otherwise (cells compressed below h, or particles outside\n",
+    " * the grid) the full 3x3x3 block around the cell is used\n",
+    " */\n",
+    "int3 neighborStencilOrigin(float3 p\n",
+    "                          ,int3 cell\n",
+    "                          ,float3 minExt\n",
+    "                          ,float3 cellSize\n",
+    "                          ,float h\n",
+    "                          ,int3* span)\n",
+    "{\n",
+    "#ifdef PBF_HALF_CELL_STENCIL\n",
+    "\n",
+    "    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {\n",
+    "\n",
+    "        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));\n",
+    "        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));\n",
+    "\n",
+    "        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {\n",
+    "            *span = hi - lo + (int3)(1, 1, 1);\n",
+    "            return lo;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "    *span = (int3)(3, 3, 3);\n",
+    "\n",
+    "    return cell - (int3)(1, 1, 1);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Squared distance from p to the box of cell c\n",
+    " */\n",
+    "float cellDistance2(float3 p\n",
+    "                   ,int3 c\n",
+    "                   ,float3 minExt\n",
+    "                   ,float3 cellSize)\n",
+    "{\n",
+    "    float3 lo = minExt + (convert_float3(c) * cellSize);\n",
+    "    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));\n",
+    "\n",
+    "    return dot(d, d);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if cell c is in the grid and its box comes within h of p; cells\n",
+    " * that fail can be skipped without reading any of their particles\n",
+    " */\n",
+    "bool stencilCellVisible(float3 p\n",
+    "                       ,int3 c\n",
+    "                       ,int3 cells\n",
+    "                       ,float3 minExt\n",
+    "                       ,float3 cellSize\n",
+    "                       ,float h)\n",
+    "{\n",
+    "    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "        return false;\n",
+    "    }\n",
+    "\n",
+    "    return cellDistance2(p, c, minExt, cellSize) < (h * h);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * SPH smoothing kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Poly6 smoothing kernel, taking the squared distance r^2\n",
+    " */\n",
+    "float poly6(float r2, float h)\n",
+    "{\n",
+    "    float h2 = h * h;\n",
+    "\n",
+    "    if (r2 >= h2) {\n",
+    "        return 0.0f;\n",
+    "    }\n",
+    "\n",
+    "    float x = h2 - r2;\n",
+    "\n",
+    "    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Gradient of the spiky smoothing kernel with respect to r\n",
+    " */\n",
+    "float3 spikyGradient(float3 r, float h)\n",
+    "{\n",
+    "    float rLen = length(r);\n",
+    "\n",
+    "    if (rLen <= 0.0f || rLen >= h) {\n",
+    "        return (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    }\n",
+    "\n",
+    "    float x = h - rLen;\n",
+    "\n",
+    "    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Geometry helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Returns the point on triangle (a, b, c) closest to p. See \"Real-Time\n",
+    " * Collision Detection\" (Ericson, 2005), section 5.1.5\n",
+    " */\n",
+    "float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)\n",
+    "{\n",
+    "    float3 ab = b - a;\n",
+    "    float3 ac = c - a;\n",
+    "    float3 ap = p - a;\n",
+    "\n",
+    "    float d1 = dot(ab, ap);\n",
+    "    float d2 = dot(ac, ap);\n",
+    "\n",
+    "    if (d1 <= 0.0f && d2 <= 0.0f) {\n",
+    "        return a;\n",
+    "    }\n",
+    "\n",
+    "    float3 bp = p - b;\n",
+    "    float d3  = dot(ab, bp);\n",
+    "    float d4  = dot(ac, bp);\n",
+    "\n",
+    "    if (d3 >= 0.0f && d4 <= d3) {\n",
+    "        return b;\n",
+    "    }\n",
+    "\n",
+    "    float vc = (d1 * d4) - (d3 * d2);\n",
+    "\n",
+    "    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {\n",
+    "        return a + ((d1 / (d1 - d3)) * ab);\n",
+    "    }\n",
+    "\n",
+    "    float3 cp = p - c;\n",
+    "    float d5  = dot(ab, cp);\n",
+    "    float d6  = dot(ac, cp);\n",
+    "\n",
+    "    if (d6 >= 0.0f && d5 <= d6) {\n",
+    "        return c;\n",
+    "    }\n",
+    "\n",
+    "    float vb = (d5 * d2) - (d1 * d6);\n",
+    "\n",
+    "    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {\n",
+    "        return a + ((d2 / (d2 - d6)) * ac);\n",
+    "    }\n",
+    "\n",
+    "    float va = (d3 * d6) - (d5 * d4);\n",
+    "\n",
+    "    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {\n",
+    "        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));\n",
+    "    }\n",
+    "\n",
+    "    float denom = 1.0f / (va + vb + vc);\n",
+    "\n",
+    "    return a + (ab * (vb * denom)) + (ac * (vc * denom));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the point p by the row-major affine matrix m, using the same\n",
+    " * row-vector convention as ofMatrix4x4 (p' = p * m)\n",
+    " */\n",
+    "float3 transformPoint(float16 m, float3 p)\n",
+    "{\n",
+    "    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the direction d by the linear part of m\n",
+    " */\n",
+    "float3 transformDirection(float16 m, float3 d)\n",
+    "{\n",
+    "    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * External force fields\n",
+    " *\n",
+    " * Analytic descriptors of the external forces acting on the fluid, passed to\n",
+    " * kernels in a small constant buffer and evaluated per particle where the\n",
+    " * positions are predicted (see kernels/Forces.cl). These must match\n",
+    " * pbf::ForceField in ForceFields.h\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define FORCE_GRAVITY   0  // strength * direction, everywhere\n",
+    "#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),\n",
+    "                           // at rate strength\n",
+    "#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)\n",
+    "#define FORCE_VORTEX    3  // Around the axis direction through position\n",
+    "#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 position;   // Point or box center\n",
+    "\n",
+    "    float4 direction;  // Direction, axis or velocity, by type\n",
+    "\n",
+    "    float4 extent;     // Box half-extents (FORCE_DRAG)\n",
+    "\n",
+    "    int type;          // FORCE_*\n",
+    "\n",
+    "    float strength;\n",
+    "\n",
+    "    float radius;      // Falloff radius of attractors, vortices and wind;\n",
+    "                       // <= 0 for no falloff\n",
+    "\n",
+    "    int __padding;\n",
+    "\n",
+    "} ForceField;\n",
+    "\n",
+    "/**\n",
+    " * Linear falloff of a field with distance d: 1 at the source, 0 at radius\n",
+    " * and beyond; 1 everywhere if radius <= 0\n",
+    " */\n",
+    "float forceFalloff(float d, float radius)\n",
+    "{\n",
+    "    return radius > 0.0f \? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Sums the acceleration of numFields force fields on a particle at p moving\n",
+    " * at velocity v\n",
+    " */\n",
+    "float3 evaluateForceFields(constant ForceField* fields\n",
+    "                          ,int numFields\n",
+    "                          ,float3 p\n",
+    "                          ,float3 v)\n",
+    "{\n",
+    "    float3 a = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    for (int i = 0; i < numFields; i++) {\n",
+    "\n",
+    "        ForceField f = fields[i];\n",
+    "\n",
+    "        float3 r = f.position.xyz - p;\n",
+    "        float d  = length(r);\n",
+    "\n",
+    "        switch (f.type) {\n",
+    "\n",
+    "            case FORCE_GRAVITY:\n",
+    "                a += f.strength * f.direction.xyz;\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_WIND:\n",
+    "                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_ATTRACTOR:\n",
+    "                if (d > 0.0f) {\n",
+    "                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_VORTEX:\n",
+    "                {\n",
+    "                    float3 axis  = normalize(f.direction.xyz);\n",
+    "                    float3 perp  = r - (dot(r, axis) * axis);\n",
+    "                    float dPerp  = length(perp);\n",
+    "\n",
+    "                    if (dPerp > 0.0f) {\n",
+    "                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);\n",
+    "                    }\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_DRAG:\n",
+    "                if (all(isless(fabs(r), f.extent.xyz))) {\n",
+    "                    a -= f.strength * v;\n",
+    "                }\n",
+    "                break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return a;\n",
+    "}\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "/******************************************************************************/\n",
+    "\n",
+    "// Maximum depth of the traversal stack used per particle. Subtrees that\n",
+    "// don't fit are tested leaf by leaf instead (see sweepParticles)\n",
+    "#define BVH_STACK_SIZE 64\n",
+    "\n",
+    "// A node of the hierarchy. For n triangles, nodes [0, n-2] are internal\n",
+    "// nodes (node 0 is the root) and nodes [n-1, 2n-2] are leaves; this must\n",
+    "// match BVHNode in MeshCollider.h\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 bmin;\n",
+    "\n",
+    "    float4 bmax;\n",
+    "\n",
+    "    int left;      // Child node indices; -1 for leaves\n",
+    "\n",
+    "    int right;\n",
+    "\n",
+    "    int parent;    // -1 for the root\n",
+    "\n",
+    "    int triangle;  // Triangle index; -1 for internal nodes\n",
+    "\n",
+    "} BVHNode;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Spreads the lower 10 bits of v out so there are two zero bits between each\n",
+    " */\n",
+    "uint expandBits(uint v)\n",
+    "{\n",
+    "    v = (v * 0x00010001u) & 0xFF0000FFu;\n",
+    "    v = (v * 0x00000101u) & 0x0F00F00Fu;\n",
+    "    v = (v * 0x00000011u) & 0xC30C30C3u;\n",
+    "    v = (v * 0x00000005u) & 0x49249249u;\n",
+    "\n",
+    "    return v;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * 30-bit Morton code of a point in the unit cube\n",
+    " */\n",
+    "uint morton3D(float3 p)\n",
+    "{\n",
+    "    p = clamp(p * 1024.0f, 0.0f, 1023.0f);\n",
+    "\n",
+    "    return (expandBits((uint)p.x) << 2) | (expandBits((uint)p.y) << 1) | expandBits((uint)p.z);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Length of the longest common prefix of the keys of sorted leaves i and j,\n",
+    " * or -1 if j is out of range. Duplicate codes are disambiguated by index\n",
+    " */\n",
+    "int commonPrefix(global const uint* codes, int n, int i, int j)\n",
+    "{\n",
+    "    if (j < 0 || j >= n) {\n",
+    "        return -1;\n",
+    "    }\n",
+    "\n",
+    "    uint ci = codes[i];\n",
+    "    uint cj = codes[j];\n",
+    "\n",
+    "    if (ci == cj) {\n",
+    "        return 32 + clz((uint)(i ^ j));\n",
+    "    }\n",
+    "\n",
+    "    return clz(ci ^ cj);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if the segment a + t * dir, t in [0, 1], overlaps the box\n",
+    " */\n",
+    "bool segmentHitsBox(float3 a, float3 invDir, float3 bmin, float3 bmax)\n",
+    "{\n",
+    "    float3 t0   = (bmin - a) * invDir;\n",
+    "    float3 t1   = (bmax - a) * invDir;\n",
+    "    float3 tLo  = fmin(t0, t1);\n",
+    "    float3 tHi  = fmax(t0, t1);\n",
+    "    float  tMin = fmax(fmax(tLo.x, tLo.y), fmax(tLo.z, 0.0f));\n",
+    "    float  tMax = fmin(fmin(tHi.x, tHi.y), fmin(tHi.z, 1.0f));\n",
+    "\n",
+    "    return tMin <= tMax;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Moller-Trumbore intersection of the segment a + t * dir, t in [0, 1], with\n",
+    " * triangle (v0, v1, v2). Returns the hit parameter t, or a value > 1 if the\n",
+    " * segment misses the triangle\n",
+    " */\n",
+    "float segmentTriangle(float3 a, float3 dir, float3 v0, float3 v1, float3 v2)\n",
+    "{\n",
+    "    float3 e1 = v1 - v0;\n",
+    "    float3 e2 = v2 - v0;\n",
+    "    float3 p  = cross(dir, e2);\n",
+    "    float  det = dot(e1, p);\n",
+    "\n",
+    "    if (fabs(det) < 1.0e-12f) {\n",
+    "        return 2.0f;\n",
+    "    }\n",
+    "\n",
+    "    float  invDet = 1.0f / det;\n",
+    "    float3 s      = a - v0;\n",
+    "    float  u      = dot(s, p) * invDet;\n",
+    "\n",
+    "    if (u < 0.0f || u > 1.0f) {\n",
+    "        return 2.0f;\n",
+    "    }\n",
+    "\n",
+    "    float3 q = cross(s, e1);\n",
+    "    float  v = dot(dir, q) * invDet;\n",
+    "\n",
+    "    if (v < 0.0f || (u + v) > 1.0f) {\n",
+    "        return 2.0f;\n",
+    "    }\n",
+    "\n",
+    "    float t = dot(e2, q) * invDet;\n",
+    "\n",
+    "    return (t >= 0.0f) \? t : 2.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests the sphere swept from a to b = a + dir against one triangle, keeping\n",
+    " * the earliest crossing (tHit, nHit) and the closest overlap at the end of\n",
+    " * the sweep (dMin, nMin)\n",
+    " */\n",
+    "void sweepTriangle(float3 a\n",
+    "                  ,float3 b\n",
+    "                  ,float3 dir\n",
+    "                  ,float3 v0\n",
+    "                  ,float3 v1\n",
+    "                  ,float3 v2\n",
+    "                  ,float* tHit\n",
+    "                  ,float3* nHit\n",
+    "                  ,float* dMin\n",
+    "                  ,float3* nMin)\n",
+    "{\n",
+    "    float3 n = normalize(cross(v1 - v0, v2 - v0));\n",
+    "\n",
+    "    // Crossing:\n",
+    "\n",
+    "    float t = segmentTriangle(a, dir, v0, v1, v2);\n",
+    "\n",
+    "    if (t <= 1.0f && t < *tHit) {\n",
+    "        *tHit = t;\n",
+    "        *nHit = (dot(a - v0, n) < 0.0f) \? -n : n;\n",
+    "    }\n",
+    "\n",
+    "    // Overlap at the end of the sweep:\n",
+    "\n",
+    "    float3 q = closestPointOnTriangle(b, v0, v1, v2);\n",
+    "    float3 e = b - q;\n",
+    "    float  d = length(e);\n",
+    "\n",
+    "    if (d < *dMin) {\n",
+    "        *dMin = d;\n",
+    "        *nMin = (d > 1.0e-6f) \? (e / d) : ((dot(a - v0, n) < 0.0f) \? -n : n);\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Construction\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Applies the row-major affine transform m to the rest pose vertices\n",
+    " *\n",
+    " * Run 1D over the number of vertices\n",
+    " */\n",
+    "kernel void transformVertices(global const float4* restVertices\n",
+    "                             ,float16 m\n",
+    "                             ,int numVertices\n",
+    "                             ,global float4* vertices)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numVertices) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    vertices[id] = (float4)(transformPoint(m, restVertices[id].xyz), 1.0f);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Computes the Morton code of each triangle's centroid, relative to the\n",
+    " * bounds of the mesh\n",
+    " *\n",
+    " * Run 1D over the number of triangles\n",
+    " */\n",
+    "kernel void computeMortonCodes(global const float4* vertices\n",
+    "                              ,global const int* indices\n",
+    "                              ,int numTriangles\n",
+    "                              ,float4 sceneMin\n",
+    "                              ,float4 sceneInvExtent\n",
+    "                              ,global uint* codes\n",
+    "                              ,global int* triangleIds)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numTriangles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    float3 c = (vertices[indices[(3 * id) + 0]].xyz +\n",
+    "                vertices[indices[(3 * id) + 1]].xyz +\n",
+    "                vertices[indices[(3 * id) + 2]].xyz) / 3.0f;\n",
+    "\n",
+    "    codes[id]       = morton3D((c - sceneMin.xyz) * sceneInvExtent.xyz);\n",
+    "    triangleIds[id] = id;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Radix sort, pass 1 of 2 for the given bit: flags keys whose bit is clear\n",
+    " *\n",
+    " * Run 1D over the number of keys\n",
+    " */\n",
+    "kernel void radixFlags(global const uint* codes\n",
+    "                      ,int bit\n",
+    "                      ,int n\n",
+    "                      ,global int* flags)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= n) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    flags[id] = ((codes[id] >> bit) & 1u) \? 0 : 1;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Radix sort, pass 2 of 2 for the given bit: a stable split of the keys (and\n",
+    " * their values) using the exclusive prefix sums of the flags. Keys with the\n",
+    " * bit clear go first, in order, followed by the keys with the bit set\n",
+    " *\n",
+    " * Run 1D over the number of keys\n",
+    " */\n",
+    "kernel void radixScatter(global const uint* codesIn\n",
+    "                        ,global const int* idsIn\n",
+    "                        ,global const int* flags\n",
+    "                        ,global const int* offsets\n",
+    "                        ,int n\n",
+    "                        ,global uint* codesOut\n",
+    "                        ,global int* idsOut)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= n) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    int numClear = offsets[n - 1] + flags[n - 1];\n",
+    "    int dst      = flags[id] \? offsets[id] : (numClear + id - offsets[id]);\n",
+    "\n",
+    "    codesOut[dst] = codesIn[id];\n",
+    "    idsOut[dst]   = idsIn[id];\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Initializes the leaf nodes from the sorted triangle ids\n",
+    " *\n",
+    " * Run 1D over the number of triangles\n",
+    " */\n",
+    "kernel void initializeLeaves(global const int* sortedTriangleIds\n",
+    "                            ,int numTriangles\n",
+    "                            ,global BVHNode* nodes)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numTriangles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    int leaf = (numTriangles - 1) + id;\n",
+    "\n",
+    "    nodes[leaf].left     = -1;\n",
+    "    nodes[leaf].right    = -1;\n",
+    "    nodes[leaf].triangle = sortedTriangleIds[id];\n",
+    "\n",
+    "    // A single triangle forms a tree with only one (root) leaf:\n",
+    "\n",
+    "    if (numTriangles == 1) {\n",
+    "        nodes[leaf].parent = -1;\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Emits internal node i by finding the range of sorted leaves it covers and\n",
+    " * where that range splits between its two children (Karras, 2012)\n",
+    " *\n",
+    " * Run 1D over (number of triangles - 1)\n",
+    " */\n",
+    "kernel void buildHierarchy(global const uint* codes\n",
+    "                          ,int numTriangles\n",
+    "                          ,global BVHNode* nodes)\n",
+    "{\n",
+    "    int i = get_global_id(0);\n",
+    "    int n = numTriangles;\n",
+    "\n",
+    "    if (i >= (n - 1)) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    // Direction of the range:\n",
+    "\n",
+    "    int d    = (commonPrefix(codes, n, i, i + 1) - commonPrefix(codes, n, i, i - 1)) >= 0 \? 1 : -1;\n",
+    "    int dMin = commonPrefix(codes, n, i, i - d);\n",
+    "\n",
+    "    // Upper bound on the length of the range, then the exact other end:\n",
+    "\n",
+    "    int lMax = 2;\n",
+    "    while (commonPrefix(codes, n, i, i + (lMax * d)) > dMin) {\n",
+    "        lMax *= 2;\n",
+    "    }\n",
+    "\n",
+    "    int l = 0;\n",
+    "    for (int t = lMax / 2; t >= 1; t /= 2) {\n",
+    "        if (commonPrefix(codes, n, i, i + ((l + t) * d)) > dMin) {\n",
+    "            l += t;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    int j     = i + (l * d);\n",
+    "    int dNode = commonPrefix(codes, n, i, j);\n",
+    "\n",
+    "    // Binary search for the split position:\n",
+    "\n",
+    "    int s = 0;\n",
+    "    for (int div = 2; ; div *= 2) {\n",
+    "\n",
+    "        int t = (l + div - 1) / div;\n",
+    "\n",
+    "        if (commonPrefix(codes, n, i, i + ((s + t) * d)) > dNode) {\n",
+    "            s += t;\n",
+    "        }\n",
+    "\n",
+    "        if (t <= 1) {\n",
+    "            break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    int gamma = i + (s * d) + min(d, 0);\n",
+    "    int left  = (min(i, j) == gamma)     \? (n - 1) + gamma       : gamma;\n",
+    "    int right = (max(i, j) == gamma + 1) \? (n - 1) + gamma + 1   : gamma + 1;\n",
+    "\n",
+    "    nodes[i].left      = left;\n",
+    "    nodes[i].right     = right;\n",
+    "    nodes[i].triangle  = -1;\n",
+    "    nodes[left].parent  = i;\n",
+    "    nodes[right].parent = i;\n",
+    "\n",
+    "    if (i == 0) {\n",
+    "        nodes[i].parent = -1;\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Refitting\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Clears the per-internal-node visit counters used by refitHierarchy\n",
+    " *\n",
+    " * Run 1D over (number of triangles - 1)\n",
+    " */\n",
+    "kernel void resetRefitFlags(global int* flags)\n",
+    "{\n",
+    "    flags[get_global_id(0)] = 0;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Writes a node's bounds with atomic exchanges, and reads them back with\n",
+    " * atomic no-op ORs. The two children of a node are usually refit by\n",
+    " * different work-groups, and OpenCL 1.1 only makes plain global stores\n",
+    " * visible within a work-group; atomics on the same words are always\n",
+    " * coherent across the device, whatever caches plain loads go through\n",
+    " */\n",
+    "void storeBounds(global BVHNode* node, float4 bmin, float4 bmax)\n",
+    "{\n",
+    "    global float* lo = (global float*)&node->bmin;\n",
+    "    global float* hi = (global float*)&node->bmax;\n",
+    "\n",
+    "    atomic_xchg(lo + 0, bmin.x);\n",
+    "    atomic_xchg(lo + 1, bmin.y);\n",
+    "    atomic_xchg(lo + 2, bmin.z);\n",
+    "    atomic_xchg(hi + 0, bmax.x);\n",
+    "    atomic_xchg(hi + 1, bmax.y);\n",
+    "    atomic_xchg(hi + 2, bmax.z);\n",
+    "}\n",
+    "\n",
+    "void loadBounds(global BVHNode* node, float4* bmin, float4* bmax)\n",
+    "{\n",
+    "    volatile global int* lo = (volatile global int*)&node->bmin;\n",
+    "    volatile global int* hi = (volatile global int*)&node->bmax;\n",
+    "\n",
+    "    *bmin = (float4)(as_float(atomic_or(lo + 0, 0))\n",
+    "                    ,as_float(atomic_or(lo + 1, 0))\n",
+    "                    ,as_float(atomic_or(lo + 2, 0))\n",
+    "                    ,0.0f);\n",
+    "    *bmax = (float4)(as_float(atomic_or(hi + 0, 0))\n",
+    "                    ,as_float(atomic_or(hi + 1, 0))\n",
+    "                    ,as_float(atomic_or(hi + 2, 0))\n",
+    "                    ,0.0f);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Recomputes all node bounds bottom-up from the current vertex positions.\n",
+    " * Every leaf walks towards the root; at each internal node, the first child\n",
+    " * to arrive stops and the second computes the union of both children, so\n",
+    " * each node is processed exactly once, after both of its children\n",
+    " *\n",
+    " * A child's bounds are stored (see storeBounds()) and fenced before its\n",
+    " * arrival is counted on the parent's flag, and the second arrival fences\n",
+    " * again before loading both children's bounds, so it never combines a box\n",
+    " * the other work-item hasn't finished publishing\n",
+    " *\n",
+    " * Run 1D over the number of triangles\n",
+    " */\n",
+    "kernel void refitHierarchy(global const float4* vertices\n",
+    "                          ,global const int* indices\n",
+    "                          ,int numTriangles\n",
+    "                          ,float thickness\n",
+    "                          ,global BVHNode* nodes\n",
+    "                          ,global int* flags)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numTriangles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    int leaf = (numTriangles - 1) + id;\n",
+    "    int tri  = nodes[leaf].triangle;\n",
+    "\n",
+    "    float3 a = vertices[indices[(3 * tri) + 0]].xyz;\n",
+    "    float3 b = vertices[indices[(3 * tri) + 1]].xyz;\n",
+    "    float3 c = vertices[indices[(3 * tri) + 2]].xyz;\n",
+    "\n",
+    "    storeBounds(&nodes[leaf]\n",
+    "               ,(float4)(fmin(a, fmin(b, c)) - thickness, 0.0f)\n",
+    "               ,(float4)(fmax(a, fmax(b, c)) + thickness, 0.0f));\n",
+    "\n",
+    "    int node = nodes[leaf].parent;\n",
+    "\n",
+    "    while (node != -1) {\n",
+    "\n",
+    "        mem_fence(CLK_GLOBAL_MEM_FENCE);\n",
+    "\n",
+    "        if (atomic_inc(&flags[node]) == 0) {\n",
+    "            return;\n",
+    "        }\n",
+    "\n",
+    "        mem_fence(CLK_GLOBAL_MEM_FENCE);\n",
+    "\n",
+    "        float4 lmin, lmax, rmin, rmax;\n",
+    "\n",
+    "        loadBounds(&nodes[nodes[node].left], &lmin, &lmax);\n",
+    "        loadBounds(&nodes[nodes[node].right], &rmin, &rmax);\n",
+    "\n",
+    "        storeBounds(&nodes[node], fmin(lmin, rmin), fmax(lmax, rmax));\n",
+    "\n",
+    "        node = nodes[node].parent;\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Queries\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Sweeps every particle, as a sphere, from its current position to its\n",
+    " * predicted position and resolves collisions against the mesh:\n",
+    " *\n",
+    " * - If the swept center crosses a triangle, the predicted position is moved\n",
+    " *   back to the earliest crossing, offset by the sphere radius on the side the\n",
+    " *   particle came from. This keeps particles from tunneling through thin\n",
+    " *   geometry regardless of their speed\n",
+    " *\n",
+    " * - Otherwise, if the sphere at its predicted position overlaps a triangle,\n",
+    " *   it is pushed out along the direction to the closest point\n",
+    " *\n",
+    " * If the traversal stack is full, the children of a node aren't pushed;\n",
+    " * every leaf under the node is tested instead. A node's leaves are\n",
+    " * contiguous in Morton order, from its leftmost to its rightmost leaf, so\n",
+    " * nothing is skipped however deep the hierarchy gets\n",
+    " *\n",
+    " * Run 1D over the number of particles\n",
+    " */\n",
+    "kernel void sweepParticles(global const Parameters* parameters\n",
+    "                          ,global Particle* particles\n",
+    "                          ,int numParticles\n",
+    "                          ,global const float4* vertices\n",
+    "                          ,global const int* indices\n",
+    "                          ,global const BVHNode* nodes\n",
+    "                          ,float thickness)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    float  r   = parameters->particleRadius + thickness;\n",
+    "    float3 a   = particles[id].pos.xyz;\n",
+    "    float3 b   = particles[id].posStar.xyz;\n",
+    "    float3 dir = b - a;\n",
+    "\n",
+    "    float3 safeDir = select(dir, (float3)(1.0e-12f, 1.0e-12f, 1.0e-12f), isless(fabs(dir), (float3)(1.0e-12f, 1.0e-12f, 1.0e-12f)));\n",
+    "    float3 invDir  = 1.0f / safeDir;\n",
+    "\n",
+    "    float  tHit    = 2.0f;\n",
+    "    float3 nHit    = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    float  dMin    = r;\n",
+    "    float3 nMin    = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    int stack[BVH_STACK_SIZE];\n",
+    "    int top = 0;\n",
+    "\n",
+    "    stack[top++] = 0;\n",
+    "\n",
+    "    while (top > 0) {\n",
+    "\n",
+    "        int node = stack[--top];\n",
+    "\n",
+    "        // Node boxes are grown by the particle radius, so overlap tests\n",
+    "        // against the swept sphere reduce to tests against its center:\n",
+    "\n",
+    "        float3 bmin = nodes[node].bmin.xyz - parameters->particleRadius;\n",
+    "        float3 bmax = nodes[node].bmax.xyz + parameters->particleRadius;\n",
+    "\n",
+    "        if (!segmentHitsBox(a, invDir, bmin, bmax)) {\n",
+    "            continue;\n",
+    "        }\n",
+    "\n",
+    "        int tri = nodes[node].triangle;\n",
+    "\n",
+    "        if (tri != -1) {\n",
+    "            sweepTriangle(a, b, dir\n",
+    "                         ,vertices[indices[(3 * tri) + 0]].xyz\n",
+    "                         ,vertices[indices[(3 * tri) + 1]].xyz\n",
+    "                         ,vertices[indices[(3 * tri) + 2]].xyz\n",
+    "                         ,&tHit, &nHit, &dMin, &nMin);\n",
+    "            continue;\n",
+    "        }\n",
+    "\n",
+    "        if (top <= (BVH_STACK_SIZE - 2)) {\n",
+    "            stack[top++] = nodes[node].left;\n",
+    "            stack[top++] = nodes[node].right;\n",
+    "            continue;\n",
+    "        }\n",
+    "\n",
+    "        // The stack is full: test the node's leaves one by one\n",
+    "\n",
+    "        int first = node;\n",
+    "        int last  = node;\n",
+    "\n",
+    "        while (nodes[first].triangle == -1) {\n",
+    "            first = nodes[first].left;\n",
+    "        }\n",
+    "\n",
+    "        while (nodes[last].triangle == -1) {\n",
+    "            last = nodes[last].right;\n",
+    "        }\n",
+    "\n",
+    "        for (int leaf = first; leaf <= last; leaf++) {\n",
+    "\n",
+    "            if (!segmentHitsBox(a, invDir\n",
+    "                               ,nodes[leaf].bmin.xyz - parameters->particleRadius\n",
+    "                               ,nodes[leaf].bmax.xyz + parameters->particleRadius)) {\n",
+    "                continue;\n",
+    "            }\n",
+    "\n",
+    "            int t = nodes[leaf].triangle;\n",
+    "\n",
+    "            sweepTriangle(a, b, dir\n",
+    "                         ,vertices[indices[(3 * t) + 0]].xyz\n",
+    "                         ,vertices[indices[(3 * t) + 1]].xyz\n",
+    "                         ,vertices[indices[(3 * t) + 2]].xyz\n",
+    "                         ,&tHit, &nHit, &dMin, &nMin);\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    if (tHit <= 1.0f) {\n",
+    "        particles[id].posStar.xyz = a + (tHit * dir) + (nHit * r);\n",
+    "    } else if (dMin < r) {\n",
+    "        particles[id].posStar.xyz = b + (nMin * (r - dMin));\n",
+    "    }\n",
+    "}\n",
+    ""
+};
+
+// kernels/Pairwise.cl
+
+const char* const PAIRWISE_CL[] = {
+    "/*******************************************************************************\n",
+    " * Pairwise.cl\n",
+    " * - Symmetric evaluation of the SPH density estimate: every pair of\n",
+    " *   neighboring particles is visited once, through a half-shell stencil of\n",
+    " *   cells, and its kernel value is added to both particles. Used in place of\n",
+    " *   the gather-based estimateDensity kernel by pbf::PairwiseDensity.\n",
+    " *   Particles can be reordered by their number of pair candidates first, so\n",
+    " *   SIMD lanes run loops of similar length, and neighbors can be read from\n",
+    " *   an image mirroring the sorted positions, through the texture cache\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Common.cl\n",
+    " * - Types and helper functions shared by the kernel programs, including\n",
+    " *   the neighbor stencils of the solver's neighbor loops. Include with\n",
+    " *   #include \"kernels/Common.cl\"\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#ifndef PBF_KERNELS_COMMON_CL\n",
+    "#define PBF_KERNELS_COMMON_CL\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Types; these must match the host-side definitions in Simulation.h and\n",
+    " * Parameters.h exactly\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 pos;      // Current particle position (x)\n",
+    "\n",
+    "    float4 posStar;  // Predicted particle position (x*)\n",
+    "\n",
+    "    float4 vel;      // Current particle velocity (v)\n",
+    "\n",
+    "} Particle;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int particleIndex; // Index of particle in particle buffer\n",
+    "\n",
+    "    int cellI;         // Corresponding grid index in the x-axis\n",
+    "\n",
+    "    int cellJ;         // Corresponding grid index in the y-axis\n",
+    "\n",
+    "    int cellK;         // Corresponding grid index in the z-axis\n",
+    "\n",
+    "    int key;           // Linearized index key computed from the subscript\n",
+    "                       // (cellI, cellJ, cellK)\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} ParticlePosition;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int start;  // Start of the grid cell in sortedParticleToCell\n",
+    "\n",
+    "    int length;\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} GridCellOffset;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float particleRadius;\n",
+    "\n",
+    "    float smoothingRadius;\n",
+    "\n",
+    "    float relaxation;\n",
+    "\n",
+    "    float artificialPressureK;\n",
+    "\n",
+    "    float artificialPressureN;\n",
+    "\n",
+    "    float vorticityEpsilon;\n",
+    "\n",
+    "    float viscosityCoeff;\n",
+    "\n",
+    "} Parameters;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Spatial grid helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Linearizes the cell subscript (i, j, k)\n",
+    " */\n",
+    "int sub2ind(int i, int j, int k, int cellsX, int cellsY)\n",
+    "{\n",
+    "    return i + (j * cellsX) + (k * cellsX * cellsY);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Finds the (clamped) subscript of the grid cell containing p, using the same\n",
+    " * discretization as the discretizeParticlePositions kernel\n",
+    " */\n",
+    "int3 cellOf(float3 p\n",
+    "           ,int3 cells\n",
+    "           ,float3 minExt\n",
+    "           ,float3 maxExt)\n",
+    "{\n",
+    "    float3 cellSize = (maxExt - minExt) / convert_float3(cells);\n",
+    "    int3 cell       = convert_int3(floor((p - minExt) / cellSize));\n",
+    "\n",
+    "    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Neighbor stencils\n",
+    " *\n",
+    " * A neighbor loop visits the cells of the block starting at\n",
+    " * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping\n",
+    " * the cells rejected by stencilCellVisible():\n",
+    " *\n",
+    " *   int3 span  = (int3)(0, 0, 0);\n",
+    " *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);\n",
+    " *\n",
+    " *   for (int k = first.z; k < first.z + span.z; k++)\n",
+    " *     for (int j = first.y; j < first.y + span.y; j++)\n",
+    " *       for (int i = first.x; i < first.x + span.x; i++)\n",
+    " *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))\n",
+    " *           ... particles of cell (i, j, k) ...\n",
+    " *\n",
+    " * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the\n",
+    " * block only covers the cells the particle's h-ball touches, which is one\n",
+    " * or two cells per axis once cells are at least 2h wide; the solver sizes\n",
+    " * its grid that way while the stencil is selected. A program whose\n",
+    " * neighbor loops go through these helpers says so by putting\n",
+    " * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel\n",
+    " * it declares, so a stencil nothing runs isn't reported as active\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }\n",
+    "\n",
+    "/**\n",
+    " * Returns the lowest subscript of the block of cells that can hold neighbors\n",
+    " * of the particle at p, in cell, and the block's width per axis in span.\n",
+    " * The cells the particle's h-ball touches run from floor((p - h) / cellSize)\n",
+    " * to floor((p + h) / cellSize) on each axis, which is within one cell of\n",
+    " * the particle's own if cells are at least h wide; the block is exactly\n",
+    " * that range. Otherwise (cells compressed below h, or particles outside\n",
+    " * the grid) the full 3x3x3 block around the cell is used\n",
+    " */\n",
+    "int3 neighborStencilOrigin(float3 p\n",
+    "                          ,int3 cell\n",
+    "                          ,float3 minExt\n",
+    "                          ,float3 cellSize\n",
+    "                          ,float h\n",
+    "                          ,int3* span)\n",
+    "{\n",
+    "#ifdef PBF_HALF_CELL_STENCIL\n",
+    "\n",
+    "    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {\n",
+    "\n",
+    "        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));\n",
+    "        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));\n",
+    "\n",
+    "        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {\n",
+    "            *span = hi - lo + (int3)(1, 1, 1);\n",
+    "            return lo;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "    *span = (int3)(3, 3, 3);\n",
+    "\n",
+    "    return cell - (int3)(1, 1, 1);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Squared distance from p to the box of cell c\n",
+    " */\n",
+    "float cellDistance2(float3 p\n",
+    "                   ,int3 c\n",
+    "                   ,float3 minExt\n",
+    "                   ,float3 cellSize)\n",
+    "{\n",
+    "    float3 lo = minExt + (convert_float3(c) * cellSize);\n",
+    "    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));\n",
+    "\n",
+    "    return dot(d, d);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if cell c is in the grid and its box comes within h of p; cells\n",
+    " * that fail can be skipped without reading any of their particles\n",
+    " */\n",
+    "bool stencilCellVisible(float3 p\n",
+    "                       ,int3 c\n",
+    "                       ,int3 cells\n",
+    "                       ,float3 minExt\n",
+    "                       ,float3 cellSize\n",
+    "                       ,float h)\n",
+    "{\n",
+    "    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "        return false;\n",
+    "    }\n",
+    "\n",
+    "    return cellDistance2(p, c, minExt, cellSize) < (h * h);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * SPH smoothing kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Poly6 smoothing kernel, taking the squared distance r^2\n",
+    " */\n",
+    "float poly6(float r2, float h)\n",
+    "{\n",
+    "    float h2 = h * h;\n",
+    "\n",
+    "    if (r2 >= h2) {\n",
+    "        return 0.0f;\n",
+    "    }\n",
+    "\n",
+    "    float x = h2 - r2;\n",
+    "\n",
+    "    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Gradient of the spiky smoothing kernel with respect to r\n",
+    " */\n",
+    "float3 spikyGradient(float3 r, float h)\n",
+    "{\n",
+    "    float rLen = length(r);\n",
+    "\n",
+    "    if (rLen <= 0.0f || rLen >= h) {\n",
+    "        return (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    }\n",
+    "\n",
+    "    float x = h - rLen;\n",
+    "\n",
+    "    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Geometry helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Returns the point on triangle (a, b, c) closest to p. See \"Real-Time\n",
+    " * Collision Detection\" (Ericson, 2005), section 5.1.5\n",
+    " */\n",
+    "float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)\n",
+    "{\n",
+    "    float3 ab = b - a;\n",
+    "    float3 ac = c - a;\n",
+    "    float3 ap = p - a;\n",
+    "\n",
+    "    float d1 = dot(ab, ap);\n",
+    "    float d2 = dot(ac, ap);\n",
+    "\n",
+    "    if (d1 <= 0.0f && d2 <= 0.0f) {\n",
+    "        return a;\n",
+    "    }\n",
+    "\n",
+    "    float3 bp = p - b;\n",
+    "    float d3  = dot(ab, bp);\n",
+    "    float d4  = dot(ac, bp);\n",
+    "\n",
+    "    if (d3 >= 0.0f && d4 <= d3) {\n",
+    "        return b;\n",
+    "    }\n",
+    "\n",
+    "    float vc = (d1 * d4) - (d3 * d2);\n",
+    "\n",
+    "    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {\n",
+    "        return a + ((d1 / (d1 - d3)) * ab);\n",
+    "    }\n",
+    "\n",
+    "    float3 cp = p - c;\n",
+    "    float d5  = dot(ab, cp);\n",
+    "    float d6  = dot(ac, cp);\n",
+    "\n",
+    "    if (d6 >= 0.0f && d5 <= d6) {\n",
+    "        return c;\n",
+    "    }\n",
+    "\n",
+    "    float vb = (d5 * d2) - (d1 * d6);\n",
+    "\n",
+    "    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {\n",
+    "        return a + ((d2 / (d2 - d6)) * ac);\n",
+    "    }\n",
+    "\n",
+    "    float va = (d3 * d6) - (d5 * d4);\n",
+    "\n",
+    "    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {\n",
+    "        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));\n",
+    "    }\n",
+    "\n",
+    "    float denom = 1.0f / (va + vb + vc);\n",
+    "\n",
+    "    return a + (ab * (vb * denom)) + (ac * (vc * denom));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the point p by the row-major affine matrix m, using the same\n",
+    " * row-vector convention as ofMatrix4x4 (p' = p * m)\n",
+    " */\n",
+    "float3 transformPoint(float16 m, float3 p)\n",
+    "{\n",
+    "    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the direction d by the linear part of m\n",
+    " */\n",
+    "float3 transformDirection(float16 m, float3 d)\n",
+    "{\n",
+    "    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * External force fields\n",
+    " *\n",
+    " * Analytic descriptors of the external forces acting on the fluid, passed to\n",
+    " * kernels in a small constant buffer and evaluated per particle where the\n",
+    " * positions are predicted (see kernels/Forces.cl). These must match\n",
+    " * pbf::ForceField in ForceFields.h\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define FORCE_GRAVITY   0  // strength * direction, everywhere\n",
+    "#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),\n",
+    "                           // at rate strength\n",
+    "#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)\n",
+    "#define FORCE_VORTEX    3  // Around the axis direction through position\n",
+    "#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 position;   // Point or box center\n",
+    "\n",
+    "    float4 direction;  // Direction, axis or velocity, by type\n",
+    "\n",
+    "    float4 extent;     // Box half-extents (FORCE_DRAG)\n",
+    "\n",
+    "    int type;          // FORCE_*\n",
+    "\n",
+    "    float strength;\n",
+    "\n",
+    "    float radius;      // Falloff radius of attractors, vortices and wind;\n",
+    "                       // <= 0 for no falloff\n",
+    "\n",
+    "    int __padding;\n",
+    "\n",
+    "} ForceField;\n",
+    "\n",
+    "/**\n",
+    " * Linear falloff of a field with distance d: 1 at the source, 0 at radius\n",
+    " * and beyond; 1 everywhere if radius <= 0\n",
+    " */\n",
+    "float forceFalloff(float d, float radius)\n",
+    "{\n",
+    "    return radius > 0.0f \? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Sums the acceleration of numFields force fields on a particle at p moving\n",
+    " * at velocity v\n",
+    " */\n",
+    "float3 evaluateForceFields(constant ForceField* fields\n",
+    "                          ,int numFields\n",
+    "                          ,float3 p\n",
+    "                          ,float3 v)\n",
+    "{\n",
+    "    float3 a = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    for (int i = 0; i < numFields; i++) {\n",
+    "\n",
+    "        ForceField f = fields[i];\n",
+    "\n",
+    "        float3 r = f.position.xyz - p;\n",
+    "        float d  = length(r);\n",
+    "\n",
+    "        switch (f.type) {\n",
+    "\n",
+    "            case FORCE_GRAVITY:\n",
+    "                a += f.strength * f.direction.xyz;\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_WIND:\n",
+    "                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_ATTRACTOR:\n",
+    "                if (d > 0.0f) {\n",
+    "                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_VORTEX:\n",
+    "                {\n",
+    "                    float3 axis  = normalize(f.direction.xyz);\n",
+    "                    float3 perp  = r - (dot(r, axis) * axis);\n",
+    "                    float dPerp  = length(perp);\n",
+    "\n",
+    "                    if (dPerp > 0.0f) {\n",
+    "                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);\n",
+    "                    }\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_DRAG:\n",
+    "                if (all(isless(fabs(r), f.extent.xyz))) {\n",
+    "                    a -= f.strength * v;\n",
+    "                }\n",
+    "                break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return a;\n",
+    "}\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Half-shell stencil\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * The 13 neighbors of a cell that come after it in (z, y, x) order. Pairs in\n",
+    " * a cell and the cells of its half shell cover every pair of particles in\n",
+    " * adjacent cells exactly once\n",
+    " */\n",
+    "constant int HALF_SHELL[13][3] = {\n",
+    "    {  1,  0,  0 },\n",
+    "    { -1,  1,  0 }, {  0,  1,  0 }, {  1,  1,  0 },\n",
+    "    { -1, -1,  1 }, {  0, -1,  1 }, {  1, -1,  1 },\n",
+    "    { -1,  0,  1 }, {  0,  0,  1 }, {  1,  0,  1 },\n",
+    "    { -1,  1,  1 }, {  0,  1,  1 }, {  1,  1,  1 }\n",
+    "};\n",
+    "\n",
+    "/**\n",
+    " * Cells of the same color are at least 3 cells apart in x and y and 2 in z,\n",
+    " * so the cells they and their half shells write to never overlap (the half\n",
+    " * shell spans -1..1 in x and y, and 0..1 in z)\n",
+    " */\n",
+    "#define COLORS_X 3\n",
+    "#define COLORS_Y 3\n",
+    "#define COLORS_Z 2\n",
+    "\n",
+    "/**\n",
+    " * Balanced runs bin particles by their number of pair candidates, in bins\n",
+    " * PAIR_BIN_WIDTH candidates wide, the last one open ended; these must match\n",
+    " * PairwiseDensity::BINS and BIN_WIDTH\n",
+    " */\n",
+    "#define PAIR_BINS      16\n",
+    "#define PAIR_BIN_WIDTH 8\n",
+    "\n",
+    "/**\n",
+    " * Reads of the sorted position image (see mirrorSortedPositions): texel s,\n",
+    " * counting along rows, holds the predicted position of sorted particle s,\n",
+    " * and its particle index in w\n",
+    " */\n",
+    "const sampler_t NEIGHBOR_SAMPLER = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_NONE | CLK_FILTER_NEAREST;\n",
+    "\n",
+    "float4 readSorted(read_only image2d_t positions, int s)\n",
+    "{\n",
+    "    int width = get_image_width(positions);\n",
+    "\n",
+    "    return read_imagef(positions, NEIGHBOR_SAMPLER, (int2)(s % width, s / width));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Adds value to a float in global memory, atomically\n",
+    " */\n",
+    "void atomicAddFloat(volatile global float* address, float value)\n",
+    "{\n",
+    "    union { unsigned int u; float f; } expected, next;\n",
+    "\n",
+    "    do {\n",
+    "        expected.f = *address;\n",
+    "        next.f     = expected.f + value;\n",
+    "    } while (atomic_cmpxchg((volatile global unsigned int*)address, expected.u, next.u) != expected.u);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * The work of the sorted particle s: pairs with the particles after it in\n",
+    " * its own cell, plus all pairs with the particles of its cell's half shell\n",
+    " */\n",
+    "int pairCandidates(int s\n",
+    "                  ,global const ParticlePosition* sortedParticleToCell\n",
+    "                  ,global const GridCellOffset* gridCellOffsets\n",
+    "                  ,int3 cells)\n",
+    "{\n",
+    "    ParticlePosition pp = sortedParticleToCell[s];\n",
+    "\n",
+    "    int3 cell = (int3)(pp.cellI, pp.cellJ, pp.cellK);\n",
+    "\n",
+    "    GridCellOffset own = gridCellOffsets[sub2ind(cell.x, cell.y, cell.z, cells.x, cells.y)];\n",
+    "\n",
+    "    int candidates = (own.start + own.length) - (s + 1);\n",
+    "\n",
+    "    for (int n = 0; n < 13; n++) {\n",
+    "\n",
+    "        int3 c = cell + (int3)(HALF_SHELL[n][0], HALF_SHELL[n][1], HALF_SHELL[n][2]);\n",
+    "\n",
+    "        if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "            continue;\n",
+    "        }\n",
+    "\n",
+    "        GridCellOffset offset = gridCellOffsets[sub2ind(c.x, c.y, c.z, cells.x, cells.y)];\n",
+    "\n",
+    "        if (offset.start != -1) {\n",
+    "            candidates += offset.length;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return candidates;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Adds the pairs of the sorted particle s to the densities of both\n",
+    " * particles; see accumulateDensityPairs\n",
+    " */\n",
+    "void accumulateParticlePairs(int s\n",
+    "                            ,float h\n",
+    "                            ,global const Particle* particles\n",
+    "                            ,global const ParticlePosition* sortedParticleToCell\n",
+    "                            ,global const GridCellOffset* gridCellOffsets\n",
+    "                            ,int3 cells\n",
+    "                            ,volatile global float* density)\n",
+    "{\n",
+    "    ParticlePosition pp = sortedParticleToCell[s];\n",
+    "\n",
+    "    float3 p  = particles[pp.particleIndex].posStar.xyz;\n",
+    "    float sum = 0.0f;\n",
+    "    int3 cell = (int3)(pp.cellI, pp.cellJ, pp.cellK);\n",
+    "\n",
+    "    GridCellOffset own = gridCellOffsets[sub2ind(cell.x, cell.y, cell.z, cells.x, cells.y)];\n",
+    "\n",
+    "    for (int t = s + 1; t < (own.start + own.length); t++) {\n",
+    "\n",
+    "        int other = sortedParticleToCell[t].particleIndex;\n",
+    "        float3 r  = p - particles[other].posStar.xyz;\n",
+    "        float W   = poly6(dot(r, r), h);\n",
+    "\n",
+    "        if (W > 0.0f) {\n",
+    "            sum += W;\n",
+    "            atomicAddFloat(&density[other], W);\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    for (int n = 0; n < 13; n++) {\n",
+    "\n",
+    "        int3 c = cell + (int3)(HALF_SHELL[n][0], HALF_SHELL[n][1], HALF_SHELL[n][2]);\n",
+    "\n",
+    "        if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "            continue;\n",
+    "        }\n",
+    "\n",
+    "        GridCellOffset offset = gridCellOffsets[sub2ind(c.x, c.y, c.z, cells.x, cells.y)];\n",
+    "\n",
+    "        if (offset.start == -1) {\n",
+    "            continue;\n",
+    "        }\n",
+    "\n",
+    "        for (int t = offset.start; t < (offset.start + offset.length); t++) {\n",
+    "\n",
+    "            int other = sortedParticleToCell[t].particleIndex;\n",
+    "            float3 r  = p - particles[other].posStar.xyz;\n",
+    "            float W   = poly6(dot(r, r), h);\n",
+    "\n",
+    "            if (W > 0.0f) {\n",
+    "                sum += W;\n",
+    "                atomicAddFloat(&density[other], W);\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    atomicAddFloat(&density[pp.particleIndex], sum);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Like accumulateParticlePairs, but positions and particle indices of the\n",
+    " * sorted particles are read from the sorted position image\n",
+    " */\n",
+    "void accumulateParticlePairsImage(int s\n",
+    "                                 ,float h\n",
+    "                                 ,global const ParticlePosition* sortedParticleToCell\n",
+    "                                 ,global const GridCellOffset* gridCellOffsets\n",
+    "                                 ,int3 cells\n",
+    "                                 ,read_only image2d_t positions\n",
+    "                                 ,volatile global float* density)\n",
+    "{\n",
+    "    ParticlePosition pp = sortedParticleToCell[s];\n",
+    "\n",
+    "    float3 p  = readSorted(positions, s).xyz;\n",
+    "    float sum = 0.0f;\n",
+    "    int3 cell = (int3)(pp.cellI, pp.cellJ, pp.cellK);\n",
+    "\n",
+    "    GridCellOffset own = gridCellOffsets[sub2ind(cell.x, cell.y, cell.z, cells.x, cells.y)];\n",
+    "\n",
+    "    for (int t = s + 1; t < (own.start + own.length); t++) {\n",
+    "\n",
+    "        float4 q = readSorted(positions, t);\n",
+    "        float3 r = p - q.xyz;\n",
+    "        float W  = poly6(dot(r, r), h);\n",
+    "\n",
+    "        if (W > 0.0f) {\n",
+    "            sum += W;\n",
+    "            atomicAddFloat(&density[(int)q.w], W);\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    for (int n = 0; n < 13; n++) {\n",
+    "\n",
+    "        int3 c = cell + (int3)(HALF_SHELL[n][0], HALF_SHELL[n][1], HALF_SHELL[n][2]);\n",
+    "\n",
+    "        if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "            continue;\n",
+    "        }\n",
+    "\n",
+    "        GridCellOffset offset = gridCellOffsets[sub2ind(c.x, c.y, c.z, cells.x, cells.y)];\n",
+    "\n",
+    "        if (offset.start == -1) {\n",
+    "            continue;\n",
+    "        }\n",
+    "\n",
+    "        for (int t = offset.start; t < (offset.start + offset.length); t++) {\n",
+    "\n",
+    "            float4 q = readSorted(positions, t);\n",
+    "            float3 r = p - q.xyz;\n",
+    "            float W  = poly6(dot(r, r), h);\n",
+    "\n",
+    "            if (W > 0.0f) {\n",
+    "                sum += W;\n",
+    "                atomicAddFloat(&density[(int)q.w], W);\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    atomicAddFloat(&density[pp.particleIndex], sum);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Starts every particle's density at its own contribution, W(0, h)\n",
+    " *\n",
+    " * Run 1D over numParticles\n",
+    " */\n",
+    "kernel void resetPairDensity(global const Parameters* parameters\n",
+    "                            ,int numParticles\n",
+    "                            ,global float* density)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    density[id] = poly6(0.0f, parameters->smoothingRadius);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Bins a sorted particle by its number of pair candidates, counting the\n",
+    " * particles per bin. binCounts must be zero (see scanPairBins)\n",
+    " *\n",
+    " * Run 1D over numParticles\n",
+    " */\n",
+    "kernel void countPairCandidates(global const ParticlePosition* sortedParticleToCell\n",
+    "                               ,global const GridCellOffset* gridCellOffsets\n",
+    "                               ,int numParticles\n",
+    "                               ,int cellsX\n",
+    "                               ,int cellsY\n",
+    "                               ,int cellsZ\n",
+    "                               ,global int* particleBin\n",
+    "                               ,volatile global int* binCounts)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    int candidates = pairCandidates(id, sortedParticleToCell, gridCellOffsets, (int3)(cellsX, cellsY, cellsZ));\n",
+    "    int bin        = min(candidates / PAIR_BIN_WIDTH, PAIR_BINS - 1);\n",
+    "\n",
+    "    particleBin[id] = bin;\n",
+    "\n",
+    "    atomic_inc(&binCounts[bin]);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Turns the bin counts into the offsets each bin starts at in the work\n",
+    " * list, heaviest bin first, so the longest runs start earliest. Clears the\n",
+    " * counts for the next step\n",
+    " *\n",
+    " * Run with a single work-item\n",
+    " */\n",
+    "kernel void scanPairBins(global int* binCounts\n",
+    "                        ,global int* binCursors)\n",
+    "{\n",
+    "    int offset = 0;\n",
+    "\n",
+    "    for (int bin = PAIR_BINS - 1; bin >= 0; bin--) {\n",
+    "        binCursors[bin] = offset;\n",
+    "        offset         += binCounts[bin];\n",
+    "        binCounts[bin]  = 0;\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Writes every sorted particle into the work list range of its bin. Order\n",
+    " * within a bin is arbitrary\n",
+    " *\n",
+    " * Run 1D over numParticles\n",
+    " */\n",
+    "kernel void scatterPairWork(global const int* particleBin\n",
+    "                           ,int numParticles\n",
+    "                           ,volatile global int* binCursors\n",
+    "                           ,global int* workList)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    workList[atomic_inc(&binCursors[particleBin[id]])] = id;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Adds the pairs of one particle to the densities of both particles: the\n",
+    " * particles after it in its own cell, and all particles of its cell's half\n",
+    " * shell. The particle's own sum is added once at the end; its partners' are\n",
+    " * added atomically, as other work-items add to them too\n",
+    " *\n",
+    " * Run 1D over numParticles, in sorted order\n",
+    " */\n",
+    "kernel void accumulateDensityPairs(global const Parameters* parameters\n",
+    "                                  ,global const Particle* particles\n",
+    "                                  ,global const ParticlePosition* sortedParticleToCell\n",
+    "                                  ,global const GridCellOffset* gridCellOffsets\n",
+    "                                  ,int numParticles\n",
+    "                                  ,int cellsX\n",
+    "                                  ,int cellsY\n",
+    "                                  ,int cellsZ\n",
+    "                                  ,volatile global float* density)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    accumulateParticlePairs(id\n",
+    "                           ,parameters->smoothingRadius\n",
+    "                           ,particles\n",
+    "                           ,sortedParticleToCell\n",
+    "                           ,gridCellOffsets\n",
+    "                           ,(int3)(cellsX, cellsY, cellsZ)\n",
+    "                           ,density);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Like accumulateDensityPairs, but work-item i handles the sorted particle\n",
+    " * workList[i] (see scatterPairWork), so the particles sharing SIMD lanes\n",
+    " * have similar numbers of candidates\n",
+    " *\n",
+    " * Run 1D over numParticles\n",
+    " */\n",
+    "kernel void accumulateDensityPairsBalanced(global const Parameters* parameters\n",
+    "                                          ,global const Particle* particles\n",
+    "                                          ,global const ParticlePosition* sortedParticleToCell\n",
+    "                                          ,global const GridCellOffset* gridCellOffsets\n",
+    "                                          ,int numParticles\n",
+    "                                          ,int cellsX\n",
+    "                                          ,int cellsY\n",
+    "                                          ,int cellsZ\n",
+    "                                          ,global const int* workList\n",
+    "                                          ,volatile global float* density)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    accumulateParticlePairs(workList[id]\n",
+    "                           ,parameters->smoothingRadius\n",
+    "                           ,particles\n",
+    "                           ,sortedParticleToCell\n",
+    "                           ,gridCellOffsets\n",
+    "                           ,(int3)(cellsX, cellsY, cellsZ)\n",
+    "                           ,density);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Copies the predicted position of every particle, in sorted order, into\n",
+    " * the sorted position image, with the particle index in w (exact up to\n",
+    " * 2^24 particles)\n",
+    " *\n",
+    " * Run 1D over numParticles\n",
+    " */\n",
+    "kernel void mirrorSortedPositions(global const Particle* particles\n",
+    "                                 ,global const ParticlePosition* sortedParticleToCell\n",
+    "                                 ,int numParticles\n",
+    "                                 ,write_only image2d_t positions)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    int index = sortedParticleToCell[id].particleIndex;\n",
+    "    int width = get_image_width(positions);\n",
+    "\n",
+    "    write_imagef(positions\n",
+    "                ,(int2)(id % width, id / width)\n",
+    "                ,(float4)(particles[index].posStar.xyz, (float)index));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Like accumulateDensityPairs, reading the sorted particles through the\n",
+    " * sorted position image. If workList is given (balanced runs), work-item i\n",
+    " * handles the sorted particle workList[i]\n",
+    " *\n",
+    " * Run 1D over numParticles, after mirrorSortedPositions\n",
+    " */\n",
+    "kernel void accumulateDensityPairsImage(global const Parameters* parameters\n",
+    "                                       ,global const ParticlePosition* sortedParticleToCell\n",
+    "                                       ,global const GridCellOffset* gridCellOffsets\n",
+    "                                       ,int numParticles\n",
+    "                                       ,int cellsX\n",
+    "                                       ,int cellsY\n",
+    "                                       ,int cellsZ\n",
+    "                                       ,read_only image2d_t positions\n",
+    "                                       ,global const int* workList\n",
+    "                                       ,volatile global float* density)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    accumulateParticlePairsImage(workList != 0 \? workList[id] : id\n",
+    "                                ,parameters->smoothingRadius\n",
+    "                                ,sortedParticleToCell\n",
+    "                                ,gridCellOffsets\n",
+    "                                ,(int3)(cellsX, cellsY, cellsZ)\n",
+    "                                ,positions\n",
+    "                                ,density);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Like accumulateDensityPairs, but one work-item handles all pairs of one\n",
+    " * cell of the given color, with plain stores: no other work-item of the\n",
+    " * launch writes to the same particles. Meant for CPU devices, where the\n",
+    " * atomics cost more than the extra launches. Run once per color\n",
+    " *\n",
+    " * Run 1D over the number of cells of the color (see\n",
+    " * PairwiseDensity::cellsOfColor)\n",
+    " */\n",
+    "kernel void accumulateDensityPairsColored(global const Parameters* parameters\n",
+    "                                         ,global const Particle* particles\n",
+    "                                         ,global const ParticlePosition* sortedParticleToCell\n",
+    "                                         ,global const GridCellOffset* gridCellOffsets\n",
+    "                                         ,int cellsX\n",
+    "                                         ,int cellsY\n",
+    "                                         ,int cellsZ\n",
+    "                                         ,int4 color\n",
+    "                                         ,global float* density)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    // Cells of this color per axis:\n",
+    "\n",
+    "    int nx = (cellsX - color.x + COLORS_X - 1) / COLORS_X;\n",
+    "    int ny = (cellsY - color.y + COLORS_Y - 1) / COLORS_Y;\n",
+    "    int nz = (cellsZ - color.z + COLORS_Z - 1) / COLORS_Z;\n",
+    "\n",
+    "    if (id >= nx * ny * nz) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    int3 cell  = (int3)(color.x + ((id % nx) * COLORS_X)\n",
+    "                       ,color.y + (((id / nx) % ny) * COLORS_Y)\n",
+    "                       ,color.z + ((id / (nx * ny)) * COLORS_Z));\n",
+    "    int3 cells = (int3)(cellsX, cellsY, cellsZ);\n",
+    "    float h    = parameters->smoothingRadius;\n",
+    "\n",
+    "    GridCellOffset own = gridCellOffsets[sub2ind(cell.x, cell.y, cell.z, cellsX, cellsY)];\n",
+    "\n",
+    "    if (own.start == -1) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    for (int a = own.start; a < (own.start + own.length); a++) {\n",
+    "\n",
+    "        int self = sortedParticleToCell[a].particleIndex;\n",
+    "        float3 p = particles[self].posStar.xyz;\n",
+    "\n",
+    "        for (int s = a + 1; s < (own.start + own.length); s++) {\n",
+    "\n",
+    "            int other = sortedParticleToCell[s].particleIndex;\n",
+    "            float3 r  = p - particles[other].posStar.xyz;\n",
+    "            float W   = poly6(dot(r, r), h);\n",
+    "\n",
+    "            density[self]  += W;\n",
+    "            density[other] += W;\n",
+    "        }\n",
+    "\n",
+    "        for (int n = 0; n < 13; n++) {\n",
+    "\n",
+    "            int3 c = cell + (int3)(HALF_SHELL[n][0], HALF_SHELL[n][1], HALF_SHELL[n][2]);\n",
+    "\n",
+    "            if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "                continue;\n",
+    "            }\n",
+    "\n",
+    "            GridCellOffset offset = gridCellOffsets[sub2ind(c.x, c.y, c.z, cellsX, cellsY)];\n",
+    "\n",
+    "            if (offset.start == -1) {\n",
+    "                continue;\n",
+    "            }\n",
+    "\n",
+    "            for (int s = offset.start; s < (offset.start + offset.length); s++) {\n",
+    "\n",
+    "                int other = sortedParticleToCell[s].particleIndex;\n",
+    "                float3 r  = p - particles[other].posStar.xyz;\n",
+    "                float W   = poly6(dot(r, r), h);\n",
+    "\n",
+    "                density[self]  += W;\n",
+    "                density[other] += W;\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "}\n",
+    ""
+};
+
+// kernels/Query.cl
+
+const char* const QUERY_CL[] = {
+    "/*******************************************************************************\n",
+    " * Query.cl\n",
+    " * - Batched spatial queries on the sorted grid of the last step: the\n",
+    " *   particles in spheres or boxes, as compacted lists of particle indices,\n",
+    " *   and SPH estimates of density and velocity at probe points. Used by\n",
+    " *   pbf::SpatialQueries\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Common.cl\n",
+    " * - Types and helper functions shared by the kernel programs, including\n",
+    " *   the neighbor stencils of the solver's neighbor loops. Include with\n",
+    " *   #include \"kernels/Common.cl\"\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#ifndef PBF_KERNELS_COMMON_CL\n",
+    "#define PBF_KERNELS_COMMON_CL\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Types; these must match the host-side definitions in Simulation.h and\n",
+    " * Parameters.h exactly\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 pos;      // Current particle position (x)\n",
+    "\n",
+    "    float4 posStar;  // Predicted particle position (x*)\n",
+    "\n",
+    "    float4 vel;      // Current particle velocity (v)\n",
+    "\n",
+    "} Particle;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int particleIndex; // Index of particle in particle buffer\n",
+    "\n",
+    "    int cellI;         // Corresponding grid index in the x-axis\n",
+    "\n",
+    "    int cellJ;         // Corresponding grid index in the y-axis\n",
+    "\n",
+    "    int cellK;         // Corresponding grid index in the z-axis\n",
+    "\n",
+    "    int key;           // Linearized index key computed from the subscript\n",
+    "                       // (cellI, cellJ, cellK)\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} ParticlePosition;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int start;  // Start of the grid cell in sortedParticleToCell\n",
+    "\n",
+    "    int length;\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} GridCellOffset;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float particleRadius;\n",
+    "\n",
+    "    float smoothingRadius;\n",
+    "\n",
+    "    float relaxation;\n",
+    "\n",
+    "    float artificialPressureK;\n",
+    "\n",
+    "    float artificialPressureN;\n",
+    "\n",
+    "    float vorticityEpsilon;\n",
+    "\n",
+    "    float viscosityCoeff;\n",
+    "\n",
+    "} Parameters;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Spatial grid helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Linearizes the cell subscript (i, j, k)\n",
+    " */\n",
+    "int sub2ind(int i, int j, int k, int cellsX, int cellsY)\n",
+    "{\n",
+    "    return i + (j * cellsX) + (k * cellsX * cellsY);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Finds the (clamped) subscript of the grid cell containing p, using the same\n",
+    " * discretization as the discretizeParticlePositions kernel\n",
+    " */\n",
+    "int3 cellOf(float3 p\n",
+    "           ,int3 cells\n",
+    "           ,float3 minExt\n",
+    "           ,float3 maxExt)\n",
+    "{\n",
+    "    float3 cellSize = (maxExt - minExt) / convert_float3(cells);\n",
+    "    int3 cell       = convert_int3(floor((p - minExt) / cellSize));\n",
+    "\n",
+    "    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Neighbor stencils\n",
+    " *\n",
+    " * A neighbor loop visits the cells of the block starting at\n",
+    " * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping\n",
+    " * the cells rejected by stencilCellVisible():\n",
+    " *\n",
+    " *   int3 span  = (int3)(0, 0, 0);\n",
+    " *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);\n",
+    " *\n",
+    " *   for (int k = first.z; k < first.z + span.z; k++)\n",
+    " *     for (int j = first.y; j < first.y + span.y; j++)\n",
+    " *       for (int i = first.x; i < first.x + span.x; i++)\n",
+    " *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))\n",
+    " *           ... particles of cell (i, j, k) ...\n",
+    " *\n",
+    " * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the\n",
+    " * block only covers the cells the particle's h-ball touches, which is one\n",
+    " * or two cells per axis once cells are at least 2h wide; the solver sizes\n",
+    " * its grid that way while the stencil is selected. A program whose\n",
+    " * neighbor loops go through these helpers says so by putting\n",
+    " * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel\n",
+    " * it declares, so a stencil nothing runs isn't reported as active\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }\n",
+    "\n",
+    "/**\n",
+    " * Returns the lowest subscript of the block of cells that can hold neighbors\n",
+    " * of the particle at p, in cell, and the block's width per axis in span.\n",
+    " * The cells the particle's h-ball touches run from floor((p - h) / cellSize)\n",
+    " * to floor((p + h) / cellSize) on each axis, which is within one cell of\n",
+    " * the particle's own if cells are at least h wide; the block is exactly\n",
+    " * that range. Otherwise (cells compressed below h, or particles outside\n",
+    " * the grid) the full 3x3x3 block around the cell is used\n",
+    " */\n",
+    "int3 neighborStencilOrigin(float3 p\n",
+    "                          ,int3 cell\n",
+    "                          ,float3 minExt\n",
+    "                          ,float3 cellSize\n",
+    "                          ,float h\n",
+    "                          ,int3* span)\n",
+    "{\n",
+    "#ifdef PBF_HALF_CELL_STENCIL\n",
+    "\n",
+    "    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {\n",
+    "\n",
+    "        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));\n",
+    "        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));\n",
+    "\n",
+    "        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {\n",
+    "            *span = hi - lo + (int3)(1, 1, 1);\n",
+    "            return lo;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "    *span = (int3)(3, 3, 3);\n",
+    "\n",
+    "    return cell - (int3)(1, 1, 1);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Squared distance from p to the box of cell c\n",
+    " */\n",
+    "float cellDistance2(float3 p\n",
+    "                   ,int3 c\n",
+    "                   ,float3 minExt\n",
+    "                   ,float3 cellSize)\n",
+    "{\n",
+    "    float3 lo = minExt + (convert_float3(c) * cellSize);\n",
+    "    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));\n",
+    "\n",
+    "    return dot(d, d);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if cell c is in the grid and its box comes within h of p; cells\n",
+    " * that fail can be skipped without reading any of their particles\n",
+    " */\n",
+    "bool stencilCellVisible(float3 p\n",
+    "                       ,int3 c\n",
+    "                       ,int3 cells\n",
+    "                       ,float3 minExt\n",
+    "                       ,float3 cellSize\n",
+    "                       ,float h)\n",
+    "{\n",
+    "    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "        return false;\n",
+    "    }\n",
+    "\n",
+    "    return cellDistance2(p, c, minExt, cellSize) < (h * h);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * SPH smoothing kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Poly6 smoothing kernel, taking the squared distance r^2\n",
+    " */\n",
+    "float poly6(float r2, float h)\n",
+    "{\n",
+    "    float h2 = h * h;\n",
+    "\n",
+    "    if (r2 >= h2) {\n",
+    "        return 0.0f;\n",
+    "    }\n",
+    "\n",
+    "    float x = h2 - r2;\n",
+    "\n",
+    "    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Gradient of the spiky smoothing kernel with respect to r\n",
+    " */\n",
+    "float3 spikyGradient(float3 r, float h)\n",
+    "{\n",
+    "    float rLen = length(r);\n",
+    "\n",
+    "    if (rLen <= 0.0f || rLen >= h) {\n",
+    "        return (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    }\n",
+    "\n",
+    "    float x = h - rLen;\n",
+    "\n",
+    "    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Geometry helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Returns the point on triangle (a, b, c) closest to p. See \"Real-Time\n",
+    " * Collision Detection\" (Ericson, 2005), section 5.1.5\n",
+    " */\n",
+    "float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)\n",
+    "{\n",
+    "    float3 ab = b - a;\n",
+    "    float3 ac = c - a;\n",
+    "    float3 ap = p - a;\n",
+    "\n",
+    "    float d1 = dot(ab, ap);\n",
+    "    float d2 = dot(ac, ap);\n",
+    "\n",
+    "    if (d1 <= 0.0f && d2 <= 0.0f) {\n",
+    "        return a;\n",
+    "    }\n",
+    "\n",
+    "    float3 bp = p - b;\n",
+    "    float d3  = dot(ab, bp);\n",
+    "    float d4  = dot(ac, bp);\n",
+    "\n",
+    "    if (d3 >= 0.0f && d4 <= d3) {\n",
+    "        return b;\n",
+    "    }\n",
+    "\n",
+    "    float vc = (d1 * d4) - (d3 * d2);\n",
+    "\n",
+    "    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {\n",
+    "        return a + ((d1 / (d1 - d3)) * ab);\n",
+    "    }\n",
+    "\n",
+    "    float3 cp = p - c;\n",
+    "    float d5  = dot(ab, cp);\n",
+    "    float d6  = dot(ac, cp);\n",
+    "\n",
+    "    if (d6 >= 0.0f && d5 <= d6) {\n",
+    "        return c;\n",
+    "    }\n",
+    "\n",
+    "    float vb = (d5 * d2) - (d1 * d6);\n",
+    "\n",
+    "    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {\n",
+    "        return a + ((d2 / (d2 - d6)) * ac);\n",
+    "    }\n",
+    "\n",
+    "    float va = (d3 * d6) - (d5 * d4);\n",
+    "\n",
+    "    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {\n",
+    "        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));\n",
+    "    }\n",
+    "\n",
+    "    float denom = 1.0f / (va + vb + vc);\n",
+    "\n",
+    "    return a + (ab * (vb * denom)) + (ac * (vc * denom));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the point p by the row-major affine matrix m, using the same\n",
+    " * row-vector convention as ofMatrix4x4 (p' = p * m)\n",
+    " */\n",
+    "float3 transformPoint(float16 m, float3 p)\n",
+    "{\n",
+    "    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the direction d by the linear part of m\n",
+    " */\n",
+    "float3 transformDirection(float16 m, float3 d)\n",
+    "{\n",
+    "    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * External force fields\n",
+    " *\n",
+    " * Analytic descriptors of the external forces acting on the fluid, passed to\n",
+    " * kernels in a small constant buffer and evaluated per particle where the\n",
+    " * positions are predicted (see kernels/Forces.cl). These must match\n",
+    " * pbf::ForceField in ForceFields.h\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define FORCE_GRAVITY   0  // strength * direction, everywhere\n",
+    "#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),\n",
+    "                           // at rate strength\n",
+    "#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)\n",
+    "#define FORCE_VORTEX    3  // Around the axis direction through position\n",
+    "#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 position;   // Point or box center\n",
+    "\n",
+    "    float4 direction;  // Direction, axis or velocity, by type\n",
+    "\n",
+    "    float4 extent;     // Box half-extents (FORCE_DRAG)\n",
+    "\n",
+    "    int type;          // FORCE_*\n",
+    "\n",
+    "    float strength;\n",
+    "\n",
+    "    float radius;      // Falloff radius of attractors, vortices and wind;\n",
+    "                       // <= 0 for no falloff\n",
+    "\n",
+    "    int __padding;\n",
+    "\n",
+    "} ForceField;\n",
+    "\n",
+    "/**\n",
+    " * Linear falloff of a field with distance d: 1 at the source, 0 at radius\n",
+    " * and beyond; 1 everywhere if radius <= 0\n",
+    " */\n",
+    "float forceFalloff(float d, float radius)\n",
+    "{\n",
+    "    return radius > 0.0f \? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Sums the acceleration of numFields force fields on a particle at p moving\n",
+    " * at velocity v\n",
+    " */\n",
+    "float3 evaluateForceFields(constant ForceField* fields\n",
+    "                          ,int numFields\n",
+    "                          ,float3 p\n",
+    "                          ,float3 v)\n",
+    "{\n",
+    "    float3 a = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    for (int i = 0; i < numFields; i++) {\n",
+    "\n",
+    "        ForceField f = fields[i];\n",
+    "\n",
+    "        float3 r = f.position.xyz - p;\n",
+    "        float d  = length(r);\n",
+    "\n",
+    "        switch (f.type) {\n",
+    "\n",
+    "            case FORCE_GRAVITY:\n",
+    "                a += f.strength * f.direction.xyz;\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_WIND:\n",
+    "                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_ATTRACTOR:\n",
+    "                if (d > 0.0f) {\n",
+    "                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_VORTEX:\n",
+    "                {\n",
+    "                    float3 axis  = normalize(f.direction.xyz);\n",
+    "                    float3 perp  = r - (dot(r, axis) * axis);\n",
+    "                    float dPerp  = length(perp);\n",
+    "\n",
+    "                    if (dPerp > 0.0f) {\n",
+    "                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);\n",
+    "                    }\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_DRAG:\n",
+    "                if (all(isless(fabs(r), f.extent.xyz))) {\n",
+    "                    a -= f.strength * v;\n",
+    "                }\n",
+    "                break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return a;\n",
+    "}\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "/******************************************************************************/\n",
+    "\n",
+    "// Kinds of query; these must match pbf::SpatialQueryType\n",
+    "#define QUERY_SPHERE 0\n",
+    "#define QUERY_BOX    1\n",
+    "#define QUERY_PROBE  2\n",
+    "\n",
+    "// A query; this must match pbf::SpatialQuery in SpatialQueries.h\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 center;\n",
+    "\n",
+    "    float4 halfExtent;  // Box half-extents; x is the radius of spheres and\n",
+    "                        // probes (<= 0 for probes: the smoothing radius)\n",
+    "\n",
+    "    int type;           // QUERY_*\n",
+    "\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} SpatialQuery;\n",
+    "\n",
+    "// The estimate at a probe point; this must match pbf::ProbeResult\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 velocity;    // Kernel-weighted mean velocity\n",
+    "\n",
+    "    float density;      // Sum of poly6 over the particles in range, as in\n",
+    "                        // the solver's density estimate\n",
+    "\n",
+    "    int neighbors;      // Particles in range\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} ProbeResult;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Half-extents of the axis-aligned box bounding the query\n",
+    " */\n",
+    "float3 queryHalfExtent(SpatialQuery q)\n",
+    "{\n",
+    "    return q.type == QUERY_BOX \? q.halfExtent.xyz : q.halfExtent.xxx;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if x is inside the sphere or box of the query\n",
+    " */\n",
+    "bool queryContains(SpatialQuery q, float3 x)\n",
+    "{\n",
+    "    float3 d = x - q.center.xyz;\n",
+    "\n",
+    "    if (q.type == QUERY_BOX) {\n",
+    "        return all(isless(fabs(d), q.halfExtent.xyz));\n",
+    "    }\n",
+    "\n",
+    "    return dot(d, d) < (q.halfExtent.x * q.halfExtent.x);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Finds the particles of a sphere or box query, visiting the grid cells its\n",
+    " * bounding box overlaps. The matches are counted first, then a range of\n",
+    " * indices is claimed with one atomic add on header[0] and filled. header\n",
+    " * receives the range of query i at [1 + 2i] (start) and [2 + 2i] (count);\n",
+    " * indices past capacity are not written, so the host can grow the list to\n",
+    " * header[0] and run again\n",
+    " *\n",
+    " * Run 1D over numQueries\n",
+    " */\n",
+    "kernel void findQueryParticles(global const Particle* particles\n",
+    "                              ,global const ParticlePosition* sortedParticleToCell\n",
+    "                              ,global const GridCellOffset* gridCellOffsets\n",
+    "                              ,int cellsX\n",
+    "                              ,int cellsY\n",
+    "                              ,int cellsZ\n",
+    "                              ,float4 minExt\n",
+    "                              ,float4 maxExt\n",
+    "                              ,global const SpatialQuery* queries\n",
+    "                              ,int numQueries\n",
+    "                              ,volatile global int* header\n",
+    "                              ,global int* indices\n",
+    "                              ,int capacity)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numQueries) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    SpatialQuery q = queries[id];\n",
+    "\n",
+    "    int3 cells  = (int3)(cellsX, cellsY, cellsZ);\n",
+    "    float3 he   = queryHalfExtent(q);\n",
+    "    int3 first  = cellOf(q.center.xyz - he, cells, minExt.xyz, maxExt.xyz);\n",
+    "    int3 last   = cellOf(q.center.xyz + he, cells, minExt.xyz, maxExt.xyz);\n",
+    "    int count   = 0;\n",
+    "\n",
+    "    for (int k = first.z; k <= last.z; k++) {\n",
+    "        for (int j = first.y; j <= last.y; j++) {\n",
+    "            for (int i = first.x; i <= last.x; i++) {\n",
+    "\n",
+    "                GridCellOffset offset = gridCellOffsets[sub2ind(i, j, k, cellsX, cellsY)];\n",
+    "\n",
+    "                if (offset.start == -1) {\n",
+    "                    continue;\n",
+    "                }\n",
+    "\n",
+    "                for (int s = offset.start; s < (offset.start + offset.length); s++) {\n",
+    "                    if (queryContains(q, particles[sortedParticleToCell[s].particleIndex].pos.xyz)) {\n",
+    "                        count++;\n",
+    "                    }\n",
+    "                }\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    int start = atomic_add(&header[0], count);\n",
+    "\n",
+    "    header[1 + (2 * id)] = start;\n",
+    "    header[2 + (2 * id)] = count;\n",
+    "\n",
+    "    int next = start;\n",
+    "\n",
+    "    for (int k = first.z; k <= last.z && next < capacity; k++) {\n",
+    "        for (int j = first.y; j <= last.y && next < capacity; j++) {\n",
+    "            for (int i = first.x; i <= last.x && next < capacity; i++) {\n",
+    "\n",
+    "                GridCellOffset offset = gridCellOffsets[sub2ind(i, j, k, cellsX, cellsY)];\n",
+    "\n",
+    "                if (offset.start == -1) {\n",
+    "                    continue;\n",
+    "                }\n",
+    "\n",
+    "                for (int s = offset.start; s < (offset.start + offset.length) && next < capacity; s++) {\n",
+    "\n",
+    "                    int index = sortedParticleToCell[s].particleIndex;\n",
+    "\n",
+    "                    if (queryContains(q, particles[index].pos.xyz)) {\n",
+    "                        indices[next++] = index;\n",
+    "                    }\n",
+    "                }\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Estimates density and velocity at the center of a probe query from the\n",
+    " * particles within its radius\n",
+    " *\n",
+    " * Run 1D over numQueries\n",
+    " */\n",
+    "kernel void probeQueryPoints(global const Parameters* parameters\n",
+    "                            ,global const Particle* particles\n",
+    "                            ,global const ParticlePosition* sortedParticleToCell\n",
+    "                            ,global const GridCellOffset* gridCellOffsets\n",
+    "                            ,int cellsX\n",
+    "                            ,int cellsY\n",
+    "                            ,int cellsZ\n",
+    "                            ,float4 minExt\n",
+    "                            ,float4 maxExt\n",
+    "                            ,global const SpatialQuery* queries\n",
+    "                            ,int numQueries\n",
+    "                            ,global ProbeResult* results)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numQueries) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    SpatialQuery q = queries[id];\n",
+    "\n",
+    "    float h     = q.halfExtent.x > 0.0f \? q.halfExtent.x : parameters->smoothingRadius;\n",
+    "    float3 p    = q.center.xyz;\n",
+    "    int3 cells  = (int3)(cellsX, cellsY, cellsZ);\n",
+    "    int3 first  = cellOf(p - (float3)(h, h, h), cells, minExt.xyz, maxExt.xyz);\n",
+    "    int3 last   = cellOf(p + (float3)(h, h, h), cells, minExt.xyz, maxExt.xyz);\n",
+    "\n",
+    "    float density  = 0.0f;\n",
+    "    float3 weighed = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    int neighbors  = 0;\n",
+    "\n",
+    "    for (int k = first.z; k <= last.z; k++) {\n",
+    "        for (int j = first.y; j <= last.y; j++) {\n",
+    "            for (int i = first.x; i <= last.x; i++) {\n",
+    "\n",
+    "                GridCellOffset offset = gridCellOffsets[sub2ind(i, j, k, cellsX, cellsY)];\n",
+    "\n",
+    "                if (offset.start == -1) {\n",
+    "                    continue;\n",
+    "                }\n",
+    "\n",
+    "                for (int s = offset.start; s < (offset.start + offset.length); s++) {\n",
+    "\n",
+    "                    Particle particle = particles[sortedParticleToCell[s].particleIndex];\n",
+    "\n",
+    "                    float3 r = p - particle.pos.xyz;\n",
+    "                    float W  = poly6(dot(r, r), h);\n",
+    "\n",
+    "                    if (W > 0.0f) {\n",
+    "                        density += W;\n",
+    "                        weighed += W * particle.vel.xyz;\n",
+    "                        neighbors++;\n",
+    "                    }\n",
+    "                }\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    ProbeResult result;\n",
+    "\n",
+    "    result.velocity     = (float4)(density > 0.0f \? weighed / density : weighed, 0.0f);\n",
+    "    result.density      = density;\n",
+    "    result.neighbors    = neighbors;\n",
+    "    result.__padding[0] = 0;\n",
+    "    result.__padding[1] = 0;\n",
+    "\n",
+    "    results[id] = result;\n",
+    "}\n",
+    ""
+};
+
+// kernels/Visualize.cl
+
+const char* const VISUALIZE_CL[] = {
+    "/*******************************************************************************\n",
+    " * Visualize.cl\n",
+    " * - Kernels used to color particles by a per-particle attribute (speed,\n",
+    " *   density, lambda, vorticity) entirely on the device. Colors are written\n",
+    " *   straight into the (GL-shared) color buffer of the particle VBO\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Common.cl\n",
+    " * - Types and helper functions shared by the kernel programs, including\n",
+    " *   the neighbor stencils of the solver's neighbor loops. Include with\n",
+    " *   #include \"kernels/Common.cl\"\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#ifndef PBF_KERNELS_COMMON_CL\n",
+    "#define PBF_KERNELS_COMMON_CL\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Types; these must match the host-side definitions in Simulation.h and\n",
+    " * Parameters.h exactly\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 pos;      // Current particle position (x)\n",
+    "\n",
+    "    float4 posStar;  // Predicted particle position (x*)\n",
+    "\n",
+    "    float4 vel;      // Current particle velocity (v)\n",
+    "\n",
+    "} Particle;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int particleIndex; // Index of particle in particle buffer\n",
+    "\n",
+    "    int cellI;         // Corresponding grid index in the x-axis\n",
+    "\n",
+    "    int cellJ;         // Corresponding grid index in the y-axis\n",
+    "\n",
+    "    int cellK;         // Corresponding grid index in the z-axis\n",
+    "\n",
+    "    int key;           // Linearized index key computed from the subscript\n",
+    "                       // (cellI, cellJ, cellK)\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} ParticlePosition;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int start;  // Start of the grid cell in sortedParticleToCell\n",
+    "\n",
+    "    int length;\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} GridCellOffset;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float particleRadius;\n",
+    "\n",
+    "    float smoothingRadius;\n",
+    "\n",
+    "    float relaxation;\n",
+    "\n",
+    "    float artificialPressureK;\n",
+    "\n",
+    "    float artificialPressureN;\n",
+    "\n",
+    "    float vorticityEpsilon;\n",
+    "\n",
+    "    float viscosityCoeff;\n",
+    "\n",
+    "} Parameters;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Spatial grid helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Linearizes the cell subscript (i, j, k)\n",
+    " */\n",
+    "int sub2ind(int i, int j, int k, int cellsX, int cellsY)\n",
+    "{\n",
+    "    return i + (j * cellsX) + (k * cellsX * cellsY);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Finds the (clamped) subscript of the grid cell containing p, using the same\n",
+    " * discretization as the discretizeParticlePositions kernel\n",
+    " */\n",
+    "int3 cellOf(float3 p\n",
+    "           ,int3 cells\n",
+    "           ,float3 minExt\n",
+    "           ,float3 maxExt)\n",
+    "{\n",
+    "    float3 cellSize = (maxExt - minExt) / convert_float3(cells);\n",
+    "    int3 cell       = convert_int3(floor((p - minExt) / cellSize));\n",
+    "\n",
+    "    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Neighbor stencils\n",
+    " *\n",
+    " * A neighbor loop visits the cells of the block starting at\n",
+    " * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping\n",
+    " * the cells rejected by stencilCellVisible():\n",
+    " *\n",
+    " *   int3 span  = (int3)(0, 0, 0);\n",
+    " *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);\n",
+    " *\n",
+    " *   for (int k = first.z; k < first.z + span.z; k++)\n",
+    " *     for (int j = first.y; j < first.y + span.y; j++)\n",
+    " *       for (int i = first.x; i < first.x + span.x; i++)\n",
+    " *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))\n",
+    " *           ... particles of cell (i, j, k) ...\n",
+    " *\n",
+    " * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the\n",
+    " * block only covers the cells the particle's h-ball touches, which is one\n",
+    " * or two cells per axis once cells are at least 2h wide; the solver sizes\n",
+    " * its grid that way while the stencil is selected. A program whose\n",
+    " * neighbor loops go through these helpers says so by putting\n",
+    " * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel\n",
+    " * it declares, so a stencil nothing runs isn't reported as active\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }\n",
+    "\n",
+    "/**\n",
+    " * Returns the lowest subscript of the block of cells that can hold neighbors\n",
+    " * of the particle at p, in cell, and the block's width per axis in span.\n",
+    " * The cells the particle's h-ball touches run from floor((p - h) / cellSize)\n",
+    " * to floor((p + h) / cellSize) on each axis, which is within one cell of\n",
+    " * the particle's own if cells are at least h wide; the block is exactly\n",
+    " * that range. Otherwise (cells compressed below h, or particles outside\n",
+    " * the grid) the full 3x3x3 block around the cell is used\n",
+    " */\n",
+    "int3 neighborStencilOrigin(float3 p\n",
+    "                          ,int3 cell\n",
+    "                          ,float3 minExt\n",
+    "                          ,float3 cellSize\n",
+    "                          ,float h\n",
+    "                          ,int3* span)\n",
+    "{\n",
+    "#ifdef PBF_HALF_CELL_STENCIL\n",
+    "\n",
+    "    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {\n",
+    "\n",
+    "        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));\n",
+    "        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));\n",
+    "\n",
+    "        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {\n",
+    "            *span = hi - lo + (int3)(1, 1, 1);\n",
+    "            return lo;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "    *span = (int3)(3, 3, 3);\n",
+    "\n",
+    "    return cell - (int3)(1, 1, 1);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Squared distance from p to the box of cell c\n",
+    " */\n",
+    "float cellDistance2(float3 p\n",
+    "                   ,int3 c\n",
+    "                   ,float3 minExt\n",
+    "                   ,float3 cellSize)\n",
+    "{\n",
+    "    float3 lo = minExt + (convert_float3(c) * cellSize);\n",
+    "    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));\n",
+    "\n",
+    "    return dot(d, d);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if cell c is in the grid and its box comes within h of p; cells\n",
+    " * that fail can be skipped without reading any of their particles\n",
+    " */\n",
+    "bool stencilCellVisible(float3 p\n",
+    "                       ,int3 c\n",
+    "                       ,int3 cells\n",
+    "                       ,float3 minExt\n",
+    "                       ,float3 cellSize\n",
+    "                       ,float h)\n",
+    "{\n",
+    "    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "        return false;\n",
+    "    }\n",
+    "\n",
+    "    return cellDistance2(p, c, minExt, cellSize) < (h * h);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * SPH smoothing kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Poly6 smoothing kernel, taking the squared distance r^2\n",
+    " */\n",
+    "float poly6(float r2, float h)\n",
+    "{\n",
+    "    float h2 = h * h;\n",
+    "\n",
+    "    if (r2 >= h2) {\n",
+    "        return 0.0f;\n",
+    "    }\n",
+    "\n",
+    "    float x = h2 - r2;\n",
+    "\n",
+    "    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Gradient of the spiky smoothing kernel with respect to r\n",
+    " */\n",
+    "float3 spikyGradient(float3 r, float h)\n",
+    "{\n",
+    "    float rLen = length(r);\n",
+    "\n",
+    "    if (rLen <= 0.0f || rLen >= h) {\n",
+    "        return (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    }\n",
+    "\n",
+    "    float x = h - rLen;\n",
+    "\n",
+    "    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Geometry helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Returns the point on triangle (a, b, c) closest to p. See \"Real-Time\n",
+    " * Collision Detection\" (Ericson, 2005), section 5.1.5\n",
+    " */\n",
+    "float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)\n",
+    "{\n",
+    "    float3 ab = b - a;\n",
+    "    float3 ac = c - a;\n",
+    "    float3 ap = p - a;\n",
+    "\n",
+    "    float d1 = dot(ab, ap);\n",
+    "    float d2 = dot(ac, ap);\n",
+    "\n",
+    "    if (d1 <= 0.0f && d2 <= 0.0f) {\n",
+    "        return a;\n",
+    "    }\n",
+    "\n",
+    "    float3 bp = p - b;\n",
+    "    float d3  = dot(ab, bp);\n",
+    "    float d4  = dot(ac, bp);\n",
+    "\n",
+    "    if (d3 >= 0.0f && d4 <= d3) {\n",
+    "        return b;\n",
+    "    }\n",
+    "\n",
+    "    float vc = (d1 * d4) - (d3 * d2);\n",
+    "\n",
+    "    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {\n",
+    "        return a + ((d1 / (d1 - d3)) * ab);\n",
+    "    }\n",
+    "\n",
+    "    float3 cp = p - c;\n",
+    "    float d5  = dot(ab, cp);\n",
+    "    float d6  = dot(ac, cp);\n",
+    "\n",
+    "    if (d6 >= 0.0f && d5 <= d6) {\n",
+    "        return c;\n",
+    "    }\n",
+    "\n",
+    "    float vb = (d5 * d2) - (d1 * d6);\n",
+    "\n",
+    "    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {\n",
+    "        return a + ((d2 / (d2 - d6)) * ac);\n",
+    "    }\n",
+    "\n",
+    "    float va = (d3 * d6) - (d5 * d4);\n",
+    "\n",
+    "    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {\n",
+    "        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));\n",
+    "    }\n",
+    "\n",
+    "    float denom = 1.0f / (va + vb + vc);\n",
+    "\n",
+    "    return a + (ab * (vb * denom)) + (ac * (vc * denom));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the point p by the row-major affine matrix m, using the same\n",
+    " * row-vector convention as ofMatrix4x4 (p' = p * m)\n",
+    " */\n",
+    "float3 transformPoint(float16 m, float3 p)\n",
+    "{\n",
+    "    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the direction d by the linear part of m\n",
+    " */\n",
+    "float3 transformDirection(float16 m, float3 d)\n",
+    "{\n",
+    "    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * External force fields\n",
+    " *\n",
+    " * Analytic descriptors of the external forces acting on the fluid, passed to\n",
+    " * kernels in a small constant buffer and evaluated per particle where the\n",
+    " * positions are predicted (see kernels/Forces.cl). These must match\n",
+    " * pbf::ForceField in ForceFields.h\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define FORCE_GRAVITY   0  // strength * direction, everywhere\n",
+    "#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),\n",
+    "                           // at rate strength\n",
+    "#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)\n",
+    "#define FORCE_VORTEX    3  // Around the axis direction through position\n",
+    "#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 position;   // Point or box center\n",
+    "\n",
+    "    float4 direction;  // Direction, axis or velocity, by type\n",
+    "\n",
+    "    float4 extent;     // Box half-extents (FORCE_DRAG)\n",
+    "\n",
+    "    int type;          // FORCE_*\n",
+    "\n",
+    "    float strength;\n",
+    "\n",
+    "    float radius;      // Falloff radius of attractors, vortices and wind;\n",
+    "                       // <= 0 for no falloff\n",
+    "\n",
+    "    int __padding;\n",
+    "\n",
+    "} ForceField;\n",
+    "\n",
+    "/**\n",
+    " * Linear falloff of a field with distance d: 1 at the source, 0 at radius\n",
+    " * and beyond; 1 everywhere if radius <= 0\n",
+    " */\n",
+    "float forceFalloff(float d, float radius)\n",
+    "{\n",
+    "    return radius > 0.0f \? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Sums the acceleration of numFields force fields on a particle at p moving\n",
+    " * at velocity v\n",
+    " */\n",
+    "float3 evaluateForceFields(constant ForceField* fields\n",
+    "                          ,int numFields\n",
+    "                          ,float3 p\n",
+    "                          ,float3 v)\n",
+    "{\n",
+    "    float3 a = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    for (int i = 0; i < numFields; i++) {\n",
+    "\n",
+    "        ForceField f = fields[i];\n",
+    "\n",
+    "        float3 r = f.position.xyz - p;\n",
+    "        float d  = length(r);\n",
+    "\n",
+    "        switch (f.type) {\n",
+    "\n",
+    "            case FORCE_GRAVITY:\n",
+    "                a += f.strength * f.direction.xyz;\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_WIND:\n",
+    "                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_ATTRACTOR:\n",
+    "                if (d > 0.0f) {\n",
+    "                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_VORTEX:\n",
+    "                {\n",
+    "                    float3 axis  = normalize(f.direction.xyz);\n",
+    "                    float3 perp  = r - (dot(r, axis) * axis);\n",
+    "                    float dPerp  = length(perp);\n",
+    "\n",
+    "                    if (dPerp > 0.0f) {\n",
+    "                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);\n",
+    "                    }\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_DRAG:\n",
+    "                if (all(isless(fabs(r), f.extent.xyz))) {\n",
+    "                    a -= f.strength * v;\n",
+    "                }\n",
+    "                break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return a;\n",
+    "}\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "/******************************************************************************/\n",
+    "\n",
+    "// Attributes; must match Simulation::VisualAttribute\n",
+    "#define ATTRIBUTE_NONE      0\n",
+    "#define ATTRIBUTE_SPEED     1\n",
+    "#define ATTRIBUTE_DENSITY   2\n",
+    "#define ATTRIBUTE_LAMBDA    3\n",
+    "#define ATTRIBUTE_VORTICITY 4\n",
+    "\n",
+    "// Transfer functions; must match Simulation::TransferFunction\n",
+    "#define TRANSFER_GRAYSCALE  0\n",
+    "#define TRANSFER_HEAT       1\n",
+    "#define TRANSFER_JET        2\n",
+    "#define TRANSFER_COOL_WARM  3\n",
+    "\n",
+    "// Work group size of the min/max reduction, a power of two. Defined by\n",
+    "// Simulation::setupVisualizeKernels() as the largest the device supports,\n",
+    "// up to Simulation::MAX_REDUCTION_GROUP_SIZE\n",
+    "#ifndef REDUCTION_GROUP_SIZE\n",
+    "#define REDUCTION_GROUP_SIZE 256\n",
+    "#endif\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Maps a normalized value t in [0,1] to a color using the given transfer\n",
+    " * function\n",
+    " */\n",
+    "float4 transfer(int transferFunction, float t)\n",
+    "{\n",
+    "    t = clamp(t, 0.0f, 1.0f);\n",
+    "\n",
+    "    if (transferFunction == TRANSFER_HEAT) {\n",
+    "\n",
+    "        // Black -> red -> yellow -> white\n",
+    "        return (float4)(clamp(3.0f * t, 0.0f, 1.0f)\n",
+    "                       ,clamp(3.0f * t - 1.0f, 0.0f, 1.0f)\n",
+    "                       ,clamp(3.0f * t - 2.0f, 0.0f, 1.0f)\n",
+    "                       ,1.0f);\n",
+    "\n",
+    "    } else if (transferFunction == TRANSFER_JET) {\n",
+    "\n",
+    "        // Blue -> cyan -> yellow -> red\n",
+    "        return (float4)(clamp(1.5f - fabs(4.0f * t - 3.0f), 0.0f, 1.0f)\n",
+    "                       ,clamp(1.5f - fabs(4.0f * t - 2.0f), 0.0f, 1.0f)\n",
+    "                       ,clamp(1.5f - fabs(4.0f * t - 1.0f), 0.0f, 1.0f)\n",
+    "                       ,1.0f);\n",
+    "\n",
+    "    } else if (transferFunction == TRANSFER_COOL_WARM) {\n",
+    "\n",
+    "        // Diverging: blue -> white -> red\n",
+    "        float3 cool  = (float3)(0.230f, 0.299f, 0.754f);\n",
+    "        float3 white = (float3)(0.865f, 0.865f, 0.865f);\n",
+    "        float3 warm  = (float3)(0.706f, 0.016f, 0.150f);\n",
+    "        float3 c     = t < 0.5f \? mix(cool, white, 2.0f * t)\n",
+    "                                : mix(white, warm, 2.0f * t - 1.0f);\n",
+    "\n",
+    "        return (float4)(c, 1.0f);\n",
+    "    }\n",
+    "\n",
+    "    return (float4)(t, t, t, 1.0f);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Gathers the selected attribute of every particle into a flat array of\n",
+    " * scalars\n",
+    " *\n",
+    " * Run 1D over the number of particles\n",
+    " */\n",
+    "kernel void computeAttribute(global const Particle* particles\n",
+    "                            ,global const float* density\n",
+    "                            ,global const float* lambda\n",
+    "                            ,global const float4* curl\n",
+    "                            ,int numParticles\n",
+    "                            ,int attribute\n",
+    "                            ,global float* values)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    float value = 0.0f;\n",
+    "\n",
+    "    if (attribute == ATTRIBUTE_SPEED) {\n",
+    "        value = length(particles[id].vel.xyz);\n",
+    "    } else if (attribute == ATTRIBUTE_DENSITY) {\n",
+    "        value = density[id];\n",
+    "    } else if (attribute == ATTRIBUTE_LAMBDA) {\n",
+    "        value = lambda[id];\n",
+    "    } else if (attribute == ATTRIBUTE_VORTICITY) {\n",
+    "        value = length(curl[id].xyz);\n",
+    "    }\n",
+    "\n",
+    "    values[id] = value;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * First pass of the min/max reduction: every work group reduces its slice of\n",
+    " * values to a single (min, max) pair in partials\n",
+    " *\n",
+    " * Run 1D over the number of values rounded up to a multiple of\n",
+    " * REDUCTION_GROUP_SIZE, with a local size of REDUCTION_GROUP_SIZE\n",
+    " */\n",
+    "kernel __attribute__((reqd_work_group_size(REDUCTION_GROUP_SIZE, 1, 1)))\n",
+    "void reduceAttributeRange(global const float* values\n",
+    "                         ,int numValues\n",
+    "                         ,global float2* partials)\n",
+    "{\n",
+    "    local float2 scratch[REDUCTION_GROUP_SIZE];\n",
+    "\n",
+    "    int id  = get_global_id(0);\n",
+    "    int lid = get_local_id(0);\n",
+    "\n",
+    "    scratch[lid] = id < numValues \? (float2)(values[id], values[id])\n",
+    "                                  : (float2)(INFINITY, -INFINITY);\n",
+    "\n",
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n",
+    "\n",
+    "    for (int stride = REDUCTION_GROUP_SIZE / 2; stride > 0; stride >>= 1) {\n",
+    "\n",
+    "        if (lid < stride) {\n",
+    "            float2 a = scratch[lid];\n",
+    "            float2 b = scratch[lid + stride];\n",
+    "            scratch[lid] = (float2)(fmin(a.x, b.x), fmax(a.y, b.y));\n",
+    "        }\n",
+    "\n",
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n",
+    "    }\n",
+    "\n",
+    "    if (lid == 0) {\n",
+    "        partials[get_group_id(0)] = scratch[0];\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Second pass of the min/max reduction: a single work group folds all of the\n",
+    " * per-group partials into range[0]\n",
+    " *\n",
+    " * Run 1D with both global and local size of REDUCTION_GROUP_SIZE\n",
+    " */\n",
+    "kernel __attribute__((reqd_work_group_size(REDUCTION_GROUP_SIZE, 1, 1)))\n",
+    "void finishAttributeRange(global const float2* partials\n",
+    "                         ,int numPartials\n",
+    "                         ,global float2* range)\n",
+    "{\n",
+    "    local float2 scratch[REDUCTION_GROUP_SIZE];\n",
+    "\n",
+    "    int lid = get_local_id(0);\n",
+    "\n",
+    "    float2 r = (float2)(INFINITY, -INFINITY);\n",
+    "\n",
+    "    for (int i = lid; i < numPartials; i += REDUCTION_GROUP_SIZE) {\n",
+    "        r = (float2)(fmin(r.x, partials[i].x), fmax(r.y, partials[i].y));\n",
+    "    }\n",
+    "\n",
+    "    scratch[lid] = r;\n",
+    "\n",
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n",
+    "\n",
+    "    for (int stride = REDUCTION_GROUP_SIZE / 2; stride > 0; stride >>= 1) {\n",
+    "\n",
+    "        if (lid < stride) {\n",
+    "            float2 a = scratch[lid];\n",
+    "            float2 b = scratch[lid + stride];\n",
+    "            scratch[lid] = (float2)(fmin(a.x, b.x), fmax(a.y, b.y));\n",
+    "        }\n",
+    "\n",
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n",
+    "    }\n",
+    "\n",
+    "    if (lid == 0) {\n",
+    "        range[0] = scratch[0];\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Normalizes every value against either the reduced range (autoRange != 0)\n",
+    " * or the given fixed range, and writes the resulting color\n",
+    " *\n",
+    " * Run 1D over the number of particles\n",
+    " */\n",
+    "kernel void colorizeAttribute(global const float* values\n",
+    "                             ,int numParticles\n",
+    "                             ,global const float2* range\n",
+    "                             ,int autoRange\n",
+    "                             ,float rangeMin\n",
+    "                             ,float rangeMax\n",
+    "                             ,int transferFunction\n",
+    "                             ,global float4* colors)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (id >= numParticles) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    float2 r = autoRange \? range[0] : (float2)(rangeMin, rangeMax);\n",
+    "    float  w = r.y - r.x;\n",
+    "    float  t = w > 1.0e-6f \? (values[id] - r.x) / w : 0.5f;\n",
+    "\n",
+    "    colors[id] = transfer(transferFunction, t);\n",
+    "}\n",
+    "\n",
+    "/******************************************************************************/\n",
+    ""
+};
+
+// kernels/Volume.cl
+
+const char* const VOLUME_CL[] = {
+    "/*******************************************************************************\n",
+    " * Volume.cl\n",
+    " * - Kernels used to splat particle density and velocity into a sparse volume\n",
+    " *   made up of fixed-size bricks of voxels. Only bricks that overlap\n",
+    " *   occupied grid cells are allocated and filled\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Common.cl\n",
+    " * - Types and helper functions shared by the kernel programs, including\n",
+    " *   the neighbor stencils of the solver's neighbor loops. Include with\n",
+    " *   #include \"kernels/Common.cl\"\n",
+    " *\n",
+    " * CIS563: Physically Based Animation final project\n",
+    " * Created by Michael Woods & Michael O'Meara\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#ifndef PBF_KERNELS_COMMON_CL\n",
+    "#define PBF_KERNELS_COMMON_CL\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Types; these must match the host-side definitions in Simulation.h and\n",
+    " * Parameters.h exactly\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 pos;      // Current particle position (x)\n",
+    "\n",
+    "    float4 posStar;  // Predicted particle position (x*)\n",
+    "\n",
+    "    float4 vel;      // Current particle velocity (v)\n",
+    "\n",
+    "} Particle;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int particleIndex; // Index of particle in particle buffer\n",
+    "\n",
+    "    int cellI;         // Corresponding grid index in the x-axis\n",
+    "\n",
+    "    int cellJ;         // Corresponding grid index in the y-axis\n",
+    "\n",
+    "    int cellK;         // Corresponding grid index in the z-axis\n",
+    "\n",
+    "    int key;           // Linearized index key computed from the subscript\n",
+    "                       // (cellI, cellJ, cellK)\n",
+    "    int __padding[3];\n",
+    "\n",
+    "} ParticlePosition;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    int start;  // Start of the grid cell in sortedParticleToCell\n",
+    "\n",
+    "    int length;\n",
+    "\n",
+    "    int __padding[2];\n",
+    "\n",
+    "} GridCellOffset;\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float particleRadius;\n",
+    "\n",
+    "    float smoothingRadius;\n",
+    "\n",
+    "    float relaxation;\n",
+    "\n",
+    "    float artificialPressureK;\n",
+    "\n",
+    "    float artificialPressureN;\n",
+    "\n",
+    "    float vorticityEpsilon;\n",
+    "\n",
+    "    float viscosityCoeff;\n",
+    "\n",
+    "} Parameters;\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Spatial grid helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Linearizes the cell subscript (i, j, k)\n",
+    " */\n",
+    "int sub2ind(int i, int j, int k, int cellsX, int cellsY)\n",
+    "{\n",
+    "    return i + (j * cellsX) + (k * cellsX * cellsY);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Finds the (clamped) subscript of the grid cell containing p, using the same\n",
+    " * discretization as the discretizeParticlePositions kernel\n",
+    " */\n",
+    "int3 cellOf(float3 p\n",
+    "           ,int3 cells\n",
+    "           ,float3 minExt\n",
+    "           ,float3 maxExt)\n",
+    "{\n",
+    "    float3 cellSize = (maxExt - minExt) / convert_float3(cells);\n",
+    "    int3 cell       = convert_int3(floor((p - minExt) / cellSize));\n",
+    "\n",
+    "    return clamp(cell, (int3)(0, 0, 0), cells - (int3)(1, 1, 1));\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Neighbor stencils\n",
+    " *\n",
+    " * A neighbor loop visits the cells of the block starting at\n",
+    " * neighborStencilOrigin(), span.x by span.y by span.z cells wide, skipping\n",
+    " * the cells rejected by stencilCellVisible():\n",
+    " *\n",
+    " *   int3 span  = (int3)(0, 0, 0);\n",
+    " *   int3 first = neighborStencilOrigin(p, cell, minExt, cellSize, h, &span);\n",
+    " *\n",
+    " *   for (int k = first.z; k < first.z + span.z; k++)\n",
+    " *     for (int j = first.y; j < first.y + span.y; j++)\n",
+    " *       for (int i = first.x; i < first.x + span.x; i++)\n",
+    " *         if (stencilCellVisible(p, (int3)(i, j, k), cells, minExt, cellSize, h))\n",
+    " *           ... particles of cell (i, j, k) ...\n",
+    " *\n",
+    " * With PBF_HALF_CELL_STENCIL defined (see Solver::setNeighborStencil), the\n",
+    " * block only covers the cells the particle's h-ball touches, which is one\n",
+    " * or two cells per axis once cells are at least 2h wide; the solver sizes\n",
+    " * its grid that way while the stencil is selected. A program whose\n",
+    " * neighbor loops go through these helpers says so by putting\n",
+    " * NEIGHBOR_STENCIL_PROGRAM at file scope; the solver looks for the kernel\n",
+    " * it declares, so a stencil nothing runs isn't reported as active\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define NEIGHBOR_STENCIL_PROGRAM kernel void usesNeighborStencil(void) { }\n",
+    "\n",
+    "/**\n",
+    " * Returns the lowest subscript of the block of cells that can hold neighbors\n",
+    " * of the particle at p, in cell, and the block's width per axis in span.\n",
+    " * The cells the particle's h-ball touches run from floor((p - h) / cellSize)\n",
+    " * to floor((p + h) / cellSize) on each axis, which is within one cell of\n",
+    " * the particle's own if cells are at least h wide; the block is exactly\n",
+    " * that range. Otherwise (cells compressed below h, or particles outside\n",
+    " * the grid) the full 3x3x3 block around the cell is used\n",
+    " */\n",
+    "int3 neighborStencilOrigin(float3 p\n",
+    "                          ,int3 cell\n",
+    "                          ,float3 minExt\n",
+    "                          ,float3 cellSize\n",
+    "                          ,float h\n",
+    "                          ,int3* span)\n",
+    "{\n",
+    "#ifdef PBF_HALF_CELL_STENCIL\n",
+    "\n",
+    "    if (all(isgreaterequal(cellSize, (float3)(h, h, h)))) {\n",
+    "\n",
+    "        int3 lo = convert_int3(floor((p - minExt - h) / cellSize));\n",
+    "        int3 hi = convert_int3(floor((p - minExt + h) / cellSize));\n",
+    "\n",
+    "        if (all(lo >= cell - (int3)(1, 1, 1)) && all(lo <= cell) && all(hi <= cell + (int3)(1, 1, 1))) {\n",
+    "            *span = hi - lo + (int3)(1, 1, 1);\n",
+    "            return lo;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "    *span = (int3)(3, 3, 3);\n",
+    "\n",
+    "    return cell - (int3)(1, 1, 1);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Squared distance from p to the box of cell c\n",
+    " */\n",
+    "float cellDistance2(float3 p\n",
+    "                   ,int3 c\n",
+    "                   ,float3 minExt\n",
+    "                   ,float3 cellSize)\n",
+    "{\n",
+    "    float3 lo = minExt + (convert_float3(c) * cellSize);\n",
+    "    float3 d  = fmax(fmax(lo - p, p - (lo + cellSize)), (float3)(0.0f, 0.0f, 0.0f));\n",
+    "\n",
+    "    return dot(d, d);\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Tests if cell c is in the grid and its box comes within h of p; cells\n",
+    " * that fail can be skipped without reading any of their particles\n",
+    " */\n",
+    "bool stencilCellVisible(float3 p\n",
+    "                       ,int3 c\n",
+    "                       ,int3 cells\n",
+    "                       ,float3 minExt\n",
+    "                       ,float3 cellSize\n",
+    "                       ,float h)\n",
+    "{\n",
+    "    if (any(c < (int3)(0, 0, 0)) || any(c >= cells)) {\n",
+    "        return false;\n",
+    "    }\n",
+    "\n",
+    "    return cellDistance2(p, c, minExt, cellSize) < (h * h);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * SPH smoothing kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Poly6 smoothing kernel, taking the squared distance r^2\n",
+    " */\n",
+    "float poly6(float r2, float h)\n",
+    "{\n",
+    "    float h2 = h * h;\n",
+    "\n",
+    "    if (r2 >= h2) {\n",
+    "        return 0.0f;\n",
+    "    }\n",
+    "\n",
+    "    float x = h2 - r2;\n",
+    "\n",
+    "    return (315.0f / (64.0f * M_PI_F * pown(h, 9))) * x * x * x;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Gradient of the spiky smoothing kernel with respect to r\n",
+    " */\n",
+    "float3 spikyGradient(float3 r, float h)\n",
+    "{\n",
+    "    float rLen = length(r);\n",
+    "\n",
+    "    if (rLen <= 0.0f || rLen >= h) {\n",
+    "        return (float3)(0.0f, 0.0f, 0.0f);\n",
+    "    }\n",
+    "\n",
+    "    float x = h - rLen;\n",
+    "\n",
+    "    return (-45.0f / (M_PI_F * pown(h, 6))) * x * x * (r / rLen);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Geometry helpers\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Returns the point on triangle (a, b, c) closest to p. See \"Real-Time\n",
+    " * Collision Detection\" (Ericson, 2005), section 5.1.5\n",
+    " */\n",
+    "float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)\n",
+    "{\n",
+    "    float3 ab = b - a;\n",
+    "    float3 ac = c - a;\n",
+    "    float3 ap = p - a;\n",
+    "\n",
+    "    float d1 = dot(ab, ap);\n",
+    "    float d2 = dot(ac, ap);\n",
+    "\n",
+    "    if (d1 <= 0.0f && d2 <= 0.0f) {\n",
+    "        return a;\n",
+    "    }\n",
+    "\n",
+    "    float3 bp = p - b;\n",
+    "    float d3  = dot(ab, bp);\n",
+    "    float d4  = dot(ac, bp);\n",
+    "\n",
+    "    if (d3 >= 0.0f && d4 <= d3) {\n",
+    "        return b;\n",
+    "    }\n",
+    "\n",
+    "    float vc = (d1 * d4) - (d3 * d2);\n",
+    "\n",
+    "    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {\n",
+    "        return a + ((d1 / (d1 - d3)) * ab);\n",
+    "    }\n",
+    "\n",
+    "    float3 cp = p - c;\n",
+    "    float d5  = dot(ab, cp);\n",
+    "    float d6  = dot(ac, cp);\n",
+    "\n",
+    "    if (d6 >= 0.0f && d5 <= d6) {\n",
+    "        return c;\n",
+    "    }\n",
+    "\n",
+    "    float vb = (d5 * d2) - (d1 * d6);\n",
+    "\n",
+    "    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {\n",
+    "        return a + ((d2 / (d2 - d6)) * ac);\n",
+    "    }\n",
+    "\n",
+    "    float va = (d3 * d6) - (d5 * d4);\n",
+    "\n",
+    "    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {\n",
+    "        return b + (((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b));\n",
+    "    }\n",
+    "\n",
+    "    float denom = 1.0f / (va + vb + vc);\n",
+    "\n",
+    "    return a + (ab * (vb * denom)) + (ac * (vc * denom));\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the point p by the row-major affine matrix m, using the same\n",
+    " * row-vector convention as ofMatrix4x4 (p' = p * m)\n",
+    " */\n",
+    "float3 transformPoint(float16 m, float3 p)\n",
+    "{\n",
+    "    return (p.x * m.s012) + (p.y * m.s456) + (p.z * m.s89a) + m.scde;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Transforms the direction d by the linear part of m\n",
+    " */\n",
+    "float3 transformDirection(float16 m, float3 d)\n",
+    "{\n",
+    "    return (d.x * m.s012) + (d.y * m.s456) + (d.z * m.s89a);\n",
+    "}\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * External force fields\n",
+    " *\n",
+    " * Analytic descriptors of the external forces acting on the fluid, passed to\n",
+    " * kernels in a small constant buffer and evaluated per particle where the\n",
+    " * positions are predicted (see kernels/Forces.cl). These must match\n",
+    " * pbf::ForceField in ForceFields.h\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "#define FORCE_GRAVITY   0  // strength * direction, everywhere\n",
+    "#define FORCE_WIND      1  // Pulls velocities toward direction (a velocity),\n",
+    "                           // at rate strength\n",
+    "#define FORCE_ATTRACTOR 2  // Toward position (away, if strength < 0)\n",
+    "#define FORCE_VORTEX    3  // Around the axis direction through position\n",
+    "#define FORCE_DRAG      4  // -strength * v inside the box position +/- extent\n",
+    "\n",
+    "typedef struct {\n",
+    "\n",
+    "    float4 position;   // Point or box center\n",
+    "\n",
+    "    float4 direction;  // Direction, axis or velocity, by type\n",
+    "\n",
+    "    float4 extent;     // Box half-extents (FORCE_DRAG)\n",
+    "\n",
+    "    int type;          // FORCE_*\n",
+    "\n",
+    "    float strength;\n",
+    "\n",
+    "    float radius;      // Falloff radius of attractors, vortices and wind;\n",
+    "                       // <= 0 for no falloff\n",
+    "\n",
+    "    int __padding;\n",
+    "\n",
+    "} ForceField;\n",
+    "\n",
+    "/**\n",
+    " * Linear falloff of a field with distance d: 1 at the source, 0 at radius\n",
+    " * and beyond; 1 everywhere if radius <= 0\n",
+    " */\n",
+    "float forceFalloff(float d, float radius)\n",
+    "{\n",
+    "    return radius > 0.0f \? clamp(1.0f - (d / radius), 0.0f, 1.0f) : 1.0f;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Sums the acceleration of numFields force fields on a particle at p moving\n",
+    " * at velocity v\n",
+    " */\n",
+    "float3 evaluateForceFields(constant ForceField* fields\n",
+    "                          ,int numFields\n",
+    "                          ,float3 p\n",
+    "                          ,float3 v)\n",
+    "{\n",
+    "    float3 a = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    for (int i = 0; i < numFields; i++) {\n",
+    "\n",
+    "        ForceField f = fields[i];\n",
+    "\n",
+    "        float3 r = f.position.xyz - p;\n",
+    "        float d  = length(r);\n",
+    "\n",
+    "        switch (f.type) {\n",
+    "\n",
+    "            case FORCE_GRAVITY:\n",
+    "                a += f.strength * f.direction.xyz;\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_WIND:\n",
+    "                a += f.strength * forceFalloff(d, f.radius) * (f.direction.xyz - v);\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_ATTRACTOR:\n",
+    "                if (d > 0.0f) {\n",
+    "                    a += (f.strength * forceFalloff(d, f.radius) / d) * r;\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_VORTEX:\n",
+    "                {\n",
+    "                    float3 axis  = normalize(f.direction.xyz);\n",
+    "                    float3 perp  = r - (dot(r, axis) * axis);\n",
+    "                    float dPerp  = length(perp);\n",
+    "\n",
+    "                    if (dPerp > 0.0f) {\n",
+    "                        a += (f.strength * forceFalloff(dPerp, f.radius) / dPerp) * cross(axis, perp);\n",
+    "                    }\n",
+    "                }\n",
+    "                break;\n",
+    "\n",
+    "            case FORCE_DRAG:\n",
+    "                if (all(isless(fabs(r), f.extent.xyz))) {\n",
+    "                    a -= f.strength * v;\n",
+    "                }\n",
+    "                break;\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    return a;\n",
+    "}\n",
+    "\n",
+    "#endif\n",
+    "\n",
+    "/******************************************************************************/\n",
+    "\n",
+    "// Voxels per brick edge; must match VolumeExporter::BRICK_SIZE\n",
+    "#define BRICK_SIZE 8\n",
+    "\n",
+    "#define VOXELS_PER_BRICK (BRICK_SIZE * BRICK_SIZE * BRICK_SIZE)\n",
+    "\n",
+    "NEIGHBOR_STENCIL_PROGRAM\n",
+    "\n",
+    "/*******************************************************************************\n",
+    " * Kernels\n",
+    " ******************************************************************************/\n",
+    "\n",
+    "/**\n",
+    " * Clears the brick occupancy flags\n",
+    " *\n",
+    " * Run 1D over the total number of bricks in the volume\n",
+    " */\n",
+    "kernel void resetBrickFlags(global int* brickFlags)\n",
+    "{\n",
+    "    brickFlags[get_global_id(0)] = 0;\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * For every occupied grid cell, flags all bricks overlapping the cell's\n",
+    " * bounding box grown by the smoothing radius h, since a particle in the cell\n",
+    " * contributes to all voxels within h of it\n",
+    " *\n",
+    " * Run 1D over the total number of grid cells\n",
+    " */\n",
+    "kernel void markActiveBricks(global const int* cellHistogram\n",
+    "                            ,int cellsX\n",
+    "                            ,int cellsY\n",
+    "                            ,int cellsZ\n",
+    "                            ,float4 minExt\n",
+    "                            ,float4 maxExt\n",
+    "                            ,float4 volumeOrigin\n",
+    "                            ,float brickExtent\n",
+    "                            ,int bricksX\n",
+    "                            ,int bricksY\n",
+    "                            ,int bricksZ\n",
+    "                            ,float h\n",
+    "                            ,global int* brickFlags)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (cellHistogram[id] <= 0) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    // Recover the cell's subscript from its linear index:\n",
+    "\n",
+    "    int i = id % cellsX;\n",
+    "    int j = (id / cellsX) % cellsY;\n",
+    "    int k = id / (cellsX * cellsY);\n",
+    "\n",
+    "    float3 cellSize = (maxExt.xyz - minExt.xyz) / (float3)(cellsX, cellsY, cellsZ);\n",
+    "    float3 lo       = minExt.xyz + ((float3)(i, j, k) * cellSize) - (float3)(h, h, h);\n",
+    "    float3 hi       = lo + cellSize + (float3)(2.0f * h, 2.0f * h, 2.0f * h);\n",
+    "\n",
+    "    int3 bricks = (int3)(bricksX, bricksY, bricksZ);\n",
+    "    int3 bLo    = clamp(convert_int3(floor((lo - volumeOrigin.xyz) / brickExtent)), (int3)(0, 0, 0), bricks - (int3)(1, 1, 1));\n",
+    "    int3 bHi    = clamp(convert_int3(floor((hi - volumeOrigin.xyz) / brickExtent)), (int3)(0, 0, 0), bricks - (int3)(1, 1, 1));\n",
+    "\n",
+    "    // Benign race: every writer stores the same value\n",
+    "\n",
+    "    for (int bk = bLo.z; bk <= bHi.z; bk++) {\n",
+    "        for (int bj = bLo.y; bj <= bHi.y; bj++) {\n",
+    "            for (int bi = bLo.x; bi <= bHi.x; bi++) {\n",
+    "                brickFlags[sub2ind(bi, bj, bk, bricksX, bricksY)] = 1;\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Given the brick occupancy flags and their exclusive prefix sums, writes the\n",
+    " * linear index of each active brick to its compacted slot. Since the scan\n",
+    " * preserves order, activeBricks ends up sorted by linear brick index\n",
+    " *\n",
+    " * Run 1D over the total number of bricks in the volume\n",
+    " */\n",
+    "kernel void compactActiveBricks(global const int* brickFlags\n",
+    "                               ,global const int* brickOffsets\n",
+    "                               ,global int* activeBricks)\n",
+    "{\n",
+    "    int id = get_global_id(0);\n",
+    "\n",
+    "    if (brickFlags[id] != 0) {\n",
+    "        activeBricks[brickOffsets[id]] = id;\n",
+    "    }\n",
+    "}\n",
+    "\n",
+    "/**\n",
+    " * Computes the SPH density and velocity estimate at the center of each voxel\n",
+    " * of each active brick. The output is laid out brick after brick, in the order\n",
+    " * given by activeBricks, with voxels in x-fastest order within a brick. Each\n",
+    " * voxel is written as (vx, vy, vz, density)\n",
+    " *\n",
+    " * Run 1D over (number of active bricks * VOXELS_PER_BRICK)\n",
+    " */\n",
+    "kernel void splatBricks(global const Parameters* parameters\n",
+    "                       ,global const Particle* particles\n",
+    "                       ,global const ParticlePosition* sortedParticleToCell\n",
+    "                       ,global const GridCellOffset* gridCellOffsets\n",
+    "                       ,int cellsX\n",
+    "                       ,int cellsY\n",
+    "                       ,int cellsZ\n",
+    "                       ,float4 minExt\n",
+    "                       ,float4 maxExt\n",
+    "                       ,global const int* activeBricks\n",
+    "                       ,int numActiveBricks\n",
+    "                       ,float4 volumeOrigin\n",
+    "                       ,float voxelSize\n",
+    "                       ,int bricksX\n",
+    "                       ,int bricksY\n",
+    "                       ,global float4* voxels)\n",
+    "{\n",
+    "    int id    = get_global_id(0);\n",
+    "    int brick = id / VOXELS_PER_BRICK;\n",
+    "    int voxel = id % VOXELS_PER_BRICK;\n",
+    "\n",
+    "    if (brick >= numActiveBricks) {\n",
+    "        return;\n",
+    "    }\n",
+    "\n",
+    "    // Brick subscript, then voxel subscript within the volume:\n",
+    "\n",
+    "    int b  = activeBricks[brick];\n",
+    "    int bi = b % bricksX;\n",
+    "    int bj = (b / bricksX) % bricksY;\n",
+    "    int bk = b / (bricksX * bricksY);\n",
+    "\n",
+    "    int3 v = (int3)(bi * BRICK_SIZE + (voxel % BRICK_SIZE)\n",
+    "                   ,bj * BRICK_SIZE + ((voxel / BRICK_SIZE) % BRICK_SIZE)\n",
+    "                   ,bk * BRICK_SIZE + (voxel / (BRICK_SIZE * BRICK_SIZE)));\n",
+    "\n",
+    "    float3 x     = volumeOrigin.xyz + ((convert_float3(v) + (float3)(0.5f, 0.5f, 0.5f)) * voxelSize);\n",
+    "    float  h     = parameters->smoothingRadius;\n",
+    "    int3   cells = (int3)(cellsX, cellsY, cellsZ);\n",
+    "    int3   c     = cellOf(x, cells, minExt.xyz, maxExt.xyz);\n",
+    "\n",
+    "    float  rho = 0.0f;\n",
+    "    float3 vel = (float3)(0.0f, 0.0f, 0.0f);\n",
+    "\n",
+    "    // Gather from the cells of the neighbor stencil around the voxel (see\n",
+    "    // kernels/Common.cl):\n",
+    "\n",
+    "    float3 cellSize = (maxExt.xyz - minExt.xyz) / convert_float3(cells);\n",
+    "    int3   span     = (int3)(0, 0, 0);\n",
+    "    int3   first    = neighborStencilOrigin(x, c, minExt.xyz, cellSize, h, &span);\n",
+    "\n",
+    "    for (int nk = first.z; nk < first.z + span.z; nk++) {\n",
+    "        for (int nj = first.y; nj < first.y + span.y; nj++) {\n",
+    "            for (int ni = first.x; ni < first.x + span.x; ni++) {\n",
+    "\n",
+    "                int3 n = (int3)(ni, nj, nk);\n",
+    "\n",
+    "                if (!stencilCellVisible(x, n, cells, minExt.xyz, cellSize, h)) {\n",
+    "                    continue;\n",
+    "                }\n",
+    "\n",
+    "                GridCellOffset offset = gridCellOffsets[sub2ind(n.x, n.y, n.z, cellsX, cellsY)];\n",
+    "\n",
+    "                if (offset.start == -1) {\n",
+    "                    continue;\n",
+    "                }\n",
+    "\n",
+    "                for (int s = offset.start; s < (offset.start + offset.length); s++) {\n",
+    "\n",
+    "                    Particle p = particles[sortedParticleToCell[s].particleIndex];\n",
+    "                    float3 r   = x - p.pos.xyz;\n",
+    "                    float  W   = poly6(dot(r, r), h);\n",
+    "\n",
+    "                    rho += W;\n",
+    "                    vel += W * p.vel.xyz;\n",
+    "                }\n",
+    "            }\n",
+    "        }\n",
+    "    }\n",
+    "\n",
+    "    if (rho > 0.0f) {\n",
+    "        vel /= rho;\n",
+    "    }\n",
+    "\n",
+    "    voxels[id] = (float4)(vel, rho);\n",
+    "}\n",
+    ""
+};
+
+}
+
+const KernelSource EMBEDDED_KERNELS[] = {
+    { "kernels/Common.cl", COMMON_CL, static_cast<int>(sizeof(COMMON_CL) / sizeof(COMMON_CL[0])) },
+    { "kernels/DistanceField.cl", DISTANCEFIELD_CL, static_cast<int>(sizeof(DISTANCEFIELD_CL) / sizeof(DISTANCEFIELD_CL[0])) },
+    { "kernels/Forces.cl", FORCES_CL, static_cast<int>(sizeof(FORCES_CL) / sizeof(FORCES_CL[0])) },
+    { "kernels/MeshCollision.cl", MESHCOLLISION_CL, static_cast<int>(sizeof(MESHCOLLISION_CL) / sizeof(MESHCOLLISION_CL[0])) },
+    { "kernels/Pairwise.cl", PAIRWISE_CL, static_cast<int>(sizeof(PAIRWISE_CL) / sizeof(PAIRWISE_CL[0])) },
+    { "kernels/Query.cl", QUERY_CL, static_cast<int>(sizeof(QUERY_CL) / sizeof(QUERY_CL[0])) },
+    { "kernels/Visualize.cl", VISUALIZE_CL, static_cast<int>(sizeof(VISUALIZE_CL) / sizeof(VISUALIZE_CL[0])) },
+    { "kernels/Volume.cl", VOLUME_CL, static_cast<int>(sizeof(VOLUME_CL) / sizeof(VOLUME_CL[0])) },
+    { NULL, NULL, 0 }
+};
+
+const int NUM_EMBEDDED_KERNELS = 8;
+
+}
+
+/******************************************************************************/
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * KernelSources.h
+ * - The kernel sources of bin/data/kernels, embedded in the binary at build
+ *   time (see tools/embedkernels.cpp), so programs can be built without
+ *   reading them from disk
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_KERNEL_SOURCES_H
+#define PBF_LIB_KERNEL_SOURCES_H
+
+#include <cstddef>
+#include <string>
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * An embedded kernel file. Its includes are already inlined, so it builds on
+ * its own; lines can be passed to clCreateProgramWithSource as they are
+ */
+typedef struct {
+
+    const char* path;                 // e.g. "kernels/Pairwise.cl"
+
+    const char* const* lines;
+
+    int numLines;
+
+} KernelSource;
+
+// Generated in KernelSources.cpp; terminated by an entry with a NULL path
+extern const KernelSource EMBEDDED_KERNELS[];
+extern const int NUM_EMBEDDED_KERNELS;
+
+/**
+ * Returns the embedded copy of a kernel file (relative to the data folder),
+ * or NULL if it wasn't embedded or embedded sources are turned off
+ */
+const KernelSource* findKernelSource(const std::string& path);
+
+/**
+ * Joins the lines of an embedded kernel file. Returns false if there is no
+ * embedded copy
+ */
+bool getKernelSource(const std::string& path, std::string& source);
+
+/**
+ * Embedded sources are used by default. Turning them off makes every program
+ * read its kernels from the data folder again, e.g. while editing them
+ */
+void setEmbeddedKernels(bool enabled);
+
+bool isUsingEmbeddedKernels();
+
+}
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,742 @@
+/*******************************************************************************
+ * PairwiseDensity.cpp
+ * - Symmetric density estimate: each pair of neighboring particles is
+ *   evaluated once, through a half-shell stencil of cells, and added to both
+ *   particles. See kernels/Pairwise.cl
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "PairwiseDensity.h"
+#include "Solver.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+// Colors per axis; these must match COLORS_X/Y/Z in kernels/Pairwise.cl
+static const int COLORS[3] = { 3, 3, 2 };
+
+const int PairwiseDensity::BINS;
+const int PairwiseDensity::BIN_WIDTH;
+const int PairwiseDensity::CALIBRATION_RUNS;
+
+/**
+ * Share of lane time spent on work when the given amounts of work are run in
+ * order, simdWidth at a time, each group taking as long as its longest item
+ */
+static double laneUtilization(const vector<int>& work, const vector<int>& order, int simdWidth)
+{
+    double busy  = 0.0;
+    double total = 0.0;
+
+    for (size_t first = 0; first < order.size(); first += simdWidth) {
+
+        size_t last = min(first + simdWidth, order.size());
+        int longest = 0;
+
+        for (size_t i = first; i < last; i++) {
+            busy   += work[order[i]];
+            longest = max(longest, work[order[i]]);
+        }
+
+        total += static_cast<double>(longest) * static_cast<double>(last - first);
+    }
+
+    return total > 0.0 ? busy / total : 1.0;
+}
+
+/**
+ * Builds kernels/Pairwise.cl and picks the path for the device: CPU devices
+ * run the colored kernel, where the extra launches are cheap and float
+ * atomics (a compare-and-swap loop) are not
+ *
+ * @param [in] _context OpenCL context the solver's buffers belong to
+ * @param [in] _device Device the kernels are built for
+ * @param [in] _queue Queue all work is enqueued on
+ * @param [in] dataPath Directory containing kernels/Pairwise.cl
+ */
+PairwiseDensity::PairwiseDensity(cl_context _context
+                                ,cl_device_id _device
+                                ,cl_command_queue _queue
+                                ,const string& dataPath) :
+    context(_context),
+    device(_device),
+    queue(_queue),
+    program(_context, _device),
+    resetKernel(NULL),
+    accumulateKernel(NULL),
+    accumulateColoredKernel(NULL),
+    accumulateBalancedKernel(NULL),
+    countCandidatesKernel(NULL),
+    scanBinsKernel(NULL),
+    scatterWorkKernel(NULL),
+    colored(false),
+    balanced(false),
+    sortedParticleToCell(NULL),
+    gridCellOffsets(NULL),
+    particleBin(NULL),
+    workList(NULL),
+    binCounts(NULL),
+    binCursors(NULL),
+    neighborReads(NEIGHBOR_READS_AUTO),
+    imageReads(false),
+    imageSupport(false),
+    calibrated(false),
+    bufferMs(0.0),
+    imageMs(0.0),
+    positionImage(NULL),
+    numParticles(0),
+    events(NULL)
+{
+    this->cellsPerAxis[0] = this->cellsPerAxis[1] = this->cellsPerAxis[2] = 0;
+
+    if (!this->program.loadKernelFile("kernels/Pairwise.cl", dataPath)) {
+        return;
+    }
+
+    this->resetKernel             = this->program.kernel("resetPairDensity");
+    this->accumulateKernel        = this->program.kernel("accumulateDensityPairs");
+    this->accumulateColoredKernel = this->program.kernel("accumulateDensityPairsColored");
+
+    this->accumulateBalancedKernel = this->program.kernel("accumulateDensityPairsBalanced");
+    this->countCandidatesKernel    = this->program.kernel("countPairCandidates");
+    this->scanBinsKernel           = this->program.kernel("scanPairBins");
+    this->scatterWorkKernel        = this->program.kernel("scatterPairWork");
+    this->mirrorPositionsKernel    = this->program.kernel("mirrorSortedPositions");
+    this->accumulateImageKernel    = this->program.kernel("accumulateDensityPairsImage");
+
+    cl_device_type type  = 0;
+    cl_bool imageSupport = CL_FALSE;
+
+    clGetDeviceInfo(this->device, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+    clGetDeviceInfo(this->device, CL_DEVICE_IMAGE_SUPPORT, sizeof(imageSupport), &imageSupport, NULL);
+
+    this->colored      = (type & CL_DEVICE_TYPE_CPU) != 0;
+    this->imageSupport = imageSupport == CL_TRUE;
+}
+
+PairwiseDensity::~PairwiseDensity()
+{
+    this->releaseBalanceBuffers();
+    this->releasePositionImage();
+}
+
+/**
+ * Binds the buffers the kernels read and write
+ *
+ * @param [in] b The solver's effective buffers
+ * @param [in] _numParticles Number of particles
+ * @param [in] _cellsPerAxis Grid cells along x, y and z
+ */
+void PairwiseDensity::bind(const DeviceBuffers& b
+                          ,int _numParticles
+                          ,const int _cellsPerAxis[3])
+{
+    if (!this->isLoaded()) {
+        return;
+    }
+
+    this->numParticles         = _numParticles;
+    this->sortedParticleToCell = b.sortedParticleToCell;
+    this->gridCellOffsets      = b.gridCellOffsets;
+
+    for (int i = 0; i < 3; i++) {
+        this->cellsPerAxis[i] = _cellsPerAxis[i];
+    }
+
+    // KERNEL :: resetPairDensity
+
+    cl_kernel k = this->resetKernel;
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, this->numParticles);
+    setArg(k, 2, b.density);
+
+    // KERNEL :: accumulateDensityPairs
+
+    k = this->accumulateKernel;
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.particles);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.gridCellOffsets);
+    setArg(k, 4, this->numParticles);
+    setArg(k, 5, this->cellsPerAxis[0]);
+    setArg(k, 6, this->cellsPerAxis[1]);
+    setArg(k, 7, this->cellsPerAxis[2]);
+    setArg(k, 8, b.density);
+
+    // KERNEL :: accumulateDensityPairsColored (color, argument 7, is set
+    // per run)
+
+    k = this->accumulateColoredKernel;
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.particles);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.gridCellOffsets);
+    setArg(k, 4, this->cellsPerAxis[0]);
+    setArg(k, 5, this->cellsPerAxis[1]);
+    setArg(k, 6, this->cellsPerAxis[2]);
+    setArg(k, 8, b.density);
+
+    // KERNEL :: accumulateDensityPairsBalanced (the work list, argument 8,
+    // is bound with the balance buffers)
+
+    k = this->accumulateBalancedKernel;
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.particles);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.gridCellOffsets);
+    setArg(k, 4, this->numParticles);
+    setArg(k, 5, this->cellsPerAxis[0]);
+    setArg(k, 6, this->cellsPerAxis[1]);
+    setArg(k, 7, this->cellsPerAxis[2]);
+    setArg(k, 9, b.density);
+
+    // KERNEL :: mirrorSortedPositions (the image, argument 3, is bound
+    // when it's created)
+
+    k = this->mirrorPositionsKernel;
+    setArg(k, 0, b.particles);
+    setArg(k, 1, b.sortedParticleToCell);
+    setArg(k, 2, this->numParticles);
+
+    // KERNEL :: accumulateDensityPairsImage (the image, argument 7, is bound
+    // when it's created; the work list, argument 8, per run)
+
+    k = this->accumulateImageKernel;
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.sortedParticleToCell);
+    setArg(k, 2, b.gridCellOffsets);
+    setArg(k, 3, this->numParticles);
+    setArg(k, 4, this->cellsPerAxis[0]);
+    setArg(k, 5, this->cellsPerAxis[1]);
+    setArg(k, 6, this->cellsPerAxis[2]);
+    setArg(k, 9, b.density);
+
+    if (this->balanced) {
+        this->releaseBalanceBuffers();
+        this->balanced = this->createBalanceBuffers();
+    }
+
+    // The image is sized for the particles, and timings depend on them:
+
+    this->releasePositionImage();
+
+    this->calibrated = false;
+
+    // Automatic selection falls back to buffer reads by itself (see
+    // calibrate) if there's no image:
+
+    if (this->neighborReads != NEIGHBOR_READS_BUFFER && !this->createPositionImage()
+        && this->neighborReads == NEIGHBOR_READS_IMAGE) {
+        this->neighborReads = NEIGHBOR_READS_BUFFER;
+    }
+
+    this->imageReads = this->neighborReads == NEIGHBOR_READS_IMAGE;
+}
+
+/**
+ * Creates the sorted position image, one float4 texel per particle in rows
+ * as wide as the device allows, and binds it
+ */
+bool PairwiseDensity::createPositionImage()
+{
+    if (!this->imageSupport) {
+        return false;
+    }
+
+    if (this->positionImage != NULL || this->numParticles <= 0) {
+        return true;
+    }
+
+    size_t maxWidth  = 0;
+    size_t maxHeight = 0;
+
+    clGetDeviceInfo(this->device, CL_DEVICE_IMAGE2D_MAX_WIDTH, sizeof(maxWidth), &maxWidth, NULL);
+    clGetDeviceInfo(this->device, CL_DEVICE_IMAGE2D_MAX_HEIGHT, sizeof(maxHeight), &maxHeight, NULL);
+
+    size_t n      = static_cast<size_t>(this->numParticles);
+    size_t width  = min(n, maxWidth);
+    size_t height = width > 0 ? (n + width - 1) / width : 0;
+
+    if (width == 0 || height > maxHeight) {
+        cerr << "[pbf] " << n << " particles don't fit a " << maxWidth << "x" << maxHeight << " image" << endl;
+        return false;
+    }
+
+    cl_image_format format;
+
+    format.image_channel_order     = CL_RGBA;
+    format.image_channel_data_type = CL_FLOAT;
+
+    cl_int err = CL_SUCCESS;
+
+    this->positionImage = clCreateImage2D(this->context, CL_MEM_READ_WRITE, &format, width, height, 0, NULL, &err);
+
+    if (!checkError(err, "clCreateImage2D (sorted positions)")) {
+        this->positionImage = NULL;
+        return false;
+    }
+
+    setArg(this->mirrorPositionsKernel, 3, this->positionImage);
+    setArg(this->accumulateImageKernel, 7, this->positionImage);
+
+    return true;
+}
+
+void PairwiseDensity::releasePositionImage()
+{
+    if (this->positionImage != NULL) {
+        clReleaseMemObject(this->positionImage);
+        this->positionImage = NULL;
+    }
+}
+
+/**
+ * Selects buffer or image reads of the neighbor positions, or timing both.
+ * Automatic selection picks buffer reads if the image can't be created
+ *
+ * @param [in] reads The neighbor reads
+ */
+bool PairwiseDensity::setNeighborReads(NeighborReads reads)
+{
+    bool image = reads != NEIGHBOR_READS_BUFFER && this->createPositionImage();
+
+    if (reads == NEIGHBOR_READS_IMAGE && !image) {
+        this->neighborReads = NEIGHBOR_READS_BUFFER;
+        this->imageReads    = false;
+        return false;
+    }
+
+    this->neighborReads = reads;
+    this->imageReads    = reads == NEIGHBOR_READS_IMAGE;
+    this->calibrated    = false;
+
+    return true;
+}
+
+bool PairwiseDensity::getCalibration(double& _bufferMs, double& _imageMs) const
+{
+    _bufferMs = this->bufferMs;
+    _imageMs  = this->imageMs;
+
+    return this->calibrated;
+}
+
+/**
+ * Allocates the bins and the work list for the bound number of particles,
+ * and binds them. The bin counts start at zero; scanPairBins clears them
+ * after every use
+ */
+bool PairwiseDensity::createBalanceBuffers()
+{
+    if (this->numParticles <= 0) {
+        return true;
+    }
+
+    size_t n   = static_cast<size_t>(this->numParticles);
+    cl_int err = CL_SUCCESS;
+
+    this->particleBin = clCreateBuffer(this->context, CL_MEM_READ_WRITE, n * sizeof(cl_int), NULL, &err);
+
+    if (!checkError(err, "clCreateBuffer (particleBin)")) {
+        this->releaseBalanceBuffers();
+        return false;
+    }
+
+    this->workList = clCreateBuffer(this->context, CL_MEM_READ_WRITE, n * sizeof(cl_int), NULL, &err);
+
+    if (!checkError(err, "clCreateBuffer (workList)")) {
+        this->releaseBalanceBuffers();
+        return false;
+    }
+
+    cl_int zeros[BINS] = { 0 };
+
+    this->binCounts = clCreateBuffer(this->context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(zeros), zeros, &err);
+
+    if (!checkError(err, "clCreateBuffer (binCounts)")) {
+        this->releaseBalanceBuffers();
+        return false;
+    }
+
+    this->binCursors = clCreateBuffer(this->context, CL_MEM_READ_WRITE, sizeof(zeros), NULL, &err);
+
+    if (!checkError(err, "clCreateBuffer (binCursors)")) {
+        this->releaseBalanceBuffers();
+        return false;
+    }
+
+    this->bindBalanced();
+
+    return true;
+}
+
+void PairwiseDensity::releaseBalanceBuffers()
+{
+    cl_mem* buffers[] = { &this->particleBin, &this->workList, &this->binCounts, &this->binCursors };
+
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (*buffers[i] != NULL) {
+            clReleaseMemObject(*buffers[i]);
+            *buffers[i] = NULL;
+        }
+    }
+}
+
+/**
+ * Binds the balance buffers to the kernels of the balanced run
+ */
+void PairwiseDensity::bindBalanced()
+{
+    // KERNEL :: countPairCandidates
+
+    cl_kernel k = this->countCandidatesKernel;
+    setArg(k, 0, this->sortedParticleToCell);
+    setArg(k, 1, this->gridCellOffsets);
+    setArg(k, 2, this->numParticles);
+    setArg(k, 3, this->cellsPerAxis[0]);
+    setArg(k, 4, this->cellsPerAxis[1]);
+    setArg(k, 5, this->cellsPerAxis[2]);
+    setArg(k, 6, this->particleBin);
+    setArg(k, 7, this->binCounts);
+
+    // KERNEL :: scanPairBins
+
+    k = this->scanBinsKernel;
+    setArg(k, 0, this->binCounts);
+    setArg(k, 1, this->binCursors);
+
+    // KERNEL :: scatterPairWork
+
+    k = this->scatterWorkKernel;
+    setArg(k, 0, this->particleBin);
+    setArg(k, 1, this->numParticles);
+    setArg(k, 2, this->binCursors);
+    setArg(k, 3, this->workList);
+
+    setArg(this->accumulateBalancedKernel, 8, this->workList);
+}
+
+/**
+ * Enables or disables binning the particles by their number of candidates
+ *
+ * @param [in] enabled Whether to balance subsequent runs
+ */
+bool PairwiseDensity::setBalanced(bool enabled)
+{
+    if (enabled == this->balanced) {
+        return true;
+    }
+
+    if (!enabled) {
+        this->releaseBalanceBuffers();
+        this->balanced = false;
+        return true;
+    }
+
+    if (!this->isLoaded() || !this->createBalanceBuffers()) {
+        return false;
+    }
+
+    this->balanced = true;
+
+    return true;
+}
+
+/**
+ * Enqueues a kernel run, collecting its event if requested
+ */
+void PairwiseDensity::run(cl_kernel kernel, size_t globalSize)
+{
+    if (this->events == NULL) {
+        run1D(this->queue, kernel, globalSize);
+        return;
+    }
+
+    cl_event event = NULL;
+
+    run1D(this->queue, kernel, globalSize, 0, &event);
+
+    if (event != NULL) {
+        this->events->push_back(event);
+    }
+}
+
+/**
+ * Returns the number of cells of the given color
+ */
+size_t PairwiseDensity::cellsOfColor(int x, int y, int z) const
+{
+    int color[3] = { x, y, z };
+    size_t cells = 1;
+
+    for (int i = 0; i < 3; i++) {
+        int n = (this->cellsPerAxis[i] - color[i] + COLORS[i] - 1) / COLORS[i];
+        cells *= static_cast<size_t>(n > 0 ? n : 0);
+    }
+
+    return cells;
+}
+
+/**
+ * Enqueues the density estimate of the bound buffers, timing buffer and
+ * image reads first if automatic selection hasn't yet
+ */
+void PairwiseDensity::evaluate()
+{
+    if (!this->isLoaded() || this->numParticles <= 0) {
+        return;
+    }
+
+    if (this->neighborReads == NEIGHBOR_READS_AUTO && !this->calibrated && !this->colored) {
+        this->calibrate();
+    }
+
+    this->enqueue();
+}
+
+/**
+ * Enqueues one run of the selected path
+ */
+void PairwiseDensity::enqueue()
+{
+    size_t n = static_cast<size_t>(this->numParticles);
+
+    this->run(this->resetKernel, n);
+
+    if (this->colored) {
+
+        // Colors run one after another on the (in-order) queue, and no two
+        // cells of a color write to the same particle:
+
+        for (int z = 0; z < COLORS[2]; z++) {
+            for (int y = 0; y < COLORS[1]; y++) {
+                for (int x = 0; x < COLORS[0]; x++) {
+
+                    size_t cells = this->cellsOfColor(x, y, z);
+
+                    if (cells == 0) {
+                        continue;
+                    }
+
+                    cl_int4 color = {{ x, y, z, 0 }};
+
+                    setArg(this->accumulateColoredKernel, 7, color);
+
+                    this->run(this->accumulateColoredKernel, cells);
+                }
+            }
+        }
+
+        return;
+    }
+
+    if (this->balanced) {
+        this->run(this->countCandidatesKernel, n);
+        this->run(this->scanBinsKernel, 1);
+        this->run(this->scatterWorkKernel, n);
+    }
+
+    if (this->imageReads) {
+
+        cl_mem workList = this->balanced ? this->workList : NULL;
+
+        setArg(this->accumulateImageKernel, 8, workList);
+
+        this->run(this->mirrorPositionsKernel, n);
+        this->run(this->accumulateImageKernel, n);
+        return;
+    }
+
+    this->run(this->balanced ? this->accumulateBalancedKernel : this->accumulateKernel, n);
+}
+
+/**
+ * Returns the mean wall-clock milliseconds of CALIBRATION_RUNS runs reading
+ * neighbors from the buffer or the image, after a warm-up run
+ */
+double PairwiseDensity::timeRuns(bool image)
+{
+    this->imageReads = image;
+
+    this->enqueue();
+
+    clFinish(this->queue);
+
+    auto start = chrono::steady_clock::now();
+
+    for (int i = 0; i < CALIBRATION_RUNS; i++) {
+        this->enqueue();
+    }
+
+    clFinish(this->queue);
+
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / CALIBRATION_RUNS;
+}
+
+/**
+ * Times buffer and image reads on the current step's data and keeps the
+ * faster. The density is recomputed by the run that follows, so the timed
+ * runs have no effect on the step
+ */
+void PairwiseDensity::calibrate()
+{
+    this->calibrated = true;
+    this->imageMs    = 0.0;
+
+    // Timed runs aren't stages of the step:
+
+    vector<cl_event>* events = this->events;
+
+    this->events = NULL;
+
+    this->bufferMs = this->timeRuns(false);
+
+    if (this->positionImage != NULL) {
+        this->imageMs = this->timeRuns(true);
+    }
+
+    this->events     = events;
+    this->imageReads = this->positionImage != NULL && this->imageMs < this->bufferMs;
+}
+
+/**
+ * Estimates the lane utilization of the accumulate kernel from the number of
+ * pair candidates of every particle, as counted by countPairCandidates
+ */
+LaneUtilization PairwiseDensity::measureLaneUtilization()
+{
+    LaneUtilization utilization;
+
+    utilization.simdWidth = 1;
+    utilization.sorted    = 1.0;
+    utilization.balanced  = 1.0;
+
+    int numCells = this->cellsPerAxis[0] * this->cellsPerAxis[1] * this->cellsPerAxis[2];
+
+    if (!this->isLoaded() || this->numParticles <= 0 || numCells <= 0) {
+        return utilization;
+    }
+
+    size_t multiple = 0;
+
+    clGetKernelWorkGroupInfo(this->accumulateKernel
+                            ,this->device
+                            ,CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE
+                            ,sizeof(multiple)
+                            ,&multiple
+                            ,NULL);
+
+    utilization.simdWidth = max(static_cast<int>(multiple), 1);
+
+    vector<ParticlePosition> sorted(this->numParticles);
+    vector<GridCellOffset> offsets(numCells);
+
+    if (!checkError(clEnqueueReadBuffer(this->queue
+                                       ,this->sortedParticleToCell
+                                       ,CL_TRUE
+                                       ,0
+                                       ,sorted.size() * sizeof(ParticlePosition)
+                                       ,&sorted[0]
+                                       ,0
+                                       ,NULL
+                                       ,NULL)
+                   ,"clEnqueueReadBuffer (sortedParticleToCell)")) {
+        return utilization;
+    }
+
+    if (!checkError(clEnqueueReadBuffer(this->queue
+                                       ,this->gridCellOffsets
+                                       ,CL_TRUE
+                                       ,0
+                                       ,offsets.size() * sizeof(GridCellOffset)
+                                       ,&offsets[0]
+                                       ,0
+                                       ,NULL
+                                       ,NULL)
+                   ,"clEnqueueReadBuffer (gridCellOffsets)")) {
+        return utilization;
+    }
+
+    int cellsX = this->cellsPerAxis[0];
+    int cellsY = this->cellsPerAxis[1];
+    int cellsZ = this->cellsPerAxis[2];
+
+    // Candidates per particle, as in pairCandidates() in kernels/Pairwise.cl,
+    // plus one for the 13 cell lookups every particle makes:
+
+    static const int HALF_SHELL[13][3] = {
+        {  1,  0,  0 },
+        { -1,  1,  0 }, {  0,  1,  0 }, {  1,  1,  0 },
+        { -1, -1,  1 }, {  0, -1,  1 }, {  1, -1,  1 },
+        { -1,  0,  1 }, {  0,  0,  1 }, {  1,  0,  1 },
+        { -1,  1,  1 }, {  0,  1,  1 }, {  1,  1,  1 }
+    };
+
+    vector<int> work(this->numParticles);
+    vector<int> binCount(BINS, 0);
+
+    for (int s = 0; s < this->numParticles; s++) {
+
+        const ParticlePosition& pp = sorted[s];
+        const GridCellOffset& own  = offsets[pp.cellI + (pp.cellJ * cellsX) + (pp.cellK * cellsX * cellsY)];
+
+        int candidates = max((own.start + own.length) - (s + 1), 0);
+
+        for (int n = 0; n < 13; n++) {
+
+            int i = pp.cellI + HALF_SHELL[n][0];
+            int j = pp.cellJ + HALF_SHELL[n][1];
+            int k = pp.cellK + HALF_SHELL[n][2];
+
+            if (i < 0 || j < 0 || k < 0 || i >= cellsX || j >= cellsY || k >= cellsZ) {
+                continue;
+            }
+
+            const GridCellOffset& offset = offsets[i + (j * cellsX) + (k * cellsX * cellsY)];
+
+            if (offset.start != -1) {
+                candidates += offset.length;
+            }
+        }
+
+        work[s] = candidates + 1;
+
+        binCount[min(candidates / BIN_WIDTH, BINS - 1)]++;
+    }
+
+    // Cell order, and the order scatterPairWork produces (heaviest bin
+    // first; order within a bin is arbitrary on the device, kept here):
+
+    vector<int> order(this->numParticles);
+    vector<int> cursor(BINS, 0);
+
+    for (int bin = BINS - 2; bin >= 0; bin--) {
+        cursor[bin] = cursor[bin + 1] + binCount[bin + 1];
+    }
+
+    for (int s = 0; s < this->numParticles; s++) {
+        order[s] = s;
+    }
+
+    utilization.sorted = laneUtilization(work, order, utilization.simdWidth);
+
+    for (int s = 0; s < this->numParticles; s++) {
+        order[cursor[min((work[s] - 1) / BIN_WIDTH, BINS - 1)]++] = s;
+    }
+
+    utilization.balanced = laneUtilization(work, order, utilization.simdWidth);
+
+    return utilization;
+}
+
+}
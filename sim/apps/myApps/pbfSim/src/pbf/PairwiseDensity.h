@@ -0,0 +1,217 @@
+/*******************************************************************************
+ * PairwiseDensity.h
+ * - Symmetric density estimate: each pair of neighboring particles is
+ *   evaluated once, through a half-shell stencil of cells, and added to both
+ *   particles. See kernels/Pairwise.cl
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_PAIRWISE_DENSITY_H
+#define PBF_LIB_PAIRWISE_DENSITY_H
+
+#include <string>
+#include <vector>
+#include "Program.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+struct DeviceBuffers;
+
+/**
+ * Share of the SIMD lane time of the accumulate kernel spent on work rather
+ * than idle behind longer loops of the same SIMD group, as estimated from
+ * each particle's number of pair candidates
+ */
+typedef struct {
+
+    int simdWidth;      // Lanes per SIMD group (the kernel's preferred work
+                        // group size multiple)
+
+    double sorted;      // Particles in cell order, one per work-item
+
+    double balanced;    // Particles binned by their number of candidates
+
+} LaneUtilization;
+
+/**
+ * Where the accumulate kernel reads the positions of neighbors from
+ */
+enum NeighborReads {
+    NEIGHBOR_READS_BUFFER = 0,  // The particle buffer, via the sorted indices
+    NEIGHBOR_READS_IMAGE,       // An image mirroring the sorted positions,
+                                // through the texture cache
+    NEIGHBOR_READS_AUTO         // Whichever of the two is faster on the
+                                // device, timed on the first run after binding
+};
+
+/**
+ * Computes the density of every particle from the sorted particles and grid
+ * cell offsets of a step, writing the same values as the gather-based
+ * estimateDensity kernel. Writes to a partner's density are made safe either
+ * with atomics, or, on CPU devices, by running the cells in 18 colors whose
+ * half shells don't overlap
+ */
+class PairwiseDensity
+{
+    public:
+        // Bins of the balanced run; these must match PAIR_BINS and
+        // PAIR_BIN_WIDTH in kernels/Pairwise.cl
+        static const int BINS      = 16;
+        static const int BIN_WIDTH = 8;
+
+        // Runs of each path timed by NEIGHBOR_READS_AUTO
+        static const int CALIBRATION_RUNS = 5;
+
+    private:
+        cl_context context;
+
+        cl_device_id device;
+
+        cl_command_queue queue;
+
+        // kernels/Pairwise.cl and its kernels
+        Program program;
+
+        cl_kernel resetKernel;
+        cl_kernel accumulateKernel;
+        cl_kernel accumulateColoredKernel;
+        cl_kernel accumulateBalancedKernel;
+        cl_kernel countCandidatesKernel;
+        cl_kernel scanBinsKernel;
+        cl_kernel scatterWorkKernel;
+        cl_kernel mirrorPositionsKernel;
+        cl_kernel accumulateImageKernel;
+
+        // Whether the colored, atomic-free path is used
+        bool colored;
+
+        // Whether particles are binned by their number of candidates before
+        // the (atomic) accumulate kernel runs
+        bool balanced;
+
+        // The solver's buffers the candidates are counted from
+        cl_mem sortedParticleToCell;
+        cl_mem gridCellOffsets;
+
+        // Buffers of the balanced run: int[numParticles] each, and int[BINS]
+        // each
+        cl_mem particleBin;
+        cl_mem workList;
+        cl_mem binCounts;
+        cl_mem binCursors;
+
+        // Neighbor reads selected (automatic by default), and whether the
+        // image is read. Images need device support, and a 2D image large
+        // enough for one texel per particle
+        NeighborReads neighborReads;
+        bool imageReads;
+        bool imageSupport;
+
+        // Whether NEIGHBOR_READS_AUTO has timed both paths since binding,
+        // and the mean milliseconds per run it measured
+        bool calibrated;
+        double bufferMs;
+        double imageMs;
+
+        // float4 image of the sorted positions (see mirrorSortedPositions)
+        cl_mem positionImage;
+
+        int numParticles;
+
+        int cellsPerAxis[3];
+
+        // If set, receives an event for every kernel run (see setEventList)
+        std::vector<cl_event>* events;
+
+        // Non-copyable
+        PairwiseDensity(const PairwiseDensity&);
+        PairwiseDensity& operator=(const PairwiseDensity&);
+
+        void run(cl_kernel kernel, size_t globalSize);
+
+        size_t cellsOfColor(int x, int y, int z) const;
+
+        bool createBalanceBuffers();
+
+        void releaseBalanceBuffers();
+
+        void bindBalanced();
+
+        bool createPositionImage();
+
+        void releasePositionImage();
+
+        void enqueue();
+
+        double timeRuns(bool image);
+
+        void calibrate();
+
+    public:
+        PairwiseDensity(cl_context context
+                       ,cl_device_id device
+                       ,cl_command_queue queue
+                       ,const std::string& dataPath);
+
+        virtual ~PairwiseDensity();
+
+        bool isLoaded() const { return this->program.isLoaded(); }
+
+        bool isColored() const { return this->colored; }
+
+        /**
+         * Bins the particles by their number of pair candidates every run,
+         * so the particles sharing SIMD lanes have loops of similar length.
+         * Only applies to the atomic path; CPU devices run by color
+         */
+        bool setBalanced(bool enabled);
+        bool isBalanced() const { return this->balanced; }
+
+        /**
+         * Selects where neighbor positions are read from. Returns false if
+         * image reads are selected and the device can't read them from an
+         * image, leaving buffer reads selected. Colored (CPU) runs always
+         * read buffers
+         */
+        bool setNeighborReads(NeighborReads reads);
+        NeighborReads getNeighborReads() const { return this->neighborReads; }
+
+        // Whether runs currently read the sorted position image
+        bool isReadingImage() const { return this->imageReads; }
+
+        /**
+         * The milliseconds per run NEIGHBOR_READS_AUTO measured for buffer
+         * and image reads. Returns false if it hasn't timed them since the
+         * buffers were bound
+         */
+        bool getCalibration(double& bufferMs, double& imageMs) const;
+
+        // Binds the buffers of a solver; called again whenever they change
+        void bind(const DeviceBuffers& buffers
+                 ,int numParticles
+                 ,const int cellsPerAxis[3]);
+
+        // Enqueues the density estimate; does not block
+        void evaluate();
+
+        /**
+         * Reads the sorted particles and grid cell offsets of the last step
+         * back and estimates the lane utilization of the accumulate kernel
+         * with particles in cell order, and binned. Blocks
+         */
+        LaneUtilization measureLaneUtilization();
+
+        // Collects the events of subsequent kernel runs into events, e.g.
+        // for profiling; NULL stops collecting
+        void setEventList(std::vector<cl_event>* events) { this->events = events; }
+};
+
+}
+
+/******************************************************************************/
+
+#endif
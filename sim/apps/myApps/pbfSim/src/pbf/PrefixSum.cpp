@@ -78,71 +78,107 @@ using namespace std;
 
 /******************************************************************************/
 
-PrefixSum::PrefixSum(msa::OpenCL& _openCL
+namespace pbf {
+
+/******************************************************************************/
+
+PrefixSum::PrefixSum(cl_context _context
+                    ,cl_device_id _device
+                    ,cl_command_queue _queue
+                    ,const string& _dataPath
                     ,int _GROUP_SIZE) :
-    openCL(_openCL),
-    GROUP_SIZE(_GROUP_SIZE),
-    ScanPartialSums(NULL),
+    context(_context),
+    queue(_queue),
+    program(_context, _device),
+    dataPath(_dataPath),
+    events(NULL),
     ElementsAllocated(0),
-    LevelsAllocated(0)
+    LevelsAllocated(0),
+    GROUP_SIZE(_GROUP_SIZE)
 {
     this->loadKernels();
 }
 
+PrefixSum::~PrefixSum()
+{
+    this->ReleasePartialSums();
+}
+
+/**
+ * Enqueues a kernel run, collecting its event if requested
+ */
+void PrefixSum::run(cl_kernel kernel, size_t global, size_t local)
+{
+    if (this->events == NULL) {
+        run1D(this->queue, kernel, global, local);
+        return;
+    }
+
+    cl_event event = NULL;
+
+    run1D(this->queue, kernel, global, local, &event);
+
+    if (event != NULL) {
+        this->events->push_back(event);
+    }
+}
+
 /**
  * Loads and initializes the kernels used in the prefix sum scan
  */
 void PrefixSum::loadKernels()
 {
-    this->openCL.loadProgramFromFile("kernels/Scan.cl");
-    
-    this->openCL.loadKernel("PreScanKernel");
-    this->openCL.loadKernel("PreScanStoreSumKernel");
-    this->openCL.loadKernel("PreScanStoreSumNonPowerOfTwoKernel");
-    this->openCL.loadKernel("PreScanNonPowerOfTwoKernel");
-    this->openCL.loadKernel("UniformAddKernel");
+    this->program.loadKernelFile("kernels/Scan.cl", this->dataPath);
+
+    this->preScanKernel                      = this->program.kernel("PreScanKernel");
+    this->preScanStoreSumKernel              = this->program.kernel("PreScanStoreSumKernel");
+    this->preScanStoreSumNonPowerOfTwoKernel = this->program.kernel("PreScanStoreSumNonPowerOfTwoKernel");
+    this->preScanNonPowerOfTwoKernel         = this->program.kernel("PreScanNonPowerOfTwoKernel");
+    this->uniformAddKernel                   = this->program.kernel("UniformAddKernel");
 }
 
 /**
  * CreatePartialSumBuffers
+ *
+ * The per-level partial sum buffers only depend on the element count, so
+ * they are kept between scans of the same size
  */
 int PrefixSum::CreatePartialSumBuffers(unsigned int count)
 {
+    if (count == ElementsAllocated) {
+        return CL_SUCCESS;
+    }
+
+    ReleasePartialSums();
+
     ElementsAllocated          = count;
     unsigned int group_size    = GROUP_SIZE;
     unsigned int element_count = count;
+    cl_int err                 = CL_SUCCESS;
     
-    int level = 0;
     do {
         unsigned int group_count = (int)std::max(1, (int)ceil((float)element_count / (2.0f * group_size)));
-
+       
         if (group_count > 1) {
-            level++;
-        }
 
-        element_count = group_count;
-        
-    } while (element_count > 1);
-    
-    for (int i = 0; i < level; i++) {
-        ScanPartialSums.push_back(new msa::OpenCLBuffer());
-    }
+            cl_mem buffer = clCreateBuffer(this->context
+                                          ,CL_MEM_READ_WRITE
+                                          ,group_count * sizeof(float)
+                                          ,NULL
+                                          ,&err);
 
-    LevelsAllocated = level;
-    
-    element_count = count;
-    level = 0;
-    
-    do {
-        unsigned int group_count = (int)std::max(1, (int)ceil((float)element_count / (2.0f * group_size)));
-       
-        if (group_count > 1) {
-            ScanPartialSums[level++]->initBuffer(group_count * sizeof(float));
+            if (!checkError(err, "clCreateBuffer (partial sums)")) {
+                return err;
+            }
+
+            ScanPartialSums.push_back(buffer);
         }
         
         element_count = group_count;
         
     } while (element_count > 1);
+
+    LevelsAllocated = static_cast<unsigned int>(ScanPartialSums.size());
     
     return CL_SUCCESS;
 }
@@ -152,7 +188,11 @@ int PrefixSum::CreatePartialSumBuffers(unsigned int count)
  */
 void PrefixSum::ReleasePartialSums()
 {
-    unsigned int i;
+    for (auto i = ScanPartialSums.begin(); i != ScanPartialSums.end(); i++) {
+        clReleaseMemObject(*i);
+    }
+
+    ScanPartialSums.clear();
 
     ElementsAllocated = 0;
     LevelsAllocated = 0;
@@ -164,21 +204,21 @@ void PrefixSum::ReleasePartialSums()
 int PrefixSum::PreScan(size_t *global
                       ,size_t *local
                       ,size_t shared
-                      ,msa::OpenCLBuffer& output_data
-                      ,msa::OpenCLBuffer& input_data
+                      ,cl_mem output_data
+                      ,cl_mem input_data
                       ,unsigned int n
                       ,int group_index
                       ,int base_index)
 {
-    auto kernel = this->openCL.kernel("PreScanKernel");
-    kernel->setArg(0, output_data);
-    kernel->setArg(1, input_data);
-    kernel->setArg(2, (void*)NULL, shared);
-    kernel->setArg(3, group_index);
-    kernel->setArg(4, base_index);
-    kernel->setArg(5, static_cast<int>(n));
+    cl_kernel kernel = this->preScanKernel;
+    setArg(kernel, 0, output_data);
+    setArg(kernel, 1, input_data);
+    setLocalArg(kernel, 2, shared);
+    setArg(kernel, 3, group_index);
+    setArg(kernel, 4, base_index);
+    setArg(kernel, 5, static_cast<int>(n));
 
-    kernel->run1D(*global, *local);
+    this->run(kernel, *global, *local);
 
     return CL_SUCCESS;
 }
@@ -189,23 +229,23 @@ int PrefixSum::PreScan(size_t *global
 int PrefixSum::PreScanStoreSum(size_t *global
                               ,size_t *local
                               ,size_t shared
-                              ,msa::OpenCLBuffer& output_data
-                              ,msa::OpenCLBuffer& input_data
-                              ,msa::OpenCLBuffer& partial_sums
+                              ,cl_mem output_data
+                              ,cl_mem input_data
+                              ,cl_mem partial_sums
                               ,unsigned int n
                               ,int group_index
                               ,int base_index)
 {
-    auto kernel = this->openCL.kernel("PreScanStoreSumKernel");
-    kernel->setArg(0, output_data);
-    kernel->setArg(1, input_data);
-    kernel->setArg(2, partial_sums);
-    kernel->setArg(3, (void*)NULL, shared);
-    kernel->setArg(4, group_index);
-    kernel->setArg(5, base_index);
-    kernel->setArg(6, static_cast<int>(n));
+    cl_kernel kernel = this->preScanStoreSumKernel;
+    setArg(kernel, 0, output_data);
+    setArg(kernel, 1, input_data);
+    setArg(kernel, 2, partial_sums);
+    setLocalArg(kernel, 3, shared);
+    setArg(kernel, 4, group_index);
+    setArg(kernel, 5, base_index);
+    setArg(kernel, 6, static_cast<int>(n));
     
-    kernel->run1D(*global, *local);
+    this->run(kernel, *global, *local);
 
     return CL_SUCCESS;
 }
@@ -216,23 +256,23 @@ int PrefixSum::PreScanStoreSum(size_t *global
 int PrefixSum::PreScanStoreSumNonPowerOfTwo(size_t *global
                                            ,size_t *local
                                            ,size_t shared
-                                           ,msa::OpenCLBuffer& output_data
-                                           ,msa::OpenCLBuffer& input_data
-                                           ,msa::OpenCLBuffer& partial_sums
+                                           ,cl_mem output_data
+                                           ,cl_mem input_data
+                                           ,cl_mem partial_sums
                                            ,unsigned int n
                                            ,int group_index
                                            ,int base_index)
 {
-    auto kernel = this->openCL.kernel("PreScanStoreSumNonPowerOfTwoKernel");
-    kernel->setArg(0, output_data);
-    kernel->setArg(1, input_data);
-    kernel->setArg(2, partial_sums);
-    kernel->setArg(3, (void*)NULL, shared);
-    kernel->setArg(4, group_index);
-    kernel->setArg(5, base_index);
-    kernel->setArg(6, static_cast<int>(n));
+    cl_kernel kernel = this->preScanStoreSumNonPowerOfTwoKernel;
+    setArg(kernel, 0, output_data);
+    setArg(kernel, 1, input_data);
+    setArg(kernel, 2, partial_sums);
+    setLocalArg(kernel, 3, shared);
+    setArg(kernel, 4, group_index);
+    setArg(kernel, 5, base_index);
+    setArg(kernel, 6, static_cast<int>(n));
     
-    kernel->run1D(*global, *local);
+    this->run(kernel, *global, *local);
 
     return CL_SUCCESS;
 }
@@ -243,22 +283,22 @@ int PrefixSum::PreScanStoreSumNonPowerOfTwo(size_t *global
 int PrefixSum::PreScanNonPowerOfTwo(size_t *global
                                    ,size_t *local
                                    ,size_t shared
-                                   ,msa::OpenCLBuffer& output_data
-                                   ,msa::OpenCLBuffer& input_data
+                                   ,cl_mem output_data
+                                   ,cl_mem input_data
                                    ,unsigned int n
                                    ,int group_index
                                    ,int base_index)
 {
-    auto kernel = this->openCL.kernel("PreScanNonPowerOfTwoKernel");
+    cl_kernel kernel = this->preScanNonPowerOfTwoKernel;
     
-    kernel->setArg(0, output_data);
-    kernel->setArg(1, input_data);
-    kernel->setArg(2, (void*)NULL, shared);
-    kernel->setArg(3, group_index);
-    kernel->setArg(4, base_index);
-    kernel->setArg(5, static_cast<int>(n));
+    setArg(kernel, 0, output_data);
+    setArg(kernel, 1, input_data);
+    setLocalArg(kernel, 2, shared);
+    setArg(kernel, 3, group_index);
+    setArg(kernel, 4, base_index);
+    setArg(kernel, 5, static_cast<int>(n));
     
-    kernel->run1D(*global, *local);
+    this->run(kernel, *global, *local);
 
     return CL_SUCCESS;
 }
@@ -268,22 +308,22 @@ int PrefixSum::PreScanNonPowerOfTwo(size_t *global
  */
 int PrefixSum::UniformAdd(size_t *global
                          ,size_t *local
-                         ,msa::OpenCLBuffer& output_data
-                         ,msa::OpenCLBuffer& partial_sums
+                         ,cl_mem output_data
+                         ,cl_mem partial_sums
                          ,unsigned int n
                          ,unsigned int group_offset
                          ,unsigned int base_index)
 {
-    auto kernel = this->openCL.kernel("UniformAddKernel");
+    cl_kernel kernel = this->uniformAddKernel;
     
-    kernel->setArg(0, output_data);
-    kernel->setArg(1, partial_sums);
-    kernel->setArg(2, (void*)NULL, sizeof(float));
-    kernel->setArg(3, static_cast<int>(group_offset));
-    kernel->setArg(4, static_cast<int>(base_index));
-    kernel->setArg(5, static_cast<int>(n));
+    setArg(kernel, 0, output_data);
+    setArg(kernel, 1, partial_sums);
+    setLocalArg(kernel, 2, sizeof(float));
+    setArg(kernel, 3, static_cast<int>(group_offset));
+    setArg(kernel, 4, static_cast<int>(base_index));
+    setArg(kernel, 5, static_cast<int>(n));
     
-    kernel->run1D(*global, *local);
+    this->run(kernel, *global, *local);
 
     return CL_SUCCESS;
 }
@@ -291,8 +331,8 @@ int PrefixSum::UniformAdd(size_t *global
 /**
  * PreScanBufferRecursive
  */
-int PrefixSum::PreScanBufferRecursive(msa::OpenCLBuffer& output_data
-                                     ,msa::OpenCLBuffer& input_data
+int PrefixSum::PreScanBufferRecursive(cl_mem output_data
+                                     ,cl_mem input_data
                                      ,int max_group_size
                                      ,int max_work_item_count
                                      ,int element_count
@@ -339,12 +379,12 @@ int PrefixSum::PreScanBufferRecursive(msa::OpenCLBuffer& output_data
     unsigned int padding = element_count_per_group / NUM_BANKS;
     size_t shared = sizeof(float) * (element_count_per_group + padding);
     
-    auto partial_sums = ScanPartialSums[level];
+    cl_mem partial_sums = (level < static_cast<int>(ScanPartialSums.size())) ? ScanPartialSums[level] : NULL;
     int err = CL_SUCCESS;
     
     if (group_count > 1) {
 
-        err = PreScanStoreSum(global, local, shared, output_data, input_data, *partial_sums, work_item_count * 2, 0, 0);
+        err = PreScanStoreSum(global, local, shared, output_data, input_data, partial_sums, work_item_count * 2, 0, 0);
 
         if (err != CL_SUCCESS) {
             return err;
@@ -360,7 +400,7 @@ int PrefixSum::PreScanBufferRecursive(msa::OpenCLBuffer& output_data
                                               ,last_shared
                                               ,output_data
                                               ,input_data
-                                              ,*partial_sums
+                                              ,partial_sums
                                               ,last_group_element_count
                                               ,group_count - 1
                                               ,element_count - last_group_element_count);
@@ -370,13 +410,13 @@ int PrefixSum::PreScanBufferRecursive(msa::OpenCLBuffer& output_data
             }
         }
         
-        err = PreScanBufferRecursive(*partial_sums, *partial_sums, max_group_size, max_work_item_count, group_count, level + 1);
+        err = PreScanBufferRecursive(partial_sums, partial_sums, max_group_size, max_work_item_count, group_count, level + 1);
 
         if (err != CL_SUCCESS) {
             return err;
         }
         
-        err = UniformAdd(global, local, output_data, *partial_sums, element_count - last_group_element_count, 0, 0);
+        err = UniformAdd(global, local, output_data, partial_sums, element_count - last_group_element_count, 0, 0);
 
         if (err != CL_SUCCESS) {
             return err;
@@ -388,7 +428,7 @@ int PrefixSum::PreScanBufferRecursive(msa::OpenCLBuffer& output_data
             size_t last_local[]  = { remaining_work_item_count, 1 };
             
             err = UniformAdd(last_global, last_local
-                            ,output_data, *partial_sums
+                            ,output_data, partial_sums
                             ,last_group_element_count
                             ,group_count - 1
                             ,element_count - last_group_element_count);
@@ -421,8 +461,8 @@ int PrefixSum::PreScanBufferRecursive(msa::OpenCLBuffer& output_data
 /**
  * PreScanBuffer
  */
-void PrefixSum::PreScanBuffer(msa::OpenCLBuffer& output_data
-                             ,msa::OpenCLBuffer& input_data
+void PrefixSum::PreScanBuffer(cl_mem output_data
+                             ,cl_mem input_data
                              ,unsigned int max_group_size
                              ,unsigned int max_work_item_count
                              ,unsigned int element_count)
@@ -435,8 +475,8 @@ void PrefixSum::PreScanBuffer(msa::OpenCLBuffer& output_data
                           ,0);
 }
 
-void PrefixSum::scan(msa::OpenCLBuffer& output_data
-                    ,msa::OpenCLBuffer& input_data
+void PrefixSum::scan(cl_mem output_data
+                    ,cl_mem input_data
                     ,unsigned int element_count)
 {
     CreatePartialSumBuffers(element_count);
@@ -448,3 +488,4 @@ void PrefixSum::scan(msa::OpenCLBuffer& output_data
                           ,0);
 }
 
+}
@@ -9,18 +9,42 @@
 
 #include <iostream>
 #include <cmath>
+#include <string>
 #include <vector>
-#include "MSAOpenCL.h"
+#include "Program.h"
 
 /******************************************************************************/
 
+namespace pbf {
+
+/**
+ * Exclusive parallel prefix sum (scan) of an int buffer. Buffers are passed
+ * as plain cl_mem handles, so any OpenCL wrapper's buffers can be scanned
+ */
 class PrefixSum
 {
     private:
-        // OpenCL manager
-        msa::OpenCL& openCL;
+        cl_context context;
+
+        cl_command_queue queue;
+
+        // Scan.cl and its kernels
+        Program program;
+
+        // Kernels, resolved once after loading
+        cl_kernel preScanKernel;
+        cl_kernel preScanStoreSumKernel;
+        cl_kernel preScanStoreSumNonPowerOfTwoKernel;
+        cl_kernel preScanNonPowerOfTwoKernel;
+        cl_kernel uniformAddKernel;
+
+        // Directory kernels/Scan.cl is loaded from
+        std::string dataPath;
 
-        std::vector<msa::OpenCLBuffer*> ScanPartialSums;
+        // If set, receives an event for every kernel run (see setEventList)
+        std::vector<cl_event>* events;
+
+        std::vector<cl_mem> ScanPartialSums;
         unsigned int ElementsAllocated;
         unsigned int LevelsAllocated;
     
@@ -37,6 +61,8 @@ class PrefixSum
         }
     
         void loadKernels();
+
+        void run(cl_kernel kernel, size_t global, size_t local);
     
     protected:
         int GROUP_SIZE;
@@ -48,8 +74,8 @@ class PrefixSum
         int PreScan(size_t *global
                    ,size_t *local
                    ,size_t shared
-                   ,msa::OpenCLBuffer& output_data
-                   ,msa::OpenCLBuffer& input_data
+                   ,cl_mem output_data
+                   ,cl_mem input_data
                    ,unsigned int n
                    ,int group_index
                    ,int base_index);
@@ -57,9 +83,9 @@ class PrefixSum
         int PreScanStoreSum(size_t *global
                            ,size_t *local
                            ,size_t shared
-                           ,msa::OpenCLBuffer& output_data
-                           ,msa::OpenCLBuffer& input_data
-                           ,msa::OpenCLBuffer& partial_sums
+                           ,cl_mem output_data
+                           ,cl_mem input_data
+                           ,cl_mem partial_sums
                            ,unsigned int n
                            ,int group_index
                            ,int base_index);
@@ -67,9 +93,9 @@ class PrefixSum
         int PreScanStoreSumNonPowerOfTwo(size_t *global
                                         ,size_t *local
                                         ,size_t shared
-                                        ,msa::OpenCLBuffer& output_data
-                                        ,msa::OpenCLBuffer& input_data
-                                        ,msa::OpenCLBuffer& partial_sums
+                                        ,cl_mem output_data
+                                        ,cl_mem input_data
+                                        ,cl_mem partial_sums
                                         ,unsigned int n
                                         ,int group_index
                                         ,int base_index);
@@ -77,40 +103,52 @@ class PrefixSum
         int PreScanNonPowerOfTwo(size_t *global
                                 ,size_t *local
                                 ,size_t shared
-                                ,msa::OpenCLBuffer& output_data
-                                ,msa::OpenCLBuffer& input_data
+                                ,cl_mem output_data
+                                ,cl_mem input_data
                                 ,unsigned int n
                                 ,int group_index
                                 ,int base_index);
     
         int UniformAdd(size_t *global
                       ,size_t *local
-                      ,msa::OpenCLBuffer& output_data
-                      ,msa::OpenCLBuffer& partial_sums
+                      ,cl_mem output_data
+                      ,cl_mem partial_sums
                       ,unsigned int n
                       ,unsigned int group_offset
                       ,unsigned int base_index);
         
-        int PreScanBufferRecursive(msa::OpenCLBuffer& output_data
-                                  ,msa::OpenCLBuffer& input_data
+        int PreScanBufferRecursive(cl_mem output_data
+                                  ,cl_mem input_data
                                   ,int max_group_size
                                   ,int max_work_item_count
                                   ,int element_count
                                   ,int level);
-        void PreScanBuffer(msa::OpenCLBuffer& output_data
-                          ,msa::OpenCLBuffer& input_data
+        void PreScanBuffer(cl_mem output_data
+                          ,cl_mem input_data
                           ,unsigned int max_group_size
                           ,unsigned int max_work_item_count
                           ,unsigned int element_count);
     
         public:
-            PrefixSum(msa::OpenCL& openCL, int GROUP_SIZE = 256);
+            PrefixSum(cl_context context
+                     ,cl_device_id device
+                     ,cl_command_queue queue
+                     ,const std::string& dataPath
+                     ,int GROUP_SIZE = 256);
+
+            virtual ~PrefixSum();
 
-            void scan(msa::OpenCLBuffer& output_data
-                     ,msa::OpenCLBuffer& input_data
+            void scan(cl_mem output_data
+                     ,cl_mem input_data
                      ,unsigned int element_count);
+
+            // Collects the events of subsequent kernel runs into events, e.g.
+            // for profiling; NULL stops collecting
+            void setEventList(std::vector<cl_event>* events) { this->events = events; }
 };
 
+}
+
 /******************************************************************************/
 
 #endif
@@ -0,0 +1,396 @@
+/*******************************************************************************
+ * Program.cpp
+ * - A minimal OpenCL program/kernel wrapper used by libpbf in place of
+ *   ofxMSAOpenCL, so the solver core has no openFrameworks dependency
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <future>
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include "KernelSources.h"
+#include "Program.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+namespace {
+
+// Programs started by prebuildProgram(), until a Program takes them over.
+// The key is made by prebuildKey()
+
+mutex prebuildLock;
+
+map<string, shared_future<cl_program> > prebuilt;
+
+bool embeddedKernels = true;
+
+string prebuildKey(cl_context context
+                  ,cl_device_id device
+                  ,const string& kernelPath
+                  ,const string& options)
+{
+    ostringstream key;
+    key << context << "|" << device << "|" << kernelPath << "|" << options;
+    return key.str();
+}
+
+/**
+ * Creates and builds a program from the given source strings, logging the
+ * build log if it fails. Returns NULL on failure
+ */
+cl_program buildProgram(cl_context context
+                       ,cl_device_id device
+                       ,cl_uint count
+                       ,const char** sources
+                       ,const size_t* lengths
+                       ,const string& name
+                       ,const string& includePath
+                       ,const string& options)
+{
+    cl_int err         = CL_SUCCESS;
+    cl_program program = clCreateProgramWithSource(context, count, sources, lengths, &err);
+
+    if (!checkError(err, "clCreateProgramWithSource")) {
+        return NULL;
+    }
+
+    string buildOptions = "-I \"" + includePath + "\"";
+
+    if (!options.empty()) {
+        buildOptions += " " + options;
+    }
+
+    err = clBuildProgram(program, 1, &device, buildOptions.c_str(), NULL, NULL);
+
+    if (err != CL_SUCCESS) {
+
+        size_t logLength = 0;
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &logLength);
+
+        vector<char> log(logLength + 1, '\0');
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, logLength, &log[0], NULL);
+
+        cerr << "[pbf] Error building " << name << ":" << endl << &log[0] << endl;
+
+        clReleaseProgram(program);
+
+        return NULL;
+    }
+
+    return program;
+}
+
+/**
+ * Builds a kernel file from its embedded copy, or from the data folder
+ */
+cl_program buildKernelFile(cl_context context
+                          ,cl_device_id device
+                          ,const string& kernelPath
+                          ,const string& dataPath
+                          ,const string& options)
+{
+    const KernelSource* embedded = findKernelSource(kernelPath);
+
+    if (embedded != NULL) {
+        return buildProgram(context
+                           ,device
+                           ,static_cast<cl_uint>(embedded->numLines)
+                           ,const_cast<const char**>(embedded->lines)
+                           ,NULL
+                           ,kernelPath
+                           ,dataPath
+                           ,options);
+    }
+
+    string filename = joinPath(dataPath, kernelPath);
+
+    ifstream file(filename.c_str(), ios::in | ios::binary);
+
+    if (!file.is_open()) {
+        cerr << "[pbf] Couldn't open kernel source: " << filename << endl;
+        return NULL;
+    }
+
+    stringstream contents;
+    contents << file.rdbuf();
+
+    string source    = contents.str();
+    const char* text = source.c_str();
+    size_t length    = source.size();
+
+    return buildProgram(context, device, 1, &text, &length, filename, dataPath, options);
+}
+
+}
+
+/******************************************************************************/
+
+const KernelSource* findKernelSource(const string& path)
+{
+    if (!embeddedKernels) {
+        return NULL;
+    }
+
+    for (int i = 0; i < NUM_EMBEDDED_KERNELS; i++) {
+        if (path == EMBEDDED_KERNELS[i].path) {
+            return &EMBEDDED_KERNELS[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool getKernelSource(const string& path, string& source)
+{
+    const KernelSource* embedded = findKernelSource(path);
+
+    if (embedded == NULL) {
+        return false;
+    }
+
+    source.clear();
+
+    for (int i = 0; i < embedded->numLines; i++) {
+        source += embedded->lines[i];
+    }
+
+    return true;
+}
+
+void setEmbeddedKernels(bool enabled)
+{
+    embeddedKernels = enabled;
+}
+
+bool isUsingEmbeddedKernels()
+{
+    return embeddedKernels;
+}
+
+void prebuildProgram(cl_context context
+                    ,cl_device_id device
+                    ,const string& kernelPath
+                    ,const string& dataPath
+                    ,const string& options)
+{
+    string key = prebuildKey(context, device, kernelPath, options);
+
+    lock_guard<mutex> guard(prebuildLock);
+
+    if (prebuilt.find(key) != prebuilt.end()) {
+        return;
+    }
+
+    prebuilt[key] = async(launch::async, buildKernelFile, context, device, kernelPath, dataPath, options).share();
+}
+
+/******************************************************************************/
+
+bool checkError(cl_int err, const char* what)
+{
+    if (err != CL_SUCCESS) {
+        cerr << "[pbf] " << what << " failed with error " << err << endl;
+        return false;
+    }
+    return true;
+}
+
+void run1D(cl_command_queue queue
+          ,cl_kernel kernel
+          ,size_t globalSize
+          ,size_t localSize
+          ,cl_event* event)
+{
+    if (localSize > 0) {
+        globalSize = ((globalSize + localSize - 1) / localSize) * localSize;
+    }
+
+    cl_int err = clEnqueueNDRangeKernel(queue
+                                       ,kernel
+                                       ,1
+                                       ,NULL
+                                       ,&globalSize
+                                       ,localSize > 0 ? &localSize : NULL
+                                       ,0
+                                       ,NULL
+                                       ,event);
+
+    checkError(err, "clEnqueueNDRangeKernel");
+}
+
+string joinPath(const string& directory, const string& path)
+{
+    if (directory.empty()) {
+        return path;
+    }
+
+    char last = directory[directory.size() - 1];
+
+    return (last == '/' || last == '\\') ? directory + path : directory + "/" + path;
+}
+
+/******************************************************************************/
+
+Program::Program(cl_context _context, cl_device_id _device) :
+    context(_context),
+    device(_device),
+    program(NULL)
+{
+
+}
+
+Program::~Program()
+{
+    this->release();
+}
+
+/**
+ * Releases the kernels and the program
+ */
+void Program::release()
+{
+    for (auto i = this->kernels.begin(); i != this->kernels.end(); i++) {
+        clReleaseKernel(i->second);
+    }
+
+    this->kernels.clear();
+
+    if (this->program != NULL) {
+        clReleaseProgram(this->program);
+        this->program = NULL;
+    }
+}
+
+/**
+ * Reads and builds the given OpenCL source file
+ *
+ * @param [in] filename Path to the source file
+ * @param [in] includePath Directory passed to the compiler with -I
+ * @param [in] options Additional build options
+ */
+bool Program::load(const string& filename
+                  ,const string& includePath
+                  ,const string& options)
+{
+    this->release();
+
+    ifstream file(filename.c_str(), ios::in | ios::binary);
+
+    if (!file.is_open()) {
+        cerr << "[pbf] Couldn't open kernel source: " << filename << endl;
+        return false;
+    }
+
+    stringstream contents;
+    contents << file.rdbuf();
+
+    string source    = contents.str();
+    const char* text = source.c_str();
+    size_t length    = source.size();
+
+    this->program = buildProgram(this->context, this->device, 1, &text, &length, filename, includePath, options);
+
+    return this->program != NULL;
+}
+
+/**
+ * Builds a kernel file, taking over a prebuilt program if there is one
+ *
+ * @param [in] kernelPath Kernel file relative to the data folder
+ * @param [in] dataPath The data folder, also passed to the compiler with -I
+ * @param [in] options Additional build options
+ */
+bool Program::loadKernelFile(const string& kernelPath
+                            ,const string& dataPath
+                            ,const string& options)
+{
+    this->release();
+
+    shared_future<cl_program> pending;
+
+    {
+        lock_guard<mutex> guard(prebuildLock);
+
+        auto found = prebuilt.find(prebuildKey(this->context, this->device, kernelPath, options));
+
+        if (found != prebuilt.end()) {
+            pending = found->second;
+            prebuilt.erase(found);
+        }
+    }
+
+    if (pending.valid()) {
+        this->program = pending.get();
+    } else {
+        this->program = buildKernelFile(this->context, this->device, kernelPath, dataPath, options);
+    }
+
+    return this->program != NULL;
+}
+
+/**
+ * Returns the named kernel, creating it the first time it's requested.
+ * Returns NULL if the kernel doesn't exist in the program
+ *
+ * @param [in] name The kernel name
+ */
+cl_kernel Program::kernel(const string& name)
+{
+    auto found = this->kernels.find(name);
+
+    if (found != this->kernels.end()) {
+        return found->second;
+    }
+
+    if (this->program == NULL) {
+        return NULL;
+    }
+
+    cl_int err       = CL_SUCCESS;
+    cl_kernel kernel = clCreateKernel(this->program, name.c_str(), &err);
+
+    if (!checkError(err, ("clCreateKernel(" + name + ")").c_str())) {
+        return NULL;
+    }
+
+    this->kernels[name] = kernel;
+
+    return kernel;
+}
+
+bool Program::hasKernel(const string& name)
+{
+    if (this->kernels.find(name) != this->kernels.end()) {
+        return true;
+    }
+
+    if (this->program == NULL) {
+        return false;
+    }
+
+    cl_int err       = CL_SUCCESS;
+    cl_kernel kernel = clCreateKernel(this->program, name.c_str(), &err);
+
+    if (err != CL_SUCCESS) {
+        return false;
+    }
+
+    this->kernels[name] = kernel;
+
+    return true;
+}
+
+}
+
+/******************************************************************************/
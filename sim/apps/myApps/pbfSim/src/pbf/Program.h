@@ -0,0 +1,148 @@
+/*******************************************************************************
+ * Program.h
+ * - A minimal OpenCL program/kernel wrapper used by libpbf in place of
+ *   ofxMSAOpenCL, so the solver core has no openFrameworks dependency
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_PROGRAM_H
+#define PBF_LIB_PROGRAM_H
+
+#include <map>
+#include <string>
+
+#ifdef __APPLE__
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/opencl.h>
+#endif
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * Logs an OpenCL error to stderr. Returns true if err is CL_SUCCESS
+ *
+ * @param [in] err The OpenCL status code
+ * @param [in] what Description of the failed operation
+ */
+bool checkError(cl_int err, const char* what);
+
+/**
+ * Sets a by-value kernel argument
+ */
+template <typename T>
+inline bool setArg(cl_kernel kernel, int index, const T& value)
+{
+    return checkError(clSetKernelArg(kernel, index, sizeof(T), &value), "clSetKernelArg");
+}
+
+/**
+ * Sets a __local kernel argument of the given size, in bytes
+ */
+inline bool setLocalArg(cl_kernel kernel, int index, size_t size)
+{
+    return checkError(clSetKernelArg(kernel, index, size, NULL), "clSetKernelArg");
+}
+
+/**
+ * Enqueues a 1D kernel run. If localSize is non-zero, globalSize is rounded
+ * up to the next multiple of it. If event is given, it receives an event
+ * for the run, which the caller must release
+ */
+void run1D(cl_command_queue queue
+          ,cl_kernel kernel
+          ,size_t globalSize
+          ,size_t localSize = 0
+          ,cl_event* event = NULL);
+
+/**
+ * Starts building a kernel file (as Program::loadKernelFile() would) on a
+ * worker thread, e.g. while the application is still setting up. The next
+ * Program that loads the same file for the same context, device and options
+ * takes over the built program instead of building it again, waiting for the
+ * build if it's still running. Builds of different files run concurrently
+ *
+ * @param [in] context The context the program is built in
+ * @param [in] device The device it is built for
+ * @param [in] kernelPath Kernel file relative to the data folder, e.g.
+ *             "kernels/Simulation.cl"
+ * @param [in] dataPath The data folder
+ * @param [in] options Build options, as given to loadKernelFile()
+ */
+void prebuildProgram(cl_context context
+                    ,cl_device_id device
+                    ,const std::string& kernelPath
+                    ,const std::string& dataPath
+                    ,const std::string& options = "");
+
+/**
+ * A program built from a single source file, with its kernels created on
+ * first use. The program and kernels are released with the instance; the
+ * context and device are borrowed
+ */
+class Program
+{
+    private:
+        cl_context context;
+
+        cl_device_id device;
+
+        cl_program program;
+
+        std::map<std::string, cl_kernel> kernels;
+
+        // Non-copyable
+        Program(const Program&);
+        Program& operator=(const Program&);
+
+        void release();
+
+    public:
+        Program(cl_context context, cl_device_id device);
+
+        virtual ~Program();
+
+        /**
+         * Builds the given source file. includePath is passed to the
+         * compiler as -I, so kernels can #include "kernels/Common.cl",
+         * followed by any other build options (e.g. "-D NAME"). Loading
+         * again replaces the program and releases its kernels
+         */
+        bool load(const std::string& filename
+                 ,const std::string& includePath
+                 ,const std::string& options = "");
+
+        /**
+         * Builds a kernel file given relative to the data folder, e.g.
+         * "kernels/Pairwise.cl". A program prebuilt by prebuildProgram() is
+         * taken over if there is one; otherwise the embedded copy of the
+         * file is built (see KernelSources.h), or the file in dataPath if
+         * there is none
+         */
+        bool loadKernelFile(const std::string& kernelPath
+                           ,const std::string& dataPath
+                           ,const std::string& options = "");
+
+        bool isLoaded() const { return this->program != NULL; }
+
+        cl_kernel kernel(const std::string& name);
+
+        // Tests if the program declares the named kernel, without logging
+        // an error if it doesn't
+        bool hasKernel(const std::string& name);
+};
+
+/**
+ * Joins a directory and a relative path with a single separator
+ */
+std::string joinPath(const std::string& directory, const std::string& path);
+
+}
+
+/******************************************************************************/
+
+#endif
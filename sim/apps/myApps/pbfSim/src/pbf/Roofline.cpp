@@ -0,0 +1,355 @@
+/*******************************************************************************
+ * Roofline.cpp
+ * - A per-kernel cost model of the solver (bytes moved and flops per
+ *   particle, per grid cell and per neighbor visited), combined with the
+ *   profiled stage timings into achieved GB/s and GFLOP/s, and placed on a
+ *   roofline against the device's peaks
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "Roofline.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * The cost model of kernels/Simulation.cl, per run. Sizes are those of the
+ * device types: Particle 48 bytes, ParticlePosition 32, GridCellOffset 16.
+ * Every neighbor search reads the 27 GridCellOffsets around the particle's
+ * cell (432 bytes) plus the particle's own ParticlePosition and predicted
+ * position (48 bytes); every candidate visited reads its particle index and
+ * predicted position (20 bytes) plus whatever the stage needs of it.
+ * Flops count the arithmetic of the smoothing kernels in Common.cl: poly6
+ * about 13, the spiky gradient about 18
+ */
+static const KernelCost KERNEL_COSTS[] = {
+
+    // stage                        cell   step   bytes  flops  nbytes nflops
+
+    // Clears particleToCell, sortedParticleToCell, density, lambda, posDelta
+    { "resetParticleQuantities",    false, false,  88.0,  0.0,   0.0,  0.0 },
+
+    // Clears the histogram, prefix sums and offsets of a cell
+    { "resetCellQuantities",        true,  false,  24.0,  0.0,   0.0,  0.0 },
+
+    // kernels/Forces.cl: reads the particle, writes vel and posStar; the
+    // force fields come from constant memory. Flops are for a few fields
+    { "predictPosition",            false, false,  80.0, 52.0,   0.0,  0.0 },
+
+    // Reads posStar, writes a ParticlePosition, increments the histogram
+    { "discretizeParticlePositions",false, false,  56.0, 16.0,   0.0,  0.0 },
+
+    // All passes: reads the histogram, writes the sums, plus the partial
+    // sums of the upper levels and the uniform add
+    { "scan",                       true,  true,   16.0,  2.0,   0.0,  0.0 },
+
+    // Reads a ParticlePosition, increments the prefix sum, writes it sorted
+    { "countSortParticlesByCell",   false, false,  72.0,  0.0,   0.0,  0.0 },
+
+    // Compares a sorted key with the previous one, writes the cell offset
+    { "findParticleBins",           false, false,  80.0,  0.0,   0.0,  0.0 },
+
+    // Sums poly6 over the neighbors, writes the density
+    { "estimateDensity",            false, false, 484.0,  2.0,  20.0, 13.0 },
+
+    // kernels/Pairwise.cl, in place of estimateDensity: the 14 offsets of
+    // the cell and its half shell, the self term, and half the candidates,
+    // each also adding to the partner's density (read-modify-write)
+    { "pairwiseDensity",            false, false, 280.0, 15.0,  14.0,  7.0 },
+
+    // Sums spiky gradients and their squared norms, reads the density,
+    // writes lambda
+    { "computeLambda",              false, false, 488.0,  8.0,  20.0, 26.0 },
+
+    // Spiky gradient scaled by both lambdas and the artificial pressure
+    // (poly6 raised to n), writes the position delta
+    { "computePositionDelta",       false, false, 500.0,  4.0,  24.0, 50.0 },
+
+    // Reads the delta, reads and writes posStar
+    { "updatePositionDelta",        false, false,  48.0,  3.0,   0.0,  0.0 },
+
+    // Relative velocity crossed with the spiky gradient, writes the curl
+    { "computeCurl",                false, false, 512.0,  2.0,  36.0, 33.0 },
+
+    // Vorticity confinement (curl gradient) and XSPH viscosity (poly6),
+    // writes the particle and its render position
+    { "updatePosition",             false, false, 592.0, 20.0,  52.0, 46.0 }
+};
+
+const double Roofline::LATENCY_BOUND_FRACTION = 0.25;
+
+/******************************************************************************/
+
+/**
+ * Queries the device's properties and estimates its peak FLOP rate as
+ * compute units * clock * lanes per unit * 2
+ *
+ * @param [in] device The device
+ */
+DeviceInfo Roofline::queryDevice(cl_device_id device)
+{
+    DeviceInfo info;
+
+    char name[256]   = { 0 };
+    char vendor[256] = { 0 };
+
+    cl_device_type type = 0;
+    cl_uint units       = 0;
+    cl_uint clock       = 0;
+    cl_uint vectorWidth = 0;
+    cl_ulong memory     = 0;
+
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_VENDOR, sizeof(vendor) - 1, vendor, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(units), &units, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(clock), &clock, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT, sizeof(vectorWidth), &vectorWidth, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(memory), &memory, NULL);
+
+    info.name           = name;
+    info.vendor         = vendor;
+    info.isGPU          = (type & CL_DEVICE_TYPE_GPU) != 0;
+    info.computeUnits   = static_cast<int>(units);
+    info.clockMHz       = static_cast<int>(clock);
+    info.globalMemBytes = memory;
+    info.peakGBps       = 0.0;
+
+    // Single precision lanes per compute unit. GPUs report streaming
+    // multiprocessors (NVIDIA), compute units (AMD) or execution units
+    // (Intel); CPUs report cores, which are assumed to have two vector
+    // FMA pipes:
+
+    double lanes = 32.0;
+
+    if (!info.isGPU) {
+        lanes = 2.0 * static_cast<double>(max(vectorWidth, 1u));
+    } else if (info.vendor.find("NVIDIA") != string::npos) {
+        lanes = 128.0;
+    } else if (info.vendor.find("AMD") != string::npos || info.vendor.find("Advanced Micro Devices") != string::npos) {
+        lanes = 64.0;
+    } else if (info.vendor.find("Intel") != string::npos) {
+        lanes = 8.0;
+    }
+
+    info.peakGflops = static_cast<double>(units) * static_cast<double>(clock) * 1.0e-3 * lanes * 2.0;
+
+    return info;
+}
+
+/**
+ * Measures the device memory bandwidth: a copy reads and writes every byte,
+ * so each one moves 2 * bytes
+ *
+ * @param [in] context Context to allocate the buffers in
+ * @param [in] queue Queue of the device to measure
+ * @param [in] bytes Size of the buffers
+ * @param [in] repetitions Number of copies timed
+ */
+double Roofline::measureBandwidth(cl_context context
+                                 ,cl_command_queue queue
+                                 ,size_t bytes
+                                 ,int repetitions)
+{
+    cl_int err = CL_SUCCESS;
+
+    cl_mem source = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, NULL, &err);
+    cl_mem target = err == CL_SUCCESS ? clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, NULL, &err) : NULL;
+
+    double gbps = 0.0;
+
+    if (checkError(err, "clCreateBuffer (bandwidth test)")) {
+
+        // The first copy also commits the buffers to the device, so it
+        // isn't timed:
+
+        clEnqueueCopyBuffer(queue, source, target, 0, 0, bytes, 0, NULL, NULL);
+        clFinish(queue);
+
+        auto start = chrono::steady_clock::now();
+
+        for (int i = 0; i < repetitions; i++) {
+            clEnqueueCopyBuffer(queue, (i & 1) ? target : source, (i & 1) ? source : target, 0, 0, bytes, 0, NULL, NULL);
+        }
+
+        clFinish(queue);
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (seconds > 0.0) {
+            gbps = 2.0 * static_cast<double>(bytes) * static_cast<double>(repetitions) / seconds * 1.0e-9;
+        }
+    }
+
+    if (source != NULL) {
+        clReleaseMemObject(source);
+    }
+
+    if (target != NULL) {
+        clReleaseMemObject(target);
+    }
+
+    return gbps;
+}
+
+const KernelCost* Roofline::getKernelCost(const string& stage)
+{
+    for (size_t i = 0; i < sizeof(KERNEL_COSTS) / sizeof(KernelCost); i++) {
+        if (stage == KERNEL_COSTS[i].stage) {
+            return &KERNEL_COSTS[i];
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************/
+
+RooflineReport Roofline::build(const DeviceInfo& device
+                              ,const vector<StageTiming>& timings
+                              ,int steps
+                              ,int numParticles
+                              ,int numCells
+                              ,double meanNeighbors)
+{
+    RooflineReport report;
+
+    report.device        = device;
+    report.numParticles  = numParticles;
+    report.numCells      = numCells;
+    report.steps         = steps;
+    report.meanNeighbors = meanNeighbors;
+
+    double ridge = device.peakGBps > 0.0 ? device.peakGflops / device.peakGBps : 0.0;
+
+    for (size_t i = 0; i < timings.size(); i++) {
+
+        const StageTiming& timing = timings[i];
+        const KernelCost* cost    = Roofline::getKernelCost(timing.name);
+
+        RooflineEntry entry = { timing.name, timing.ms, timing.runs, 0.0, 0.0, 0.0, 0.0, 0.0, "unmodeled" };
+
+        if (cost != NULL && timing.ms > 0.0) {
+
+            double items     = static_cast<double>(cost->perCell ? numCells : numParticles);
+            double neighbors = static_cast<double>(numParticles) * meanNeighbors;
+            double times     = static_cast<double>(cost->perStep ? steps : timing.runs);
+            double bytes     = times * (items * cost->bytesPerItem + neighbors * cost->bytesPerNeighbor);
+            double flops     = times * (items * cost->flopsPerItem + neighbors * cost->flopsPerNeighbor);
+            double seconds   = timing.ms * 1.0e-3;
+
+            entry.gbps      = bytes / seconds * 1.0e-9;
+            entry.gflops    = flops / seconds * 1.0e-9;
+            entry.intensity = bytes > 0.0 ? flops / bytes : 0.0;
+
+            // The roof at this intensity, and how close the stage gets to
+            // it on whichever side of the ridge point it falls:
+
+            bool memorySide = device.peakGBps > 0.0 && entry.intensity < ridge;
+
+            entry.roofGflops = memorySide ? entry.intensity * device.peakGBps : device.peakGflops;
+            entry.ofRoof     = memorySide ? entry.gbps / device.peakGBps
+                                          : (device.peakGflops > 0.0 ? entry.gflops / device.peakGflops : 0.0);
+
+            if (entry.ofRoof < Roofline::LATENCY_BOUND_FRACTION) {
+                entry.limiter = "latency";
+            } else {
+                entry.limiter = memorySide ? "bandwidth" : "compute";
+            }
+        }
+
+        report.entries.push_back(entry);
+    }
+
+    return report;
+}
+
+/******************************************************************************/
+
+static string quote(const string& value)
+{
+    string quoted = "\"";
+
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '"' || value[i] == '\\') {
+            quoted += '\\';
+        }
+        quoted += (static_cast<unsigned char>(value[i]) < 0x20) ? ' ' : value[i];
+    }
+
+    return quoted + "\"";
+}
+
+string Roofline::toJson(const RooflineReport& report)
+{
+    ostringstream json;
+
+    const DeviceInfo& d = report.device;
+
+    json << "{\n"
+         << "  \"device\": {"
+         << "\"name\": " << quote(d.name)
+         << ", \"vendor\": " << quote(d.vendor)
+         << ", \"gpu\": " << (d.isGPU ? "true" : "false")
+         << ", \"computeUnits\": " << d.computeUnits
+         << ", \"clockMHz\": " << d.clockMHz
+         << ", \"peakGflops\": " << d.peakGflops
+         << ", \"peakGBps\": " << d.peakGBps
+         << "},\n"
+         << "  \"particles\": " << report.numParticles << ",\n"
+         << "  \"cells\": " << report.numCells << ",\n"
+         << "  \"steps\": " << report.steps << ",\n"
+         << "  \"meanNeighbors\": " << report.meanNeighbors << ",\n"
+         << "  \"stages\": [";
+
+    for (size_t i = 0; i < report.entries.size(); i++) {
+
+        const RooflineEntry& e = report.entries[i];
+
+        json << (i == 0 ? "\n" : ",\n")
+             << "    {\"stage\": " << quote(e.stage)
+             << ", \"ms\": " << e.ms
+             << ", \"runs\": " << e.runs
+             << ", \"gbps\": " << e.gbps
+             << ", \"gflops\": " << e.gflops
+             << ", \"intensity\": " << e.intensity
+             << ", \"roofGflops\": " << e.roofGflops
+             << ", \"ofRoof\": " << e.ofRoof
+             << ", \"limiter\": " << quote(e.limiter)
+             << "}";
+    }
+
+    json << "\n  ]\n}\n";
+
+    return json.str();
+}
+
+bool Roofline::writeJson(const string& filename, const RooflineReport& report)
+{
+    ofstream out(filename.c_str());
+
+    if (!out) {
+        cerr << "[pbf] Couldn't write " << filename << endl;
+        return false;
+    }
+
+    out << Roofline::toJson(report);
+
+    return true;
+}
+
+}
+
+/******************************************************************************/
@@ -0,0 +1,168 @@
+/*******************************************************************************
+ * Roofline.h
+ * - A per-kernel cost model of the solver (bytes moved and flops per
+ *   particle, per grid cell and per neighbor visited), combined with the
+ *   profiled stage timings into achieved GB/s and GFLOP/s, and placed on a
+ *   roofline against the device's peaks
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_ROOFLINE_H
+#define PBF_LIB_ROOFLINE_H
+
+#include <string>
+#include <vector>
+#include "Solver.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * What the roofline is drawn against. OpenCL reports neither peak, so
+ * peakGflops is estimated from the compute units, clock and a per-vendor
+ * lane count, and peakGBps is measured with a device-to-device copy (see
+ * Roofline::measureBandwidth). Both can be overridden
+ */
+typedef struct {
+
+    std::string name;
+
+    std::string vendor;
+
+    bool isGPU;
+
+    int computeUnits;
+
+    int clockMHz;
+
+    unsigned long long globalMemBytes;
+
+    double peakGflops;   // Single precision, counting an FMA as 2 flops
+
+    double peakGBps;     // 0 until measured
+
+} DeviceInfo;
+
+/**
+ * Estimated cost of one run of a stage. "Items" are particles, or grid
+ * cells for the stages that run per cell. Bytes are counted as if every
+ * access went to device memory, so the GB/s reported is the effective
+ * bandwidth; caches can push it past the measured peak
+ */
+typedef struct {
+
+    const char* stage;
+
+    bool perCell;
+
+    // The cost covers all runs of a step (for multi-pass stages like the
+    // scan) rather than a single run
+    bool perStep;
+
+    double bytesPerItem;
+
+    double flopsPerItem;
+
+    // Per neighbor candidate visited (every particle in the cells of the
+    // neighbor stencil around a particle's cell); zero for stages with no
+    // neighbor search
+    double bytesPerNeighbor;
+
+    double flopsPerNeighbor;
+
+} KernelCost;
+
+typedef struct {
+
+    std::string stage;
+
+    double ms;           // Device time summed over the profiled runs
+
+    int runs;
+
+    double gbps;         // Achieved
+
+    double gflops;
+
+    double intensity;    // flops per byte
+
+    double roofGflops;   // Attainable at this intensity: min(peak, I * BW)
+
+    double ofRoof;       // Achieved / attainable, 0 - 1
+
+    // "bandwidth" or "compute" if the stage runs close to the roof on its
+    // side of the ridge point, "latency" if it's well below the roof
+    const char* limiter;
+
+} RooflineEntry;
+
+typedef struct {
+
+    DeviceInfo device;
+
+    int numParticles;
+
+    int numCells;
+
+    int steps;
+
+    double meanNeighbors;   // Candidates visited per particle
+
+    std::vector<RooflineEntry> entries;
+
+} RooflineReport;
+
+/******************************************************************************/
+
+class Roofline
+{
+    public:
+        // Entries below this fraction of their roof are considered
+        // latency-bound
+        static const double LATENCY_BOUND_FRACTION;
+
+        // Queries the device and estimates its peak FLOP rate
+        static DeviceInfo queryDevice(cl_device_id device);
+
+        /**
+         * Measures the device memory bandwidth by timing copies between two
+         * buffers of the given size. Returns 0 on failure
+         */
+        static double measureBandwidth(cl_context context
+                                      ,cl_command_queue queue
+                                      ,size_t bytes = 64 << 20
+                                      ,int repetitions = 8);
+
+        // Cost model of a stage, or NULL if there is none
+        static const KernelCost* getKernelCost(const std::string& stage);
+
+        /**
+         * Places the profiled stages on the roofline
+         *
+         * @param [in] device Peaks to compare against
+         * @param [in] timings Stage timings from Solver::collectStageTimings
+         * @param [in] steps Number of steps the timings cover
+         * @param [in] numParticles Particle count
+         * @param [in] numCells Grid cell count
+         * @param [in] meanNeighbors From Solver::measureNeighborCount
+         */
+        static RooflineReport build(const DeviceInfo& device
+                                   ,const std::vector<StageTiming>& timings
+                                   ,int steps
+                                   ,int numParticles
+                                   ,int numCells
+                                   ,double meanNeighbors);
+
+        static std::string toJson(const RooflineReport& report);
+
+        static bool writeJson(const std::string& filename, const RooflineReport& report);
+};
+
+}
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,566 @@
+/*******************************************************************************
+ * Session.cpp
+ * - A self-contained, headless simulation: owns its OpenCL context, queue
+ *   and solver, and keeps the particle state mapped into host memory between
+ *   steps
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "Session.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * Creates an OpenCL context on the given device and loads the solver
+ *
+ * @param [in] _dataPath Directory containing kernels/
+ * @param [in] platformIndex Index of the OpenCL platform to use
+ * @param [in] deviceIndex Index of the device within the platform
+ */
+Session::Session(const string& _dataPath
+                ,int platformIndex
+                ,int deviceIndex) :
+    context(NULL),
+    device(NULL),
+    queue(NULL),
+    dataPath(_dataPath),
+    particleBuffer(NULL),
+    densityBuffer(NULL),
+    particles(NULL),
+    density(NULL),
+    animate(false),
+    reused(false),
+    resident(false),
+    frameNumber(0)
+{
+    memset(&this->bounds, 0, sizeof(Bounds));
+    memset(&this->originalBounds, 0, sizeof(Bounds));
+
+    if (this->createContext(platformIndex, deviceIndex)) {
+        this->solver = shared_ptr<Solver>(new Solver(this->context, this->device, this->queue, this->dataPath));
+    }
+}
+
+/**
+ * Creates an OpenCL context on the given device and loads the solver
+ *
+ * @param [in] _dataPath Directory containing kernels/
+ * @param [in] _device The device to use
+ */
+Session::Session(const string& _dataPath, cl_device_id _device) :
+    context(NULL),
+    device(NULL),
+    queue(NULL),
+    dataPath(_dataPath),
+    particleBuffer(NULL),
+    densityBuffer(NULL),
+    particles(NULL),
+    density(NULL),
+    animate(false),
+    reused(false),
+    resident(false),
+    frameNumber(0)
+{
+    memset(&this->bounds, 0, sizeof(Bounds));
+    memset(&this->originalBounds, 0, sizeof(Bounds));
+
+    if (this->createContext(_device)) {
+        this->solver = shared_ptr<Solver>(new Solver(this->context, this->device, this->queue, this->dataPath));
+    }
+}
+
+Session::~Session()
+{
+    this->releaseBuffers();
+
+    // The solver's buffers and kernels must go before the context:
+
+    this->solver.reset();
+
+    if (this->queue != NULL) {
+        clReleaseCommandQueue(this->queue);
+    }
+
+    if (this->context != NULL) {
+        clReleaseContext(this->context);
+    }
+}
+
+/**
+ * Creates the context and queue on the device at the given indices
+ */
+bool Session::createContext(int platformIndex, int deviceIndex)
+{
+    cl_uint numPlatforms = 0;
+
+    clGetPlatformIDs(0, NULL, &numPlatforms);
+
+    if (platformIndex < 0 || static_cast<cl_uint>(platformIndex) >= numPlatforms) {
+        cerr << "[pbf] No OpenCL platform " << platformIndex << " (" << numPlatforms << " found)" << endl;
+        return false;
+    }
+
+    vector<cl_platform_id> platforms(numPlatforms);
+    clGetPlatformIDs(numPlatforms, &platforms[0], NULL);
+
+    cl_uint numDevices = 0;
+
+    clGetDeviceIDs(platforms[platformIndex], CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices);
+
+    if (deviceIndex < 0 || static_cast<cl_uint>(deviceIndex) >= numDevices) {
+        cerr << "[pbf] No OpenCL device " << deviceIndex << " on platform " << platformIndex << endl;
+        return false;
+    }
+
+    vector<cl_device_id> devices(numDevices);
+    clGetDeviceIDs(platforms[platformIndex], CL_DEVICE_TYPE_ALL, numDevices, &devices[0], NULL);
+
+    return this->createContext(devices[deviceIndex]);
+}
+
+/**
+ * Creates the context and queue on the given device
+ */
+bool Session::createContext(cl_device_id _device)
+{
+    this->device = _device;
+
+    cl_int err = CL_SUCCESS;
+
+    this->context = clCreateContext(NULL, 1, &this->device, NULL, NULL, &err);
+
+    if (!checkError(err, "clCreateContext")) {
+        this->context = NULL;
+        return false;
+    }
+
+    // Profiling is enabled so that stage timings can be collected on demand
+    // (see Solver::setProfiling); it costs nothing unless events are asked
+    // for:
+
+    this->queue = clCreateCommandQueue(this->context, this->device, CL_QUEUE_PROFILING_ENABLE, &err);
+
+    if (!checkError(err, "clCreateCommandQueue")) {
+        this->queue = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Returns the name of the session's device
+ */
+string Session::getDeviceName() const
+{
+    if (this->device == NULL) {
+        return "";
+    }
+
+    char name[256] = { 0 };
+
+    clGetDeviceInfo(this->device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+
+    return name;
+}
+
+/**
+ * Unmaps and releases the host-mapped buffers
+ */
+void Session::releaseBuffers()
+{
+    this->unmap();
+
+    if (this->particleBuffer != NULL) {
+        clReleaseMemObject(this->particleBuffer);
+        this->particleBuffer = NULL;
+    }
+
+    if (this->densityBuffer != NULL) {
+        clReleaseMemObject(this->densityBuffer);
+        this->densityBuffer = NULL;
+    }
+}
+
+/**
+ * Maps the particle and density buffers for host access
+ */
+void Session::map()
+{
+    int n = this->getNumberOfParticles();
+
+    if (this->particles != NULL || this->particleBuffer == NULL) {
+        return;
+    }
+
+    cl_int err = CL_SUCCESS;
+
+    this->particles = static_cast<Particle*>(clEnqueueMapBuffer(this->queue
+                                                               ,this->particleBuffer
+                                                               ,CL_TRUE
+                                                               ,CL_MAP_READ | CL_MAP_WRITE
+                                                               ,0
+                                                               ,n * sizeof(Particle)
+                                                               ,0
+                                                               ,NULL
+                                                               ,NULL
+                                                               ,&err));
+    checkError(err, "clEnqueueMapBuffer (particles)");
+
+    this->density = static_cast<float*>(clEnqueueMapBuffer(this->queue
+                                                          ,this->densityBuffer
+                                                          ,CL_TRUE
+                                                          ,CL_MAP_READ | CL_MAP_WRITE
+                                                          ,0
+                                                          ,n * sizeof(float)
+                                                          ,0
+                                                          ,NULL
+                                                          ,NULL
+                                                          ,&err));
+    checkError(err, "clEnqueueMapBuffer (density)");
+}
+
+/**
+ * Hands the particle and density buffers back to the device. Edits made
+ * through the mapped pointers become visible to the solver
+ */
+void Session::unmap()
+{
+    if (this->particles != NULL) {
+        clEnqueueUnmapMemObject(this->queue, this->particleBuffer, this->particles, 0, NULL, NULL);
+        this->particles = NULL;
+    }
+
+    if (this->density != NULL) {
+        clEnqueueUnmapMemObject(this->queue, this->densityBuffer, this->density, 0, NULL, NULL);
+        this->density = NULL;
+    }
+}
+
+/******************************************************************************/
+
+/**
+ * Finds the spatial grid subdivisions per axis, as the app does for a given
+ * particle radius
+ *
+ * @param [in] bounds Bounds of the simulation
+ * @param [in] particleRadius Particle radius
+ * @param [in] particlesPerCell Particles per cell along each axis
+ * @param [out] cellsPerAxis The subdivisions
+ */
+void Session::idealCellsPerAxis(const Bounds& bounds
+                               ,float particleRadius
+                               ,int particlesPerCell
+                               ,int cellsPerAxis[3])
+{
+    float subDiv = static_cast<float>(particlesPerCell);
+
+    for (int i = 0; i < 3; i++) {
+        float extent    = bounds.max[i] - bounds.min[i];
+        cellsPerAxis[i] = static_cast<int>(ceil((extent / particleRadius) / subDiv));
+    }
+}
+
+/**
+ * Generates particles at rest at random positions in the bottom quarter of
+ * the bounds
+ *
+ * @param [out] particles The generated particles
+ * @param [in] count Number of particles
+ * @param [in] bounds Bounds of the simulation
+ * @param [in] particleRadius Particle radius; particles keep this far from
+ *             the walls
+ * @param [in] seed Random seed
+ */
+void Session::randomParticles(vector<Particle>& particles
+                             ,int count
+                             ,const Bounds& bounds
+                             ,float particleRadius
+                             ,unsigned int seed)
+{
+    mt19937 random(seed);
+
+    uniform_real_distribution<float> x(bounds.min[0] + particleRadius, bounds.max[0] - particleRadius);
+    uniform_real_distribution<float> y(bounds.min[1] + particleRadius, 0.25f * (bounds.max[1] - particleRadius));
+    uniform_real_distribution<float> z(bounds.min[2] + particleRadius, bounds.max[2] - particleRadius);
+
+    particles.assign(count, Particle());
+
+    for (int i = 0; i < count; i++) {
+
+        Particle& p = particles[i];
+
+        memset(&p, 0, sizeof(Particle));
+
+        p.pos.s[0] = x(random);
+        p.pos.s[1] = y(random);
+        p.pos.s[2] = z(random);
+    }
+}
+
+/**
+ * Sizes the simulation and uploads its initial state
+ *
+ * @param [in] initialState numParticles particles
+ * @param [in] numParticles The number of particles
+ * @param [in] cellsPerAxis Spatial grid subdivisions per axis
+ * @param [in] _bounds Bounds of the simulation
+ * @param [in] parameters Simulation parameters
+ * @param [in] dt Time step
+ */
+bool Session::setup(const Particle* initialState
+                   ,int numParticles
+                   ,const int cellsPerAxis[3]
+                   ,const Bounds& _bounds
+                   ,const Parameters& parameters
+                   ,float dt)
+{
+    if (!this->isLoaded() || numParticles <= 0) {
+        return false;
+    }
+
+    this->bounds         = _bounds;
+    this->originalBounds = _bounds;
+    this->frameNumber    = 0;
+    this->animation.reset();
+
+    // Same size as before? Then the buffers and kernel arguments can stay as
+    // they are; only the state is replaced:
+
+    const int* cells = this->solver->getRequestedCellsPerAxis();
+
+    this->reused = this->particleBuffer != NULL
+                && numParticles == this->getNumberOfParticles()
+                && cells[0] == cellsPerAxis[0]
+                && cells[1] == cellsPerAxis[1]
+                && cells[2] == cellsPerAxis[2];
+
+    if (this->reused) {
+        this->writeParticles(0, numParticles, initialState);
+        this->solver->setParameters(parameters);
+        this->solver->setTimeStep(dt);
+        this->solver->setBounds(this->bounds);
+        return true;
+    }
+
+    this->releaseBuffers();
+
+    cl_int err = CL_SUCCESS;
+
+    this->particleBuffer = clCreateBuffer(this->context
+                                         ,CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR
+                                         ,numParticles * sizeof(Particle)
+                                         ,const_cast<Particle*>(initialState)
+                                         ,&err);
+
+    if (!checkError(err, "clCreateBuffer (particles)")) {
+        this->particleBuffer = NULL;
+        return false;
+    }
+
+    this->densityBuffer = clCreateBuffer(this->context
+                                        ,CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR
+                                        ,numParticles * sizeof(float)
+                                        ,NULL
+                                        ,&err);
+
+    if (!checkError(err, "clCreateBuffer (density)")) {
+        this->densityBuffer = NULL;
+        return false;
+    }
+
+    DeviceBuffers external;
+    external.particles = this->particleBuffer;
+    external.density   = this->densityBuffer;
+
+    if (!this->solver->setup(numParticles, cellsPerAxis, this->bounds, parameters, dt, external)) {
+        return false;
+    }
+
+    if (!this->resident) {
+        this->map();
+    }
+
+    return true;
+}
+
+/**
+ * Steps the simulation; the mapped buffers are handed to the device for the
+ * duration
+ *
+ * @param [in] steps Number of steps to take
+ */
+void Session::step(int steps)
+{
+    if (!this->isLoaded() || this->particleBuffer == NULL) {
+        return;
+    }
+
+    this->unmap();
+
+    for (int i = 0; i < steps; i++) {
+
+        this->solver->setBounds(this->bounds);
+        this->solver->step();
+
+        if (this->animate) {
+            this->animation.step(this->originalBounds, this->bounds, this->solver->getTimeStep());
+        }
+
+        this->frameNumber++;
+    }
+
+    if (!this->resident) {
+        this->map();
+    }
+}
+
+/**
+ * Maps the buffers again when the session stops being resident, or unmaps
+ * them when it starts
+ *
+ * @param [in] value Whether to keep the buffers on the device between steps
+ */
+void Session::setResident(bool value)
+{
+    this->resident = value;
+
+    if (value) {
+        this->unmap();
+    } else {
+        this->map();
+    }
+}
+
+/**
+ * @param [in] first Index of the first particle to read
+ * @param [in] count Number of particles to read
+ * @param [out] particles Where the particles are written
+ */
+bool Session::readParticles(int first, int count, Particle* particles)
+{
+    if (first < 0 || count < 0 || first + count > this->getNumberOfParticles() || this->particleBuffer == NULL) {
+        return false;
+    }
+
+    if (count == 0) {
+        return true;
+    }
+
+    if (this->particles != NULL) {
+        memcpy(particles, this->particles + first, count * sizeof(Particle));
+        return true;
+    }
+
+    return checkError(clEnqueueReadBuffer(this->queue
+                                         ,this->particleBuffer
+                                         ,CL_TRUE
+                                         ,first * sizeof(Particle)
+                                         ,count * sizeof(Particle)
+                                         ,particles
+                                         ,0
+                                         ,NULL
+                                         ,NULL)
+                     ,"clEnqueueReadBuffer (particles)");
+}
+
+/**
+ * @param [in] first Index of the first particle to replace
+ * @param [in] count Number of particles to replace
+ * @param [in] particles The new particles
+ */
+bool Session::writeParticles(int first, int count, const Particle* particles)
+{
+    if (first < 0 || count < 0 || first + count > this->getNumberOfParticles() || this->particleBuffer == NULL) {
+        return false;
+    }
+
+    if (count == 0) {
+        return true;
+    }
+
+    if (this->particles != NULL) {
+        memcpy(this->particles + first, particles, count * sizeof(Particle));
+        return true;
+    }
+
+    return checkError(clEnqueueWriteBuffer(this->queue
+                                          ,this->particleBuffer
+                                          ,CL_TRUE
+                                          ,first * sizeof(Particle)
+                                          ,count * sizeof(Particle)
+                                          ,particles
+                                          ,0
+                                          ,NULL
+                                          ,NULL)
+                     ,"clEnqueueWriteBuffer (particles)");
+}
+
+/**
+ * Summarizes the densities and speeds of the particles
+ */
+SessionStatistics Session::getStatistics() const
+{
+    SessionStatistics stats = { 0.0f, 0.0f, 0.0f, 0.0f };
+    int n                   = this->getNumberOfParticles();
+
+    if (this->particles == NULL || n <= 0) {
+        return stats;
+    }
+
+    double densitySum = 0.0;
+    double speedSum   = 0.0;
+
+    for (int i = 0; i < n; i++) {
+
+        const cl_float* v = this->particles[i].vel.s;
+        float speed       = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+        densitySum      += this->density[i];
+        speedSum        += speed;
+        stats.maxDensity = max(stats.maxDensity, this->density[i]);
+        stats.maxSpeed   = max(stats.maxSpeed, speed);
+    }
+
+    stats.meanDensity = static_cast<float>(densitySum / n);
+    stats.meanSpeed   = static_cast<float>(speedSum / n);
+
+    return stats;
+}
+
+void Session::setBounds(const Bounds& _bounds)
+{
+    this->bounds = _bounds;
+}
+
+/**
+ * Restores the bounds the simulation was set up with
+ */
+void Session::resetBounds()
+{
+    this->animation.reset();
+    this->bounds = this->originalBounds;
+}
+
+void Session::setParameters(const Parameters& parameters)
+{
+    this->solver->setParameters(parameters);
+}
+
+}
+
+/******************************************************************************/
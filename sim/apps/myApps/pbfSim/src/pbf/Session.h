@@ -0,0 +1,202 @@
+/*******************************************************************************
+ * Session.h
+ * - A self-contained, headless simulation: owns its OpenCL context, queue
+ *   and solver, and keeps the particle state mapped into host memory between
+ *   steps so it can be inspected and edited in place (e.g. from Python, see
+ *   CInterface.h)
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_SESSION_H
+#define PBF_LIB_SESSION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Solver.h"
+#include "BoundsAnimation.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+// Summary of the particle state, e.g. to compare runs
+
+typedef struct {
+
+    float meanDensity;
+    float maxDensity;
+
+    float meanSpeed;
+    float maxSpeed;
+
+} SessionStatistics;
+
+/**
+ * Between steps, the particle and density buffers are mapped: getParticles()
+ * and getDensity() point at host memory the device buffers are backed by
+ * (CL_MEM_ALLOC_HOST_PTR), so reading or editing them involves no explicit
+ * transfers. step() unmaps both buffers while the solver runs and maps them
+ * again afterwards; pointers obtained before a step must not be used after it
+ *
+ * A resident session (see setResident()) leaves the buffers on the device
+ * instead, and only the ranges passed to readParticles() and writeParticles()
+ * are transferred
+ */
+class Session
+{
+    private:
+        cl_context context;
+
+        cl_device_id device;
+
+        cl_command_queue queue;
+
+        std::string dataPath;
+
+        std::shared_ptr<Solver> solver;
+
+        // Host-mapped buffers, handed to the solver as external buffers
+        cl_mem particleBuffer;
+        cl_mem densityBuffer;
+
+        Particle* particles;
+
+        float* density;
+
+        Bounds bounds;
+
+        Bounds originalBounds;
+
+        BoundsAnimation animation;
+
+        bool animate;
+
+        bool reused;
+
+        // If set, the buffers stay unmapped between steps (see setResident())
+        bool resident;
+
+        unsigned int frameNumber;
+
+        // Non-copyable
+        Session(const Session&);
+        Session& operator=(const Session&);
+
+        bool createContext(int platformIndex, int deviceIndex);
+        bool createContext(cl_device_id device);
+
+        void releaseBuffers();
+
+        void map();
+
+        void unmap();
+
+    public:
+        Session(const std::string& dataPath
+               ,int platformIndex = 0
+               ,int deviceIndex = 0);
+
+        // Creates the session on a device found elsewhere, e.g. a sub-device
+        // (see CoExecution). The device must outlive the session
+        Session(const std::string& dataPath, cl_device_id device);
+
+        virtual ~Session();
+
+        bool isLoaded() const { return this->solver && this->solver->isLoaded(); }
+
+        Solver& getSolver() { return *this->solver; }
+
+        cl_device_id getDevice() const { return this->device; }
+
+        std::string getDeviceName() const;
+
+        /**
+         * Finds the spatial grid subdivisions per axis that hold about
+         * particlesPerCell particles of the given radius per cell and axis
+         */
+        static void idealCellsPerAxis(const Bounds& bounds
+                                     ,float particleRadius
+                                     ,int particlesPerCell
+                                     ,int cellsPerAxis[3]);
+
+        /**
+         * Particles at rest, placed at random in the bottom quarter of the
+         * bounds, as the app does by default
+         */
+        static void randomParticles(std::vector<Particle>& particles
+                                   ,int count
+                                   ,const Bounds& bounds
+                                   ,float particleRadius
+                                   ,unsigned int seed);
+
+        /**
+         * Sizes the simulation and uploads its initial state. Can be called
+         * again to start over; if the particle count and grid are unchanged,
+         * the existing buffers are reused and only the state is uploaded
+         */
+        bool setup(const Particle* initialState
+                  ,int numParticles
+                  ,const int cellsPerAxis[3]
+                  ,const Bounds& bounds
+                  ,const Parameters& parameters
+                  ,float dt);
+
+        // Takes the given number of steps; blocks until they are done
+        void step(int steps = 1);
+
+        int getNumberOfParticles() const { return this->solver ? this->solver->getNumberOfParticles() : 0; }
+
+        unsigned int getFrameNumber() const { return this->frameNumber; }
+
+        // Mapped particle state; valid until the next step(). NULL while
+        // the session is resident
+        Particle* getParticles() { return this->particles; }
+        float* getDensity()      { return this->density; }
+
+        /**
+         * Keeps the buffers unmapped between steps, so a step doesn't move
+         * the whole state between the device and the host; the state is
+         * then only reached through readParticles() and writeParticles()
+         */
+        void setResident(bool value);
+        bool isResident() const { return this->resident; }
+
+        /**
+         * Copies count particles, starting at first, from or to the state.
+         * Blocks until the copy is done
+         */
+        bool readParticles(int first, int count, Particle* particles);
+        bool writeParticles(int first, int count, const Particle* particles);
+
+        // Computed from the mapped state
+        SessionStatistics getStatistics() const;
+
+        const Bounds& getBounds() const { return this->bounds; }
+        void setBounds(const Bounds& bounds);
+        void resetBounds();
+
+        const Parameters& getParameters() const { return this->solver->getParameters(); }
+        void setParameters(const Parameters& parameters);
+
+        float getTimeStep() const { return this->solver->getTimeStep(); }
+        void setTimeStep(float dt) { this->solver->setTimeStep(dt); }
+
+        void setSolverIterations(int iterations) { this->solver->setSolverIterations(iterations); }
+
+        // True if the last setup() reused the previous setup's buffers
+        bool reusedBuffers() const { return this->reused; }
+
+        BoundsAnimation& getAnimation() { return this->animation; }
+
+        bool isAnimating() const      { return this->animate; }
+        void setAnimating(bool value) { this->animate = value; }
+};
+
+}
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,188 @@
+/*******************************************************************************
+ * SessionLog.cpp
+ * - A timestamped log of the inputs and events of an interactive session
+ *   (keys, GUI changes, camera moves), written while recording and read
+ *   back to replay the session frame by frame
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "SessionLog.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+SessionLog::SessionLog() :
+    cursor(0)
+{
+
+}
+
+SessionLog::~SessionLog()
+{
+    this->stopRecording();
+}
+
+/******************************************************************************/
+
+/**
+ * Creates the log file and writes its header
+ *
+ * @param [in] filename Path of the log
+ */
+bool SessionLog::startRecording(const string& filename)
+{
+    this->stopRecording();
+
+    this->out.open(filename.c_str());
+
+    if (!this->out) {
+        cerr << "[pbf] Couldn't create session log " << filename << endl;
+        return false;
+    }
+
+    this->out << "# pbf session log, version " << SessionLog::VERSION << endl
+              << "# <frame> <seconds> <event> [values...]" << endl;
+
+    return true;
+}
+
+void SessionLog::stopRecording()
+{
+    if (this->out.is_open()) {
+        this->out.close();
+    }
+}
+
+/**
+ * Appends an event. Every event is flushed, so a session that ends in a
+ * crash can still be replayed up to it
+ *
+ * @param [in] frame Updates since recording started
+ * @param [in] time Seconds since recording started
+ * @param [in] name Event name; must not contain whitespace
+ * @param [in] values Event arguments
+ */
+void SessionLog::record(unsigned int frame
+                       ,double time
+                       ,const string& name
+                       ,const vector<float>& values)
+{
+    if (!this->isRecording()) {
+        return;
+    }
+
+    this->out << frame << ' ' << fixed << setprecision(4) << time << ' ' << name;
+
+    // Floats round-trip with 9 significant digits:
+
+    this->out.unsetf(ios::floatfield);
+    this->out << setprecision(9);
+
+    for (size_t i = 0; i < values.size(); i++) {
+        this->out << ' ' << values[i];
+    }
+
+    this->out << endl;
+}
+
+void SessionLog::record(unsigned int frame, double time, const string& name, float value)
+{
+    this->record(frame, time, name, vector<float>(1, value));
+}
+
+/******************************************************************************/
+
+/**
+ * Reads a recorded log for replay
+ *
+ * @param [in] filename Path of the log
+ */
+bool SessionLog::load(const string& filename)
+{
+    ifstream in(filename.c_str());
+
+    if (!in) {
+        cerr << "[pbf] Couldn't open session log " << filename << endl;
+        return false;
+    }
+
+    this->events.clear();
+    this->cursor = 0;
+
+    string line;
+    int lineNumber = 0;
+
+    while (getline(in, line)) {
+
+        lineNumber++;
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        istringstream fields(line);
+        SessionEvent event;
+
+        if (!(fields >> event.frame >> event.time >> event.name)) {
+            cerr << "[pbf] " << filename << ":" << lineNumber << ": malformed event" << endl;
+            return false;
+        }
+
+        float value = 0.0f;
+
+        while (fields >> value) {
+            event.values.push_back(value);
+        }
+
+        this->events.push_back(event);
+    }
+
+    return true;
+}
+
+const SessionEvent* SessionLog::findEvent(const string& name) const
+{
+    for (size_t i = 0; i < this->events.size(); i++) {
+        if (this->events[i].name == name) {
+            return &this->events[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns the next due event
+ *
+ * @param [in] frame The frame about to be updated
+ * @param [out] event The event
+ */
+bool SessionLog::nextEvent(unsigned int frame, SessionEvent& event)
+{
+    if (this->isFinished() || this->events[this->cursor].frame > frame) {
+        return false;
+    }
+
+    event = this->events[this->cursor++];
+
+    return true;
+}
+
+unsigned int SessionLog::getLastFrame() const
+{
+    return this->events.empty() ? 0 : this->events.back().frame;
+}
+
+}
+
+/******************************************************************************/
@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * SessionLog.h
+ * - A timestamped log of the inputs and events of an interactive session
+ *   (keys, GUI changes, camera moves), written while recording and read
+ *   back to replay the session frame by frame
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_SESSION_LOG_H
+#define PBF_LIB_SESSION_LOG_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * One line of the log:
+ *
+ *   <frame> <seconds> <name> [values...]
+ *
+ * frame counts the application's updates since recording started; an event
+ * with frame f is applied before the f-th update steps the simulation.
+ * seconds is the wall time since recording started, for reference only
+ */
+typedef struct {
+
+    unsigned int frame;
+
+    double time;
+
+    std::string name;
+
+    std::vector<float> values;
+
+} SessionEvent;
+
+class SessionLog
+{
+    private:
+        std::ofstream out;
+
+        std::vector<SessionEvent> events;
+
+        // Next event to replay
+        size_t cursor;
+
+        // Non-copyable
+        SessionLog(const SessionLog&);
+        SessionLog& operator=(const SessionLog&);
+
+    public:
+        static const int VERSION = 1;
+
+        SessionLog();
+
+        virtual ~SessionLog();
+
+        // Recording:
+
+        bool startRecording(const std::string& filename);
+
+        void stopRecording();
+
+        bool isRecording() const { return this->out.is_open(); }
+
+        void record(unsigned int frame
+                   ,double time
+                   ,const std::string& name
+                   ,const std::vector<float>& values = std::vector<float>());
+
+        void record(unsigned int frame, double time, const std::string& name, float value);
+
+        // Replay:
+
+        bool load(const std::string& filename);
+
+        const std::vector<SessionEvent>& getEvents() const { return this->events; }
+
+        // First event with the given name, if any (e.g. "scene")
+        const SessionEvent* findEvent(const std::string& name) const;
+
+        /**
+         * Returns the next event due at or before the given frame, in the
+         * order recorded. Returns false once no more events are due
+         */
+        bool nextEvent(unsigned int frame, SessionEvent& event);
+
+        bool isFinished() const { return this->cursor >= this->events.size(); }
+
+        // Frame of the last event (the "end" event of a complete recording)
+        unsigned int getLastFrame() const;
+
+        void rewind() { this->cursor = 0; }
+};
+
+}
+
+/******************************************************************************/
+
+#endif
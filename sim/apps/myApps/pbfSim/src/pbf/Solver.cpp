@@ -0,0 +1,1039 @@
+/*******************************************************************************
+ * Solver.cpp
+ * - The position-based fluids solver core: device buffers, kernels and
+ *   stepping, with no openFrameworks or OpenGL dependency
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "Solver.h"
+#include "KernelSources.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+DeviceBuffers::DeviceBuffers() :
+    parameters(NULL),
+    particles(NULL),
+    particleToCell(NULL),
+    sortedParticleToCell(NULL),
+    cellHistogram(NULL),
+    cellPrefixSums(NULL),
+    gridCellOffsets(NULL),
+    density(NULL),
+    lambda(NULL),
+    curl(NULL),
+    extForces(NULL),
+    posDelta(NULL),
+    renderPos(NULL)
+{
+
+}
+
+/******************************************************************************/
+
+const char* const Solver::KERNEL_NAMES[Solver::NUM_KERNELS] = {
+    "resetParticleQuantities",
+    "resetCellQuantities",
+    "predictPosition",
+    "discretizeParticlePositions",
+    "countSortParticlesByCell",
+    "findParticleBins",
+    "estimateDensity",
+    "computeLambda",
+    "computePositionDelta",
+    "updatePositionDelta",
+    "computeCurl",
+    "updatePosition"
+};
+
+/**
+ * Creates a solver and builds its kernels
+ *
+ * @param [in] _context OpenCL context all buffers belong to
+ * @param [in] _device Device the kernels are built for
+ * @param [in] _queue Queue all work is enqueued on
+ * @param [in] _dataPath Directory containing kernels/Simulation.cl,
+ *             kernels/Scan.cl and kernels/Forces.cl
+ */
+Solver::Solver(cl_context _context
+              ,cl_device_id _device
+              ,cl_command_queue _queue
+              ,const string& _dataPath) :
+    context(_context),
+    device(_device),
+    queue(_queue),
+    dataPath(_dataPath),
+    program(_context, _device),
+    listener(NULL),
+    numParticles(0),
+    numCells(0),
+    dt(0.025f),
+    solverIterations(3),
+    stencil(STENCIL_FULL),
+    stencilInProgram(false),
+    pairwise(false),
+    profiling(false)
+{
+    this->cellsPerAxis[0] = this->cellsPerAxis[1] = this->cellsPerAxis[2] = 0;
+    this->requestedCellsPerAxis[0] = this->requestedCellsPerAxis[1] = this->requestedCellsPerAxis[2] = 0;
+
+    memset(&this->bounds, 0, sizeof(Bounds));
+    memset(&this->binnedBounds, 0, sizeof(Bounds));
+
+    // Build all three programs at once, unless the application already
+    // started them; PrefixSum and ForceFields take theirs over below:
+
+    Solver::prebuild(_context, _device, _dataPath);
+
+    this->loadProgram();
+
+    this->prefixSum   = shared_ptr<PrefixSum>(new PrefixSum(_context, _device, _queue, _dataPath));
+    this->forceFields = shared_ptr<ForceFields>(new ForceFields(_context, _device, _queue, _dataPath));
+}
+
+Solver::~Solver()
+{
+    this->setProfiling(false);
+    this->releaseOwnedBuffers();
+}
+
+/******************************************************************************/
+
+/**
+ * Starts building the programs every solver needs
+ *
+ * @param [in] context OpenCL context the solver will be created with
+ * @param [in] device Device it will be created for
+ * @param [in] dataPath Data folder it will be created with
+ */
+void Solver::prebuild(cl_context context
+                     ,cl_device_id device
+                     ,const string& dataPath)
+{
+    prebuildProgram(context, device, "kernels/Simulation.cl", dataPath);
+    prebuildProgram(context, device, "kernels/Scan.cl", dataPath);
+    prebuildProgram(context, device, "kernels/Forces.cl", dataPath);
+}
+
+/******************************************************************************/
+
+/**
+ * Builds kernels/Simulation.cl for the selected neighbor stencil and
+ * resolves its kernels
+ */
+bool Solver::loadProgram()
+{
+    string options = this->stencil == STENCIL_HALF_CELL ? "-D PBF_HALF_CELL_STENCIL" : "";
+
+    bool loaded = this->program.loadKernelFile("kernels/Simulation.cl", this->dataPath, options);
+
+    // The define only matters if the program's neighbor loops use the
+    // stencil helpers, which such a program declares with
+    // NEIGHBOR_STENCIL_PROGRAM (see kernels/Common.cl):
+
+    this->stencilInProgram = loaded && this->program.hasKernel("usesNeighborStencil");
+
+    for (int i = 0; i < NUM_KERNELS; i++) {
+        this->kernels[i] = loaded ? this->program.kernel(KERNEL_NAMES[i]) : NULL;
+    }
+
+    return loaded;
+}
+
+/**
+ * Returns external if it's given, otherwise allocates a buffer of the given
+ * size, remembering it in owned
+ */
+cl_mem Solver::useOrCreate(cl_mem external, cl_mem& owned, size_t size)
+{
+    if (external != NULL) {
+        return external;
+    }
+
+    cl_int err = CL_SUCCESS;
+
+    owned = clCreateBuffer(this->context, CL_MEM_READ_WRITE, size, NULL, &err);
+
+    checkError(err, "clCreateBuffer");
+
+    return owned;
+}
+
+/**
+ * Releases all buffers the solver allocated itself
+ */
+void Solver::releaseOwnedBuffers()
+{
+    cl_mem* handles = &this->owned.parameters;
+    int count       = static_cast<int>(sizeof(DeviceBuffers) / sizeof(cl_mem));
+
+    for (int i = 0; i < count; i++) {
+        if (handles[i] != NULL) {
+            clReleaseMemObject(handles[i]);
+            handles[i] = NULL;
+        }
+    }
+}
+
+/**
+ * Sizes the solver, allocates any buffers not given in external and binds
+ * the kernel arguments
+ *
+ * @param [in] _numParticles The number of particles
+ * @param [in] _cellsPerAxis Spatial grid subdivisions per axis
+ * @param [in] _bounds Initial bounds of the simulation
+ * @param [in] _parameters Simulation parameters
+ * @param [in] _dt Time step
+ * @param [in] external Externally owned buffers to use, if any
+ */
+bool Solver::setup(int _numParticles
+                  ,const int _cellsPerAxis[3]
+                  ,const Bounds& _bounds
+                  ,const Parameters& _parameters
+                  ,float _dt
+                  ,const DeviceBuffers& external)
+{
+    if (!this->isLoaded()) {
+        return false;
+    }
+
+    this->releaseOwnedBuffers();
+
+    this->numParticles = _numParticles;
+    this->bounds       = _bounds;
+    this->parameters   = _parameters;
+    this->dt           = _dt;
+
+    for (int i = 0; i < 3; i++) {
+        this->requestedCellsPerAxis[i] = _cellsPerAxis[i];
+    }
+
+    // The cell buffers are sized for the requested grid, which is never
+    // smaller than the one sizeGrid() picks for any stencil:
+
+    size_t n = static_cast<size_t>(this->numParticles);
+    size_t c = static_cast<size_t>(this->requestedCellsPerAxis[0])
+             * static_cast<size_t>(this->requestedCellsPerAxis[1])
+             * static_cast<size_t>(this->requestedCellsPerAxis[2]);
+
+    this->sizeGrid();
+
+    DeviceBuffers& b = this->buffers;
+    DeviceBuffers& o = this->owned;
+
+    b.parameters           = this->useOrCreate(external.parameters, o.parameters, sizeof(Parameters));
+    b.particles            = this->useOrCreate(external.particles, o.particles, n * sizeof(Particle));
+    b.particleToCell       = this->useOrCreate(external.particleToCell, o.particleToCell, n * sizeof(ParticlePosition));
+    b.sortedParticleToCell = this->useOrCreate(external.sortedParticleToCell, o.sortedParticleToCell, n * sizeof(ParticlePosition));
+    b.cellHistogram        = this->useOrCreate(external.cellHistogram, o.cellHistogram, c * sizeof(cl_int));
+    b.cellPrefixSums       = this->useOrCreate(external.cellPrefixSums, o.cellPrefixSums, c * sizeof(cl_int));
+    b.gridCellOffsets      = this->useOrCreate(external.gridCellOffsets, o.gridCellOffsets, c * sizeof(GridCellOffset));
+    b.density              = this->useOrCreate(external.density, o.density, n * sizeof(cl_float));
+    b.lambda               = this->useOrCreate(external.lambda, o.lambda, n * sizeof(cl_float));
+    b.curl                 = this->useOrCreate(external.curl, o.curl, n * sizeof(cl_float4));
+    b.extForces            = this->useOrCreate(external.extForces, o.extForces, n * sizeof(cl_float4));
+    b.posDelta             = this->useOrCreate(external.posDelta, o.posDelta, n * sizeof(cl_float4));
+    b.renderPos            = this->useOrCreate(external.renderPos, o.renderPos, n * sizeof(cl_float4));
+
+    this->setParameters(this->parameters);
+    this->bindKernels();
+
+    return true;
+}
+
+/**
+ * Picks the grid the particles are binned into. The full stencil uses the
+ * requested grid. The half-cell stencil only gets down to one or two cells
+ * per axis if a particle's h-ball fits in two cells, so while it is
+ * selected, cells are merged until they are at least 2h wide (in the bounds
+ * the solver was set up with; bounds compressed below that fall back to
+ * wider blocks per particle, see neighborStencilOrigin())
+ */
+void Solver::sizeGrid()
+{
+    float h = this->parameters.smoothingRadius;
+
+    for (int i = 0; i < 3; i++) {
+
+        int cells = this->requestedCellsPerAxis[i];
+
+        if (this->stencil == STENCIL_HALF_CELL && h > 0.0f) {
+            float extent = this->bounds.max[i] - this->bounds.min[i];
+            cells        = min(cells, max(1, static_cast<int>(floor(extent / (2.0f * h)))));
+        }
+
+        this->cellsPerAxis[i] = cells;
+    }
+
+    this->numCells = this->cellsPerAxis[0] * this->cellsPerAxis[1] * this->cellsPerAxis[2];
+}
+
+/**
+ * Binds the arguments of all kernels in kernels/Simulation.cl that don't
+ * change from step to step
+ */
+void Solver::bindKernels()
+{
+    DeviceBuffers& b = this->buffers;
+    cl_kernel k      = NULL;
+
+    int cellsX = this->cellsPerAxis[0];
+    int cellsY = this->cellsPerAxis[1];
+    int cellsZ = this->cellsPerAxis[2];
+
+    // KERNEL :: resetParticleQuantities
+
+    k = this->kernels[RESET_PARTICLE_QUANTITIES];
+    setArg(k, 0, b.particles);
+    setArg(k, 1, b.particleToCell);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.density);
+    setArg(k, 4, b.lambda);
+    setArg(k, 5, b.posDelta);
+
+    // KERNEL :: resetCellQuantities
+
+    k = this->kernels[RESET_CELL_QUANTITIES];
+    setArg(k, 0, b.cellHistogram);
+    setArg(k, 1, b.cellPrefixSums);
+    setArg(k, 2, b.gridCellOffsets);
+
+    // KERNEL :: predictPosition
+
+    k = this->kernels[PREDICT_POSITION];
+    setArg(k, 0, b.particles);
+    setArg(k, 1, b.extForces);
+    setArg(k, 2, this->dt);
+
+    // KERNEL :: discretizeParticlePositions
+
+    k = this->kernels[DISCRETIZE_PARTICLE_POSITIONS];
+    setArg(k, 0, b.particles);
+    setArg(k, 1, b.particleToCell);
+    setArg(k, 2, b.cellHistogram);
+    setArg(k, 3, cellsX);
+    setArg(k, 4, cellsY);
+    setArg(k, 5, cellsZ);
+
+    // KERNEL :: countSortParticlesByCell
+
+    k = this->kernels[COUNT_SORT_PARTICLES_BY_CELL];
+    setArg(k, 0, b.particleToCell);
+    setArg(k, 1, b.sortedParticleToCell);
+    setArg(k, 2, b.cellPrefixSums);
+    setArg(k, 3, this->numParticles);
+
+    // KERNEL :: findParticleBins
+
+    k = this->kernels[FIND_PARTICLE_BINS];
+    setArg(k, 0, b.sortedParticleToCell);
+    setArg(k, 1, b.gridCellOffsets);
+    setArg(k, 2, this->numParticles);
+
+    // KERNEL :: estimateDensity
+
+    k = this->kernels[ESTIMATE_DENSITY];
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.particles);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.gridCellOffsets);
+    setArg(k, 4, this->numParticles);
+    setArg(k, 5, cellsX);
+    setArg(k, 6, cellsY);
+    setArg(k, 7, cellsZ);
+    setArg(k, 10, b.density);
+
+    this->forceFields->bind(b, this->numParticles);
+
+    if (this->spatialQueries) {
+        this->spatialQueries->bind(b, this->cellsPerAxis);
+    }
+
+    if (this->pairwiseDensity) {
+        this->pairwiseDensity->bind(b, this->numParticles, this->cellsPerAxis);
+    }
+
+    // KERNEL :: computeLambda
+
+    k = this->kernels[COMPUTE_LAMBDA];
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.particles);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.gridCellOffsets);
+    setArg(k, 4, b.density);
+    setArg(k, 5, this->numParticles);
+    setArg(k, 6, cellsX);
+    setArg(k, 7, cellsY);
+    setArg(k, 8, cellsZ);
+    setArg(k, 11, b.lambda);
+
+    // KERNEL :: computePositionDelta
+
+    k = this->kernels[COMPUTE_POSITION_DELTA];
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.particles);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.gridCellOffsets);
+    setArg(k, 4, this->numParticles);
+    setArg(k, 5, b.lambda);
+    setArg(k, 6, cellsX);
+    setArg(k, 7, cellsY);
+    setArg(k, 8, cellsZ);
+    setArg(k, 11, b.posDelta);
+
+    // KERNEL :: updatePositionDelta
+
+    k = this->kernels[UPDATE_POSITION_DELTA];
+    setArg(k, 0, b.posDelta);
+    setArg(k, 1, b.particles);
+
+    // KERNEL :: computeCurl
+
+    k = this->kernels[COMPUTE_CURL];
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.particles);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.gridCellOffsets);
+    setArg(k, 4, this->numParticles);
+    setArg(k, 5, cellsX);
+    setArg(k, 6, cellsY);
+    setArg(k, 7, cellsZ);
+    setArg(k, 10, b.curl);
+
+    // KERNEL :: updatePosition
+
+    k = this->kernels[UPDATE_POSITION];
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, this->dt);
+    setArg(k, 2, b.particles);
+    setArg(k, 3, b.sortedParticleToCell);
+    setArg(k, 4, b.gridCellOffsets);
+    setArg(k, 5, this->numParticles);
+    setArg(k, 6, b.curl);
+    setArg(k, 7, cellsX);
+    setArg(k, 8, cellsY);
+    setArg(k, 9, cellsZ);
+    setArg(k, 12, b.renderPos);
+
+    this->setBounds(this->bounds);
+}
+
+/**
+ * Binds the bounds' extents to the given arguments of a kernel
+ */
+void Solver::bindBounds(cl_kernel kernel, int minIndex, int maxIndex)
+{
+    cl_float4 minExt = {{ this->bounds.min[0], this->bounds.min[1], this->bounds.min[2], 0.0f }};
+    cl_float4 maxExt = {{ this->bounds.max[0], this->bounds.max[1], this->bounds.max[2], 0.0f }};
+
+    setArg(kernel, minIndex, minExt);
+    setArg(kernel, maxIndex, maxExt);
+}
+
+/**
+ * Sets the bounds the particles are binned and constrained to from the next
+ * step on
+ *
+ * @param [in] _bounds The new bounds
+ */
+void Solver::setBounds(const Bounds& _bounds)
+{
+    this->bounds = _bounds;
+
+    if (!this->isLoaded()) {
+        return;
+    }
+
+    this->bindBounds(this->kernels[DISCRETIZE_PARTICLE_POSITIONS], 6, 7);
+    this->bindBounds(this->kernels[ESTIMATE_DENSITY], 8, 9);
+    this->bindBounds(this->kernels[COMPUTE_LAMBDA], 9, 10);
+    this->bindBounds(this->kernels[COMPUTE_POSITION_DELTA], 9, 10);
+    this->bindBounds(this->kernels[COMPUTE_CURL], 8, 9);
+    this->bindBounds(this->kernels[UPDATE_POSITION], 10, 11);
+}
+
+/**
+ * Rebuilds the kernels for the given stencil, resizes the grid for it and
+ * binds the kernels again, if the solver has been set up
+ *
+ * @param [in] _stencil The neighbor stencil
+ */
+bool Solver::setNeighborStencil(NeighborStencil _stencil)
+{
+    if (_stencil == this->stencil) {
+        return this->isLoaded();
+    }
+
+    // The kernels are about to be released:
+
+    clFinish(this->queue);
+
+    this->stencil = _stencil;
+
+    if (!this->loadProgram()) {
+        return false;
+    }
+
+    if (this->numParticles > 0) {
+        this->sizeGrid();
+        this->bindKernels();
+    }
+
+    return true;
+}
+
+/**
+ * Switches between the gather-based and the pairwise density estimate,
+ * building kernels/Pairwise.cl the first time the latter is selected
+ *
+ * @param [in] enabled Whether to use the pairwise density estimate
+ */
+bool Solver::setPairwiseDensity(bool enabled)
+{
+    if (enabled && !this->pairwiseDensity) {
+
+        this->pairwiseDensity = shared_ptr<PairwiseDensity>(new PairwiseDensity(this->context, this->device, this->queue, this->dataPath));
+
+        if (this->numParticles > 0) {
+            this->pairwiseDensity->bind(this->buffers, this->numParticles, this->cellsPerAxis);
+        }
+    }
+
+    if (enabled && !this->pairwiseDensity->isLoaded()) {
+        cerr << "[pbf] Pairwise density kernels unavailable; keeping estimateDensity" << endl;
+        this->pairwise = false;
+        return false;
+    }
+
+    this->pairwise = enabled;
+
+    return true;
+}
+
+/**
+ * Sets the simulation parameters, writing them to the device
+ *
+ * @param [in] _parameters The new parameters
+ */
+void Solver::setParameters(const Parameters& _parameters)
+{
+    this->parameters = _parameters;
+
+    if (this->buffers.parameters != NULL) {
+        checkError(clEnqueueWriteBuffer(this->queue
+                                       ,this->buffers.parameters
+                                       ,CL_TRUE
+                                       ,0
+                                       ,sizeof(Parameters)
+                                       ,&this->parameters
+                                       ,0
+                                       ,NULL
+                                       ,NULL)
+                  ,"clEnqueueWriteBuffer (parameters)");
+    }
+}
+
+/**
+ * Sets the time step used from the next step on
+ *
+ * @param [in] _dt The new time step
+ */
+void Solver::setTimeStep(float _dt)
+{
+    this->dt = _dt;
+
+    if (this->isLoaded()) {
+        setArg(this->kernels[PREDICT_POSITION], 2, this->dt);
+        setArg(this->kernels[UPDATE_POSITION], 1, this->dt);
+    }
+}
+
+/**
+ * Uploads the state of all particles
+ *
+ * @param [in] particles numParticles particles
+ */
+void Solver::writeParticles(const Particle* particles)
+{
+    checkError(clEnqueueWriteBuffer(this->queue
+                                   ,this->buffers.particles
+                                   ,CL_TRUE
+                                   ,0
+                                   ,this->numParticles * sizeof(Particle)
+                                   ,particles
+                                   ,0
+                                   ,NULL
+                                   ,NULL)
+              ,"clEnqueueWriteBuffer (particles)");
+}
+
+/**
+ * Downloads the state of all particles
+ *
+ * @param [out] particles Room for numParticles particles
+ */
+void Solver::readParticles(Particle* particles)
+{
+    checkError(clEnqueueReadBuffer(this->queue
+                                  ,this->buffers.particles
+                                  ,CL_TRUE
+                                  ,0
+                                  ,this->numParticles * sizeof(Particle)
+                                  ,particles
+                                  ,0
+                                  ,NULL
+                                  ,NULL)
+              ,"clEnqueueReadBuffer (particles)");
+}
+
+/******************************************************************************/
+
+void Solver::run(Kernel kernel, size_t globalSize)
+{
+    if (!this->profiling) {
+        run1D(this->queue, this->kernels[kernel], globalSize);
+        return;
+    }
+
+    cl_event event = NULL;
+
+    run1D(this->queue, this->kernels[kernel], globalSize, 0, &event);
+
+    if (event != NULL) {
+        this->stageEvents.push_back(make_pair(KERNEL_NAMES[kernel], event));
+    }
+}
+
+/**
+ * Enqueues the density estimate of one solver iteration, with the selected
+ * method
+ */
+void Solver::estimateDensity(size_t n)
+{
+    if (!this->pairwise) {
+        this->run(ESTIMATE_DENSITY, n);
+        return;
+    }
+
+    if (!this->profiling) {
+        this->pairwiseDensity->evaluate();
+        return;
+    }
+
+    this->pairwiseDensity->setEventList(&this->helperEvents);
+    this->pairwiseDensity->evaluate();
+    this->pairwiseDensity->setEventList(NULL);
+    this->tagHelperEvents("pairwiseDensity");
+}
+
+/**
+ * Moves the events collected from a helper's kernel runs to the stage
+ * events, tagged with the given stage
+ */
+void Solver::tagHelperEvents(const char* stage)
+{
+    for (size_t i = 0; i < this->helperEvents.size(); i++) {
+        this->stageEvents.push_back(make_pair(stage, this->helperEvents[i]));
+    }
+
+    this->helperEvents.clear();
+}
+
+/**
+ * Enqueues one step of the simulation. This follows "Algorithm 1 Simulation
+ * Loop" of "Position Based Fluids", with neighbors found by counting sort
+ * rather than the method of [Green 2008]
+ */
+void Solver::step()
+{
+    if (!this->isLoaded() || this->numParticles <= 0) {
+        return;
+    }
+
+    size_t n = static_cast<size_t>(this->numParticles);
+
+    this->binnedBounds = this->bounds;
+
+    // Reset per-step quantities:
+
+    this->run(RESET_PARTICLE_QUANTITIES, n);
+    this->run(RESET_CELL_QUANTITIES, static_cast<size_t>(this->numCells));
+
+    if (this->listener != NULL) {
+        this->listener->beginStep(this->dt);
+    }
+
+    // (1) - (4): predict positions, evaluating the force fields as they're
+    // integrated. predictPosition, which integrates the external force
+    // buffer instead, is only left for when kernels/Forces.cl didn't build
+
+    if (!this->forceFields->isLoaded()) {
+        this->run(PREDICT_POSITION, n);
+    } else if (this->profiling) {
+        this->forceFields->setEventList(&this->helperEvents);
+        this->forceFields->predict(this->dt);
+        this->forceFields->setEventList(NULL);
+        this->tagHelperEvents("predictPosition");
+    } else {
+        this->forceFields->predict(this->dt);
+    }
+
+    // (5) - (7): bin the particles into grid cells and sort them by cell
+
+    this->run(DISCRETIZE_PARTICLE_POSITIONS, n);
+
+    if (this->profiling) {
+        this->prefixSum->setEventList(&this->helperEvents);
+        this->prefixSum->scan(this->buffers.cellPrefixSums, this->buffers.cellHistogram, this->numCells);
+        this->prefixSum->setEventList(NULL);
+        this->tagHelperEvents("scan");
+    } else {
+        this->prefixSum->scan(this->buffers.cellPrefixSums, this->buffers.cellHistogram, this->numCells);
+    }
+
+    this->run(COUNT_SORT_PARTICLES_BY_CELL, n);
+    this->run(FIND_PARTICLE_BINS, n);
+
+    // (8) - (19): constraint solver
+
+    for (int i = 0; i < this->solverIterations; i++) {
+
+        this->estimateDensity(n);
+        this->run(COMPUTE_LAMBDA, n);
+        this->run(COMPUTE_POSITION_DELTA, n);
+        this->run(UPDATE_POSITION_DELTA, n);
+
+        if (this->listener != NULL) {
+            this->listener->solverIteration(i);
+        }
+    }
+
+    // (20) - (24): vorticity confinement, viscosity and the final positions
+
+    this->run(COMPUTE_CURL, n);
+    this->run(UPDATE_POSITION, n);
+}
+
+void Solver::finish()
+{
+    clFinish(this->queue);
+}
+
+/**
+ * Enables or disables per-stage profiling. Disabling it drops any events
+ * that haven't been collected
+ *
+ * @param [in] enabled Whether to profile subsequent steps
+ */
+void Solver::setProfiling(bool enabled)
+{
+    if (enabled) {
+
+        cl_command_queue_properties properties = 0;
+
+        clGetCommandQueueInfo(this->queue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, NULL);
+
+        if ((properties & CL_QUEUE_PROFILING_ENABLE) == 0) {
+            cerr << "[pbf] Profiling requires a queue created with CL_QUEUE_PROFILING_ENABLE" << endl;
+            return;
+        }
+
+    } else {
+
+        for (size_t i = 0; i < this->stageEvents.size(); i++) {
+            clReleaseEvent(this->stageEvents[i].second);
+        }
+
+        this->stageEvents.clear();
+    }
+
+    this->profiling = enabled;
+}
+
+/**
+ * Sums the device time of the profiled kernel runs per stage
+ *
+ * @param [out] timings One entry per stage
+ */
+bool Solver::collectStageTimings(vector<StageTiming>& timings)
+{
+    if (this->stageEvents.empty()) {
+        timings.clear();
+        return false;
+    }
+
+    clFinish(this->queue);
+
+    // Keep the entries (and their names) of the last collection:
+
+    for (size_t j = 0; j < timings.size(); j++) {
+        timings[j].ms   = 0.0;
+        timings[j].runs = 0;
+    }
+
+    bool available = true;
+
+    for (size_t i = 0; i < this->stageEvents.size(); i++) {
+
+        const char* stage = this->stageEvents[i].first;
+        cl_event event    = this->stageEvents[i].second;
+        cl_ulong start    = 0;
+        cl_ulong end      = 0;
+
+        available = available
+                 && clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) == CL_SUCCESS
+                 && clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) == CL_SUCCESS;
+
+        clReleaseEvent(event);
+
+        if (!available) {
+            continue;
+        }
+
+        // Stages are few, so a linear search keeps them in execution order:
+
+        size_t j = 0;
+
+        while (j < timings.size() && timings[j].name != stage) {
+            j++;
+        }
+
+        if (j == timings.size()) {
+            StageTiming timing = { stage, 0.0, 0 };
+            timings.push_back(timing);
+        }
+
+        timings[j].ms += static_cast<double>(end - start) * 1.0e-6;
+        timings[j].runs++;
+    }
+
+    this->stageEvents.clear();
+
+    if (!available) {
+        timings.clear();
+        return false;
+    }
+
+    // Drop the stages that didn't run this time, keeping the order:
+
+    size_t kept = 0;
+
+    for (size_t j = 0; j < timings.size(); j++) {
+        if (timings[j].runs > 0) {
+            if (kept != j) {
+                swap(timings[kept], timings[j]);
+            }
+            kept++;
+        }
+    }
+
+    timings.resize(kept);
+
+    return true;
+}
+
+/**
+ * Returns the spatial queries, building kernels/Query.cl and binding them
+ * the first time; NULL if they couldn't be built
+ */
+SpatialQueries* Solver::getSpatialQueries()
+{
+    if (!this->spatialQueries) {
+
+        this->spatialQueries = shared_ptr<SpatialQueries>(new SpatialQueries(this->context, this->device, this->queue, this->dataPath));
+
+        if (this->numParticles > 0) {
+            this->spatialQueries->bind(this->buffers, this->cellsPerAxis);
+        }
+    }
+
+    return this->spatialQueries->isLoaded() ? this->spatialQueries.get() : NULL;
+}
+
+/**
+ * Finds the particles in a batch of sphere and box queries
+ *
+ * @param [in] queries The queries
+ * @param [out] ranges The range of indices of every query
+ * @param [out] indices The particles found
+ */
+bool Solver::findParticles(const vector<SpatialQuery>& queries
+                          ,vector<QueryRange>& ranges
+                          ,vector<int>& indices)
+{
+    SpatialQueries* spatial = this->getSpatialQueries();
+
+    // Nothing has been binned before the first step:
+
+    if (spatial == NULL || this->numParticles <= 0 || this->binnedBounds.max[0] <= this->binnedBounds.min[0]) {
+        ranges.clear();
+        indices.clear();
+        return false;
+    }
+
+    return spatial->find(queries.empty() ? NULL : &queries[0]
+                        ,static_cast<int>(queries.size())
+                        ,this->binnedBounds.min
+                        ,this->binnedBounds.max
+                        ,ranges
+                        ,indices);
+}
+
+/**
+ * Estimates density and velocity at a batch of probe points
+ *
+ * @param [in] probes The probes
+ * @param [out] results One estimate per probe
+ */
+bool Solver::probe(const vector<SpatialQuery>& probes, vector<ProbeResult>& results)
+{
+    SpatialQueries* spatial = this->getSpatialQueries();
+
+    if (spatial == NULL || this->numParticles <= 0 || this->binnedBounds.max[0] <= this->binnedBounds.min[0]) {
+        results.clear();
+        return false;
+    }
+
+    return spatial->probe(probes.empty() ? NULL : &probes[0]
+                         ,static_cast<int>(probes.size())
+                         ,this->binnedBounds.min
+                         ,this->binnedBounds.max
+                         ,results);
+}
+
+/**
+ * Counts the neighbor candidates per particle from the cell lengths: every
+ * particle of a cell visits every particle of the cells around it
+ */
+double Solver::measureNeighborCount()
+{
+    if (this->numParticles <= 0 || this->numCells <= 0) {
+        return 0.0;
+    }
+
+    vector<GridCellOffset> offsets(this->numCells);
+
+    if (!checkError(clEnqueueReadBuffer(this->queue
+                                       ,this->buffers.gridCellOffsets
+                                       ,CL_TRUE
+                                       ,0
+                                       ,this->numCells * sizeof(GridCellOffset)
+                                       ,&offsets[0]
+                                       ,0
+                                       ,NULL
+                                       ,NULL)
+                   ,"clEnqueueReadBuffer (gridCellOffsets)")) {
+        return 0.0;
+    }
+
+    int cellsX = this->cellsPerAxis[0];
+    int cellsY = this->cellsPerAxis[1];
+    int cellsZ = this->cellsPerAxis[2];
+
+    // Sums the particles of the block of cells starting at (i0, j0, k0),
+    // span[0] by span[1] by span[2] cells wide, clipped to the grid:
+
+    auto blockLength = [&](int i0, int j0, int k0, const int span[3]) -> double {
+        double sum = 0.0;
+        for (int dk = max(k0, 0); dk <= min(k0 + span[2] - 1, cellsZ - 1); dk++) {
+            for (int dj = max(j0, 0); dj <= min(j0 + span[1] - 1, cellsY - 1); dj++) {
+                for (int di = max(i0, 0); di <= min(i0 + span[0] - 1, cellsX - 1); di++) {
+                    sum += max(offsets[di + (dj * cellsX) + (dk * cellsX * cellsY)].length, 0);
+                }
+            }
+        }
+        return sum;
+    };
+
+    // With the half-cell stencil, the block depends on where in its cell a
+    // particle is (see neighborStencilOrigin() in kernels/Common.cl). Taking
+    // particles to be spread evenly over their cells, on each axis a share
+    // of them reaches only into the lower neighbor cell, a share into
+    // neither, a share only into the upper one and a share into both; each
+    // case has its own first cell and width on that axis:
+
+    const int caseStart[4] = { -1, 0, 0, -1 };
+    const int caseSpan[4]  = {  2, 1, 2,  3 };
+
+    bool halfCell = this->isHalfCellStencilActive();
+    float h       = this->parameters.smoothingRadius;
+
+    // Per axis: { lower only, neither, upper only, both }
+    double shares[3][4];
+
+    for (int a = 0; a < 3; a++) {
+
+        float width = (this->bounds.max[a] - this->bounds.min[a]) / static_cast<float>(max(this->cellsPerAxis[a], 1));
+
+        halfCell = halfCell && width >= h;
+
+        double reachLo = min(max(h / width, 0.0f), 1.0f);          // u < reachLo touches the lower cell
+        double reachHi = min(max(1.0f - h / width, 0.0f), 1.0f);   // u >= reachHi touches the upper one
+
+        shares[a][0] = min(reachLo, reachHi);
+        shares[a][1] = max(reachHi - reachLo, 0.0);
+        shares[a][2] = 1.0 - max(reachLo, reachHi);
+        shares[a][3] = max(reachLo - reachHi, 0.0);
+    }
+
+    const int full[3] = { 3, 3, 3 };
+    double visits     = 0.0;
+
+    for (int k = 0; k < cellsZ; k++) {
+        for (int j = 0; j < cellsY; j++) {
+            for (int i = 0; i < cellsX; i++) {
+
+                int length = max(offsets[i + (j * cellsX) + (k * cellsX * cellsY)].length, 0);
+
+                if (length == 0) {
+                    continue;
+                }
+
+                double around = 0.0;
+
+                if (!halfCell) {
+                    around = blockLength(i - 1, j - 1, k - 1, full);
+                } else {
+                    for (int cz = 0; cz < 4; cz++) {
+                        for (int cy = 0; cy < 4; cy++) {
+                            for (int cx = 0; cx < 4; cx++) {
+
+                                double share = shares[0][cx] * shares[1][cy] * shares[2][cz];
+
+                                if (share <= 0.0) {
+                                    continue;
+                                }
+
+                                int span[3] = { caseSpan[cx], caseSpan[cy], caseSpan[cz] };
+
+                                around += share * blockLength(i + caseStart[cx]
+                                                             ,j + caseStart[cy]
+                                                             ,k + caseStart[cz]
+                                                             ,span);
+                            }
+                        }
+                    }
+                }
+
+                visits += static_cast<double>(length) * around;
+            }
+        }
+    }
+
+    return visits / static_cast<double>(this->numParticles);
+}
+
+}
+
+/******************************************************************************/
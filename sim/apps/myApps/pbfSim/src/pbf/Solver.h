@@ -0,0 +1,408 @@
+/*******************************************************************************
+ * Solver.h
+ * - The position-based fluids solver core: device buffers, kernels and
+ *   stepping, with no openFrameworks or OpenGL dependency. Applications
+ *   provide the OpenCL context and queue, and may provide any of the device
+ *   buffers the solver works on
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_SOLVER_H
+#define PBF_LIB_SOLVER_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Program.h"
+#include "PrefixSum.h"
+#include "PairwiseDensity.h"
+#include "ForceFields.h"
+#include "SpatialQueries.h"
+#include "Parameters.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+// Device-side types; these must match the definitions in kernels/Common.cl
+
+typedef struct {
+
+    cl_float4 pos;      // Current particle position (x)
+
+    cl_float4 posStar;  // Predicted particle position (x*)
+
+    cl_float4 vel;      // Current particle velocity (v)
+
+} Particle;
+
+typedef struct {
+
+    cl_int particleIndex;
+
+    cl_int cellI;
+
+    cl_int cellJ;
+
+    cl_int cellK;
+
+    cl_int key;
+
+    cl_int __padding[3];
+
+} ParticlePosition;
+
+typedef struct {
+
+    cl_int start;
+
+    cl_int length;
+
+    cl_int __padding[2];
+
+} GridCellOffset;
+
+// World space bounds of the simulation
+
+typedef struct {
+
+    float min[3];
+
+    float max[3];
+
+} Bounds;
+
+/**
+ * Device buffers the solver works on. Any handle left NULL is allocated (and
+ * released) by the solver; handles that are given are borrowed and must stay
+ * valid until the solver is destroyed or set up again
+ *
+ * Buffers shared with a graphics API (e.g. renderPos as a GL vertex buffer)
+ * must be acquired by the caller around step()
+ */
+struct DeviceBuffers
+{
+    cl_mem parameters;           // Parameters
+    cl_mem particles;            // Particle[numParticles]
+    cl_mem particleToCell;       // ParticlePosition[numParticles]
+    cl_mem sortedParticleToCell; // ParticlePosition[numParticles]
+    cl_mem cellHistogram;        // int[numCells]
+    cl_mem cellPrefixSums;       // int[numCells]
+    cl_mem gridCellOffsets;      // GridCellOffset[numCells]
+    cl_mem density;              // float[numParticles]
+    cl_mem lambda;               // float[numParticles]
+    cl_mem curl;                 // float4[numParticles]
+    cl_mem extForces;            // float4[numParticles]; only read if
+                                 // kernels/Forces.cl didn't build
+    cl_mem posDelta;             // float4[numParticles]
+    cl_mem renderPos;            // float4[numParticles]
+
+    DeviceBuffers();
+};
+
+/**
+ * Cells a neighbor loop visits around a particle's cell (see "Neighbor
+ * stencils" in kernels/Common.cl)
+ */
+enum NeighborStencil {
+    STENCIL_FULL = 0,    // The 3x3x3 block around the particle's cell
+    STENCIL_HALF_CELL    // The cells the particle's h-ball touches: one
+                         // or two per axis, on cells at least 2h wide
+};
+
+// Device time spent in one stage (kernel, or the scan) of the steps profiled
+
+typedef struct {
+
+    std::string name;
+
+    double ms;
+
+    int runs;
+
+} StageTiming;
+
+/**
+ * Receives callbacks at fixed points of every step, e.g. to update and
+ * resolve colliders against the predicted positions
+ */
+class SolverListener
+{
+    public:
+        virtual ~SolverListener() {}
+
+        // Called after per-step quantities are reset, before positions are
+        // predicted
+        virtual void beginStep(float dt) {}
+
+        // Called at the end of every constraint solver iteration, after the
+        // position deltas have been applied
+        virtual void solverIteration(int iteration) {}
+};
+
+/**
+ * Steps the simulation described in "Position Based Fluids" (Macklin &
+ * Muller), using the counting sort based neighbor search of Hoetzlein, 2014.
+ * See kernels/Simulation.cl
+ */
+class Solver
+{
+    private:
+        cl_context context;
+
+        cl_device_id device;
+
+        cl_command_queue queue;
+
+        // Directory kernels/ is loaded from
+        std::string dataPath;
+
+        Program program;
+
+        // Kernels of kernels/Simulation.cl, resolved once after loading so
+        // steps don't look them up by name
+        enum Kernel {
+            RESET_PARTICLE_QUANTITIES = 0,
+            RESET_CELL_QUANTITIES,
+            PREDICT_POSITION,
+            DISCRETIZE_PARTICLE_POSITIONS,
+            COUNT_SORT_PARTICLES_BY_CELL,
+            FIND_PARTICLE_BINS,
+            ESTIMATE_DENSITY,
+            COMPUTE_LAMBDA,
+            COMPUTE_POSITION_DELTA,
+            UPDATE_POSITION_DELTA,
+            COMPUTE_CURL,
+            UPDATE_POSITION,
+            NUM_KERNELS
+        };
+
+        static const char* const KERNEL_NAMES[NUM_KERNELS];
+
+        cl_kernel kernels[NUM_KERNELS];
+
+        std::shared_ptr<PrefixSum> prefixSum;
+
+        // Created on first use (see setPairwiseDensity)
+        std::shared_ptr<PairwiseDensity> pairwiseDensity;
+
+        std::shared_ptr<ForceFields> forceFields;
+
+        // Created on first use (see findParticles, probe)
+        std::shared_ptr<SpatialQueries> spatialQueries;
+
+        SolverListener* listener;
+
+        int numParticles;
+
+        int numCells;
+
+        // The grid the particles are binned into, and the one asked for in
+        // setup(); see sizeGrid()
+        int cellsPerAxis[3];
+        int requestedCellsPerAxis[3];
+
+        float dt;
+
+        int solverIterations;
+
+        Bounds bounds;
+
+        // The bounds the particles were binned with in the last step
+        Bounds binnedBounds;
+
+        Parameters parameters;
+
+        // Effective buffers, and the ones allocated by the solver
+        DeviceBuffers buffers;
+        DeviceBuffers owned;
+
+        NeighborStencil stencil;
+
+        // Whether kernels/Simulation.cl declares NEIGHBOR_STENCIL_PROGRAM,
+        // i.e. whether PBF_HALF_CELL_STENCIL changes anything it runs
+        bool stencilInProgram;
+
+        bool pairwise;
+
+        bool profiling;
+
+        // Events of the kernel runs enqueued since the last
+        // collectStageTimings(), tagged with their stage
+        std::vector<std::pair<const char*, cl_event> > stageEvents;
+
+        // Events of the helpers' (scan, pairwise density, force fields)
+        // kernel runs, before they're tagged
+        std::vector<cl_event> helperEvents;
+
+        // Non-copyable
+        Solver(const Solver&);
+        Solver& operator=(const Solver&);
+
+        cl_mem useOrCreate(cl_mem external, cl_mem& owned, size_t size);
+
+        void releaseOwnedBuffers();
+
+        bool loadProgram();
+
+        void sizeGrid();
+
+        void bindKernels();
+
+        void bindBounds(cl_kernel kernel, int minIndex, int maxIndex);
+
+        void run(Kernel kernel, size_t globalSize);
+
+        void estimateDensity(size_t n);
+
+        void tagHelperEvents(const char* stage);
+
+        SpatialQueries* getSpatialQueries();
+
+    public:
+        Solver(cl_context context
+              ,cl_device_id device
+              ,cl_command_queue queue
+              ,const std::string& dataPath);
+
+        virtual ~Solver();
+
+        /**
+         * Starts building the programs a solver builds when it's created
+         * (kernels/Simulation.cl for the default stencil, kernels/Scan.cl
+         * and kernels/Forces.cl) concurrently on worker threads, so they
+         * can build while the application sets up. See prebuildProgram()
+         */
+        static void prebuild(cl_context context
+                            ,cl_device_id device
+                            ,const std::string& dataPath);
+
+        bool isLoaded() const { return this->program.isLoaded(); }
+
+        cl_context getContext() const      { return this->context; }
+        cl_device_id getDevice() const     { return this->device; }
+        cl_command_queue getQueue() const  { return this->queue; }
+
+        /**
+         * Sizes the solver and binds its buffers. Can be called again, e.g.
+         * after the external buffers have been reallocated
+         */
+        bool setup(int numParticles
+                  ,const int cellsPerAxis[3]
+                  ,const Bounds& bounds
+                  ,const Parameters& parameters
+                  ,float dt
+                  ,const DeviceBuffers& external = DeviceBuffers());
+
+        int getNumberOfParticles() const { return this->numParticles; }
+        int getNumberOfCells() const     { return this->numCells; }
+        const int* getCellsPerAxis() const { return this->cellsPerAxis; }
+        const int* getRequestedCellsPerAxis() const { return this->requestedCellsPerAxis; }
+
+        const Bounds& getBounds() const { return this->bounds; }
+        void setBounds(const Bounds& bounds);
+
+        const Parameters& getParameters() const { return this->parameters; }
+        void setParameters(const Parameters& parameters);
+
+        float getTimeStep() const { return this->dt; }
+        void setTimeStep(float dt);
+
+        int getSolverIterations() const           { return this->solverIterations; }
+        void setSolverIterations(int iterations) { this->solverIterations = iterations; }
+
+        void setListener(SolverListener* listener) { this->listener = listener; }
+
+        /**
+         * Selects the neighbor stencil, rebuilding kernels/Simulation.cl
+         * with or without PBF_HALF_CELL_STENCIL. With the half-cell stencil
+         * the grid is coarsened to cells at least 2h wide, so
+         * getCellsPerAxis() may differ from the grid given to setup()
+         */
+        bool setNeighborStencil(NeighborStencil stencil);
+        NeighborStencil getNeighborStencil() const { return this->stencil; }
+
+        // True if the half-cell stencil is selected and the neighbor loops
+        // of kernels/Simulation.cl actually go through it
+        bool isHalfCellStencilActive() const { return this->stencil == STENCIL_HALF_CELL && this->stencilInProgram; }
+
+        /**
+         * Selects how densities are estimated: per particle, gathering from
+         * all neighbors (estimateDensity), or per pair of neighbors, visited
+         * once through a half-shell stencil and added to both particles
+         * (kernels/Pairwise.cl). Returns false if the pairwise kernels could
+         * not be built, leaving the gather-based estimate selected
+         */
+        bool setPairwiseDensity(bool enabled);
+        bool isPairwiseDensity() const { return this->pairwise; }
+
+        // NULL until the pairwise density estimate is first selected
+        PairwiseDensity* getPairwiseDensity() { return this->pairwiseDensity.get(); }
+
+        const DeviceBuffers& getBuffers() const { return this->buffers; }
+
+        PrefixSum& getPrefixSum() { return *this->prefixSum; }
+
+        /**
+         * External force fields, evaluated as the positions are predicted
+         * at the start of every step
+         */
+        ForceFields& getForceFields() { return *this->forceFields; }
+
+        // Blocking transfers of the particle state
+        void writeParticles(const Particle* particles);
+        void readParticles(Particle* particles);
+
+        // Enqueues one simulation step; does not block
+        void step();
+
+        // Blocks until all enqueued work is done
+        void finish();
+
+        /**
+         * Records an event for every stage of subsequent steps. The queue
+         * must have been created with CL_QUEUE_PROFILING_ENABLE
+         */
+        void setProfiling(bool enabled);
+        bool isProfiling() const { return this->profiling; }
+
+        /**
+         * Waits for the profiled steps to finish and sums their device time
+         * per stage, in the order the stages run. Returns false if no
+         * profiling information was available. The entries already in
+         * timings are reused, so collecting every step doesn't allocate
+         */
+        bool collectStageTimings(std::vector<StageTiming>& timings);
+
+        /**
+         * Finds the particles in a batch of sphere and box queries on the
+         * grid of the last step; see SpatialQueries::find. Blocks
+         */
+        bool findParticles(const std::vector<SpatialQuery>& queries
+                          ,std::vector<QueryRange>& ranges
+                          ,std::vector<int>& indices);
+
+        /**
+         * Estimates density and velocity at a batch of probe points from the
+         * particles of the last step; see SpatialQueries::probe. Blocks
+         */
+        bool probe(const std::vector<SpatialQuery>& probes
+                  ,std::vector<ProbeResult>& results);
+
+        /**
+         * Reads the grid cell offsets of the last step back and returns the
+         * mean number of neighbor candidates (particles in the cells of the
+         * stencil, the particle's own cell included) visited per particle,
+         * before cells are rejected by distance. Blocks
+         */
+        double measureNeighborCount();
+};
+
+}
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,396 @@
+/*******************************************************************************
+ * SpatialQueries.cpp
+ * - Batched spatial queries on the sorted grid of the last step: particles
+ *   in spheres or boxes, and density and velocity at probe points, answered
+ *   on the device. See kernels/Query.cl
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include "SpatialQueries.h"
+#include "Solver.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+// The header is read from the device straight into a vector<int>
+static_assert(sizeof(int) == sizeof(cl_int), "int must be the size of cl_int");
+
+namespace pbf {
+
+/**
+ * Returns a query of the given type, zeroed otherwise
+ */
+static SpatialQuery makeQuery(SpatialQueryType type, const float center[3])
+{
+    SpatialQuery query;
+
+    memset(&query, 0, sizeof(SpatialQuery));
+
+    query.type = type;
+
+    for (int i = 0; i < 3; i++) {
+        query.center.s[i] = center[i];
+    }
+
+    return query;
+}
+
+SpatialQuery sphereQuery(const float center[3], float radius)
+{
+    SpatialQuery query = makeQuery(QUERY_SPHERE, center);
+
+    query.halfExtent.s[0] = radius;
+
+    return query;
+}
+
+SpatialQuery boxQuery(const float center[3], const float halfExtent[3])
+{
+    SpatialQuery query = makeQuery(QUERY_BOX, center);
+
+    for (int i = 0; i < 3; i++) {
+        query.halfExtent.s[i] = halfExtent[i];
+    }
+
+    return query;
+}
+
+SpatialQuery probeQuery(const float point[3], float radius)
+{
+    SpatialQuery query = makeQuery(QUERY_PROBE, point);
+
+    query.halfExtent.s[0] = radius;
+
+    return query;
+}
+
+/******************************************************************************/
+
+/**
+ * Builds kernels/Query.cl. Buffers are allocated by the first batch, and
+ * grown by larger ones
+ *
+ * @param [in] _context OpenCL context the solver's buffers belong to
+ * @param [in] device Device the kernels are built for
+ * @param [in] _queue Queue all work is enqueued on
+ * @param [in] dataPath Directory containing kernels/Query.cl
+ */
+SpatialQueries::SpatialQueries(cl_context _context
+                              ,cl_device_id device
+                              ,cl_command_queue _queue
+                              ,const string& dataPath) :
+    context(_context),
+    queue(_queue),
+    program(_context, device),
+    findKernel(NULL),
+    probeKernel(NULL),
+    queryBuffer(NULL),
+    queryCapacity(0),
+    headerBuffer(NULL),
+    probeBuffer(NULL),
+    indexBuffer(NULL),
+    indexCapacity(0),
+    zero(0)
+{
+    if (!this->program.loadKernelFile("kernels/Query.cl", dataPath)) {
+        return;
+    }
+
+    this->findKernel  = this->program.kernel("findQueryParticles");
+    this->probeKernel = this->program.kernel("probeQueryPoints");
+}
+
+SpatialQueries::~SpatialQueries()
+{
+    cl_mem buffers[] = { this->queryBuffer, this->headerBuffer, this->probeBuffer, this->indexBuffer };
+
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (buffers[i] != NULL) {
+            clReleaseMemObject(buffers[i]);
+        }
+    }
+}
+
+/**
+ * Binds the particles and grid the queries are answered from
+ *
+ * @param [in] b The solver's effective buffers
+ * @param [in] cellsPerAxis Grid cells along x, y and z
+ */
+void SpatialQueries::bind(const DeviceBuffers& b, const int cellsPerAxis[3])
+{
+    if (!this->isLoaded()) {
+        return;
+    }
+
+    // KERNEL :: findQueryParticles (bounds, arguments 6 and 7, and the
+    // queries, 8 - 12, are set per batch)
+
+    cl_kernel k = this->findKernel;
+    setArg(k, 0, b.particles);
+    setArg(k, 1, b.sortedParticleToCell);
+    setArg(k, 2, b.gridCellOffsets);
+    setArg(k, 3, cellsPerAxis[0]);
+    setArg(k, 4, cellsPerAxis[1]);
+    setArg(k, 5, cellsPerAxis[2]);
+
+    // KERNEL :: probeQueryPoints (bounds, arguments 7 and 8, and the
+    // queries, 9 - 11, are set per batch)
+
+    k = this->probeKernel;
+    setArg(k, 0, b.parameters);
+    setArg(k, 1, b.particles);
+    setArg(k, 2, b.sortedParticleToCell);
+    setArg(k, 3, b.gridCellOffsets);
+    setArg(k, 4, cellsPerAxis[0]);
+    setArg(k, 5, cellsPerAxis[1]);
+    setArg(k, 6, cellsPerAxis[2]);
+}
+
+/**
+ * Grows the query, header and probe result buffers to hold numQueries
+ * queries, at least doubling them
+ */
+bool SpatialQueries::reserveQueries(int numQueries)
+{
+    if (numQueries <= this->queryCapacity) {
+        return true;
+    }
+
+    int capacity = max(numQueries, 2 * this->queryCapacity);
+
+    cl_mem* buffers[] = { &this->queryBuffer, &this->headerBuffer, &this->probeBuffer };
+    size_t sizes[]    = { capacity * sizeof(SpatialQuery)
+                        , (1 + (2 * capacity)) * sizeof(cl_int)
+                        , capacity * sizeof(ProbeResult) };
+
+    this->queryCapacity = 0;
+
+    for (int i = 0; i < 3; i++) {
+
+        if (*buffers[i] != NULL) {
+            clReleaseMemObject(*buffers[i]);
+        }
+
+        cl_int err  = CL_SUCCESS;
+        *buffers[i] = clCreateBuffer(this->context, CL_MEM_READ_WRITE, sizes[i], NULL, &err);
+
+        if (!checkError(err, "clCreateBuffer (spatial queries)")) {
+            *buffers[i] = NULL;
+            return false;
+        }
+    }
+
+    this->queryCapacity = capacity;
+    this->header.resize(1 + (2 * capacity));
+
+    return true;
+}
+
+/**
+ * Grows the index list to hold numIndices indices, at least doubling it
+ */
+bool SpatialQueries::reserveIndices(int numIndices)
+{
+    if (numIndices <= this->indexCapacity) {
+        return true;
+    }
+
+    int capacity = max(numIndices, 2 * this->indexCapacity);
+
+    if (this->indexBuffer != NULL) {
+        clReleaseMemObject(this->indexBuffer);
+    }
+
+    cl_int err          = CL_SUCCESS;
+    this->indexCapacity = 0;
+    this->indexBuffer   = clCreateBuffer(this->context, CL_MEM_READ_WRITE, capacity * sizeof(cl_int), NULL, &err);
+
+    if (!checkError(err, "clCreateBuffer (query indices)")) {
+        this->indexBuffer = NULL;
+        return false;
+    }
+
+    this->indexCapacity = capacity;
+
+    return true;
+}
+
+/**
+ * Enqueues the write of a batch of queries; the caller's array is read
+ * before the batch's (blocking) read back returns
+ */
+bool SpatialQueries::writeQueries(const SpatialQuery* queries, int numQueries)
+{
+    if (!this->reserveQueries(numQueries)) {
+        return false;
+    }
+
+    return checkError(clEnqueueWriteBuffer(this->queue
+                                          ,this->queryBuffer
+                                          ,CL_FALSE
+                                          ,0
+                                          ,numQueries * sizeof(SpatialQuery)
+                                          ,queries
+                                          ,0
+                                          ,NULL
+                                          ,NULL)
+                     ,"clEnqueueWriteBuffer (spatial queries)");
+}
+
+/**
+ * Finds the particles of a batch of sphere and box queries
+ *
+ * @param [in] queries The queries
+ * @param [in] numQueries Number of queries
+ * @param [in] minExt, maxExt The bounds the grid was binned with
+ * @param [out] ranges The range of indices of every query
+ * @param [out] indices The particles found
+ */
+bool SpatialQueries::find(const SpatialQuery* queries
+                         ,int numQueries
+                         ,const float minExt[3]
+                         ,const float maxExt[3]
+                         ,vector<QueryRange>& ranges
+                         ,vector<int>& indices)
+{
+    ranges.clear();
+    indices.clear();
+
+    if (!this->isLoaded() || numQueries <= 0) {
+        return this->isLoaded();
+    }
+
+    if (!this->writeQueries(queries, numQueries) || !this->reserveIndices(numQueries)) {
+        return false;
+    }
+
+    cl_float4 lo = {{ minExt[0], minExt[1], minExt[2], 0.0f }};
+    cl_float4 hi = {{ maxExt[0], maxExt[1], maxExt[2], 0.0f }};
+
+    cl_kernel k = this->findKernel;
+    setArg(k, 6, lo);
+    setArg(k, 7, hi);
+    setArg(k, 8, this->queryBuffer);
+    setArg(k, 9, numQueries);
+    setArg(k, 10, this->headerBuffer);
+
+    // Runs again, once, if the index list was too short:
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+
+        clEnqueueWriteBuffer(this->queue, this->headerBuffer, CL_FALSE, 0, sizeof(cl_int), &this->zero, 0, NULL, NULL);
+
+        setArg(k, 11, this->indexBuffer);
+        setArg(k, 12, this->indexCapacity);
+
+        run1D(this->queue, k, static_cast<size_t>(numQueries));
+
+        if (!checkError(clEnqueueReadBuffer(this->queue
+                                           ,this->headerBuffer
+                                           ,CL_TRUE
+                                           ,0
+                                           ,(1 + (2 * numQueries)) * sizeof(int)
+                                           ,&this->header[0]
+                                           ,0
+                                           ,NULL
+                                           ,NULL)
+                       ,"clEnqueueReadBuffer (query ranges)")) {
+            return false;
+        }
+
+        if (this->header[0] <= this->indexCapacity) {
+            break;
+        }
+
+        if (!this->reserveIndices(this->header[0])) {
+            return false;
+        }
+    }
+
+    int total = this->header[0];
+
+    ranges.resize(numQueries);
+
+    for (int i = 0; i < numQueries; i++) {
+        ranges[i].start = this->header[1 + (2 * i)];
+        ranges[i].count = this->header[2 + (2 * i)];
+    }
+
+    if (total == 0) {
+        return true;
+    }
+
+    indices.resize(total);
+
+    return checkError(clEnqueueReadBuffer(this->queue
+                                         ,this->indexBuffer
+                                         ,CL_TRUE
+                                         ,0
+                                         ,total * sizeof(cl_int)
+                                         ,&indices[0]
+                                         ,0
+                                         ,NULL
+                                         ,NULL)
+                     ,"clEnqueueReadBuffer (query indices)");
+}
+
+/**
+ * Estimates density and velocity at a batch of probe points
+ *
+ * @param [in] queries The probes (any query; only center and radius are
+ *             used)
+ * @param [in] numQueries Number of probes
+ * @param [in] minExt, maxExt The bounds the grid was binned with
+ * @param [out] results One estimate per probe
+ */
+bool SpatialQueries::probe(const SpatialQuery* queries
+                          ,int numQueries
+                          ,const float minExt[3]
+                          ,const float maxExt[3]
+                          ,vector<ProbeResult>& results)
+{
+    results.clear();
+
+    if (!this->isLoaded() || numQueries <= 0) {
+        return this->isLoaded();
+    }
+
+    if (!this->writeQueries(queries, numQueries)) {
+        return false;
+    }
+
+    cl_float4 lo = {{ minExt[0], minExt[1], minExt[2], 0.0f }};
+    cl_float4 hi = {{ maxExt[0], maxExt[1], maxExt[2], 0.0f }};
+
+    cl_kernel k = this->probeKernel;
+    setArg(k, 7, lo);
+    setArg(k, 8, hi);
+    setArg(k, 9, this->queryBuffer);
+    setArg(k, 10, numQueries);
+    setArg(k, 11, this->probeBuffer);
+
+    run1D(this->queue, k, static_cast<size_t>(numQueries));
+
+    results.resize(numQueries);
+
+    return checkError(clEnqueueReadBuffer(this->queue
+                                         ,this->probeBuffer
+                                         ,CL_TRUE
+                                         ,0
+                                         ,numQueries * sizeof(ProbeResult)
+                                         ,&results[0]
+                                         ,0
+                                         ,NULL
+                                         ,NULL)
+                     ,"clEnqueueReadBuffer (probe results)");
+}
+
+}
@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * SpatialQueries.h
+ * - Batched spatial queries on the sorted grid of the last step: particles
+ *   in spheres or boxes, and density and velocity at probe points, answered
+ *   on the device. See kernels/Query.cl
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_SPATIAL_QUERIES_H
+#define PBF_LIB_SPATIAL_QUERIES_H
+
+#include <string>
+#include <vector>
+#include "Program.h"
+
+/******************************************************************************/
+
+namespace pbf {
+
+struct DeviceBuffers;
+
+// Kinds of query; these must match QUERY_* in kernels/Query.cl
+
+enum SpatialQueryType {
+    QUERY_SPHERE = 0,  // Particles within a radius of a point
+    QUERY_BOX,         // Particles in an axis-aligned box
+    QUERY_PROBE        // Density and velocity at a point
+};
+
+// Device-side types; these must match the definitions in kernels/Query.cl
+
+typedef struct {
+
+    cl_float4 center;
+
+    cl_float4 halfExtent;  // Box half-extents; x is the radius of spheres
+                           // and probes (<= 0 for probes: the smoothing
+                           // radius)
+
+    cl_int type;           // SpatialQueryType
+
+    cl_int __padding[3];
+
+} SpatialQuery;
+
+typedef struct {
+
+    cl_float4 velocity;    // Kernel-weighted mean velocity
+
+    cl_float density;      // Sum of poly6 over the particles in range, as in
+                           // the solver's density estimate
+
+    cl_int neighbors;      // Particles in range
+
+    cl_int __padding[2];
+
+} ProbeResult;
+
+// The particles found by a sphere or box query: indices[start, start + count)
+
+typedef struct {
+
+    int start;
+
+    int count;
+
+} QueryRange;
+
+// Queries of each kind
+
+SpatialQuery sphereQuery(const float center[3], float radius);
+
+SpatialQuery boxQuery(const float center[3], const float halfExtent[3]);
+
+SpatialQuery probeQuery(const float point[3], float radius = 0.0f);
+
+/**
+ * Answers batches of queries against the particles and the grid binned by
+ * the solver's last step. Queries test the particles' positions at the end
+ * of that step; the cells searched are those of the binning, so a particle
+ * that crossed into a cell outside a query's box during the step's solver
+ * iterations (well under a particle radius) can be missed
+ */
+class SpatialQueries
+{
+    private:
+        cl_context context;
+
+        cl_command_queue queue;
+
+        // kernels/Query.cl and its kernels
+        Program program;
+
+        cl_kernel findKernel;
+        cl_kernel probeKernel;
+
+        // SpatialQuery[queryCapacity]
+        cl_mem queryBuffer;
+        int queryCapacity;
+
+        // int[1 + 2 * queryCapacity]: the number of matches, then the
+        // (start, count) of every query
+        cl_mem headerBuffer;
+
+        // ProbeResult[queryCapacity]
+        cl_mem probeBuffer;
+
+        // int[indexCapacity]
+        cl_mem indexBuffer;
+        int indexCapacity;
+
+        // Host copy of the header, kept between batches. Plain int, which
+        // is cl_int without the alignment attribute a vector would ignore
+        std::vector<int> header;
+
+        // Source of the write clearing the match count
+        cl_int zero;
+
+        // Non-copyable
+        SpatialQueries(const SpatialQueries&);
+        SpatialQueries& operator=(const SpatialQueries&);
+
+        bool reserveQueries(int numQueries);
+
+        bool reserveIndices(int numIndices);
+
+        bool writeQueries(const SpatialQuery* queries, int numQueries);
+
+    public:
+        SpatialQueries(cl_context context
+                      ,cl_device_id device
+                      ,cl_command_queue queue
+                      ,const std::string& dataPath);
+
+        virtual ~SpatialQueries();
+
+        bool isLoaded() const { return this->program.isLoaded(); }
+
+        // Binds the buffers of a solver; called again whenever they change
+        void bind(const DeviceBuffers& buffers, const int cellsPerAxis[3]);
+
+        /**
+         * Finds the particles of every sphere and box query (probes match
+         * nothing). ranges receives one entry per query into indices, which
+         * receives the particle indices found, in no particular order.
+         * Blocks; reads back the ranges, then the indices
+         *
+         * @param [in] minExt, maxExt The bounds the grid was binned with
+         */
+        bool find(const SpatialQuery* queries
+                 ,int numQueries
+                 ,const float minExt[3]
+                 ,const float maxExt[3]
+                 ,std::vector<QueryRange>& ranges
+                 ,std::vector<int>& indices);
+
+        /**
+         * Estimates density and velocity at the center of every query,
+         * within its radius. Blocks; one read back of the results
+         */
+        bool probe(const SpatialQuery* queries
+                  ,int numQueries
+                  ,const float minExt[3]
+                  ,const float maxExt[3]
+                  ,std::vector<ProbeResult>& results);
+};
+
+}
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * TimingHistogram.cpp
+ * - A fixed-size, log-bucketed histogram of durations, from which
+ *   percentiles (p50, p95, p99, ...) can be read at any time
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include "TimingHistogram.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace pbf {
+
+const double TimingHistogram::MIN_MS = 0.01;
+
+const double TimingHistogram::GROWTH = 1.05;
+
+TimingHistogram::TimingHistogram()
+{
+    this->reset();
+}
+
+void TimingHistogram::reset()
+{
+    fill(this->buckets, this->buckets + NUM_BUCKETS, 0ULL);
+
+    this->count   = 0;
+    this->sum     = 0.0;
+    this->maximum = 0.0;
+}
+
+int TimingHistogram::bucketOf(double ms)
+{
+    if (ms <= TimingHistogram::MIN_MS) {
+        return 0;
+    }
+
+    int bucket = static_cast<int>(log(ms / TimingHistogram::MIN_MS) / log(TimingHistogram::GROWTH));
+
+    return min(bucket, NUM_BUCKETS - 1);
+}
+
+void TimingHistogram::add(double ms)
+{
+    this->buckets[TimingHistogram::bucketOf(ms)]++;
+
+    this->count++;
+    this->sum    += ms;
+    this->maximum = max(this->maximum, ms);
+}
+
+/**
+ * Finds a percentile by walking the buckets
+ *
+ * @param [in] percent Percentage of samples, 0 - 100
+ */
+double TimingHistogram::percentile(double percent) const
+{
+    if (this->count == 0) {
+        return 0.0;
+    }
+
+    // Rank of the sample sought, 1-based:
+
+    double rank = max(1.0, ceil(static_cast<double>(this->count) * min(max(percent, 0.0), 100.0) / 100.0));
+
+    unsigned long long seen = 0;
+
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+
+        seen += this->buckets[i];
+
+        if (static_cast<double>(seen) >= rank) {
+            return min(TimingHistogram::MIN_MS * pow(TimingHistogram::GROWTH, i + 1), this->maximum);
+        }
+    }
+
+    return this->maximum;
+}
+
+}
+
+/******************************************************************************/
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * TimingHistogram.h
+ * - A fixed-size, log-bucketed histogram of durations, from which
+ *   percentiles (p50, p95, p99, ...) can be read at any time
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_TIMING_HISTOGRAM_H
+#define PBF_LIB_TIMING_HISTOGRAM_H
+
+/******************************************************************************/
+
+namespace pbf {
+
+/**
+ * Bucket i holds durations in [MIN_MS * GROWTH^i, MIN_MS * GROWTH^(i+1)), so
+ * percentiles are exact to within 5%. Durations outside the covered range
+ * (0.01 ms to about 10 s) go to the first or last bucket. Adding a sample
+ * never allocates
+ */
+class TimingHistogram
+{
+    public:
+        static const int NUM_BUCKETS = 288;
+
+        static const double MIN_MS;
+
+        static const double GROWTH;
+
+    private:
+        unsigned long long buckets[NUM_BUCKETS];
+
+        unsigned long long count;
+
+        double sum;
+
+        double maximum;
+
+        static int bucketOf(double ms);
+
+    public:
+        TimingHistogram();
+
+        void reset();
+
+        void add(double ms);
+
+        unsigned long long getCount() const { return this->count; }
+
+        double getMean() const { return this->count > 0 ? this->sum / static_cast<double>(this->count) : 0.0; }
+
+        double getMax() const { return this->maximum; }
+
+        /**
+         * The duration below which the given percentage (0 - 100) of the
+         * samples fall. Reported as the upper edge of its bucket, but never
+         * more than the largest sample
+         */
+        double percentile(double percent) const;
+};
+
+}
+
+/******************************************************************************/
+
+#endif
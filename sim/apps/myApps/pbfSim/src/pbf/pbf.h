@@ -0,0 +1,31 @@
+/*******************************************************************************
+ * pbf.h
+ * - Public header of libpbf, the position-based fluids solver core. The
+ *   library depends only on OpenCL; see Makefile in this directory
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_LIB_H
+#define PBF_LIB_H
+
+#include "Parameters.h"
+#include "Program.h"
+#include "KernelSources.h"
+#include "PrefixSum.h"
+#include "PairwiseDensity.h"
+#include "ForceFields.h"
+#include "SpatialQueries.h"
+#include "Solver.h"
+#include "Roofline.h"
+#include "TimingHistogram.h"
+#include "FlightRecorder.h"
+#include "FrameRing.h"
+#include "BoundsAnimation.h"
+#include "Session.h"
+#include "SessionLog.h"
+#include "Ensemble.h"
+#include "CoExecution.h"
+
+#endif
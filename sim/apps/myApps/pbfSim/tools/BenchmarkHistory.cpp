@@ -0,0 +1,270 @@
+/*******************************************************************************
+ * BenchmarkHistory.cpp
+ * - Per-stage benchmark results kept in a local SQLite database (through
+ *   Poco::Data), and the comparison of a run against a rolling baseline of
+ *   the runs before it
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <cmath>
+#include <iostream>
+#include "Poco/DateTimeFormat.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Data/SQLite/Connector.h"
+#include "BenchmarkHistory.h"
+
+/******************************************************************************/
+
+using namespace std;
+using Poco::Data::into;
+using Poco::Data::now;
+using Poco::Data::use;
+
+/******************************************************************************/
+
+BenchmarkHistory::BenchmarkHistory()
+{
+    Poco::Data::SQLite::Connector::registerConnector();
+}
+
+BenchmarkHistory::~BenchmarkHistory()
+{
+
+}
+
+/**
+ * Opens the database, creating its tables if they don't exist yet
+ *
+ * @param [in] path Path to the SQLite database file
+ */
+bool BenchmarkHistory::open(const string& path)
+{
+    try {
+
+        this->session = shared_ptr<Poco::Data::Session>(new Poco::Data::Session("SQLite", path));
+
+        Poco::Data::Session& db = *this->session;
+
+        db << "CREATE TABLE IF NOT EXISTS runs ("
+              "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+              "recorded TEXT, "
+              "commit_id TEXT, "
+              "device TEXT, "
+              "particles INTEGER)", now;
+
+        db << "CREATE TABLE IF NOT EXISTS stages ("
+              "run_id INTEGER REFERENCES runs(id), "
+              "stage TEXT, "
+              "mean_ms REAL, "
+              "stddev_ms REAL, "
+              "samples INTEGER)", now;
+
+        db << "CREATE INDEX IF NOT EXISTS runs_by_configuration ON runs (device, particles, id)", now;
+
+    } catch (Poco::Exception& e) {
+        cerr << "Couldn't open benchmark history " << path << ": " << e.displayText() << endl;
+        this->session.reset();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Stores a run and its stages. The run's id and timestamp are assigned here
+ *
+ * @param [in|out] run The run to store
+ */
+bool BenchmarkHistory::record(BenchmarkRun& run)
+{
+    if (!this->isOpen()) {
+        return false;
+    }
+
+    run.recorded = Poco::DateTimeFormatter::format(Poco::Timestamp(), Poco::DateTimeFormat::ISO8601_FORMAT);
+
+    try {
+
+        Poco::Data::Session& db = *this->session;
+
+        db.begin();
+
+        db << "INSERT INTO runs (recorded, commit_id, device, particles) VALUES (?, ?, ?, ?)"
+           , use(run.recorded), use(run.commit), use(run.device), use(run.numParticles), now;
+
+        db << "SELECT last_insert_rowid()", into(run.id), now;
+
+        for (size_t i = 0; i < run.stages.size(); i++) {
+
+            StageSample& stage = run.stages[i];
+
+            db << "INSERT INTO stages (run_id, stage, mean_ms, stddev_ms, samples) VALUES (?, ?, ?, ?, ?)"
+               , use(run.id), use(stage.stage), use(stage.meanMs), use(stage.stddevMs), use(stage.samples), now;
+        }
+
+        db.commit();
+
+    } catch (Poco::Exception& e) {
+        cerr << "Couldn't record benchmark run: " << e.displayText() << endl;
+        this->session->rollback();
+        return false;
+    }
+
+    return true;
+}
+
+vector<pair<string, int> > BenchmarkHistory::getConfigurations()
+{
+    vector<pair<string, int> > configurations;
+
+    if (!this->isOpen()) {
+        return configurations;
+    }
+
+    vector<string> devices;
+    vector<int> particles;
+
+    try {
+        *this->session << "SELECT DISTINCT device, particles FROM runs ORDER BY device, particles"
+                       , into(devices), into(particles), now;
+    } catch (Poco::Exception& e) {
+        cerr << "Couldn't read benchmark history: " << e.displayText() << endl;
+    }
+
+    for (size_t i = 0; i < devices.size() && i < particles.size(); i++) {
+        configurations.push_back(make_pair(devices[i], particles[i]));
+    }
+
+    return configurations;
+}
+
+/**
+ * Reads the most recent runs of a configuration, with their stages
+ *
+ * @param [in] device Device name
+ * @param [in] numParticles Particle count
+ * @param [in] limit Maximum number of runs to read
+ */
+vector<BenchmarkRun> BenchmarkHistory::getHistory(const string& device, int numParticles, int limit)
+{
+    vector<BenchmarkRun> runs;
+
+    if (!this->isOpen()) {
+        return runs;
+    }
+
+    try {
+
+        Poco::Data::Session& db = *this->session;
+
+        vector<Poco::Int64> ids;
+        vector<string> recorded;
+        vector<string> commits;
+
+        db << "SELECT id, recorded, commit_id FROM runs WHERE device = ? AND particles = ? ORDER BY id DESC LIMIT ?"
+           , into(ids), into(recorded), into(commits), use(device), use(numParticles), use(limit), now;
+
+        for (size_t i = 0; i < ids.size(); i++) {
+
+            BenchmarkRun run;
+
+            run.id           = ids[i];
+            run.recorded     = recorded[i];
+            run.commit       = commits[i];
+            run.device       = device;
+            run.numParticles = numParticles;
+
+            vector<string> names;
+            vector<double> means;
+            vector<double> stddevs;
+            vector<int> samples;
+
+            db << "SELECT stage, mean_ms, stddev_ms, samples FROM stages WHERE run_id = ? ORDER BY rowid"
+               , into(names), into(means), into(stddevs), into(samples), use(run.id), now;
+
+            for (size_t j = 0; j < names.size(); j++) {
+                StageSample stage = { names[j], means[j], stddevs[j], samples[j] };
+                run.stages.push_back(stage);
+            }
+
+            runs.push_back(run);
+        }
+
+    } catch (Poco::Exception& e) {
+        cerr << "Couldn't read benchmark history: " << e.displayText() << endl;
+    }
+
+    return runs;
+}
+
+/******************************************************************************/
+
+/**
+ * Compares a run against its baseline, stage by stage
+ *
+ * @param [in] latest The run to check
+ * @param [in] baseline The runs to compare against
+ * @param [in] tThreshold Smallest t statistic considered significant
+ * @param [in] minSlowdownPercent Smallest slowdown considered a regression
+ */
+vector<StageDiff> BenchmarkHistory::compare(const BenchmarkRun& latest
+                                           ,const vector<BenchmarkRun>& baseline
+                                           ,double tThreshold
+                                           ,double minSlowdownPercent)
+{
+    vector<StageDiff> diffs;
+
+    for (size_t i = 0; i < latest.stages.size(); i++) {
+
+        const StageSample& current = latest.stages[i];
+
+        // Pool the baseline samples of this stage: the pooled variance is
+        // the within-run variance plus the spread of the run means
+
+        double n       = 0.0;
+        double sum     = 0.0;
+        double squares = 0.0;
+        int runs       = 0;
+
+        for (size_t r = 0; r < baseline.size(); r++) {
+            for (size_t s = 0; s < baseline[r].stages.size(); s++) {
+
+                const StageSample& sample = baseline[r].stages[s];
+
+                if (sample.stage != current.stage || sample.samples <= 0) {
+                    continue;
+                }
+
+                double k  = static_cast<double>(sample.samples);
+                n        += k;
+                sum      += k * sample.meanMs;
+                squares  += (k - 1.0) * sample.stddevMs * sample.stddevMs + k * sample.meanMs * sample.meanMs;
+                runs++;
+            }
+        }
+
+        StageDiff diff = { current.stage, 0.0, current.meanMs, 0.0, 0.0, runs, false };
+
+        if (runs > 0 && n > 1.0) {
+
+            double mean     = sum / n;
+            double variance = max(0.0, (squares - n * mean * mean) / (n - 1.0));
+            double k        = static_cast<double>(max(current.samples, 1));
+            double error    = sqrt(current.stddevMs * current.stddevMs / k + variance / n);
+
+            diff.baselineMs    = mean;
+            diff.changePercent = mean > 0.0 ? 100.0 * (current.meanMs - mean) / mean : 0.0;
+            diff.t             = error > 0.0 ? (current.meanMs - mean) / error : 0.0;
+            diff.regression    = diff.t > tThreshold && diff.changePercent >= minSlowdownPercent;
+        }
+
+        diffs.push_back(diff);
+    }
+
+    return diffs;
+}
+
+/******************************************************************************/
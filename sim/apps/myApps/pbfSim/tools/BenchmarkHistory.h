@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * BenchmarkHistory.h
+ * - Per-stage benchmark results kept in a local SQLite database (through
+ *   Poco::Data), and the comparison of a run against a rolling baseline of
+ *   the runs before it
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#ifndef PBF_TOOLS_BENCHMARK_HISTORY_H
+#define PBF_TOOLS_BENCHMARK_HISTORY_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Poco/Data/Session.h"
+
+/******************************************************************************/
+
+// Device time of one stage over the measured steps
+
+typedef struct {
+
+    std::string stage;
+
+    double meanMs;     // Per step
+
+    double stddevMs;
+
+    int samples;       // Number of steps measured
+
+} StageSample;
+
+typedef struct {
+
+    Poco::Int64 id;
+
+    std::string recorded;   // ISO 8601
+
+    std::string commit;
+
+    std::string device;
+
+    int numParticles;
+
+    std::vector<StageSample> stages;
+
+} BenchmarkRun;
+
+// How a stage of the latest run compares to the baseline
+
+typedef struct {
+
+    std::string stage;
+
+    double baselineMs;
+
+    double latestMs;
+
+    double changePercent;
+
+    // Welch's t statistic of the latest samples against the pooled baseline
+    // samples; positive means slower
+    double t;
+
+    int baselineRuns;
+
+    bool regression;
+
+} StageDiff;
+
+/******************************************************************************/
+
+/**
+ * Runs are keyed by (device, particle count); only runs with the same key
+ * are compared
+ */
+class BenchmarkHistory
+{
+    private:
+        std::shared_ptr<Poco::Data::Session> session;
+
+    public:
+        BenchmarkHistory();
+        virtual ~BenchmarkHistory();
+
+        // Opens (creating it if needed) the database at path
+        bool open(const std::string& path);
+
+        bool isOpen() const { return this->session != NULL; }
+
+        bool record(BenchmarkRun& run);
+
+        // Every (device, particle count) recorded so far
+        std::vector<std::pair<std::string, int> > getConfigurations();
+
+        // The most recent runs of a configuration, newest first
+        std::vector<BenchmarkRun> getHistory(const std::string& device, int numParticles, int limit);
+
+        /**
+         * Compares a run stage by stage against the pooled samples of the
+         * baseline runs. A stage is a regression if it is slower with
+         * t > tThreshold and by at least minSlowdownPercent
+         */
+        static std::vector<StageDiff> compare(const BenchmarkRun& latest
+                                             ,const std::vector<BenchmarkRun>& baseline
+                                             ,double tThreshold
+                                             ,double minSlowdownPercent);
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,341 @@
+/*******************************************************************************
+ * benchmark.cpp
+ * - pbf-benchmark: records per-stage device timings of the solver into a
+ *   benchmark history database, and compares the latest run of every
+ *   configuration against a rolling baseline of the runs before it. Built by
+ *   "make benchmark" in src/pbf
+ *
+ *   Usage:
+ *     pbf-benchmark record <db> <commit> [--particles N[,N...]] [--steps N]
+ *                          [--warmup N] [--data path] [--platform P] [--device D]
+ *     pbf-benchmark compare <db> [--window N] [--threshold T] [--min-slowdown PCT]
+ *
+ *   compare exits with status 3 if any stage of any configuration regressed
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include "pbf.h"
+#include "BenchmarkHistory.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+typedef struct {
+
+    vector<int> particleCounts;
+
+    int steps;
+
+    int warmup;
+
+    string dataPath;
+
+    int platform;
+
+    int device;
+
+    int window;
+
+    double threshold;
+
+    double minSlowdown;
+
+} Options;
+
+static bool parseOptions(int argc, char** argv, int first, Options& options)
+{
+    options.particleCounts.clear();
+    options.steps       = 100;
+    options.warmup      = 20;
+    options.dataPath    = "../../bin/data";
+    options.platform    = 0;
+    options.device      = 0;
+    options.window      = 10;
+    options.threshold   = 3.0;
+    options.minSlowdown = 5.0;
+
+    for (int i = first; i < argc; i++) {
+
+        string name = argv[i];
+
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << name << endl;
+            return false;
+        }
+
+        string value = argv[++i];
+
+        if (name == "--particles") {
+            stringstream list(value);
+            string count;
+            while (getline(list, count, ',')) {
+                options.particleCounts.push_back(atoi(count.c_str()));
+            }
+        } else if (name == "--steps") {
+            options.steps = atoi(value.c_str());
+        } else if (name == "--warmup") {
+            options.warmup = atoi(value.c_str());
+        } else if (name == "--data") {
+            options.dataPath = value;
+        } else if (name == "--platform") {
+            options.platform = atoi(value.c_str());
+        } else if (name == "--device") {
+            options.device = atoi(value.c_str());
+        } else if (name == "--window") {
+            options.window = atoi(value.c_str());
+        } else if (name == "--threshold") {
+            options.threshold = atof(value.c_str());
+        } else if (name == "--min-slowdown") {
+            options.minSlowdown = atof(value.c_str());
+        } else {
+            cerr << "Unknown option " << name << endl;
+            return false;
+        }
+    }
+
+    if (options.particleCounts.empty()) {
+        options.particleCounts.push_back(4096);
+        options.particleCounts.push_back(16384);
+        options.particleCounts.push_back(65536);
+    }
+
+    return true;
+}
+
+/******************************************************************************/
+
+/**
+ * Benchmarks one particle count. Steps are profiled one at a time, so every
+ * step is a sample of every stage. The "total" stage is the device time of
+ * the whole step
+ */
+static bool benchmark(pbf::Session& session, int numParticles, const Options& options, BenchmarkRun& run)
+{
+    Parameters parameters;
+    pbf::Bounds bounds;
+
+    for (int i = 0; i < 3; i++) {
+        bounds.min[i] = 0.0f;
+        bounds.max[i] = 20.0f;
+    }
+
+    vector<pbf::Particle> initialState;
+    pbf::Session::randomParticles(initialState, numParticles, bounds, parameters.particleRadius, 1);
+
+    int cells[3];
+    pbf::Session::idealCellsPerAxis(bounds, parameters.particleRadius, 2, cells);
+
+    if (!session.setup(&initialState[0], numParticles, cells, bounds, parameters, 0.033f)) {
+        return false;
+    }
+
+    // Let the fluid settle a little, so the neighborhoods look like a
+    // running simulation rather than the initial random placement:
+
+    session.step(options.warmup);
+
+    pbf::Solver& solver = session.getSolver();
+    solver.setProfiling(true);
+
+    if (!solver.isProfiling()) {
+        return false;
+    }
+
+    vector<string> names;
+    vector<double> sums;
+    vector<double> squares;
+    vector<pbf::StageTiming> timings;
+    int samples = 0;
+
+    for (int step = 0; step < options.steps; step++) {
+
+        session.step();
+
+        if (!solver.collectStageTimings(timings)) {
+            continue;
+        }
+
+        double total = 0.0;
+
+        for (size_t i = 0; i <= timings.size(); i++) {
+
+            string name = i < timings.size() ? timings[i].name : "total";
+            double ms   = i < timings.size() ? timings[i].ms : total;
+            total      += i < timings.size() ? ms : 0.0;
+
+            size_t j = find(names.begin(), names.end(), name) - names.begin();
+
+            if (j == names.size()) {
+                names.push_back(name);
+                sums.push_back(0.0);
+                squares.push_back(0.0);
+            }
+
+            sums[j]    += ms;
+            squares[j] += ms * ms;
+        }
+
+        samples++;
+    }
+
+    solver.setProfiling(false);
+
+    if (samples == 0) {
+        return false;
+    }
+
+    run.device       = session.getDeviceName();
+    run.numParticles = numParticles;
+    run.stages.clear();
+
+    for (size_t j = 0; j < names.size(); j++) {
+
+        double n        = static_cast<double>(samples);
+        double mean     = sums[j] / n;
+        double variance = samples > 1 ? max(0.0, (squares[j] - n * mean * mean) / (n - 1.0)) : 0.0;
+
+        StageSample stage = { names[j], mean, sqrt(variance), samples };
+        run.stages.push_back(stage);
+    }
+
+    return true;
+}
+
+static int record(BenchmarkHistory& history, const string& commit, const Options& options)
+{
+    pbf::Session session(options.dataPath, options.platform, options.device);
+
+    if (!session.isLoaded()) {
+        cerr << "Couldn't load the solver from " << options.dataPath << endl;
+        return 1;
+    }
+
+    for (size_t i = 0; i < options.particleCounts.size(); i++) {
+
+        BenchmarkRun run;
+        run.commit = commit;
+
+        if (!benchmark(session, options.particleCounts[i], options, run)) {
+            cerr << "Couldn't benchmark " << options.particleCounts[i] << " particles" << endl;
+            return 1;
+        }
+
+        if (!history.record(run)) {
+            return 1;
+        }
+
+        cout << run.device << ", " << run.numParticles << " particles: "
+             << run.stages.back().meanMs << " ms per step ("
+             << run.stages.back().samples << " steps)" << endl;
+    }
+
+    return 0;
+}
+
+static int compare(BenchmarkHistory& history, const Options& options)
+{
+    vector<pair<string, int> > configurations = history.getConfigurations();
+
+    int regressions = 0;
+
+    for (size_t i = 0; i < configurations.size(); i++) {
+
+        vector<BenchmarkRun> runs = history.getHistory(configurations[i].first
+                                                      ,configurations[i].second
+                                                      ,options.window + 1);
+        if (runs.empty()) {
+            continue;
+        }
+
+        BenchmarkRun latest = runs.front();
+        vector<BenchmarkRun> baseline(runs.begin() + 1, runs.end());
+
+        cout << latest.device << ", " << latest.numParticles << " particles: "
+             << latest.commit << " (" << latest.recorded << ") against "
+             << baseline.size() << " previous runs" << endl;
+
+        vector<StageDiff> diffs = BenchmarkHistory::compare(latest, baseline, options.threshold, options.minSlowdown);
+
+        printf("  %-24s %12s %12s %9s %8s\n", "stage", "baseline ms", "latest ms", "change", "t");
+
+        for (size_t j = 0; j < diffs.size(); j++) {
+
+            const StageDiff& diff = diffs[j];
+
+            if (diff.baselineRuns == 0) {
+                printf("  %-24s %12s %12.4f %9s %8s  new\n", diff.stage.c_str(), "-", diff.latestMs, "-", "-");
+                continue;
+            }
+
+            printf("  %-24s %12.4f %12.4f %+8.1f%% %8.2f%s\n"
+                  ,diff.stage.c_str()
+                  ,diff.baselineMs
+                  ,diff.latestMs
+                  ,diff.changePercent
+                  ,diff.t
+                  ,diff.regression ? "  REGRESSION" : "");
+
+            regressions += diff.regression ? 1 : 0;
+        }
+
+        cout << endl;
+    }
+
+    if (regressions > 0) {
+        cerr << regressions << " stage(s) regressed" << endl;
+        return 3;
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
+
+static void usage(const char* program)
+{
+    cerr << "Usage:" << endl
+         << "  " << program << " record <db> <commit> [--particles N[,N...]] [--steps N]" << endl
+         << "                       [--warmup N] [--data path] [--platform P] [--device D]" << endl
+         << "  " << program << " compare <db> [--window N] [--threshold T] [--min-slowdown PCT]" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    string command = argv[1];
+    bool recording = command == "record";
+    Options options;
+
+    if ((!recording && command != "compare")
+     || (recording && argc < 4)
+     || !parseOptions(argc, argv, recording ? 4 : 3, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    BenchmarkHistory history;
+
+    if (!history.open(argv[2])) {
+        return 1;
+    }
+
+    return recording ? record(history, argv[3], options) : compare(history, options);
+}
+
+/******************************************************************************/
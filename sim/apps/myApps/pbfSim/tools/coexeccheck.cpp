@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * coexeccheck.cpp
+ * - pbf-coexeccheck: checks that a step co-executed on two devices (see
+ *   pbf::CoExecution) matches the same step taken on a single device, to
+ *   within a tolerance. Built and run on two CPU devices by
+ *   "make coexeccheck" in src/pbf
+ *
+ *   Usage: pbf-coexeccheck [--cpu] [--particles N] [--steps N] [--warmup N]
+ *                          [--tolerance T] [--data path]
+ *
+ *   --cpu co-executes on CPU devices only: two CPU platforms, or one CPU
+ *   split by device fission. The single-device reference runs on the first
+ *   of the two devices. Every check starts both from the reference state,
+ *   so the chaotic growth of small differences over many steps doesn't
+ *   count against the split, and takes STEPS_PER_CHECK steps, so the ghost
+ *   exchange between steps is covered too; the largest position difference
+ *   of every check must stay within T smoothing radii (default 0.001).
+ *   Exits with status 1 if it doesn't, or if no pair of devices could be
+ *   opened
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "pbf.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace {
+
+// Steps taken from the same state by both sides of a check
+const int STEPS_PER_CHECK = 2;
+
+typedef struct {
+
+    bool cpu;
+
+    int numParticles;
+
+    int steps;
+
+    int warmup;
+
+    float tolerance;                  // In smoothing radii
+
+    string dataPath;
+
+} Options;
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    options.cpu          = false;
+    options.numParticles = 8192;
+    options.steps        = 10;
+    options.warmup       = 20;
+    options.tolerance    = 0.001f;
+    options.dataPath     = "../../bin/data";
+
+    for (int i = 1; i < argc; i++) {
+
+        string name = argv[i];
+
+        if (name == "--cpu") {
+            options.cpu = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << name << endl;
+            return false;
+        }
+
+        string value = argv[++i];
+
+        if (name == "--particles") {
+            options.numParticles = atoi(value.c_str());
+        } else if (name == "--steps") {
+            options.steps = atoi(value.c_str());
+        } else if (name == "--warmup") {
+            options.warmup = atoi(value.c_str());
+        } else if (name == "--tolerance") {
+            options.tolerance = static_cast<float>(atof(value.c_str()));
+        } else if (name == "--data") {
+            options.dataPath = value;
+        } else {
+            cerr << "Unknown option " << name << endl;
+            return false;
+        }
+    }
+
+    return options.numParticles > 0 && options.steps > 0;
+}
+
+float distance(const pbf::Particle& a, const pbf::Particle& b)
+{
+    float sum = 0.0f;
+
+    for (int i = 0; i < 3; i++) {
+        float d = a.pos.s[i] - b.pos.s[i];
+        sum += d * d;
+    }
+
+    return sqrt(sum);
+}
+
+}
+
+/******************************************************************************/
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " [--cpu] [--particles N] [--steps N] [--warmup N]"
+             << " [--tolerance T] [--data path]" << endl;
+        return 1;
+    }
+
+    Parameters parameters;
+    pbf::Bounds bounds;
+
+    // Longer along x, so the split plane is always across x:
+
+    for (int i = 0; i < 3; i++) {
+        bounds.min[i] = 0.0f;
+        bounds.max[i] = i == 0 ? 40.0f : 20.0f;
+    }
+
+    int cells[3];
+    pbf::Session::idealCellsPerAxis(bounds, parameters.particleRadius, 2, cells);
+
+    const float dt = 0.033f;
+
+    pbf::CoExecution coExecution(options.dataPath);
+
+    if (!coExecution.open(options.cpu ? CL_DEVICE_TYPE_CPU : CL_DEVICE_TYPE_ALL)) {
+        return 1;
+    }
+
+    pbf::Session reference(options.dataPath, coExecution.getDevice(0));
+
+    if (!reference.isLoaded()) {
+        cerr << "Couldn't load the solver from " << options.dataPath << endl;
+        return 1;
+    }
+
+    vector<pbf::Particle> state;
+    pbf::Session::randomParticles(state, options.numParticles, bounds, parameters.particleRadius, 1);
+
+    if (!reference.setup(&state[0], options.numParticles, cells, bounds, parameters, dt)) {
+        return 1;
+    }
+
+    int solverIterations = reference.getSolver().getSolverIterations();
+
+    cout << "Reference: " << reference.getDeviceName() << endl
+         << "Co-execution: " << coExecution.getPartition(0).name << " + " << coExecution.getPartition(1).name << endl
+         << options.numParticles << " particles, " << solverIterations << " solver iterations, ghost band "
+         << pbf::CoExecution::ghostWidth(parameters, solverIterations) << endl;
+
+    // Let the fluid fall and splash first, so particles cross the split:
+
+    reference.step(options.warmup);
+
+    float limit = options.tolerance * parameters.smoothingRadius;
+    float worst = 0.0f;
+
+    for (int step = 0; step < options.steps; step++) {
+
+        const pbf::Particle* current = reference.getParticles();
+        state.assign(current, current + options.numParticles);
+
+        if (!coExecution.setup(&state[0], options.numParticles, cells, bounds, parameters, dt, solverIterations)) {
+            return 1;
+        }
+
+        for (int i = 0; i < STEPS_PER_CHECK; i++) {
+            if (!coExecution.step(bounds, parameters, dt, solverIterations)) {
+                return 1;
+            }
+        }
+
+        if (!coExecution.readParticles(&state[0])) {
+            return 1;
+        }
+
+        reference.step(STEPS_PER_CHECK);
+
+        const pbf::Particle* expected = reference.getParticles();
+        float largest = 0.0f;
+
+        for (int i = 0; i < options.numParticles; i++) {
+            largest = max(largest, distance(state[i], expected[i]));
+        }
+
+        worst = max(worst, largest);
+
+        cout << "step " << step
+             << ": split " << coExecution.getSplit()
+             << ", owned " << coExecution.getPartition(0).owned << "/" << coExecution.getPartition(1).owned
+             << ", ghosts " << coExecution.getPartition(0).ghosts << "/" << coExecution.getPartition(1).ghosts
+             << ", max position difference " << largest << endl;
+    }
+
+    if (worst > limit) {
+        cerr << "Co-executed steps differ from single-device steps by up to " << worst
+             << " (tolerance " << limit << ")" << endl;
+        return 1;
+    }
+
+    cout << "Co-executed steps match single-device steps to within " << limit << endl;
+    return 0;
+}
+
+/******************************************************************************/
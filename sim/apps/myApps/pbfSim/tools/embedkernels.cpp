@@ -0,0 +1,210 @@
+/*******************************************************************************
+ * embedkernels.cpp
+ * - pbf-embedkernels: writes the kernel sources in the data folder into a C++
+ *   file (src/pbf/KernelSources.cpp), so they are built into the binary and
+ *   don't have to be read from disk at startup. Run by "make kernels" in
+ *   src/pbf, and by the library build whenever a kernel changes
+ *
+ *   Usage: pbf-embedkernels <data path> <output.cpp> <kernels/X.cl>...
+ *
+ *   #include "kernels/..." lines are replaced by the included file (once
+ *   per kernel file), so every embedded source builds on its own. Every
+ *   line becomes its own string literal, which keeps clear of compiler
+ *   limits on literal length; clCreateProgramWithSource takes the lines as
+ *   they are
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+/**
+ * Appends the lines of a kernel file to lines, inlining its includes
+ */
+static bool readKernel(const string& dataPath
+                      ,const string& path
+                      ,set<string>& included
+                      ,vector<string>& lines)
+{
+    if (!included.insert(path).second) {
+        return true;
+    }
+
+    ifstream file((dataPath + "/" + path).c_str(), ios::in | ios::binary);
+
+    if (!file.is_open()) {
+        cerr << "Couldn't open " << dataPath << "/" << path << endl;
+        return false;
+    }
+
+    string line;
+
+    while (getline(file, line)) {
+
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+
+        size_t open  = line.find('"');
+        size_t close = open != string::npos ? line.find('"', open + 1) : string::npos;
+
+        if (line.compare(0, 10, "#include \"") == 0 && close != string::npos) {
+            if (!readKernel(dataPath, line.substr(open + 1, close - open - 1), included, lines)) {
+                return false;
+            }
+            continue;
+        }
+
+        lines.push_back(line + "\n");
+    }
+
+    return true;
+}
+
+/**
+ * Escapes a line for a C string literal. '?' is escaped too, so no trigraphs
+ * are formed
+ */
+static string escape(const string& line)
+{
+    ostringstream out;
+
+    for (size_t i = 0; i < line.size(); i++) {
+
+        unsigned char c = static_cast<unsigned char>(line[i]);
+
+        switch (c) {
+            case '\\': out << "\\\\"; break;
+            case '"':  out << "\\\""; break;
+            case '?':  out << "\\?";  break;
+            case '\n': out << "\\n";  break;
+            case '\t': out << "\\t";  break;
+            default:
+                if (c < 32 || c > 126) {
+                    out << "\\" << oct << static_cast<int>(c) << dec;
+                } else {
+                    out << static_cast<char>(c);
+                }
+        }
+    }
+
+    return out.str();
+}
+
+/**
+ * "kernels/Pairwise.cl" -> "PAIRWISE_CL"
+ */
+static string symbolFor(const string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    string name  = slash == string::npos ? path : path.substr(slash + 1);
+    string symbol;
+
+    for (size_t i = 0; i < name.size(); i++) {
+        symbol += isalnum(static_cast<unsigned char>(name[i])) ? static_cast<char>(toupper(name[i])) : '_';
+    }
+
+    return symbol;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <data path> <output.cpp> <kernels/X.cl>..." << endl;
+        return 1;
+    }
+
+    string dataPath = argv[1];
+    vector<string> paths;
+
+    for (int i = 3; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+
+    ostringstream out;
+
+    out << "/*******************************************************************************\n"
+        << " * KernelSources.cpp\n"
+        << " * - Generated by pbf-embedkernels (tools/embedkernels.cpp) from the kernels\n"
+        << " *   in bin/data; don't edit. \"make kernels\" in src/pbf regenerates it\n"
+        << " *\n"
+        << " * CIS563: Physically Based Animation final project\n"
+        << " * Created by Michael Woods & Michael O'Meara\n"
+        << " ******************************************************************************/\n"
+        << "\n"
+        << "#include \"KernelSources.h\"\n"
+        << "\n"
+        << "/******************************************************************************/\n"
+        << "\n"
+        << "namespace pbf {\n"
+        << "\n"
+        << "namespace {\n";
+
+    for (size_t i = 0; i < paths.size(); i++) {
+
+        set<string> included;
+        vector<string> lines;
+
+        if (!readKernel(dataPath, paths[i], included, lines)) {
+            return 1;
+        }
+
+        out << "\n"
+            << "// " << paths[i] << "\n"
+            << "\n"
+            << "const char* const " << symbolFor(paths[i]) << "[] = {\n";
+
+        for (size_t j = 0; j < lines.size(); j++) {
+            out << "    \"" << escape(lines[j]) << "\",\n";
+        }
+
+        out << "    \"\"\n"
+            << "};\n";
+    }
+
+    out << "\n"
+        << "}\n"
+        << "\n"
+        << "const KernelSource EMBEDDED_KERNELS[] = {\n";
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        string symbol = symbolFor(paths[i]);
+        out << "    { \"" << paths[i] << "\", " << symbol << ", static_cast<int>(sizeof(" << symbol
+            << ") / sizeof(" << symbol << "[0])) },\n";
+    }
+
+    out << "    { NULL, NULL, 0 }\n"
+        << "};\n"
+        << "\n"
+        << "const int NUM_EMBEDDED_KERNELS = " << paths.size() << ";\n"
+        << "\n"
+        << "}\n"
+        << "\n"
+        << "/******************************************************************************/\n";
+
+    ofstream file(argv[2], ios::out | ios::binary);
+
+    if (!file.is_open()) {
+        cerr << "Couldn't write " << argv[2] << endl;
+        return 1;
+    }
+
+    file << out.str();
+
+    cout << "Embedded " << paths.size() << " kernel file(s) in " << argv[2] << endl;
+
+    return 0;
+}
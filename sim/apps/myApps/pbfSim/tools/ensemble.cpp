@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * ensemble.cpp
+ * - pbf-ensemble: runs a parameter sweep over every OpenCL device and writes
+ *   the per-run metrics to a CSV table. Built by "make ensemble" in src/pbf
+ *
+ *   Usage: pbf-ensemble <sweep spec> <results.csv> [data path] [CPU workers]
+ *
+ *   See pbf::SweepSpec::load() for the format of the sweep specification
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include "pbf.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <sweep spec> <results.csv> [data path] [CPU workers]" << endl;
+        return 1;
+    }
+
+    string dataPath = argc > 3 ? argv[3] : "../../bin/data";
+    int cpuWorkers  = argc > 4 ? atoi(argv[4]) : 1;
+
+    pbf::SweepSpec spec;
+
+    if (!spec.load(argv[1])) {
+        return 1;
+    }
+
+    pbf::Ensemble ensemble(dataPath, cpuWorkers);
+
+    cout << "Running " << pbf::Ensemble::expand(spec).size() << " runs on "
+         << ensemble.getNumberOfWorkers() << " workers" << endl;
+
+    vector<pbf::EnsembleResult> results;
+
+    bool completed = ensemble.run(spec, results);
+
+    if (!pbf::Ensemble::writeResults(argv[2], results)) {
+        return 1;
+    }
+
+    if (!completed) {
+        cerr << "Some runs did not complete; see " << argv[2] << endl;
+        return 2;
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
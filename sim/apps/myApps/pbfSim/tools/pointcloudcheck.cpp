@@ -0,0 +1,288 @@
+/*******************************************************************************
+ * pointcloudcheck.cpp
+ * - pbf-pointcloudcheck: checks the point cloud header parsing of
+ *   PointCloudFormat against small in-memory PLY and CSV files, in
+ *   particular that the body starts at the vertices whatever elements come
+ *   before or after them. Built and run by "make check" in src/pbf
+ *
+ *   Usage: pbf-pointcloudcheck
+ *
+ *   Exits with status 1 if any check fails
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "PointCloudFormat.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const string& test, const string& what)
+{
+    if (!condition) {
+        cerr << test << ": " << what << endl;
+        failures++;
+    }
+}
+
+// Appends a native float; the binary cases are written in the host's order
+void appendFloat(string& file, float value)
+{
+    file.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+PointCloudFormat::Format hostBinaryFormat()
+{
+    const int one = 1;
+    bool little   = *reinterpret_cast<const char*>(&one) == 1;
+
+    return little ? PointCloudFormat::PLY_BINARY_LITTLE_ENDIAN : PointCloudFormat::PLY_BINARY_BIG_ENDIAN;
+}
+
+/**
+ * Parses the header of file and checks the format, the vertex count, and
+ * that the body starts at bodyOffset
+ */
+bool checkHeader(const string& test
+                ,const string& file
+                ,PointCloudFormat::Format expectedFormat
+                ,int expectedRecords
+                ,size_t bodyOffset
+                ,PointCloudFormat::RecordLayout& layout)
+{
+    const char* begin = file.data();
+    const char* end   = begin + file.size();
+    const char* body  = NULL;
+    PointCloudFormat::Format format = PointCloudFormat::UNKNOWN;
+    int numRecords = 0;
+
+    if (!PointCloudFormat::parseHeader(begin, end, format, layout, numRecords, body)) {
+        check(false, test, "header rejected");
+        return false;
+    }
+
+    check(format == expectedFormat, test, "wrong format");
+    check(numRecords == expectedRecords, test, "wrong number of records");
+    check(body == begin + bodyOffset, test, "body doesn't start at the vertices");
+
+    return body == begin + bodyOffset;
+}
+
+/**
+ * Checks that the text record at the start of body has the given position
+ */
+void checkTextRecord(const string& test
+                    ,const string& file
+                    ,size_t bodyOffset
+                    ,const PointCloudFormat::RecordLayout& layout
+                    ,float x, float y, float z)
+{
+    float values[PointCloudFormat::MAX_TEXT_COLUMNS];
+    const char* p = file.data() + bodyOffset;
+    int count     = PointCloudFormat::parseLine(p, file.data() + file.size(), values, PointCloudFormat::MAX_TEXT_COLUMNS);
+
+    check(count == layout.numColumns, test, "wrong number of columns in the first record");
+
+    if (count == layout.numColumns) {
+        check(values[layout.column[PointCloudFormat::ATTR_X]] == x &&
+              values[layout.column[PointCloudFormat::ATTR_Y]] == y &&
+              values[layout.column[PointCloudFormat::ATTR_Z]] == z, test, "wrong first position");
+    }
+}
+
+/******************************************************************************/
+
+void checkASCIIVertexThenFace()
+{
+    const string test = "ascii, vertex then face";
+    string header = "ply\n"
+                    "format ascii 1.0\n"
+                    "element vertex 3\n"
+                    "property float x\n"
+                    "property float y\n"
+                    "property float z\n"
+                    "element face 1\n"
+                    "property list uchar int vertex_indices\n"
+                    "end_header\n";
+    string file   = header + "1 2 3\n4 5 6\n7 8 9\n3 0 1 2\n";
+
+    PointCloudFormat::RecordLayout layout;
+
+    if (checkHeader(test, file, PointCloudFormat::PLY_ASCII, 3, header.size(), layout)) {
+        checkTextRecord(test, file, header.size(), layout, 1.0f, 2.0f, 3.0f);
+    }
+}
+
+void checkASCIIFaceThenVertex()
+{
+    const string test = "ascii, face then vertex";
+    string header = "ply\n"
+                    "format ascii 1.0\n"
+                    "element face 2\n"
+                    "property list uchar int vertex_indices\n"
+                    "element vertex 3\n"
+                    "property float z\n"
+                    "property float y\n"
+                    "property float x\n"
+                    "property float vx\n"
+                    "end_header\n";
+    string faces  = "3 0 1 2\n3 2 1 0\n";
+    string file   = header + faces + "1 2 3 0\n4 5 6 0\n7 8 9 0\n";
+
+    PointCloudFormat::RecordLayout layout;
+
+    if (checkHeader(test, file, PointCloudFormat::PLY_ASCII, 3, header.size() + faces.size(), layout)) {
+        checkTextRecord(test, file, header.size() + faces.size(), layout, 3.0f, 2.0f, 1.0f);
+        check(layout.column[PointCloudFormat::ATTR_VX] == 3, test, "vx not found");
+    }
+}
+
+void checkBinaryVertexThenFace()
+{
+    const string test = "binary, vertex then face";
+    PointCloudFormat::Format format = hostBinaryFormat();
+    string header = string("ply\n") +
+                    (format == PointCloudFormat::PLY_BINARY_LITTLE_ENDIAN ? "format binary_little_endian 1.0\n"
+                                                                          : "format binary_big_endian 1.0\n") +
+                    "element vertex 2\n"
+                    "property float x\n"
+                    "property float y\n"
+                    "property float z\n"
+                    "element face 1\n"
+                    "property list uchar int vertex_indices\n"
+                    "end_header\n";
+    string file   = header;
+
+    for (int i = 0; i < 6; i++) {
+        appendFloat(file, static_cast<float>(i + 1));
+    }
+
+    file += "\x03";
+    file.append(12, '\0');
+
+    PointCloudFormat::RecordLayout layout;
+
+    if (checkHeader(test, file, format, 2, header.size(), layout)) {
+        const char* body = file.data() + header.size();
+
+        check(layout.stride == 12, test, "wrong stride");
+        check(PointCloudFormat::readScalar(body + layout.column[PointCloudFormat::ATTR_X], layout.type[PointCloudFormat::ATTR_X], false) == 1.0f &&
+              PointCloudFormat::readScalar(body + layout.stride + layout.column[PointCloudFormat::ATTR_Z], layout.type[PointCloudFormat::ATTR_Z], false) == 6.0f,
+              test, "wrong positions");
+    }
+}
+
+void checkBinaryFixedElementThenVertex()
+{
+    const string test = "binary, fixed-size element then vertex";
+    PointCloudFormat::Format format = hostBinaryFormat();
+    string header = string("ply\n") +
+                    (format == PointCloudFormat::PLY_BINARY_LITTLE_ENDIAN ? "format binary_little_endian 1.0\n"
+                                                                          : "format binary_big_endian 1.0\n") +
+                    "comment skipped: 2 * (4 + 2) bytes\n"
+                    "element camera 2\n"
+                    "property float focal\n"
+                    "property short id\n"
+                    "element vertex 1\n"
+                    "property float x\n"
+                    "property float y\n"
+                    "property float z\n"
+                    "end_header\n";
+    string file   = header + string(12, '\0');
+
+    appendFloat(file, 1.0f);
+    appendFloat(file, 2.0f);
+    appendFloat(file, 3.0f);
+
+    PointCloudFormat::RecordLayout layout;
+
+    checkHeader(test, file, format, 1, header.size() + 12, layout);
+}
+
+void checkBinaryListElementThenVertex()
+{
+    const string test = "binary, list element then vertex";
+    string file = "ply\n"
+                  "format binary_little_endian 1.0\n"
+                  "element face 1\n"
+                  "property list uchar int vertex_indices\n"
+                  "element vertex 1\n"
+                  "property float x\n"
+                  "property float y\n"
+                  "property float z\n"
+                  "end_header\n";
+
+    file.append(16 + 12, '\0');
+
+    const char* body = NULL;
+    PointCloudFormat::Format format;
+    PointCloudFormat::RecordLayout layout;
+    int numRecords = 0;
+
+    // Variable-sized records before the vertices can't be skipped:
+
+    check(!PointCloudFormat::parseHeader(file.data(), file.data() + file.size(), format, layout, numRecords, body)
+         ,test, "header accepted");
+}
+
+void checkCSVWithHeader()
+{
+    const string test = "csv with a header row";
+    string header = "vz;vy;vx;z;y;x\n";
+    string file   = header + "0;0;0;3;2;1\n";
+
+    PointCloudFormat::RecordLayout layout;
+
+    if (checkHeader(test, file, PointCloudFormat::CSV, -1, header.size(), layout)) {
+        checkTextRecord(test, file, header.size(), layout, 1.0f, 2.0f, 3.0f);
+    }
+}
+
+void checkCSVWithoutHeader()
+{
+    const string test = "csv without a header row";
+    string file = "\n1, 2, 3\n4, 5, 6\n";
+
+    PointCloudFormat::RecordLayout layout;
+
+    if (checkHeader(test, file, PointCloudFormat::CSV, -1, 1, layout)) {
+        checkTextRecord(test, file, 1, layout, 1.0f, 2.0f, 3.0f);
+        check(layout.column[PointCloudFormat::ATTR_VX] < 0, test, "velocity found in 3 columns");
+    }
+}
+
+}
+
+/******************************************************************************/
+
+int main(int argc, char** argv)
+{
+    checkASCIIVertexThenFace();
+    checkASCIIFaceThenVertex();
+    checkBinaryVertexThenFace();
+    checkBinaryFixedElementThenVertex();
+    checkBinaryListElementThenVertex();
+    checkCSVWithHeader();
+    checkCSVWithoutHeader();
+
+    if (failures > 0) {
+        cerr << failures << " point cloud format check(s) failed" << endl;
+        return 1;
+    }
+
+    cout << "Point cloud format checks passed" << endl;
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * replay.cpp
+ * - pbf-replay: replays a session recorded by the app (the 'c' key) on a
+ *   headless pbf::Session and writes per-frame step timings, so recorded
+ *   interactive sessions can serve as regression benchmarks. Built by
+ *   "make replay" in src/pbf
+ *
+ *   Usage: pbf-replay <session log> <timings.csv> [data path]
+ *
+ *   Only the inputs that affect the simulation are replayed: pause/step and
+ *   reset keys, and the bounds animation controls. Camera and visualization
+ *   events are skipped. The initial state is generated from the recorded
+ *   seed by pbf::Session::randomParticles, so it matches other headless
+ *   replays of the same log, not the app's
+ *
+ * CIS563: Physically Based Animation final project
+ * Created by Michael Woods & Michael O'Meara
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include "pbf.h"
+
+/******************************************************************************/
+
+using namespace std;
+
+/******************************************************************************/
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <session log> <timings.csv> [data path]" << endl;
+        return 1;
+    }
+
+    string dataPath = argc > 3 ? argv[3] : "../../bin/data";
+
+    pbf::SessionLog log;
+
+    if (!log.load(argv[1])) {
+        return 1;
+    }
+
+    const pbf::SessionEvent* seed  = log.findEvent("seed");
+    const pbf::SessionEvent* scene = log.findEvent("scene");
+
+    if (seed == NULL || scene == NULL || scene->values.size() < 19) {
+        cerr << argv[1] << " has no seed or scene; was it recorded by the app?" << endl;
+        return 1;
+    }
+
+    // Scene: bounds (6), particle count, dt, cells per axis (3), the seven
+    // parameters and the solver iterations:
+
+    const vector<float>& v = scene->values;
+
+    pbf::Bounds bounds;
+
+    for (int i = 0; i < 3; i++) {
+        bounds.min[i] = v[i];
+        bounds.max[i] = v[3 + i];
+    }
+
+    int numParticles = static_cast<int>(v[6]);
+    float dt         = v[7];
+    int cells[3]     = { static_cast<int>(v[8]), static_cast<int>(v[9]), static_cast<int>(v[10]) };
+    Parameters parameters(v[11], v[12], v[13], v[14], v[15], v[16], v[17]);
+
+    pbf::Session session(dataPath);
+
+    if (!session.isLoaded()) {
+        cerr << "Couldn't load the solver from " << dataPath << endl;
+        return 1;
+    }
+
+    vector<pbf::Particle> initialState;
+    pbf::Session::randomParticles(initialState, numParticles, bounds, parameters.particleRadius, static_cast<unsigned int>(seed->values[0]));
+
+    if (!session.setup(&initialState[0], numParticles, cells, bounds, parameters, dt)) {
+        return 1;
+    }
+
+    session.setSolverIterations(static_cast<int>(v[18]));
+
+    ofstream timings(argv[2]);
+
+    if (!timings) {
+        cerr << "Couldn't write " << argv[2] << endl;
+        return 1;
+    }
+
+    timings << "frame,simulation_frame,step_ms" << endl;
+
+    bool paused      = true;
+    bool done        = false;
+    unsigned int end = log.getLastFrame();
+    double total     = 0.0;
+    double worst     = 0.0;
+    int steps        = 0;
+
+    for (unsigned int frame = 0; frame <= end && !done; frame++) {
+
+        bool stepOnce = false;
+        pbf::SessionEvent event;
+
+        while (log.nextEvent(frame, event)) {
+
+            float value = event.values.empty() ? 0.0f : event.values[0];
+
+            if (event.name == "paused") {
+                paused = value != 0.0f;
+            } else if (event.name == "key") {
+                int key = static_cast<int>(value);
+                if (key == 'p' || key == ' ') {
+                    paused = !paused;
+                } else if (key == 's') {
+                    stepOnce = true;
+                } else if (key == 'r') {
+                    session.setup(&initialState[0], numParticles, cells, bounds, parameters, dt);
+                }
+            } else if (event.name == "animate") {
+                session.setAnimating(value != 0.0f);
+            } else if (event.name == "bothSides") {
+                session.getAnimation().bothSides = value != 0.0f;
+            } else if (event.name == "animation") {
+                session.getAnimation().type = static_cast<pbf::BoundsAnimation::Type>(static_cast<int>(value));
+            } else if (event.name == "period") {
+                session.getAnimation().period = value;
+            } else if (event.name == "amplitude") {
+                session.getAnimation().amplitude = value;
+            } else if (event.name == "resetBounds") {
+                session.setAnimating(false);
+                session.getAnimation().bothSides = false;
+                session.resetBounds();
+            } else if (event.name == "end") {
+                done = true;
+            }
+        }
+
+        if (done || (paused && !stepOnce)) {
+            continue;
+        }
+
+        auto start = chrono::steady_clock::now();
+
+        session.step();
+
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        timings << frame << "," << session.getFrameNumber() << "," << ms << "\n";
+
+        total += ms;
+        worst  = max(worst, ms);
+        steps++;
+    }
+
+    cout << "Replayed " << end << " frames, " << steps << " steps on " << session.getDeviceName()
+         << ": mean " << (steps > 0 ? total / steps : 0.0) << " ms, max " << worst << " ms per step" << endl;
+
+    return 0;
+}
+
+/******************************************************************************/